@@ -138,6 +138,13 @@ static size_t gst_curl_http_src_get_header (void *header, size_t size,
 static size_t gst_curl_http_src_get_chunks (void *chunk, size_t size,
     size_t nmemb, void *src);
 static void gst_curl_http_src_request_remove (GstCurlHttpSrc * src);
+static void gst_curl_http_src_drop_buffer (GstCurlHttpSrc * src);
+#ifndef G_OS_WIN32
+static int gst_curl_http_src_socket_cb (CURL * easy, curl_socket_t s,
+    int what, void *userp, void *socketp);
+static int gst_curl_http_src_timer_cb (CURLM * multi, long timeout_ms,
+    void *userp);
+#endif
 static char *gst_curl_http_src_strcasestr (const char *haystack,
     const char *needle);
 
@@ -619,7 +626,7 @@ gst_curl_http_src_init (GstCurlHttpSrc * source)
   g_mutex_init (&source->buffer_mutex);
   g_cond_init (&source->signal);
 
-  source->buffer = NULL;
+  g_queue_init (&source->buffer);
   source->buffer_len = 0;
   source->state = GSTCURL_NONE;
   source->pending_state = GSTCURL_NONE;
@@ -664,6 +671,21 @@ gst_curl_http_src_ref_multi (GstCurlHttpSrc * src)
     curl_multi_setopt (klass->multi_task_context.multi_handle,
         CURLMOPT_MAX_HOST_CONNECTIONS, 1);
 #endif
+#ifndef G_OS_WIN32
+    /* Let curl tell us which sockets to watch instead of collecting them all
+     * with curl_multi_fdset() on every iteration */
+    klass->multi_task_context.pollfds =
+        g_array_new (FALSE, FALSE, sizeof (GPollFD));
+    klass->multi_task_context.timer_deadline = -1;
+    curl_multi_setopt (klass->multi_task_context.multi_handle,
+        CURLMOPT_SOCKETFUNCTION, gst_curl_http_src_socket_cb);
+    curl_multi_setopt (klass->multi_task_context.multi_handle,
+        CURLMOPT_SOCKETDATA, &klass->multi_task_context);
+    curl_multi_setopt (klass->multi_task_context.multi_handle,
+        CURLMOPT_TIMERFUNCTION, gst_curl_http_src_timer_cb);
+    curl_multi_setopt (klass->multi_task_context.multi_handle,
+        CURLMOPT_TIMERDATA, &klass->multi_task_context);
+#endif
 
     /* Start the thread */
     klass->multi_task_context.task = gst_task_new (
@@ -716,6 +738,10 @@ gst_curl_http_src_unref_multi (GstCurlHttpSrc * src)
     g_cond_signal (&klass->multi_task_context.signal);
     g_mutex_unlock (&klass->multi_task_context.mutex);
     gst_task_join (klass->multi_task_context.task);
+#ifndef G_OS_WIN32
+    g_array_free (klass->multi_task_context.pollfds, TRUE);
+    klass->multi_task_context.pollfds = NULL;
+#endif
   } else {
     g_mutex_unlock (&klass->multi_task_context.mutex);
   }
@@ -806,11 +832,7 @@ retry:
   }
 
   if (src->state == GSTCURL_UNLOCK) {
-    if (src->buffer_len > 0) {
-      g_free (src->buffer);
-      src->buffer = NULL;
-      src->buffer_len = 0;
-    }
+    gst_curl_http_src_drop_buffer (src);
     ret = GST_FLOW_FLUSHING;
     goto escape;
   }
@@ -859,16 +881,22 @@ retry:
   if (((src->state == GSTCURL_OK) || (src->state == GSTCURL_DONE)) &&
       (src->buffer_len > 0)) {
 
-    GST_DEBUG_OBJECT (src, "Pushing %u bytes of transfer for URI %s to pad",
-        src->buffer_len, src->uri);
-    *outbuf = gst_buffer_new_allocate (NULL, src->buffer_len, NULL);
-    gst_buffer_fill (*outbuf, 0, src->buffer, src->buffer_len);
+    guint n_mem = 0, max_mem = gst_buffer_get_max_memory ();
+    GstMemory *mem;
 
-    g_free (src->buffer);
-    src->buffer = NULL;
-    src->buffer_len = 0;
+    /* Hand out the received chunks as they are, as long as they fit in one
+     * buffer without being merged; the rest goes into the next one. */
+    *outbuf = gst_buffer_new ();
+    while (n_mem < max_mem && (mem = g_queue_pop_head (&src->buffer))) {
+      src->buffer_len -= gst_memory_get_sizes (mem, NULL, NULL);
+      gst_buffer_append_memory (*outbuf, mem);
+      n_mem++;
+    }
     src->data_received = TRUE;
 
+    GST_DEBUG_OBJECT (src, "Pushing %" G_GSIZE_FORMAT " bytes of transfer "
+        "for URI %s to pad", gst_buffer_get_size (*outbuf), src->uri);
+
     /* ret should still be GST_FLOW_OK */
   } else if ((src->state == GSTCURL_DONE) && (src->buffer_len == 0)) {
     GST_INFO_OBJECT (src, "Full body received, signalling EOS for URI %s.",
@@ -1318,8 +1346,7 @@ gst_curl_http_src_cleanup_instance (GstCurlHttpSrc * src)
 
   g_cond_clear (&src->signal);
 
-  g_free (src->buffer);
-  src->buffer = NULL;
+  gst_curl_http_src_drop_buffer (src);
 
   if (src->http_headers != NULL) {
     gst_structure_free (src->http_headers);
@@ -1559,50 +1586,66 @@ gst_curl_http_src_curl_multi_loop (gpointer thread_data)
     }
     g_mutex_unlock (&context->mutex);
   } else if (context->state == GSTCURL_MULTI_LOOP_STATE_RUNNING) {
-    struct timeval timeout;
-    gint rc;
-    fd_set fdread, fdwrite, fdexcep;
-    int maxfd = -1;
-    long curl_timeo = -1;
-
     /* Because curl can possibly take some time here, be nice and let go of the
      * mutex so other threads can perform state/queue operations as we don't
      * care about those until the end of this. */
     g_mutex_unlock (&context->mutex);
 
-    FD_ZERO (&fdread);
-    FD_ZERO (&fdwrite);
-    FD_ZERO (&fdexcep);
+    /* Only go back to waiting once curl reported no running transfers */
+    still_running = 1;
 
-    timeout.tv_sec = 1;
-    timeout.tv_usec = 0;
-
-    curl_multi_timeout (context->multi_handle, &curl_timeo);
-    if (curl_timeo >= 0) {
-      timeout.tv_sec = curl_timeo / 1000;
-      if (timeout.tv_sec > 1) {
-        timeout.tv_sec = 1;
-      } else {
-        timeout.tv_usec = (curl_timeo % 1000) * 1000;
+#ifdef G_OS_WIN32
+    curl_multi_wait (context->multi_handle, NULL, 0, 1000, NULL);
+    curl_multi_perform (context->multi_handle, &still_running);
+#else
+    {
+      GPollFD *fds;
+      guint n_fds;
+      gint timeout, rc;
+      gint64 now;
+
+      /* Wake up at least once a second to pick up queue and state changes */
+      timeout = 1000;
+      if (context->timer_deadline >= 0) {
+        now = g_get_monotonic_time ();
+        timeout = MIN ((MAX (context->timer_deadline - now, 0) + 999) / 1000,
+            timeout);
       }
-    }
-
-    /* get file descriptors from the transfers */
-    curl_multi_fdset (context->multi_handle, &fdread, &fdwrite, &fdexcep,
-        &maxfd);
 
-    rc = select (maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout);
+      /* curl may change the watched sockets from within
+       * curl_multi_socket_action(), so work on a copy */
+      n_fds = context->pollfds->len;
+      fds = g_newa (GPollFD, n_fds + 1);
+      memcpy (fds, context->pollfds->data, n_fds * sizeof (GPollFD));
+
+      rc = g_poll (fds, n_fds, timeout);
+      if (rc > 0) {
+        for (i = 0; i < n_fds; i++) {
+          int ev_bitmask = 0;
+
+          if (fds[i].revents == 0)
+            continue;
+          if (fds[i].revents & G_IO_IN)
+            ev_bitmask |= CURL_CSELECT_IN;
+          if (fds[i].revents & G_IO_OUT)
+            ev_bitmask |= CURL_CSELECT_OUT;
+          if (fds[i].revents & (G_IO_ERR | G_IO_HUP | G_IO_NVAL))
+            ev_bitmask |= CURL_CSELECT_ERR;
+          curl_multi_socket_action (context->multi_handle, fds[i].fd,
+              ev_bitmask, &still_running);
+        }
+      }
 
-    switch (rc) {
-      case -1:
-        /* select error */
-        break;
-      case 0:
-      default:
-        /* timeout or readable/writable sockets */
-        curl_multi_perform (context->multi_handle, &still_running);
-        break;
+      /* Also let curl look at its transfers when we woke up for nothing, so
+       * that it reports when there are none left */
+      if (rc == 0 || (context->timer_deadline >= 0 &&
+              g_get_monotonic_time () >= context->timer_deadline)) {
+        context->timer_deadline = -1;
+        curl_multi_socket_action (context->multi_handle, CURL_SOCKET_TIMEOUT,
+            0, &still_running);
+      }
     }
+#endif
 
     /*
      * Check the CURL message buffer to find out if any transfers have
@@ -1683,6 +1726,62 @@ gst_curl_http_src_curl_multi_loop (gpointer thread_data)
   }
 }
 
+#ifndef G_OS_WIN32
+/*
+ * Called by curl from within the multi loop whenever the set of events it
+ * wants to be told about on a socket changes.
+ */
+static int
+gst_curl_http_src_socket_cb (CURL * easy, curl_socket_t s, int what,
+    void *userp, void *socketp)
+{
+  GstCurlHttpSrcMultiTaskContext *context = userp;
+  GPollFD *pfd;
+  guint i;
+
+  for (i = 0; i < context->pollfds->len; i++) {
+    if (g_array_index (context->pollfds, GPollFD, i).fd == s)
+      break;
+  }
+
+  if (what == CURL_POLL_REMOVE) {
+    if (i < context->pollfds->len)
+      g_array_remove_index_fast (context->pollfds, i);
+    return 0;
+  }
+
+  if (i == context->pollfds->len) {
+    GPollFD new_pfd = { s, 0, 0 };
+    g_array_append_val (context->pollfds, new_pfd);
+  }
+
+  pfd = &g_array_index (context->pollfds, GPollFD, i);
+  pfd->events = G_IO_ERR | G_IO_HUP;
+  if (what & CURL_POLL_IN)
+    pfd->events |= G_IO_IN;
+  if (what & CURL_POLL_OUT)
+    pfd->events |= G_IO_OUT;
+
+  return 0;
+}
+
+/*
+ * Called by curl to (re)arm or cancel the single timeout of the multi handle.
+ */
+static int
+gst_curl_http_src_timer_cb (CURLM * multi, long timeout_ms, void *userp)
+{
+  GstCurlHttpSrcMultiTaskContext *context = userp;
+
+  if (timeout_ms < 0)
+    context->timer_deadline = -1;
+  else
+    context->timer_deadline = g_get_monotonic_time () + timeout_ms * 1000;
+
+  return 0;
+}
+#endif
+
 /*
  * Receive headers from the remote server and put them into the http_headers
  * structure to be sent downstream when we've got them all and started receiving
@@ -1832,6 +1931,8 @@ gst_curl_http_src_get_chunks (void *chunk, size_t size, size_t nmemb, void *src)
 {
   GstCurlHttpSrc *s = src;
   size_t chunk_len = size * nmemb;
+  gpointer data;
+  GstMemory *mem;
   GST_TRACE_OBJECT (s,
       "Received curl chunk for URI %s of size %d", s->uri, (int) chunk_len);
   g_mutex_lock (&s->buffer_mutex);
@@ -1839,19 +1940,31 @@ gst_curl_http_src_get_chunks (void *chunk, size_t size, size_t nmemb, void *src)
     g_mutex_unlock (&s->buffer_mutex);
     return chunk_len;
   }
-  s->buffer =
-      g_realloc (s->buffer, (s->buffer_len + chunk_len + 1) * sizeof (char));
-  if (s->buffer == NULL) {
-    GST_ERROR_OBJECT (s, "Realloc for cURL response message failed!\n");
-    return 0;
-  }
-  memcpy (s->buffer + s->buffer_len, chunk, chunk_len);
+  /* Each chunk is copied once into its own memory, which ::create() then
+   * pushes downstream as it is. */
+  data = g_memdup (chunk, chunk_len);
+  mem = gst_memory_new_wrapped (0, data, chunk_len, 0, chunk_len, data, g_free);
+  g_queue_push_tail (&s->buffer, mem);
   s->buffer_len += chunk_len;
   g_cond_signal (&s->signal);
   g_mutex_unlock (&s->buffer_mutex);
   return chunk_len;
 }
 
+/*
+ * Drop any received chunks that haven't been pushed yet. Called with the
+ * buffer mutex held.
+ */
+static void
+gst_curl_http_src_drop_buffer (GstCurlHttpSrc * src)
+{
+  GstMemory *mem;
+
+  while ((mem = g_queue_pop_head (&src->buffer)) != NULL)
+    gst_memory_unref (mem);
+  src->buffer_len = 0;
+}
+
 /*
  * Request a cancellation of a currently running curl handle.
  */
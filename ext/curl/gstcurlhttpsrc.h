@@ -126,6 +126,10 @@ struct _GstCurlHttpSrcMultiTaskContext
 
   /* < private > */
   CURLM *multi_handle;
+#ifndef G_OS_WIN32
+  GArray *pollfds;              /* GPollFD for every socket curl watches */
+  gint64 timer_deadline;        /* monotonic time curl wants a timeout, or -1 */
+#endif
 };
 
 struct _GstCurlHttpSrcClass
@@ -201,8 +205,8 @@ struct _GstCurlHttpSrc
   CURL *curl_handle;
   GMutex buffer_mutex;
   GCond signal;
-  gchar *buffer;
-  guint buffer_len;
+  GQueue buffer;                /* received body chunks as GstMemory */
+  gsize buffer_len;
   gboolean transfer_begun;
   gboolean data_received;
 
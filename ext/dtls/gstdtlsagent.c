@@ -39,6 +39,8 @@
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
+#include <string.h>
+
 GST_DEBUG_CATEGORY_STATIC (gst_dtls_agent_debug);
 #define GST_CAT_DEFAULT gst_dtls_agent_debug
 
@@ -55,11 +57,17 @@ enum
 
 static GParamSpec *properties[NUM_PROPERTIES];
 
+/* Maximum number of client sessions remembered for resumption */
+#define MAX_CACHED_SESSIONS 1024
+
 struct _GstDtlsAgentPrivate
 {
   SSL_CTX *ssl_context;
 
   GstDtlsCertificate *certificate;
+
+  GMutex session_lock;
+  GHashTable *sessions;
 };
 
 static void gst_dtls_agent_finalize (GObject * gobject);
@@ -200,6 +208,16 @@ gst_dtls_agent_init (GstDtlsAgent * self)
 #if OPENSSL_VERSION_NUMBER >= 0x1000200fL
   SSL_CTX_set_ecdh_auto (priv->ssl_context, 1);
 #endif
+
+  /* Let servers resume sessions from their cache or from session tickets,
+   * which requires a session id context as peers are verified */
+  SSL_CTX_set_session_cache_mode (priv->ssl_context, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_set_session_id_context (priv->ssl_context,
+      (const guchar *) "gstdtls", strlen ("gstdtls"));
+
+  g_mutex_init (&priv->session_lock);
+  priv->sessions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) SSL_SESSION_free);
 }
 
 static void
@@ -207,6 +225,10 @@ gst_dtls_agent_finalize (GObject * gobject)
 {
   GstDtlsAgentPrivate *priv = GST_DTLS_AGENT (gobject)->priv;
 
+  g_hash_table_unref (priv->sessions);
+  priv->sessions = NULL;
+  g_mutex_clear (&priv->session_lock);
+
   SSL_CTX_free (priv->ssl_context);
   priv->ssl_context = NULL;
 
@@ -282,3 +304,50 @@ _gst_dtls_agent_peek_context (GstDtlsAgent * self)
   g_return_val_if_fail (GST_IS_DTLS_AGENT (self), NULL);
   return self->priv->ssl_context;
 }
+
+void
+_gst_dtls_agent_take_session (GstDtlsAgent * self, const gchar * id,
+    gpointer session)
+{
+  GstDtlsAgentPrivate *priv;
+
+  g_return_if_fail (GST_IS_DTLS_AGENT (self));
+  g_return_if_fail (id);
+  g_return_if_fail (session);
+
+  priv = self->priv;
+
+  g_mutex_lock (&priv->session_lock);
+  if (g_hash_table_size (priv->sessions) >= MAX_CACHED_SESSIONS
+      && !g_hash_table_contains (priv->sessions, id)) {
+    GST_DEBUG_OBJECT (self, "session cache full, flushing it");
+    g_hash_table_remove_all (priv->sessions);
+  }
+  g_hash_table_insert (priv->sessions, g_strdup (id), session);
+  g_mutex_unlock (&priv->session_lock);
+}
+
+gpointer
+_gst_dtls_agent_dup_session (GstDtlsAgent * self, const gchar * id)
+{
+  GstDtlsAgentPrivate *priv;
+  SSL_SESSION *session;
+
+  g_return_val_if_fail (GST_IS_DTLS_AGENT (self), NULL);
+  g_return_val_if_fail (id, NULL);
+
+  priv = self->priv;
+
+  g_mutex_lock (&priv->session_lock);
+  session = g_hash_table_lookup (priv->sessions, id);
+  if (session) {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    SSL_SESSION_up_ref (session);
+#else
+    CRYPTO_add (&session->references, 1, CRYPTO_LOCK_SSL_SESSION);
+#endif
+  }
+  g_mutex_unlock (&priv->session_lock);
+
+  return session;
+}
@@ -77,6 +77,18 @@ gchar *gst_dtls_agent_get_certificate_pem(GstDtlsAgent *self);
 void _gst_dtls_init_openssl(void);
 const GstDtlsAgentContext _gst_dtls_agent_peek_context(GstDtlsAgent *);
 
+/*
+ * Remembers the SSL_SESSION of the client connection with the given id,
+ * taking ownership of it.
+ */
+void _gst_dtls_agent_take_session(GstDtlsAgent *, const gchar *id, gpointer session);
+
+/*
+ * Returns a new reference to the SSL_SESSION remembered for the given id,
+ * or NULL.
+ */
+gpointer _gst_dtls_agent_dup_session(GstDtlsAgent *, const gchar *id);
+
 G_END_DECLS
 
 #endif /* gstdtlsagent_h */
@@ -60,6 +60,7 @@ enum
   SIGNAL_ON_ENCODER_KEY,
   SIGNAL_ON_DECODER_KEY,
   SIGNAL_ON_PEER_CERTIFICATE,
+  SIGNAL_ON_HANDSHAKE_FAILED,
   NUM_SIGNALS
 };
 
@@ -69,6 +70,8 @@ enum
 {
   PROP_0,
   PROP_AGENT,
+  PROP_CONNECTION_ID,
+  PROP_SESSION_RESUMED,
   NUM_PROPERTIES
 };
 
@@ -83,9 +86,13 @@ struct _GstDtlsConnectionPrivate
   SSL *ssl;
   BIO *bio;
 
+  GstDtlsAgent *agent;
+  gchar *id;
+
   gboolean is_client;
   gboolean is_alive;
   gboolean keys_exported;
+  gboolean session_resumed;
 
   GMutex mutex;
   GCond condition;
@@ -96,18 +103,22 @@ struct _GstDtlsConnectionPrivate
   GClosure *send_closure;
 
   gboolean timeout_pending;
-  GThreadPool *thread_pool;
+  GstClockID timeout_clock_id;
 };
 
 static void gst_dtls_connection_finalize (GObject * gobject);
 static void gst_dtls_connection_set_property (GObject *, guint prop_id,
     const GValue *, GParamSpec *);
+static void gst_dtls_connection_get_property (GObject *, guint prop_id,
+    GValue *, GParamSpec *);
 
 static void log_state (GstDtlsConnection *, const gchar * str);
 static void export_srtp_keys (GstDtlsConnection *);
 static void openssl_poll (GstDtlsConnection *);
+static void handshake_failed (GstDtlsConnection *);
 static int openssl_verify_callback (int preverify_ok,
     X509_STORE_CTX * x509_ctx);
+static gboolean emit_peer_certificate (GstDtlsConnection *, X509 * cert);
 
 static BIO_METHOD *BIO_s_gst_dtls_connection (void);
 static int bio_method_write (BIO *, const char *data, int size);
@@ -124,6 +135,7 @@ gst_dtls_connection_class_init (GstDtlsConnectionClass * klass)
   g_type_class_add_private (klass, sizeof (GstDtlsConnectionPrivate));
 
   gobject_class->set_property = gst_dtls_connection_set_property;
+  gobject_class->get_property = gst_dtls_connection_get_property;
 
   connection_ex_index =
       SSL_get_ex_new_index (0, (gpointer) "gstdtlsagent connection index", NULL,
@@ -146,6 +158,11 @@ gst_dtls_connection_class_init (GstDtlsConnectionClass * klass)
       G_SIGNAL_RUN_LAST, 0, NULL, NULL,
       g_cclosure_marshal_generic, G_TYPE_BOOLEAN, 1, G_TYPE_STRING);
 
+  signals[SIGNAL_ON_HANDSHAKE_FAILED] =
+      g_signal_new ("on-handshake-failed", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+      g_cclosure_marshal_generic, G_TYPE_NONE, 0);
+
   properties[PROP_AGENT] =
       g_param_spec_object ("agent",
       "DTLS Agent",
@@ -153,6 +170,19 @@ gst_dtls_connection_class_init (GstDtlsConnectionClass * klass)
       GST_TYPE_DTLS_AGENT,
       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_CONNECTION_ID] =
+      g_param_spec_string ("connection-id",
+      "Connection id",
+      "Id used to resume the DTLS session of a previous client connection "
+      "with the same id, or NULL to always do a full handshake",
+      NULL, G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_SESSION_RESUMED] =
+      g_param_spec_boolean ("session-resumed",
+      "Session resumed",
+      "Whether the handshake resumed the session of a previous connection",
+      FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, NUM_PROPERTIES, properties);
 
   _gst_dtls_init_openssl ();
@@ -174,6 +204,7 @@ gst_dtls_connection_init (GstDtlsConnection * self)
   priv->is_client = FALSE;
   priv->is_alive = TRUE;
   priv->keys_exported = FALSE;
+  priv->session_resumed = FALSE;
 
   priv->bio_buffer = NULL;
   priv->bio_buffer_len = 0;
@@ -182,12 +213,59 @@ gst_dtls_connection_init (GstDtlsConnection * self)
   g_mutex_init (&priv->mutex);
   g_cond_init (&priv->condition);
 
-  /* Thread pool for handling timeouts, we only need one thread for that
-   * really and share threads with all other thread pools around there as
-   * this is not going to happen very often */
-  priv->thread_pool = g_thread_pool_new (handle_timeout, self, 1, FALSE, NULL);
-  g_assert (priv->thread_pool);
+  priv->agent = NULL;
+  priv->id = NULL;
+
   priv->timeout_pending = FALSE;
+  priv->timeout_clock_id = NULL;
+}
+
+/* Retransmission timeouts of all connections are handled by a single,
+ * bounded pool. A burst of connections being set up at the same time would
+ * otherwise need one thread per connection. */
+static GThreadPool *
+get_timeout_thread_pool (void)
+{
+  static gsize pool = 0;
+
+  if (g_once_init_enter (&pool)) {
+    GThreadPool *new_pool;
+    gint max_threads = g_get_num_processors ();
+
+    new_pool = g_thread_pool_new (handle_timeout, NULL, MAX (max_threads, 2),
+        FALSE, NULL);
+    g_assert (new_pool);
+
+    g_once_init_leave (&pool, (gsize) new_pool);
+  }
+
+  return (GThreadPool *) pool;
+}
+
+static void
+gst_dtls_connection_clear_timeout_locked (GstDtlsConnection * self)
+{
+  GstDtlsConnectionPrivate *priv = self->priv;
+
+  if (priv->timeout_clock_id) {
+    gst_clock_id_unschedule (priv->timeout_clock_id);
+    gst_clock_id_unref (priv->timeout_clock_id);
+    priv->timeout_clock_id = NULL;
+  }
+}
+
+/* Must be called with the mutex held */
+static void
+gst_dtls_connection_push_timeout_locked (GstDtlsConnection * self)
+{
+  GstDtlsConnectionPrivate *priv = self->priv;
+
+  if (priv->is_alive && !priv->timeout_pending) {
+    priv->timeout_pending = TRUE;
+
+    GST_TRACE_OBJECT (self, "Schedule timeout now");
+    g_thread_pool_push (get_timeout_thread_pool (), g_object_ref (self), NULL);
+  }
 }
 
 static void
@@ -196,12 +274,19 @@ gst_dtls_connection_finalize (GObject * gobject)
   GstDtlsConnection *self = GST_DTLS_CONNECTION (gobject);
   GstDtlsConnectionPrivate *priv = self->priv;
 
-  g_thread_pool_free (priv->thread_pool, TRUE, TRUE);
-  priv->thread_pool = NULL;
+  gst_dtls_connection_clear_timeout_locked (self);
 
   SSL_free (priv->ssl);
   priv->ssl = NULL;
 
+  if (priv->agent) {
+    g_object_unref (priv->agent);
+    priv->agent = NULL;
+  }
+
+  g_free (priv->id);
+  priv->id = NULL;
+
   if (priv->send_closure) {
     g_closure_unref (priv->send_closure);
     priv->send_closure = NULL;
@@ -278,8 +363,32 @@ gst_dtls_connection_set_property (GObject * object, guint prop_id,
           openssl_verify_callback);
       SSL_set_ex_data (priv->ssl, connection_ex_index, self);
 
+      priv->agent = g_object_ref (agent);
+
       log_state (self, "connection created");
       break;
+    case PROP_CONNECTION_ID:
+      g_free (priv->id);
+      priv->id = g_value_dup_string (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
+  }
+}
+
+static void
+gst_dtls_connection_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstDtlsConnection *self = GST_DTLS_CONNECTION (object);
+  GstDtlsConnectionPrivate *priv = self->priv;
+
+  switch (prop_id) {
+    case PROP_SESSION_RESUMED:
+      g_mutex_lock (&priv->mutex);
+      g_value_set_boolean (value, priv->session_resumed);
+      g_mutex_unlock (&priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
@@ -305,9 +414,21 @@ gst_dtls_connection_start (GstDtlsConnection * self, gboolean is_client)
   priv->bio_buffer_len = 0;
   priv->bio_buffer_offset = 0;
   priv->keys_exported = FALSE;
+  priv->session_resumed = FALSE;
 
   priv->is_client = is_client;
   if (priv->is_client) {
+    gpointer session = NULL;
+
+    if (priv->id)
+      session = _gst_dtls_agent_dup_session (priv->agent, priv->id);
+
+    if (session) {
+      GST_DEBUG_OBJECT (self, "trying to resume session of '%s'", priv->id);
+      SSL_set_session (priv->ssl, session);
+      SSL_SESSION_free (session);
+    }
+
     SSL_set_connect_state (priv->ssl);
   } else {
     SSL_set_accept_state (priv->ssl);
@@ -325,7 +446,7 @@ gst_dtls_connection_start (GstDtlsConnection * self, gboolean is_client)
 static void
 handle_timeout (gpointer data, gpointer user_data)
 {
-  GstDtlsConnection *self = user_data;
+  GstDtlsConnection *self = data;
   GstDtlsConnectionPrivate *priv;
   gint ret;
 
@@ -348,6 +469,8 @@ handle_timeout (gpointer data, gpointer user_data)
     }
   }
   g_mutex_unlock (&priv->mutex);
+
+  g_object_unref (self);
 }
 
 static gboolean
@@ -355,16 +478,17 @@ schedule_timeout_handling (GstClock * clock, GstClockTime time, GstClockID id,
     gpointer user_data)
 {
   GstDtlsConnection *self = user_data;
+  GstDtlsConnectionPrivate *priv = self->priv;
 
-  g_mutex_lock (&self->priv->mutex);
-  if (self->priv->is_alive && !self->priv->timeout_pending) {
-    self->priv->timeout_pending = TRUE;
+  g_mutex_lock (&priv->mutex);
+  /* Ignore timeouts that were replaced by a newer one in the meantime */
+  if (priv->timeout_clock_id == id) {
+    gst_clock_id_unref (priv->timeout_clock_id);
+    priv->timeout_clock_id = NULL;
 
-    GST_TRACE_OBJECT (self, "Schedule timeout now");
-    g_thread_pool_push (self->priv->thread_pool, GINT_TO_POINTER (0xc0ffee),
-        NULL);
+    gst_dtls_connection_push_timeout_locked (self);
   }
-  g_mutex_unlock (&self->priv->mutex);
+  g_mutex_unlock (&priv->mutex);
 
   return TRUE;
 }
@@ -393,6 +517,10 @@ gst_dtls_connection_check_timeout_locked (GstDtlsConnection * self)
 
       end_time = gst_clock_get_time (system_clock) + wait_time * GST_USECOND;
 
+      /* All timeouts are waited for by the single async thread of the system
+       * clock, keep at most one entry per connection in there */
+      gst_dtls_connection_clear_timeout_locked (self);
+
       clock_id = gst_clock_new_single_shot_id (system_clock, end_time);
 #ifndef G_DISABLE_ASSERT
       clock_return =
@@ -402,16 +530,10 @@ gst_dtls_connection_check_timeout_locked (GstDtlsConnection * self)
           gst_clock_id_wait_async (clock_id, schedule_timeout_handling,
           g_object_ref (self), (GDestroyNotify) g_object_unref);
       g_assert (clock_return == GST_CLOCK_OK);
-      gst_clock_id_unref (clock_id);
+      priv->timeout_clock_id = clock_id;
       gst_object_unref (system_clock);
     } else {
-      if (self->priv->is_alive && !self->priv->timeout_pending) {
-        self->priv->timeout_pending = TRUE;
-        GST_TRACE_OBJECT (self, "Schedule timeout now");
-
-        g_thread_pool_push (self->priv->thread_pool, GINT_TO_POINTER (0xc0ffee),
-            NULL);
-      }
+      gst_dtls_connection_push_timeout_locked (self);
     }
   } else {
     GST_DEBUG_OBJECT (self, "no timeout set");
@@ -449,6 +571,7 @@ gst_dtls_connection_stop (GstDtlsConnection * self)
   GST_TRACE_OBJECT (self, "locked @ stop");
 
   self->priv->is_alive = FALSE;
+  gst_dtls_connection_clear_timeout_locked (self);
   GST_TRACE_OBJECT (self, "signaling @ stop");
   g_cond_signal (&self->priv->condition);
   GST_TRACE_OBJECT (self, "signaled @ stop");
@@ -476,6 +599,7 @@ gst_dtls_connection_close (GstDtlsConnection * self)
     self->priv->is_alive = FALSE;
     g_cond_signal (&self->priv->condition);
   }
+  gst_dtls_connection_clear_timeout_locked (self);
 
   GST_TRACE_OBJECT (self, "unlocking @ close");
   g_mutex_unlock (&self->priv->mutex);
@@ -715,6 +839,11 @@ openssl_poll (GstDtlsConnection * self)
   char buf[512];
   int error;
 
+  if (!self->priv->is_alive) {
+    GST_DEBUG_OBJECT (self, "connection is not alive, not polling");
+    return;
+  }
+
   log_state (self, "poll: before handshake");
 
   ret = SSL_do_handshake (self->priv->ssl);
@@ -723,9 +852,42 @@ openssl_poll (GstDtlsConnection * self)
 
   if (ret == 1) {
     if (!self->priv->keys_exported) {
+      if (SSL_session_reused (self->priv->ssl)) {
+        X509 *cert = SSL_get_peer_certificate (self->priv->ssl);
+        gboolean accepted = FALSE;
+
+        /* The verify callback is not called for resumed sessions, let the
+         * peer certificate of the session still be checked */
+        if (cert) {
+          accepted = emit_peer_certificate (self, cert);
+          X509_free (cert);
+        }
+
+        if (!accepted) {
+          GST_WARNING_OBJECT (self, "peer certificate of resumed session "
+              "not accepted, closing connection");
+          /* The handshake already completed here, so unlike for a full
+           * handshake OpenSSL did not send an alert to the peer */
+          SSL_shutdown (self->priv->ssl);
+          handshake_failed (self);
+          return;
+        }
+
+        GST_INFO_OBJECT (self, "session resumed");
+        self->priv->session_resumed = TRUE;
+      }
+
       GST_INFO_OBJECT (self,
           "handshake just completed successfully, exporting keys");
       export_srtp_keys (self);
+
+      if (self->priv->is_client && self->priv->id) {
+        SSL_SESSION *session = SSL_get1_session (self->priv->ssl);
+
+        if (session)
+          _gst_dtls_agent_take_session (self->priv->agent, self->priv->id,
+              session);
+      }
     } else {
       GST_INFO_OBJECT (self, "handshake is completed");
     }
@@ -749,6 +911,8 @@ openssl_poll (GstDtlsConnection * self)
     case SSL_ERROR_SSL:
       GST_LOG_OBJECT (self, "SSL error %d: %s", error,
           ERR_error_string (ERR_get_error (), buf));
+      if (!SSL_is_init_finished (self->priv->ssl))
+        handshake_failed (self);
       break;
     case SSL_ERROR_WANT_READ:
       GST_LOG_OBJECT (self, "SSL wants read");
@@ -765,14 +929,24 @@ openssl_poll (GstDtlsConnection * self)
   }
 }
 
+/* Must be called with the mutex held */
+static void
+handshake_failed (GstDtlsConnection * self)
+{
+  GST_WARNING_OBJECT (self, "handshake failed");
+
+  self->priv->is_alive = FALSE;
+  gst_dtls_connection_clear_timeout_locked (self);
+  g_cond_signal (&self->priv->condition);
+
+  g_signal_emit (self, signals[SIGNAL_ON_HANDSHAKE_FAILED], 0);
+}
+
 static int
 openssl_verify_callback (int preverify_ok, X509_STORE_CTX * x509_ctx)
 {
   GstDtlsConnection *self;
   SSL *ssl;
-  BIO *bio;
-  gchar *pem = NULL;
-  gboolean accepted = FALSE;
 
   ssl =
       X509_STORE_CTX_get_ex_data (x509_ctx,
@@ -780,7 +954,17 @@ openssl_verify_callback (int preverify_ok, X509_STORE_CTX * x509_ctx)
   self = SSL_get_ex_data (ssl, connection_ex_index);
   g_return_val_if_fail (GST_IS_DTLS_CONNECTION (self), FALSE);
 
-  pem = _gst_dtls_x509_to_pem (X509_STORE_CTX_get0_cert (x509_ctx));
+  return emit_peer_certificate (self, X509_STORE_CTX_get0_cert (x509_ctx));
+}
+
+static gboolean
+emit_peer_certificate (GstDtlsConnection * self, X509 * cert)
+{
+  BIO *bio;
+  gchar *pem = NULL;
+  gboolean accepted = FALSE;
+
+  pem = _gst_dtls_x509_to_pem (cert);
 
   if (!pem) {
     GST_WARNING_OBJECT (self,
@@ -792,8 +976,7 @@ openssl_verify_callback (int preverify_ok, X509_STORE_CTX * x509_ctx)
       gint len;
 
       len =
-          X509_NAME_print_ex (bio,
-          X509_get_subject_name (X509_STORE_CTX_get0_cert (x509_ctx)), 1,
+          X509_NAME_print_ex (bio, X509_get_subject_name (cert), 1,
           XN_FLAG_MULTILINE);
       BIO_read (bio, buffer, len);
       buffer[len] = '\0';
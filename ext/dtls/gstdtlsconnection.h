@@ -71,6 +71,8 @@ typedef enum {
  * A class that handles a single DTLS connection.
  * Any connection needs to be created with the agent property set.
  * Once the DTLS handshake is completed, on-encoder-key and on-decoder-key will be signalled.
+ * If the handshake fails, including when the peer certificate of a resumed session is not
+ * accepted, the connection is stopped and on-handshake-failed will be signalled.
  */
 struct _GstDtlsConnection {
     GObject parent_instance;
@@ -52,6 +52,7 @@ G_DEFINE_TYPE_WITH_CODE (GstDtlsDec, gst_dtls_dec, GST_TYPE_ELEMENT,
 enum
 {
   SIGNAL_ON_KEY_RECEIVED,
+  SIGNAL_ON_PEER_CERTIFICATE,
   NUM_SIGNALS
 };
 
@@ -67,6 +68,7 @@ enum
   PROP_DECODER_KEY,
   PROP_SRTP_CIPHER,
   PROP_SRTP_AUTH,
+  PROP_SESSION_RESUMED,
   NUM_PROPERTIES
 };
 
@@ -98,6 +100,7 @@ static void on_key_received (GstDtlsConnection *, gpointer key, guint cipher,
     guint auth, GstDtlsDec *);
 static gboolean on_peer_certificate_received (GstDtlsConnection *, gchar * pem,
     GstDtlsDec *);
+static void on_handshake_failed (GstDtlsConnection *, GstDtlsDec *);
 static GstFlowReturn sink_chain (GstPad *, GstObject * parent, GstBuffer *);
 static GstFlowReturn sink_chain_list (GstPad *, GstObject * parent,
     GstBufferList *);
@@ -131,6 +134,19 @@ gst_dtls_dec_class_init (GstDtlsDecClass * klass)
       G_SIGNAL_RUN_LAST, 0, NULL, NULL,
       g_cclosure_marshal_generic, G_TYPE_NONE, 0);
 
+  /**
+   * GstDtlsDec::on-peer-certificate:
+   * @pem: the certificate of the peer, in PEM format
+   *
+   * Emitted during the handshake to let the application verify the
+   * certificate of the peer. Returning %FALSE fails the handshake. Without
+   * a handler every certificate is accepted.
+   */
+  signals[SIGNAL_ON_PEER_CERTIFICATE] =
+      g_signal_new ("on-peer-certificate", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, g_signal_accumulator_first_wins, NULL,
+      g_cclosure_marshal_generic, G_TYPE_BOOLEAN, 1, G_TYPE_STRING);
+
   properties[PROP_CONNECTION_ID] =
       g_param_spec_string ("connection-id",
       "Connection id",
@@ -171,6 +187,13 @@ gst_dtls_dec_class_init (GstDtlsDecClass * klass)
       0, GST_DTLS_SRTP_AUTH_HMAC_SHA1_80, DEFAULT_SRTP_AUTH,
       G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_SESSION_RESUMED] =
+      g_param_spec_boolean ("session-resumed",
+      "Session resumed",
+      "Whether the handshake resumed a session of an earlier connection "
+      "instead of negotiating a new one",
+      FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, NUM_PROPERTIES, properties);
 
   gst_element_class_add_static_pad_template (element_class, &src_template);
@@ -301,6 +324,13 @@ gst_dtls_dec_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_SRTP_AUTH:
       g_value_set_uint (value, self->srtp_auth);
       break;
+    case PROP_SESSION_RESUMED:
+      if (self->connection)
+        g_object_get_property (G_OBJECT (self->connection), "session-resumed",
+            value);
+      else
+        g_value_set_boolean (value, FALSE);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
@@ -320,6 +350,8 @@ gst_dtls_dec_change_state (GstElement * element, GstStateChange transition)
         g_signal_connect_object (self->connection,
             "on-peer-certificate", G_CALLBACK (on_peer_certificate_received),
             self, 0);
+        g_signal_connect_object (self->connection,
+            "on-handshake-failed", G_CALLBACK (on_handshake_failed), self, 0);
       } else {
         GST_WARNING_OBJECT (self,
             "trying to change state to ready without connection id and pem");
@@ -437,6 +469,8 @@ static gboolean
 on_peer_certificate_received (GstDtlsConnection * connection, gchar * pem,
     GstDtlsDec * self)
 {
+  gboolean accepted = TRUE;
+
   g_return_val_if_fail (GST_IS_DTLS_DEC (self), TRUE);
 
   GST_DEBUG_OBJECT (self, "Received peer certificate PEM: \n%s", pem);
@@ -449,7 +483,24 @@ on_peer_certificate_received (GstDtlsConnection * connection, gchar * pem,
 
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PEER_PEM]);
 
-  return TRUE;
+  if (g_signal_has_handler_pending (self,
+          signals[SIGNAL_ON_PEER_CERTIFICATE], 0, TRUE))
+    g_signal_emit (self, signals[SIGNAL_ON_PEER_CERTIFICATE], 0, pem,
+        &accepted);
+
+  if (!accepted)
+    GST_WARNING_OBJECT (self, "peer certificate rejected");
+
+  return accepted;
+}
+
+static void
+on_handshake_failed (GstDtlsConnection * connection, GstDtlsDec * self)
+{
+  g_return_if_fail (GST_IS_DTLS_DEC (self));
+
+  GST_ELEMENT_ERROR (self, RESOURCE, FAILED, (NULL),
+      ("DTLS handshake of connection '%s' failed", self->connection_id));
 }
 
 static gint
@@ -698,7 +749,8 @@ create_connection (GstDtlsDec * self, gchar * id)
   }
 
   self->connection =
-      g_object_new (GST_TYPE_DTLS_CONNECTION, "agent", self->agent, NULL);
+      g_object_new (GST_TYPE_DTLS_CONNECTION, "agent", self->agent,
+      "connection-id", id, NULL);
 
   g_object_weak_ref (G_OBJECT (self->connection),
       (GWeakNotify) connection_weak_ref_notify, g_strdup (id));
@@ -712,7 +764,10 @@ static void
 connection_weak_ref_notify (gchar * id, GstDtlsConnection * connection)
 {
   G_LOCK (connection_table);
-  g_hash_table_remove (connection_table, id);
+  /* The id might have been taken over by a new connection already if this
+   * one was fetched and then outlived its decoder */
+  if (g_hash_table_lookup (connection_table, id) == connection)
+    g_hash_table_remove (connection_table, id);
   G_UNLOCK (connection_table);
 
   g_free (id);
@@ -32,15 +32,36 @@
 GST_DEBUG_CATEGORY_STATIC (gst_openjpeg_dec_debug);
 #define GST_CAT_DEFAULT gst_openjpeg_dec_debug
 
+enum
+{
+  PROP_0,
+  PROP_MAX_THREADS
+};
+
+#define DEFAULT_MAX_THREADS 0
+
+static void gst_openjpeg_dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_openjpeg_dec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_openjpeg_dec_finalize (GObject * object);
+
 static gboolean gst_openjpeg_dec_start (GstVideoDecoder * decoder);
 static gboolean gst_openjpeg_dec_stop (GstVideoDecoder * decoder);
 static gboolean gst_openjpeg_dec_set_format (GstVideoDecoder * decoder,
     GstVideoCodecState * state);
 static GstFlowReturn gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame);
+static GstFlowReturn gst_openjpeg_dec_finish (GstVideoDecoder * decoder);
+static gboolean gst_openjpeg_dec_flush (GstVideoDecoder * decoder);
 static gboolean gst_openjpeg_dec_decide_allocation (GstVideoDecoder * decoder,
     GstQuery * query);
 
+static void gst_openjpeg_dec_decode_thread (gpointer data, gpointer user_data);
+static void gst_openjpeg_dec_discard_jobs (GstOpenJPEGDec * self);
+static GstFlowReturn gst_openjpeg_dec_push_jobs (GstOpenJPEGDec * self,
+    guint max_pending);
+
 #if G_BYTE_ORDER == G_LITTLE_ENDIAN
 #define GRAY16 "GRAY16_LE"
 #define YUV10 "Y444_10LE, I422_10LE, I420_10LE"
@@ -73,12 +94,25 @@ G_DEFINE_TYPE (GstOpenJPEGDec, gst_openjpeg_dec, GST_TYPE_VIDEO_DECODER);
 static void
 gst_openjpeg_dec_class_init (GstOpenJPEGDecClass * klass)
 {
+  GObjectClass *gobject_class;
   GstElementClass *element_class;
   GstVideoDecoderClass *video_decoder_class;
 
+  gobject_class = (GObjectClass *) klass;
   element_class = (GstElementClass *) klass;
   video_decoder_class = (GstVideoDecoderClass *) klass;
 
+  gobject_class->set_property = gst_openjpeg_dec_set_property;
+  gobject_class->get_property = gst_openjpeg_dec_get_property;
+  gobject_class->finalize = gst_openjpeg_dec_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_int ("max-threads", "Maximum threads",
+          "Maximum number of frames decoded in parallel "
+          "(0 = number of processors, 1 = decode in the streaming thread)",
+          0, G_MAXINT, DEFAULT_MAX_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_static_pad_template (element_class,
       &gst_openjpeg_dec_src_template);
   gst_element_class_add_static_pad_template (element_class,
@@ -96,6 +130,9 @@ gst_openjpeg_dec_class_init (GstOpenJPEGDecClass * klass)
       GST_DEBUG_FUNCPTR (gst_openjpeg_dec_set_format);
   video_decoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_openjpeg_dec_handle_frame);
+  video_decoder_class->finish = GST_DEBUG_FUNCPTR (gst_openjpeg_dec_finish);
+  video_decoder_class->drain = GST_DEBUG_FUNCPTR (gst_openjpeg_dec_finish);
+  video_decoder_class->flush = GST_DEBUG_FUNCPTR (gst_openjpeg_dec_flush);
   video_decoder_class->decide_allocation = gst_openjpeg_dec_decide_allocation;
 
   GST_DEBUG_CATEGORY_INIT (gst_openjpeg_dec_debug, "openjpegdec", 0,
@@ -117,6 +154,54 @@ gst_openjpeg_dec_init (GstOpenJPEGDec * self)
   self->params.cp_limit_decoding = NO_LIMITATION;
 #endif
   self->sampling = GST_JPEG2000_SAMPLING_NONE;
+
+  self->max_threads = DEFAULT_MAX_THREADS;
+  g_mutex_init (&self->decode_lock);
+  g_cond_init (&self->decode_cond);
+  g_queue_init (&self->decode_queue);
+}
+
+static void
+gst_openjpeg_dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (object);
+
+  switch (prop_id) {
+    case PROP_MAX_THREADS:
+      self->max_threads = g_value_get_int (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_openjpeg_dec_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (object);
+
+  switch (prop_id) {
+    case PROP_MAX_THREADS:
+      g_value_set_int (value, self->max_threads);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_openjpeg_dec_finalize (GObject * object)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (object);
+
+  g_mutex_clear (&self->decode_lock);
+  g_cond_clear (&self->decode_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static gboolean
@@ -126,6 +211,30 @@ gst_openjpeg_dec_start (GstVideoDecoder * decoder)
 
   GST_DEBUG_OBJECT (self, "Starting");
 
+#ifdef HAVE_OPENJPEG_1
+  /* OpenJPEG 1.x is not known to be reentrant */
+  self->n_threads = 1;
+#else
+  self->n_threads = self->max_threads;
+  if (self->n_threads == 0)
+    self->n_threads = g_get_num_processors ();
+#endif
+
+  if (self->n_threads > 1) {
+    GError *err = NULL;
+
+    self->decode_pool = g_thread_pool_new (gst_openjpeg_dec_decode_thread,
+        self, self->n_threads, FALSE, &err);
+    if (!self->decode_pool) {
+      GST_WARNING_OBJECT (self, "Failed to create thread pool: %s",
+          err->message);
+      g_clear_error (&err);
+      self->n_threads = 1;
+    }
+  }
+
+  GST_DEBUG_OBJECT (self, "Decoding with %d threads", self->n_threads);
+
   return TRUE;
 }
 
@@ -136,6 +245,12 @@ gst_openjpeg_dec_stop (GstVideoDecoder * video_decoder)
 
   GST_DEBUG_OBJECT (self, "Stopping");
 
+  if (self->decode_pool) {
+    gst_openjpeg_dec_discard_jobs (self);
+    g_thread_pool_free (self->decode_pool, FALSE, TRUE);
+    self->decode_pool = NULL;
+  }
+
   if (self->output_state) {
     gst_video_codec_state_unref (self->output_state);
     self->output_state = NULL;
@@ -160,6 +275,10 @@ gst_openjpeg_dec_set_format (GstVideoDecoder * decoder,
 
   GST_DEBUG_OBJECT (self, "Setting format: %" GST_PTR_FORMAT, state->caps);
 
+  /* Frames still in flight were decoded with the previous settings */
+  if (gst_openjpeg_dec_push_jobs (self, 0) != GST_FLOW_OK)
+    return FALSE;
+
   s = gst_caps_get_structure (state->caps, 0);
 
   self->color_space = OPJ_CLRSPC_UNKNOWN;
@@ -195,6 +314,15 @@ gst_openjpeg_dec_set_format (GstVideoDecoder * decoder,
     gst_video_codec_state_unref (self->input_state);
   self->input_state = gst_video_codec_state_ref (state);
 
+  /* Up to n_threads frames are held back while they are decoded */
+  if (self->decode_pool && state->info.fps_n > 0) {
+    GstClockTime latency;
+
+    latency = gst_util_uint64_scale (self->n_threads * GST_SECOND,
+        state->info.fps_d, state->info.fps_n);
+    gst_video_decoder_set_latency (decoder, latency, latency);
+  }
+
   return TRUE;
 }
 
@@ -205,93 +333,157 @@ reverse_rgb_channels (GstJPEG2000Sampling sampling)
       || sampling == GST_JPEG2000_SAMPLING_BGRA;
 }
 
-static void
-fill_frame_packed8_4 (GstVideoFrame * frame, opj_image_t * image)
+/* The converters work row by row on contiguous arrays with only simple
+ * arithmetic in the inner loops so that the compiler can vectorize them */
+static inline void
+convert_row_8 (guint8 * dst, const gint * src, gint n, gint off)
 {
-  gint x, y, w, h, c;
-  guint8 *data_out, *tmp;
-  const gint *data_in[4];
-  gint dstride;
-  gint off[4];
+  gint x;
 
-  w = GST_VIDEO_FRAME_WIDTH (frame);
-  h = GST_VIDEO_FRAME_HEIGHT (frame);
-  data_out = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  for (x = 0; x < n; x++)
+    dst[x] = off + src[x];
+}
+
+static inline void
+convert_row_16 (guint16 * dst, const gint * src, gint n, gint off, gint shift)
+{
+  gint x;
 
-  for (c = 0; c < 4; c++) {
-    data_in[c] = image->comps[c].data;
-    off[c] = 0x80 * image->comps[c].sgnd;
+  for (x = 0; x < n; x++)
+    dst[x] = off + (src[x] << shift);
+}
+
+static inline void
+interleave_row_8 (guint8 * dst, const gint * src[4], const gint off[4],
+    gint n)
+{
+  const gint *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+  gint x;
+
+  for (x = 0; x < n; x++) {
+    dst[4 * x + 0] = off[0] + s0[x];
+    dst[4 * x + 1] = off[1] + s1[x];
+    dst[4 * x + 2] = off[2] + s2[x];
+    dst[4 * x + 3] = off[3] + s3[x];
   }
+}
 
-  for (y = 0; y < h; y++) {
-    tmp = data_out;
+static inline void
+interleave_row_16 (guint16 * dst, const gint * src[4], const gint off[4],
+    const gint shift[4], gint n)
+{
+  const gint *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+  gint x;
+
+  for (x = 0; x < n; x++) {
+    dst[4 * x + 0] = off[0] + (s0[x] << shift[0]);
+    dst[4 * x + 1] = off[1] + (s1[x] << shift[1]);
+    dst[4 * x + 2] = off[2] + (s2[x] << shift[2]);
+    dst[4 * x + 3] = off[3] + (s3[x] << shift[3]);
+  }
+}
 
-    for (x = 0; x < w; x++) {
-      /* alpha, from 4'th input channel */
-      tmp[0] = off[3] + *data_in[3];
-      /* colour channels */
-      tmp[1] = off[0] + *data_in[0];
-      tmp[2] = off[1] + *data_in[1];
-      tmp[3] = off[2] + *data_in[2];
-
-      tmp += 4;
-      data_in[0]++;
-      data_in[1]++;
-      data_in[2]++;
-      data_in[3]++;
-    }
-    data_out += dstride;
+static inline void
+upsample_row (gint * dst, const gint * src, gint n, gint dx)
+{
+  gint x, k;
+
+  for (x = 0; x < n; src++) {
+    for (k = 0; k < dx && x < n; k++, x++)
+      dst[x] = *src;
   }
 }
 
+/* Fills a frame with four 8 or 16 bit components per pixel from the image
+ * components comp[0..3]. Sub-sampled components are upsampled, a component
+ * of -1 is set to the constant alpha */
 static void
-fill_frame_packed16_4 (GstVideoFrame * frame, opj_image_t * image)
+fill_packed4 (GstVideoFrame * frame, opj_image_t * image, const gint comp[4],
+    gboolean words, gint alpha)
 {
-  gint x, y, w, h, c;
-  guint16 *data_out, *tmp;
-  const gint *data_in[4];
-  gint dstride;
-  gint shift[4], off[4];
+  gint i, y, w, h, dstride;
+  guint8 *data_out;
+  const gint *src[4];
+  gint off[4], shift[4], last_row[4];
+  gint *tmp, *zero;
 
   w = GST_VIDEO_FRAME_WIDTH (frame);
   h = GST_VIDEO_FRAME_HEIGHT (frame);
   data_out = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0) / 2;
+  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
 
-  for (c = 0; c < 4; c++) {
-    data_in[c] = image->comps[c].data;
-    off[c] = (1 << (image->comps[c].prec - 1)) * image->comps[c].sgnd;
-    shift[c] =
-        MAX (MIN (GST_VIDEO_FRAME_COMP_DEPTH (frame, c) - image->comps[c].prec,
-            8), 0);
+  /* one scratch row per component for upsampling plus a row of zeroes */
+  tmp = g_new0 (gint, 5 * w);
+  zero = tmp + 4 * w;
+
+  for (i = 0; i < 4; i++) {
+    gint c = comp[i];
+
+    last_row[i] = -1;
+    shift[i] = 0;
+    if (c < 0) {
+      off[i] = alpha;
+      src[i] = zero;
+    } else if (words) {
+      off[i] = (1 << (image->comps[c].prec - 1)) * image->comps[c].sgnd;
+      shift[i] = MAX (MIN (GST_VIDEO_FRAME_COMP_DEPTH (frame, c) -
+              image->comps[c].prec, 8), 0);
+    } else {
+      off[i] = 0x80 * image->comps[c].sgnd;
+    }
   }
 
   for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      /* alpha, from 4'th input channel */
-      tmp[0] = off[3] + (*data_in[3] << shift[3]);
-      /* colour channels */
-      tmp[1] = off[0] + (*data_in[0] << shift[0]);
-      tmp[2] = off[1] + (*data_in[1] << shift[1]);
-      tmp[3] = off[2] + (*data_in[2] << shift[2]);
-
-      tmp += 4;
-      data_in[0]++;
-      data_in[1]++;
-      data_in[2]++;
-      data_in[3]++;
+    for (i = 0; i < 4; i++) {
+      gint c = comp[i];
+      gint row;
+      const gint *data_in;
+
+      if (c < 0)
+        continue;
+
+      row = y / image->comps[c].dy;
+      data_in = image->comps[c].data + row * image->comps[c].w;
+      if (image->comps[c].dx == 1) {
+        src[i] = data_in;
+      } else if (row != last_row[i]) {
+        upsample_row (tmp + i * w, data_in, w, image->comps[c].dx);
+        src[i] = tmp + i * w;
+        last_row[i] = row;
+      }
     }
+
+    if (words)
+      interleave_row_16 ((guint16 *) data_out, src, off, shift, w);
+    else
+      interleave_row_8 (data_out, src, off, w);
     data_out += dstride;
   }
+
+  g_free (tmp);
+}
+
+static void
+fill_frame_packed8_4 (GstVideoFrame * frame, opj_image_t * image)
+{
+  /* alpha from the 4'th input channel, then the colour channels */
+  static const gint comp[4] = { 3, 0, 1, 2 };
+
+  fill_packed4 (frame, image, comp, FALSE, 0);
+}
+
+static void
+fill_frame_packed16_4 (GstVideoFrame * frame, opj_image_t * image)
+{
+  static const gint comp[4] = { 3, 0, 1, 2 };
+
+  fill_packed4 (frame, image, comp, TRUE, 0);
 }
 
 static void
 fill_frame_packed8_3 (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h, c;
+  gint x, y, w, h;
   guint8 *data_out, *tmp;
   const gint *data_in[3];
   gint dstride;
@@ -302,23 +494,22 @@ fill_frame_packed8_3 (GstVideoFrame * frame, opj_image_t * image)
   data_out = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
   dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
 
-  for (c = 0; c < 3; c++) {
-    data_in[c] = image->comps[c].data;
-    off[c] = 0x80 * image->comps[c].sgnd;
-  };
+  for (x = 0; x < 3; x++) {
+    data_in[x] = image->comps[x].data;
+    off[x] = 0x80 * image->comps[x].sgnd;
+  }
 
   for (y = 0; y < h; y++) {
     tmp = data_out;
 
     for (x = 0; x < w; x++) {
-      tmp[0] = off[0] + *data_in[0];
-      tmp[1] = off[1] + *data_in[1];
-      tmp[2] = off[2] + *data_in[2];
-      data_in[0]++;
-      data_in[1]++;
-      data_in[2]++;
-      tmp += 3;
+      tmp[3 * x + 0] = off[0] + data_in[0][x];
+      tmp[3 * x + 1] = off[1] + data_in[1][x];
+      tmp[3 * x + 2] = off[2] + data_in[2][x];
     }
+    data_in[0] += w;
+    data_in[1] += w;
+    data_in[2] += w;
     data_out += dstride;
   }
 }
@@ -326,127 +517,36 @@ fill_frame_packed8_3 (GstVideoFrame * frame, opj_image_t * image)
 static void
 fill_frame_packed16_3 (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h, c;
-  guint16 *data_out, *tmp;
-  const gint *data_in[3];
-  gint dstride;
-  gint shift[3], off[3];
+  /* opaque alpha */
+  static const gint comp[4] = { -1, 0, 1, 2 };
 
-  w = GST_VIDEO_FRAME_WIDTH (frame);
-  h = GST_VIDEO_FRAME_HEIGHT (frame);
-  data_out = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0) / 2;
-
-  for (c = 0; c < 3; c++) {
-    data_in[c] = image->comps[c].data;
-    off[c] = (1 << (image->comps[c].prec - 1)) * image->comps[c].sgnd;
-    shift[c] =
-        MAX (MIN (GST_VIDEO_FRAME_COMP_DEPTH (frame, c) - image->comps[c].prec,
-            8), 0);
-  }
-
-  for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      tmp[1] = off[0] + (*data_in[0] << shift[0]);
-      tmp[2] = off[1] + (*data_in[1] << shift[1]);
-      tmp[3] = off[2] + (*data_in[2] << shift[2]);
-
-      tmp += 4;
-      data_in[0]++;
-      data_in[1]++;
-      data_in[2]++;
-    }
-    data_out += dstride;
-  }
+  fill_packed4 (frame, image, comp, TRUE, 0xffff);
 }
 
 /* for grayscale with alpha */
 static void
 fill_frame_packed8_2 (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h, c;
-  guint8 *data_out, *tmp;
-  const gint *data_in[2];
-  gint dstride;
-  gint off[2];
+  /* alpha from the 2nd input channel, luminance from the first */
+  static const gint comp[4] = { 1, 0, 0, 0 };
 
-  w = GST_VIDEO_FRAME_WIDTH (frame);
-  h = GST_VIDEO_FRAME_HEIGHT (frame);
-  data_out = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
-
-  for (c = 0; c < 2; c++) {
-    data_in[c] = image->comps[c].data;
-    off[c] = 0x80 * image->comps[c].sgnd;
-  };
-
-  for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      /* alpha, from 2nd input channel */
-      tmp[0] = off[1] + *data_in[1];
-      /* luminance, from first input channel */
-      tmp[1] = off[0] + *data_in[0];
-      tmp[2] = tmp[1];
-      tmp[3] = tmp[1];
-      data_in[0]++;
-      data_in[1]++;
-      tmp += 4;
-    }
-    data_out += dstride;
-  }
+  fill_packed4 (frame, image, comp, FALSE, 0);
 }
 
 /* for grayscale with alpha */
 static void
 fill_frame_packed16_2 (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h, c;
-  guint16 *data_out, *tmp;
-  const gint *data_in[2];
-  gint dstride;
-  gint shift[2], off[2];
-
-  w = GST_VIDEO_FRAME_WIDTH (frame);
-  h = GST_VIDEO_FRAME_HEIGHT (frame);
-  data_out = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0) / 2;
+  static const gint comp[4] = { 1, 0, 0, 0 };
 
-  for (c = 0; c < 2; c++) {
-    data_in[c] = image->comps[c].data;
-    off[c] = (1 << (image->comps[c].prec - 1)) * image->comps[c].sgnd;
-    shift[c] =
-        MAX (MIN (GST_VIDEO_FRAME_COMP_DEPTH (frame, c) - image->comps[c].prec,
-            8), 0);
-  }
-
-  for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      /* alpha, from 2nd input channel */
-      tmp[0] = off[1] + (*data_in[1] << shift[1]);
-      /* luminance, from first input channel  */
-      tmp[1] = off[0] + (*data_in[0] << shift[0]);
-      tmp[2] = tmp[1];
-      tmp[3] = tmp[1];
-      tmp += 4;
-      data_in[0]++;
-      data_in[1]++;
-    }
-    data_out += dstride;
-  }
+  fill_packed4 (frame, image, comp, TRUE, 0);
 }
 
-
 static void
 fill_frame_planar8_1 (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h;
-  guint8 *data_out, *tmp;
+  gint y, w, h;
+  guint8 *data_out;
   const gint *data_in;
   gint dstride;
   gint off;
@@ -460,14 +560,8 @@ fill_frame_planar8_1 (GstVideoFrame * frame, opj_image_t * image)
   off = 0x80 * image->comps[0].sgnd;
 
   for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      *tmp = off + *data_in;
-
-      tmp++;
-      data_in++;
-    }
+    convert_row_8 (data_out, data_in, w, off);
+    data_in += w;
     data_out += dstride;
   }
 }
@@ -475,8 +569,8 @@ fill_frame_planar8_1 (GstVideoFrame * frame, opj_image_t * image)
 static void
 fill_frame_planar16_1 (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h;
-  guint16 *data_out, *tmp;
+  gint y, w, h;
+  guint16 *data_out;
   const gint *data_in;
   gint dstride;
   gint shift, off;
@@ -494,14 +588,8 @@ fill_frame_planar16_1 (GstVideoFrame * frame, opj_image_t * image)
           8), 0);
 
   for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      *tmp = off + (*data_in << shift);
-
-      tmp++;
-      data_in++;
-    }
+    convert_row_16 (data_out, data_in, w, off, shift);
+    data_in += w;
     data_out += dstride;
   }
 }
@@ -509,8 +597,8 @@ fill_frame_planar16_1 (GstVideoFrame * frame, opj_image_t * image)
 static void
 fill_frame_planar8_3 (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint c, x, y, w, h;
-  guint8 *data_out, *tmp;
+  gint c, y, w, h;
+  guint8 *data_out;
   const gint *data_in;
   gint dstride, off;
 
@@ -523,13 +611,8 @@ fill_frame_planar8_3 (GstVideoFrame * frame, opj_image_t * image)
     off = 0x80 * image->comps[c].sgnd;
 
     for (y = 0; y < h; y++) {
-      tmp = data_out;
-
-      for (x = 0; x < w; x++) {
-        *tmp = off + *data_in;
-        tmp++;
-        data_in++;
-      }
+      convert_row_8 (data_out, data_in, w, off);
+      data_in += w;
       data_out += dstride;
     }
   }
@@ -538,8 +621,8 @@ fill_frame_planar8_3 (GstVideoFrame * frame, opj_image_t * image)
 static void
 fill_frame_planar16_3 (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint c, x, y, w, h;
-  guint16 *data_out, *tmp;
+  gint c, y, w, h;
+  guint16 *data_out;
   const gint *data_in;
   gint dstride;
   gint shift, off;
@@ -556,13 +639,8 @@ fill_frame_planar16_3 (GstVideoFrame * frame, opj_image_t * image)
             8), 0);
 
     for (y = 0; y < h; y++) {
-      tmp = data_out;
-
-      for (x = 0; x < w; x++) {
-        *tmp = off + (*data_in << shift);
-        tmp++;
-        data_in++;
-      }
+      convert_row_16 (data_out, data_in, w, off, shift);
+      data_in += w;
       data_out += dstride;
     }
   }
@@ -571,147 +649,33 @@ fill_frame_planar16_3 (GstVideoFrame * frame, opj_image_t * image)
 static void
 fill_frame_planar8_3_generic (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h, c;
-  guint8 *data_out, *tmp;
-  const gint *data_in[3];
-  gint dstride;
-  gint dx[3], dy[3], off[3];
-
-  w = GST_VIDEO_FRAME_WIDTH (frame);
-  h = GST_VIDEO_FRAME_HEIGHT (frame);
-  data_out = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
-
-  for (c = 0; c < 3; c++) {
-    data_in[c] = image->comps[c].data;
-    dx[c] = image->comps[c].dx;
-    dy[c] = image->comps[c].dy;
-    off[c] = 0x80 * image->comps[c].sgnd;
-  }
-
-  for (y = 0; y < h; y++) {
-    tmp = data_out;
+  static const gint comp[4] = { -1, 0, 1, 2 };
 
-    for (x = 0; x < w; x++) {
-      tmp[0] = 0xff;
-      tmp[1] = off[0] + data_in[0][((y / dy[0]) * w + x) / dx[0]];
-      tmp[2] = off[1] + data_in[1][((y / dy[1]) * w + x) / dx[1]];
-      tmp[3] = off[2] + data_in[2][((y / dy[2]) * w + x) / dx[2]];
-      tmp += 4;
-    }
-    data_out += dstride;
-  }
+  fill_packed4 (frame, image, comp, FALSE, 0xff);
 }
 
 static void
 fill_frame_planar8_4_generic (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h, c;
-  guint8 *data_out, *tmp;
-  const gint *data_in[4];
-  gint dstride;
-  gint dx[4], dy[4], off[4];
-
-  w = GST_VIDEO_FRAME_WIDTH (frame);
-  h = GST_VIDEO_FRAME_HEIGHT (frame);
-  data_out = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
-
-  for (c = 0; c < 4; c++) {
-    data_in[c] = image->comps[c].data;
-    dx[c] = image->comps[c].dx;
-    dy[c] = image->comps[c].dy;
-    off[c] = 0x80 * image->comps[c].sgnd;
-  }
+  static const gint comp[4] = { 3, 0, 1, 2 };
 
-  for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      tmp[0] = off[3] + data_in[3][((y / dy[3]) * w + x) / dx[3]];
-      tmp[1] = off[0] + data_in[0][((y / dy[0]) * w + x) / dx[0]];
-      tmp[2] = off[1] + data_in[1][((y / dy[1]) * w + x) / dx[1]];
-      tmp[3] = off[2] + data_in[2][((y / dy[2]) * w + x) / dx[2]];
-      tmp += 4;
-    }
-    data_out += dstride;
-  }
+  fill_packed4 (frame, image, comp, FALSE, 0);
 }
 
 static void
 fill_frame_planar16_3_generic (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h, c;
-  guint16 *data_out, *tmp;
-  const gint *data_in[3];
-  gint dstride;
-  gint dx[3], dy[3], shift[3], off[3];
+  static const gint comp[4] = { -1, 0, 1, 2 };
 
-  w = GST_VIDEO_FRAME_WIDTH (frame);
-  h = GST_VIDEO_FRAME_HEIGHT (frame);
-  data_out = (guint16 *) GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0) / 2;
-
-  for (c = 0; c < 3; c++) {
-    dx[c] = image->comps[c].dx;
-    dy[c] = image->comps[c].dy;
-    data_in[c] = image->comps[c].data;
-    off[c] = (1 << (image->comps[c].prec - 1)) * image->comps[c].sgnd;
-    shift[c] =
-        MAX (MIN (GST_VIDEO_FRAME_COMP_DEPTH (frame, c) - image->comps[c].prec,
-            8), 0);
-  }
-
-  for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      tmp[0] = 0xff;
-      tmp[1] = off[0] + (data_in[0][((y / dy[0]) * w + x) / dx[0]] << shift[0]);
-      tmp[2] = off[1] + (data_in[1][((y / dy[1]) * w + x) / dx[1]] << shift[1]);
-      tmp[3] = off[2] + (data_in[2][((y / dy[2]) * w + x) / dx[2]] << shift[2]);
-      tmp += 4;
-    }
-    data_out += dstride;
-  }
+  fill_packed4 (frame, image, comp, TRUE, 0xff);
 }
 
 static void
 fill_frame_planar16_4_generic (GstVideoFrame * frame, opj_image_t * image)
 {
-  gint x, y, w, h, c;
-  guint16 *data_out, *tmp;
-  const gint *data_in[4];
-  gint dstride;
-  gint dx[4], dy[4], shift[4], off[4];
-
-  w = GST_VIDEO_FRAME_WIDTH (frame);
-  h = GST_VIDEO_FRAME_HEIGHT (frame);
-  data_out = (guint16 *) GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
-  dstride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0) / 2;
-
-  for (c = 0; c < 4; c++) {
-    dx[c] = image->comps[c].dx;
-    dy[c] = image->comps[c].dy;
-    data_in[c] = image->comps[c].data;
-    off[c] = (1 << (image->comps[c].prec - 1)) * image->comps[c].sgnd;
-    shift[c] =
-        MAX (MIN (GST_VIDEO_FRAME_COMP_DEPTH (frame, c) - image->comps[c].prec,
-            8), 0);
-  }
+  static const gint comp[4] = { 3, 0, 1, 2 };
 
-  for (y = 0; y < h; y++) {
-    tmp = data_out;
-
-    for (x = 0; x < w; x++) {
-      tmp[0] = off[3] + (data_in[3][((y / dy[3]) * w + x) / dx[3]] << shift[3]);
-      tmp[1] = off[0] + (data_in[0][((y / dy[0]) * w + x) / dx[0]] << shift[0]);
-      tmp[2] = off[1] + (data_in[1][((y / dy[1]) * w + x) / dx[1]] << shift[1]);
-      tmp[3] = off[2] + (data_in[2][((y / dy[2]) * w + x) / dx[2]] << shift[2]);
-      tmp += 4;
-    }
-    data_out += dstride;
-  }
+  fill_packed4 (frame, image, comp, TRUE, 0);
 }
 
 static gint
@@ -1046,13 +1010,38 @@ seek_fn (OPJ_OFF_T p_nb_bytes, void *p_user_data)
 }
 #endif
 
-static GstFlowReturn
-gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
-    GstVideoCodecFrame * frame)
+typedef enum
 {
-  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (decoder);
-  GstFlowReturn ret = GST_FLOW_OK;
-  gint64 deadline;
+  DECODE_OK,
+  DECODE_INIT_ERROR,
+  DECODE_MAP_ERROR,
+  DECODE_OPEN_ERROR,
+  DECODE_ERROR
+} DecodeResult;
+
+/* One frame to decode. The decoding only uses the fields of the job so that
+ * it can run in the thread pool while the streaming thread goes on. Anything
+ * that interacts with the base class is done in order in the streaming
+ * thread once the job is done */
+typedef struct
+{
+  GstOpenJPEGDec *self;
+  GstVideoCodecFrame *frame;
+
+  OPJ_CODEC_FORMAT codec_format;
+  gboolean is_jp2c;
+  opj_dparameters_t params;
+
+  /* set when decoding is done, protected by decode_lock */
+  gboolean done;
+  DecodeResult result;
+  opj_image_t *image;
+} DecodeJob;
+
+static void
+gst_openjpeg_dec_decode_job (DecodeJob * job)
+{
+  GstOpenJPEGDec *self = job->self;
   GstMapInfo map;
 #ifdef HAVE_OPENJPEG_1
   opj_dinfo_t *dec;
@@ -1062,24 +1051,15 @@ gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
   opj_stream_t *stream;
   MemStream mstream;
 #endif
-  opj_image_t *image;
-  GstVideoFrame vframe;
-  opj_dparameters_t params;
-
-  GST_DEBUG_OBJECT (self, "Handling frame");
+  opj_image_t *image = NULL;
+  gint i;
 
-  deadline = gst_video_decoder_get_max_decode_time (decoder, frame);
-  if (deadline < 0) {
-    GST_LOG_OBJECT (self, "Dropping too late frame: deadline %" G_GINT64_FORMAT,
-        deadline);
-    ret = gst_video_decoder_drop_frame (decoder, frame);
-    return ret;
+  dec = opj_create_decompress (job->codec_format);
+  if (!dec) {
+    job->result = DECODE_INIT_ERROR;
+    return;
   }
 
-  dec = opj_create_decompress (self->codec_format);
-  if (!dec)
-    goto initialization_error;
-
 #ifdef HAVE_OPENJPEG_1
   if (G_UNLIKELY (gst_debug_category_get_threshold (GST_CAT_DEFAULT) >=
           GST_LEVEL_TRACE)) {
@@ -1105,34 +1085,37 @@ gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
   }
 #endif
 
-  params = self->params;
-  if (self->ncomps)
-    params.jpwl_exp_comps = self->ncomps;
-  opj_setup_decoder (dec, &params);
-
-  if (!gst_buffer_map (frame->input_buffer, &map, GST_MAP_READ))
-    goto map_read_error;
+  opj_setup_decoder (dec, &job->params);
 
-  if (self->is_jp2c && map.size < 8)
-    goto open_error;
+  if (!gst_buffer_map (job->frame->input_buffer, &map, GST_MAP_READ)) {
+    job->result = DECODE_MAP_ERROR;
+    goto done;
+  }
 
+  if (job->is_jp2c && map.size < 8) {
+    job->result = DECODE_OPEN_ERROR;
+    goto unmap;
+  }
 #ifdef HAVE_OPENJPEG_1
-  io = opj_cio_open ((opj_common_ptr) dec, map.data + (self->is_jp2c ? 8 : 0),
-      map.size - (self->is_jp2c ? 8 : 0));
-  if (!io)
-    goto open_error;
+  io = opj_cio_open ((opj_common_ptr) dec, map.data + (job->is_jp2c ? 8 : 0),
+      map.size - (job->is_jp2c ? 8 : 0));
+  if (!io) {
+    job->result = DECODE_OPEN_ERROR;
+    goto unmap;
+  }
 
   image = opj_decode (dec, io);
-  if (!image)
-    goto decode_error;
+  opj_cio_close (io);
 #else
   stream = opj_stream_create (4096, OPJ_TRUE);
-  if (!stream)
-    goto open_error;
+  if (!stream) {
+    job->result = DECODE_OPEN_ERROR;
+    goto unmap;
+  }
 
-  mstream.data = map.data + (self->is_jp2c ? 8 : 0);
+  mstream.data = map.data + (job->is_jp2c ? 8 : 0);
   mstream.offset = 0;
-  mstream.size = map.size - (self->is_jp2c ? 8 : 0);
+  mstream.size = map.size - (job->is_jp2c ? 8 : 0);
 
   opj_stream_set_read_function (stream, read_fn);
   opj_stream_set_write_function (stream, write_fn);
@@ -1141,24 +1124,76 @@ gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
   opj_stream_set_user_data (stream, &mstream, NULL);
   opj_stream_set_user_data_length (stream, mstream.size);
 
-  image = NULL;
-  if (!opj_read_header (stream, dec, &image))
-    goto decode_error;
-
-  if (!opj_decode (dec, stream, image))
-    goto decode_error;
+  if (opj_read_header (stream, dec, &image)
+      && opj_decode (dec, stream, image)) {
+    opj_end_decompress (dec, stream);
+  } else if (image) {
+    opj_image_destroy (image);
+    image = NULL;
+  }
+  opj_stream_destroy (stream);
 #endif
 
-  {
-    gint i;
-
-    for (i = 0; i < image->numcomps; i++) {
-      if (image->comps[i].data == NULL)
-        goto decode_error;
+  for (i = 0; image && i < image->numcomps; i++) {
+    if (image->comps[i].data == NULL) {
+      opj_image_destroy (image);
+      image = NULL;
     }
   }
 
-  gst_buffer_unmap (frame->input_buffer, &map);
+  job->image = image;
+  job->result = image ? DECODE_OK : DECODE_ERROR;
+
+unmap:
+  gst_buffer_unmap (job->frame->input_buffer, &map);
+done:
+#ifdef HAVE_OPENJPEG_1
+  opj_destroy_decompress (dec);
+#else
+  opj_destroy_codec (dec);
+#endif
+}
+
+static void
+gst_openjpeg_dec_decode_thread (gpointer data, gpointer user_data)
+{
+  DecodeJob *job = data;
+  GstOpenJPEGDec *self = user_data;
+
+  gst_openjpeg_dec_decode_job (job);
+
+  g_mutex_lock (&self->decode_lock);
+  job->done = TRUE;
+  g_cond_broadcast (&self->decode_cond);
+  g_mutex_unlock (&self->decode_lock);
+}
+
+/* Converts the decoded image of the job into an output buffer and finishes
+ * the frame. Takes ownership of the job */
+static GstFlowReturn
+gst_openjpeg_dec_finish_job (GstOpenJPEGDec * self, DecodeJob * job)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstVideoCodecFrame *frame = job->frame;
+  opj_image_t *image = job->image;
+  DecodeResult result = job->result;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstVideoFrame vframe;
+
+  g_slice_free (DecodeJob, job);
+
+  switch (result) {
+    case DECODE_OK:
+      break;
+    case DECODE_INIT_ERROR:
+      goto initialization_error;
+    case DECODE_MAP_ERROR:
+      goto map_read_error;
+    case DECODE_OPEN_ERROR:
+      goto open_error;
+    case DECODE_ERROR:
+      goto decode_error;
+  }
 
   ret = gst_openjpeg_dec_negotiate (self, image);
   if (ret != GST_FLOW_OK)
@@ -1176,16 +1211,7 @@ gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
 
   gst_video_frame_unmap (&vframe);
 
-#ifdef HAVE_OPENJPEG_1
-  opj_cio_close (io);
   opj_image_destroy (image);
-  opj_destroy_decompress (dec);
-#else
-  opj_end_decompress (dec, stream);
-  opj_stream_destroy (stream);
-  opj_image_destroy (image);
-  opj_destroy_codec (dec);
-#endif
 
   ret = gst_video_decoder_finish_frame (decoder, frame);
 
@@ -1200,11 +1226,6 @@ initialization_error:
   }
 map_read_error:
   {
-#ifdef HAVE_OPENJPEG_1
-    opj_destroy_decompress (dec);
-#else
-    opj_destroy_codec (dec);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, CORE, FAILED,
@@ -1213,12 +1234,6 @@ map_read_error:
   }
 open_error:
   {
-#ifdef HAVE_OPENJPEG_1
-    opj_destroy_decompress (dec);
-#else
-    opj_destroy_codec (dec);
-#endif
-    gst_buffer_unmap (frame->input_buffer, &map);
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, LIBRARY, INIT,
@@ -1227,16 +1242,6 @@ open_error:
   }
 decode_error:
   {
-    if (image)
-      opj_image_destroy (image);
-#ifdef HAVE_OPENJPEG_1
-    opj_cio_close (io);
-    opj_destroy_decompress (dec);
-#else
-    opj_stream_destroy (stream);
-    opj_destroy_codec (dec);
-#endif
-    gst_buffer_unmap (frame->input_buffer, &map);
     gst_video_codec_frame_unref (frame);
 
     GST_VIDEO_DECODER_ERROR (self, 1, STREAM, DECODE,
@@ -1246,13 +1251,6 @@ decode_error:
 negotiate_error:
   {
     opj_image_destroy (image);
-#ifdef HAVE_OPENJPEG_1
-    opj_cio_close (io);
-    opj_destroy_decompress (dec);
-#else
-    opj_stream_destroy (stream);
-    opj_destroy_codec (dec);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, CORE, NEGOTIATION,
@@ -1262,13 +1260,6 @@ negotiate_error:
 allocate_error:
   {
     opj_image_destroy (image);
-#ifdef HAVE_OPENJPEG_1
-    opj_cio_close (io);
-    opj_destroy_decompress (dec);
-#else
-    opj_stream_destroy (stream);
-    opj_destroy_codec (dec);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, CORE, FAILED,
@@ -1278,13 +1269,6 @@ allocate_error:
 map_write_error:
   {
     opj_image_destroy (image);
-#ifdef HAVE_OPENJPEG_1
-    opj_cio_close (io);
-    opj_destroy_decompress (dec);
-#else
-    opj_stream_destroy (stream);
-    opj_destroy_codec (dec);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, CORE, FAILED,
@@ -1293,6 +1277,126 @@ map_write_error:
   }
 }
 
+/* Finishes the decoded jobs at the head of the queue in order until at most
+ * max_pending jobs are left, waiting for the thread pool if needed */
+static GstFlowReturn
+gst_openjpeg_dec_push_jobs (GstOpenJPEGDec * self, guint max_pending)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  DecodeJob *job;
+
+  g_mutex_lock (&self->decode_lock);
+  while (ret == GST_FLOW_OK
+      && (job = g_queue_peek_head (&self->decode_queue)) != NULL) {
+    if (!job->done) {
+      if (self->decode_queue.length <= max_pending)
+        break;
+      g_cond_wait (&self->decode_cond, &self->decode_lock);
+      continue;
+    }
+
+    g_queue_pop_head (&self->decode_queue);
+    g_mutex_unlock (&self->decode_lock);
+    ret = gst_openjpeg_dec_finish_job (self, job);
+    g_mutex_lock (&self->decode_lock);
+  }
+  g_mutex_unlock (&self->decode_lock);
+
+  return ret;
+}
+
+/* Waits for all queued jobs and drops their frames */
+static void
+gst_openjpeg_dec_discard_jobs (GstOpenJPEGDec * self)
+{
+  DecodeJob *job;
+
+  g_mutex_lock (&self->decode_lock);
+  while ((job = g_queue_pop_head (&self->decode_queue)) != NULL) {
+    while (!job->done)
+      g_cond_wait (&self->decode_cond, &self->decode_lock);
+    g_mutex_unlock (&self->decode_lock);
+
+    if (job->image)
+      opj_image_destroy (job->image);
+    gst_video_decoder_release_frame (GST_VIDEO_DECODER (self), job->frame);
+    g_slice_free (DecodeJob, job);
+
+    g_mutex_lock (&self->decode_lock);
+  }
+  g_mutex_unlock (&self->decode_lock);
+}
+
+static GstFlowReturn
+gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
+    GstVideoCodecFrame * frame)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (decoder);
+  GstFlowReturn ret = GST_FLOW_OK;
+  gint64 deadline;
+  DecodeJob *job;
+
+  GST_DEBUG_OBJECT (self, "Handling frame");
+
+  deadline = gst_video_decoder_get_max_decode_time (decoder, frame);
+  if (deadline < 0) {
+    GST_LOG_OBJECT (self, "Dropping too late frame: deadline %" G_GINT64_FORMAT,
+        deadline);
+    /* keep the output in order */
+    ret = gst_openjpeg_dec_push_jobs (self, 0);
+    if (ret != GST_FLOW_OK) {
+      gst_video_codec_frame_unref (frame);
+      return ret;
+    }
+    ret = gst_video_decoder_drop_frame (decoder, frame);
+    return ret;
+  }
+
+  job = g_slice_new0 (DecodeJob);
+  job->self = self;
+  job->frame = frame;
+  job->codec_format = self->codec_format;
+  job->is_jp2c = self->is_jp2c;
+  job->params = self->params;
+  if (self->ncomps)
+    job->params.jpwl_exp_comps = self->ncomps;
+
+  if (!self->decode_pool) {
+    gst_openjpeg_dec_decode_job (job);
+    return gst_openjpeg_dec_finish_job (self, job);
+  }
+
+  g_mutex_lock (&self->decode_lock);
+  g_queue_push_tail (&self->decode_queue, job);
+  g_mutex_unlock (&self->decode_lock);
+  g_thread_pool_push (self->decode_pool, job, NULL);
+
+  /* Keep all threads busy but don't queue up more frames than that */
+  return gst_openjpeg_dec_push_jobs (self, self->n_threads);
+}
+
+static GstFlowReturn
+gst_openjpeg_dec_finish (GstVideoDecoder * decoder)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (decoder);
+
+  GST_DEBUG_OBJECT (self, "Draining");
+
+  return gst_openjpeg_dec_push_jobs (self, 0);
+}
+
+static gboolean
+gst_openjpeg_dec_flush (GstVideoDecoder * decoder)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (decoder);
+
+  GST_DEBUG_OBJECT (self, "Flushing");
+
+  gst_openjpeg_dec_discard_jobs (self);
+
+  return TRUE;
+}
+
 static gboolean
 gst_openjpeg_dec_decide_allocation (GstVideoDecoder * decoder, GstQuery * query)
 {
@@ -61,6 +61,15 @@ struct _GstOpenJPEGDec
   void (*fill_frame) (GstVideoFrame *frame, opj_image_t * image);
 
   opj_dparameters_t params;
+
+  /* Frame-parallel decoding: frames are decoded by decode_pool and finished
+   * in order from decode_queue */
+  gint max_threads;
+  gint n_threads;
+  GThreadPool *decode_pool;
+  GMutex decode_lock;
+  GCond decode_cond;
+  GQueue decode_queue;
 };
 
 struct _GstOpenJPEGDecClass
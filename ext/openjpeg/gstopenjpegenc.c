@@ -66,7 +66,11 @@ enum
   PROP_TILE_OFFSET_X,
   PROP_TILE_OFFSET_Y,
   PROP_TILE_WIDTH,
-  PROP_TILE_HEIGHT
+  PROP_TILE_HEIGHT,
+  PROP_MAX_THREADS,
+  PROP_NUM_STRIPES,
+  PROP_SOP_MARKERS,
+  PROP_EPH_MARKERS
 };
 
 #define DEFAULT_NUM_LAYERS 1
@@ -76,11 +80,20 @@ enum
 #define DEFAULT_TILE_OFFSET_Y 0
 #define DEFAULT_TILE_WIDTH 0
 #define DEFAULT_TILE_HEIGHT 0
+#define DEFAULT_MAX_THREADS 0
+#define DEFAULT_NUM_STRIPES 1
+#define DEFAULT_SOP_MARKERS FALSE
+#define DEFAULT_EPH_MARKERS FALSE
+
+/* Coding style flags of the COD marker, not exported by OpenJPEG */
+#define CODING_STYLE_SOP 0x02
+#define CODING_STYLE_EPH 0x04
 
 static void gst_openjpeg_enc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_openjpeg_enc_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
+static void gst_openjpeg_enc_finalize (GObject * object);
 
 static gboolean gst_openjpeg_enc_start (GstVideoEncoder * encoder);
 static gboolean gst_openjpeg_enc_stop (GstVideoEncoder * encoder);
@@ -88,9 +101,16 @@ static gboolean gst_openjpeg_enc_set_format (GstVideoEncoder * encoder,
     GstVideoCodecState * state);
 static GstFlowReturn gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
     GstVideoCodecFrame * frame);
+static GstFlowReturn gst_openjpeg_enc_finish (GstVideoEncoder * encoder);
+static gboolean gst_openjpeg_enc_flush (GstVideoEncoder * encoder);
 static gboolean gst_openjpeg_enc_propose_allocation (GstVideoEncoder * encoder,
     GstQuery * query);
 
+static void gst_openjpeg_enc_encode_thread (gpointer data, gpointer user_data);
+static void gst_openjpeg_enc_discard_jobs (GstOpenJPEGEnc * self);
+static GstFlowReturn gst_openjpeg_enc_push_jobs (GstOpenJPEGEnc * self,
+    guint max_pending);
+
 #if G_BYTE_ORDER == G_LITTLE_ENDIAN
 #define GRAY16 "GRAY16_LE"
 #define YUV10 "Y444_10LE, I422_10LE, I420_10LE"
@@ -105,7 +125,7 @@ GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ ARGB64, ARGB, xRGB, "
             "AYUV64, " YUV10 ", "
-            "AYUV, Y444, Y42B, I420, Y41B, YUV9, " "GRAY8, " GRAY16 " }"))
+            "AYUV, A420, Y444, Y42B, I420, Y41B, YUV9, " "GRAY8, " GRAY16 " }"))
     );
 
 static GstStaticPadTemplate gst_openjpeg_enc_src_template =
@@ -143,6 +163,7 @@ gst_openjpeg_enc_class_init (GstOpenJPEGEncClass * klass)
 
   gobject_class->set_property = gst_openjpeg_enc_set_property;
   gobject_class->get_property = gst_openjpeg_enc_get_property;
+  gobject_class->finalize = gst_openjpeg_enc_finalize;
 
   g_object_class_install_property (gobject_class, PROP_NUM_LAYERS,
       g_param_spec_int ("num-layers", "Number of layers",
@@ -180,6 +201,31 @@ gst_openjpeg_enc_class_init (GstOpenJPEGEncClass * klass)
           "Tile Height", 0, G_MAXINT, DEFAULT_TILE_HEIGHT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_int ("max-threads", "Maximum threads",
+          "Maximum number of frames or stripes encoded in parallel "
+          "(0 = number of processors, 1 = encode in the streaming thread)",
+          0, G_MAXINT, DEFAULT_MAX_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_NUM_STRIPES,
+      g_param_spec_int ("num-stripes", "Number of stripes",
+          "Number of horizontal stripes per frame that are encoded in "
+          "parallel as separate tiles (1 = no stripes, ignored for "
+          "image/jp2 and when tiles are configured)",
+          1, 65535, DEFAULT_NUM_STRIPES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SOP_MARKERS,
+      g_param_spec_boolean ("sop-markers", "SOP markers",
+          "Write a start of packet marker before every packet",
+          DEFAULT_SOP_MARKERS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_EPH_MARKERS,
+      g_param_spec_boolean ("eph-markers", "EPH markers",
+          "Write an end of packet header marker after every packet header",
+          DEFAULT_EPH_MARKERS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_static_pad_template (element_class,
       &gst_openjpeg_enc_src_template);
   gst_element_class_add_static_pad_template (element_class,
@@ -197,6 +243,8 @@ gst_openjpeg_enc_class_init (GstOpenJPEGEncClass * klass)
       GST_DEBUG_FUNCPTR (gst_openjpeg_enc_set_format);
   video_encoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_openjpeg_enc_handle_frame);
+  video_encoder_class->finish = GST_DEBUG_FUNCPTR (gst_openjpeg_enc_finish);
+  video_encoder_class->flush = GST_DEBUG_FUNCPTR (gst_openjpeg_enc_flush);
   video_encoder_class->propose_allocation = gst_openjpeg_enc_propose_allocation;
 
   GST_DEBUG_CATEGORY_INIT (gst_openjpeg_enc_debug, "openjpegenc", 0,
@@ -217,7 +265,6 @@ gst_openjpeg_enc_init (GstOpenJPEGEnc * self)
   /*
    * TODO: Add properties / caps fields for these
    *
-   * self->params.csty;
    * self->params.tcp_rates;
    * self->params.tcp_distoratio;
    * self->params.mode;
@@ -235,6 +282,12 @@ gst_openjpeg_enc_init (GstOpenJPEGEnc * self)
   self->params.cp_tdy = DEFAULT_TILE_HEIGHT;
   self->params.tile_size_on = (self->params.cp_tdx != 0
       && self->params.cp_tdy != 0);
+
+  self->max_threads = DEFAULT_MAX_THREADS;
+  self->num_stripes = DEFAULT_NUM_STRIPES;
+  g_mutex_init (&self->encode_lock);
+  g_cond_init (&self->encode_cond);
+  g_queue_init (&self->encode_queue);
 }
 
 static void
@@ -269,6 +322,24 @@ gst_openjpeg_enc_set_property (GObject * object, guint prop_id,
       self->params.tile_size_on = (self->params.cp_tdx != 0
           && self->params.cp_tdy != 0);
       break;
+    case PROP_MAX_THREADS:
+      self->max_threads = g_value_get_int (value);
+      break;
+    case PROP_NUM_STRIPES:
+      self->num_stripes = g_value_get_int (value);
+      break;
+    case PROP_SOP_MARKERS:
+      if (g_value_get_boolean (value))
+        self->params.csty |= CODING_STYLE_SOP;
+      else
+        self->params.csty &= ~CODING_STYLE_SOP;
+      break;
+    case PROP_EPH_MARKERS:
+      if (g_value_get_boolean (value))
+        self->params.csty |= CODING_STYLE_EPH;
+      else
+        self->params.csty &= ~CODING_STYLE_EPH;
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -303,12 +374,35 @@ gst_openjpeg_enc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_TILE_HEIGHT:
       g_value_set_int (value, self->params.cp_tdy);
       break;
+    case PROP_MAX_THREADS:
+      g_value_set_int (value, self->max_threads);
+      break;
+    case PROP_NUM_STRIPES:
+      g_value_set_int (value, self->num_stripes);
+      break;
+    case PROP_SOP_MARKERS:
+      g_value_set_boolean (value, ! !(self->params.csty & CODING_STYLE_SOP));
+      break;
+    case PROP_EPH_MARKERS:
+      g_value_set_boolean (value, ! !(self->params.csty & CODING_STYLE_EPH));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static void
+gst_openjpeg_enc_finalize (GObject * object)
+{
+  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (object);
+
+  g_mutex_clear (&self->encode_lock);
+  g_cond_clear (&self->encode_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static gboolean
 gst_openjpeg_enc_start (GstVideoEncoder * encoder)
 {
@@ -316,6 +410,30 @@ gst_openjpeg_enc_start (GstVideoEncoder * encoder)
 
   GST_DEBUG_OBJECT (self, "Starting");
 
+#ifdef HAVE_OPENJPEG_1
+  /* OpenJPEG 1.x is not known to be reentrant */
+  self->n_threads = 1;
+#else
+  self->n_threads = self->max_threads;
+  if (self->n_threads == 0)
+    self->n_threads = g_get_num_processors ();
+#endif
+
+  if (self->n_threads > 1) {
+    GError *err = NULL;
+
+    self->encode_pool = g_thread_pool_new (gst_openjpeg_enc_encode_thread,
+        self, self->n_threads, FALSE, &err);
+    if (!self->encode_pool) {
+      GST_WARNING_OBJECT (self, "Failed to create thread pool: %s",
+          err->message);
+      g_clear_error (&err);
+      self->n_threads = 1;
+    }
+  }
+
+  GST_DEBUG_OBJECT (self, "Encoding with %d threads", self->n_threads);
+
   return TRUE;
 }
 
@@ -326,6 +444,12 @@ gst_openjpeg_enc_stop (GstVideoEncoder * video_encoder)
 
   GST_DEBUG_OBJECT (self, "Stopping");
 
+  if (self->encode_pool) {
+    gst_openjpeg_enc_discard_jobs (self);
+    g_thread_pool_free (self->encode_pool, FALSE, TRUE);
+    self->encode_pool = NULL;
+  }
+
   if (self->output_state) {
     gst_video_codec_state_unref (self->output_state);
     self->output_state = NULL;
@@ -476,15 +600,16 @@ fill_image_planar16_3 (opj_image_t * image, GstVideoFrame * frame)
   }
 }
 
+/* Also used for A420, whose alpha plane becomes the fourth component */
 static void
-fill_image_planar8_3 (opj_image_t * image, GstVideoFrame * frame)
+fill_image_planar8 (opj_image_t * image, GstVideoFrame * frame)
 {
   gint c, x, y, w, h;
   const guint8 *data_in, *tmp;
   gint *data_out;
   gint sstride;
 
-  for (c = 0; c < 3; c++) {
+  for (c = 0; c < image->numcomps; c++) {
     w = GST_VIDEO_FRAME_COMP_WIDTH (frame, c);
     h = GST_VIDEO_FRAME_COMP_HEIGHT (frame, c);
     data_in = GST_VIDEO_FRAME_COMP_DATA (frame, c);
@@ -566,6 +691,9 @@ gst_openjpeg_enc_set_format (GstVideoEncoder * encoder,
 
   GST_DEBUG_OBJECT (self, "Setting format: %" GST_PTR_FORMAT, state->caps);
 
+  /* Frames still in flight were encoded with the previous settings */
+  gst_openjpeg_enc_push_jobs (self, 0);
+
   if (self->input_state)
     gst_video_codec_state_unref (self->input_state);
   self->input_state = gst_video_codec_state_ref (state);
@@ -618,9 +746,13 @@ gst_openjpeg_enc_set_format (GstVideoEncoder * encoder,
     case GST_VIDEO_FORMAT_I420:
     case GST_VIDEO_FORMAT_Y41B:
     case GST_VIDEO_FORMAT_YUV9:
-      self->fill_image = fill_image_planar8_3;
+      self->fill_image = fill_image_planar8;
       ncomps = 3;
       break;
+    case GST_VIDEO_FORMAT_A420:
+      self->fill_image = fill_image_planar8;
+      ncomps = 4;
+      break;
     case GST_VIDEO_FORMAT_GRAY8:
       self->fill_image = fill_image_planar8_1;
       ncomps = 1;
@@ -674,6 +806,7 @@ gst_openjpeg_enc_set_format (GstVideoEncoder * encoder,
       sampling = GST_JPEG2000_SAMPLING_GRAYSCALE;
       break;
     default:
+      /* no sampling describes A420, only image/jp2 can carry it */
       break;
   }
 
@@ -701,6 +834,41 @@ gst_openjpeg_enc_set_format (GstVideoEncoder * encoder,
   }
   gst_caps_unref (allowed_caps);
 
+  /* Each stripe is encoded as one full width tile of the frame */
+  self->n_stripes = 1;
+  self->stripe_height = GST_VIDEO_INFO_HEIGHT (&state->info);
+  if (self->num_stripes > 1) {
+    if (self->codec_format == OPJ_CODEC_JP2) {
+      GST_WARNING_OBJECT (self, "Stripes are not supported for image/jp2");
+    } else if (self->params.tile_size_on) {
+      GST_WARNING_OBJECT (self, "Stripes can't be combined with tiles");
+    } else {
+      /* a multiple of the vertical sub-sampling of all formats and high
+       * enough for the number of resolutions */
+      guint align = MAX (16, 1 << (self->params.numresolution - 1));
+
+      self->stripe_height =
+          (self->stripe_height + self->num_stripes - 1) / self->num_stripes;
+      self->stripe_height =
+          (self->stripe_height + align - 1) / align * align;
+      self->n_stripes =
+          (GST_VIDEO_INFO_HEIGHT (&state->info) + self->stripe_height - 1) /
+          self->stripe_height;
+    }
+  }
+  GST_DEBUG_OBJECT (self, "Encoding %u stripes of %u lines", self->n_stripes,
+      self->stripe_height);
+
+  /* Up to n_threads / n_stripes frames are held back while they are
+   * encoded */
+  if (self->encode_pool && state->info.fps_n > 0) {
+    GstClockTime latency;
+
+    latency = gst_util_uint64_scale ((self->n_threads / self->n_stripes) *
+        GST_SECOND, state->info.fps_d, state->info.fps_n);
+    gst_video_encoder_set_latency (encoder, latency, latency);
+  }
+
   if (self->output_state)
     gst_video_codec_state_unref (self->output_state);
   self->output_state =
@@ -711,8 +879,58 @@ gst_openjpeg_enc_set_format (GstVideoEncoder * encoder,
   return TRUE;
 }
 
+typedef enum
+{
+  ENCODE_OK,
+  ENCODE_INIT_ERROR,
+  ENCODE_FILL_ERROR,
+  ENCODE_OPEN_ERROR,
+  ENCODE_ERROR
+} EncodeResult;
+
+typedef struct _EncodeFrame EncodeFrame;
+
+/* A horizontal stripe of a frame, encoded as a codestream of its own */
+typedef struct
+{
+  EncodeFrame *job;
+  guint index;
+
+  EncodeResult result;
+  guint8 *data;
+  gsize size;
+  gsize tiles_offset;
+} EncodeStripe;
+
+/* One frame to encode. The stripes only use the fields of the job so that
+ * they can be encoded in the thread pool while the streaming thread goes
+ * on. Anything that interacts with the base class is done in order in the
+ * streaming thread once all stripes are done */
+struct _EncodeFrame
+{
+  GstOpenJPEGEnc *self;
+  GstVideoCodecFrame *frame;
+  GstVideoFrame vframe;
+
+  OPJ_CODEC_FORMAT codec_format;
+  gboolean is_jp2c;
+  opj_cparameters_t params;
+  void (*fill_image) (opj_image_t * image, GstVideoFrame * frame);
+
+  guint width, height;
+  guint n_stripes, stripe_height;
+  EncodeStripe *stripes;
+
+  /* protected by encode_lock */
+  guint n_pending;
+};
+
+/* Creates an image of the stripe of the frame starting at row y0. frame
+ * only covers the stripe, y0 places the image on the reference grid of the
+ * whole frame */
 static opj_image_t *
-gst_openjpeg_enc_fill_image (GstOpenJPEGEnc * self, GstVideoFrame * frame)
+gst_openjpeg_enc_fill_image (EncodeFrame * job, GstVideoFrame * frame,
+    guint y0)
 {
   gint i, ncomps;
   opj_image_cmptparm_t *comps;
@@ -723,15 +941,17 @@ gst_openjpeg_enc_fill_image (GstOpenJPEGEnc * self, GstVideoFrame * frame)
   comps = g_new0 (opj_image_cmptparm_t, ncomps);
 
   for (i = 0; i < ncomps; i++) {
+    gint w_sub = GST_VIDEO_FORMAT_INFO_W_SUB (frame->info.finfo, i);
+    gint h_sub = GST_VIDEO_FORMAT_INFO_H_SUB (frame->info.finfo, i);
+
     comps[i].prec = GST_VIDEO_FRAME_COMP_DEPTH (frame, i);
     comps[i].bpp = GST_VIDEO_FRAME_COMP_DEPTH (frame, i);
     comps[i].sgnd = 0;
     comps[i].w = GST_VIDEO_FRAME_COMP_WIDTH (frame, i);
     comps[i].h = GST_VIDEO_FRAME_COMP_HEIGHT (frame, i);
-    comps[i].dx =
-        GST_VIDEO_FRAME_WIDTH (frame) / GST_VIDEO_FRAME_COMP_WIDTH (frame, i);
-    comps[i].dy =
-        GST_VIDEO_FRAME_HEIGHT (frame) / GST_VIDEO_FRAME_COMP_HEIGHT (frame, i);
+    comps[i].dx = 1 << w_sub;
+    comps[i].dy = 1 << h_sub;
+    comps[i].y0 = y0 >> h_sub;
   }
 
   if ((frame->info.finfo->flags & GST_VIDEO_FORMAT_FLAG_YUV))
@@ -746,11 +966,12 @@ gst_openjpeg_enc_fill_image (GstOpenJPEGEnc * self, GstVideoFrame * frame)
   image = opj_image_create (ncomps, comps, colorspace);
   g_free (comps);
 
-  image->x0 = image->y0 = 0;
+  image->x0 = 0;
+  image->y0 = y0;
   image->x1 = GST_VIDEO_FRAME_WIDTH (frame);
-  image->y1 = GST_VIDEO_FRAME_HEIGHT (frame);
+  image->y1 = y0 + GST_VIDEO_FRAME_HEIGHT (frame);
 
-  self->fill_image (image, frame);
+  job->fill_image (image, frame);
 
   return image;
 }
@@ -851,16 +1072,16 @@ seek_fn (OPJ_OFF_T p_nb_bytes, void *p_user_data)
 }
 #endif
 
-static GstFlowReturn
-gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
-    GstVideoCodecFrame * frame)
+static void
+gst_openjpeg_enc_encode_stripe (EncodeStripe * stripe)
 {
-  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (encoder);
-  GstFlowReturn ret = GST_FLOW_OK;
+  EncodeFrame *job = stripe->job;
+  GstOpenJPEGEnc *self = job->self;
+  opj_cparameters_t params = job->params;
+  GstVideoFrame vframe = job->vframe;
+  guint y0 = 0;
 #ifdef HAVE_OPENJPEG_1
   opj_cinfo_t *enc;
-  GstMapInfo map;
-  guint length;
   opj_cio_t *io;
 #else
   opj_codec_t *enc;
@@ -868,14 +1089,36 @@ gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
   MemStream mstream;
 #endif
   opj_image_t *image;
-  GstVideoFrame vframe;
 
-  GST_DEBUG_OBJECT (self, "Handling frame");
+  if (job->n_stripes > 1) {
+    guint i;
+
+    y0 = stripe->index * job->stripe_height;
 
-  enc = opj_create_compress (self->codec_format);
-  if (!enc)
-    goto initialization_error;
+    /* view on the rows of the stripe */
+    for (i = 0; i < GST_VIDEO_FRAME_N_COMPONENTS (&vframe); i++) {
+      gint plane = GST_VIDEO_FRAME_COMP_PLANE (&vframe, i);
+      gint h_sub = GST_VIDEO_FORMAT_INFO_H_SUB (vframe.info.finfo, i);
 
+      vframe.data[plane] = (guint8 *) job->vframe.data[plane] +
+          (y0 >> h_sub) * GST_VIDEO_FRAME_PLANE_STRIDE (&vframe, plane);
+    }
+    vframe.info.height = MIN (job->stripe_height, job->height - y0);
+
+    /* a single tile covering exactly the stripe. The tile of the shorter
+     * last stripe starts above the image so that it has the nominal tile
+     * height, the tile data only depends on the intersection with the
+     * image */
+    params.tile_size_on = FALSE;
+    params.cp_tx0 = 0;
+    params.cp_ty0 = y0 + vframe.info.height - job->stripe_height;
+  }
+
+  enc = opj_create_compress (job->codec_format);
+  if (!enc) {
+    stripe->result = ENCODE_INIT_ERROR;
+    return;
+  }
 #ifdef HAVE_OPENJPEG_1
   if (G_UNLIKELY (gst_debug_category_get_threshold (GST_CAT_DEFAULT) >=
           GST_LEVEL_TRACE)) {
@@ -901,53 +1144,35 @@ gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
   }
 #endif
 
-  if (!gst_video_frame_map (&vframe, &self->input_state->info,
-          frame->input_buffer, GST_MAP_READ))
-    goto map_read_error;
-
-  image = gst_openjpeg_enc_fill_image (self, &vframe);
-  if (!image)
-    goto fill_image_error;
-  gst_video_frame_unmap (&vframe);
-
-  if (vframe.info.finfo->flags & GST_VIDEO_FORMAT_FLAG_RGB) {
-    self->params.tcp_mct = 1;
+  image = gst_openjpeg_enc_fill_image (job, &vframe, y0);
+  if (!image) {
+    stripe->result = ENCODE_FILL_ERROR;
+    goto done;
   }
-  opj_setup_encoder (enc, &self->params, image);
+
+  opj_setup_encoder (enc, &params, image);
 
 #ifdef HAVE_OPENJPEG_1
   io = opj_cio_open ((opj_common_ptr) enc, NULL, 0);
-  if (!io)
-    goto open_error;
-
-  if (!opj_encode (enc, io, image, NULL))
-    goto encode_error;
-
-  opj_image_destroy (image);
-
-  length = cio_tell (io);
-
-  ret =
-      gst_video_encoder_allocate_output_frame (encoder, frame,
-      length + (self->is_jp2c ? 8 : 0));
-  if (ret != GST_FLOW_OK)
-    goto allocate_error;
+  if (!io) {
+    stripe->result = ENCODE_OPEN_ERROR;
+    goto destroy_image;
+  }
 
-  gst_buffer_fill (frame->output_buffer, self->is_jp2c ? 8 : 0, io->buffer,
-      length);
-  if (self->is_jp2c) {
-    gst_buffer_map (frame->output_buffer, &map, GST_MAP_WRITE);
-    GST_WRITE_UINT32_BE (map.data, length + 8);
-    GST_WRITE_UINT32_BE (map.data + 4, GST_MAKE_FOURCC ('j', 'p', '2', 'c'));
-    gst_buffer_unmap (frame->output_buffer, &map);
+  if (opj_encode (enc, io, image, NULL)) {
+    stripe->size = cio_tell (io);
+    stripe->data = g_memdup (io->buffer, stripe->size);
+  } else {
+    stripe->result = ENCODE_ERROR;
   }
 
   opj_cio_close (io);
-  opj_destroy_compress (enc);
 #else
   stream = opj_stream_create (4096, OPJ_FALSE);
-  if (!stream)
-    goto open_error;
+  if (!stream) {
+    stripe->result = ENCODE_OPEN_ERROR;
+    goto destroy_image;
+  }
 
   mstream.allocsize = 4096;
   mstream.data = g_malloc (mstream.allocsize);
@@ -961,42 +1186,218 @@ gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
   opj_stream_set_user_data (stream, &mstream, NULL);
   opj_stream_set_user_data_length (stream, mstream.size);
 
-  if (!opj_start_compress (enc, image, stream))
-    goto encode_error;
-
-  if (!opj_encode (enc, stream))
-    goto encode_error;
+  if (opj_start_compress (enc, image, stream) && opj_encode (enc, stream)
+      && opj_end_compress (enc, stream)) {
+    stripe->data = mstream.data;
+    stripe->size = mstream.size;
+  } else {
+    g_free (mstream.data);
+    stripe->result = ENCODE_ERROR;
+  }
 
-  if (!opj_end_compress (enc, stream))
-    goto encode_error;
+  opj_stream_destroy (stream);
+#endif
 
+destroy_image:
   opj_image_destroy (image);
-  opj_stream_destroy (stream);
+done:
+#ifdef HAVE_OPENJPEG_1
+  opj_destroy_compress (enc);
+#else
   opj_destroy_codec (enc);
+#endif
+}
+
+static void
+gst_openjpeg_enc_encode_thread (gpointer data, gpointer user_data)
+{
+  EncodeStripe *stripe = data;
+  GstOpenJPEGEnc *self = user_data;
+
+  gst_openjpeg_enc_encode_stripe (stripe);
+
+  g_mutex_lock (&self->encode_lock);
+  if (--stripe->job->n_pending == 0)
+    g_cond_broadcast (&self->encode_cond);
+  g_mutex_unlock (&self->encode_lock);
+}
+
+/* Joins the single-tile codestreams of all stripes of a frame into one
+ * codestream with one tile per stripe. The stripes were encoded on the
+ * reference grid of the whole frame so their tile data can be used as is,
+ * only the SIZ marker of the first stripe is rewritten for the whole frame
+ * and the tile index of every tile-part is updated */
+static gboolean
+gst_openjpeg_enc_join_stripes (EncodeFrame * job, guint8 ** data, gsize * size)
+{
+  const guint8 *first = job->stripes[0].data;
+  gsize first_size = job->stripes[0].size;
+  gsize header_size, offset, total;
+  guint8 *out;
+  guint i;
+
+  /* main header: SOC, SIZ and everything else until the first SOT */
+  if (first_size < 2 + 40 || GST_READ_UINT16_BE (first) != 0xff4f
+      || GST_READ_UINT16_BE (first + 2) != 0xff51)
+    return FALSE;
+
+  header_size = 2;
+  while (header_size + 4 <= first_size
+      && GST_READ_UINT16_BE (first + header_size) != 0xff90)
+    header_size += 2 + GST_READ_UINT16_BE (first + header_size + 2);
+  if (header_size + 4 > first_size)
+    return FALSE;
+
+  /* the tile-parts of each stripe without the main header and EOC */
+  total = header_size + 2;
+  for (i = 0; i < job->n_stripes; i++) {
+    EncodeStripe *stripe = &job->stripes[i];
+
+    if (stripe->size < 4
+        || GST_READ_UINT16_BE (stripe->data + stripe->size - 2) != 0xffd9)
+      return FALSE;
+
+    stripe->tiles_offset = 2;
+    while (stripe->tiles_offset + 4 <= stripe->size
+        && GST_READ_UINT16_BE (stripe->data + stripe->tiles_offset) != 0xff90)
+      stripe->tiles_offset +=
+          2 + GST_READ_UINT16_BE (stripe->data + stripe->tiles_offset + 2);
+    if (stripe->tiles_offset + 4 > stripe->size - 2)
+      return FALSE;
+
+    total += stripe->size - 2 - stripe->tiles_offset;
+  }
+
+  out = g_malloc (total);
+  memcpy (out, first, header_size);
+
+  /* Xsiz, Ysiz, XOsiz, YOsiz, XTsiz, YTsiz, XTOsiz, YTOsiz */
+  GST_WRITE_UINT32_BE (out + 8, job->width);
+  GST_WRITE_UINT32_BE (out + 12, job->height);
+  GST_WRITE_UINT32_BE (out + 16, 0);
+  GST_WRITE_UINT32_BE (out + 20, 0);
+  GST_WRITE_UINT32_BE (out + 24, job->width);
+  GST_WRITE_UINT32_BE (out + 28, job->stripe_height);
+  GST_WRITE_UINT32_BE (out + 32, 0);
+  GST_WRITE_UINT32_BE (out + 36, 0);
+
+  offset = header_size;
+  for (i = 0; i < job->n_stripes; i++) {
+    EncodeStripe *stripe = &job->stripes[i];
+    gsize end = stripe->size - 2;
+    gsize pos = stripe->tiles_offset;
+
+    memcpy (out + offset, stripe->data + pos, end - pos);
+
+    /* SOT: Lsot, Isot, Psot, TPsot, TNsot */
+    while (pos < end) {
+      guint32 psot;
+
+      if (pos + 12 > end
+          || GST_READ_UINT16_BE (stripe->data + pos) != 0xff90) {
+        g_free (out);
+        return FALSE;
+      }
+
+      /* a zero Psot extends until EOC, which is only valid for the last
+       * tile-part of the whole codestream */
+      psot = GST_READ_UINT32_BE (stripe->data + pos + 6);
+      if (psot == 0)
+        psot = end - pos;
+      else if (psot < 12 || psot > end - pos) {
+        g_free (out);
+        return FALSE;
+      }
+      GST_WRITE_UINT16_BE (out + offset + 4, i);
+      GST_WRITE_UINT32_BE (out + offset + 6, psot);
+
+      pos += psot;
+      offset += psot;
+    }
+  }
+
+  GST_WRITE_UINT16_BE (out + offset, 0xffd9);
+  offset += 2;
+  g_assert (offset == total);
+
+  *data = out;
+  *size = total;
+
+  return TRUE;
+}
+
+static void
+gst_openjpeg_enc_free_job (EncodeFrame * job)
+{
+  guint i;
+
+  for (i = 0; i < job->n_stripes; i++)
+    g_free (job->stripes[i].data);
+  g_free (job->stripes);
+  gst_video_frame_unmap (&job->vframe);
+  g_slice_free (EncodeFrame, job);
+}
+
+/* Puts the encoded stripes of the job into the output buffer and finishes
+ * the frame. Takes ownership of the job */
+static GstFlowReturn
+gst_openjpeg_enc_finish_job (GstOpenJPEGEnc * self, EncodeFrame * job)
+{
+  GstVideoCodecFrame *frame = job->frame;
+  gboolean is_jp2c = job->is_jp2c;
+  EncodeResult result = ENCODE_OK;
+  guint8 *data = NULL;
+  gsize size = 0;
+  guint i;
+
+  for (i = 0; i < job->n_stripes && result == ENCODE_OK; i++)
+    result = job->stripes[i].result;
+
+  if (result == ENCODE_OK) {
+    if (job->n_stripes == 1) {
+      data = job->stripes[0].data;
+      size = job->stripes[0].size;
+      job->stripes[0].data = NULL;
+    } else if (!gst_openjpeg_enc_join_stripes (job, &data, &size)) {
+      result = ENCODE_ERROR;
+    }
+  }
+
+  gst_openjpeg_enc_free_job (job);
+
+  switch (result) {
+    case ENCODE_OK:
+      break;
+    case ENCODE_INIT_ERROR:
+      goto initialization_error;
+    case ENCODE_FILL_ERROR:
+      goto fill_image_error;
+    case ENCODE_OPEN_ERROR:
+      goto open_error;
+    case ENCODE_ERROR:
+      goto encode_error;
+  }
 
   frame->output_buffer = gst_buffer_new ();
 
-  if (self->is_jp2c) {
+  if (is_jp2c) {
     GstMapInfo map;
     GstMemory *mem;
 
     mem = gst_allocator_alloc (NULL, 8, NULL);
     gst_memory_map (mem, &map, GST_MAP_WRITE);
-    GST_WRITE_UINT32_BE (map.data, mstream.size + 8);
+    GST_WRITE_UINT32_BE (map.data, size + 8);
     GST_WRITE_UINT32_BE (map.data + 4, GST_MAKE_FOURCC ('j', 'p', '2', 'c'));
     gst_memory_unmap (mem, &map);
     gst_buffer_append_memory (frame->output_buffer, mem);
   }
 
   gst_buffer_append_memory (frame->output_buffer,
-      gst_memory_new_wrapped (0, mstream.data, mstream.allocsize, 0,
-          mstream.size, NULL, (GDestroyNotify) g_free));
-#endif
+      gst_memory_new_wrapped (0, data, size, 0, size, data,
+          (GDestroyNotify) g_free));
 
   GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
-  ret = gst_video_encoder_finish_frame (encoder, frame);
-
-  return ret;
+  return gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (self), frame);
 
 initialization_error:
   {
@@ -1005,27 +1406,8 @@ initialization_error:
         ("Failed to initialize OpenJPEG encoder"), (NULL));
     return GST_FLOW_ERROR;
   }
-map_read_error:
-  {
-#ifdef HAVE_OPENJPEG_1
-    opj_destroy_compress (enc);
-#else
-    opj_destroy_codec (enc);
-#endif
-    gst_video_codec_frame_unref (frame);
-
-    GST_ELEMENT_ERROR (self, CORE, FAILED,
-        ("Failed to map input buffer"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 fill_image_error:
   {
-#ifdef HAVE_OPENJPEG_1
-    opj_destroy_compress (enc);
-#else
-    opj_destroy_codec (enc);
-#endif
-    gst_video_frame_unmap (&vframe);
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, LIBRARY, INIT,
@@ -1034,12 +1416,6 @@ fill_image_error:
   }
 open_error:
   {
-    opj_image_destroy (image);
-#ifdef HAVE_OPENJPEG_1
-    opj_destroy_compress (enc);
-#else
-    opj_destroy_codec (enc);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, LIBRARY, INIT,
@@ -1048,34 +1424,142 @@ open_error:
   }
 encode_error:
   {
-#ifdef HAVE_OPENJPEG_1
-    opj_cio_close (io);
-    opj_image_destroy (image);
-    opj_destroy_compress (enc);
-#else
-    opj_stream_destroy (stream);
-    g_free (mstream.data);
-    opj_image_destroy (image);
-    opj_destroy_codec (enc);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, STREAM, ENCODE,
         ("Failed to encode OpenJPEG stream"), (NULL));
     return GST_FLOW_ERROR;
   }
-#ifdef HAVE_OPENJPEG_1
-allocate_error:
+}
+
+/* Finishes the encoded jobs at the head of the queue in order until at most
+ * max_pending jobs are left, waiting for the thread pool if needed */
+static GstFlowReturn
+gst_openjpeg_enc_push_jobs (GstOpenJPEGEnc * self, guint max_pending)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  EncodeFrame *job;
+
+  g_mutex_lock (&self->encode_lock);
+  while (ret == GST_FLOW_OK
+      && (job = g_queue_peek_head (&self->encode_queue)) != NULL) {
+    if (job->n_pending > 0) {
+      if (self->encode_queue.length <= max_pending)
+        break;
+      g_cond_wait (&self->encode_cond, &self->encode_lock);
+      continue;
+    }
+
+    g_queue_pop_head (&self->encode_queue);
+    g_mutex_unlock (&self->encode_lock);
+    ret = gst_openjpeg_enc_finish_job (self, job);
+    g_mutex_lock (&self->encode_lock);
+  }
+  g_mutex_unlock (&self->encode_lock);
+
+  return ret;
+}
+
+/* Waits for all queued jobs and drops their frames */
+static void
+gst_openjpeg_enc_discard_jobs (GstOpenJPEGEnc * self)
+{
+  EncodeFrame *job;
+
+  g_mutex_lock (&self->encode_lock);
+  while ((job = g_queue_pop_head (&self->encode_queue)) != NULL) {
+    while (job->n_pending > 0)
+      g_cond_wait (&self->encode_cond, &self->encode_lock);
+    g_mutex_unlock (&self->encode_lock);
+
+    gst_video_codec_frame_unref (job->frame);
+    gst_openjpeg_enc_free_job (job);
+
+    g_mutex_lock (&self->encode_lock);
+  }
+  g_mutex_unlock (&self->encode_lock);
+}
+
+static GstFlowReturn
+gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
+    GstVideoCodecFrame * frame)
+{
+  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (encoder);
+  EncodeFrame *job;
+  guint i;
+
+  GST_DEBUG_OBJECT (self, "Handling frame");
+
+  job = g_slice_new0 (EncodeFrame);
+  if (!gst_video_frame_map (&job->vframe, &self->input_state->info,
+          frame->input_buffer, GST_MAP_READ))
+    goto map_read_error;
+
+  job->self = self;
+  job->frame = frame;
+  job->codec_format = self->codec_format;
+  job->is_jp2c = self->is_jp2c;
+  job->params = self->params;
+  if (job->vframe.info.finfo->flags & GST_VIDEO_FORMAT_FLAG_RGB)
+    job->params.tcp_mct = 1;
+  job->fill_image = self->fill_image;
+  job->width = GST_VIDEO_FRAME_WIDTH (&job->vframe);
+  job->height = GST_VIDEO_FRAME_HEIGHT (&job->vframe);
+  job->n_stripes = self->n_stripes;
+  job->stripe_height = self->stripe_height;
+  job->stripes = g_new0 (EncodeStripe, job->n_stripes);
+  for (i = 0; i < job->n_stripes; i++) {
+    job->stripes[i].job = job;
+    job->stripes[i].index = i;
+  }
+
+  if (!self->encode_pool) {
+    for (i = 0; i < job->n_stripes; i++)
+      gst_openjpeg_enc_encode_stripe (&job->stripes[i]);
+    return gst_openjpeg_enc_finish_job (self, job);
+  }
+
+  g_mutex_lock (&self->encode_lock);
+  job->n_pending = job->n_stripes;
+  g_queue_push_tail (&self->encode_queue, job);
+  g_mutex_unlock (&self->encode_lock);
+  for (i = 0; i < job->n_stripes; i++)
+    g_thread_pool_push (self->encode_pool, &job->stripes[i], NULL);
+
+  /* Keep all threads busy but don't queue up more frames than that */
+  return gst_openjpeg_enc_push_jobs (self, self->n_threads / self->n_stripes);
+
+map_read_error:
   {
-    opj_cio_close (io);
-    opj_destroy_compress (enc);
+    g_slice_free (EncodeFrame, job);
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, CORE, FAILED,
-        ("Failed to allocate output buffer"), (NULL));
-    return ret;
+        ("Failed to map input buffer"), (NULL));
+    return GST_FLOW_ERROR;
   }
-#endif
+}
+
+static GstFlowReturn
+gst_openjpeg_enc_finish (GstVideoEncoder * encoder)
+{
+  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (encoder);
+
+  GST_DEBUG_OBJECT (self, "Draining");
+
+  return gst_openjpeg_enc_push_jobs (self, 0);
+}
+
+static gboolean
+gst_openjpeg_enc_flush (GstVideoEncoder * encoder)
+{
+  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (encoder);
+
+  GST_DEBUG_OBJECT (self, "Flushing");
+
+  gst_openjpeg_enc_discard_jobs (self);
+
+  return TRUE;
 }
 
 static gboolean
@@ -57,6 +57,17 @@ struct _GstOpenJPEGEnc
   void (*fill_image) (opj_image_t * image, GstVideoFrame *frame);
 
   opj_cparameters_t params;
+
+  /* Parallel encoding: frames are split into n_stripes stripes that are
+   * encoded by encode_pool and finished in order from encode_queue */
+  gint max_threads;
+  gint num_stripes;
+  gint n_threads;
+  guint n_stripes, stripe_height;
+  GThreadPool *encode_pool;
+  GMutex encode_lock;
+  GCond encode_cond;
+  GQueue encode_queue;
 };
 
 struct _GstOpenJPEGEncClass
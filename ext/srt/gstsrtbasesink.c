@@ -161,6 +161,20 @@ gst_srt_base_sink_render (GstBaseSink * sink, GstBuffer * buffer)
   return ret;
 }
 
+static GstFlowReturn
+gst_srt_base_sink_render_list (GstBaseSink * sink, GstBufferList * list)
+{
+  GstBaseSinkClass *bclass = GST_BASE_SINK_GET_CLASS (sink);
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint i, len;
+
+  len = gst_buffer_list_length (list);
+  for (i = 0; i < len && ret == GST_FLOW_OK; i++)
+    ret = bclass->render (sink, gst_buffer_list_get (list, i));
+
+  return ret;
+}
+
 static void
 gst_srt_base_sink_class_init (GstSRTBaseSinkClass * klass)
 {
@@ -198,6 +212,8 @@ gst_srt_base_sink_class_init (GstSRTBaseSinkClass * klass)
   g_object_class_install_properties (gobject_class, PROP_LAST, properties);
 
   gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_srt_base_sink_render);
+  gstbasesink_class->render_list =
+      GST_DEBUG_FUNCPTR (gst_srt_base_sink_render_list);
 }
 
 static void
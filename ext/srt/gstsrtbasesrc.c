@@ -30,6 +30,31 @@
 #define GST_CAT_DEFAULT gst_debug_srt_base_src
 GST_DEBUG_CATEGORY (GST_CAT_DEFAULT);
 
+/* The largest payload a single live mode SRT message can carry */
+#define SRT_MAX_PAYLOAD_SIZE 1456
+
+struct _GstSRTBaseSrcPrivate
+{
+  /* receive statistics, protected by the object lock */
+  SRTSOCKET stats_sock;
+  guint64 messages_received;
+  guint64 buffers_received;
+  guint64 bytes_received;
+  gint64 first_recv_time;
+  gint64 last_recv_time;
+  guint64 aggregation_delay;
+  guint64 max_aggregation_delay;
+
+  /* blocksize raised to aggregate-size while running, and the one it was
+   * raised from. Only used from set_property and state changes */
+  gboolean running;
+  guint raised_blocksize;
+  guint saved_blocksize;
+};
+
+#define GST_SRT_BASE_SRC_GET_PRIVATE(obj)  \
+       (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_SRT_BASE_SRC, GstSRTBaseSrcPrivate))
+
 enum
 {
   PROP_URI = 1,
@@ -37,6 +62,9 @@ enum
   PROP_LATENCY,
   PROP_PASSPHRASE,
   PROP_KEY_LENGTH,
+  PROP_AGGREGATE_SIZE,
+  PROP_AGGREGATE_TIME,
+  PROP_STATS,
 
   /*< private > */
   PROP_LAST
@@ -52,11 +80,102 @@ static gboolean gst_srt_base_src_uri_set_uri (GstURIHandler * handler,
 
 #define gst_srt_base_src_parent_class parent_class
 G_DEFINE_ABSTRACT_TYPE_WITH_CODE (GstSRTBaseSrc, gst_srt_base_src,
-    GST_TYPE_PUSH_SRC, G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER,
+    GST_TYPE_PUSH_SRC, G_ADD_PRIVATE (GstSRTBaseSrc)
+    G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER,
         gst_srt_base_src_uri_handler_init)
     GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "srtbasesrc", 0,
         "SRT Base Source"));
 
+static GstStructure *
+gst_srt_base_src_get_stats (GstSRTBaseSrc * self)
+{
+  GstSRTBaseSrcPrivate *priv = GST_SRT_BASE_SRC_GET_PRIVATE (self);
+  SRT_TRACEBSTATS stats;
+  GstStructure *s;
+  SRTSOCKET sock;
+  gdouble throughput = 0, messages_per_buffer = 0;
+  guint64 aggregation_delay = 0;
+
+  GST_OBJECT_LOCK (self);
+  sock = priv->stats_sock;
+  if (priv->last_recv_time > priv->first_recv_time)
+    /* bits per microsecond is Mb/s */
+    throughput = (gdouble) priv->bytes_received * 8 /
+        (priv->last_recv_time - priv->first_recv_time);
+  if (priv->buffers_received > 0) {
+    messages_per_buffer =
+        (gdouble) priv->messages_received / priv->buffers_received;
+    aggregation_delay = priv->aggregation_delay / priv->buffers_received;
+  }
+
+  s = gst_structure_new ("application/x-srt-statistics",
+      /* SRT messages read and buffers they were aggregated into */
+      "messages-received", G_TYPE_UINT64, priv->messages_received,
+      "buffers-received", G_TYPE_UINT64, priv->buffers_received,
+      "bytes-received", G_TYPE_UINT64, priv->bytes_received,
+      "messages-per-buffer", G_TYPE_DOUBLE, messages_per_buffer,
+      /* payload throughput since the first received message, in Mb/s */
+      "throughput-mbps", G_TYPE_DOUBLE, throughput,
+      /* time spent collecting messages after the first one of a buffer */
+      "aggregation-delay-us", G_TYPE_UINT64, aggregation_delay,
+      "max-aggregation-delay-us", G_TYPE_UINT64, priv->max_aggregation_delay,
+      NULL);
+  GST_OBJECT_UNLOCK (self);
+
+  if (sock != SRT_INVALID_SOCK && srt_bstats (sock, &stats, 0) >= 0) {
+    gst_structure_set (s,
+        /* number of received data packets */
+        "packets-received", G_TYPE_INT64, stats.pktRecv,
+        /* number of lost packets (receiver side) */
+        "packets-received-lost", G_TYPE_INT, stats.pktRcvLoss,
+        /* number of too-late-to-play dropped packets */
+        "packets-received-dropped", G_TYPE_INT, stats.pktRcvDrop,
+        /* number of too-late-to-play dropped bytes */
+        "bytes-received-dropped", G_TYPE_UINT64, stats.byteRcvDrop,
+        /* receiving rate in Mb/s */
+        "receive-rate-mbps", G_TYPE_DOUBLE, stats.mbpsRecvRate,
+        /* estimated bandwidth, in Mb/s */
+        "bandwidth-mbps", G_TYPE_DOUBLE, stats.mbpsBandwidth,
+        "rtt-ms", G_TYPE_DOUBLE, stats.msRTT,
+        "negotiated-latency-ms", G_TYPE_INT, stats.msRcvTsbPdDelay, NULL);
+  }
+
+  return s;
+}
+
+/* Raises the blocksize to aggregate-size while the source is running, so
+ * that the buffers to receive into are large enough. Otherwise, or when
+ * aggregate-size was lowered, restores the blocksize it was raised from */
+static void
+gst_srt_base_src_update_blocksize (GstSRTBaseSrc * self)
+{
+  GstSRTBaseSrcPrivate *priv = GST_SRT_BASE_SRC_GET_PRIVATE (self);
+  GstBaseSrc *src = GST_BASE_SRC (self);
+  guint blocksize, aggregate_size;
+
+  GST_OBJECT_LOCK (self);
+  aggregate_size = self->aggregate_size;
+  GST_OBJECT_UNLOCK (self);
+
+  blocksize = gst_base_src_get_blocksize (src);
+  if (priv->raised_blocksize != 0) {
+    /* unless it was set in the meantime */
+    if (blocksize == priv->raised_blocksize)
+      blocksize = priv->saved_blocksize;
+    priv->raised_blocksize = 0;
+  }
+
+  if (priv->running && aggregate_size > blocksize) {
+    GST_DEBUG_OBJECT (self, "raising blocksize from %u to %u", blocksize,
+        aggregate_size);
+    priv->saved_blocksize = blocksize;
+    priv->raised_blocksize = aggregate_size;
+    blocksize = aggregate_size;
+  }
+
+  gst_base_src_set_blocksize (src, blocksize);
+}
+
 static void
 gst_srt_base_src_get_property (GObject * object,
     guint prop_id, GValue * value, GParamSpec * pspec)
@@ -84,6 +203,19 @@ gst_srt_base_src_get_property (GObject * object,
     case PROP_KEY_LENGTH:
       g_value_set_int (value, self->key_length);
       break;
+    case PROP_AGGREGATE_SIZE:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->aggregate_size);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_AGGREGATE_TIME:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint64 (value, self->aggregate_time);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_srt_base_src_get_stats (self));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -122,6 +254,17 @@ gst_srt_base_src_set_property (GObject * object,
       self->key_length = key_length;
       break;
     }
+    case PROP_AGGREGATE_SIZE:
+      GST_OBJECT_LOCK (self);
+      self->aggregate_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      gst_srt_base_src_update_blocksize (self);
+      break;
+    case PROP_AGGREGATE_TIME:
+      GST_OBJECT_LOCK (self);
+      self->aggregate_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -166,11 +309,148 @@ gst_srt_base_src_get_caps (GstBaseSrc * src, GstCaps * filter)
   return result;
 }
 
+static GstStateChangeReturn
+gst_srt_base_src_change_state (GstElement * element, GstStateChange transition)
+{
+  GstSRTBaseSrc *self = GST_SRT_BASE_SRC (element);
+  GstSRTBaseSrcPrivate *priv = GST_SRT_BASE_SRC_GET_PRIVATE (self);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED) {
+    priv->running = TRUE;
+    gst_srt_base_src_update_blocksize (self);
+
+    GST_OBJECT_LOCK (self);
+    priv->stats_sock = SRT_INVALID_SOCK;
+    priv->messages_received = 0;
+    priv->buffers_received = 0;
+    priv->bytes_received = 0;
+    priv->first_recv_time = 0;
+    priv->last_recv_time = 0;
+    priv->aggregation_delay = 0;
+    priv->max_aggregation_delay = 0;
+    GST_OBJECT_UNLOCK (self);
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY ||
+      (transition == GST_STATE_CHANGE_READY_TO_PAUSED &&
+          ret == GST_STATE_CHANGE_FAILURE)) {
+    priv->running = FALSE;
+    gst_srt_base_src_update_blocksize (self);
+  }
+
+  return ret;
+}
+
+/**
+ * gst_srt_base_src_receive:
+ * @self: a #GstSRTBaseSrc
+ * @sock: the connected SRT socket to read from
+ * @data: memory to receive into
+ * @size: size of @data
+ * @pts: (out): running time at which the first message arrived
+ *
+ * Blocks until one SRT message has been received. When
+ * #GstSRTBaseSrc:aggregate-size is set, further messages are appended to
+ * @data while they are already queued in SRT, or until
+ * #GstSRTBaseSrc:aggregate-time has passed since the first one, as long as
+ * the result stays within aggregate-size.
+ *
+ * Returns: the number of bytes received, 0 at the end of the stream, or
+ * %SRT_ERROR if the first message could not be received.
+ */
+gint
+gst_srt_base_src_receive (GstSRTBaseSrc * self, SRTSOCKET sock,
+    guint8 * data, gsize size, GstClockTime * pts)
+{
+  GstSRTBaseSrcPrivate *priv = GST_SRT_BASE_SRC_GET_PRIVATE (self);
+  guint aggregate_size;
+  GstClockTime aggregate_time;
+  gint64 start, now, deadline;
+  gint recv_len, total;
+  guint n_messages = 1;
+
+  recv_len = srt_recvmsg (sock, (char *) data, size);
+  if (recv_len <= 0)
+    return recv_len;
+
+  start = g_get_monotonic_time ();
+  *pts = gst_clock_get_time (GST_ELEMENT_CLOCK (self)) -
+      GST_ELEMENT_CAST (self)->base_time;
+
+  GST_OBJECT_LOCK (self);
+  aggregate_size = self->aggregate_size;
+  aggregate_time = self->aggregate_time;
+  GST_OBJECT_UNLOCK (self);
+
+  if (aggregate_size > 0 && aggregate_size < size)
+    size = aggregate_size;
+  total = recv_len;
+
+  if (aggregate_size > 0 && total + SRT_MAX_PAYLOAD_SIZE <= size) {
+    deadline = start + aggregate_time / GST_USECOND;
+
+    /* Without a time limit only drain what SRT has already queued */
+    if (aggregate_time == 0)
+      srt_setsockopt (sock, 0, SRTO_RCVSYN, &(int) {
+          0}, sizeof (int));
+
+    while (total + SRT_MAX_PAYLOAD_SIZE <= size) {
+      if (aggregate_time > 0) {
+        gint timeout = (deadline - g_get_monotonic_time ()) / 1000;
+
+        if (timeout <= 0)
+          break;
+        srt_setsockopt (sock, 0, SRTO_RCVTIMEO, &timeout, sizeof (int));
+      }
+
+      recv_len = srt_recvmsg (sock, (char *) data + total, size - total);
+      if (recv_len <= 0) {
+        /* Nothing queued, timed out or failed. A real error is reported
+         * again by the next blocking receive. */
+        srt_clearlasterror ();
+        break;
+      }
+
+      total += recv_len;
+      n_messages++;
+    }
+
+    if (aggregate_time == 0)
+      srt_setsockopt (sock, 0, SRTO_RCVSYN, &(int) {
+          1}, sizeof (int));
+    else
+      srt_setsockopt (sock, 0, SRTO_RCVTIMEO, &(int) {
+          -1}, sizeof (int));
+  }
+
+  now = g_get_monotonic_time ();
+
+  GST_OBJECT_LOCK (self);
+  priv->stats_sock = sock;
+  priv->messages_received += n_messages;
+  priv->buffers_received++;
+  priv->bytes_received += total;
+  if (priv->first_recv_time == 0)
+    priv->first_recv_time = start;
+  priv->last_recv_time = now;
+  priv->aggregation_delay += now - start;
+  if (now - start > priv->max_aggregation_delay)
+    priv->max_aggregation_delay = now - start;
+  GST_OBJECT_UNLOCK (self);
+
+  GST_LOG_OBJECT (self, "received %u messages, %d bytes", n_messages, total);
+
+  return total;
+}
 
 static void
 gst_srt_base_src_class_init (GstSRTBaseSrcClass * klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
 
   gobject_class->set_property = gst_srt_base_src_set_property;
@@ -210,8 +490,49 @@ gst_srt_base_src_class_init (GstSRTBaseSrcClass * klass)
       "Crypto key length in bytes{16,24,32}", 16,
       32, SRT_DEFAULT_KEY_LENGTH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * GstSRTBaseSrc:aggregate-size:
+   *
+   * The maximum size of an output buffer when several SRT messages are
+   * received into it. 0 pushes every message in its own buffer. While the
+   * source is running this also raises #GstBaseSrc:blocksize if it is
+   * smaller, the previous blocksize is restored when it stops or
+   * aggregate-size is lowered again.
+   */
+  properties[PROP_AGGREGATE_SIZE] =
+      g_param_spec_uint ("aggregate-size", "Aggregate size",
+      "Maximum bytes of consecutive messages to receive into one buffer "
+      "(0 = one message per buffer)", 0, G_MAXINT32, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstSRTBaseSrc:aggregate-time:
+   *
+   * How long to keep waiting for more messages once the first message of
+   * a buffer has arrived. 0 only collects the messages that are already
+   * available. Has no effect unless #GstSRTBaseSrc:aggregate-size is set.
+   */
+  properties[PROP_AGGREGATE_TIME] =
+      g_param_spec_uint64 ("aggregate-time", "Aggregate time",
+      "Maximum time in nanoseconds to wait for more messages to aggregate "
+      "(0 = only take already received messages)", 0, G_MAXUINT64, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstSRTBaseSrc:stats:
+   *
+   * Receive statistics: counters of the messages and buffers received by
+   * the element and the SRT statistics of the current connection.
+   */
+  properties[PROP_STATS] = g_param_spec_boxed ("stats", "Statistics",
+      "SRT receive statistics", GST_TYPE_STRUCTURE,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, PROP_LAST, properties);
 
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_srt_base_src_change_state);
+
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_srt_base_src_get_caps);
 }
 
@@ -223,6 +544,10 @@ gst_srt_base_src_init (GstSRTBaseSrc * self)
   gst_base_src_set_live (GST_BASE_SRC (self), TRUE);
   self->latency = SRT_DEFAULT_LATENCY;
   self->key_length = SRT_DEFAULT_KEY_LENGTH;
+  self->aggregate_size = 0;
+  self->aggregate_time = 0;
+
+  GST_SRT_BASE_SRC_GET_PRIVATE (self)->stats_sock = SRT_INVALID_SOCK;
 }
 
 static GstURIType
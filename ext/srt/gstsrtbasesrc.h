@@ -24,6 +24,8 @@
 #include <gst/gst.h>
 #include <gst/base/gstpushsrc.h>
 
+#include <srt/srt.h>
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_SRT_BASE_SRC              (gst_srt_base_src_get_type ())
@@ -37,6 +39,7 @@ G_BEGIN_DECLS
 
 typedef struct _GstSRTBaseSrc GstSRTBaseSrc;
 typedef struct _GstSRTBaseSrcClass GstSRTBaseSrcClass;
+typedef struct _GstSRTBaseSrcPrivate GstSRTBaseSrcPrivate;
 
 struct _GstSRTBaseSrc {
   GstPushSrc parent;
@@ -46,6 +49,8 @@ struct _GstSRTBaseSrc {
   gint latency;
   gchar *passphrase;
   gint key_length;
+  guint aggregate_size;
+  GstClockTime aggregate_time;
 
   /*< private >*/
   gpointer _gst_reserved[GST_PADDING];
@@ -60,6 +65,9 @@ struct _GstSRTBaseSrcClass {
 GST_EXPORT
 GType gst_srt_base_src_get_type (void);
 
+gint gst_srt_base_src_receive (GstSRTBaseSrc * self, SRTSOCKET sock,
+    guint8 * data, gsize size, GstClockTime * pts);
+
 G_END_DECLS
 
 #endif /* __GST_SRT_BASE_SRC_H__ */
@@ -174,6 +174,7 @@ gst_srt_client_src_fill (GstPushSrc * src, GstBuffer * outbuf)
   GstMapInfo info;
   SRTSOCKET ready[2];
   gint recv_len;
+  GstClockTime pts;
 
   if (srt_epoll_wait (priv->poll_id, 0, 0, ready, &(int) {
           2}, priv->poll_timeout, 0, 0, 0, 0) == -1) {
@@ -195,8 +196,8 @@ gst_srt_client_src_fill (GstPushSrc * src, GstBuffer * outbuf)
     goto out;
   }
 
-  recv_len = srt_recvmsg (priv->sock, (char *) info.data,
-      gst_buffer_get_size (outbuf));
+  recv_len = gst_srt_base_src_receive (GST_SRT_BASE_SRC (self), priv->sock,
+      info.data, info.size, &pts);
 
   gst_buffer_unmap (outbuf, &info);
 
@@ -210,9 +211,7 @@ gst_srt_client_src_fill (GstPushSrc * src, GstBuffer * outbuf)
     goto out;
   }
 
-  GST_BUFFER_PTS (outbuf) =
-      gst_clock_get_time (GST_ELEMENT_CLOCK (src)) -
-      GST_ELEMENT_CAST (src)->base_time;
+  GST_BUFFER_PTS (outbuf) = pts;
 
   gst_buffer_resize (outbuf, 0, recv_len);
 
@@ -32,7 +32,10 @@
  * gst-launch-1.0 -v audiotestsrc ! srtserversink
  * ]| This pipeline shows how to serve SRT packets through the default port.
  * </refsect2>
- * 
+ *
+ * Each client gets its own queue of at most #GstSRTServerSink:max-client-backlog
+ * buffers, which a separate sender thread hands to SRT. A slow client does
+ * not hold up the others, it loses its oldest queued data instead.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -43,8 +46,17 @@
 #include "gstsrt.h"
 #include <srt/srt.h>
 #include <gio/gio.h>
+#include <glib-unix.h>
+#include <unistd.h>
 
 #define SRT_DEFAULT_POLL_TIMEOUT -1
+#define SRT_DEFAULT_MAX_CLIENT_BACKLOG 1024
+
+/* how long the sender thread blocks waiting for a client whose SRT send
+ * buffer was full, in milliseconds. New data and stopping wake it up
+ * earlier through the wakeup pipe */
+#define SRT_SEND_POLL_TIMEOUT 500
+#define SRT_SEND_POLL_SOCKS 16
 
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -67,7 +79,21 @@ struct _GstSRTServerSinkPrivate
   GSource *server_source;
   GThread *thread;
 
+  /* protected by the object lock; while streaming, clients are only
+   * removed by the sender thread */
   GList *clients;
+  guint max_client_backlog;
+
+  GThread *send_thread;
+  GCond send_cond;
+  gboolean send_stop;
+  /* the sender thread blocks in srt_epoll_wait(), writing to the pipe
+   * wakes it up */
+  gboolean send_polling;
+  gint wakeup_fds[2];
+  /* only used by the sender thread */
+  gint send_poll_id;
+  guint n_blocked;
 };
 
 #define GST_SRT_SERVER_SINK_GET_PRIVATE(obj)  \
@@ -77,6 +103,7 @@ enum
 {
   PROP_POLL_TIMEOUT = 1,
   PROP_STATS,
+  PROP_MAX_CLIENT_BACKLOG,
   /*< private > */
   PROP_LAST
 };
@@ -103,6 +130,15 @@ typedef struct
 {
   int sock;
   GSocketAddress *sockaddr;
+
+  /* buffers not yet handed to SRT, oldest first; protected by the object
+   * lock */
+  GQueue queue;
+  guint64 queued_bytes;
+  guint64 dropped;
+
+  /* SRT send buffer is full, waiting for the socket to become writable */
+  gboolean blocked;
 } SRTClient;
 
 static SRTClient *
@@ -110,6 +146,7 @@ srt_client_new (void)
 {
   SRTClient *client = g_new0 (SRTClient, 1);
   client->sock = SRT_INVALID_SOCK;
+  g_queue_init (&client->queue);
   return client;
 }
 
@@ -120,6 +157,9 @@ srt_client_free (SRTClient * client)
 
   g_clear_object (&client->sockaddr);
 
+  g_queue_foreach (&client->queue, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (&client->queue);
+
   if (client->sock != SRT_INVALID_SOCK) {
     srt_close (client->sock);
   }
@@ -127,6 +167,22 @@ srt_client_free (SRTClient * client)
   g_free (client);
 }
 
+/* call with the object lock */
+static void
+srt_client_enqueue (SRTClient * client, GstBuffer * buffer, guint max_backlog)
+{
+  while (client->queue.length >= max_backlog) {
+    GstBuffer *old = g_queue_pop_head (&client->queue);
+
+    client->queued_bytes -= gst_buffer_get_size (old);
+    client->dropped++;
+    gst_buffer_unref (old);
+  }
+
+  g_queue_push_tail (&client->queue, gst_buffer_ref (buffer));
+  client->queued_bytes += gst_buffer_get_size (buffer);
+}
+
 static void
 srt_emit_client_removed (SRTClient * client, gpointer user_data)
 {
@@ -157,14 +213,28 @@ gst_srt_server_sink_get_property (GObject * object,
         SRTClient *client = item->data;
         GValue tmp = G_VALUE_INIT;
 
+        GstStructure *s;
+
+        s = gst_srt_base_sink_get_stats (client->sockaddr, client->sock);
+        gst_structure_set (s,
+            /* buffers queued for the client but not yet handed to SRT */
+            "backlog-buffers", G_TYPE_UINT, client->queue.length,
+            "backlog-bytes", G_TYPE_UINT64, client->queued_bytes,
+            /* buffers dropped because the backlog was full */
+            "buffers-dropped", G_TYPE_UINT64, client->dropped, NULL);
+
         g_value_init (&tmp, GST_TYPE_STRUCTURE);
-        g_value_take_boxed (&tmp, gst_srt_base_sink_get_stats (client->sockaddr,
-                client->sock));
+        g_value_take_boxed (&tmp, s);
         gst_value_array_append_and_take_value (value, &tmp);
       }
       GST_OBJECT_UNLOCK (self);
       break;
     }
+    case PROP_MAX_CLIENT_BACKLOG:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, priv->max_client_backlog);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -182,6 +252,11 @@ gst_srt_server_sink_set_property (GObject * object,
     case PROP_POLL_TIMEOUT:
       priv->poll_timeout = g_value_get_int (value);
       break;
+    case PROP_MAX_CLIENT_BACKLOG:
+      GST_OBJECT_LOCK (self);
+      priv->max_client_backlog = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -256,6 +331,191 @@ thread_func (gpointer data)
   return NULL;
 }
 
+static void
+gst_srt_server_sink_remove_client (GstSRTServerSink * self,
+    SRTClient * client)
+{
+  GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
+
+  GST_OBJECT_LOCK (self);
+  priv->clients = g_list_remove (priv->clients, client);
+  GST_OBJECT_UNLOCK (self);
+
+  if (client->blocked) {
+    srt_epoll_remove_usock (priv->send_poll_id, client->sock);
+    priv->n_blocked--;
+  }
+
+  g_signal_emit (self, signals[SIG_CLIENT_REMOVED], 0, client->sock,
+      client->sockaddr);
+  srt_client_free (client);
+}
+
+/* call with the object lock */
+static void
+gst_srt_server_sink_wakeup (GstSRTServerSink * self)
+{
+  GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
+
+  if (priv->send_polling) {
+    if (write (priv->wakeup_fds[1], "", 1) < 0)
+      GST_WARNING_OBJECT (self, "failed to wake up the sender thread");
+    priv->send_polling = FALSE;
+  } else {
+    g_cond_signal (&priv->send_cond);
+  }
+}
+
+/* waits up to @timeout milliseconds for blocked clients to become writable
+ * again, or for a wakeup, and unblocks the writable ones */
+static void
+gst_srt_server_sink_poll_blocked (GstSRTServerSink * self, GList * clients,
+    gint timeout)
+{
+  GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
+  SRTSOCKET ready[SRT_SEND_POLL_SOCKS];
+  int n_ready = G_N_ELEMENTS (ready);
+  SYSSOCKET wakeup;
+  int n_wakeup = 1;
+  GList *item;
+  int i;
+  char c;
+
+  if (srt_epoll_wait (priv->send_poll_id, NULL, NULL, ready, &n_ready,
+          timeout, &wakeup, &n_wakeup, NULL, NULL) == -1) {
+    /* SRT_ETIMEOUT, nothing became writable */
+    srt_clearlasterror ();
+    return;
+  }
+
+  /* woken up by render() or stop(), empty the pipe */
+  if (n_wakeup > 0) {
+    while (read (priv->wakeup_fds[0], &c, 1) > 0);
+  }
+
+  for (i = 0; i < n_ready; i++) {
+    for (item = clients; item; item = item->next) {
+      SRTClient *client = item->data;
+
+      if (client->sock == ready[i] && client->blocked) {
+        srt_epoll_remove_usock (priv->send_poll_id, client->sock);
+        client->blocked = FALSE;
+        priv->n_blocked--;
+        break;
+      }
+    }
+  }
+}
+
+/* hands queued buffers to SRT until the queue is empty or the SRT send
+ * buffer is full; the client is removed on error */
+static void
+gst_srt_server_sink_drain_client (GstSRTServerSink * self, SRTClient * client)
+{
+  GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
+  GstBuffer *buffer;
+  GstMapInfo info;
+  gsize size;
+  int res;
+
+  while (!client->blocked) {
+    GST_OBJECT_LOCK (self);
+    buffer = g_queue_pop_head (&client->queue);
+    size = buffer ? gst_buffer_get_size (buffer) : 0;
+    client->queued_bytes -= size;
+    GST_OBJECT_UNLOCK (self);
+
+    if (buffer == NULL)
+      break;
+
+    if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+      GST_WARNING_OBJECT (self, "could not map buffer, dropping it");
+      gst_buffer_unref (buffer);
+      continue;
+    }
+
+    res = srt_sendmsg2 (client->sock, (char *) info.data, info.size, 0);
+    gst_buffer_unmap (buffer, &info);
+
+    if (res != SRT_ERROR) {
+      gst_buffer_unref (buffer);
+      continue;
+    }
+
+    if (srt_getlasterror (NULL) == SRT_EASYNCSND) {
+      srt_clearlasterror ();
+
+      /* put it back, unless newer data has filled the backlog meanwhile */
+      GST_OBJECT_LOCK (self);
+      if (client->queue.length < priv->max_client_backlog) {
+        g_queue_push_head (&client->queue, buffer);
+        client->queued_bytes += size;
+      } else {
+        client->dropped++;
+        gst_buffer_unref (buffer);
+      }
+      GST_OBJECT_UNLOCK (self);
+
+      GST_LOG_OBJECT (self, "client %d is blocked", client->sock);
+      client->blocked = TRUE;
+      priv->n_blocked++;
+      srt_epoll_add_usock (priv->send_poll_id, client->sock, &(int) {
+          SRT_EPOLL_OUT | SRT_EPOLL_ERR});
+      break;
+    }
+
+    GST_WARNING_OBJECT (self, "%s", srt_getlasterror_str ());
+    srt_clearlasterror ();
+    gst_buffer_unref (buffer);
+    gst_srt_server_sink_remove_client (self, client);
+    break;
+  }
+}
+
+static gpointer
+send_thread_func (gpointer data)
+{
+  GstSRTServerSink *self = GST_SRT_SERVER_SINK (data);
+  GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
+
+  GST_OBJECT_LOCK (self);
+  while (!priv->send_stop) {
+    GList *clients, *item;
+    gboolean pending = FALSE;
+
+    for (item = priv->clients; item && !pending; item = item->next) {
+      SRTClient *client = item->data;
+
+      pending = !client->blocked && client->queue.length > 0;
+    }
+
+    if (!pending && priv->n_blocked == 0) {
+      g_cond_wait (&priv->send_cond, GST_OBJECT_GET_LOCK (self));
+      continue;
+    }
+
+    /* With nothing else to send, block in SRT until a blocked client
+     * becomes writable or render() and stop() wake us up */
+    clients = g_list_copy (priv->clients);
+    priv->send_polling = !pending;
+    GST_OBJECT_UNLOCK (self);
+
+    if (priv->n_blocked > 0)
+      gst_srt_server_sink_poll_blocked (self, clients,
+          pending ? 0 : SRT_SEND_POLL_TIMEOUT);
+
+    for (item = clients; item; item = item->next)
+      gst_srt_server_sink_drain_client (self, item->data);
+    g_list_free (clients);
+
+    GST_OBJECT_LOCK (self);
+    priv->send_polling = FALSE;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return NULL;
+}
+
 static gboolean
 gst_srt_server_sink_start (GstBaseSink * sink)
 {
@@ -364,6 +624,38 @@ gst_srt_server_sink_start (GstBaseSink * sink)
   if (error != NULL) {
     GST_WARNING_OBJECT (self, "failed to create thread (reason: %s)",
         error->message);
+    g_clear_error (&error);
+    ret = FALSE;
+  }
+
+  priv->send_poll_id = srt_epoll_create ();
+  if (priv->send_poll_id == -1) {
+    GST_WARNING_OBJECT (self,
+        "failed to create poll id for sending (reason: %s)",
+        srt_getlasterror_str ());
+    ret = FALSE;
+  }
+
+  if (!g_unix_open_pipe (priv->wakeup_fds, FD_CLOEXEC, &error) ||
+      !g_unix_set_fd_nonblocking (priv->wakeup_fds[0], TRUE, &error)) {
+    GST_WARNING_OBJECT (self, "failed to create wakeup pipe (reason: %s)",
+        error->message);
+    g_clear_error (&error);
+    ret = FALSE;
+  } else {
+    srt_epoll_add_ssock (priv->send_poll_id, priv->wakeup_fds[0], &(int) {
+        SRT_EPOLL_IN});
+  }
+
+  priv->send_stop = FALSE;
+  priv->send_polling = FALSE;
+  priv->n_blocked = 0;
+  priv->send_thread = g_thread_try_new ("srtserversink-send",
+      send_thread_func, self, &error);
+  if (error != NULL) {
+    GST_WARNING_OBJECT (self, "failed to create sender thread (reason: %s)",
+        error->message);
+    g_clear_error (&error);
     ret = FALSE;
   }
 
@@ -390,34 +682,42 @@ failed:
   return FALSE;
 }
 
-static gboolean
-gst_srt_server_sink_send_buffer (GstSRTBaseSink * sink,
-    const GstMapInfo * mapinfo)
+static GstFlowReturn
+gst_srt_server_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 {
   GstSRTServerSink *self = GST_SRT_SERVER_SINK (sink);
   GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
-  GList *clients = priv->clients;
+  GList *item;
 
-  GST_OBJECT_LOCK (sink);
-  while (clients != NULL) {
-    SRTClient *client = clients->data;
-    clients = clients->next;
-
-    if (srt_sendmsg2 (client->sock, (char *) mapinfo->data, mapinfo->size,
-            0) == SRT_ERROR) {
-      GST_WARNING_OBJECT (self, "%s", srt_getlasterror_str ());
-
-      priv->clients = g_list_remove (priv->clients, client);
-      GST_OBJECT_UNLOCK (sink);
-      g_signal_emit (self, signals[SIG_CLIENT_REMOVED], 0, client->sock,
-          client->sockaddr);
-      srt_client_free (client);
-      GST_OBJECT_LOCK (sink);
-    }
+  GST_OBJECT_LOCK (self);
+  for (item = priv->clients; item; item = item->next)
+    srt_client_enqueue (item->data, buffer, priv->max_client_backlog);
+  gst_srt_server_sink_wakeup (self);
+  GST_OBJECT_UNLOCK (self);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_srt_server_sink_render_list (GstBaseSink * sink, GstBufferList * list)
+{
+  GstSRTServerSink *self = GST_SRT_SERVER_SINK (sink);
+  GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
+  guint i, len = gst_buffer_list_length (list);
+  GList *item;
+
+  /* queue the whole batch for every client at once, and wake up the
+   * sender thread only once */
+  GST_OBJECT_LOCK (self);
+  for (item = priv->clients; item; item = item->next) {
+    for (i = 0; i < len; i++)
+      srt_client_enqueue (item->data, gst_buffer_list_get (list, i),
+          priv->max_client_backlog);
   }
-  GST_OBJECT_UNLOCK (sink);
+  gst_srt_server_sink_wakeup (self);
+  GST_OBJECT_UNLOCK (self);
 
-  return TRUE;
+  return GST_FLOW_OK;
 }
 
 static gboolean
@@ -428,6 +728,16 @@ gst_srt_server_sink_stop (GstBaseSink * sink)
   gboolean ret = TRUE;
   GList *clients;
 
+  if (priv->send_thread) {
+    GST_OBJECT_LOCK (sink);
+    priv->send_stop = TRUE;
+    gst_srt_server_sink_wakeup (self);
+    GST_OBJECT_UNLOCK (sink);
+
+    g_thread_join (priv->send_thread);
+    priv->send_thread = NULL;
+  }
+
   GST_DEBUG_OBJECT (self, "closing client sockets");
 
   GST_OBJECT_LOCK (sink);
@@ -438,6 +748,18 @@ gst_srt_server_sink_stop (GstBaseSink * sink)
   g_list_foreach (clients, (GFunc) srt_emit_client_removed, self);
   g_list_free_full (clients, (GDestroyNotify) srt_client_free);
 
+  if (priv->send_poll_id != SRT_ERROR) {
+    srt_epoll_release (priv->send_poll_id);
+    priv->send_poll_id = SRT_ERROR;
+  }
+  priv->n_blocked = 0;
+
+  if (priv->wakeup_fds[0] != -1) {
+    close (priv->wakeup_fds[0]);
+    close (priv->wakeup_fds[1]);
+    priv->wakeup_fds[0] = priv->wakeup_fds[1] = -1;
+  }
+
   GST_DEBUG_OBJECT (self, "closing SRT connection");
   srt_epoll_remove_usock (priv->poll_id, priv->sock);
   srt_epoll_release (priv->poll_id);
@@ -482,16 +804,27 @@ gst_srt_server_sink_unlock_stop (GstBaseSink * sink)
   return TRUE;
 }
 
+static void
+gst_srt_server_sink_finalize (GObject * object)
+{
+  GstSRTServerSink *self = GST_SRT_SERVER_SINK (object);
+  GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
+
+  g_cond_clear (&priv->send_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gst_srt_server_sink_class_init (GstSRTServerSinkClass * klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSinkClass *gstbasesink_class = GST_BASE_SINK_CLASS (klass);
-  GstSRTBaseSinkClass *gstsrtbasesink_class = GST_SRT_BASE_SINK_CLASS (klass);
 
   gobject_class->set_property = gst_srt_server_sink_set_property;
   gobject_class->get_property = gst_srt_server_sink_get_property;
+  gobject_class->finalize = gst_srt_server_sink_finalize;
 
   properties[PROP_POLL_TIMEOUT] =
       g_param_spec_int ("poll-timeout", "Poll Timeout",
@@ -506,6 +839,18 @@ gst_srt_server_sink_class_init (GstSRTServerSinkClass * klass)
           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS),
       G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * GstSRTServerSink:max-client-backlog:
+   *
+   * The maximum number of buffers queued for one client. When a client
+   * cannot keep up, its oldest queued buffers are dropped.
+   */
+  properties[PROP_MAX_CLIENT_BACKLOG] =
+      g_param_spec_uint ("max-client-backlog", "Max client backlog",
+      "Maximum number of buffers queued per client before dropping the oldest",
+      1, G_MAXUINT, SRT_DEFAULT_MAX_CLIENT_BACKLOG,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, PROP_LAST, properties);
 
   /**
@@ -549,9 +894,9 @@ gst_srt_server_sink_class_init (GstSRTServerSinkClass * klass)
   gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_srt_server_sink_unlock);
   gstbasesink_class->unlock_stop =
       GST_DEBUG_FUNCPTR (gst_srt_server_sink_unlock_stop);
-
-  gstsrtbasesink_class->send_buffer =
-      GST_DEBUG_FUNCPTR (gst_srt_server_sink_send_buffer);
+  gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_srt_server_sink_render);
+  gstbasesink_class->render_list =
+      GST_DEBUG_FUNCPTR (gst_srt_server_sink_render_list);
 }
 
 static void
@@ -559,4 +904,8 @@ gst_srt_server_sink_init (GstSRTServerSink * self)
 {
   GstSRTServerSinkPrivate *priv = GST_SRT_SERVER_SINK_GET_PRIVATE (self);
   priv->poll_timeout = SRT_DEFAULT_POLL_TIMEOUT;
+  priv->max_client_backlog = SRT_DEFAULT_MAX_CLIENT_BACKLOG;
+  priv->send_poll_id = SRT_ERROR;
+  priv->wakeup_fds[0] = priv->wakeup_fds[1] = -1;
+  g_cond_init (&priv->send_cond);
 }
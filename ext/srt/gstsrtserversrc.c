@@ -157,6 +157,7 @@ gst_srt_server_src_fill (GstPushSrc * src, GstBuffer * outbuf)
   GstMapInfo info;
   SRTSOCKET ready[2];
   gint recv_len;
+  GstClockTime pts;
   struct sockaddr client_sa;
   size_t client_sa_len;
 
@@ -216,8 +217,9 @@ gst_srt_server_src_fill (GstPushSrc * src, GstBuffer * outbuf)
     goto out;
   }
 
-  recv_len = srt_recvmsg (priv->client_sock, (char *) info.data,
-      gst_buffer_get_size (outbuf));
+  recv_len =
+      gst_srt_base_src_receive (GST_SRT_BASE_SRC (self), priv->client_sock,
+      info.data, info.size, &pts);
 
   gst_buffer_unmap (outbuf, &info);
 
@@ -239,9 +241,7 @@ gst_srt_server_src_fill (GstPushSrc * src, GstBuffer * outbuf)
     goto out;
   }
 
-  GST_BUFFER_PTS (outbuf) =
-      gst_clock_get_time (GST_ELEMENT_CLOCK (src)) -
-      GST_ELEMENT_CAST (src)->base_time;
+  GST_BUFFER_PTS (outbuf) = pts;
 
   gst_buffer_resize (outbuf, 0, recv_len);
 
@@ -200,6 +200,10 @@ static GstFlowReturn gst_srtp_dec_chain_rtp (GstPad * pad,
     GstObject * parent, GstBuffer * buf);
 static GstFlowReturn gst_srtp_dec_chain_rtcp (GstPad * pad,
     GstObject * parent, GstBuffer * buf);
+static GstFlowReturn gst_srtp_dec_chain_list_rtp (GstPad * pad,
+    GstObject * parent, GstBufferList * buf_list);
+static GstFlowReturn gst_srtp_dec_chain_list_rtcp (GstPad * pad,
+    GstObject * parent, GstBufferList * buf_list);
 
 static GstStateChangeReturn gst_srtp_dec_change_state (GstElement * element,
     GstStateChange transition);
@@ -207,6 +211,16 @@ static GstStateChangeReturn gst_srtp_dec_change_state (GstElement * element,
 static GstSrtpDecSsrcStream *request_key_with_signal (GstSrtpDec * filter,
     guint32 ssrc, gint signal);
 
+typedef struct ProcessBufferItData
+{
+  GstSrtpDec *filter;
+  GstPad *pad;
+  gboolean is_rtcp;
+  GstBufferList *rtp_list;
+  GstBufferList *rtcp_list;
+  GArray *soft_limit_ssrcs;
+} ProcessBufferItData;
+
 struct _GstSrtpDecSsrcStream
 {
   guint32 ssrc;
@@ -363,6 +377,8 @@ gst_srtp_dec_init (GstSrtpDec * filter)
       GST_DEBUG_FUNCPTR (gst_srtp_dec_iterate_internal_links_rtp));
   gst_pad_set_chain_function (filter->rtp_sinkpad,
       GST_DEBUG_FUNCPTR (gst_srtp_dec_chain_rtp));
+  gst_pad_set_chain_list_function (filter->rtp_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_srtp_dec_chain_list_rtp));
 
   filter->rtp_srcpad =
       gst_pad_new_from_static_template (&rtp_src_template, "rtp_src");
@@ -386,6 +402,8 @@ gst_srtp_dec_init (GstSrtpDec * filter)
       GST_DEBUG_FUNCPTR (gst_srtp_dec_iterate_internal_links_rtcp));
   gst_pad_set_chain_function (filter->rtcp_sinkpad,
       GST_DEBUG_FUNCPTR (gst_srtp_dec_chain_rtcp));
+  gst_pad_set_chain_list_function (filter->rtcp_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_srtp_dec_chain_list_rtcp));
 
   filter->rtcp_srcpad =
       gst_pad_new_from_static_template (&rtcp_src_template, "rtcp_src");
@@ -1136,22 +1154,24 @@ gst_srtp_dec_push_early_events (GstSrtpDec * filter, GstPad * pad,
 }
 
 /*
- * This function should be called while holding the filter lock
+ * This function should be called while holding the filter lock. It only
+ * releases it while signalling for a new key.
  */
 static gboolean
-gst_srtp_dec_decode_buffer (GstSrtpDec * filter, GstPad * pad, GstBuffer * buf,
-    gboolean is_rtcp, guint32 ssrc)
+gst_srtp_dec_decode_buffer (GstSrtpDec * filter, GstPad * pad,
+    GstBuffer ** bufp, gboolean is_rtcp, guint32 ssrc)
 {
+  GstBuffer *buf;
   GstMapInfo map;
   srtp_err_status_t err;
   gint size;
 
   GST_LOG_OBJECT (pad, "Received %s buffer of size %" G_GSIZE_FORMAT
-      " with SSRC = %u", is_rtcp ? "RTCP" : "RTP", gst_buffer_get_size (buf),
+      " with SSRC = %u", is_rtcp ? "RTCP" : "RTP", gst_buffer_get_size (*bufp),
       ssrc);
 
   /* Change buffer to remove protection */
-  buf = gst_buffer_make_writable (buf);
+  buf = *bufp = gst_buffer_make_writable (*bufp);
 
   gst_buffer_map (buf, &map, GST_MAP_READWRITE);
   size = map.size;
@@ -1192,9 +1212,9 @@ unprotect:
     err = srtp_unprotect (filter->session, map.data, &size);
   }
 
-  GST_OBJECT_UNLOCK (filter);
-
   if (err != srtp_err_status_ok) {
+    GST_OBJECT_UNLOCK (filter);
+
     GST_WARNING_OBJECT (pad,
         "Unable to unprotect buffer (unprotect failed code %d)", err);
 
@@ -1214,6 +1234,7 @@ unprotect:
                 "dropping");
           }
         } else {
+          GST_OBJECT_UNLOCK (filter);
           GST_WARNING_OBJECT (filter, "Could not find matching stream, "
               "dropping");
         }
@@ -1239,10 +1260,27 @@ unprotect:
 
   gst_buffer_set_size (buf, size);
 
-  GST_OBJECT_LOCK (filter);
   return TRUE;
 }
 
+/* Returns the source pad for @is_rtcp packets, making sure the events that
+ * have to precede the first buffer on it were sent */
+static GstPad *
+gst_srtp_dec_prepare_srcpad (GstSrtpDec * filter, gboolean is_rtcp)
+{
+  if (is_rtcp) {
+    if (!filter->rtcp_has_segment)
+      gst_srtp_dec_push_early_events (filter, filter->rtcp_srcpad,
+          filter->rtp_srcpad, TRUE);
+    return filter->rtcp_srcpad;
+  } else {
+    if (!filter->rtp_has_segment)
+      gst_srtp_dec_push_early_events (filter, filter->rtp_srcpad,
+          filter->rtcp_srcpad, FALSE);
+    return filter->rtp_srcpad;
+  }
+}
+
 static GstFlowReturn
 gst_srtp_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
     gboolean is_rtcp)
@@ -1268,7 +1306,7 @@ gst_srtp_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
     goto push_out;
   }
 
-  if (!gst_srtp_dec_decode_buffer (filter, pad, buf, is_rtcp, ssrc)) {
+  if (!gst_srtp_dec_decode_buffer (filter, pad, &buf, is_rtcp, ssrc)) {
     GST_OBJECT_UNLOCK (filter);
     goto drop_buffer;
   }
@@ -1281,17 +1319,7 @@ gst_srtp_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
 
 push_out:
   /* Push buffer to source pad */
-  if (is_rtcp) {
-    otherpad = filter->rtcp_srcpad;
-    if (!filter->rtcp_has_segment)
-      gst_srtp_dec_push_early_events (filter, filter->rtcp_srcpad,
-          filter->rtp_srcpad, TRUE);
-  } else {
-    otherpad = filter->rtp_srcpad;
-    if (!filter->rtp_has_segment)
-      gst_srtp_dec_push_early_events (filter, filter->rtp_srcpad,
-          filter->rtcp_srcpad, FALSE);
-  }
+  otherpad = gst_srtp_dec_prepare_srcpad (filter, is_rtcp);
   ret = gst_pad_push (otherpad, buf);
 
   return ret;
@@ -1316,6 +1344,123 @@ gst_srtp_dec_chain_rtcp (GstPad * pad, GstObject * parent, GstBuffer * buf)
   return gst_srtp_dec_chain (pad, parent, buf, TRUE);
 }
 
+static gboolean
+decode_buffer_it (GstBuffer ** buffer, guint index, gpointer user_data)
+{
+  ProcessBufferItData *data = user_data;
+  GstSrtpDec *filter = data->filter;
+  GstSrtpDecSsrcStream *stream;
+  GstBuffer *buf = *buffer;
+  gboolean is_rtcp = data->is_rtcp;
+  guint32 ssrc = 0;
+
+  /* Take the buffer out of the list, so it can be unprotected in place */
+  *buffer = NULL;
+
+  if (!(stream = validate_buffer (filter, buf, &ssrc, &is_rtcp))) {
+    GST_WARNING_OBJECT (filter, "Invalid buffer, dropping");
+    gst_buffer_unref (buf);
+    return TRUE;
+  }
+
+  if (STREAM_HAS_CRYPTO (stream)) {
+    if (!gst_srtp_dec_decode_buffer (filter, data->pad, &buf, is_rtcp, ssrc)) {
+      gst_buffer_unref (buf);
+      return TRUE;
+    }
+
+    /* If all is well, we may have reached soft limit. The key is requested
+     * once the whole list has been processed. */
+    if (gst_srtp_get_soft_limit_reached ()) {
+      if (!data->soft_limit_ssrcs)
+        data->soft_limit_ssrcs = g_array_new (FALSE, FALSE, sizeof (guint32));
+      if (data->soft_limit_ssrcs->len == 0 ||
+          g_array_index (data->soft_limit_ssrcs, guint32,
+              data->soft_limit_ssrcs->len - 1) != ssrc)
+        g_array_append_val (data->soft_limit_ssrcs, ssrc);
+    }
+  }
+
+  gst_buffer_list_add (is_rtcp ? data->rtcp_list : data->rtp_list, buf);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_srtp_dec_push_list (GstSrtpDec * filter, GstBufferList * buf_list,
+    gboolean is_rtcp)
+{
+  GstPad *otherpad;
+
+  if (!gst_buffer_list_length (buf_list)) {
+    gst_buffer_list_unref (buf_list);
+    return GST_FLOW_OK;
+  }
+
+  otherpad = gst_srtp_dec_prepare_srcpad (filter, is_rtcp);
+  return gst_pad_push_list (otherpad, buf_list);
+}
+
+static GstFlowReturn
+gst_srtp_dec_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * buf_list, gboolean is_rtcp)
+{
+  GstSrtpDec *filter = GST_SRTP_DEC (parent);
+  GstFlowReturn ret, other_ret;
+  ProcessBufferItData process_data;
+  guint i, len;
+
+  len = gst_buffer_list_length (buf_list);
+  GST_LOG_OBJECT (pad, "Buffer chain with list of %u", len);
+
+  process_data.filter = filter;
+  process_data.pad = pad;
+  process_data.is_rtcp = is_rtcp;
+  /* muxed RTCP packets on the RTP pad and vice versa go to the other pad */
+  process_data.rtp_list = gst_buffer_list_new_sized (is_rtcp ? 0 : len);
+  process_data.rtcp_list = gst_buffer_list_new_sized (is_rtcp ? len : 0);
+  process_data.soft_limit_ssrcs = NULL;
+
+  /* Unprotect the whole list with a single lock */
+  buf_list = gst_buffer_list_make_writable (buf_list);
+  GST_OBJECT_LOCK (filter);
+  gst_buffer_list_foreach (buf_list, decode_buffer_it, &process_data);
+  GST_OBJECT_UNLOCK (filter);
+  gst_buffer_list_unref (buf_list);
+
+  if (process_data.soft_limit_ssrcs) {
+    for (i = 0; i < process_data.soft_limit_ssrcs->len; i++)
+      request_key_with_signal (filter,
+          g_array_index (process_data.soft_limit_ssrcs, guint32, i),
+          SIGNAL_SOFT_LIMIT);
+    g_array_free (process_data.soft_limit_ssrcs, TRUE);
+  }
+
+  if (is_rtcp) {
+    ret = gst_srtp_dec_push_list (filter, process_data.rtcp_list, TRUE);
+    other_ret = gst_srtp_dec_push_list (filter, process_data.rtp_list, FALSE);
+  } else {
+    ret = gst_srtp_dec_push_list (filter, process_data.rtp_list, FALSE);
+    other_ret = gst_srtp_dec_push_list (filter, process_data.rtcp_list, TRUE);
+  }
+
+  return ret != GST_FLOW_OK ? ret : other_ret;
+}
+
+static GstFlowReturn
+gst_srtp_dec_chain_list_rtp (GstPad * pad, GstObject * parent,
+    GstBufferList * buf_list)
+{
+  return gst_srtp_dec_chain_list (pad, parent, buf_list, FALSE);
+}
+
+static GstFlowReturn
+gst_srtp_dec_chain_list_rtcp (GstPad * pad, GstObject * parent,
+    GstBufferList * buf_list)
+{
+  return gst_srtp_dec_chain_list (pad, parent, buf_list, TRUE);
+}
+
 static GstStateChangeReturn
 gst_srtp_dec_change_state (GstElement * element, GstStateChange transition)
 {
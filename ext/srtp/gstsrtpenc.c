@@ -128,6 +128,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_srtp_enc_debug);
 #define DEFAULT_REPLAY_WINDOW_SIZE 128
 #define DEFAULT_ALLOW_REPEAT_TX FALSE
 
+/* Room needed after a packet for srtp_protect() to append its trailer */
+#define SRTP_TRAILER_ROOM (SRTP_MAX_TRAILER_LEN + 10)
+
+/* Protected packets up to this size, including the trailer room, are written
+ * into buffers from our pool */
+#define SRTP_POOL_BUFFER_SIZE (1500 + SRTP_TRAILER_ROOM)
+
 #define HAS_CRYPTO(filter) (filter->rtp_cipher != GST_SRTP_CIPHER_NULL || \
       filter->rtcp_cipher != GST_SRTP_CIPHER_NULL ||                      \
       filter->rtp_auth != GST_SRTP_AUTH_NULL ||                           \
@@ -159,8 +166,8 @@ typedef struct ProcessBufferItData
 {
   GstSrtpEnc *filter;
   GstPad *pad;
-  GstBufferList *out_list;
   gboolean is_rtcp;
+  srtp_err_status_t err;
 } ProcessBufferItData;
 
 /* the capabilities of the inputs and outputs.
@@ -458,6 +465,22 @@ gst_srtp_enc_reset (GstSrtpEnc * filter)
   GST_OBJECT_UNLOCK (filter);
 }
 
+static void
+gst_srtp_enc_clear_pool (GstSrtpEnc * filter)
+{
+  GstBufferPool *pool;
+
+  GST_OBJECT_LOCK (filter);
+  pool = filter->pool;
+  filter->pool = NULL;
+  GST_OBJECT_UNLOCK (filter);
+
+  if (pool) {
+    gst_buffer_pool_set_active (pool, FALSE);
+    gst_object_unref (pool);
+  }
+}
+
 /* Create sinkpad to receive RTP packets from encers
  * and a srcpad for the RTP packets
  */
@@ -602,6 +625,8 @@ gst_srtp_enc_dispose (GObject * object)
     g_hash_table_unref (filter->ssrcs_set);
   filter->ssrcs_set = NULL;
 
+  gst_srtp_enc_clear_pool (filter);
+
   G_OBJECT_CLASS (gst_srtp_enc_parent_class)->dispose (object);
 }
 
@@ -907,6 +932,29 @@ gst_srtp_enc_sink_query (GstPad * pad, GstObject * parent, GstQuery * query,
 
       return TRUE;
     }
+    case GST_QUERY_ALLOCATION:
+    {
+      GstAllocationParams params;
+      GstAllocator *allocator = NULL;
+
+      gst_pad_query_default (pad, parent, query);
+
+      /* Ask upstream to leave room for the trailer after each packet, so
+       * that we can protect it in place */
+      if (gst_query_get_n_allocation_params (query) > 0) {
+        gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
+        params.padding = MAX (params.padding, SRTP_TRAILER_ROOM);
+        gst_query_set_nth_allocation_param (query, 0, allocator, &params);
+        if (allocator)
+          gst_object_unref (allocator);
+      } else {
+        gst_allocation_params_init (&params);
+        params.padding = SRTP_TRAILER_ROOM;
+        gst_query_add_allocation_param (query, NULL, &params);
+      }
+
+      return TRUE;
+    }
     default:
       return gst_pad_query_default (pad, parent, query);
   }
@@ -1029,64 +1077,134 @@ gst_srtp_enc_check_set_caps (GstSrtpEnc * filter, GstPad * pad,
   return GST_FLOW_OK;
 }
 
+/* Returns a writable buffer with the packet of @buf followed by room for the
+ * trailer, taking ownership of @buf. This is @buf itself if it is writable and
+ * already has enough room after the packet, a pooled copy otherwise. */
 static GstBuffer *
-gst_srtp_enc_process_buffer (GstSrtpEnc * filter, GstPad * pad,
-    GstBuffer * buf, gboolean is_rtcp)
+gst_srtp_enc_prepare_buffer (GstSrtpEnc * filter, GstBuffer * buf)
 {
-  gint size_max, size;
+  gsize size, size_max, offset, maxsize;
   GstBuffer *bufout = NULL;
+  GstBufferPool *pool = NULL;
   GstMapInfo mapout;
-  srtp_err_status_t err;
 
-  /* Create a bigger buffer to add protection */
   size = gst_buffer_get_size (buf);
-  size_max = size + SRTP_MAX_TRAILER_LEN + 10;
-  bufout = gst_buffer_new_allocate (NULL, size_max, NULL);
+  size_max = size + SRTP_TRAILER_ROOM;
 
-  gst_buffer_map (bufout, &mapout, GST_MAP_READWRITE);
+  if (gst_buffer_is_writable (buf) && gst_buffer_n_memory (buf) == 1) {
+    GstMemory *mem = gst_buffer_peek_memory (buf, 0);
 
-  gst_buffer_extract (buf, 0, mapout.data, size);
+    gst_memory_get_sizes (mem, &offset, &maxsize);
+    if (gst_memory_is_writable (mem) && !GST_MEMORY_IS_READONLY (mem) &&
+        maxsize - offset >= size_max) {
+      gst_buffer_set_size (buf, size_max);
+      return buf;
+    }
+  }
 
-  GST_OBJECT_LOCK (filter);
+  if (size_max <= SRTP_POOL_BUFFER_SIZE) {
+    GST_OBJECT_LOCK (filter);
+    if (filter->pool == NULL) {
+      GstStructure *config;
+
+      filter->pool = gst_buffer_pool_new ();
+      config = gst_buffer_pool_get_config (filter->pool);
+      gst_buffer_pool_config_set_params (config, NULL, SRTP_POOL_BUFFER_SIZE,
+          0, 0);
+      gst_buffer_pool_set_config (filter->pool, config);
+      gst_buffer_pool_set_active (filter->pool, TRUE);
+    }
+    pool = gst_object_ref (filter->pool);
+    GST_OBJECT_UNLOCK (filter);
 
-  gst_srtp_init_event_reporter ();
+    gst_buffer_pool_acquire_buffer (pool, &bufout, NULL);
+    gst_object_unref (pool);
+  }
 
-  if (is_rtcp)
-    err = srtp_protect_rtcp (filter->session, mapout.data, &size);
+  if (bufout)
+    gst_buffer_set_size (bufout, size_max);
   else
-    err = srtp_protect (filter->session, mapout.data, &size);
-
-  GST_OBJECT_UNLOCK (filter);
+    bufout = gst_buffer_new_allocate (NULL, size_max, NULL);
 
+  gst_buffer_map (bufout, &mapout, GST_MAP_WRITE);
+  gst_buffer_extract (buf, 0, mapout.data, size);
   gst_buffer_unmap (bufout, &mapout);
 
-  if (err == srtp_err_status_ok) {
-    /* Buffer protected */
-    gst_buffer_set_size (bufout, size);
-    gst_buffer_copy_into (bufout, buf, GST_BUFFER_COPY_METADATA, 0, -1);
+  gst_buffer_copy_into (bufout, buf, GST_BUFFER_COPY_METADATA, 0, -1);
+  gst_buffer_unref (buf);
+
+  return bufout;
+}
+
+/* Protects the packet in a buffer returned by gst_srtp_enc_prepare_buffer()
+ * and trims it to the protected size. Must be called with the object lock
+ * held. */
+static srtp_err_status_t
+gst_srtp_enc_protect_buffer (GstSrtpEnc * filter, GstBuffer * buf,
+    gboolean is_rtcp)
+{
+  GstMapInfo map;
+  srtp_err_status_t err;
+  gint size;
+
+  gst_buffer_map (buf, &map, GST_MAP_READWRITE);
+  size = map.size - SRTP_TRAILER_ROOM;
+
+  if (is_rtcp)
+    err = srtp_protect_rtcp (filter->session, map.data, &size);
+  else
+    err = srtp_protect (filter->session, map.data, &size);
 
-    GST_LOG_OBJECT (pad, "Encoding %s buffer of size %d",
-        is_rtcp ? "RTCP" : "RTP", size);
+  gst_buffer_unmap (buf, &map);
 
-  } else if (err == srtp_err_status_key_expired) {
+  if (err == srtp_err_status_ok)
+    gst_buffer_set_size (buf, size);
 
+  return err;
+}
+
+static void
+gst_srtp_enc_post_protect_error (GstSrtpEnc * filter, srtp_err_status_t err)
+{
+  if (err == srtp_err_status_key_expired) {
     GST_ELEMENT_ERROR (GST_ELEMENT_CAST (filter), STREAM, ENCODE,
         ("Key usage limit has been reached"),
         ("Unable to protect buffer (hard key usage limit reached)"));
-    goto fail;
-
   } else {
     /* srtp_protect failed */
     GST_ELEMENT_ERROR (filter, LIBRARY, FAILED, (NULL),
         ("Unable to protect buffer (protect failed) code %d", err));
-    goto fail;
   }
+}
 
-  return bufout;
+/* Takes ownership of @buf */
+static GstBuffer *
+gst_srtp_enc_process_buffer (GstSrtpEnc * filter, GstPad * pad,
+    GstBuffer * buf, gboolean is_rtcp)
+{
+  GstBuffer *bufout;
+  srtp_err_status_t err;
 
-fail:
-  gst_buffer_unref (bufout);
-  return NULL;
+  bufout = gst_srtp_enc_prepare_buffer (filter, buf);
+
+  GST_OBJECT_LOCK (filter);
+
+  gst_srtp_init_event_reporter ();
+
+  err = gst_srtp_enc_protect_buffer (filter, bufout, is_rtcp);
+
+  GST_OBJECT_UNLOCK (filter);
+
+  if (err != srtp_err_status_ok) {
+    gst_srtp_enc_post_protect_error (filter, err);
+    gst_buffer_unref (bufout);
+    return NULL;
+  }
+
+  GST_LOG_OBJECT (pad, "Encoding %s buffer of size %" G_GSIZE_FORMAT,
+      is_rtcp ? "RTCP" : "RTP", gst_buffer_get_size (bufout));
+
+  return bufout;
 }
 
 static GstFlowReturn
@@ -1112,7 +1230,10 @@ gst_srtp_enc_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
 
   GST_OBJECT_UNLOCK (filter);
 
-  if ((bufout = gst_srtp_enc_process_buffer (filter, pad, buf, is_rtcp))) {
+  bufout = gst_srtp_enc_process_buffer (filter, pad, buf, is_rtcp);
+  buf = NULL;
+
+  if (bufout) {
     /* Push buffer to source pad */
     otherpad = get_rtp_other_pad (pad);
     ret = gst_pad_push (otherpad, bufout);
@@ -1138,7 +1259,8 @@ gst_srtp_enc_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
 
 out:
 
-  gst_buffer_unref (buf);
+  if (buf)
+    gst_buffer_unref (buf);
 
   return ret;
 
@@ -1148,17 +1270,28 @@ fail:
 }
 
 static gboolean
-process_buffer_it (GstBuffer ** buffer, guint index, gpointer user_data)
+prepare_buffer_it (GstBuffer ** buffer, guint index, gpointer user_data)
 {
   ProcessBufferItData *data = user_data;
-  GstBuffer *bufout;
 
-  if ((bufout =
-          gst_srtp_enc_process_buffer (data->filter, data->pad, *buffer,
-              data->is_rtcp))) {
-    gst_buffer_list_add (data->out_list, bufout);
-  } else {
-    GST_WARNING_OBJECT (data->filter, "Error encoding buffer, dropping");
+  *buffer = gst_srtp_enc_prepare_buffer (data->filter, *buffer);
+
+  return TRUE;
+}
+
+static gboolean
+protect_buffer_it (GstBuffer ** buffer, guint index, gpointer user_data)
+{
+  ProcessBufferItData *data = user_data;
+  srtp_err_status_t err;
+
+  err = gst_srtp_enc_protect_buffer (data->filter, *buffer, data->is_rtcp);
+  if (err != srtp_err_status_ok) {
+    /* Remember the first error, it is posted once the lock is released */
+    if (data->err == srtp_err_status_ok)
+      data->err = err;
+    gst_buffer_unref (*buffer);
+    *buffer = NULL;
   }
 
   return TRUE;
@@ -1171,7 +1304,6 @@ gst_srtp_enc_chain_list (GstPad * pad, GstObject * parent,
   GstSrtpEnc *filter = GST_SRTP_ENC (parent);
   GstFlowReturn ret = GST_FLOW_OK;
   GstPad *otherpad;
-  GstBufferList *out_list = NULL;
   ProcessBufferItData process_data;
 
   GST_LOG_OBJECT (pad, "Buffer chain with list of %d",
@@ -1193,17 +1325,27 @@ gst_srtp_enc_chain_list (GstPad * pad, GstObject * parent,
 
   GST_OBJECT_UNLOCK (filter);
 
-  out_list = gst_buffer_list_new ();
-
   process_data.filter = filter;
   process_data.pad = pad;
   process_data.is_rtcp = is_rtcp;
-  process_data.out_list = out_list;
+  process_data.err = srtp_err_status_ok;
 
-  gst_buffer_list_foreach (buf_list, process_buffer_it, &process_data);
+  /* Copy the packets where needed outside of the lock, then protect the
+   * whole list in one go */
+  buf_list = gst_buffer_list_make_writable (buf_list);
+  gst_buffer_list_foreach (buf_list, prepare_buffer_it, &process_data);
+
+  GST_OBJECT_LOCK (filter);
+  gst_srtp_init_event_reporter ();
+  gst_buffer_list_foreach (buf_list, protect_buffer_it, &process_data);
+  GST_OBJECT_UNLOCK (filter);
+
+  if (process_data.err != srtp_err_status_ok) {
+    GST_WARNING_OBJECT (filter, "Error encoding buffers, dropping");
+    gst_srtp_enc_post_protect_error (filter, process_data.err);
+  }
 
-  if (!gst_buffer_list_length (out_list)) {
-    gst_buffer_list_unref (out_list);
+  if (!gst_buffer_list_length (buf_list)) {
     ret = GST_FLOW_OK;
     goto out;
   }
@@ -1212,7 +1354,8 @@ gst_srtp_enc_chain_list (GstPad * pad, GstObject * parent,
   otherpad = get_rtp_other_pad (pad);
   GST_LOG_OBJECT (pad, "Pushing buffer chain of %d",
       gst_buffer_list_length (buf_list));
-  ret = gst_pad_push_list (otherpad, out_list);
+  ret = gst_pad_push_list (otherpad, buf_list);
+  buf_list = NULL;
 
   if (ret != GST_FLOW_OK) {
     goto out;
@@ -1232,7 +1375,8 @@ gst_srtp_enc_chain_list (GstPad * pad, GstObject * parent,
 
 out:
 
-  gst_buffer_list_unref (buf_list);
+  if (buf_list)
+    gst_buffer_list_unref (buf_list);
 
   return ret;
 }
@@ -1316,6 +1460,7 @@ gst_srtp_enc_change_state (GstElement * element, GstStateChange transition)
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       gst_srtp_enc_reset (filter);
+      gst_srtp_enc_clear_pool (filter);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
       break;
@@ -193,6 +193,8 @@ enum
   ON_NEGOTIATION_NEEDED_SIGNAL,
   ON_ICE_CANDIDATE_SIGNAL,
   GET_STATS_SIGNAL,
+  GET_STATS_SNAPSHOT_SIGNAL,
+  ON_STATS_SIGNAL,
   ADD_TRANSCEIVER_SIGNAL,
   GET_TRANSCEIVERS_SIGNAL,
   LAST_SIGNAL,
@@ -213,6 +215,7 @@ enum
   PROP_PENDING_REMOTE_DESCRIPTION,
   PROP_STUN_SERVER,
   PROP_TURN_SERVER,
+  PROP_STATS_INTERVAL,
 };
 
 static guint gst_webrtc_bin_signals[LAST_SIGNAL] = { 0 };
@@ -2659,18 +2662,21 @@ _on_ice_candidate (GstWebRTCICE * ice, guint session_id,
 
 /* https://www.w3.org/TR/webrtc/#dfn-stats-selection-algorithm */
 static GstStructure *
-_get_stats_from_selector (GstWebRTCBin * webrtc, gpointer selector)
+_get_stats_from_selector (GstWebRTCBin * webrtc, gpointer selector,
+    guint types, const guint64 * since)
 {
   if (selector)
     GST_FIXME_OBJECT (webrtc, "Implement stats selection");
 
-  return gst_structure_copy (webrtc->priv->stats);
+  return gst_webrtc_bin_create_stats_report (webrtc, types, since);
 }
 
 struct get_stats
 {
   GstPad *pad;
   GstPromise *promise;
+  guint types;
+  gboolean only_changed;
 };
 
 static void
@@ -2684,14 +2690,11 @@ _free_get_stats (struct get_stats *stats)
 }
 
 /* https://www.w3.org/TR/webrtc/#dom-rtcpeerconnection-getstats() */
-static void
-_get_stats_task (GstWebRTCBin * webrtc, struct get_stats *stats)
+static gpointer
+_get_stats_selector (struct get_stats *stats)
 {
-  GstStructure *s;
   gpointer selector = NULL;
 
-  gst_webrtc_bin_update_stats (webrtc);
-
   if (stats->pad) {
     GstWebRTCBinPad *wpad = GST_WEBRTC_BIN_PAD (stats->pad);
 
@@ -2704,7 +2707,49 @@ _get_stats_task (GstWebRTCBin * webrtc, struct get_stats *stats)
     }
   }
 
-  s = _get_stats_from_selector (webrtc, selector);
+  return selector;
+}
+
+static void
+_get_stats_task (GstWebRTCBin * webrtc, struct get_stats *stats)
+{
+  GstStructure *s;
+
+  gst_webrtc_bin_update_stats (webrtc);
+
+  s = _get_stats_from_selector (webrtc, _get_stats_selector (stats), 0, NULL);
+  gst_promise_reply (stats->promise, s);
+}
+
+/* Marks the stats of the types in @types (0 for all) as reported up to the
+ * current collection in @generations */
+static void
+_advance_stats_generations (GstWebRTCBin * webrtc, guint64 * generations,
+    guint types)
+{
+  guint i;
+
+  for (i = 0; i < GST_WEBRTC_STATS_N_TYPES; i++) {
+    if (types == 0 || (types & (1 << i)))
+      generations[i] = webrtc->priv->stats_generation;
+  }
+}
+
+static void
+_get_stats_snapshot_task (GstWebRTCBin * webrtc, struct get_stats *stats)
+{
+  GstWebRTCBinPrivate *priv = webrtc->priv;
+  GstStructure *s;
+
+  gst_webrtc_bin_update_stats (webrtc);
+
+  /* every type has its own baseline, a snapshot of some types must not hide
+   * the changes of the others from the next snapshot of those */
+  s = _get_stats_from_selector (webrtc, _get_stats_selector (stats),
+      stats->types,
+      stats->only_changed ? priv->stats_snapshot_generations : NULL);
+  _advance_stats_generations (webrtc, priv->stats_snapshot_generations,
+      stats->types);
   gst_promise_reply (stats->promise, s);
 }
 
@@ -2727,6 +2772,78 @@ gst_webrtc_bin_get_stats (GstWebRTCBin * webrtc, GstPad * pad,
       stats, (GDestroyNotify) _free_get_stats);
 }
 
+static void
+gst_webrtc_bin_get_stats_snapshot (GstWebRTCBin * webrtc, GstPad * pad,
+    guint types, gboolean only_changed, GstPromise * promise)
+{
+  struct get_stats *stats;
+
+  g_return_if_fail (promise != NULL);
+  g_return_if_fail (pad == NULL || GST_IS_WEBRTC_BIN_PAD (pad));
+
+  stats = g_new0 (struct get_stats, 1);
+  stats->promise = gst_promise_ref (promise);
+  if (pad)
+    stats->pad = gst_object_ref (pad);
+  stats->types = types;
+  stats->only_changed = only_changed;
+
+  gst_webrtc_bin_enqueue_task (webrtc,
+      (GstWebRTCBinFunc) _get_stats_snapshot_task, stats,
+      (GDestroyNotify) _free_get_stats);
+}
+
+/* One timer per webrtcbin collects the stats of all transceivers at once
+ * and emits those that changed since the previous time */
+static gboolean
+_on_stats_timeout (GstWebRTCBin * webrtc)
+{
+  GstStructure *s;
+
+  PC_LOCK (webrtc);
+  if (webrtc->priv->is_closed) {
+    PC_UNLOCK (webrtc);
+    return G_SOURCE_CONTINUE;
+  }
+
+  gst_webrtc_bin_update_stats (webrtc);
+  s = gst_webrtc_bin_create_stats_report (webrtc, 0,
+      webrtc->priv->stats_periodic_generations);
+  _advance_stats_generations (webrtc, webrtc->priv->stats_periodic_generations,
+      0);
+  PC_UNLOCK (webrtc);
+
+  if (gst_structure_n_fields (s) > 0)
+    g_signal_emit (webrtc, gst_webrtc_bin_signals[ON_STATS_SIGNAL], 0, s);
+  gst_structure_free (s);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Must be called with the pc lock held */
+static void
+_update_stats_source (GstWebRTCBin * webrtc)
+{
+  GstWebRTCBinPrivate *priv = webrtc->priv;
+
+  if (priv->stats_source) {
+    g_source_destroy (priv->stats_source);
+    g_source_unref (priv->stats_source);
+    priv->stats_source = NULL;
+  }
+
+  if (priv->stats_interval > 0 && priv->main_context && !priv->is_closed) {
+    /* report everything on the first tick */
+    memset (priv->stats_periodic_generations, 0,
+        sizeof (priv->stats_periodic_generations));
+
+    priv->stats_source = g_timeout_source_new (priv->stats_interval);
+    g_source_set_callback (priv->stats_source, (GSourceFunc) _on_stats_timeout,
+        webrtc, NULL);
+    g_source_attach (priv->stats_source, priv->main_context);
+  }
+}
+
 static GstWebRTCRTPTransceiver *
 gst_webrtc_bin_add_transceiver (GstWebRTCBin * webrtc,
     GstWebRTCRTPTransceiverDirection direction, GstCaps * caps)
@@ -3058,6 +3175,12 @@ gst_webrtc_bin_set_property (GObject * object, guint prop_id,
     case PROP_TURN_SERVER:
       g_object_set_property (G_OBJECT (webrtc->priv->ice), pspec->name, value);
       break;
+    case PROP_STATS_INTERVAL:
+      PC_LOCK (webrtc);
+      webrtc->priv->stats_interval = g_value_get_uint (value);
+      _update_stats_source (webrtc);
+      PC_UNLOCK (webrtc);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -3116,6 +3239,9 @@ gst_webrtc_bin_get_property (GObject * object, guint prop_id,
     case PROP_TURN_SERVER:
       g_object_get_property (G_OBJECT (webrtc->priv->ice), pspec->name, value);
       break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, webrtc->priv->stats_interval);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -3134,6 +3260,11 @@ gst_webrtc_bin_dispose (GObject * object)
 {
   GstWebRTCBin *webrtc = GST_WEBRTC_BIN (object);
 
+  PC_LOCK (webrtc);
+  webrtc->priv->stats_interval = 0;
+  _update_stats_source (webrtc);
+  PC_UNLOCK (webrtc);
+
   _stop_thread (webrtc);
 
   if (webrtc->priv->ice)
@@ -3187,9 +3318,7 @@ gst_webrtc_bin_finalize (GObject * object)
     gst_webrtc_session_description_free (webrtc->pending_remote_description);
   webrtc->pending_remote_description = NULL;
 
-  if (webrtc->priv->stats)
-    gst_structure_free (webrtc->priv->stats);
-  webrtc->priv->stats = NULL;
+  gst_webrtc_bin_clear_stats (webrtc);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -3244,6 +3373,13 @@ gst_webrtc_bin_class_init (GstWebRTCBinClass * klass)
           "The TURN server of the form turn(s)://username:password@host:port",
           NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Stats interval",
+          "Interval in milliseconds at which the stats that changed are "
+          "emitted with the on-stats signal (0 = disabled)",
+          0, G_MAXUINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class,
       PROP_CONNECTION_STATE,
       g_param_spec_enum ("connection-state", "Connection State",
@@ -3417,6 +3553,43 @@ gst_webrtc_bin_class_init (GstWebRTCBinClass * klass)
       g_cclosure_marshal_generic, G_TYPE_NONE, 2, GST_TYPE_PAD,
       GST_TYPE_PROMISE);
 
+  /**
+   * GstWebRTCBin::get-stats-snapshot:
+   * @object: the #GstWebRtcBin
+   * @pad: (nullable): a #GstPad to select the statistics of, or %NULL
+   * @types: mask of (1 << #GstWebRTCStatsType) values to retrieve, or 0 for
+   *   all types
+   * @only-changed: only retrieve the statistics that changed since the
+   *   previous get-stats-snapshot that retrieved their type
+   * @promise: a #GstPromise for the result
+   *
+   * Like #GstWebRTCBin::get-stats but restricted to the selected types of
+   * statistics and, optionally, to the statistics that changed since the
+   * previous call.  This is cheaper than #GstWebRTCBin::get-stats when
+   * polling regularly.
+   */
+  gst_webrtc_bin_signals[GET_STATS_SNAPSHOT_SIGNAL] =
+      g_signal_new_class_handler ("get-stats-snapshot",
+      G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_CALLBACK (gst_webrtc_bin_get_stats_snapshot), NULL, NULL,
+      g_cclosure_marshal_generic, G_TYPE_NONE, 4, GST_TYPE_PAD, G_TYPE_UINT,
+      G_TYPE_BOOLEAN, GST_TYPE_PROMISE);
+
+  /**
+   * GstWebRTCBin::on-stats:
+   * @object: the #GstWebRtcBin
+   * @stats: the statistics that changed, in the format of
+   *   #GstWebRTCBin::get-stats
+   *
+   * Emitted every #GstWebRTCBin:stats-interval milliseconds from the
+   * peerconnection thread with the statistics that changed since the
+   * previous emission.  The first emission contains all of them.
+   */
+  gst_webrtc_bin_signals[ON_STATS_SIGNAL] =
+      g_signal_new ("on-stats", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_generic,
+      G_TYPE_NONE, 1, GST_TYPE_STRUCTURE | G_SIGNAL_TYPE_STATIC_SCOPE);
+
   /**
    * GstWebRTCBin::on-negotiation-needed:
    * @object: the #GstWebRtcBin
@@ -96,6 +96,9 @@ struct _GstWebRTCBinClass
   GstBinClass           parent_class;
 };
 
+/* number of GstWebRTCStatsType values, including the unused 0 */
+#define GST_WEBRTC_STATS_N_TYPES (GST_WEBRTC_STATS_CERTIFICATE + 1)
+
 struct _GstWebRTCBinPrivate
 {
   guint max_sink_pad_serial;
@@ -130,7 +133,16 @@ struct _GstWebRTCBinPrivate
   /* FIXME: overflow? */
   guint media_counter;
 
-  GstStructure *stats;
+  /* WebRTCStatsEntry by id, only accessed from the peerconnection thread */
+  GHashTable *stats_entries;
+  /* number of the last stats collection */
+  guint64 stats_generation;
+  /* per GstWebRTCStatsType, collections the last get-stats-snapshot and
+   * on-stats reports of that type were created from */
+  guint64 stats_snapshot_generations[GST_WEBRTC_STATS_N_TYPES];
+  guint64 stats_periodic_generations[GST_WEBRTC_STATS_N_TYPES];
+  guint stats_interval;
+  GSource *stats_source;
 };
 
 typedef void (*GstWebRTCBinFunc) (GstWebRTCBin * webrtc, gpointer data);
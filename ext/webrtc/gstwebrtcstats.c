@@ -31,6 +31,8 @@
 #include "utils.h"
 #include "webrtctransceiver.h"
 
+#include <string.h>
+
 #define GST_CAT_DEFAULT gst_webrtc_stats_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
@@ -68,17 +70,214 @@ _set_base_stats (GstStructure * s, GstWebRTCStatsType type, double ts,
   g_free (name);
 }
 
-static GstStructure *
-_get_peer_connection_stats (GstWebRTCBin * webrtc)
+/* Stats are collected into a cache of plain counter structs, one entry per
+ * RTCStats object (or per RTP source, which maps to four RTCStats objects).
+ * The GstStructure for an entry is only built when a report asks for it and
+ * is kept until the counters change, so that polling mostly copies cached
+ * structures and reports can be restricted to the entries that changed. */
+
+typedef enum
 {
-  GstStructure *s = gst_structure_new_empty ("unused");
+  STATS_ENTRY_PEER_CONNECTION,
+  STATS_ENTRY_CODEC,
+  STATS_ENTRY_TRANSPORT,
+  STATS_ENTRY_CANDIDATE_PAIR,
+  STATS_ENTRY_RTP_SOURCE,
+} StatsEntryKind;
+
+enum
+{
+  HAVE_RECV_FIR = (1 << 0),
+  HAVE_RECV_PLI = (1 << 1),
+  HAVE_RECV_NACK = (1 << 2),
+  HAVE_SENT_FIR = (1 << 3),
+  HAVE_SENT_PLI = (1 << 4),
+  HAVE_SENT_NACK = (1 << 5),
+  HAVE_PACKETS_RECEIVED = (1 << 6),
+  HAVE_OCTETS_RECEIVED = (1 << 7),
+  HAVE_PACKETS_LOST = (1 << 8),
+  HAVE_JITTER = (1 << 9),
+  HAVE_RB_JITTER = (1 << 10),
+  HAVE_RB_PACKETS_LOST = (1 << 11),
+  HAVE_RB_ROUND_TRIP = (1 << 12),
+  HAVE_OCTETS_SENT = (1 << 13),
+  HAVE_PACKETS_SENT = (1 << 14),
+};
+
+typedef struct
+{
+  guint have;
+  guint32 ssrc;
+  gint clock_rate;
+  gboolean have_rb;
+  gboolean sent_rb;
+  guint recv_fir, recv_pli, recv_nack;
+  guint sent_fir, sent_pli, sent_nack;
+  guint64 packets_received, octets_received;
+  guint64 packets_sent, octets_sent;
+  gint packets_lost, rb_packets_lost;
+  guint jitter, rb_jitter;
+  guint32 rb_round_trip;
+} RTPSourceCounters;
+
+enum
+{
+  HAVE_PAYLOAD_TYPE = (1 << 0),
+  HAVE_CLOCK_RATE = (1 << 1),
+};
+
+typedef struct
+{
+  guint have;
+  guint payload_type;
+  guint clock_rate;
+} CodecCounters;
+
+typedef union
+{
+  RTPSourceCounters rtp;
+  CodecCounters codec;
+} StatsCounters;
+
+/* RTP sources produce inbound, outbound, remote-inbound and remote-outbound
+ * stats */
+#define MAX_ENTRY_STATS 4
+
+struct _WebRTCStatsEntry
+{
+  StatsEntryKind kind;
+  guint n_stats;
+  GstWebRTCStatsType types[MAX_ENTRY_STATS];
+  gchar *ids[MAX_ENTRY_STATS];
+  GstStructure *cache[MAX_ENTRY_STATS];
+
+  gchar *codec_id;
+  gchar *transport_id;
+  StatsCounters counters;
+
+  /* collection the counters last changed in */
+  guint64 changed;
+  /* last collection the entry was still present in */
+  guint64 seen;
+};
+
+static WebRTCStatsEntry *
+_stats_entry_new (StatsEntryKind kind, const gchar * id,
+    const StatsCounters * counters)
+{
+  WebRTCStatsEntry *entry = g_new0 (WebRTCStatsEntry, 1);
+
+  entry->kind = kind;
+  entry->n_stats = 1;
+  entry->ids[0] = g_strdup (id);
+
+  switch (kind) {
+    case STATS_ENTRY_PEER_CONNECTION:
+      entry->types[0] = GST_WEBRTC_STATS_PEER_CONNECTION;
+      break;
+    case STATS_ENTRY_CODEC:
+      entry->types[0] = GST_WEBRTC_STATS_CODEC;
+      break;
+    case STATS_ENTRY_TRANSPORT:
+    case STATS_ENTRY_CANDIDATE_PAIR:
+      entry->types[0] = GST_WEBRTC_STATS_TRANSPORT;
+      break;
+    case STATS_ENTRY_RTP_SOURCE:{
+      guint32 ssrc = counters->rtp.ssrc;
+
+      entry->n_stats = 4;
+      entry->types[0] = GST_WEBRTC_STATS_INBOUND_RTP;
+      entry->types[1] = GST_WEBRTC_STATS_OUTBOUND_RTP;
+      entry->types[2] = GST_WEBRTC_STATS_REMOTE_INBOUND_RTP;
+      entry->types[3] = GST_WEBRTC_STATS_REMOTE_OUTBOUND_RTP;
+      entry->ids[1] = g_strdup_printf ("rtp-outbound-stream-stats_%u", ssrc);
+      entry->ids[2] =
+          g_strdup_printf ("rtp-remote-inbound-stream-stats_%u", ssrc);
+      entry->ids[3] =
+          g_strdup_printf ("rtp-remote-outbound-stream-stats_%u", ssrc);
+      break;
+    }
+  }
+
+  return entry;
+}
+
+static void
+_stats_entry_clear_cache (WebRTCStatsEntry * entry)
+{
+  guint i;
+
+  for (i = 0; i < entry->n_stats; i++) {
+    if (entry->cache[i])
+      gst_structure_free (entry->cache[i]);
+    entry->cache[i] = NULL;
+  }
+}
+
+static void
+_stats_entry_free (WebRTCStatsEntry * entry)
+{
+  guint i;
+
+  _stats_entry_clear_cache (entry);
+  for (i = 0; i < entry->n_stats; i++)
+    g_free (entry->ids[i]);
+  g_free (entry->codec_id);
+  g_free (entry->transport_id);
+  g_free (entry);
+}
+
+/* Updates or adds the entry with the given id, marking it as changed in the
+ * current collection if any of its values differ from the previous one */
+static void
+_update_stats_entry (GstWebRTCBin * webrtc, StatsEntryKind kind,
+    const gchar * id, const StatsCounters * counters, const gchar * codec_id,
+    const gchar * transport_id)
+{
+  GstWebRTCBinPrivate *priv = webrtc->priv;
+  StatsCounters zero;
+  WebRTCStatsEntry *entry;
+
+  if (!counters) {
+    memset (&zero, 0, sizeof (zero));
+    counters = &zero;
+  }
+
+  entry = g_hash_table_lookup (priv->stats_entries, id);
+  if (!entry) {
+    entry = _stats_entry_new (kind, id, counters);
+    g_hash_table_insert (priv->stats_entries, entry->ids[0], entry);
+  } else if (entry->seen == priv->stats_generation) {
+    /* already collected through another pad in this collection */
+    return;
+  } else if (memcmp (&entry->counters, counters, sizeof (StatsCounters)) == 0
+      && g_strcmp0 (entry->codec_id, codec_id) == 0
+      && g_strcmp0 (entry->transport_id, transport_id) == 0) {
+    entry->seen = priv->stats_generation;
+    return;
+  }
+
+  entry->counters = *counters;
+  if (g_strcmp0 (entry->codec_id, codec_id) != 0) {
+    g_free (entry->codec_id);
+    entry->codec_id = g_strdup (codec_id);
+  }
+  if (g_strcmp0 (entry->transport_id, transport_id) != 0) {
+    g_free (entry->transport_id);
+    entry->transport_id = g_strdup (transport_id);
+  }
+  _stats_entry_clear_cache (entry);
+
+  entry->changed = entry->seen = priv->stats_generation;
+}
 
+static void
+_set_peer_connection_stats (GstStructure * s)
+{
   /* FIXME: datachannel */
   gst_structure_set (s, "data-channels-opened", G_TYPE_UINT, 0,
       "data-channels-closed", G_TYPE_UINT, 0, "data-channels-requested",
       G_TYPE_UINT, 0, "data-channels-accepted", G_TYPE_UINT, 0, NULL);
-
-  return s;
 }
 
 #define CLOCK_RATE_VALUE_TO_SECONDS(v,r) ((double) v / (double) clock_rate)
@@ -86,54 +285,84 @@ _get_peer_connection_stats (GstWebRTCBin * webrtc)
 /* https://www.w3.org/TR/webrtc-stats/#inboundrtpstats-dict*
    https://www.w3.org/TR/webrtc-stats/#outboundrtpstats-dict* */
 static void
-_get_stats_from_rtp_source_stats (GstWebRTCBin * webrtc,
-    const GstStructure * source_stats, const gchar * codec_id,
-    const gchar * transport_id, GstStructure * s)
-{
-  GstStructure *in, *out, *r_in, *r_out;
-  gchar *in_id, *out_id, *r_in_id, *r_out_id;
-  guint ssrc, fir, pli, nack, jitter;
-  int lost, clock_rate;
-  guint64 packets, bytes;
-  gboolean have_rb = FALSE, sent_rb = FALSE;
-  double ts;
-
-  gst_structure_get_double (s, "timestamp", &ts);
-  gst_structure_get_uint (source_stats, "ssrc", &ssrc);
-  gst_structure_get (source_stats, "have-rb", G_TYPE_BOOLEAN, &have_rb,
-      "sent_rb", G_TYPE_BOOLEAN, &sent_rb, "clock-rate", G_TYPE_INT,
-      &clock_rate, NULL);
-
-  in_id = g_strdup_printf ("rtp-inbound-stream-stats_%u", ssrc);
-  out_id = g_strdup_printf ("rtp-outbound-stream-stats_%u", ssrc);
-  r_in_id = g_strdup_printf ("rtp-remote-inbound-stream-stats_%u", ssrc);
-  r_out_id = g_strdup_printf ("rtp-remote-outbound-stream-stats_%u", ssrc);
-
-  in = gst_structure_new_empty (in_id);
-  _set_base_stats (in, GST_WEBRTC_STATS_INBOUND_RTP, ts, in_id);
+_get_counters_from_rtp_source_stats (const GstStructure * source_stats,
+    RTPSourceCounters * c)
+{
+  memset (c, 0, sizeof (RTPSourceCounters));
+
+  gst_structure_get_uint (source_stats, "ssrc", &c->ssrc);
+  gst_structure_get (source_stats, "have-rb", G_TYPE_BOOLEAN, &c->have_rb,
+      "sent_rb", G_TYPE_BOOLEAN, &c->sent_rb, "clock-rate", G_TYPE_INT,
+      &c->clock_rate, NULL);
+
+  if (gst_structure_get_uint (source_stats, "recv-fir-count", &c->recv_fir))
+    c->have |= HAVE_RECV_FIR;
+  if (gst_structure_get_uint (source_stats, "recv-pli-count", &c->recv_pli))
+    c->have |= HAVE_RECV_PLI;
+  if (gst_structure_get_uint (source_stats, "recv-nack-count", &c->recv_nack))
+    c->have |= HAVE_RECV_NACK;
+  if (gst_structure_get_uint (source_stats, "sent-fir-count", &c->sent_fir))
+    c->have |= HAVE_SENT_FIR;
+  if (gst_structure_get_uint (source_stats, "sent-pli-count", &c->sent_pli))
+    c->have |= HAVE_SENT_PLI;
+  if (gst_structure_get_uint (source_stats, "sent-nack-count", &c->sent_nack))
+    c->have |= HAVE_SENT_NACK;
+  if (gst_structure_get_uint64 (source_stats, "packets-received",
+          &c->packets_received))
+    c->have |= HAVE_PACKETS_RECEIVED;
+  if (gst_structure_get_uint64 (source_stats, "octets-received",
+          &c->octets_received))
+    c->have |= HAVE_OCTETS_RECEIVED;
+  if (gst_structure_get_int (source_stats, "packets-lost", &c->packets_lost))
+    c->have |= HAVE_PACKETS_LOST;
+  if (gst_structure_get_uint (source_stats, "jitter", &c->jitter))
+    c->have |= HAVE_JITTER;
+  if (gst_structure_get_uint (source_stats, "sent-rb-jitter", &c->rb_jitter))
+    c->have |= HAVE_RB_JITTER;
+  if (gst_structure_get_int (source_stats, "sent-rb-packetslost",
+          &c->rb_packets_lost))
+    c->have |= HAVE_RB_PACKETS_LOST;
+  if (gst_structure_get_uint (source_stats, "rb-round-trip",
+          &c->rb_round_trip))
+    c->have |= HAVE_RB_ROUND_TRIP;
+  if (gst_structure_get_uint64 (source_stats, "octets-sent", &c->octets_sent))
+    c->have |= HAVE_OCTETS_SENT;
+  if (gst_structure_get_uint64 (source_stats, "packets-sent",
+          &c->packets_sent))
+    c->have |= HAVE_PACKETS_SENT;
+}
+
+static void
+_set_inbound_rtp_stats (WebRTCStatsEntry * entry, GstStructure * in)
+{
+  const RTPSourceCounters *c = &entry->counters.rtp;
+  gint clock_rate = c->clock_rate;
 
   /* RTCStreamStats */
-  gst_structure_set (in, "ssrc", G_TYPE_UINT, ssrc, NULL);
-  gst_structure_set (in, "codec-id", G_TYPE_STRING, codec_id, NULL);
-  gst_structure_set (in, "transport-id", G_TYPE_STRING, transport_id, NULL);
-  if (gst_structure_get_uint (source_stats, "recv-fir-count", &fir))
-    gst_structure_set (in, "fir-count", G_TYPE_UINT, fir, NULL);
-  if (gst_structure_get_uint (source_stats, "recv-pli-count", &pli))
-    gst_structure_set (in, "pli-count", G_TYPE_UINT, pli, NULL);
-  if (gst_structure_get_uint (source_stats, "recv-nack-count", &nack))
-    gst_structure_set (in, "nack-count", G_TYPE_UINT, nack, NULL);
+  gst_structure_set (in, "ssrc", G_TYPE_UINT, c->ssrc, NULL);
+  gst_structure_set (in, "codec-id", G_TYPE_STRING, entry->codec_id, NULL);
+  gst_structure_set (in, "transport-id", G_TYPE_STRING, entry->transport_id,
+      NULL);
+  if (c->have & HAVE_RECV_FIR)
+    gst_structure_set (in, "fir-count", G_TYPE_UINT, c->recv_fir, NULL);
+  if (c->have & HAVE_RECV_PLI)
+    gst_structure_set (in, "pli-count", G_TYPE_UINT, c->recv_pli, NULL);
+  if (c->have & HAVE_RECV_NACK)
+    gst_structure_set (in, "nack-count", G_TYPE_UINT, c->recv_nack, NULL);
   /* XXX: mediaType, trackId, sliCount, qpSum */
 
   /* RTCReceivedRTPStreamStats */
-  if (gst_structure_get_uint64 (source_stats, "packets-received", &packets))
-    gst_structure_set (in, "packets-received", G_TYPE_UINT64, packets, NULL);
-  if (gst_structure_get_uint64 (source_stats, "octets-received", &bytes))
-    gst_structure_set (in, "bytes-received", G_TYPE_UINT64, bytes, NULL);
-  if (gst_structure_get_int (source_stats, "packets-lost", &lost))
-    gst_structure_set (in, "packets-lost", G_TYPE_INT, lost, NULL);
-  if (gst_structure_get_uint (source_stats, "jitter", &jitter))
+  if (c->have & HAVE_PACKETS_RECEIVED)
+    gst_structure_set (in, "packets-received", G_TYPE_UINT64,
+        c->packets_received, NULL);
+  if (c->have & HAVE_OCTETS_RECEIVED)
+    gst_structure_set (in, "bytes-received", G_TYPE_UINT64,
+        c->octets_received, NULL);
+  if (c->have & HAVE_PACKETS_LOST)
+    gst_structure_set (in, "packets-lost", G_TYPE_INT, c->packets_lost, NULL);
+  if (c->have & HAVE_JITTER)
     gst_structure_set (in, "jitter", G_TYPE_DOUBLE,
-        CLOCK_RATE_VALUE_TO_SECONDS (jitter, clock_rate), NULL);
+        CLOCK_RATE_VALUE_TO_SECONDS (c->jitter, clock_rate), NULL);
 /*
     RTCReceivedRTPStreamStats
     double             fractionLost;
@@ -151,25 +380,31 @@ _get_stats_from_rtp_source_stats (GstWebRTCBin * webrtc,
 */
 
   /* RTCInboundRTPStreamStats */
-  gst_structure_set (in, "remote-id", G_TYPE_STRING, r_out_id, NULL);
+  gst_structure_set (in, "remote-id", G_TYPE_STRING, entry->ids[3], NULL);
   /* XXX: framesDecoded, lastPacketReceivedTimestamp */
+}
 
-  r_in = gst_structure_new_empty (r_in_id);
-  _set_base_stats (r_in, GST_WEBRTC_STATS_REMOTE_INBOUND_RTP, ts, r_in_id);
+static void
+_set_remote_inbound_rtp_stats (WebRTCStatsEntry * entry, GstStructure * r_in)
+{
+  const RTPSourceCounters *c = &entry->counters.rtp;
+  gint clock_rate = c->clock_rate;
 
   /* RTCStreamStats */
-  gst_structure_set (r_in, "ssrc", G_TYPE_UINT, ssrc, NULL);
-  gst_structure_set (r_in, "codec-id", G_TYPE_STRING, codec_id, NULL);
-  gst_structure_set (r_in, "transport-id", G_TYPE_STRING, transport_id, NULL);
+  gst_structure_set (r_in, "ssrc", G_TYPE_UINT, c->ssrc, NULL);
+  gst_structure_set (r_in, "codec-id", G_TYPE_STRING, entry->codec_id, NULL);
+  gst_structure_set (r_in, "transport-id", G_TYPE_STRING, entry->transport_id,
+      NULL);
   /* XXX: mediaType, trackId, sliCount, qpSum */
 
   /* RTCReceivedRTPStreamStats */
-  if (sent_rb) {
-    if (gst_structure_get_uint (source_stats, "sent-rb-jitter", &jitter))
+  if (c->sent_rb) {
+    if (c->have & HAVE_RB_JITTER)
       gst_structure_set (r_in, "jitter", G_TYPE_DOUBLE,
-          CLOCK_RATE_VALUE_TO_SECONDS (jitter, clock_rate), NULL);
-    if (gst_structure_get_int (source_stats, "sent-rb-packetslost", &lost))
-      gst_structure_set (r_in, "packets-lost", G_TYPE_INT, lost, NULL);
+          CLOCK_RATE_VALUE_TO_SECONDS (c->rb_jitter, clock_rate), NULL);
+    if (c->have & HAVE_RB_PACKETS_LOST)
+      gst_structure_set (r_in, "packets-lost", G_TYPE_INT, c->rb_packets_lost,
+          NULL);
     /* packetsReceived, bytesReceived */
   } else {
     /* default values */
@@ -192,10 +427,10 @@ _get_stats_from_rtp_source_stats (GstWebRTCBin * webrtc,
 */
 
   /* RTCRemoteInboundRTPStreamStats */
-  gst_structure_set (r_in, "local-id", G_TYPE_STRING, out_id, NULL);
-  if (have_rb) {
-    guint32 rtt;
-    if (gst_structure_get_uint (source_stats, "rb-round-trip", &rtt)) {
+  gst_structure_set (r_in, "local-id", G_TYPE_STRING, entry->ids[1], NULL);
+  if (c->have_rb) {
+    if (c->have & HAVE_RB_ROUND_TRIP) {
+      guint32 rtt = c->rb_round_trip;
       /* 16.16 fixed point to double */
       double val =
           (double) ((rtt & 0xffff0000) >> 16) + ((rtt & 0xffff) / 65536.0);
@@ -206,34 +441,39 @@ _get_stats_from_rtp_source_stats (GstWebRTCBin * webrtc,
     gst_structure_set (r_in, "round-trip-time", G_TYPE_DOUBLE, 0.0, NULL);
   }
   /* XXX: framesDecoded, lastPacketReceivedTimestamp */
+}
 
-  out = gst_structure_new_empty (out_id);
-  _set_base_stats (out, GST_WEBRTC_STATS_OUTBOUND_RTP, ts, out_id);
+static void
+_set_outbound_rtp_stats (WebRTCStatsEntry * entry, GstStructure * out)
+{
+  const RTPSourceCounters *c = &entry->counters.rtp;
 
   /* RTCStreamStats */
-  gst_structure_set (out, "ssrc", G_TYPE_UINT, ssrc, NULL);
-  gst_structure_set (out, "codec-id", G_TYPE_STRING, codec_id, NULL);
-  gst_structure_set (out, "transport-id", G_TYPE_STRING, transport_id, NULL);
-  if (gst_structure_get_uint (source_stats, "sent-fir-count", &fir))
-    gst_structure_set (out, "fir-count", G_TYPE_UINT, fir, NULL);
-  if (gst_structure_get_uint (source_stats, "sent-pli-count", &pli))
-    gst_structure_set (out, "pli-count", G_TYPE_UINT, pli, NULL);
-  if (gst_structure_get_uint (source_stats, "sent-nack-count", &nack))
-    gst_structure_set (out, "nack-count", G_TYPE_UINT, nack, NULL);
+  gst_structure_set (out, "ssrc", G_TYPE_UINT, c->ssrc, NULL);
+  gst_structure_set (out, "codec-id", G_TYPE_STRING, entry->codec_id, NULL);
+  gst_structure_set (out, "transport-id", G_TYPE_STRING, entry->transport_id,
+      NULL);
+  if (c->have & HAVE_SENT_FIR)
+    gst_structure_set (out, "fir-count", G_TYPE_UINT, c->sent_fir, NULL);
+  if (c->have & HAVE_SENT_PLI)
+    gst_structure_set (out, "pli-count", G_TYPE_UINT, c->sent_pli, NULL);
+  if (c->have & HAVE_SENT_NACK)
+    gst_structure_set (out, "nack-count", G_TYPE_UINT, c->sent_nack, NULL);
   /* XXX: mediaType, trackId, sliCount, qpSum */
 
 /* RTCSentRTPStreamStats */
-  if (gst_structure_get_uint64 (source_stats, "octets-sent", &bytes))
-    gst_structure_set (out, "bytes-sent", G_TYPE_UINT64, bytes, NULL);
-  if (gst_structure_get_uint64 (source_stats, "packets-sent", &packets))
-    gst_structure_set (out, "packets-sent", G_TYPE_UINT64, packets, NULL);
+  if (c->have & HAVE_OCTETS_SENT)
+    gst_structure_set (out, "bytes-sent", G_TYPE_UINT64, c->octets_sent, NULL);
+  if (c->have & HAVE_PACKETS_SENT)
+    gst_structure_set (out, "packets-sent", G_TYPE_UINT64, c->packets_sent,
+        NULL);
 /* XXX:
     unsigned long      packetsDiscardedOnSend;
     unsigned long long bytesDiscardedOnSend;
 */
 
   /* RTCOutboundRTPStreamStats */
-  gst_structure_set (out, "remote-id", G_TYPE_STRING, r_in_id, NULL);
+  gst_structure_set (out, "remote-id", G_TYPE_STRING, entry->ids[2], NULL);
 /* XXX:
     DOMHighResTimeStamp lastPacketSentTimestamp;
     double              targetBitrate;
@@ -241,58 +481,96 @@ _get_stats_from_rtp_source_stats (GstWebRTCBin * webrtc,
     double              totalEncodeTime;
     double              averageRTCPInterval;
 */
+}
+
+static void
+_set_remote_outbound_rtp_stats (WebRTCStatsEntry * entry,
+    GstStructure * r_out)
+{
+  const RTPSourceCounters *c = &entry->counters.rtp;
 
-  r_out = gst_structure_new_empty (r_out_id);
-  _set_base_stats (r_out, GST_WEBRTC_STATS_REMOTE_OUTBOUND_RTP, ts, r_out_id);
   /* RTCStreamStats */
-  gst_structure_set (r_out, "ssrc", G_TYPE_UINT, ssrc, NULL);
-  gst_structure_set (r_out, "codec-id", G_TYPE_STRING, codec_id, NULL);
-  gst_structure_set (r_out, "transport-id", G_TYPE_STRING, transport_id, NULL);
+  gst_structure_set (r_out, "ssrc", G_TYPE_UINT, c->ssrc, NULL);
+  gst_structure_set (r_out, "codec-id", G_TYPE_STRING, entry->codec_id, NULL);
+  gst_structure_set (r_out, "transport-id", G_TYPE_STRING, entry->transport_id,
+      NULL);
   /* XXX: mediaType, trackId, sliCount, qpSum */
 
 /* RTCSentRTPStreamStats */
-/*  if (gst_structure_get_uint64 (source_stats, "octets-sent", &bytes))
-    gst_structure_set (r_out, "bytes-sent", G_TYPE_UINT64, bytes, NULL);
-  if (gst_structure_get_uint64 (source_stats, "packets-sent", &packets))
-    gst_structure_set (r_out, "packets-sent", G_TYPE_UINT64, packets, NULL);*/
 /* XXX:
     unsigned long      packetsDiscardedOnSend;
     unsigned long long bytesDiscardedOnSend;
 */
 
-  gst_structure_set (r_out, "local-id", G_TYPE_STRING, in_id, NULL);
+  gst_structure_set (r_out, "local-id", G_TYPE_STRING, entry->ids[0], NULL);
+}
 
-  gst_structure_set (s, in_id, GST_TYPE_STRUCTURE, in, NULL);
-  gst_structure_set (s, out_id, GST_TYPE_STRUCTURE, out, NULL);
-  gst_structure_set (s, r_in_id, GST_TYPE_STRUCTURE, r_in, NULL);
-  gst_structure_set (s, r_out_id, GST_TYPE_STRUCTURE, r_out, NULL);
+/* https://www.w3.org/TR/webrtc-stats/#codec-dict* */
+static void
+_set_codec_stats (WebRTCStatsEntry * entry, GstStructure * stats)
+{
+  const CodecCounters *c = &entry->counters.codec;
 
-  gst_structure_free (in);
-  gst_structure_free (out);
-  gst_structure_free (r_in);
-  gst_structure_free (r_out);
+  if (c->have & HAVE_PAYLOAD_TYPE)
+    gst_structure_set (stats, "payload-type", G_TYPE_UINT, c->payload_type,
+        NULL);
+  if (c->have & HAVE_CLOCK_RATE)
+    gst_structure_set (stats, "clock-rate", G_TYPE_UINT, c->clock_rate, NULL);
 
-  g_free (in_id);
-  g_free (out_id);
-  g_free (r_in_id);
-  g_free (r_out_id);
+  /* FIXME: codecType, mimeType, channels, sdpFmtpLine, implementation, transportId */
 }
 
-/* https://www.w3.org/TR/webrtc-stats/#candidatepair-dict* */
-static gchar *
-_get_stats_from_ice_transport (GstWebRTCBin * webrtc,
-    GstWebRTCICETransport * transport, GstStructure * s)
+/* Builds the GstStructure for the stats at @index of @entry */
+static GstStructure *
+_stats_entry_build (WebRTCStatsEntry * entry, guint index, double ts)
 {
-  GstStructure *stats;
-  gchar *id;
-  double ts;
+  GstStructure *s = gst_structure_new_empty ("unused");
 
-  gst_structure_get_double (s, "timestamp", &ts);
+  _set_base_stats (s, entry->types[index], ts, entry->ids[index]);
 
-  id = g_strdup_printf ("ice-candidate-pair_%s", GST_OBJECT_NAME (transport));
-  stats = gst_structure_new_empty (id);
-  _set_base_stats (stats, GST_WEBRTC_STATS_TRANSPORT, ts, id);
+  switch (entry->kind) {
+    case STATS_ENTRY_PEER_CONNECTION:
+      _set_peer_connection_stats (s);
+      break;
+    case STATS_ENTRY_CODEC:
+      _set_codec_stats (entry, s);
+      break;
+    case STATS_ENTRY_TRANSPORT:
+/* https://www.w3.org/TR/webrtc-stats/#dom-rtctransportstats */
+/* XXX: RTCTransportStats
+    unsigned long         packetsSent;
+    unsigned long         packetsReceived;
+    unsigned long long    bytesSent;
+    unsigned long long    bytesReceived;
+    DOMString             rtcpTransportStatsId;
+    RTCIceRole            iceRole;
+    RTCDtlsTransportState dtlsState;
+    DOMString             selectedCandidatePairId;
+    DOMString             localCertificateId;
+    DOMString             remoteCertificateId;
+*/
 
+/* XXX: RTCCertificateStats
+    DOMString fingerprint;
+    DOMString fingerprintAlgorithm;
+    DOMString base64Certificate;
+    DOMString issuerCertificateId;
+*/
+
+/* XXX: RTCIceCandidateStats
+    DOMString           transportId;
+    boolean             isRemote;
+    DOMString           ip;
+    long                port;
+    DOMString           protocol;
+    RTCIceCandidateType candidateType;
+    long                priority;
+    DOMString           url;
+    boolean             deleted = false;
+*/
+      break;
+    case STATS_ENTRY_CANDIDATE_PAIR:
+/* https://www.w3.org/TR/webrtc-stats/#candidatepair-dict* */
 /* XXX: RTCIceCandidatePairStats
     DOMString                     transportId;
     DOMString                     localCandidateId;
@@ -338,82 +616,66 @@ _get_stats_from_ice_transport (GstWebRTCBin * webrtc,
     boolean             deleted = false;
 };
 */
+      break;
+    case STATS_ENTRY_RTP_SOURCE:
+      switch (index) {
+        case 0:
+          _set_inbound_rtp_stats (entry, s);
+          break;
+        case 1:
+          _set_outbound_rtp_stats (entry, s);
+          break;
+        case 2:
+          _set_remote_inbound_rtp_stats (entry, s);
+          break;
+        case 3:
+          _set_remote_outbound_rtp_stats (entry, s);
+          break;
+      }
+      break;
+  }
+
+  return s;
+}
 
-  gst_structure_set (s, id, GST_TYPE_STRUCTURE, stats, NULL);
-  gst_structure_free (stats);
+static gchar *
+_get_stats_from_ice_transport (GstWebRTCBin * webrtc,
+    GstWebRTCICETransport * transport)
+{
+  gchar *id;
+
+  id = g_strdup_printf ("ice-candidate-pair_%s", GST_OBJECT_NAME (transport));
+  _update_stats_entry (webrtc, STATS_ENTRY_CANDIDATE_PAIR, id, NULL, NULL,
+      NULL);
 
   return id;
 }
 
-/* https://www.w3.org/TR/webrtc-stats/#dom-rtctransportstats */
 static gchar *
 _get_stats_from_dtls_transport (GstWebRTCBin * webrtc,
-    GstWebRTCDTLSTransport * transport, GstStructure * s)
+    GstWebRTCDTLSTransport * transport)
 {
-  GstStructure *stats;
   gchar *id;
-  double ts;
-
-  gst_structure_get_double (s, "timestamp", &ts);
 
   id = g_strdup_printf ("transport-stats_%s", GST_OBJECT_NAME (transport));
-  stats = gst_structure_new_empty (id);
-  _set_base_stats (stats, GST_WEBRTC_STATS_TRANSPORT, ts, id);
-
-/* XXX: RTCTransportStats
-    unsigned long         packetsSent;
-    unsigned long         packetsReceived;
-    unsigned long long    bytesSent;
-    unsigned long long    bytesReceived;
-    DOMString             rtcpTransportStatsId;
-    RTCIceRole            iceRole;
-    RTCDtlsTransportState dtlsState;
-    DOMString             selectedCandidatePairId;
-    DOMString             localCertificateId;
-    DOMString             remoteCertificateId;
-*/
+  _update_stats_entry (webrtc, STATS_ENTRY_TRANSPORT, id, NULL, NULL, NULL);
 
-/* XXX: RTCCertificateStats
-    DOMString fingerprint;
-    DOMString fingerprintAlgorithm;
-    DOMString base64Certificate;
-    DOMString issuerCertificateId;
-*/
-
-/* XXX: RTCIceCandidateStats
-    DOMString           transportId;
-    boolean             isRemote;
-    DOMString           ip;
-    long                port;
-    DOMString           protocol;
-    RTCIceCandidateType candidateType;
-    long                priority;
-    DOMString           url;
-    boolean             deleted = false;
-*/
-
-  gst_structure_set (s, id, GST_TYPE_STRUCTURE, stats, NULL);
-  gst_structure_free (stats);
-
-  _get_stats_from_ice_transport (webrtc, transport->transport, s);
+  g_free (_get_stats_from_ice_transport (webrtc, transport->transport));
 
   return id;
 }
 
 static void
 _get_stats_from_transport_channel (GstWebRTCBin * webrtc,
-    TransportStream * stream, const gchar * codec_id, GstStructure * s)
+    TransportStream * stream, const gchar * codec_id)
 {
   GstWebRTCDTLSTransport *transport;
   GObject *rtp_session;
   GstStructure *rtp_stats;
   GValueArray *source_stats;
   gchar *transport_id;
-  double ts;
   int i;
 
-  gst_structure_get_double (s, "timestamp", &ts);
-
   transport = stream->transport;
   if (!transport)
     transport = stream->transport;
@@ -432,13 +694,15 @@ _get_stats_from_transport_channel (GstWebRTCBin * webrtc,
       "transport %" GST_PTR_FORMAT, stream, rtp_session, source_stats->n_values,
       transport);
 
-  transport_id = _get_stats_from_dtls_transport (webrtc, transport, s);
+  transport_id = _get_stats_from_dtls_transport (webrtc, transport);
 
   /* construct stats objects */
   for (i = 0; i < source_stats->n_values; i++) {
     const GstStructure *stats;
     const GValue *val = g_value_array_get_nth (source_stats, i);
+    StatsCounters counters;
     gboolean internal;
+    gchar *id;
 
     stats = gst_value_get_structure (val);
 
@@ -447,7 +711,11 @@ _get_stats_from_transport_channel (GstWebRTCBin * webrtc,
     if (internal)
       continue;
 
-    _get_stats_from_rtp_source_stats (webrtc, stats, codec_id, transport_id, s);
+    _get_counters_from_rtp_source_stats (stats, &counters.rtp);
+    id = g_strdup_printf ("rtp-inbound-stream-stats_%u", counters.rtp.ssrc);
+    _update_stats_entry (webrtc, STATS_ENTRY_RTP_SOURCE, id, &counters,
+        codec_id, transport_id);
+    g_free (id);
   }
 
   g_object_unref (rtp_session);
@@ -456,57 +724,70 @@ _get_stats_from_transport_channel (GstWebRTCBin * webrtc,
   g_free (transport_id);
 }
 
-/* https://www.w3.org/TR/webrtc-stats/#codec-dict* */
 static gchar *
-_get_codec_stats_from_pad (GstWebRTCBin * webrtc, GstPad * pad,
-    GstStructure * s)
+_get_codec_stats_from_pad (GstWebRTCBin * webrtc, GstPad * pad)
 {
-  GstStructure *stats;
+  StatsCounters counters;
   GstCaps *caps;
   gchar *id;
-  double ts;
-
-  gst_structure_get_double (s, "timestamp", &ts);
 
-  stats = gst_structure_new_empty ("unused");
+  memset (&counters, 0, sizeof (counters));
   id = g_strdup_printf ("codec-stats-%s", GST_OBJECT_NAME (pad));
-  _set_base_stats (stats, GST_WEBRTC_STATS_CODEC, ts, id);
 
   caps = gst_pad_get_current_caps (pad);
   if (caps && gst_caps_is_fixed (caps)) {
     GstStructure *caps_s = gst_caps_get_structure (caps, 0);
     gint pt, clock_rate;
 
-    if (gst_structure_get_int (caps_s, "payload", &pt))
-      gst_structure_set (stats, "payload-type", G_TYPE_UINT, pt, NULL);
-
-    if (gst_structure_get_int (caps_s, "clock-rate", &clock_rate))
-      gst_structure_set (stats, "clock-rate", G_TYPE_UINT, clock_rate, NULL);
+    if (gst_structure_get_int (caps_s, "payload", &pt)) {
+      counters.codec.payload_type = pt;
+      counters.codec.have |= HAVE_PAYLOAD_TYPE;
+    }
 
-    /* FIXME: codecType, mimeType, channels, sdpFmtpLine, implementation, transportId */
+    if (gst_structure_get_int (caps_s, "clock-rate", &clock_rate)) {
+      counters.codec.clock_rate = clock_rate;
+      counters.codec.have |= HAVE_CLOCK_RATE;
+    }
   }
 
   if (caps)
     gst_caps_unref (caps);
 
-  gst_structure_set (s, id, GST_TYPE_STRUCTURE, stats, NULL);
-  gst_structure_free (stats);
+  _update_stats_entry (webrtc, STATS_ENTRY_CODEC, id, &counters, NULL, NULL);
 
   return id;
 }
 
 static gboolean
-_get_stats_from_pad (GstWebRTCBin * webrtc, GstPad * pad, GstStructure * s)
+_ptr_array_contains (GPtrArray * array, gpointer data)
+{
+  guint i;
+
+  for (i = 0; i < array->len; i++) {
+    if (g_ptr_array_index (array, i) == data)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gboolean
+_get_stats_from_pad (GstWebRTCBin * webrtc, GstPad * pad, gpointer user_data)
 {
   GstWebRTCBinPad *wpad = GST_WEBRTC_BIN_PAD (pad);
+  GPtrArray *streams = user_data;
   gchar *codec_id;
 
-  codec_id = _get_codec_stats_from_pad (webrtc, pad, s);
+  codec_id = _get_codec_stats_from_pad (webrtc, pad);
   if (wpad->trans) {
     WebRTCTransceiver *trans;
     trans = WEBRTC_TRANSCEIVER (wpad->trans);
-    if (trans->stream)
-      _get_stats_from_transport_channel (webrtc, trans->stream, codec_id, s);
+    /* with bundling, several pads share a stream and its rtp session, only
+     * retrieve the stats of those once */
+    if (trans->stream && !_ptr_array_contains (streams, trans->stream)) {
+      g_ptr_array_add (streams, trans->stream);
+      _get_stats_from_transport_channel (webrtc, trans->stream, codec_id);
+    }
   }
 
   g_free (codec_id);
@@ -514,36 +795,90 @@ _get_stats_from_pad (GstWebRTCBin * webrtc, GstPad * pad, GstStructure * s)
   return TRUE;
 }
 
+static gboolean
+_stats_entry_is_stale (gpointer key, WebRTCStatsEntry * entry,
+    GstWebRTCBin * webrtc)
+{
+  return entry->seen != webrtc->priv->stats_generation;
+}
+
 void
 gst_webrtc_bin_update_stats (GstWebRTCBin * webrtc)
 {
-  GstStructure *s = gst_structure_new_empty ("application/x-webrtc-stats");
-  double ts = monotonic_time_as_double_milliseconds ();
-  GstStructure *pc_stats;
+  GstWebRTCBinPrivate *priv = webrtc->priv;
+  GPtrArray *streams;
 
   _init_debug ();
 
-  gst_structure_set (s, "timestamp", G_TYPE_DOUBLE, ts, NULL);
-
   /* FIXME: better unique IDs */
-  /* FIXME: rate limitting stat updates? */
   /* FIXME: all stats need to be kept forever */
 
-  GST_DEBUG_OBJECT (webrtc, "updating stats at time %f", ts);
+  if (!priv->stats_entries)
+    priv->stats_entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) _stats_entry_free);
 
-  if ((pc_stats = _get_peer_connection_stats (webrtc))) {
-    const gchar *id = "peer-connection-stats";
-    _set_base_stats (pc_stats, GST_WEBRTC_STATS_PEER_CONNECTION, ts, id);
-    gst_structure_set (s, id, GST_TYPE_STRUCTURE, pc_stats, NULL);
-    gst_structure_free (pc_stats);
-  }
+  priv->stats_generation++;
+
+  GST_DEBUG_OBJECT (webrtc, "updating stats, collection %" G_GUINT64_FORMAT,
+      priv->stats_generation);
+
+  _update_stats_entry (webrtc, STATS_ENTRY_PEER_CONNECTION,
+      "peer-connection-stats", NULL, NULL, NULL);
 
+  streams = g_ptr_array_new ();
   gst_element_foreach_pad (GST_ELEMENT (webrtc),
-      (GstElementForeachPadFunc) _get_stats_from_pad, s);
+      (GstElementForeachPadFunc) _get_stats_from_pad, streams);
+  g_ptr_array_free (streams, TRUE);
 
-  gst_structure_remove_field (s, "timestamp");
+  /* drop the stats of everything that went away */
+  g_hash_table_foreach_remove (priv->stats_entries,
+      (GHRFunc) _stats_entry_is_stale, webrtc);
+}
+
+/* Returns a new 'application/x-webrtc-stats' structure with the stats from
+ * the last gst_webrtc_bin_update_stats() that changed after the collection
+ * in @since for their GstWebRTCStatsType (NULL for all of them). @types is
+ * a mask of (1 << GstWebRTCStatsType) of the stats to include, or 0 for all
+ * types */
+GstStructure *
+gst_webrtc_bin_create_stats_report (GstWebRTCBin * webrtc, guint types,
+    const guint64 * since)
+{
+  GstStructure *s = gst_structure_new_empty ("application/x-webrtc-stats");
+  double ts = monotonic_time_as_double_milliseconds ();
+  WebRTCStatsEntry *entry;
+  GHashTableIter iter;
+  guint i;
+
+  if (!webrtc->priv->stats_entries)
+    return s;
+
+  g_hash_table_iter_init (&iter, webrtc->priv->stats_entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & entry)) {
+    for (i = 0; i < entry->n_stats; i++) {
+      if (types != 0 && !(types & (1 << entry->types[i])))
+        continue;
+      if (since && entry->changed <= since[entry->types[i]])
+        continue;
+
+      if (!entry->cache[i])
+        entry->cache[i] = _stats_entry_build (entry, i, ts);
+      else
+        gst_structure_set (entry->cache[i], "timestamp", G_TYPE_DOUBLE, ts,
+            NULL);
+
+      gst_structure_set (s, entry->ids[i], GST_TYPE_STRUCTURE,
+          entry->cache[i], NULL);
+    }
+  }
+
+  return s;
+}
 
-  if (webrtc->priv->stats)
-    gst_structure_free (webrtc->priv->stats);
-  webrtc->priv->stats = s;
+void
+gst_webrtc_bin_clear_stats (GstWebRTCBin * webrtc)
+{
+  if (webrtc->priv->stats_entries)
+    g_hash_table_unref (webrtc->priv->stats_entries);
+  webrtc->priv->stats_entries = NULL;
 }
@@ -27,8 +27,16 @@
 
 G_BEGIN_DECLS
 
+typedef struct _WebRTCStatsEntry WebRTCStatsEntry;
+
 G_GNUC_INTERNAL
 void        gst_webrtc_bin_update_stats         (GstWebRTCBin * webrtc);
+G_GNUC_INTERNAL
+GstStructure * gst_webrtc_bin_create_stats_report (GstWebRTCBin * webrtc,
+                                                   guint types,
+                                                   const guint64 * since);
+G_GNUC_INTERNAL
+void        gst_webrtc_bin_clear_stats          (GstWebRTCBin * webrtc);
 
 G_END_DECLS
 
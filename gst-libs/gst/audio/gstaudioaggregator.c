@@ -1899,6 +1899,9 @@ gst_audio_aggregator_aggregate (GstAggregator * agg, gboolean timeout)
     return GST_AGGREGATOR_FLOW_NEED_DATA;
   }
 
+  if (GST_AUDIO_AGGREGATOR_GET_CLASS (aagg)->finish_output_buffer)
+    GST_AUDIO_AGGREGATOR_GET_CLASS (aagg)->finish_output_buffer (aagg, outbuf);
+
   if (is_eos) {
     gint64 max_offset = 0;
 
@@ -189,6 +189,10 @@ struct _GstAudioAggregator
  *  is either a sinkpad, when converting an input buffer, or the source pad,
  *  when converting the output buffer after a downstream format change is
  *  requested.
+ * @finish_output_buffer: Called once all input buffers for the current output
+ *  buffer were passed to @aggregate_one_buffer, right before the output
+ *  buffer is pushed downstream. Subclasses that only record the work in
+ *  @aggregate_one_buffer can do it here for all pads at once. Since: 1.14
  */
 struct _GstAudioAggregatorClass {
   GstAggregatorClass   parent_class;
@@ -203,9 +207,11 @@ struct _GstAudioAggregatorClass {
                                   GstAudioInfo *in_info,
                                   GstAudioInfo *out_info,
                                   GstBuffer * buffer);
+  void (* finish_output_buffer) (GstAudioAggregator * aagg,
+      GstBuffer * outbuf);
 
   /*< private >*/
-  gpointer          _gst_reserved[GST_PADDING_LARGE];
+  gpointer          _gst_reserved[GST_PADDING_LARGE - 1];
 };
 
 /*************************
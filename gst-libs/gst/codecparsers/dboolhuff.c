@@ -11,6 +11,14 @@
 
 #include "dboolhuff.h"
 
+#include <string.h>
+
+#if GLIB_SIZEOF_SIZE_T == 8
+#define VP8_BD_VALUE_FROM_BE(v) GUINT64_FROM_BE (v)
+#else
+#define VP8_BD_VALUE_FROM_BE(v) GUINT32_FROM_BE (v)
+#endif
+
 int
 vp8dx_start_decode (BOOL_DECODER * br,
     const unsigned char *source,
@@ -56,6 +64,23 @@ vp8dx_bool_decoder_fill (BOOL_DECODER * br)
   if (x >= 0) {
     count += VP8_LOTS_OF_BITS;
     loop_end = x;
+  } else if (!br->decrypt_cb && bytes_left >= sizeof (VP8_BD_VALUE)) {
+    /* Fast path: enough input left to refill from one big-endian word
+     * load instead of one byte per iteration. The lowest byte that fits
+     * may only partially do so, its bits below 'shift % 8' are masked
+     * off so the state is the same as the byte-wise loop leaves it. */
+    VP8_BD_VALUE word;
+    int n = shift / CHAR_BIT + 1;
+
+    memcpy (&word, bufptr, sizeof (word));
+    word = VP8_BD_VALUE_FROM_BE (word) >> (VP8_BD_VALUE_SIZE - 8 - shift);
+    value |= word & ~(((VP8_BD_VALUE) 1 << (shift % CHAR_BIT)) - 1);
+    count += n * CHAR_BIT;
+    br->user_buffer += n;
+
+    br->value = value;
+    br->count = count;
+    return;
   }
 
   if (x < 0 || bits_left) {
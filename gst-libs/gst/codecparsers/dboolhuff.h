@@ -58,7 +58,7 @@ void vp8dx_bool_decoder_fill(BOOL_DECODER *br);
 
 
 static inline int vp8dx_decode_bool(BOOL_DECODER *br, int probability) {
-    unsigned int bit = 0;
+    unsigned int bit;
     VP8_BD_VALUE value;
     unsigned int split;
     VP8_BD_VALUE bigsplit;
@@ -75,14 +75,10 @@ static inline int vp8dx_decode_bool(BOOL_DECODER *br, int probability) {
 
     bigsplit = (VP8_BD_VALUE)split << (VP8_BD_VALUE_SIZE - 8);
 
-    range = split;
-
-    if (value >= bigsplit)
-    {
-        range = br->range - split;
-        value = value - bigsplit;
-        bit = 1;
-    }
+    /* branch-free select, the outcome of a bool is hard to predict */
+    bit = value >= bigsplit;
+    range = bit ? br->range - split : split;
+    value -= bigsplit & ((VP8_BD_VALUE)0 - bit);
 
     {
         register unsigned int shift = vp8_norm[range];
@@ -189,6 +189,16 @@ gst_h264_parser_get_pps (GstH264NalParser * nalparser, guint8 pps_id)
   return NULL;
 }
 
+/* Records the bytes the SPS @id was parsed from, or forgets them if @data
+ * is %NULL. PPS parsing depends on the SPS, so cached PPS are dropped. */
+static void
+gst_h264_parser_cache_sps (GstH264NalParser * nalparser, guint8 sps_id,
+    const guint8 * data, guint size)
+{
+  nal_cache_store (nalparser->sps_cache, sps_id, data, size);
+  nal_cache_clear (nalparser->pps_cache, GST_H264_MAX_PPS_COUNT);
+}
+
 static gboolean
 gst_h264_parse_nalu_header (GstH264NalUnit * nalu)
 {
@@ -1238,6 +1248,8 @@ gst_h264_nal_parser_free (GstH264NalParser * nalparser)
     gst_h264_sps_clear (&nalparser->sps[i]);
   for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++)
     gst_h264_pps_clear (&nalparser->pps[i]);
+  nal_cache_clear (nalparser->sps_cache, GST_H264_MAX_SPS_COUNT);
+  nal_cache_clear (nalparser->pps_cache, GST_H264_MAX_PPS_COUNT);
   g_slice_free (GstH264NalParser, nalparser);
 
   nalparser = NULL;
@@ -1469,7 +1481,27 @@ GstH264ParserResult
 gst_h264_parser_parse_sps (GstH264NalParser * nalparser, GstH264NalUnit * nalu,
     GstH264SPS * sps, gboolean parse_vui_params)
 {
-  GstH264ParserResult res = gst_h264_parse_sps (nalu, sps, parse_vui_params);
+  const guint8 *data = nalu->data + nalu->offset;
+  GstH264ParserResult res;
+  gint id = -1;
+
+  /* streams repeat their SPS, skip parsing if nothing changed; only sets
+   * parsed including the VUI are cached */
+  if (parse_vui_params)
+    id = nal_cache_lookup (nalparser->sps_cache, GST_H264_MAX_SPS_COUNT,
+        nalparser->last_sps ? nalparser->last_sps->id : -1, data, nalu->size);
+
+  if (id >= 0) {
+    GST_DEBUG ("sequence parameter set with id: %d unchanged", id);
+
+    memset (sps, 0, sizeof (*sps));
+    if (!gst_h264_sps_copy (sps, &nalparser->sps[id]))
+      return GST_H264_PARSER_ERROR;
+    nalparser->last_sps = &nalparser->sps[id];
+    return GST_H264_PARSER_OK;
+  }
+
+  res = gst_h264_parse_sps (nalu, sps, parse_vui_params);
 
   if (res == GST_H264_PARSER_OK) {
     GST_DEBUG ("adding sequence parameter set with id: %d to array", sps->id);
@@ -1477,6 +1509,8 @@ gst_h264_parser_parse_sps (GstH264NalParser * nalparser, GstH264NalUnit * nalu,
     if (!gst_h264_sps_copy (&nalparser->sps[sps->id], sps))
       return GST_H264_PARSER_ERROR;
     nalparser->last_sps = &nalparser->sps[sps->id];
+    gst_h264_parser_cache_sps (nalparser, sps->id,
+        parse_vui_params ? data : NULL, nalu->size);
   }
   return res;
 }
@@ -1801,6 +1835,7 @@ gst_h264_parser_parse_subset_sps (GstH264NalParser * nalparser,
       return GST_H264_PARSER_ERROR;
     }
     nalparser->last_sps = &nalparser->sps[sps->id];
+    gst_h264_parser_cache_sps (nalparser, sps->id, NULL, 0);
   }
   return res;
 }
@@ -2011,7 +2046,24 @@ GstH264ParserResult
 gst_h264_parser_parse_pps (GstH264NalParser * nalparser,
     GstH264NalUnit * nalu, GstH264PPS * pps)
 {
-  GstH264ParserResult res = gst_h264_parse_pps (nalparser, nalu, pps);
+  const guint8 *data = nalu->data + nalu->offset;
+  GstH264ParserResult res;
+  gint id;
+
+  id = nal_cache_lookup (nalparser->pps_cache, GST_H264_MAX_PPS_COUNT,
+      nalparser->last_pps ? nalparser->last_pps->id : -1, data, nalu->size);
+
+  if (id >= 0) {
+    GST_DEBUG ("picture parameter set with id: %d unchanged", id);
+
+    memset (pps, 0, sizeof (*pps));
+    if (!gst_h264_pps_copy (pps, &nalparser->pps[id]))
+      return GST_H264_PARSER_ERROR;
+    nalparser->last_pps = &nalparser->pps[id];
+    return GST_H264_PARSER_OK;
+  }
+
+  res = gst_h264_parse_pps (nalparser, nalu, pps);
 
   if (res == GST_H264_PARSER_OK) {
     GST_DEBUG ("adding picture parameter set with id: %d to array", pps->id);
@@ -2019,6 +2071,7 @@ gst_h264_parser_parse_pps (GstH264NalParser * nalparser,
     if (!gst_h264_pps_copy (&nalparser->pps[pps->id], pps))
       return GST_H264_PARSER_ERROR;
     nalparser->last_pps = &nalparser->pps[pps->id];
+    nal_cache_store (nalparser->pps_cache, pps->id, data, nalu->size);
   }
 
   return res;
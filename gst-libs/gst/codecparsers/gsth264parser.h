@@ -1022,6 +1022,10 @@ struct _GstH264NalParser
   GstH264PPS pps[GST_H264_MAX_PPS_COUNT];
   GstH264SPS *last_sps;
   GstH264PPS *last_pps;
+
+  /* bytes each stored parameter set was parsed from */
+  GBytes *sps_cache[GST_H264_MAX_SPS_COUNT];
+  GBytes *pps_cache[GST_H264_MAX_PPS_COUNT];
 };
 
 GST_EXPORT
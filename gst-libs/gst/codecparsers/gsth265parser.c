@@ -1116,6 +1116,9 @@ gst_h265_parser_new (void)
 void
 gst_h265_parser_free (GstH265Parser * parser)
 {
+  nal_cache_clear (parser->vps_cache, GST_H265_MAX_VPS_COUNT);
+  nal_cache_clear (parser->sps_cache, GST_H265_MAX_SPS_COUNT);
+  nal_cache_clear (parser->pps_cache, GST_H265_MAX_PPS_COUNT);
   g_slice_free (GstH265Parser, parser);
   parser = NULL;
 }
@@ -1345,13 +1348,34 @@ GstH265ParserResult
 gst_h265_parser_parse_vps (GstH265Parser * parser, GstH265NalUnit * nalu,
     GstH265VPS * vps)
 {
-  GstH265ParserResult res = gst_h265_parse_vps (nalu, vps);
+  const guint8 *data = nalu->data + nalu->offset;
+  GstH265ParserResult res;
+  gint id;
+
+  /* streams repeat their parameter sets, skip parsing if nothing changed */
+  id = nal_cache_lookup (parser->vps_cache, GST_H265_MAX_VPS_COUNT,
+      parser->last_vps ? parser->last_vps->id : -1, data, nalu->size);
+
+  if (id >= 0) {
+    GST_DEBUG ("video parameter set with id: %d unchanged", id);
+
+    *vps = parser->vps[id];
+    parser->last_vps = &parser->vps[id];
+    return GST_H265_PARSER_OK;
+  }
+
+  res = gst_h265_parse_vps (nalu, vps);
 
   if (res == GST_H265_PARSER_OK) {
     GST_DEBUG ("adding video parameter set with id: %d to array", vps->id);
 
     parser->vps[vps->id] = *vps;
     parser->last_vps = &parser->vps[vps->id];
+
+    /* SPS and PPS parsing depends on the VPS */
+    nal_cache_store (parser->vps_cache, vps->id, data, nalu->size);
+    nal_cache_clear (parser->sps_cache, GST_H265_MAX_SPS_COUNT);
+    nal_cache_clear (parser->pps_cache, GST_H265_MAX_PPS_COUNT);
   }
 
   return res;
@@ -1480,14 +1504,35 @@ GstH265ParserResult
 gst_h265_parser_parse_sps (GstH265Parser * parser, GstH265NalUnit * nalu,
     GstH265SPS * sps, gboolean parse_vui_params)
 {
-  GstH265ParserResult res =
-      gst_h265_parse_sps (parser, nalu, sps, parse_vui_params);
+  const guint8 *data = nalu->data + nalu->offset;
+  GstH265ParserResult res;
+  gint id = -1;
+
+  /* only sets parsed including the VUI are cached */
+  if (parse_vui_params)
+    id = nal_cache_lookup (parser->sps_cache, GST_H265_MAX_SPS_COUNT,
+        parser->last_sps ? parser->last_sps->id : -1, data, nalu->size);
+
+  if (id >= 0) {
+    GST_DEBUG ("sequence parameter set with id: %d unchanged", id);
+
+    *sps = parser->sps[id];
+    parser->last_sps = &parser->sps[id];
+    return GST_H265_PARSER_OK;
+  }
+
+  res = gst_h265_parse_sps (parser, nalu, sps, parse_vui_params);
 
   if (res == GST_H265_PARSER_OK) {
     GST_DEBUG ("adding sequence parameter set with id: %d to array", sps->id);
 
     parser->sps[sps->id] = *sps;
     parser->last_sps = &parser->sps[sps->id];
+
+    /* PPS parsing depends on the SPS */
+    nal_cache_store (parser->sps_cache, sps->id,
+        parse_vui_params ? data : NULL, nalu->size);
+    nal_cache_clear (parser->pps_cache, GST_H265_MAX_PPS_COUNT);
   }
 
   return res;
@@ -1864,12 +1909,28 @@ GstH265ParserResult
 gst_h265_parser_parse_pps (GstH265Parser * parser,
     GstH265NalUnit * nalu, GstH265PPS * pps)
 {
-  GstH265ParserResult res = gst_h265_parse_pps (parser, nalu, pps);
+  const guint8 *data = nalu->data + nalu->offset;
+  GstH265ParserResult res;
+  gint id;
+
+  id = nal_cache_lookup (parser->pps_cache, GST_H265_MAX_PPS_COUNT,
+      parser->last_pps ? parser->last_pps->id : -1, data, nalu->size);
+
+  if (id >= 0) {
+    GST_DEBUG ("picture parameter set with id: %d unchanged", id);
+
+    *pps = parser->pps[id];
+    parser->last_pps = &parser->pps[id];
+    return GST_H265_PARSER_OK;
+  }
+
+  res = gst_h265_parse_pps (parser, nalu, pps);
   if (res == GST_H265_PARSER_OK) {
     GST_DEBUG ("adding picture parameter set with id: %d to array", pps->id);
 
     parser->pps[pps->id] = *pps;
     parser->last_pps = &parser->pps[pps->id];
+    nal_cache_store (parser->pps_cache, pps->id, data, nalu->size);
   }
 
   return res;
@@ -995,6 +995,11 @@ struct _GstH265Parser
   GstH265VPS *last_vps;
   GstH265SPS *last_sps;
   GstH265PPS *last_pps;
+
+  /* bytes each stored parameter set was parsed from */
+  GBytes *vps_cache[GST_H265_MAX_VPS_COUNT];
+  GBytes *sps_cache[GST_H265_MAX_SPS_COUNT];
+  GBytes *pps_cache[GST_H265_MAX_PPS_COUNT];
 };
 
 GST_EXPORT
@@ -307,3 +307,63 @@ scan_for_start_codes (const guint8 * data, guint size)
   return gst_byte_reader_masked_scan_uint32 (&br, 0xffffff00, 0x00000100,
       0, size);
 }
+
+/***********  parameter set cache ***************/
+
+static inline gboolean
+nal_cache_matches (GBytes * bytes, const guint8 * data, guint size)
+{
+  gconstpointer cached;
+  gsize cached_size;
+
+  if (!bytes)
+    return FALSE;
+
+  cached = g_bytes_get_data (bytes, &cached_size);
+  return cached_size == size && memcmp (cached, data, size) == 0;
+}
+
+/* Returns the id whose cached bytes equal @data, trying @hint first, or -1 */
+gint
+nal_cache_lookup (GBytes ** cache, guint n_cache, gint hint,
+    const guint8 * data, guint size)
+{
+  guint i;
+
+  if (hint >= 0 && hint < (gint) n_cache
+      && nal_cache_matches (cache[hint], data, size))
+    return hint;
+
+  for (i = 0; i < n_cache; i++) {
+    if ((gint) i != hint && nal_cache_matches (cache[i], data, size))
+      return i;
+  }
+
+  return -1;
+}
+
+/* Stores @size bytes of @data as the cached bytes of @id, or forgets the
+ * bytes of @id if @data is %NULL */
+void
+nal_cache_store (GBytes ** cache, guint id, const guint8 * data, guint size)
+{
+  if (data && nal_cache_matches (cache[id], data, size))
+    return;
+
+  if (cache[id])
+    g_bytes_unref (cache[id]);
+  cache[id] = data ? g_bytes_new (data, size) : NULL;
+}
+
+void
+nal_cache_clear (GBytes ** cache, guint n_cache)
+{
+  guint i;
+
+  for (i = 0; i < n_cache; i++) {
+    if (cache[i]) {
+      g_bytes_unref (cache[i]);
+      cache[i] = NULL;
+    }
+  }
+}
@@ -181,3 +181,16 @@ gboolean nal_reader_get_se (NalReader * nr, gint32 * val);
 
 G_GNUC_INTERNAL
 gint scan_for_start_codes (const guint8 * data, guint size);
+
+/* Raw bytes of stored parameter sets, indexed by id, so byte-identical
+ * repeats can skip parsing */
+G_GNUC_INTERNAL
+gint nal_cache_lookup (GBytes ** cache, guint n_cache, gint hint,
+    const guint8 * data, guint size);
+
+G_GNUC_INTERNAL
+void nal_cache_store (GBytes ** cache, guint id, const guint8 * data,
+    guint size);
+
+G_GNUC_INTERNAL
+void nal_cache_clear (GBytes ** cache, guint n_cache);
@@ -651,20 +651,30 @@ _packetize_descriptor_array (GPtrArray * array, guint8 ** out_data)
   }
 }
 
+/* Descriptors are allocated together with their data in one block */
+static GstMpegtsDescriptor *
+_descriptor_alloc (gsize data_size)
+{
+  GstMpegtsDescriptor *descriptor;
+
+  descriptor = g_malloc0 (sizeof (GstMpegtsDescriptor) + data_size);
+  descriptor->data = (guint8 *) (descriptor + 1);
+
+  return descriptor;
+}
+
 GstMpegtsDescriptor *
 _new_descriptor (guint8 tag, guint8 length)
 {
   GstMpegtsDescriptor *descriptor;
   guint8 *data;
 
-  descriptor = g_slice_new (GstMpegtsDescriptor);
+  descriptor = _descriptor_alloc (length + 2);
 
   descriptor->tag = tag;
   descriptor->tag_extension = 0;
   descriptor->length = length;
 
-  descriptor->data = g_malloc (length + 2);
-
   data = descriptor->data;
 
   *data++ = descriptor->tag;
@@ -679,14 +689,12 @@ _new_descriptor_with_extension (guint8 tag, guint8 tag_extension, guint8 length)
   GstMpegtsDescriptor *descriptor;
   guint8 *data;
 
-  descriptor = g_slice_new (GstMpegtsDescriptor);
+  descriptor = _descriptor_alloc (length + 3);
 
   descriptor->tag = tag;
   descriptor->tag_extension = tag_extension;
   descriptor->length = length + 1;
 
-  descriptor->data = g_malloc (length + 3);
-
   data = descriptor->data;
 
   *data++ = descriptor->tag;
@@ -701,8 +709,11 @@ _copy_descriptor (GstMpegtsDescriptor * desc)
 {
   GstMpegtsDescriptor *copy;
 
-  copy = g_slice_dup (GstMpegtsDescriptor, desc);
-  copy->data = g_memdup (desc->data, desc->length + 2);
+  copy = _descriptor_alloc (desc->length + 2);
+  copy->tag = desc->tag;
+  copy->tag_extension = desc->tag_extension;
+  copy->length = desc->length;
+  memcpy (copy->data, desc->data, desc->length + 2);
 
   return copy;
 }
@@ -716,8 +727,7 @@ _copy_descriptor (GstMpegtsDescriptor * desc)
 void
 gst_mpegts_descriptor_free (GstMpegtsDescriptor * desc)
 {
-  g_free ((gpointer) desc->data);
-  g_slice_free (GstMpegtsDescriptor, desc);
+  g_free (desc);
 }
 
 G_DEFINE_BOXED_TYPE (GstMpegtsDescriptor, gst_mpegts_descriptor,
@@ -784,13 +794,12 @@ gst_mpegts_parse_descriptors (guint8 * buffer, gsize buf_len)
   data = buffer;
 
   for (i = 0; i < nb_desc; i++) {
-    GstMpegtsDescriptor *desc = g_slice_new0 (GstMpegtsDescriptor);
+    GstMpegtsDescriptor *desc;
 
-    desc->data = data;
+    desc = _descriptor_alloc (data[1] + 2);
+    memcpy (desc->data, data, data[1] + 2);
     desc->tag = *data++;
     desc->length = *data++;
-    /* Copy the data now that we known the size */
-    desc->data = g_memdup (desc->data, desc->length + 2);
     GST_LOG ("descriptor 0x%02x length:%d", desc->tag, desc->length);
     GST_MEMDUMP ("descriptor", desc->data + 2, desc->length);
     /* extended descriptors */
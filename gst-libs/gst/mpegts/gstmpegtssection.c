@@ -127,19 +127,182 @@ static const guint32 crc_tab[256] = {
   0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
 
+/* crc_tab_8[k][i] is the CRC of byte i followed by k + 1 zero bytes, for
+ * processing 8 bytes per step ("slicing-by-8") */
+static guint32 crc_tab_8[7][256];
+
+static void
+_init_crc_tables (void)
+{
+  static gsize tables_init = 0;
+  guint32 crc;
+  guint i, k;
+
+  if (g_once_init_enter (&tables_init)) {
+    for (i = 0; i < 256; i++) {
+      crc = crc_tab[i];
+      for (k = 0; k < 7; k++) {
+        crc = (crc << 8) ^ crc_tab[crc >> 24];
+        crc_tab_8[k][i] = crc;
+      }
+    }
+    g_once_init_leave (&tables_init, 1);
+  }
+}
+
 /* _calc_crc32 relicensed to LGPL from fluendo ts demuxer */
 guint32
 _calc_crc32 (const guint8 * data, guint datalen)
 {
-  gint i;
   guint32 crc = 0xffffffff;
+  guint32 hi, lo;
+
+  _init_crc_tables ();
+
+  while (datalen >= 8) {
+    hi = crc ^ GST_READ_UINT32_BE (data);
+    lo = GST_READ_UINT32_BE (data + 4);
+    crc = crc_tab_8[6][hi >> 24] ^ crc_tab_8[5][(hi >> 16) & 0xff] ^
+        crc_tab_8[4][(hi >> 8) & 0xff] ^ crc_tab_8[3][hi & 0xff] ^
+        crc_tab_8[2][lo >> 24] ^ crc_tab_8[1][(lo >> 16) & 0xff] ^
+        crc_tab_8[0][(lo >> 8) & 0xff] ^ crc_tab[lo & 0xff];
+    data += 8;
+    datalen -= 8;
+  }
 
-  for (i = 0; i < datalen; i++) {
+  while (datalen--)
     crc = (crc << 8) ^ crc_tab[((crc >> 24) ^ *data++) & 0xff];
-  }
+
   return crc;
 }
 
+/* GstMpegtsSectionCache:
+ *
+ * The last long sections seen by one user, most recently used first. A
+ * section added with the same contents as a cached one keeps a reference
+ * to it and reuses its parsed table instead of checking the CRC and parsing
+ * again. */
+struct _GstMpegtsSectionCache
+{
+  guint max_sections;
+  /* GstMpegtsSection => GList link in lru */
+  GHashTable *sections;
+  GQueue lru;
+};
+
+static guint
+_section_hash (const GstMpegtsSection * section)
+{
+  return section->crc ^ (section->table_id << 24) ^
+      section->subtable_extension ^ (section->pid << 8);
+}
+
+static gboolean
+_section_equal (const GstMpegtsSection * a, const GstMpegtsSection * b)
+{
+  return a->crc == b->crc && a->pid == b->pid && a->table_id == b->table_id
+      && a->section_type == b->section_type
+      && a->section_length == b->section_length
+      && memcmp (a->data, b->data, a->section_length) == 0;
+}
+
+/**
+ * gst_mpegts_section_cache_new:
+ * @max_sections: the maximum number of sections to keep
+ *
+ * Creates a cache for sections that are received over and over again, like
+ * the EIT, SDT or NIT tables. See gst_mpegts_section_cache_add().
+ *
+ * The cache is not thread-safe and is meant to be used by the one element
+ * creating the sections.
+ *
+ * Returns: (transfer full): a new #GstMpegtsSectionCache, free with
+ * gst_mpegts_section_cache_free()
+ *
+ * Since: 1.14
+ */
+GstMpegtsSectionCache *
+gst_mpegts_section_cache_new (guint max_sections)
+{
+  GstMpegtsSectionCache *cache;
+
+  g_return_val_if_fail (max_sections > 0, NULL);
+
+  cache = g_slice_new0 (GstMpegtsSectionCache);
+  cache->max_sections = max_sections;
+  cache->sections = g_hash_table_new ((GHashFunc) _section_hash,
+      (GEqualFunc) _section_equal);
+  g_queue_init (&cache->lru);
+
+  return cache;
+}
+
+/**
+ * gst_mpegts_section_cache_free:
+ * @cache: a #GstMpegtsSectionCache
+ *
+ * Frees @cache and releases the sections it holds.
+ *
+ * Since: 1.14
+ */
+void
+gst_mpegts_section_cache_free (GstMpegtsSectionCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_hash_table_destroy (cache->sections);
+  g_queue_foreach (&cache->lru, (GFunc) gst_mini_object_unref, NULL);
+  g_queue_clear (&cache->lru);
+  g_slice_free (GstMpegtsSectionCache, cache);
+}
+
+/**
+ * gst_mpegts_section_cache_add:
+ * @cache: a #GstMpegtsSectionCache
+ * @section: (transfer none): a newly created long #GstMpegtsSection
+ *
+ * Looks up a section with the same contents as @section in @cache. If there
+ * is one, @section will use its parsed table, if it was parsed by the same
+ * gst_mpegts_section_get_*() function, instead of checking and parsing its
+ * data again. Otherwise @section is added to @cache, evicting the least
+ * recently used section if @cache is full.
+ *
+ * Returns: %TRUE if an identical section was found in @cache
+ *
+ * Since: 1.14
+ */
+gboolean
+gst_mpegts_section_cache_add (GstMpegtsSectionCache * cache,
+    GstMpegtsSection * section)
+{
+  GstMpegtsSection *evicted;
+  GList *link;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (section != NULL, FALSE);
+  g_return_val_if_fail (!section->short_section, FALSE);
+  g_return_val_if_fail (section->shared == NULL, FALSE);
+
+  link = g_hash_table_lookup (cache->sections, section);
+  if (link) {
+    section->shared = gst_mpegts_section_ref (link->data);
+    g_queue_unlink (&cache->lru, link);
+    g_queue_push_head_link (&cache->lru, link);
+    return TRUE;
+  }
+
+  g_queue_push_head (&cache->lru, gst_mpegts_section_ref (section));
+  g_hash_table_insert (cache->sections, section, cache->lru.head);
+
+  if (cache->lru.length > cache->max_sections) {
+    evicted = g_queue_pop_tail (&cache->lru);
+    g_hash_table_remove (cache->sections, evicted);
+    gst_mpegts_section_unref (evicted);
+  }
+
+  return FALSE;
+}
+
 gpointer
 __common_section_checks (GstMpegtsSection * section, guint min_size,
     GstMpegtsParseFunc parsefunc, GDestroyNotify destroynotify)
@@ -154,6 +317,15 @@ __common_section_checks (GstMpegtsSection * section, guint min_size,
     return NULL;
   }
 
+  /* An identical section was already checked and parsed the same way,
+   * share its table */
+  if (section->shared && section->shared->cached_parsed
+      && section->shared->destroy_parsed == destroynotify) {
+    GST_LOG ("PID:0x%04x table_id:0x%02x, using cached section",
+        section->pid, section->table_id);
+    return section->shared->cached_parsed;
+  }
+
   /* If section has a CRC, check it */
   if (!section->short_section
       && (_calc_crc32 (section->data, section->section_length) != 0)) {
@@ -183,6 +355,8 @@ _gst_mpegts_section_free (GstMpegtsSection * section)
 
   if (section->cached_parsed && section->destroy_parsed)
     section->destroy_parsed (section->cached_parsed);
+  if (section->shared)
+    gst_mpegts_section_unref (section->shared);
 
   g_free (section->data);
 
@@ -173,8 +173,13 @@ struct _GstMpegtsSection
   gboolean      short_section;
   GstMpegtsPacketizeFunc packetizer;
 
+  /*< private >*/
+  /* shared: identical section found in a GstMpegtsSectionCache, whose
+   * cached_parsed is used if it was parsed with the same destroy_parsed */
+  GstMpegtsSection *shared;
+
   /* Padding for future extension */
-  gpointer _gst_reserved[GST_PADDING];
+  gpointer _gst_reserved[GST_PADDING - 1];
 };
 
 GST_EXPORT
@@ -426,6 +431,28 @@ GstMpegtsSection *gst_mpegts_section_new (guint16 pid,
 GST_EXPORT
 guint8 *gst_mpegts_section_packetize (GstMpegtsSection * section, gsize * output_size);
 
+/* cache */
+
+/**
+ * GstMpegtsSectionCache:
+ *
+ * Opaque cache of recently seen sections, see
+ * gst_mpegts_section_cache_new().
+ *
+ * Since: 1.14
+ */
+typedef struct _GstMpegtsSectionCache GstMpegtsSectionCache;
+
+GST_EXPORT
+GstMpegtsSectionCache *gst_mpegts_section_cache_new (guint max_sections);
+
+GST_EXPORT
+void gst_mpegts_section_cache_free (GstMpegtsSectionCache * cache);
+
+GST_EXPORT
+gboolean gst_mpegts_section_cache_add (GstMpegtsSectionCache * cache,
+				       GstMpegtsSection * section);
+
 G_END_DECLS
 
 #endif				/* GST_MPEGTS_SECTION_H */
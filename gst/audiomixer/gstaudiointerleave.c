@@ -29,6 +29,13 @@
  * SECTION:element-audiointerleave
  * @title: audiointerleave
  *
+ * Merges mono input streams into one interleaved multi-channel stream.
+ *
+ * The input buffers of all pads are only recorded while mixing and are
+ * interleaved together once the output buffer is complete. This is done in
+ * blocks of the output that fit into the CPU cache, handling groups of
+ * adjacent channels at once, so that every output cache line is only written
+ * a few times instead of once per input pad.
  */
 
 /* FIXME 0.11: suppress warnings for deprecated API such as GValueArray
@@ -156,11 +163,33 @@ static void gst_audio_interleave_release_pad (GstElement * element,
     GstPad * pad);
 
 static gboolean gst_audio_interleave_stop (GstAggregator * agg);
+static GstFlowReturn gst_audio_interleave_flush (GstAggregator * agg);
 
 static gboolean
 gst_audio_interleave_aggregate_one_buffer (GstAudioAggregator * aagg,
     GstAudioAggregatorPad * aaggpad, GstBuffer * inbuf, guint in_offset,
     GstBuffer * outbuf, guint out_offset, guint num_samples);
+static GstBuffer *gst_audio_interleave_create_output_buffer (GstAudioAggregator
+    * aagg, guint num_frames);
+static void gst_audio_interleave_finish_output_buffer (GstAudioAggregator *
+    aagg, GstBuffer * outbuf);
+
+/* An input buffer range that is to be interleaved into the current output
+ * buffer */
+typedef struct
+{
+  GstBuffer *inbuf;
+  GstMapInfo inmap;
+  guint in_offset;
+  guint in_bpf;
+  guint out_offset;
+  guint num_frames;
+  gint channel;
+} GstAudioInterleaveInput;
+
+/* Size of the output blocks that are completely interleaved before moving on
+ * to the next one, small enough to stay in the L1 cache */
+#define INTERLEAVE_BLOCK_SIZE 8192
 
 
 static void
@@ -359,11 +388,34 @@ static void interleave_##type (guint##type *out, guint##type *in, \
   } \
 }
 
+/* Same for four adjacent output channels at once, which writes them with
+ * consecutive stores instead of four passes over the output */
+#define MAKE_GROUP_FUNC(type) \
+static void interleave_group_##type (guint##type *out, guint##type **in, \
+    guint stride, guint nframes) \
+{ \
+  const guint##type *in0 = in[0], *in1 = in[1], *in2 = in[2], *in3 = in[3]; \
+  gint i; \
+  \
+  for (i = 0; i < nframes; i++) { \
+    out[0] = in0[i]; \
+    out[1] = in1[i]; \
+    out[2] = in2[i]; \
+    out[3] = in3[i]; \
+    out += stride; \
+  } \
+}
+
 MAKE_FUNC (8);
 MAKE_FUNC (16);
 MAKE_FUNC (32);
 MAKE_FUNC (64);
 
+MAKE_GROUP_FUNC (8);
+MAKE_GROUP_FUNC (16);
+MAKE_GROUP_FUNC (32);
+MAKE_GROUP_FUNC (64);
+
 static void
 interleave_24 (guint8 * out, guint8 * in, guint stride, guint nframes)
 {
@@ -376,6 +428,18 @@ interleave_24 (guint8 * out, guint8 * in, guint stride, guint nframes)
   }
 }
 
+static void
+interleave_group_24 (guint8 * out, guint8 ** in, guint stride, guint nframes)
+{
+  gint i, j;
+
+  for (i = 0; i < nframes; i++) {
+    for (j = 0; j < 4; j++)
+      memcpy (out + j * 3, in[j] + i * 3, 3);
+    out += stride * 3;
+  }
+}
+
 static void
 gst_audio_interleave_set_process_function (GstAudioInterleave * self,
     GstAudioInfo * info)
@@ -383,18 +447,23 @@ gst_audio_interleave_set_process_function (GstAudioInterleave * self,
   switch (GST_AUDIO_INFO_WIDTH (info)) {
     case 8:
       self->func = (GstInterleaveFunc) interleave_8;
+      self->group_func = (GstInterleaveGroupFunc) interleave_group_8;
       break;
     case 16:
       self->func = (GstInterleaveFunc) interleave_16;
+      self->group_func = (GstInterleaveGroupFunc) interleave_group_16;
       break;
     case 24:
       self->func = (GstInterleaveFunc) interleave_24;
+      self->group_func = (GstInterleaveGroupFunc) interleave_group_24;
       break;
     case 32:
       self->func = (GstInterleaveFunc) interleave_32;
+      self->group_func = (GstInterleaveGroupFunc) interleave_group_32;
       break;
     case 64:
       self->func = (GstInterleaveFunc) interleave_64;
+      self->group_func = (GstInterleaveGroupFunc) interleave_group_64;
       break;
     default:
       g_assert_not_reached ();
@@ -576,10 +645,13 @@ gst_audio_interleave_class_init (GstAudioInterleaveClass * klass)
   agg_class->sink_query = GST_DEBUG_FUNCPTR (gst_audio_interleave_sink_query);
   agg_class->sink_event = GST_DEBUG_FUNCPTR (gst_audio_interleave_sink_event);
   agg_class->stop = gst_audio_interleave_stop;
+  agg_class->flush = gst_audio_interleave_flush;
   agg_class->update_src_caps = gst_audio_interleave_update_src_caps;
   agg_class->negotiated_src_caps = gst_audio_interleave_negotiated_src_caps;
 
   aagg_class->aggregate_one_buffer = gst_audio_interleave_aggregate_one_buffer;
+  aagg_class->create_output_buffer = gst_audio_interleave_create_output_buffer;
+  aagg_class->finish_output_buffer = gst_audio_interleave_finish_output_buffer;
   aagg_class->convert_buffer = NULL;
 
   /**
@@ -629,6 +701,18 @@ gst_audio_interleave_init (GstAudioInterleave * self)
   self->input_channel_positions = g_value_array_new (0);
   self->channel_positions_from_input = TRUE;
   self->channel_positions = self->input_channel_positions;
+  self->pending = g_array_new (FALSE, FALSE, sizeof (GstAudioInterleaveInput));
+}
+
+static void
+gst_audio_interleave_clear_pending (GstAudioInterleave * self)
+{
+  guint i;
+
+  for (i = 0; i < self->pending->len; i++)
+    gst_buffer_unref (g_array_index (self->pending, GstAudioInterleaveInput,
+            i).inbuf);
+  g_array_set_size (self->pending, 0);
 }
 
 static void
@@ -647,6 +731,9 @@ gst_audio_interleave_finalize (GObject * object)
     self->input_channel_positions = NULL;
   }
 
+  gst_audio_interleave_clear_pending (self);
+  g_array_free (self->pending, TRUE);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -712,10 +799,21 @@ gst_audio_interleave_stop (GstAggregator * agg)
     return FALSE;
 
   gst_caps_replace (&self->sinkcaps, NULL);
+  gst_audio_interleave_clear_pending (self);
 
   return TRUE;
 }
 
+static GstFlowReturn
+gst_audio_interleave_flush (GstAggregator * agg)
+{
+  GstAudioInterleave *self = GST_AUDIO_INTERLEAVE (agg);
+
+  gst_audio_interleave_clear_pending (self);
+
+  return GST_AGGREGATOR_CLASS (parent_class)->flush (agg);
+}
+
 static GstPad *
 gst_audio_interleave_request_new_pad (GstElement * element,
     GstPadTemplate * templ, const gchar * req_name, const GstCaps * caps)
@@ -807,7 +905,9 @@ gst_audio_interleave_release_pad (GstElement * element, GstPad * pad)
 }
 
 
-/* Called with object lock and pad object lock held */
+/* Only records which range of the input buffer goes to which channel, the
+ * actual interleaving happens for all pads together once the output buffer
+ * is complete */
 static gboolean
 gst_audio_interleave_aggregate_one_buffer (GstAudioAggregator * aagg,
     GstAudioAggregatorPad * aaggpad, GstBuffer * inbuf, guint in_offset,
@@ -815,45 +915,153 @@ gst_audio_interleave_aggregate_one_buffer (GstAudioAggregator * aagg,
 {
   GstAudioInterleave *self = GST_AUDIO_INTERLEAVE (aagg);
   GstAudioInterleavePad *pad = GST_AUDIO_INTERLEAVE_PAD (aaggpad);
-  GstMapInfo inmap;
-  GstMapInfo outmap;
-  gint out_width, in_bpf, out_bpf, out_channels, channel;
-  guint8 *outdata;
+  GstAudioInterleaveInput input;
 
   GST_OBJECT_LOCK (aagg);
   GST_OBJECT_LOCK (aaggpad);
 
-  out_width = GST_AUDIO_INFO_WIDTH (&aagg->info) / 8;
-  in_bpf = GST_AUDIO_INFO_BPF (&aaggpad->info);
-  out_bpf = GST_AUDIO_INFO_BPF (&aagg->info);
-  out_channels = GST_AUDIO_INFO_CHANNELS (&aagg->info);
-
-  gst_buffer_map (outbuf, &outmap, GST_MAP_READWRITE);
-  gst_buffer_map (inbuf, &inmap, GST_MAP_READ);
   GST_LOG_OBJECT (pad, "interleaves %u frames on channel %d/%d at offset %u"
-      " from offset %u", num_frames, pad->channel, out_channels,
-      out_offset * out_bpf, in_offset * in_bpf);
+      " from offset %u", num_frames, pad->channel,
+      GST_AUDIO_INFO_CHANNELS (&aagg->info), out_offset, in_offset);
+
+  input.inbuf = gst_buffer_ref (inbuf);
+  input.in_offset = in_offset;
+  input.in_bpf = GST_AUDIO_INFO_BPF (&aaggpad->info);
+  input.out_offset = out_offset;
+  input.num_frames = num_frames;
 
   if (self->channels > 64) {
-    channel = pad->channel;
+    input.channel = pad->channel;
   } else {
-    channel = self->default_channels_ordering_map[pad->channel];
+    input.channel = self->default_channels_ordering_map[pad->channel];
   }
 
-  outdata = outmap.data + (out_offset * out_bpf) + (out_width * channel);
+  g_array_append_val (self->pending, input);
 
+  GST_OBJECT_UNLOCK (aaggpad);
+  GST_OBJECT_UNLOCK (aagg);
+
+  return TRUE;
+}
 
-  self->func (outdata, inmap.data + (in_offset * in_bpf), out_channels,
+static GstBuffer *
+gst_audio_interleave_create_output_buffer (GstAudioAggregator * aagg,
+    guint num_frames)
+{
+  GstAudioInterleave *self = GST_AUDIO_INTERLEAVE (aagg);
+
+  /* Anything still pending belongs to an output buffer that was dropped */
+  gst_audio_interleave_clear_pending (self);
+
+  return GST_AUDIO_AGGREGATOR_CLASS (parent_class)->create_output_buffer (aagg,
       num_frames);
+}
+
+static gint
+compare_inputs (gconstpointer a, gconstpointer b)
+{
+  const GstAudioInterleaveInput *ia = a;
+  const GstAudioInterleaveInput *ib = b;
+
+  if (ia->channel != ib->channel)
+    return ia->channel < ib->channel ? -1 : 1;
+  if (ia->out_offset != ib->out_offset)
+    return ia->out_offset < ib->out_offset ? -1 : 1;
+  return 0;
+}
 
+static void
+gst_audio_interleave_finish_output_buffer (GstAudioAggregator * aagg,
+    GstBuffer * outbuf)
+{
+  GstAudioInterleave *self = GST_AUDIO_INTERLEAVE (aagg);
+  GstAudioInterleaveInput *inputs;
+  GstMapInfo outmap;
+  guint n_inputs, out_frames, block_frames, start, i, j;
+  gint out_width, out_bpf, out_channels;
 
-  gst_buffer_unmap (inbuf, &inmap);
-  gst_buffer_unmap (outbuf, &outmap);
+  n_inputs = self->pending->len;
+  if (n_inputs == 0)
+    return;
 
-  GST_OBJECT_UNLOCK (aaggpad);
+  GST_OBJECT_LOCK (aagg);
+  out_width = GST_AUDIO_INFO_WIDTH (&aagg->info) / 8;
+  out_bpf = GST_AUDIO_INFO_BPF (&aagg->info);
+  out_channels = GST_AUDIO_INFO_CHANNELS (&aagg->info);
   GST_OBJECT_UNLOCK (aagg);
 
-  return TRUE;
+  g_array_sort (self->pending, compare_inputs);
+  inputs = (GstAudioInterleaveInput *) self->pending->data;
+
+  gst_buffer_map (outbuf, &outmap, GST_MAP_READWRITE);
+  for (i = 0; i < n_inputs; i++)
+    gst_buffer_map (inputs[i].inbuf, &inputs[i].inmap, GST_MAP_READ);
+
+  out_frames = outmap.size / out_bpf;
+
+  GST_LOG_OBJECT (self, "interleaving %u inputs into %u frames", n_inputs,
+      out_frames);
+
+  if (out_channels == 1) {
+    /* Nothing to interleave, just copy the single channel over */
+    for (i = 0; i < n_inputs; i++) {
+      memcpy (outmap.data + inputs[i].out_offset * out_bpf,
+          inputs[i].inmap.data + inputs[i].in_offset * inputs[i].in_bpf,
+          inputs[i].num_frames * out_bpf);
+    }
+    goto done;
+  }
+
+  block_frames = MAX (1, INTERLEAVE_BLOCK_SIZE / out_bpf);
+
+  for (start = 0; start < out_frames; start += block_frames) {
+    guint end = MIN (start + block_frames, out_frames);
+
+    for (i = 0; i < n_inputs;) {
+      GstAudioInterleaveInput *input = &inputs[i];
+      guint first = MAX (start, input->out_offset);
+      guint last = MIN (end, input->out_offset + input->num_frames);
+      guint8 *outdata;
+      guint group = 1;
+
+      if (first >= last) {
+        i++;
+        continue;
+      }
+
+      outdata = outmap.data + first * out_bpf + input->channel * out_width;
+
+      /* inputs are sorted by channel, so check if the next three cover the
+       * next three channels for the same range */
+      while (group < 4 && i + group < n_inputs
+          && inputs[i + group].channel == input->channel + group
+          && inputs[i + group].out_offset == input->out_offset
+          && inputs[i + group].num_frames == input->num_frames)
+        group++;
+
+      if (group == 4) {
+        gpointer in[4];
+
+        for (j = 0; j < 4; j++)
+          in[j] = inputs[i + j].inmap.data + (inputs[i + j].in_offset +
+              first - inputs[i + j].out_offset) * inputs[i + j].in_bpf;
+        self->group_func (outdata, in, out_channels, last - first);
+      } else {
+        group = 1;
+        self->func (outdata, input->inmap.data + (input->in_offset + first -
+                input->out_offset) * input->in_bpf, out_channels,
+            last - first);
+      }
+      i += group;
+    }
+  }
+
+done:
+  for (i = 0; i < n_inputs; i++)
+    gst_buffer_unmap (inputs[i].inbuf, &inputs[i].inmap);
+  gst_buffer_unmap (outbuf, &outmap);
+
+  gst_audio_interleave_clear_pending (self);
 }
 
 
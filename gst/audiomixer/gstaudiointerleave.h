@@ -46,6 +46,8 @@ typedef struct _GstAudioInterleavePadClass GstAudioInterleavePadClass;
 
 typedef void (*GstInterleaveFunc) (gpointer out, gpointer in, guint stride,
     guint nframes);
+typedef void (*GstInterleaveGroupFunc) (gpointer out, gpointer * in,
+    guint stride, guint nframes);
 
 /**
  * GstAudioInterleave:
@@ -67,6 +69,11 @@ struct _GstAudioInterleave {
   gint default_channels_ordering_map[64];
 
   GstInterleaveFunc func;
+  GstInterleaveGroupFunc group_func;
+
+  /* input buffers recorded for the current output buffer, interleaved all
+   * together in finish_output_buffer */
+  GArray *pending;
 };
 
 struct _GstAudioInterleaveClass {
@@ -48,6 +48,15 @@
  *
  * * "mute": Whether to mute the pad or not (#gboolean)
  * * "volume": The volume of the pad, between 0.0 and 10.0 (#gdouble)
+ * * "volume-ramp-mode": How volume changes are applied (#GstAudioMixerRampMode)
+ * * "volume-ramp-duration": Duration of a volume ramp (#guint64)
+ *
+ * By default volume changes take effect at the next mixed sample. With a
+ * "volume-ramp-mode" other than "none" each volume change instead ramps the
+ * gain sample-accurately from its current value to the new one over
+ * "volume-ramp-duration", which avoids zipper noise when the volume is
+ * automated, e.g. with a #GstControlSource. The ramp is applied while mixing,
+ * so it doesn't cost an additional pass over the samples.
  *
  * ## Example launch line
  * |[
@@ -63,6 +72,7 @@
 #include "gstaudiomixer.h"
 #include <gst/audio/audio.h>
 #include <string.h>             /* strcmp */
+#include <math.h>
 #include "gstaudiomixerorc.h"
 
 #include "gstaudiointerleave.h"
@@ -72,6 +82,12 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
 #define DEFAULT_PAD_VOLUME (1.0)
 #define DEFAULT_PAD_MUTE (FALSE)
+#define DEFAULT_PAD_VOLUME_RAMP_MODE GST_AUDIO_MIXER_RAMP_MODE_NONE
+#define DEFAULT_PAD_VOLUME_RAMP_DURATION (10 * GST_MSECOND)
+
+/* exponential ramps can't start or end at 0.0, so they go from/to -60dB
+ * instead and the gain snaps to the target volume at the end */
+#define VOLUME_RAMP_EXP_FLOOR (0.001)
 
 /* some defines for audio processing */
 /* the volume factor is a range from 0.0 to (arbitrary) VOLUME_MAX_DOUBLE = 10.0
@@ -90,9 +106,33 @@ enum
 {
   PROP_PAD_0,
   PROP_PAD_VOLUME,
-  PROP_PAD_MUTE
+  PROP_PAD_MUTE,
+  PROP_PAD_VOLUME_RAMP_MODE,
+  PROP_PAD_VOLUME_RAMP_DURATION
 };
 
+#define GST_TYPE_AUDIO_MIXER_RAMP_MODE (gst_audio_mixer_ramp_mode_get_type())
+static GType
+gst_audio_mixer_ramp_mode_get_type (void)
+{
+  static GType ramp_mode_type = 0;
+
+  static const GEnumValue ramp_modes[] = {
+    {GST_AUDIO_MIXER_RAMP_MODE_NONE, "Apply volume changes immediately",
+        "none"},
+    {GST_AUDIO_MIXER_RAMP_MODE_LINEAR, "Linear volume ramp", "linear"},
+    {GST_AUDIO_MIXER_RAMP_MODE_EXPONENTIAL, "Exponential volume ramp",
+        "exponential"},
+    {0, NULL, NULL},
+  };
+
+  if (!ramp_mode_type) {
+    ramp_mode_type =
+        g_enum_register_static ("GstAudioMixerRampMode", ramp_modes);
+  }
+  return ramp_mode_type;
+}
+
 G_DEFINE_TYPE (GstAudioMixerPad, gst_audiomixer_pad,
     GST_TYPE_AUDIO_AGGREGATOR_CONVERT_PAD);
 
@@ -109,6 +149,12 @@ gst_audiomixer_pad_get_property (GObject * object, guint prop_id,
     case PROP_PAD_MUTE:
       g_value_set_boolean (value, pad->mute);
       break;
+    case PROP_PAD_VOLUME_RAMP_MODE:
+      g_value_set_enum (value, pad->ramp_mode);
+      break;
+    case PROP_PAD_VOLUME_RAMP_DURATION:
+      g_value_set_uint64 (value, pad->ramp_duration);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -128,6 +174,7 @@ gst_audiomixer_pad_set_property (GObject * object, guint prop_id,
       pad->volume_i8 = pad->volume * VOLUME_UNITY_INT8;
       pad->volume_i16 = pad->volume * VOLUME_UNITY_INT16;
       pad->volume_i32 = pad->volume * VOLUME_UNITY_INT32;
+      pad->ramp_pending = TRUE;
       GST_OBJECT_UNLOCK (pad);
       break;
     case PROP_PAD_MUTE:
@@ -135,6 +182,16 @@ gst_audiomixer_pad_set_property (GObject * object, guint prop_id,
       pad->mute = g_value_get_boolean (value);
       GST_OBJECT_UNLOCK (pad);
       break;
+    case PROP_PAD_VOLUME_RAMP_MODE:
+      GST_OBJECT_LOCK (pad);
+      pad->ramp_mode = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (pad);
+      break;
+    case PROP_PAD_VOLUME_RAMP_DURATION:
+      GST_OBJECT_LOCK (pad);
+      pad->ramp_duration = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (pad);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -157,6 +214,17 @@ gst_audiomixer_pad_class_init (GstAudioMixerPadClass * klass)
       g_param_spec_boolean ("mute", "Mute", "Mute this pad",
           DEFAULT_PAD_MUTE,
           G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PAD_VOLUME_RAMP_MODE,
+      g_param_spec_enum ("volume-ramp-mode", "Volume Ramp Mode",
+          "How to move from the current to a newly set volume",
+          GST_TYPE_AUDIO_MIXER_RAMP_MODE, DEFAULT_PAD_VOLUME_RAMP_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class,
+      PROP_PAD_VOLUME_RAMP_DURATION,
+      g_param_spec_uint64 ("volume-ramp-duration", "Volume Ramp Duration",
+          "Duration of the ramp to a newly set volume (in nanoseconds)",
+          0, G_MAXUINT64, DEFAULT_PAD_VOLUME_RAMP_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -164,6 +232,47 @@ gst_audiomixer_pad_init (GstAudioMixerPad * pad)
 {
   pad->volume = DEFAULT_PAD_VOLUME;
   pad->mute = DEFAULT_PAD_MUTE;
+  pad->ramp_mode = DEFAULT_PAD_VOLUME_RAMP_MODE;
+  pad->ramp_duration = DEFAULT_PAD_VOLUME_RAMP_DURATION;
+  pad->ramp_volume = DEFAULT_PAD_VOLUME;
+}
+
+/* Called with the pad's object lock held once a new volume was set. Until
+ * the pad mixed its first samples there is nothing to ramp from, so the
+ * new volume is used directly */
+static void
+gst_audiomixer_pad_start_ramp (GstAudioMixerPad * pad, gint rate)
+{
+  guint64 num_frames = 0;
+
+  pad->ramp_pending = FALSE;
+
+  if (pad->ramp_volume_valid && pad->ramp_mode != GST_AUDIO_MIXER_RAMP_MODE_NONE
+      && GST_CLOCK_TIME_IS_VALID (pad->ramp_duration))
+    num_frames = gst_util_uint64_scale_round (pad->ramp_duration, rate,
+        GST_SECOND);
+
+  if (num_frames == 0 || pad->ramp_volume == pad->volume) {
+    pad->ramp_volume = pad->volume;
+    pad->ramp_remaining = 0;
+    return;
+  }
+
+  pad->ramp_exponential =
+      (pad->ramp_mode == GST_AUDIO_MIXER_RAMP_MODE_EXPONENTIAL);
+  if (pad->ramp_exponential) {
+    gdouble from = MAX (pad->ramp_volume, VOLUME_RAMP_EXP_FLOOR);
+    gdouble to = MAX (pad->volume, VOLUME_RAMP_EXP_FLOOR);
+
+    pad->ramp_volume = from;
+    pad->ramp_step = pow (to / from, 1.0 / num_frames);
+  } else {
+    pad->ramp_step = (pad->volume - pad->ramp_volume) / num_frames;
+  }
+  pad->ramp_remaining = num_frames;
+
+  GST_DEBUG_OBJECT (pad, "ramping volume from %f to %f over %" G_GUINT64_FORMAT
+      " frames", pad->ramp_volume, pad->volume, num_frames);
 }
 
 enum
@@ -285,76 +394,145 @@ gst_audiomixer_release_pad (GstElement * element, GstPad * pad)
   GST_ELEMENT_CLASS (parent_class)->release_pad (element, pad);
 }
 
+/* Ramp kernels: add the input to the output while moving the gain by step
+ * after every frame, either additively or multiplicatively. Integer formats
+ * are mixed as signed values with the sign bit flipped for unsigned ones, and
+ * clamped like the saturating ORC kernels */
+#define MAKE_RAMP_FUNC_INT(name, ctype, stype, min_val, max_val, flip)     \
+static void                                                                 \
+audiomixer_ramp_add_##name (gpointer out, gconstpointer in, gint channels,  \
+    guint num_frames, gdouble * volume, gdouble step, gboolean exponential) \
+{                                                                           \
+  ctype *o = out;                                                           \
+  const ctype *s = in;                                                      \
+  gdouble v = *volume;                                                      \
+  guint i;                                                                  \
+  gint c;                                                                   \
+                                                                            \
+  for (i = 0; i < num_frames; i++) {                                        \
+    for (c = 0; c < channels; c++) {                                        \
+      gint64 val = (stype) (o[c] ^ flip) +                                  \
+          (gint64) ((stype) (s[c] ^ flip) * v);                             \
+      o[c] = ((ctype) CLAMP (val, min_val, max_val)) ^ flip;                \
+    }                                                                       \
+    o += channels;                                                          \
+    s += channels;                                                          \
+    v = exponential ? v * step : v + step;                                  \
+  }                                                                         \
+  *volume = v;                                                              \
+}
 
-static gboolean
-gst_audiomixer_aggregate_one_buffer (GstAudioAggregator * aagg,
-    GstAudioAggregatorPad * aaggpad, GstBuffer * inbuf, guint in_offset,
-    GstBuffer * outbuf, guint out_offset, guint num_frames)
-{
-  GstAudioMixerPad *pad = GST_AUDIO_MIXER_PAD (aaggpad);
-  GstMapInfo inmap;
-  GstMapInfo outmap;
-  gint bpf;
-
-  GST_OBJECT_LOCK (aagg);
-  GST_OBJECT_LOCK (aaggpad);
+#define MAKE_RAMP_FUNC_FLOAT(name, ctype)                                   \
+static void                                                                 \
+audiomixer_ramp_add_##name (gpointer out, gconstpointer in, gint channels,  \
+    guint num_frames, gdouble * volume, gdouble step, gboolean exponential) \
+{                                                                           \
+  ctype *o = out;                                                           \
+  const ctype *s = in;                                                      \
+  gdouble v = *volume;                                                      \
+  guint i;                                                                  \
+  gint c;                                                                   \
+                                                                            \
+  for (i = 0; i < num_frames; i++) {                                        \
+    for (c = 0; c < channels; c++)                                          \
+      o[c] += s[c] * v;                                                     \
+    o += channels;                                                          \
+    s += channels;                                                          \
+    v = exponential ? v * step : v + step;                                  \
+  }                                                                         \
+  *volume = v;                                                              \
+}
 
-  if (pad->mute || pad->volume < G_MINDOUBLE) {
-    GST_DEBUG_OBJECT (pad, "Skipping muted pad");
-    GST_OBJECT_UNLOCK (aaggpad);
-    GST_OBJECT_UNLOCK (aagg);
-    return FALSE;
+MAKE_RAMP_FUNC_INT (u8, guint8, gint8, G_MININT8, G_MAXINT8, 0x80)
+MAKE_RAMP_FUNC_INT (s8, gint8, gint8, G_MININT8, G_MAXINT8, 0)
+MAKE_RAMP_FUNC_INT (u16, guint16, gint16, G_MININT16, G_MAXINT16, 0x8000)
+MAKE_RAMP_FUNC_INT (s16, gint16, gint16, G_MININT16, G_MAXINT16, 0)
+MAKE_RAMP_FUNC_INT (u32, guint32, gint32, G_MININT32, G_MAXINT32,
+    0x80000000U)
+MAKE_RAMP_FUNC_INT (s32, gint32, gint32, G_MININT32, G_MAXINT32, 0)
+MAKE_RAMP_FUNC_FLOAT (f32, gfloat)
+MAKE_RAMP_FUNC_FLOAT (f64, gdouble)
+
+/* Called with the pad's object lock held */
+static void
+gst_audiomixer_mix_ramp (GstAudioAggregator * aagg, GstAudioMixerPad * pad,
+    guint8 * out, const guint8 * in, guint num_frames)
+{
+  gint channels = aagg->info.channels;
+  gdouble step = pad->ramp_step;
+  gboolean exponential = pad->ramp_exponential;
+
+  switch (aagg->info.finfo->format) {
+    case GST_AUDIO_FORMAT_U8:
+      audiomixer_ramp_add_u8 (out, in, channels, num_frames,
+          &pad->ramp_volume, step, exponential);
+      break;
+    case GST_AUDIO_FORMAT_S8:
+      audiomixer_ramp_add_s8 (out, in, channels, num_frames,
+          &pad->ramp_volume, step, exponential);
+      break;
+    case GST_AUDIO_FORMAT_U16:
+      audiomixer_ramp_add_u16 (out, in, channels, num_frames,
+          &pad->ramp_volume, step, exponential);
+      break;
+    case GST_AUDIO_FORMAT_S16:
+      audiomixer_ramp_add_s16 (out, in, channels, num_frames,
+          &pad->ramp_volume, step, exponential);
+      break;
+    case GST_AUDIO_FORMAT_U32:
+      audiomixer_ramp_add_u32 (out, in, channels, num_frames,
+          &pad->ramp_volume, step, exponential);
+      break;
+    case GST_AUDIO_FORMAT_S32:
+      audiomixer_ramp_add_s32 (out, in, channels, num_frames,
+          &pad->ramp_volume, step, exponential);
+      break;
+    case GST_AUDIO_FORMAT_F32:
+      audiomixer_ramp_add_f32 (out, in, channels, num_frames,
+          &pad->ramp_volume, step, exponential);
+      break;
+    case GST_AUDIO_FORMAT_F64:
+      audiomixer_ramp_add_f64 (out, in, channels, num_frames,
+          &pad->ramp_volume, step, exponential);
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
   }
+}
 
-  bpf = GST_AUDIO_INFO_BPF (&aagg->info);
-
-  gst_buffer_map (outbuf, &outmap, GST_MAP_READWRITE);
-  gst_buffer_map (inbuf, &inmap, GST_MAP_READ);
-  GST_LOG_OBJECT (pad, "mixing %u bytes at offset %u from offset %u",
-      num_frames * bpf, out_offset * bpf, in_offset * bpf);
+/* Called with the pad's object lock held */
+static void
+gst_audiomixer_mix_volume (GstAudioAggregator * aagg, GstAudioMixerPad * pad,
+    guint8 * out, const guint8 * in, guint num_frames)
+{
+  guint num_samples = num_frames * aagg->info.channels;
 
-  /* further buffers, need to add them */
   if (pad->volume == 1.0) {
     switch (aagg->info.finfo->format) {
       case GST_AUDIO_FORMAT_U8:
-        audiomixer_orc_add_u8 ((gpointer) (outmap.data + out_offset * bpf),
-            (gpointer) (inmap.data + in_offset * bpf),
-            num_frames * aagg->info.channels);
+        audiomixer_orc_add_u8 ((gpointer) out, (gpointer) in, num_samples);
         break;
       case GST_AUDIO_FORMAT_S8:
-        audiomixer_orc_add_s8 ((gpointer) (outmap.data + out_offset * bpf),
-            (gpointer) (inmap.data + in_offset * bpf),
-            num_frames * aagg->info.channels);
+        audiomixer_orc_add_s8 ((gpointer) out, (gpointer) in, num_samples);
         break;
       case GST_AUDIO_FORMAT_U16:
-        audiomixer_orc_add_u16 ((gpointer) (outmap.data + out_offset * bpf),
-            (gpointer) (inmap.data + in_offset * bpf),
-            num_frames * aagg->info.channels);
+        audiomixer_orc_add_u16 ((gpointer) out, (gpointer) in, num_samples);
         break;
       case GST_AUDIO_FORMAT_S16:
-        audiomixer_orc_add_s16 ((gpointer) (outmap.data + out_offset * bpf),
-            (gpointer) (inmap.data + in_offset * bpf),
-            num_frames * aagg->info.channels);
+        audiomixer_orc_add_s16 ((gpointer) out, (gpointer) in, num_samples);
         break;
       case GST_AUDIO_FORMAT_U32:
-        audiomixer_orc_add_u32 ((gpointer) (outmap.data + out_offset * bpf),
-            (gpointer) (inmap.data + in_offset * bpf),
-            num_frames * aagg->info.channels);
+        audiomixer_orc_add_u32 ((gpointer) out, (gpointer) in, num_samples);
         break;
       case GST_AUDIO_FORMAT_S32:
-        audiomixer_orc_add_s32 ((gpointer) (outmap.data + out_offset * bpf),
-            (gpointer) (inmap.data + in_offset * bpf),
-            num_frames * aagg->info.channels);
+        audiomixer_orc_add_s32 ((gpointer) out, (gpointer) in, num_samples);
         break;
       case GST_AUDIO_FORMAT_F32:
-        audiomixer_orc_add_f32 ((gpointer) (outmap.data + out_offset * bpf),
-            (gpointer) (inmap.data + in_offset * bpf),
-            num_frames * aagg->info.channels);
+        audiomixer_orc_add_f32 ((gpointer) out, (gpointer) in, num_samples);
         break;
       case GST_AUDIO_FORMAT_F64:
-        audiomixer_orc_add_f64 ((gpointer) (outmap.data + out_offset * bpf),
-            (gpointer) (inmap.data + in_offset * bpf),
-            num_frames * aagg->info.channels);
+        audiomixer_orc_add_f64 ((gpointer) out, (gpointer) in, num_samples);
         break;
       default:
         g_assert_not_reached ();
@@ -363,50 +541,99 @@ gst_audiomixer_aggregate_one_buffer (GstAudioAggregator * aagg,
   } else {
     switch (aagg->info.finfo->format) {
       case GST_AUDIO_FORMAT_U8:
-        audiomixer_orc_add_volume_u8 ((gpointer) (outmap.data +
-                out_offset * bpf), (gpointer) (inmap.data + in_offset * bpf),
-            pad->volume_i8, num_frames * aagg->info.channels);
+        audiomixer_orc_add_volume_u8 ((gpointer) out, (gpointer) in,
+            pad->volume_i8, num_samples);
         break;
       case GST_AUDIO_FORMAT_S8:
-        audiomixer_orc_add_volume_s8 ((gpointer) (outmap.data +
-                out_offset * bpf), (gpointer) (inmap.data + in_offset * bpf),
-            pad->volume_i8, num_frames * aagg->info.channels);
+        audiomixer_orc_add_volume_s8 ((gpointer) out, (gpointer) in,
+            pad->volume_i8, num_samples);
         break;
       case GST_AUDIO_FORMAT_U16:
-        audiomixer_orc_add_volume_u16 ((gpointer) (outmap.data +
-                out_offset * bpf), (gpointer) (inmap.data + in_offset * bpf),
-            pad->volume_i16, num_frames * aagg->info.channels);
+        audiomixer_orc_add_volume_u16 ((gpointer) out, (gpointer) in,
+            pad->volume_i16, num_samples);
         break;
       case GST_AUDIO_FORMAT_S16:
-        audiomixer_orc_add_volume_s16 ((gpointer) (outmap.data +
-                out_offset * bpf), (gpointer) (inmap.data + in_offset * bpf),
-            pad->volume_i16, num_frames * aagg->info.channels);
+        audiomixer_orc_add_volume_s16 ((gpointer) out, (gpointer) in,
+            pad->volume_i16, num_samples);
         break;
       case GST_AUDIO_FORMAT_U32:
-        audiomixer_orc_add_volume_u32 ((gpointer) (outmap.data +
-                out_offset * bpf), (gpointer) (inmap.data + in_offset * bpf),
-            pad->volume_i32, num_frames * aagg->info.channels);
+        audiomixer_orc_add_volume_u32 ((gpointer) out, (gpointer) in,
+            pad->volume_i32, num_samples);
         break;
       case GST_AUDIO_FORMAT_S32:
-        audiomixer_orc_add_volume_s32 ((gpointer) (outmap.data +
-                out_offset * bpf), (gpointer) (inmap.data + in_offset * bpf),
-            pad->volume_i32, num_frames * aagg->info.channels);
+        audiomixer_orc_add_volume_s32 ((gpointer) out, (gpointer) in,
+            pad->volume_i32, num_samples);
         break;
       case GST_AUDIO_FORMAT_F32:
-        audiomixer_orc_add_volume_f32 ((gpointer) (outmap.data +
-                out_offset * bpf), (gpointer) (inmap.data + in_offset * bpf),
-            pad->volume, num_frames * aagg->info.channels);
+        audiomixer_orc_add_volume_f32 ((gpointer) out, (gpointer) in,
+            pad->volume, num_samples);
         break;
       case GST_AUDIO_FORMAT_F64:
-        audiomixer_orc_add_volume_f64 ((gpointer) (outmap.data +
-                out_offset * bpf), (gpointer) (inmap.data + in_offset * bpf),
-            pad->volume, num_frames * aagg->info.channels);
+        audiomixer_orc_add_volume_f64 ((gpointer) out, (gpointer) in,
+            pad->volume, num_samples);
         break;
       default:
         g_assert_not_reached ();
         break;
     }
   }
+}
+
+static gboolean
+gst_audiomixer_aggregate_one_buffer (GstAudioAggregator * aagg,
+    GstAudioAggregatorPad * aaggpad, GstBuffer * inbuf, guint in_offset,
+    GstBuffer * outbuf, guint out_offset, guint num_frames)
+{
+  GstAudioMixerPad *pad = GST_AUDIO_MIXER_PAD (aaggpad);
+  GstMapInfo inmap;
+  GstMapInfo outmap;
+  guint8 *out;
+  const guint8 *in;
+  gint bpf;
+
+  GST_OBJECT_LOCK (aagg);
+  GST_OBJECT_LOCK (aaggpad);
+
+  if (pad->ramp_pending)
+    gst_audiomixer_pad_start_ramp (pad, GST_AUDIO_INFO_RATE (&aagg->info));
+
+  if (pad->mute || (pad->volume < G_MINDOUBLE && pad->ramp_remaining == 0)) {
+    GST_DEBUG_OBJECT (pad, "Skipping muted pad");
+    pad->ramp_volume_valid = TRUE;
+    GST_OBJECT_UNLOCK (aaggpad);
+    GST_OBJECT_UNLOCK (aagg);
+    return FALSE;
+  }
+
+  bpf = GST_AUDIO_INFO_BPF (&aagg->info);
+
+  gst_buffer_map (outbuf, &outmap, GST_MAP_READWRITE);
+  gst_buffer_map (inbuf, &inmap, GST_MAP_READ);
+  GST_LOG_OBJECT (pad, "mixing %u bytes at offset %u from offset %u",
+      num_frames * bpf, out_offset * bpf, in_offset * bpf);
+
+  out = outmap.data + out_offset * bpf;
+  in = inmap.data + in_offset * bpf;
+
+  /* further buffers, need to add them */
+  if (pad->ramp_remaining > 0) {
+    guint ramp_frames = MIN (num_frames, pad->ramp_remaining);
+
+    gst_audiomixer_mix_ramp (aagg, pad, out, in, ramp_frames);
+    pad->ramp_remaining -= ramp_frames;
+    if (pad->ramp_remaining == 0)
+      pad->ramp_volume = pad->volume;
+
+    out += ramp_frames * bpf;
+    in += ramp_frames * bpf;
+    num_frames -= ramp_frames;
+  }
+
+  if (num_frames > 0 && pad->volume >= G_MINDOUBLE)
+    gst_audiomixer_mix_volume (aagg, pad, out, in, num_frames);
+
+  pad->ramp_volume_valid = TRUE;
+
   gst_buffer_unmap (inbuf, &inmap);
   gst_buffer_unmap (outbuf, &outmap);
 
@@ -43,6 +43,21 @@ typedef struct _GstAudioMixerClass        GstAudioMixerClass;
 typedef struct _GstAudioMixerPad GstAudioMixerPad;
 typedef struct _GstAudioMixerPadClass GstAudioMixerPadClass;
 
+/**
+ * GstAudioMixerRampMode:
+ * @GST_AUDIO_MIXER_RAMP_MODE_NONE: volume changes are applied immediately
+ * @GST_AUDIO_MIXER_RAMP_MODE_LINEAR: volume changes are ramped linearly
+ * @GST_AUDIO_MIXER_RAMP_MODE_EXPONENTIAL: volume changes are ramped
+ *   exponentially, i.e. linearly in dB
+ *
+ * How a pad moves from its current to a newly set volume.
+ */
+typedef enum {
+  GST_AUDIO_MIXER_RAMP_MODE_NONE,
+  GST_AUDIO_MIXER_RAMP_MODE_LINEAR,
+  GST_AUDIO_MIXER_RAMP_MODE_EXPONENTIAL
+} GstAudioMixerRampMode;
+
 /**
  * GstAudioMixer:
  *
@@ -73,6 +88,18 @@ struct _GstAudioMixerPad {
   gint volume_i16;
   gint volume_i8;
   gboolean mute;
+
+  GstAudioMixerRampMode ramp_mode;
+  GstClockTime ramp_duration;
+
+  /* gain that was applied to the last mixed sample, the ramp runs from
+   * here towards volume over ramp_remaining frames */
+  gdouble ramp_volume;
+  gboolean ramp_pending;
+  gboolean ramp_exponential;
+  gboolean ramp_volume_valid;
+  guint64 ramp_remaining;
+  gdouble ramp_step;
 };
 
 struct _GstAudioMixerPadClass {
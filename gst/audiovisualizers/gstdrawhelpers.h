@@ -45,13 +45,14 @@
 #define draw_line(_vd, _x1, _x2, _y1, _y2, _st, _c) G_STMT_START {             \
   guint _i, _j, _x, _y;                                                        \
   gint _dx = _x2 - _x1, _dy = _y2 - _y1;                                       \
-  gfloat _f;                                                                   \
+  gfloat _sx, _sy;                                                             \
                                                                                \
   _j = abs (_dx) > abs (_dy) ? abs (_dx) : abs (_dy);                          \
+  _sx = _j ? (gfloat) _dx / (gfloat) _j : 0.0;                                 \
+  _sy = _j ? (gfloat) _dy / (gfloat) _j : 0.0;                                 \
   for (_i = 0; _i < _j; _i++) {                                                \
-    _f = (gfloat) _i / (gfloat) _j;                                            \
-    _x = _x1 + _dx * _f;                                                       \
-    _y = _y1 + _dy * _f;                                                       \
+    _x = _x1 + _i * _sx;                                                       \
+    _y = _y1 + _i * _sy;                                                       \
     draw_dot (_vd, _x, _y, _st, _c);                                           \
   }                                                                            \
 } G_STMT_END
@@ -59,13 +60,14 @@
 #define draw_line_aa(_vd, _x1, _x2, _y1, _y2, _st, _c) G_STMT_START {          \
   guint _i, _j, _x, _y;                                                        \
   gint _dx = _x2 - _x1, _dy = _y2 - _y1;                                       \
-  gfloat _f, _rx, _ry, _fx, _fy;                                               \
+  gfloat _f, _rx, _ry, _fx, _fy, _sx, _sy;                                     \
                                                                                \
   _j = abs (_dx) > abs (_dy) ? abs (_dx) : abs (_dy);                          \
+  _sx = _j ? (gfloat) _dx / (gfloat) _j : 0.0;                                 \
+  _sy = _j ? (gfloat) _dy / (gfloat) _j : 0.0;                                 \
   for (_i = 0; _i < _j; _i++) {                                                \
-    _f = (gfloat) _i / (gfloat) _j;                                            \
-    _rx = _x1 + _dx * _f;                                                      \
-    _ry = _y1 + _dy * _f;                                                      \
+    _rx = _x1 + _i * _sx;                                                      \
+    _ry = _y1 + _i * _sy;                                                      \
     _x = (guint)_rx;                                                           \
     _y = (guint)_ry;                                                           \
     _fx = _rx - (gfloat)_x;                                                    \
@@ -85,3 +87,16 @@
   }                                                                            \
 } G_STMT_END
 
+/* Adds the colour to the pixel, saturating each of the four bytes. This
+ * works on all bytes at once: the low 7 bits of each byte are added without
+ * carrying into the next byte and the bytes that overflow are set to 255 */
+static inline void
+add_pixel (guint32 * p, guint32 c)
+{
+  guint32 a = *p, s, ov;
+
+  s = (a & 0x7f7f7f7f) + (c & 0x7f7f7f7f);
+  s ^= (a ^ c) & 0x80808080;
+  ov = ((a & c) | ((a | c) & ~s)) & 0x80808080;
+  *p = s | ((ov >> 7) * 0xff);
+}
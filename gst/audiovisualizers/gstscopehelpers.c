@@ -0,0 +1,139 @@
+/* GStreamer
+ *
+ * gstscopehelpers.c: FFT plans and frame repetition shared by the scopes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "gstscopehelpers.h"
+
+/* Idle plans and the windows by length. The plans keep scratch buffers and
+ * can only be used by one element at a time, the windows are never changed
+ * after creation */
+G_LOCK_DEFINE_STATIC (fft_pool);
+static GHashTable *fft_plans = NULL;    /* length -> GSList of GstScopeFFT */
+static GHashTable *fft_windows = NULL;  /* length -> gfloat array */
+
+GstScopeFFT *
+gst_scope_fft_acquire (guint len)
+{
+  GstScopeFFT *fft = NULL;
+  GSList *plans;
+  gfloat *window;
+  guint i;
+
+  G_LOCK (fft_pool);
+  if (fft_plans == NULL) {
+    fft_plans = g_hash_table_new (NULL, NULL);
+    fft_windows = g_hash_table_new (NULL, NULL);
+  }
+
+  plans = g_hash_table_lookup (fft_plans, GUINT_TO_POINTER (len));
+  if (plans) {
+    fft = plans->data;
+    g_hash_table_insert (fft_plans, GUINT_TO_POINTER (len),
+        g_slist_delete_link (plans, plans));
+  } else {
+    window = g_hash_table_lookup (fft_windows, GUINT_TO_POINTER (len));
+    if (window == NULL) {
+      /* same as GST_FFT_WINDOW_HAMMING */
+      window = g_new (gfloat, len);
+      for (i = 0; i < len; i++)
+        window[i] = 0.53836 - 0.46164 * cos (2.0 * G_PI * i / len);
+      g_hash_table_insert (fft_windows, GUINT_TO_POINTER (len), window);
+    }
+
+    fft = g_slice_new (GstScopeFFT);
+    fft->fft = gst_fft_f32_new (len, FALSE);
+    fft->len = len;
+    fft->window = window;
+  }
+  G_UNLOCK (fft_pool);
+
+  return fft;
+}
+
+void
+gst_scope_fft_release (GstScopeFFT * fft)
+{
+  GSList *plans;
+
+  G_LOCK (fft_pool);
+  plans = g_hash_table_lookup (fft_plans, GUINT_TO_POINTER (fft->len));
+  g_hash_table_insert (fft_plans, GUINT_TO_POINTER (fft->len),
+      g_slist_prepend (plans, fft));
+  G_UNLOCK (fft_pool);
+}
+
+static gsize
+frame_size (GstVideoFrame * video)
+{
+  return GST_VIDEO_FRAME_PLANE_STRIDE (video, 0) *
+      GST_VIDEO_FRAME_HEIGHT (video);
+}
+
+/* Returns TRUE if the frame was filled with the last rendered frame and
+ * does not need to be rendered */
+gboolean
+gst_scope_repeat_frame (GstScopeRepeat * repeat, GstVideoFrame * video)
+{
+  gboolean render;
+
+  if (repeat->interval <= 1)
+    return FALSE;
+
+  render = (repeat->count % repeat->interval) == 0;
+  repeat->count++;
+  if (render || repeat->last == NULL || repeat->size != frame_size (video))
+    return FALSE;
+
+  memcpy (GST_VIDEO_FRAME_PLANE_DATA (video, 0), repeat->last, repeat->size);
+
+  return TRUE;
+}
+
+/* Keeps a copy of the rendered frame for repeating it */
+void
+gst_scope_repeat_store (GstScopeRepeat * repeat, GstVideoFrame * video)
+{
+  gsize size = frame_size (video);
+
+  if (repeat->interval <= 1)
+    return;
+
+  if (repeat->size != size) {
+    g_free (repeat->last);
+    repeat->last = g_malloc (size);
+    repeat->size = size;
+  }
+  memcpy (repeat->last, GST_VIDEO_FRAME_PLANE_DATA (video, 0), size);
+}
+
+void
+gst_scope_repeat_reset (GstScopeRepeat * repeat)
+{
+  g_free (repeat->last);
+  repeat->last = NULL;
+  repeat->size = 0;
+  repeat->count = 0;
+}
@@ -0,0 +1,63 @@
+/* GStreamer
+ *
+ * gstscopehelpers.h: FFT plans and frame repetition shared by the scopes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_SCOPE_HELPERS_H__
+#define __GST_SCOPE_HELPERS_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/fft/gstfftf32.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstScopeFFT GstScopeFFT;
+typedef struct _GstScopeRepeat GstScopeRepeat;
+
+/* A float FFT plan of a given length. Plans are taken from and returned to
+ * a process-wide pool, so elements that get (re)configured to the same size
+ * don't need to recompute the twiddle factors and window */
+struct _GstScopeFFT
+{
+  GstFFTF32 *fft;               /* only used by one element at a time */
+  guint len;
+  const gfloat *window;         /* Hamming window, shared by all plans */
+};
+
+GstScopeFFT *gst_scope_fft_acquire (guint len);
+void gst_scope_fft_release (GstScopeFFT * fft);
+
+/* Renders only every interval-th frame and repeats the last rendered frame
+ * for the frames in between */
+struct _GstScopeRepeat
+{
+  guint interval;               /* 0 or 1 renders all frames */
+
+  /* < private > */
+  guint count;
+  guint8 *last;
+  gsize size;
+};
+
+gboolean gst_scope_repeat_frame (GstScopeRepeat * repeat, GstVideoFrame * video);
+void gst_scope_repeat_store (GstScopeRepeat * repeat, GstVideoFrame * video);
+void gst_scope_repeat_reset (GstScopeRepeat * repeat);
+
+G_END_DECLS
+#endif /* __GST_SCOPE_HELPERS_H__ */
@@ -70,7 +70,8 @@ GST_DEBUG_CATEGORY_STATIC (space_scope_debug);
 enum
 {
   PROP_0,
-  PROP_STYLE
+  PROP_STYLE,
+  PROP_RENDER_INTERVAL
 };
 
 enum
@@ -106,6 +107,7 @@ static void gst_space_scope_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_space_scope_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
+static void gst_space_scope_finalize (GObject * object);
 
 static void render_dots (GstAudioVisualizer * base, guint32 * vdata,
     gint16 * adata, guint num_samples);
@@ -140,6 +142,7 @@ gst_space_scope_class_init (GstSpaceScopeClass * g_class)
 
   gobject_class->set_property = gst_space_scope_set_property;
   gobject_class->get_property = gst_space_scope_get_property;
+  gobject_class->finalize = gst_space_scope_finalize;
 
   scope_class->render = GST_DEBUG_FUNCPTR (gst_space_scope_render);
 
@@ -148,12 +151,27 @@ gst_space_scope_class_init (GstSpaceScopeClass * g_class)
           "Drawing styles for the space scope display.",
           GST_TYPE_SPACE_SCOPE_STYLE, STYLE_DOTS,
           G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_RENDER_INTERVAL,
+      g_param_spec_uint ("render-interval", "Render interval",
+          "Only render every n-th frame and repeat it for the others",
+          1, G_MAXUINT, 1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
 gst_space_scope_init (GstSpaceScope * scope)
 {
-  /* do nothing */
+  scope->repeat.interval = 1;
+}
+
+static void
+gst_space_scope_finalize (GObject * object)
+{
+  GstSpaceScope *scope = GST_SPACE_SCOPE (object);
+
+  gst_scope_repeat_reset (&scope->repeat);
+
+  G_OBJECT_CLASS (gst_space_scope_parent_class)->finalize (object);
 }
 
 static void
@@ -180,6 +198,9 @@ gst_space_scope_set_property (GObject * object, guint prop_id,
           break;
       }
       break;
+    case PROP_RENDER_INTERVAL:
+      scope->repeat.interval = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -196,6 +217,9 @@ gst_space_scope_get_property (GObject * object, guint prop_id,
     case PROP_STYLE:
       g_value_set_enum (value, scope->style);
       break;
+    case PROP_RENDER_INTERVAL:
+      g_value_set_uint (value, scope->repeat.interval);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -434,6 +458,9 @@ gst_space_scope_render (GstAudioVisualizer * base, GstBuffer * audio,
   GstMapInfo amap;
   guint num_samples;
 
+  if (gst_scope_repeat_frame (&scope->repeat, video))
+    return TRUE;
+
   gst_buffer_map (audio, &amap, GST_MAP_READ);
 
   num_samples =
@@ -441,6 +468,9 @@ gst_space_scope_render (GstAudioVisualizer * base, GstBuffer * audio,
   scope->process (base, (guint32 *) GST_VIDEO_FRAME_PLANE_DATA (video, 0),
       (gint16 *) amap.data, num_samples);
   gst_buffer_unmap (audio, &amap);
+
+  gst_scope_repeat_store (&scope->repeat, video);
+
   return TRUE;
 }
 
@@ -23,6 +23,7 @@
 #define __GST_SPACE_SCOPE_H__
 
 #include "gst/pbutils/gstaudiovisualizer.h"
+#include "gstscopehelpers.h"
 
 G_BEGIN_DECLS
 #define GST_TYPE_SPACE_SCOPE            (gst_space_scope_get_type())
@@ -48,6 +49,8 @@ struct _GstSpaceScope
   gdouble f1r_l, f1r_m, f1r_h;
   gdouble f2l_l, f2l_m, f2l_h;
   gdouble f2r_l, f2r_m, f2r_h;
+
+  GstScopeRepeat repeat;
 };
 
 struct _GstSpaceScopeClass
@@ -39,6 +39,7 @@
 #include <stdlib.h>
 
 #include "gstspectrascope.h"
+#include "gstdrawhelpers.h"
 
 #if G_BYTE_ORDER == G_BIG_ENDIAN
 #define RGB_ORDER "xRGB"
@@ -68,6 +69,16 @@ GST_STATIC_PAD_TEMPLATE ("sink",
 GST_DEBUG_CATEGORY_STATIC (spectra_scope_debug);
 #define GST_CAT_DEFAULT spectra_scope_debug
 
+enum
+{
+  PROP_0,
+  PROP_RENDER_INTERVAL
+};
+
+static void gst_spectra_scope_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_spectra_scope_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 static void gst_spectra_scope_finalize (GObject * object);
 
 static gboolean gst_spectra_scope_setup (GstAudioVisualizer * scope);
@@ -84,6 +95,8 @@ gst_spectra_scope_class_init (GstSpectraScopeClass * g_class)
   GstElementClass *element_class = (GstElementClass *) g_class;
   GstAudioVisualizerClass *scope_class = (GstAudioVisualizerClass *) g_class;
 
+  gobject_class->set_property = gst_spectra_scope_set_property;
+  gobject_class->get_property = gst_spectra_scope_get_property;
   gobject_class->finalize = gst_spectra_scope_finalize;
 
   gst_element_class_set_static_metadata (element_class,
@@ -97,27 +110,67 @@ gst_spectra_scope_class_init (GstSpectraScopeClass * g_class)
 
   scope_class->setup = GST_DEBUG_FUNCPTR (gst_spectra_scope_setup);
   scope_class->render = GST_DEBUG_FUNCPTR (gst_spectra_scope_render);
+
+  g_object_class_install_property (gobject_class, PROP_RENDER_INTERVAL,
+      g_param_spec_uint ("render-interval", "Render interval",
+          "Only render every n-th frame and repeat it for the others",
+          1, G_MAXUINT, 1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
 gst_spectra_scope_init (GstSpectraScope * scope)
 {
-  /* do nothing */
+  scope->repeat.interval = 1;
 }
 
 static void
-gst_spectra_scope_finalize (GObject * object)
+gst_spectra_scope_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
 {
   GstSpectraScope *scope = GST_SPECTRA_SCOPE (object);
 
-  if (scope->fft_ctx) {
-    gst_fft_s16_free (scope->fft_ctx);
-    scope->fft_ctx = NULL;
+  switch (prop_id) {
+    case PROP_RENDER_INTERVAL:
+      scope->repeat.interval = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
   }
-  if (scope->freq_data) {
-    g_free (scope->freq_data);
-    scope->freq_data = NULL;
+}
+
+static void
+gst_spectra_scope_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstSpectraScope *scope = GST_SPECTRA_SCOPE (object);
+
+  switch (prop_id) {
+    case PROP_RENDER_INTERVAL:
+      g_value_set_uint (value, scope->repeat.interval);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
   }
+}
+
+static void
+gst_spectra_scope_finalize (GObject * object)
+{
+  GstSpectraScope *scope = GST_SPECTRA_SCOPE (object);
+
+  if (scope->fft) {
+    gst_scope_fft_release (scope->fft);
+    scope->fft = NULL;
+  }
+  g_free (scope->mono_data);
+  scope->mono_data = NULL;
+  g_free (scope->freq_data);
+  scope->freq_data = NULL;
+  g_free (scope->tops);
+  scope->tops = NULL;
+  gst_scope_repeat_reset (&scope->repeat);
 
   G_OBJECT_CLASS (gst_spectra_scope_parent_class)->finalize (object);
 }
@@ -128,104 +181,101 @@ gst_spectra_scope_setup (GstAudioVisualizer * bscope)
   GstSpectraScope *scope = GST_SPECTRA_SCOPE (bscope);
   guint num_freq = GST_VIDEO_INFO_WIDTH (&bscope->vinfo) + 1;
 
-  if (scope->fft_ctx)
-    gst_fft_s16_free (scope->fft_ctx);
+  if (scope->fft)
+    gst_scope_fft_release (scope->fft);
+  g_free (scope->mono_data);
   g_free (scope->freq_data);
+  g_free (scope->tops);
+  gst_scope_repeat_reset (&scope->repeat);
 
   /* we'd need this amount of samples per render() call */
   bscope->req_spf = num_freq * 2 - 2;
-  scope->fft_ctx = gst_fft_s16_new (bscope->req_spf, FALSE);
-  scope->freq_data = g_new (GstFFTS16Complex, num_freq);
+  scope->fft = gst_scope_fft_acquire (bscope->req_spf);
+  scope->mono_data = g_new (gfloat, bscope->req_spf);
+  scope->freq_data = g_new (GstFFTF32Complex, num_freq);
+  scope->tops = g_new (guint, GST_VIDEO_INFO_WIDTH (&bscope->vinfo));
 
   return TRUE;
 }
 
-static inline void
-add_pixel (guint32 * _p, guint32 _c)
-{
-  guint8 *p = (guint8 *) _p;
-  guint8 *c = (guint8 *) & _c;
-
-  if (p[0] < 255 - c[0])
-    p[0] += c[0];
-  else
-    p[0] = 255;
-  if (p[1] < 255 - c[1])
-    p[1] += c[1];
-  else
-    p[1] = 255;
-  if (p[2] < 255 - c[2])
-    p[2] += c[2];
-  else
-    p[2] = 255;
-  if (p[3] < 255 - c[3])
-    p[3] += c[3];
-  else
-    p[3] = 255;
-}
-
 static gboolean
 gst_spectra_scope_render (GstAudioVisualizer * bscope, GstBuffer * audio,
     GstVideoFrame * video)
 {
   GstSpectraScope *scope = GST_SPECTRA_SCOPE (bscope);
-  gint16 *mono_adata;
-  GstFFTS16Complex *fdata = scope->freq_data;
-  guint x, y, off, l;
+  gfloat *mono_adata = scope->mono_data;
+  GstFFTF32Complex *fdata = scope->freq_data;
+  const gfloat *window = scope->fft->window;
+  guint *tops = scope->tops;
+  guint x, y, top;
   guint w = GST_VIDEO_INFO_WIDTH (&bscope->vinfo);
   guint h = GST_VIDEO_INFO_HEIGHT (&bscope->vinfo) - 1;
-  gfloat fr, fi;
+  guint n = bscope->req_spf;
+  gfloat fr, fi, scale;
   GstMapInfo amap;
-  guint32 *vdata;
-  gint channels;
+  guint32 *vdata, *row;
+  gint16 *adata;
+  guint ch, num_samples, i, c, s;
+
+  if (gst_scope_repeat_frame (&scope->repeat, video))
+    return TRUE;
 
   gst_buffer_map (audio, &amap, GST_MAP_READ);
   vdata = (guint32 *) GST_VIDEO_FRAME_PLANE_DATA (video, 0);
+  adata = (gint16 *) amap.data;
 
-  channels = GST_AUDIO_INFO_CHANNELS (&bscope->ainfo);
+  ch = GST_AUDIO_INFO_CHANNELS (&bscope->ainfo);
+  num_samples = MIN (amap.size / (ch * sizeof (gint16)), n);
 
-  mono_adata = (gint16 *) g_memdup (amap.data, amap.size);
+  /* mixdown and window in one go */
+  for (i = 0, s = 0; i < num_samples; i++) {
+    gint v = 0;
 
-  if (channels > 1) {
-    guint ch = channels;
-    guint num_samples = amap.size / (ch * sizeof (gint16));
-    guint i, c, v, s = 0;
-
-    /* deinterleave and mixdown adata */
-    for (i = 0; i < num_samples; i++) {
-      v = 0;
-      for (c = 0; c < ch; c++) {
-        v += mono_adata[s++];
-      }
-      mono_adata[i] = v / ch;
-    }
+    for (c = 0; c < ch; c++)
+      v += adata[s++];
+    mono_adata[i] = (gfloat) (v / (gint) ch) * window[i];
   }
+  for (; i < n; i++)
+    mono_adata[i] = 0.0;
+  gst_buffer_unmap (audio, &amap);
 
   /* run fft */
-  gst_fft_s16_window (scope->fft_ctx, mono_adata, GST_FFT_WINDOW_HAMMING);
-  gst_fft_s16_fft (scope->fft_ctx, mono_adata, fdata);
-  g_free (mono_adata);
-
-  /* draw lines */
+  gst_fft_f32_fft (scope->fft->fft, mono_adata, fdata);
+
+  /* figure out the height of all bars first, the float fft is not scaled
+   * down by the fft length like the integer one was.
+   * figure out the range so that we don't need to clip,
+   * or even better do a log mapping? */
+  scale = 1.0 / (512.0 * n);
+  top = h;
   for (x = 0; x < w; x++) {
-    /* figure out the range so that we don't need to clip,
-     * or even better do a log mapping? */
-    fr = (gfloat) fdata[1 + x].r / 512.0;
-    fi = (gfloat) fdata[1 + x].i / 512.0;
+    fr = fdata[1 + x].r * scale;
+    fi = fdata[1 + x].i * scale;
     y = (guint) (h * sqrt (fr * fr + fi * fi));
     if (y > h)
       y = h;
-    y = h - y;
-    off = (y * w) + x;
-    vdata[off] = 0x00FFFFFF;
-    for (l = y; l < h; l++) {
-      off += w;
-      add_pixel (&vdata[off], 0x007F7F7F);
+    tops[x] = h - y;
+    top = MIN (top, tops[x]);
+  }
+
+  /* draw the bars row by row, so that the inner loop runs over consecutive
+   * pixels and can be vectorised */
+  for (y = top; y <= h; y++) {
+    row = vdata + y * w;
+    for (x = 0; x < w; x++) {
+      if (tops[x] < y)
+        add_pixel (&row[x], 0x007F7F7F);
+      else if (tops[x] == y)
+        row[x] = 0x00FFFFFF;
     }
-    /* ensure bottom line is full bright (especially in move-up mode) */
-    add_pixel (&vdata[off], 0x007F7F7F);
   }
-  gst_buffer_unmap (audio, &amap);
+  /* ensure bottom line is full bright (especially in move-up mode) */
+  row = vdata + h * w;
+  for (x = 0; x < w; x++)
+    add_pixel (&row[x], 0x007F7F7F);
+
+  gst_scope_repeat_store (&scope->repeat, video);
+
   return TRUE;
 }
 
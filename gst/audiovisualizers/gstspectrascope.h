@@ -23,7 +23,7 @@
 #define __GST_SPECTRA_SCOPE_H__
 
 #include "gst/pbutils/gstaudiovisualizer.h"
-#include <gst/fft/gstffts16.h>
+#include "gstscopehelpers.h"
 
 G_BEGIN_DECLS
 #define GST_TYPE_SPECTRA_SCOPE            (gst_spectra_scope_get_type())
@@ -38,8 +38,12 @@ struct _GstSpectraScope
 {
   GstAudioVisualizer parent;
 
-  GstFFTS16 *fft_ctx;
-  GstFFTS16Complex *freq_data;
+  GstScopeFFT *fft;
+  gfloat *mono_data;
+  GstFFTF32Complex *freq_data;
+  guint *tops;
+
+  GstScopeRepeat repeat;
 };
 
 struct _GstSpectraScopeClass
@@ -70,7 +70,8 @@ GST_DEBUG_CATEGORY_STATIC (wave_scope_debug);
 enum
 {
   PROP_0,
-  PROP_STYLE
+  PROP_STYLE,
+  PROP_RENDER_INTERVAL
 };
 
 enum
@@ -144,6 +145,11 @@ gst_wave_scope_class_init (GstWaveScopeClass * g_class)
           GST_TYPE_WAVE_SCOPE_STYLE, STYLE_DOTS,
           G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_RENDER_INTERVAL,
+      g_param_spec_uint ("render-interval", "Render interval",
+          "Only render every n-th frame and repeat it for the others",
+          1, G_MAXUINT, 1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (gstelement_class,
       "Waveform oscilloscope", "Visualization", "Simple waveform oscilloscope",
       "Stefan Kost <ensonic@users.sf.net>");
@@ -157,7 +163,7 @@ gst_wave_scope_class_init (GstWaveScopeClass * g_class)
 static void
 gst_wave_scope_init (GstWaveScope * scope)
 {
-  /* do nothing */
+  scope->repeat.interval = 1;
 }
 
 static void
@@ -169,6 +175,7 @@ gst_wave_scope_finalize (GObject * object)
     g_free (scope->flt);
     scope->flt = NULL;
   }
+  gst_scope_repeat_reset (&scope->repeat);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -179,6 +186,7 @@ gst_wave_scope_setup (GstAudioVisualizer * bscope)
   GstWaveScope *scope = GST_WAVE_SCOPE (bscope);
 
   g_free (scope->flt);
+  gst_scope_repeat_reset (&scope->repeat);
 
   scope->flt = g_new0 (gdouble, 6 * GST_AUDIO_INFO_CHANNELS (&bscope->ainfo));
 
@@ -209,6 +217,9 @@ gst_wave_scope_set_property (GObject * object, guint prop_id,
           break;
       }
       break;
+    case PROP_RENDER_INTERVAL:
+      scope->repeat.interval = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -225,6 +236,9 @@ gst_wave_scope_get_property (GObject * object, guint prop_id,
     case PROP_STYLE:
       g_value_set_enum (value, scope->style);
       break;
+    case PROP_RENDER_INTERVAL:
+      g_value_set_uint (value, scope->repeat.interval);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -410,6 +424,9 @@ gst_wave_scope_render (GstAudioVisualizer * base, GstBuffer * audio,
   guint num_samples;
   gint channels = GST_AUDIO_INFO_CHANNELS (&base->ainfo);
 
+  if (gst_scope_repeat_frame (&scope->repeat, video))
+    return TRUE;
+
   gst_buffer_map (audio, &amap, GST_MAP_READ);
 
   num_samples = amap.size / (channels * sizeof (gint16));
@@ -418,6 +435,8 @@ gst_wave_scope_render (GstAudioVisualizer * base, GstBuffer * audio,
 
   gst_buffer_unmap (audio, &amap);
 
+  gst_scope_repeat_store (&scope->repeat, video);
+
   return TRUE;
 }
 
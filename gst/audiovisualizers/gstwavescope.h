@@ -23,6 +23,7 @@
 #define __GST_WAVE_SCOPE_H__
 
 #include "gst/pbutils/gstaudiovisualizer.h"
+#include "gstscopehelpers.h"
 
 G_BEGIN_DECLS
 #define GST_TYPE_WAVE_SCOPE            (gst_wave_scope_get_type())
@@ -45,6 +46,8 @@ struct _GstWaveScope
 
   /* filter specific data */
   gdouble *flt;
+
+  GstScopeRepeat repeat;
 };
 
 struct _GstWaveScopeClass
@@ -26,6 +26,15 @@
  * @title: bayer2rgb
  *
  * Decodes raw camera bayer (fourcc BA81) to RGB.
+ *
+ * Besides 8-bit bayer, 10, 12, 14 and 16-bit bayer stored in 16-bit
+ * little or big endian words (e.g. "bggr12le") is accepted. The output is
+ * always 8 bits per component.
+ *
+ * The #GstBayer2RGB:method property selects between the default fast linear
+ * interpolation and the slower, higher quality Malvar-He-Cutler
+ * interpolation. Frames are split into stripes of rows that are converted in
+ * parallel, see #GstBayer2RGB:max-threads.
  */
 
 /*
@@ -70,6 +79,20 @@
  *   B   A blue element
  *   GR  A green element which is followed by a red one
  *   GB  A green element which is followed by a blue one
+ *
+ * The "malvar" method instead uses the gradient-corrected linear
+ * interpolation from
+ * H. S. Malvar, L. He and R. Cutler,
+ * "High-quality linear interpolation for demosaicing of Bayer-patterned
+ *  color images,"
+ * Proc. IEEE ICASSP, vol. 3, pp. 485-488, May 2004.
+ * Each missing component is interpolated from its neighbours of the same
+ * colour and corrected by the laplacian of the known component, using 5x5
+ * kernels.  Rows and columns outside of the frame are mirrored into it,
+ * which keeps the bayer pattern intact at the borders.
+ *
+ * Both methods only need the few source rows around each output row, so the
+ * frame is cut into horizontal stripes that are converted independently.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -109,7 +132,35 @@ enum
 typedef struct _GstBayer2RGB GstBayer2RGB;
 typedef struct _GstBayer2RGBClass GstBayer2RGBClass;
 
-typedef void (*GstBayer2RGBProcessFunc) (GstBayer2RGB *, guint8 *, guint);
+typedef struct _GstBayer2RGBStripe GstBayer2RGBStripe;
+
+typedef enum
+{
+  GST_BAYER_2_RGB_METHOD_LINEAR,
+  GST_BAYER_2_RGB_METHOD_MALVAR
+} GstBayer2RGBMethod;
+
+typedef void (*process_func) (guint8 * d0, const guint8 * s0, const guint8 * s1,
+    const guint8 * s2, const guint8 * s3, const guint8 * s4, const guint8 * s5,
+    int n);
+
+typedef void (*GstBayer2RGBStripeFunc) (GstBayer2RGB *, GstBayer2RGBStripe *);
+
+/* A stripe of output rows [first, last) converted by one thread, with the
+ * line buffers of that thread */
+struct _GstBayer2RGBStripe
+{
+  GstBayer2RGBStripeFunc func;
+  guint8 *dest;
+  int dest_stride;
+  const guint8 *src;
+  int src_stride;
+  int first;
+  int last;
+
+  guint8 *tmp;
+  gsize tmp_size;
+};
 
 struct _GstBayer2RGB
 {
@@ -123,6 +174,20 @@ struct _GstBayer2RGB
   int g_off;                    /* offset for green */
   int b_off;                    /* offset for blue */
   int format;
+  int depth;                    /* bits per bayer sample */
+  gboolean big_endian;          /* byte order of samples deeper than 8 bits */
+  process_func merge[2];
+
+  GstBayer2RGBMethod method;
+  int max_threads;
+
+  /* thread pool converting all but the first stripe of each frame */
+  guint n_threads;
+  GstBayer2RGBStripe *stripes;
+  GThreadPool *stripe_pool;
+  GMutex stripe_lock;
+  GCond stripe_cond;
+  guint stripes_pending;
 };
 
 struct _GstBayer2RGBClass
@@ -133,14 +198,50 @@ struct _GstBayer2RGBClass
 #define	SRC_CAPS                                 \
   GST_VIDEO_CAPS_MAKE ("{ RGBx, xRGB, BGRx, xBGR, RGBA, ARGB, BGRA, ABGR }")
 
-#define SINK_CAPS "video/x-bayer,format=(string){bggr,grbg,gbrg,rggb}," \
+#define DEEP_FORMATS(p) \
+  p "10le," p "10be," p "12le," p "12be," p "14le," p "14be," p "16le," p "16be"
+
+#define SINK_CAPS "video/x-bayer,format=(string){bggr,grbg,gbrg,rggb," \
+  DEEP_FORMATS ("bggr") "," DEEP_FORMATS ("grbg") ","                  \
+  DEEP_FORMATS ("gbrg") "," DEEP_FORMATS ("rggb") "},"                 \
   "width=(int)[1,MAX],height=(int)[1,MAX],framerate=(fraction)[0/1,MAX]"
 
+/* Stripes are not made shorter than this, the rows around each stripe are
+ * read twice */
+#define MIN_STRIPE_HEIGHT 16
+
+#define DEFAULT_METHOD GST_BAYER_2_RGB_METHOD_LINEAR
+#define DEFAULT_MAX_THREADS 0
+
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_METHOD,
+  PROP_MAX_THREADS
 };
 
+#define GST_TYPE_BAYER_2_RGB_METHOD (gst_bayer2rgb_method_get_type())
+static GType
+gst_bayer2rgb_method_get_type (void)
+{
+  static GType bayer2rgb_method_type = 0;
+
+  if (!bayer2rgb_method_type) {
+    static const GEnumValue bayer2rgb_methods[] = {
+      {GST_BAYER_2_RGB_METHOD_LINEAR, "Linear interpolation", "linear"},
+      {GST_BAYER_2_RGB_METHOD_MALVAR,
+          "Malvar-He-Cutler gradient-corrected linear interpolation",
+          "malvar"},
+      {0, NULL, NULL},
+    };
+
+    bayer2rgb_method_type =
+        g_enum_register_static ("GstBayer2RGBMethod", bayer2rgb_methods);
+  }
+
+  return bayer2rgb_method_type;
+}
+
 GType gst_bayer2rgb_get_type (void);
 
 #define gst_bayer2rgb_parent_class parent_class
@@ -150,6 +251,10 @@ static void gst_bayer2rgb_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_bayer2rgb_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
+static void gst_bayer2rgb_finalize (GObject * object);
+
+static gboolean gst_bayer2rgb_start (GstBaseTransform * base);
+static gboolean gst_bayer2rgb_stop (GstBaseTransform * base);
 
 static gboolean gst_bayer2rgb_set_caps (GstBaseTransform * filter,
     GstCaps * incaps, GstCaps * outcaps);
@@ -160,6 +265,7 @@ static GstCaps *gst_bayer2rgb_transform_caps (GstBaseTransform * base,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter);
 static gboolean gst_bayer2rgb_get_unit_size (GstBaseTransform * base,
     GstCaps * caps, gsize * size);
+static void gst_bayer2rgb_stripe_thread (gpointer data, gpointer user_data);
 
 
 static void
@@ -173,6 +279,18 @@ gst_bayer2rgb_class_init (GstBayer2RGBClass * klass)
 
   gobject_class->set_property = gst_bayer2rgb_set_property;
   gobject_class->get_property = gst_bayer2rgb_get_property;
+  gobject_class->finalize = gst_bayer2rgb_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_METHOD,
+      g_param_spec_enum ("method", "Method", "Demosaicing method",
+          GST_TYPE_BAYER_2_RGB_METHOD, DEFAULT_METHOD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_int ("max-threads", "Maximum threads",
+          "Maximum number of threads each frame is converted in "
+          "(0 = number of processors, 1 = convert in the streaming thread)",
+          0, G_MAXINT, DEFAULT_MAX_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (gstelement_class,
       "Bayer to RGB decoder for cameras", "Filter/Converter/Video",
@@ -194,6 +312,10 @@ gst_bayer2rgb_class_init (GstBayer2RGBClass * klass)
       GST_DEBUG_FUNCPTR (gst_bayer2rgb_set_caps);
   GST_BASE_TRANSFORM_CLASS (klass)->transform =
       GST_DEBUG_FUNCPTR (gst_bayer2rgb_transform);
+  GST_BASE_TRANSFORM_CLASS (klass)->start =
+      GST_DEBUG_FUNCPTR (gst_bayer2rgb_start);
+  GST_BASE_TRANSFORM_CLASS (klass)->stop =
+      GST_DEBUG_FUNCPTR (gst_bayer2rgb_stop);
 
   GST_DEBUG_CATEGORY_INIT (gst_bayer2rgb_debug, "bayer2rgb", 0,
       "bayer2rgb element");
@@ -204,15 +326,37 @@ gst_bayer2rgb_init (GstBayer2RGB * filter)
 {
   gst_bayer2rgb_reset (filter);
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
+
+  filter->method = DEFAULT_METHOD;
+  filter->max_threads = DEFAULT_MAX_THREADS;
+  g_mutex_init (&filter->stripe_lock);
+  g_cond_init (&filter->stripe_cond);
+}
+
+static void
+gst_bayer2rgb_finalize (GObject * object)
+{
+  GstBayer2RGB *filter = GST_BAYER2RGB (object);
+
+  g_mutex_clear (&filter->stripe_lock);
+  g_cond_clear (&filter->stripe_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
-/* No properties are implemented, so only a warning is produced */
 static void
 gst_bayer2rgb_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
+  GstBayer2RGB *filter = GST_BAYER2RGB (object);
 
   switch (prop_id) {
+    case PROP_METHOD:
+      filter->method = g_value_get_enum (value);
+      break;
+    case PROP_MAX_THREADS:
+      filter->max_threads = g_value_get_int (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -223,14 +367,89 @@ static void
 gst_bayer2rgb_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  GstBayer2RGB *filter = GST_BAYER2RGB (object);
 
   switch (prop_id) {
+    case PROP_METHOD:
+      g_value_set_enum (value, filter->method);
+      break;
+    case PROP_MAX_THREADS:
+      g_value_set_int (value, filter->max_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+/* Parses bayer formats like "bggr" or "grbg12le" */
+static gboolean
+gst_bayer2rgb_parse_format (const char *format, int *pattern, int *depth,
+    gboolean * big_endian)
+{
+  static const char *patterns[] = { "bggr", "gbrg", "grbg", "rggb" };
+  const char *suffix;
+  guint i;
+
+  if (format == NULL || strlen (format) < 4)
+    return FALSE;
+
+  for (i = 0; i < G_N_ELEMENTS (patterns); i++) {
+    if (strncmp (format, patterns[i], 4) == 0)
+      break;
+  }
+  if (i == G_N_ELEMENTS (patterns))
+    return FALSE;
+  *pattern = GST_BAYER_2_RGB_FORMAT_BGGR + i;
+
+  suffix = format + 4;
+  if (*suffix == '\0') {
+    *depth = 8;
+    *big_endian = FALSE;
+    return TRUE;
+  }
+
+  /* 10 to 16 bits per sample, stored in 16-bit words */
+  if (!g_ascii_isdigit (suffix[0]) || !g_ascii_isdigit (suffix[1]))
+    return FALSE;
+  *depth = (suffix[0] - '0') * 10 + (suffix[1] - '0');
+  if (*depth < 10 || *depth > 16)
+    return FALSE;
+
+  if (strcmp (suffix + 2, "le") == 0)
+    *big_endian = FALSE;
+  else if (strcmp (suffix + 2, "be") == 0)
+    *big_endian = TRUE;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+#define BYTES_PER_SAMPLE(depth) ((depth) > 8 ? 2 : 1)
+
+/* We exploit some symmetry in the functions here.  The base functions
+ * are all named for the BGGR arrangement.  For RGGB, we swap the
+ * red offset and blue offset in the output.  For GRBG, we swap the
+ * order of the rows.  For GBRG, do both. */
+static void
+gst_bayer2rgb_get_bggr_offsets (GstBayer2RGB * bayer2rgb, int *r_off,
+    int *b_off)
+{
+  if (bayer2rgb->format == GST_BAYER_2_RGB_FORMAT_RGGB ||
+      bayer2rgb->format == GST_BAYER_2_RGB_FORMAT_GBRG) {
+    *r_off = bayer2rgb->b_off;
+    *b_off = bayer2rgb->r_off;
+  } else {
+    *r_off = bayer2rgb->r_off;
+    *b_off = bayer2rgb->b_off;
+  }
+}
+
+#define SWAPPED_ROWS(bayer2rgb)                               \
+  ((bayer2rgb)->format == GST_BAYER_2_RGB_FORMAT_GRBG ||      \
+   (bayer2rgb)->format == GST_BAYER_2_RGB_FORMAT_GBRG)
+
 static gboolean
 gst_bayer2rgb_set_caps (GstBaseTransform * base, GstCaps * incaps,
     GstCaps * outcaps)
@@ -239,6 +458,7 @@ gst_bayer2rgb_set_caps (GstBaseTransform * base, GstCaps * incaps,
   GstStructure *structure;
   const char *format;
   GstVideoInfo info;
+  int r_off, g_off, b_off;
 
   GST_DEBUG ("in caps %" GST_PTR_FORMAT " out caps %" GST_PTR_FORMAT, incaps,
       outcaps);
@@ -249,17 +469,9 @@ gst_bayer2rgb_set_caps (GstBaseTransform * base, GstCaps * incaps,
   gst_structure_get_int (structure, "height", &bayer2rgb->height);
 
   format = gst_structure_get_string (structure, "format");
-  if (g_str_equal (format, "bggr")) {
-    bayer2rgb->format = GST_BAYER_2_RGB_FORMAT_BGGR;
-  } else if (g_str_equal (format, "gbrg")) {
-    bayer2rgb->format = GST_BAYER_2_RGB_FORMAT_GBRG;
-  } else if (g_str_equal (format, "grbg")) {
-    bayer2rgb->format = GST_BAYER_2_RGB_FORMAT_GRBG;
-  } else if (g_str_equal (format, "rggb")) {
-    bayer2rgb->format = GST_BAYER_2_RGB_FORMAT_RGGB;
-  } else {
+  if (!gst_bayer2rgb_parse_format (format, &bayer2rgb->format,
+          &bayer2rgb->depth, &bayer2rgb->big_endian))
     return FALSE;
-  }
 
   /* To cater for different RGB formats, we need to set params for later */
   gst_video_info_from_caps (&info, outcaps);
@@ -269,6 +481,29 @@ gst_bayer2rgb_set_caps (GstBaseTransform * base, GstCaps * incaps,
 
   bayer2rgb->info = info;
 
+  gst_bayer2rgb_get_bggr_offsets (bayer2rgb, &r_off, &b_off);
+  g_off = bayer2rgb->g_off;
+  if (r_off == 2 && g_off == 1 && b_off == 0) {
+    bayer2rgb->merge[0] = bayer_orc_merge_bg_bgra;
+    bayer2rgb->merge[1] = bayer_orc_merge_gr_bgra;
+  } else if (r_off == 3 && g_off == 2 && b_off == 1) {
+    bayer2rgb->merge[0] = bayer_orc_merge_bg_abgr;
+    bayer2rgb->merge[1] = bayer_orc_merge_gr_abgr;
+  } else if (r_off == 1 && g_off == 2 && b_off == 3) {
+    bayer2rgb->merge[0] = bayer_orc_merge_bg_argb;
+    bayer2rgb->merge[1] = bayer_orc_merge_gr_argb;
+  } else if (r_off == 0 && g_off == 1 && b_off == 2) {
+    bayer2rgb->merge[0] = bayer_orc_merge_bg_rgba;
+    bayer2rgb->merge[1] = bayer_orc_merge_gr_rgba;
+  } else {
+    return FALSE;
+  }
+  if (SWAPPED_ROWS (bayer2rgb)) {
+    process_func tmp = bayer2rgb->merge[0];
+    bayer2rgb->merge[0] = bayer2rgb->merge[1];
+    bayer2rgb->merge[1] = tmp;
+  }
+
   return TRUE;
 }
 
@@ -280,9 +515,61 @@ gst_bayer2rgb_reset (GstBayer2RGB * filter)
   filter->r_off = 0;
   filter->g_off = 0;
   filter->b_off = 0;
+  filter->depth = 8;
+  filter->big_endian = FALSE;
+  filter->merge[0] = NULL;
+  filter->merge[1] = NULL;
   gst_video_info_init (&filter->info);
 }
 
+static gboolean
+gst_bayer2rgb_start (GstBaseTransform * base)
+{
+  GstBayer2RGB *filter = GST_BAYER2RGB (base);
+
+  filter->n_threads = filter->max_threads;
+  if (filter->n_threads == 0)
+    filter->n_threads = g_get_num_processors ();
+
+  /* the streaming thread converts one stripe itself */
+  if (filter->n_threads > 1) {
+    GError *err = NULL;
+
+    filter->stripe_pool = g_thread_pool_new (gst_bayer2rgb_stripe_thread,
+        filter, filter->n_threads - 1, FALSE, &err);
+    if (!filter->stripe_pool) {
+      GST_WARNING_OBJECT (filter, "Failed to create thread pool: %s",
+          err->message);
+      g_clear_error (&err);
+      filter->n_threads = 1;
+    }
+  }
+  filter->stripes = g_new0 (GstBayer2RGBStripe, filter->n_threads);
+
+  GST_DEBUG_OBJECT (filter, "Converting in %u threads", filter->n_threads);
+
+  return TRUE;
+}
+
+static gboolean
+gst_bayer2rgb_stop (GstBaseTransform * base)
+{
+  GstBayer2RGB *filter = GST_BAYER2RGB (base);
+  guint i;
+
+  if (filter->stripe_pool) {
+    g_thread_pool_free (filter->stripe_pool, FALSE, TRUE);
+    filter->stripe_pool = NULL;
+  }
+
+  for (i = 0; i < filter->n_threads && filter->stripes; i++)
+    g_free (filter->stripes[i].tmp);
+  g_free (filter->stripes);
+  filter->stripes = NULL;
+  filter->n_threads = 0;
+
+  return TRUE;
+}
 static GstCaps *
 gst_bayer2rgb_transform_caps (GstBaseTransform * base,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter)
@@ -326,6 +613,9 @@ gst_bayer2rgb_get_unit_size (GstBaseTransform * base, GstCaps * caps,
   int width;
   int height;
   const char *name;
+  const char *format;
+  int pattern, depth;
+  gboolean big_endian;
 
   structure = gst_caps_get_structure (caps, 0);
 
@@ -334,7 +624,10 @@ gst_bayer2rgb_get_unit_size (GstBaseTransform * base, GstCaps * caps,
     name = gst_structure_get_name (structure);
     /* Our name must be either video/x-bayer video/x-raw */
     if (strcmp (name, "video/x-raw")) {
-      *size = GST_ROUND_UP_4 (width) * height;
+      format = gst_structure_get_string (structure, "format");
+      if (!gst_bayer2rgb_parse_format (format, &pattern, &depth, &big_endian))
+        depth = 8;
+      *size = GST_ROUND_UP_4 (width * BYTES_PER_SAMPLE (depth)) * height;
       return TRUE;
     } else {
       /* For output, calculate according to format (always 32 bits) */
@@ -377,78 +670,332 @@ gst_bayer2rgb_split_and_upsample_horiz (guint8 * dest0, guint8 * dest1,
   }
 }
 
-typedef void (*process_func) (guint8 * d0, const guint8 * s0, const guint8 * s1,
-    const guint8 * s2, const guint8 * s3, const guint8 * s4, const guint8 * s5,
-    int n);
+/* Mirrors a row or column index outside of [0, n) back into it.  This keeps
+ * the parity of the index and thus the colour of the bayer sample. */
+static inline int
+gst_bayer2rgb_mirror (int i, int n)
+{
+  if (i < 0)
+    i = -i;
+  else if (i >= n)
+    i = 2 * n - 2 - i;
+
+  return CLAMP (i, 0, n - 1);
+}
+
+static inline const guint8 *
+gst_bayer2rgb_src_line (GstBayer2RGB * bayer2rgb,
+    GstBayer2RGBStripe * stripe, int j)
+{
+  return stripe->src + gst_bayer2rgb_mirror (j,
+      bayer2rgb->height) * stripe->src_stride;
+}
 
+/* Reduces a line of samples deeper than 8 bits to 8 bits */
 static void
-gst_bayer2rgb_process (GstBayer2RGB * bayer2rgb, uint8_t * dest,
-    int dest_stride, uint8_t * src, int src_stride)
+gst_bayer2rgb_line_to_8 (guint8 * dest, const guint8 * src, int n,
+    int shift, gboolean big_endian)
 {
-  int j;
-  guint8 *tmp;
-  process_func merge[2] = { NULL, NULL };
-  int r_off, g_off, b_off;
+  int i, v;
 
-  /* We exploit some symmetry in the functions here.  The base functions
-   * are all named for the BGGR arrangement.  For RGGB, we swap the
-   * red offset and blue offset in the output.  For GRBG, we swap the
-   * order of the merge functions.  For GBRG, do both. */
-  r_off = bayer2rgb->r_off;
-  g_off = bayer2rgb->g_off;
-  b_off = bayer2rgb->b_off;
-  if (bayer2rgb->format == GST_BAYER_2_RGB_FORMAT_RGGB ||
-      bayer2rgb->format == GST_BAYER_2_RGB_FORMAT_GBRG) {
-    r_off = bayer2rgb->b_off;
-    b_off = bayer2rgb->r_off;
+  if (big_endian) {
+    for (i = 0; i < n; i++) {
+      v = GST_READ_UINT16_BE (src + 2 * i) >> shift;
+      dest[i] = MIN (v, 255);
+    }
+  } else {
+    for (i = 0; i < n; i++) {
+      v = GST_READ_UINT16_LE (src + 2 * i) >> shift;
+      dest[i] = MIN (v, 255);
+    }
   }
+}
 
-  if (r_off == 2 && g_off == 1 && b_off == 0) {
-    merge[0] = bayer_orc_merge_bg_bgra;
-    merge[1] = bayer_orc_merge_gr_bgra;
-  } else if (r_off == 3 && g_off == 2 && b_off == 1) {
-    merge[0] = bayer_orc_merge_bg_abgr;
-    merge[1] = bayer_orc_merge_gr_abgr;
-  } else if (r_off == 1 && g_off == 2 && b_off == 3) {
-    merge[0] = bayer_orc_merge_bg_argb;
-    merge[1] = bayer_orc_merge_gr_argb;
-  } else if (r_off == 0 && g_off == 1 && b_off == 2) {
-    merge[0] = bayer_orc_merge_bg_rgba;
-    merge[1] = bayer_orc_merge_gr_rgba;
-  }
-  if (bayer2rgb->format == GST_BAYER_2_RGB_FORMAT_GRBG ||
-      bayer2rgb->format == GST_BAYER_2_RGB_FORMAT_GBRG) {
-    process_func tmp = merge[0];
-    merge[0] = merge[1];
-    merge[1] = tmp;
+static void
+gst_bayer2rgb_split_line (GstBayer2RGB * bayer2rgb,
+    GstBayer2RGBStripe * stripe, guint8 * dest0, guint8 * dest1, int j)
+{
+  const guint8 *src = gst_bayer2rgb_src_line (bayer2rgb, stripe, j);
+
+  if (bayer2rgb->depth > 8) {
+    guint8 *line = stripe->tmp + 8 * bayer2rgb->width;
+
+    gst_bayer2rgb_line_to_8 (line, src, bayer2rgb->width,
+        bayer2rgb->depth - 8, bayer2rgb->big_endian);
+    src = line;
   }
 
-  tmp = g_malloc (2 * 4 * bayer2rgb->width);
+  gst_bayer2rgb_split_and_upsample_horiz (dest0, dest1, src, bayer2rgb->width);
+}
+
+/* Line buffers: 8 split lines and one line reduced to 8 bits */
+#define LINEAR_TMP_SIZE(width) (9 * (width))
+
+static void
+gst_bayer2rgb_process_linear (GstBayer2RGB * bayer2rgb,
+    GstBayer2RGBStripe * stripe)
+{
+  int j;
+  guint8 *tmp = stripe->tmp;
+
 #define LINE(x) (tmp + ((x)&7) * bayer2rgb->width)
 
-  gst_bayer2rgb_split_and_upsample_horiz (LINE (3 * 2 + 0), LINE (3 * 2 + 1),
-      src + 1 * src_stride, bayer2rgb->width);
-  j = 0;
-  gst_bayer2rgb_split_and_upsample_horiz (LINE (j * 2 + 0), LINE (j * 2 + 1),
-      src + j * src_stride, bayer2rgb->width);
+  j = stripe->first;
+  gst_bayer2rgb_split_line (bayer2rgb, stripe, LINE (j * 2 - 2),
+      LINE (j * 2 - 1), j - 1);
+  gst_bayer2rgb_split_line (bayer2rgb, stripe, LINE (j * 2 + 0),
+      LINE (j * 2 + 1), j);
 
-  for (j = 0; j < bayer2rgb->height; j++) {
-    if (j < bayer2rgb->height - 1) {
-      gst_bayer2rgb_split_and_upsample_horiz (LINE ((j + 1) * 2 + 0),
-          LINE ((j + 1) * 2 + 1), src + (j + 1) * src_stride, bayer2rgb->width);
-    }
+  for (; j < stripe->last; j++) {
+    gst_bayer2rgb_split_line (bayer2rgb, stripe, LINE ((j + 1) * 2 + 0),
+        LINE ((j + 1) * 2 + 1), j + 1);
 
-    merge[j & 1] (dest + j * dest_stride,
+    bayer2rgb->merge[j & 1] (stripe->dest + j * stripe->dest_stride,
         LINE (j * 2 - 2), LINE (j * 2 - 1),
         LINE (j * 2 + 0), LINE (j * 2 + 1),
         LINE (j * 2 + 2), LINE (j * 2 + 3), bayer2rgb->width >> 1);
   }
 
-  g_free (tmp);
+#undef LINE
+}
+
+/* Reads a line of samples into 16 bits per sample, with two mirrored samples
+ * on either side */
+static void
+gst_bayer2rgb_load_line (GstBayer2RGB * bayer2rgb, guint16 * dest,
+    const guint8 * src)
+{
+  int i, n = bayer2rgb->width;
+
+  if (bayer2rgb->depth == 8) {
+    for (i = 0; i < n; i++)
+      dest[i] = src[i];
+  } else if (bayer2rgb->big_endian) {
+    for (i = 0; i < n; i++)
+      dest[i] = GST_READ_UINT16_BE (src + 2 * i);
+  } else {
+    for (i = 0; i < n; i++)
+      dest[i] = GST_READ_UINT16_LE (src + 2 * i);
+  }
+
+  dest[-2] = dest[gst_bayer2rgb_mirror (-2, n)];
+  dest[-1] = dest[gst_bayer2rgb_mirror (-1, n)];
+  dest[n] = dest[gst_bayer2rgb_mirror (n, n)];
+  dest[n + 1] = dest[gst_bayer2rgb_mirror (n + 1, n)];
+}
+
+/* The Malvar-He-Cutler kernels, scaled by 16.  m2, m1, z, p1 and p2 point to
+ * the sample in the rows two above to two below the output row. */
+
+/* green at a red or blue sample */
+static inline int
+malvar_green (const guint16 * m2, const guint16 * m1, const guint16 * z,
+    const guint16 * p1, const guint16 * p2)
+{
+  return 8 * z[0] + 4 * (m1[0] + p1[0] + z[-1] + z[1])
+      - 2 * (m2[0] + p2[0] + z[-2] + z[2]);
+}
+
+/* red or blue at a green sample that has it to the left and right */
+static inline int
+malvar_horiz (const guint16 * m2, const guint16 * m1, const guint16 * z,
+    const guint16 * p1, const guint16 * p2)
+{
+  return 10 * z[0] + 8 * (z[-1] + z[1])
+      - 2 * (z[-2] + z[2] + m1[-1] + m1[1] + p1[-1] + p1[1])
+      + m2[0] + p2[0];
+}
+
+/* red or blue at a green sample that has it above and below */
+static inline int
+malvar_vert (const guint16 * m2, const guint16 * m1, const guint16 * z,
+    const guint16 * p1, const guint16 * p2)
+{
+  return 10 * z[0] + 8 * (m1[0] + p1[0])
+      - 2 * (m2[0] + p2[0] + m1[-1] + m1[1] + p1[-1] + p1[1])
+      + z[-2] + z[2];
+}
+
+/* red at a blue sample and blue at a red sample */
+static inline int
+malvar_diag (const guint16 * m2, const guint16 * m1, const guint16 * z,
+    const guint16 * p1, const guint16 * p2)
+{
+  return 12 * z[0] + 4 * (m1[-1] + m1[1] + p1[-1] + p1[1])
+      - 3 * (m2[0] + p2[0] + z[-2] + z[2]);
+}
+
+static inline guint8
+malvar_clamp (int v, int max, int shift)
+{
+  v = (v + 8) >> 4;
+  v = CLAMP (v, 0, max);
+
+  return v >> shift;
+}
+
+/* Converts one row.  own_off is the offset of the colour that shares the row
+ * with green, other_off the offset of the colour in the rows above and
+ * below.  Samples of the own colour are at the odd columns if odd is set. */
+static void
+gst_bayer2rgb_malvar_line (guint8 * dest, const guint16 * m2,
+    const guint16 * m1, const guint16 * z, const guint16 * p1,
+    const guint16 * p2, int n, gboolean odd, int own_off, int g_off,
+    int other_off, int a_off, int depth)
+{
+  int max = (1 << depth) - 1;
+  int shift = depth - 8;
+  int i;
+
+#define GREEN_SAMPLE(i) G_STMT_START {                                  \
+  guint8 *d = dest + 4 * (i);                                           \
+  d[own_off] = malvar_clamp (malvar_horiz (m2 + (i), m1 + (i), z + (i), \
+          p1 + (i), p2 + (i)), max, shift);                             \
+  d[g_off] = malvar_clamp (16 * z[i], max, shift);                      \
+  d[other_off] = malvar_clamp (malvar_vert (m2 + (i), m1 + (i),         \
+          z + (i), p1 + (i), p2 + (i)), max, shift);                    \
+  d[a_off] = 0xff;                                                      \
+} G_STMT_END
+
+#define OWN_SAMPLE(i) G_STMT_START {                                    \
+  guint8 *d = dest + 4 * (i);                                           \
+  d[own_off] = malvar_clamp (16 * z[i], max, shift);                    \
+  d[g_off] = malvar_clamp (malvar_green (m2 + (i), m1 + (i), z + (i),   \
+          p1 + (i), p2 + (i)), max, shift);                             \
+  d[other_off] = malvar_clamp (malvar_diag (m2 + (i), m1 + (i),         \
+          z + (i), p1 + (i), p2 + (i)), max, shift);                    \
+  d[a_off] = 0xff;                                                      \
+} G_STMT_END
+
+  i = 0;
+  if (odd && n > 0) {
+    GREEN_SAMPLE (0);
+    i = 1;
+  }
+  for (; i + 1 < n; i += 2) {
+    OWN_SAMPLE (i);
+    GREEN_SAMPLE (i + 1);
+  }
+  if (i < n)
+    OWN_SAMPLE (i);
+
+#undef GREEN_SAMPLE
+#undef OWN_SAMPLE
+}
+
+/* Line buffers: 5 lines of 16-bit samples with two samples of padding on
+ * either side */
+#define MALVAR_TMP_SIZE(width) (5 * ((width) + 4) * sizeof (guint16))
+
+static void
+gst_bayer2rgb_process_malvar (GstBayer2RGB * bayer2rgb,
+    GstBayer2RGBStripe * stripe)
+{
+  int line_size = bayer2rgb->width + 4;
+  guint16 *tmp = (guint16 *) stripe->tmp;
+  int r_off, b_off, a_off;
+  int j;
+
+  gst_bayer2rgb_get_bggr_offsets (bayer2rgb, &r_off, &b_off);
+  /* the offsets are three of 0 to 3, alpha or padding is the fourth */
+  a_off = 6 - r_off - bayer2rgb->g_off - b_off;
+
+#define LINE(x) (tmp + (((x) + 5) % 5) * line_size + 2)
+
+  for (j = stripe->first - 2; j < stripe->first + 2; j++)
+    gst_bayer2rgb_load_line (bayer2rgb, LINE (j),
+        gst_bayer2rgb_src_line (bayer2rgb, stripe, j));
+
+  for (j = stripe->first; j < stripe->last; j++) {
+    gst_bayer2rgb_load_line (bayer2rgb, LINE (j + 2),
+        gst_bayer2rgb_src_line (bayer2rgb, stripe, j + 2));
+
+    /* In the BGGR arrangement, even rows are blue and green starting with
+     * blue, odd rows are green and red starting with green */
+    if (((j + SWAPPED_ROWS (bayer2rgb)) & 1) == 0) {
+      gst_bayer2rgb_malvar_line (stripe->dest + j * stripe->dest_stride,
+          LINE (j - 2), LINE (j - 1), LINE (j), LINE (j + 1), LINE (j + 2),
+          bayer2rgb->width, FALSE, b_off, bayer2rgb->g_off, r_off, a_off,
+          bayer2rgb->depth);
+    } else {
+      gst_bayer2rgb_malvar_line (stripe->dest + j * stripe->dest_stride,
+          LINE (j - 2), LINE (j - 1), LINE (j), LINE (j + 1), LINE (j + 2),
+          bayer2rgb->width, TRUE, r_off, bayer2rgb->g_off, b_off, a_off,
+          bayer2rgb->depth);
+    }
+  }
+
+#undef LINE
 }
 
+static void
+gst_bayer2rgb_stripe_thread (gpointer data, gpointer user_data)
+{
+  GstBayer2RGB *bayer2rgb = user_data;
+  GstBayer2RGBStripe *stripe = data;
+
+  stripe->func (bayer2rgb, stripe);
+
+  g_mutex_lock (&bayer2rgb->stripe_lock);
+  if (--bayer2rgb->stripes_pending == 0)
+    g_cond_signal (&bayer2rgb->stripe_cond);
+  g_mutex_unlock (&bayer2rgb->stripe_lock);
+}
+
+/* Cuts the frame into one stripe of rows per thread and converts them in
+ * parallel */
+static void
+gst_bayer2rgb_process (GstBayer2RGB * bayer2rgb, uint8_t * dest,
+    int dest_stride, uint8_t * src, int src_stride)
+{
+  GstBayer2RGBStripeFunc func;
+  gsize tmp_size;
+  guint i, n_stripes;
+
+  if (bayer2rgb->method == GST_BAYER_2_RGB_METHOD_MALVAR) {
+    func = gst_bayer2rgb_process_malvar;
+    tmp_size = MALVAR_TMP_SIZE (bayer2rgb->width);
+  } else {
+    func = gst_bayer2rgb_process_linear;
+    tmp_size = LINEAR_TMP_SIZE (bayer2rgb->width);
+  }
 
+  n_stripes = MAX (bayer2rgb->height / MIN_STRIPE_HEIGHT, 1);
+  n_stripes = MIN (n_stripes, bayer2rgb->n_threads);
 
+  for (i = 0; i < n_stripes; i++) {
+    GstBayer2RGBStripe *stripe = &bayer2rgb->stripes[i];
+
+    stripe->func = func;
+    stripe->dest = dest;
+    stripe->dest_stride = dest_stride;
+    stripe->src = src;
+    stripe->src_stride = src_stride;
+    stripe->first = (gint64) bayer2rgb->height * i / n_stripes;
+    stripe->last = (gint64) bayer2rgb->height * (i + 1) / n_stripes;
+
+    if (stripe->tmp_size < tmp_size) {
+      g_free (stripe->tmp);
+      stripe->tmp = g_malloc (tmp_size);
+      stripe->tmp_size = tmp_size;
+    }
+  }
+
+  g_mutex_lock (&bayer2rgb->stripe_lock);
+  bayer2rgb->stripes_pending = n_stripes - 1;
+  g_mutex_unlock (&bayer2rgb->stripe_lock);
+  for (i = 1; i < n_stripes; i++)
+    g_thread_pool_push (bayer2rgb->stripe_pool, &bayer2rgb->stripes[i], NULL);
+
+  func (bayer2rgb, &bayer2rgb->stripes[0]);
+
+  if (n_stripes > 1) {
+    g_mutex_lock (&bayer2rgb->stripe_lock);
+    while (bayer2rgb->stripes_pending)
+      g_cond_wait (&bayer2rgb->stripe_cond, &bayer2rgb->stripe_lock);
+    g_mutex_unlock (&bayer2rgb->stripe_lock);
+  }
+}
 
 static GstFlowReturn
 gst_bayer2rgb_transform (GstBaseTransform * base, GstBuffer * inbuf,
@@ -471,7 +1018,8 @@ gst_bayer2rgb_transform (GstBaseTransform * base, GstBuffer * inbuf,
 
   output = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
   gst_bayer2rgb_process (filter, output, frame.info.stride[0],
-      map.data, GST_ROUND_UP_4 (filter->width));
+      map.data, GST_ROUND_UP_4 (filter->width *
+          BYTES_PER_SAMPLE (filter->depth)));
 
   gst_video_frame_unmap (&frame);
   gst_buffer_unmap (inbuf, &map);
@@ -16,6 +16,28 @@
  * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
  * Boston, MA 02110-1301, USA.
  */
+/**
+ * SECTION:element-checksumsink
+ * @title: checksumsink
+ *
+ * The checksumsink element calculates a checksum for every buffer it
+ * receives and prints it together with the buffer timestamp.
+ *
+ * Besides the cryptographic hashes provided by GLib, the much faster
+ * non-cryptographic xxhash64 and crc32c hashes can be selected with the
+ * #GstChecksumSink:hash property. For raw video
+ * #GstChecksumSink:video-planes only hashes the visible pixels of each
+ * plane, so that the result does not depend on the strides and padding
+ * chosen by upstream. Hashing can be moved off the streaming thread with
+ * #GstChecksumSink:threaded and the results can be written to a file in a
+ * tab separated format with #GstChecksumSink:location.
+ *
+ * ## Example launch line
+ * |[
+ * gst-launch-1.0 videotestsrc num-buffers=100 ! checksumsink hash=xxhash64 video-planes=true location=sums.txt
+ * ]|
+ *
+ */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -25,6 +47,10 @@
 #include <gst/base/gstbasesink.h>
 #include "gstchecksumsink.h"
 
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <string.h>
+
 static void gst_checksum_sink_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_checksum_sink_get_property (GObject * object, guint prop_id,
@@ -34,6 +60,11 @@ static void gst_checksum_sink_finalize (GObject * object);
 
 static gboolean gst_checksum_sink_start (GstBaseSink * sink);
 static gboolean gst_checksum_sink_stop (GstBaseSink * sink);
+static gboolean gst_checksum_sink_set_caps (GstBaseSink * sink,
+    GstCaps * caps);
+static gboolean gst_checksum_sink_event (GstBaseSink * sink, GstEvent * event);
+static gboolean gst_checksum_sink_unlock (GstBaseSink * sink);
+static gboolean gst_checksum_sink_unlock_stop (GstBaseSink * sink);
 static GstFlowReturn
 gst_checksum_sink_render (GstBaseSink * sink, GstBuffer * buffer);
 
@@ -41,8 +72,26 @@ enum
 {
   PROP_0,
   PROP_HASH,
+  PROP_VIDEO_PLANES,
+  PROP_THREADED,
+  PROP_LOCATION
+};
+
+/* Hashes not provided by GChecksum, kept clear of GChecksumType values */
+enum
+{
+  CHECKSUM_XXH64 = 0x100,
+  CHECKSUM_CRC32C
 };
 
+#define DEFAULT_HASH G_CHECKSUM_SHA1
+#define DEFAULT_VIDEO_PLANES FALSE
+#define DEFAULT_THREADED FALSE
+#define DEFAULT_LOCATION NULL
+
+/* number of buffers that can be queued for the worker thread */
+#define MAX_PENDING_BUFFERS 8
+
 static GstStaticPadTemplate gst_checksum_sink_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -69,6 +118,8 @@ gst_checksum_sink_hash_get_type (void)
       {G_CHECKSUM_SHA1, "SHA-1", "sha1"},
       {G_CHECKSUM_SHA256, "SHA-256", "sha256"},
       {G_CHECKSUM_SHA512, "SHA-512", "sha512"},
+      {CHECKSUM_XXH64, "xxHash 64 bit (not cryptographic)", "xxhash64"},
+      {CHECKSUM_CRC32C, "CRC-32C (not cryptographic)", "crc32c"},
       {0, NULL, NULL},
     };
 
@@ -80,6 +131,29 @@ gst_checksum_sink_hash_get_type (void)
 #define gst_checksum_sink_parent_class parent_class
 G_DEFINE_TYPE (GstChecksumSink, gst_checksum_sink, GST_TYPE_BASE_SINK);
 
+static guint32 crc32c_table[8][256];
+
+static void
+gst_checksum_sink_init_crc32c_table (void)
+{
+  guint32 i, j, crc;
+
+  for (i = 0; i < 256; i++) {
+    crc = i;
+    for (j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+    crc32c_table[0][i] = crc;
+  }
+
+  /* tables for processing 8 bytes at once */
+  for (i = 0; i < 256; i++) {
+    for (j = 1; j < 8; j++) {
+      crc = crc32c_table[j - 1][i];
+      crc32c_table[j][i] = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+    }
+  }
+}
+
 static void
 gst_checksum_sink_class_init (GstChecksumSinkClass * klass)
 {
@@ -93,6 +167,11 @@ gst_checksum_sink_class_init (GstChecksumSinkClass * klass)
   gobject_class->finalize = gst_checksum_sink_finalize;
   base_sink_class->start = GST_DEBUG_FUNCPTR (gst_checksum_sink_start);
   base_sink_class->stop = GST_DEBUG_FUNCPTR (gst_checksum_sink_stop);
+  base_sink_class->set_caps = GST_DEBUG_FUNCPTR (gst_checksum_sink_set_caps);
+  base_sink_class->event = GST_DEBUG_FUNCPTR (gst_checksum_sink_event);
+  base_sink_class->unlock = GST_DEBUG_FUNCPTR (gst_checksum_sink_unlock);
+  base_sink_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_checksum_sink_unlock_stop);
   base_sink_class->render = GST_DEBUG_FUNCPTR (gst_checksum_sink_render);
 
   gst_element_class_add_static_pad_template (element_class,
@@ -102,19 +181,47 @@ gst_checksum_sink_class_init (GstChecksumSinkClass * klass)
 
   g_object_class_install_property (gobject_class, PROP_HASH,
       g_param_spec_enum ("hash", "Hash", "Checksum type",
-          gst_checksum_sink_hash_get_type (), G_CHECKSUM_SHA1,
+          gst_checksum_sink_hash_get_type (), DEFAULT_HASH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_VIDEO_PLANES,
+      g_param_spec_boolean ("video-planes", "Video planes",
+          "Only hash the visible pixels of each plane of raw video, ignoring "
+          "stride padding", DEFAULT_VIDEO_PLANES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_THREADED,
+      g_param_spec_boolean ("threaded", "Threaded",
+          "Calculate the checksums in a separate thread instead of the "
+          "streaming thread", DEFAULT_THREADED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "Location",
+          "File to write the checksums to instead of stdout, one line per "
+          "buffer with tab separated index, PTS, duration (in nanoseconds, "
+          "-1 if unknown) and checksum", DEFAULT_LOCATION,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (element_class, "Checksum sink",
       "Debug/Sink", "Calculates a checksum for buffers",
       "David Schleef <ds@schleef.org>");
+
+  gst_checksum_sink_init_crc32c_table ();
 }
 
 static void
 gst_checksum_sink_init (GstChecksumSink * checksumsink)
 {
   gst_base_sink_set_sync (GST_BASE_SINK (checksumsink), FALSE);
-  checksumsink->hash = G_CHECKSUM_SHA1;
+  checksumsink->hash = DEFAULT_HASH;
+  checksumsink->video_planes = DEFAULT_VIDEO_PLANES;
+  checksumsink->threaded = DEFAULT_THREADED;
+  checksumsink->location = g_strdup (DEFAULT_LOCATION);
+
+  g_mutex_init (&checksumsink->lock);
+  g_cond_init (&checksumsink->cond);
+  g_queue_init (&checksumsink->queue);
 }
 
 static void
@@ -125,7 +232,25 @@ gst_checksum_sink_set_property (GObject * object, guint prop_id,
 
   switch (prop_id) {
     case PROP_HASH:
+      GST_OBJECT_LOCK (checksumsink);
       checksumsink->hash = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (checksumsink);
+      break;
+    case PROP_VIDEO_PLANES:
+      GST_OBJECT_LOCK (checksumsink);
+      checksumsink->video_planes = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (checksumsink);
+      break;
+    case PROP_THREADED:
+      GST_OBJECT_LOCK (checksumsink);
+      checksumsink->threaded = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (checksumsink);
+      break;
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (checksumsink);
+      g_free (checksumsink->location);
+      checksumsink->location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (checksumsink);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -141,7 +266,24 @@ gst_checksum_sink_get_property (GObject * object, guint prop_id,
 
   switch (prop_id) {
     case PROP_HASH:
+      GST_OBJECT_LOCK (checksumsink);
       g_value_set_enum (value, checksumsink->hash);
+      GST_OBJECT_UNLOCK (checksumsink);
+      break;
+    case PROP_VIDEO_PLANES:
+      GST_OBJECT_LOCK (checksumsink);
+      g_value_set_boolean (value, checksumsink->video_planes);
+      GST_OBJECT_UNLOCK (checksumsink);
+      break;
+    case PROP_THREADED:
+      GST_OBJECT_LOCK (checksumsink);
+      g_value_set_boolean (value, checksumsink->threaded);
+      GST_OBJECT_UNLOCK (checksumsink);
+      break;
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (checksumsink);
+      g_value_set_string (value, checksumsink->location);
+      GST_OBJECT_UNLOCK (checksumsink);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -158,36 +300,513 @@ gst_checksum_sink_dispose (GObject * object)
 static void
 gst_checksum_sink_finalize (GObject * object)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (object);
+
+  g_free (checksumsink->location);
+  g_mutex_clear (&checksumsink->lock);
+  g_cond_clear (&checksumsink->cond);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* xxHash64, see https://github.com/Cyan4973/xxHash */
+#define XXH_PRIME64_1 G_GUINT64_CONSTANT (11400714785074694791)
+#define XXH_PRIME64_2 G_GUINT64_CONSTANT (14029467366897019727)
+#define XXH_PRIME64_3 G_GUINT64_CONSTANT (1609587929392839161)
+#define XXH_PRIME64_4 G_GUINT64_CONSTANT (9650029242287828579)
+#define XXH_PRIME64_5 G_GUINT64_CONSTANT (2870177450012600261)
+
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline guint64
+xxh64_round (guint64 acc, guint64 input)
+{
+  acc += input * XXH_PRIME64_2;
+  acc = XXH_ROTL64 (acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline guint64
+xxh64_merge_round (guint64 acc, guint64 val)
+{
+  acc ^= xxh64_round (0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void
+xxh64_reset (GstChecksumSinkXXH64 * state)
+{
+  state->total_len = 0;
+  state->mem_size = 0;
+  state->v[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+  state->v[1] = XXH_PRIME64_2;
+  state->v[2] = 0;
+  state->v[3] = 0 - XXH_PRIME64_1;
+}
+
+static void
+xxh64_update (GstChecksumSinkXXH64 * state, const guint8 * data, gsize len)
+{
+  const guint8 *end = data + len;
+  guint64 v1, v2, v3, v4;
+
+  state->total_len += len;
+
+  if (state->mem_size + len < 32) {
+    memcpy (state->mem + state->mem_size, data, len);
+    state->mem_size += len;
+    return;
+  }
+
+  v1 = state->v[0];
+  v2 = state->v[1];
+  v3 = state->v[2];
+  v4 = state->v[3];
+
+  if (state->mem_size > 0) {
+    guint fill = 32 - state->mem_size;
+
+    memcpy (state->mem + state->mem_size, data, fill);
+    v1 = xxh64_round (v1, GST_READ_UINT64_LE (state->mem));
+    v2 = xxh64_round (v2, GST_READ_UINT64_LE (state->mem + 8));
+    v3 = xxh64_round (v3, GST_READ_UINT64_LE (state->mem + 16));
+    v4 = xxh64_round (v4, GST_READ_UINT64_LE (state->mem + 24));
+    data += fill;
+    state->mem_size = 0;
+  }
+
+  while (end - data >= 32) {
+    v1 = xxh64_round (v1, GST_READ_UINT64_LE (data));
+    v2 = xxh64_round (v2, GST_READ_UINT64_LE (data + 8));
+    v3 = xxh64_round (v3, GST_READ_UINT64_LE (data + 16));
+    v4 = xxh64_round (v4, GST_READ_UINT64_LE (data + 24));
+    data += 32;
+  }
+
+  state->v[0] = v1;
+  state->v[1] = v2;
+  state->v[2] = v3;
+  state->v[3] = v4;
+
+  memcpy (state->mem, data, end - data);
+  state->mem_size = end - data;
+}
+
+static guint64
+xxh64_digest (const GstChecksumSinkXXH64 * state)
+{
+  const guint8 *p = state->mem;
+  const guint8 *end = state->mem + state->mem_size;
+  guint64 h;
+
+  if (state->total_len >= 32) {
+    h = XXH_ROTL64 (state->v[0], 1) + XXH_ROTL64 (state->v[1], 7) +
+        XXH_ROTL64 (state->v[2], 12) + XXH_ROTL64 (state->v[3], 18);
+    h = xxh64_merge_round (h, state->v[0]);
+    h = xxh64_merge_round (h, state->v[1]);
+    h = xxh64_merge_round (h, state->v[2]);
+    h = xxh64_merge_round (h, state->v[3]);
+  } else {
+    h = XXH_PRIME64_5;
+  }
+
+  h += state->total_len;
+
+  while (p + 8 <= end) {
+    h ^= xxh64_round (0, GST_READ_UINT64_LE (p));
+    h = XXH_ROTL64 (h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    p += 8;
+  }
+  if (p + 4 <= end) {
+    h ^= (guint64) GST_READ_UINT32_LE (p) * XXH_PRIME64_1;
+    h = XXH_ROTL64 (h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= *p * XXH_PRIME64_5;
+    h = XXH_ROTL64 (h, 11) * XXH_PRIME64_1;
+    p++;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+/* CRC-32C (Castagnoli), slicing-by-8 */
+static guint32
+crc32c_update (guint32 crc, const guint8 * data, gsize len)
+{
+  crc = ~crc;
+
+  while (len >= 8) {
+    guint32 lo = crc ^ GST_READ_UINT32_LE (data);
+    guint32 hi = GST_READ_UINT32_LE (data + 4);
+
+    crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+        crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+        crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff] ^
+        crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+    data += 8;
+    len -= 8;
+  }
+
+  while (len--)
+    crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *data++) & 0xff];
+
+  return ~crc;
+}
+
+/* The hash functions get the hash type read once per buffer, so that
+ * changing the property while hashing a buffer can't mix two types */
+static void
+gst_checksum_sink_hash_reset (GstChecksumSink * checksumsink, gint hash)
+{
+  switch (hash) {
+    case CHECKSUM_XXH64:
+      xxh64_reset (&checksumsink->xxh64);
+      break;
+    case CHECKSUM_CRC32C:
+      checksumsink->crc = 0;
+      break;
+    default:
+      if (checksumsink->checksum
+          && checksumsink->checksum_type == hash) {
+        g_checksum_reset (checksumsink->checksum);
+      } else {
+        if (checksumsink->checksum)
+          g_checksum_free (checksumsink->checksum);
+        checksumsink->checksum = g_checksum_new (hash);
+        checksumsink->checksum_type = hash;
+      }
+      break;
+  }
+}
+
+static void
+gst_checksum_sink_hash_update (GstChecksumSink * checksumsink, gint hash,
+    const guint8 * data, gsize size)
+{
+  switch (hash) {
+    case CHECKSUM_XXH64:
+      xxh64_update (&checksumsink->xxh64, data, size);
+      break;
+    case CHECKSUM_CRC32C:
+      checksumsink->crc = crc32c_update (checksumsink->crc, data, size);
+      break;
+    default:
+      g_checksum_update (checksumsink->checksum, data, size);
+      break;
+  }
+}
+
+static gchar *
+gst_checksum_sink_hash_finish (GstChecksumSink * checksumsink, gint hash)
+{
+  switch (hash) {
+    case CHECKSUM_XXH64:
+      return g_strdup_printf ("%016" G_GINT64_MODIFIER "x",
+          xxh64_digest (&checksumsink->xxh64));
+    case CHECKSUM_CRC32C:
+      return g_strdup_printf ("%08x", checksumsink->crc);
+    default:
+      return g_strdup (g_checksum_get_string (checksumsink->checksum));
+  }
+}
+
+/* Hashes the visible part of every plane row by row */
+static gboolean
+gst_checksum_sink_hash_video (GstChecksumSink * checksumsink, gint hash,
+    GstBuffer * buffer)
+{
+  GstVideoFrame frame;
+  guint plane, comp;
+  gint row;
+
+  if (!gst_video_frame_map (&frame, &checksumsink->info, buffer,
+          GST_MAP_READ))
+    return FALSE;
+
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (&frame); plane++) {
+    const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (&frame, plane);
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, plane);
+    gsize row_size = ABS (stride);
+    gint height = GST_VIDEO_FRAME_HEIGHT (&frame);
+
+    /* the first component stored in this plane gives the visible size,
+     * formats without a pixel stride are hashed with padding */
+    for (comp = 0; comp < GST_VIDEO_FRAME_N_COMPONENTS (&frame); comp++) {
+      if (GST_VIDEO_FORMAT_INFO_PLANE (frame.info.finfo, comp) != plane)
+        continue;
+
+      if (GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, comp) > 0)
+        row_size = GST_VIDEO_FRAME_COMP_WIDTH (&frame, comp) *
+            GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, comp);
+      height = GST_VIDEO_FRAME_COMP_HEIGHT (&frame, comp);
+      break;
+    }
+
+    for (row = 0; row < height; row++)
+      gst_checksum_sink_hash_update (checksumsink, hash, data + row * stride,
+          row_size);
+  }
+
+  gst_video_frame_unmap (&frame);
+
+  return TRUE;
+}
+
+static void
+gst_checksum_sink_process (GstChecksumSink * checksumsink, GstBuffer * buffer)
+{
+  GstMapInfo map;
+  gboolean video_planes;
+  gint hash;
+  gchar *s;
+
+  GST_OBJECT_LOCK (checksumsink);
+  hash = checksumsink->hash;
+  video_planes = checksumsink->video_planes;
+  GST_OBJECT_UNLOCK (checksumsink);
+
+  gst_checksum_sink_hash_reset (checksumsink, hash);
+
+  if (!video_planes || !checksumsink->have_info
+      || !gst_checksum_sink_hash_video (checksumsink, hash, buffer)) {
+    gst_buffer_map (buffer, &map, GST_MAP_READ);
+    gst_checksum_sink_hash_update (checksumsink, hash, map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+  }
+
+  s = gst_checksum_sink_hash_finish (checksumsink, hash);
+
+  if (checksumsink->file) {
+    fprintf (checksumsink->file, "%" G_GUINT64_FORMAT "\t%" G_GINT64_FORMAT
+        "\t%" G_GINT64_FORMAT "\t%s\n", checksumsink->n_buffers,
+        GST_CLOCK_TIME_IS_VALID (GST_BUFFER_PTS (buffer)) ?
+        (gint64) GST_BUFFER_PTS (buffer) : -1,
+        GST_CLOCK_TIME_IS_VALID (GST_BUFFER_DURATION (buffer)) ?
+        (gint64) GST_BUFFER_DURATION (buffer) : -1, s);
+  } else {
+    g_print ("%" GST_TIME_FORMAT " %s\n",
+        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)), s);
+  }
+  checksumsink->n_buffers++;
+
+  g_free (s);
+}
+
+static gpointer
+gst_checksum_sink_thread (GstChecksumSink * checksumsink)
+{
+  GstBuffer *buffer;
+
+  g_mutex_lock (&checksumsink->lock);
+  while (TRUE) {
+    while (checksumsink->running && g_queue_is_empty (&checksumsink->queue))
+      g_cond_wait (&checksumsink->cond, &checksumsink->lock);
+
+    if (!checksumsink->running)
+      break;
+
+    buffer = g_queue_pop_head (&checksumsink->queue);
+    checksumsink->busy = TRUE;
+    g_cond_broadcast (&checksumsink->cond);
+    g_mutex_unlock (&checksumsink->lock);
+
+    gst_checksum_sink_process (checksumsink, buffer);
+    gst_buffer_unref (buffer);
+
+    g_mutex_lock (&checksumsink->lock);
+    checksumsink->busy = FALSE;
+    g_cond_broadcast (&checksumsink->cond);
+  }
+  g_mutex_unlock (&checksumsink->lock);
+
+  return NULL;
+}
+
+/* Waits until the worker thread processed all queued buffers */
+static void
+gst_checksum_sink_drain (GstChecksumSink * checksumsink)
+{
+  if (!checksumsink->thread)
+    return;
+
+  g_mutex_lock (&checksumsink->lock);
+  while (!checksumsink->flushing && (checksumsink->busy
+          || !g_queue_is_empty (&checksumsink->queue)))
+    g_cond_wait (&checksumsink->cond, &checksumsink->lock);
+  g_mutex_unlock (&checksumsink->lock);
+}
+
 static gboolean
 gst_checksum_sink_start (GstBaseSink * sink)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+  gboolean threaded;
+  gchar *location;
+
+  checksumsink->n_buffers = 0;
+  checksumsink->have_info = FALSE;
+
+  GST_OBJECT_LOCK (checksumsink);
+  threaded = checksumsink->threaded;
+  location = g_strdup (checksumsink->location);
+  GST_OBJECT_UNLOCK (checksumsink);
+
+  if (location) {
+    checksumsink->file = g_fopen (location, "w");
+    if (!checksumsink->file) {
+      GST_ELEMENT_ERROR (checksumsink, RESOURCE, OPEN_WRITE,
+          ("Could not open file \"%s\" for writing.", location),
+          GST_ERROR_SYSTEM);
+      g_free (location);
+      return FALSE;
+    }
+    g_free (location);
+  }
+
+  if (threaded) {
+    checksumsink->running = TRUE;
+    checksumsink->flushing = FALSE;
+    checksumsink->thread = g_thread_new ("checksumsink",
+        (GThreadFunc) gst_checksum_sink_thread, checksumsink);
+  }
+
   return TRUE;
 }
 
 static gboolean
 gst_checksum_sink_stop (GstBaseSink * sink)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  if (checksumsink->thread) {
+    g_mutex_lock (&checksumsink->lock);
+    checksumsink->running = FALSE;
+    g_queue_foreach (&checksumsink->queue, (GFunc) gst_buffer_unref, NULL);
+    g_queue_clear (&checksumsink->queue);
+    g_cond_broadcast (&checksumsink->cond);
+    g_mutex_unlock (&checksumsink->lock);
+
+    g_thread_join (checksumsink->thread);
+    checksumsink->thread = NULL;
+  }
+
+  if (checksumsink->file) {
+    fclose (checksumsink->file);
+    checksumsink->file = NULL;
+  }
+
+  if (checksumsink->checksum) {
+    g_checksum_free (checksumsink->checksum);
+    checksumsink->checksum = NULL;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_checksum_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+  GstVideoInfo info;
+  gboolean have_info = FALSE;
+
+  if (gst_structure_has_name (gst_caps_get_structure (caps, 0),
+          "video/x-raw"))
+    have_info = gst_video_info_from_caps (&info, caps);
+
+  /* queued buffers still have to be hashed with the previous format */
+  gst_checksum_sink_drain (checksumsink);
+
+  checksumsink->have_info = have_info;
+  if (have_info)
+    checksumsink->info = info;
+
+  return TRUE;
+}
+
+static gboolean
+gst_checksum_sink_event (GstBaseSink * sink, GstEvent * event)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      /* all checksums are written once EOS is posted */
+      gst_checksum_sink_drain (checksumsink);
+      if (checksumsink->file)
+        fflush (checksumsink->file);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&checksumsink->lock);
+      g_queue_foreach (&checksumsink->queue, (GFunc) gst_buffer_unref, NULL);
+      g_queue_clear (&checksumsink->queue);
+      g_mutex_unlock (&checksumsink->lock);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_SINK_CLASS (parent_class)->event (sink, event);
+}
+
+static gboolean
+gst_checksum_sink_unlock (GstBaseSink * sink)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  g_mutex_lock (&checksumsink->lock);
+  checksumsink->flushing = TRUE;
+  g_cond_broadcast (&checksumsink->cond);
+  g_mutex_unlock (&checksumsink->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_checksum_sink_unlock_stop (GstBaseSink * sink)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  g_mutex_lock (&checksumsink->lock);
+  checksumsink->flushing = FALSE;
+  g_mutex_unlock (&checksumsink->lock);
+
   return TRUE;
 }
 
 static GstFlowReturn
 gst_checksum_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 {
-  gchar *s;
-  GstMapInfo map;
   GstChecksumSink *checksumsink;
 
   checksumsink = GST_CHECKSUM_SINK (sink);
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  s = g_compute_checksum_for_data (checksumsink->hash, map.data, map.size);
-  gst_buffer_unmap (buffer, &map);
-  g_print ("%" GST_TIME_FORMAT " %s\n",
-      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)), s);
 
-  g_free (s);
+  if (!checksumsink->thread) {
+    gst_checksum_sink_process (checksumsink, buffer);
+    return GST_FLOW_OK;
+  }
+
+  g_mutex_lock (&checksumsink->lock);
+  while (!checksumsink->flushing
+      && g_queue_get_length (&checksumsink->queue) >= MAX_PENDING_BUFFERS)
+    g_cond_wait (&checksumsink->cond, &checksumsink->lock);
+
+  if (checksumsink->flushing) {
+    g_mutex_unlock (&checksumsink->lock);
+    return GST_FLOW_FLUSHING;
+  }
+
+  g_queue_push_tail (&checksumsink->queue, gst_buffer_ref (buffer));
+  g_cond_broadcast (&checksumsink->cond);
+  g_mutex_unlock (&checksumsink->lock);
 
   return GST_FLOW_OK;
 }
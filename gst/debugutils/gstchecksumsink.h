@@ -22,6 +22,8 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstbasesink.h>
+#include <gst/video/video.h>
+#include <stdio.h>
 
 G_BEGIN_DECLS
 
@@ -34,10 +36,43 @@ G_BEGIN_DECLS
 typedef struct _GstChecksumSink GstChecksumSink;
 typedef struct _GstChecksumSinkClass GstChecksumSinkClass;
 
+typedef struct
+{
+  guint64 total_len;
+  guint64 v[4];
+  guint8 mem[32];
+  guint mem_size;
+} GstChecksumSinkXXH64;
+
 struct _GstChecksumSink
 {
   GstBaseSink base_checksumsink;
-  GChecksumType hash;
+
+  /* properties, protected by the object lock */
+  gint hash;
+  gboolean video_planes;
+  gboolean threaded;
+  gchar *location;
+
+  /* hashing state, only used from one thread at a time */
+  GChecksum *checksum;
+  gint checksum_type;
+  guint32 crc;
+  GstChecksumSinkXXH64 xxh64;
+
+  GstVideoInfo info;
+  gboolean have_info;
+  guint64 n_buffers;
+  FILE *file;
+
+  /* worker thread, protected by lock */
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  GQueue queue;
+  gboolean running;
+  gboolean busy;
+  gboolean flushing;
 };
 
 struct _GstChecksumSinkClass
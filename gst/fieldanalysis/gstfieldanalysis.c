@@ -82,6 +82,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_field_analysis_debug);
 #define DEFAULT_BLOCK_HEIGHT 16
 #define DEFAULT_BLOCK_THRESH 80
 #define DEFAULT_IGNORED_LINES 2
+#define DEFAULT_MAX_THREADS 0
+#define DEFAULT_DECIMATION 1
 
 enum
 {
@@ -96,7 +98,9 @@ enum
   PROP_BLOCK_WIDTH,
   PROP_BLOCK_HEIGHT,
   PROP_BLOCK_THRESH,
-  PROP_IGNORED_LINES
+  PROP_IGNORED_LINES,
+  PROP_MAX_THREADS,
+  PROP_DECIMATION
 };
 
 static GstStaticPadTemplate sink_factory =
@@ -122,6 +126,7 @@ static GstFlowReturn gst_field_analysis_chain (GstPad * pad, GstObject * parent,
 static GstStateChangeReturn gst_field_analysis_change_state (GstElement *
     element, GstStateChange transition);
 static void gst_field_analysis_finalize (GObject * self);
+static void gst_field_analysis_band_thread (gpointer data, gpointer user_data);
 
 static GQueue *gst_field_analysis_flush_frames (GstFieldAnalysis * filter);
 
@@ -170,8 +175,7 @@ gst_fieldanalysis_frame_metric_get_type (void)
   if (!fieldanalysis_frame_metric_type) {
     static const GEnumValue fieldanalyis_frame_metrics[] = {
       {GST_FIELDANALYSIS_5_TAP, "5-tap [1,-3,4,-3,1] Vertical Filter", "5-tap"},
-      {GST_FIELDANALYSIS_WINDOWED_COMB,
-            "Windowed Comb Detection (not optimised)",
+      {GST_FIELDANALYSIS_WINDOWED_COMB, "Windowed Comb Detection",
           "windowed-comb"},
       {0, NULL, NULL},
     };
@@ -274,6 +278,19 @@ gst_field_analysis_class_init (GstFieldAnalysisClass * klass)
           "Ignore this many lines from the top and bottom for windowed comb detection",
           2, G_MAXUINT64, DEFAULT_IGNORED_LINES,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_int ("max-threads", "Maximum threads",
+          "Maximum number of threads the rows of each field are analysed in "
+          "(0 = number of processors, 1 = analyse in the streaming thread)",
+          0, G_MAXINT, DEFAULT_MAX_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_DECIMATION,
+      g_param_spec_uint ("decimation", "Decimation",
+          "Only analyse every Nth line of each field (every Nth row of blocks "
+          "for windowed comb detection). Values above 1 are faster but less "
+          "reliable at detecting combing and are meant for detecting the "
+          "telecine pattern only", 1, 64, DEFAULT_DECIMATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_field_analysis_change_state);
@@ -297,12 +314,15 @@ static gfloat same_parity_3_tap (GstFieldAnalysis * filter,
     FieldAnalysisFields (*history)[2]);
 static gfloat opposite_parity_5_tap (GstFieldAnalysis * filter,
     FieldAnalysisFields (*history)[2]);
-static guint64 block_score_for_row_32detect (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1);
-static guint64 block_score_for_row_iscombed (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1);
-static guint64 block_score_for_row_5_tap (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1);
+static void comb_mask_32detect (guint8 * mask, const guint8 * fjm2,
+    const guint8 * fjm1, const guint8 * fj, const guint8 * fjp1,
+    const guint8 * fjp2, gint incr, gint width, gint thresh);
+static void comb_mask_iscombed (guint8 * mask, const guint8 * fjm2,
+    const guint8 * fjm1, const guint8 * fj, const guint8 * fjp1,
+    const guint8 * fjp2, gint incr, gint width, gint thresh);
+static void comb_mask_5_tap (guint8 * mask, const guint8 * fjm2,
+    const guint8 * fjm1, const guint8 * fj, const guint8 * fjp1,
+    const guint8 * fjp2, gint incr, gint width, gint thresh);
 static gfloat opposite_parity_windowed_comb (GstFieldAnalysis * filter,
     FieldAnalysisFields (*history)[2]);
 
@@ -325,10 +345,50 @@ gst_field_analysis_reset (GstFieldAnalysis * filter)
   filter->is_telecine = FALSE;
   filter->first_buffer = TRUE;
   gst_video_info_init (&filter->vinfo);
-  g_free (filter->comb_mask);
-  filter->comb_mask = NULL;
-  g_free (filter->block_scores);
-  filter->block_scores = NULL;
+}
+
+static void
+gst_field_analysis_start (GstFieldAnalysis * filter)
+{
+  filter->n_threads = filter->max_threads;
+  if (filter->n_threads == 0)
+    filter->n_threads = g_get_num_processors ();
+
+  /* the streaming thread analyses one band itself */
+  if (filter->n_threads > 1) {
+    GError *err = NULL;
+
+    filter->band_pool = g_thread_pool_new (gst_field_analysis_band_thread,
+        filter, filter->n_threads - 1, FALSE, &err);
+    if (!filter->band_pool) {
+      GST_WARNING_OBJECT (filter, "Failed to create thread pool: %s",
+          err->message);
+      g_clear_error (&err);
+      filter->n_threads = 1;
+    }
+  }
+  filter->bands = g_new0 (FieldAnalysisBand, filter->n_threads);
+
+  GST_DEBUG_OBJECT (filter, "Analysing in %u threads", filter->n_threads);
+}
+
+static void
+gst_field_analysis_stop (GstFieldAnalysis * filter)
+{
+  guint i;
+
+  if (filter->band_pool) {
+    g_thread_pool_free (filter->band_pool, FALSE, TRUE);
+    filter->band_pool = NULL;
+  }
+
+  for (i = 0; i < filter->n_threads && filter->bands; i++) {
+    g_free (filter->bands[i].comb_mask);
+    g_free (filter->bands[i].block_scores);
+  }
+  g_free (filter->bands);
+  filter->bands = NULL;
+  filter->n_threads = 0;
 }
 
 static void
@@ -352,12 +412,16 @@ gst_field_analysis_init (GstFieldAnalysis * filter)
   filter->same_frame = &opposite_parity_5_tap;
   filter->frame_thresh = DEFAULT_FRAME_THRESH;
   filter->noise_floor = DEFAULT_NOISE_FLOOR;
-  filter->block_score_for_row = &block_score_for_row_5_tap;
+  filter->comb_mask_for_line = &comb_mask_5_tap;
   filter->spatial_thresh = DEFAULT_SPATIAL_THRESH;
   filter->block_width = DEFAULT_BLOCK_WIDTH;
   filter->block_height = DEFAULT_BLOCK_HEIGHT;
   filter->block_thresh = DEFAULT_BLOCK_THRESH;
   filter->ignored_lines = DEFAULT_IGNORED_LINES;
+  filter->max_threads = DEFAULT_MAX_THREADS;
+  filter->decimation = DEFAULT_DECIMATION;
+  g_mutex_init (&filter->band_lock);
+  g_cond_init (&filter->band_cond);
 }
 
 static void
@@ -406,13 +470,13 @@ gst_field_analysis_set_property (GObject * object, guint prop_id,
     case PROP_COMB_METHOD:
       switch (g_value_get_enum (value)) {
         case METHOD_32DETECT:
-          filter->block_score_for_row = &block_score_for_row_32detect;
+          filter->comb_mask_for_line = &comb_mask_32detect;
           break;
         case METHOD_IS_COMBED:
-          filter->block_score_for_row = &block_score_for_row_iscombed;
+          filter->comb_mask_for_line = &comb_mask_iscombed;
           break;
         case METHOD_5_TAP:
-          filter->block_score_for_row = &block_score_for_row_5_tap;
+          filter->comb_mask_for_line = &comb_mask_5_tap;
           break;
         default:
           break;
@@ -423,18 +487,6 @@ gst_field_analysis_set_property (GObject * object, guint prop_id,
       break;
     case PROP_BLOCK_WIDTH:
       filter->block_width = g_value_get_uint64 (value);
-      if (GST_VIDEO_FRAME_WIDTH (&filter->frames[0].frame)) {
-        const gint frame_width =
-            GST_VIDEO_FRAME_WIDTH (&filter->frames[0].frame);
-        if (filter->block_scores) {
-          gsize nbytes = (frame_width / filter->block_width) * sizeof (guint);
-          filter->block_scores = g_realloc (filter->block_scores, nbytes);
-          memset (filter->block_scores, 0, nbytes);
-        } else {
-          filter->block_scores =
-              g_malloc0 ((frame_width / filter->block_width) * sizeof (guint));
-        }
-      }
       break;
     case PROP_BLOCK_HEIGHT:
       filter->block_height = g_value_get_uint64 (value);
@@ -445,6 +497,12 @@ gst_field_analysis_set_property (GObject * object, guint prop_id,
     case PROP_IGNORED_LINES:
       filter->ignored_lines = g_value_get_uint64 (value);
       break;
+    case PROP_MAX_THREADS:
+      filter->max_threads = g_value_get_int (value);
+      break;
+    case PROP_DECIMATION:
+      filter->decimation = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -494,11 +552,11 @@ gst_field_analysis_get_property (GObject * object, guint prop_id,
     case PROP_COMB_METHOD:
     {
       FieldAnalysisCombMethod method = DEFAULT_COMB_METHOD;
-      if (filter->block_score_for_row == &block_score_for_row_32detect) {
+      if (filter->comb_mask_for_line == &comb_mask_32detect) {
         method = METHOD_32DETECT;
-      } else if (filter->block_score_for_row == &block_score_for_row_iscombed) {
+      } else if (filter->comb_mask_for_line == &comb_mask_iscombed) {
         method = METHOD_IS_COMBED;
-      } else if (filter->block_score_for_row == &block_score_for_row_5_tap) {
+      } else if (filter->comb_mask_for_line == &comb_mask_5_tap) {
         method = METHOD_5_TAP;
       }
       g_value_set_enum (value, method);
@@ -519,6 +577,12 @@ gst_field_analysis_get_property (GObject * object, guint prop_id,
     case PROP_IGNORED_LINES:
       g_value_set_uint64 (value, filter->ignored_lines);
       break;
+    case PROP_MAX_THREADS:
+      g_value_set_int (value, filter->max_threads);
+      break;
+    case PROP_DECIMATION:
+      g_value_set_uint (value, filter->decimation);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -528,7 +592,6 @@ gst_field_analysis_get_property (GObject * object, guint prop_id,
 static void
 gst_field_analysis_update_format (GstFieldAnalysis * filter, GstCaps * caps)
 {
-  gint width;
   GQueue *outbufs;
   GstVideoInfo vinfo;
 
@@ -565,22 +628,6 @@ gst_field_analysis_update_format (GstFieldAnalysis * filter, GstCaps * caps)
   filter->flushing = FALSE;
 
   filter->vinfo = vinfo;
-  width = GST_VIDEO_INFO_WIDTH (&filter->vinfo);
-
-  /* update allocations for metric scores */
-  if (filter->comb_mask) {
-    filter->comb_mask = g_realloc (filter->comb_mask, width);
-  } else {
-    filter->comb_mask = g_malloc (width);
-  }
-  if (filter->block_scores) {
-    gsize nbytes = (width / filter->block_width) * sizeof (guint);
-    filter->block_scores = g_realloc (filter->block_scores, nbytes);
-    memset (filter->block_scores, 0, nbytes);
-  } else {
-    filter->block_scores =
-        g_malloc0 ((width / filter->block_width) * sizeof (guint));
-  }
 
   GST_OBJECT_UNLOCK (filter);
   return;
@@ -802,121 +849,188 @@ gst_field_analysis_sink_event (GstPad * pad, GstObject * parent,
 }
 
 
-static gfloat
-same_parity_sad (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+static inline guint8 *
+frame_line (GstVideoFrame * frame, gint line)
 {
-  gint j;
-  gfloat sum;
-  guint8 *f1j, *f2j;
+  return (guint8 *) GST_VIDEO_FRAME_COMP_DATA (frame, 0) +
+      GST_VIDEO_FRAME_COMP_OFFSET (frame, 0) +
+      line * GST_VIDEO_FRAME_COMP_STRIDE (frame, 0);
+}
 
-  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
+/* line j of the field with the given parity */
+static inline guint8 *
+field_line (FieldAnalysisFields * field, gint j)
+{
+  return frame_line (&field->frame, 2 * j + field->parity);
+}
+
+/* splits the n_rows rows of a metric, of which every step'th is analysed,
+ * into bands, analyses them in parallel and returns the sum or, if take_max
+ * is set, the maximum of the band results */
+static guint64
+gst_field_analysis_run_bands (GstFieldAnalysis * filter,
+    FieldAnalysisBandFunc func, FieldAnalysisFields (*history)[2],
+    guint n_rows, guint step, gboolean take_max)
+{
+  guint64 result;
+  guint i, n_bands;
+
+  n_bands = MIN (filter->n_threads, n_rows);
+  if (n_bands == 0)
+    return 0;
+
+  for (i = 0; i < n_bands; i++) {
+    FieldAnalysisBand *band = &filter->bands[i];
+
+    band->func = func;
+    band->history = history;
+    band->step = step;
+    band->first = (guint64) n_rows * i / n_bands;
+    band->last = (guint64) n_rows * (i + 1) / n_bands;
+    band->result = 0;
+  }
+
+  g_mutex_lock (&filter->band_lock);
+  filter->bands_pending = n_bands - 1;
+  g_mutex_unlock (&filter->band_lock);
+  for (i = 1; i < n_bands; i++)
+    g_thread_pool_push (filter->band_pool, &filter->bands[i], NULL);
+
+  filter->bands[0].result = func (filter, &filter->bands[0]);
+
+  if (n_bands > 1) {
+    g_mutex_lock (&filter->band_lock);
+    while (filter->bands_pending)
+      g_cond_wait (&filter->band_cond, &filter->band_lock);
+    g_mutex_unlock (&filter->band_lock);
+  }
+
+  result = filter->bands[0].result;
+  for (i = 1; i < n_bands; i++) {
+    if (!take_max)
+      result += filter->bands[i].result;
+    else if (filter->bands[i].result > result)
+      result = filter->bands[i].result;
+  }
+
+  return result;
+}
+
+static void
+gst_field_analysis_band_thread (gpointer data, gpointer user_data)
+{
+  GstFieldAnalysis *filter = user_data;
+  FieldAnalysisBand *band = data;
+
+  band->result = band->func (filter, band);
+
+  g_mutex_lock (&filter->band_lock);
+  if (--filter->bands_pending == 0)
+    g_cond_signal (&filter->band_cond);
+  g_mutex_unlock (&filter->band_lock);
+}
+
+/* number of field lines analysed by the field and frame metrics */
+static inline guint
+gst_field_analysis_n_field_rows (FieldAnalysisFields (*history)[2],
+    guint step)
+{
   const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride0x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const gint stride1x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0) << 1;
+
+  return ((height >> 1) + step - 1) / step;
+}
+
+static guint64
+same_parity_sad_band (GstFieldAnalysis * filter, FieldAnalysisBand * band)
+{
+  FieldAnalysisFields (*history)[2] = band->history;
+  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
   const guint32 noise_floor = filter->noise_floor;
+  guint64 sum = 0;
+  guint r;
 
-  f1j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame,
-      0) +
-      (*history)[0].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame,
-      0);
-  f2j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-      0) +
-      (*history)[1].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame,
-      0);
-
-  sum = 0.0f;
-  for (j = 0; j < (height >> 1); j++) {
+  for (r = band->first; r < band->last; r++) {
+    const gint j = r * band->step;
     guint32 tempsum = 0;
-    fieldanalysis_orc_same_parity_sad_planar_yuv (&tempsum, f1j, f2j,
+
+    fieldanalysis_orc_same_parity_sad_planar_yuv (&tempsum,
+        field_line (&(*history)[0], j), field_line (&(*history)[1], j),
         noise_floor, width);
     sum += tempsum;
-    f1j += stride0x2;
-    f2j += stride1x2;
   }
 
-  return sum / (0.5f * width * height);
+  return sum;
 }
 
 static gfloat
-same_parity_ssd (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+same_parity_sad (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
 {
-  gint j;
-  gfloat sum;
-  guint8 *f1j, *f2j;
+  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
+  const guint step = filter->decimation;
+  const guint n_rows = gst_field_analysis_n_field_rows (history, step);
+  guint64 sum;
 
+  sum = gst_field_analysis_run_bands (filter, same_parity_sad_band, history,
+      n_rows, step, FALSE);
+
+  return sum / ((gfloat) width * n_rows);
+}
+
+static guint64
+same_parity_ssd_band (GstFieldAnalysis * filter, FieldAnalysisBand * band)
+{
+  FieldAnalysisFields (*history)[2] = band->history;
   const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
-  const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride0x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const gint stride1x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0) << 1;
   /* noise floor needs to be squared for SSD */
   const guint32 noise_floor = filter->noise_floor * filter->noise_floor;
+  guint64 sum = 0;
+  guint r;
 
-  f1j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame,
-      0) +
-      (*history)[0].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame,
-      0);
-  f2j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-      0) +
-      (*history)[1].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame,
-      0);
-
-  sum = 0.0f;
-  for (j = 0; j < (height >> 1); j++) {
+  for (r = band->first; r < band->last; r++) {
+    const gint j = r * band->step;
     guint32 tempsum = 0;
-    fieldanalysis_orc_same_parity_ssd_planar_yuv (&tempsum, f1j, f2j,
+
+    fieldanalysis_orc_same_parity_ssd_planar_yuv (&tempsum,
+        field_line (&(*history)[0], j), field_line (&(*history)[1], j),
         noise_floor, width);
     sum += tempsum;
-    f1j += stride0x2;
-    f2j += stride1x2;
   }
 
-  return sum / (0.5f * width * height); /* field is half height */
+  return sum;
 }
 
-/* horizontal [1,4,1] diff between fields - is this a good idea or should the
- * current sample be emphasised more or less? */
 static gfloat
-same_parity_3_tap (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+same_parity_ssd (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
 {
-  gint i, j;
-  gfloat sum;
-  guint8 *f1j, *f2j;
+  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
+  const guint step = filter->decimation;
+  const guint n_rows = gst_field_analysis_n_field_rows (history, step);
+  guint64 sum;
 
+  sum = gst_field_analysis_run_bands (filter, same_parity_ssd_band, history,
+      n_rows, step, FALSE);
+
+  return sum / ((gfloat) width * n_rows);
+}
+
+/* horizontal [1,4,1] diff between fields - is this a good idea or should the
+ * current sample be emphasised more or less? */
+static guint64
+same_parity_3_tap_band (GstFieldAnalysis * filter, FieldAnalysisBand * band)
+{
+  FieldAnalysisFields (*history)[2] = band->history;
   const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
-  const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride0x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const gint stride1x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0) << 1;
   const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (&(*history)[0].frame, 0);
   /* noise floor needs to be *6 for [1,4,1] */
   const guint32 noise_floor = filter->noise_floor * 6;
-
-  f1j = GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame, 0) +
-      GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame, 0) +
-      (*history)[0].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame,
-      0);
-  f2j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-      0) +
-      (*history)[1].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame,
-      0);
-
-  sum = 0.0f;
-  for (j = 0; j < (height >> 1); j++) {
+  guint64 sum = 0;
+  guint r;
+
+  for (r = band->first; r < band->last; r++) {
+    const gint j = r * band->step;
+    const guint8 *f1j = field_line (&(*history)[0], j);
+    const guint8 *f2j = field_line (&(*history)[1], j);
+    const gint i = width - 1;
     guint32 tempsum = 0;
     guint32 diff;
 
@@ -932,456 +1046,384 @@ same_parity_3_tap (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
     sum += tempsum;
 
     /* unroll last as it is a special case */
-    i = width - 1;
     diff = abs (((f1j[i - incr] << 1) + (f1j[i] << 2))
         - ((f2j[i - incr] << 1) + (f2j[i] << 2)));
     if (diff > noise_floor)
       sum += diff;
-
-    f1j += stride0x2;
-    f2j += stride1x2;
   }
 
-  return sum / ((6.0f / 2.0f) * width * height);        /* 1 + 4 + 1 = 6; field is half height */
+  return sum;
 }
 
-/* vertical [1,-3,4,-3,1] - same as is used in FieldDiff from TIVTC,
- * tritical's AVISynth IVTC filter */
-/* 0th field's parity defines operation */
 static gfloat
-opposite_parity_5_tap (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2])
+same_parity_3_tap (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
 {
-  gint j;
-  gfloat sum;
-  guint8 *fjm2, *fjm1, *fj, *fjp1, *fjp2;
-  guint32 tempsum;
-
   const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
-  const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride0x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const gint stride1x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0) << 1;
+  const guint step = filter->decimation;
+  const guint n_rows = gst_field_analysis_n_field_rows (history, step);
+  guint64 sum;
+
+  sum = gst_field_analysis_run_bands (filter, same_parity_3_tap_band, history,
+      n_rows, step, FALSE);
+
+  return sum / (6.0f * width * n_rows); /* 1 + 4 + 1 = 6 */
+}
+
+/* the top and bottom field of the frame made from the 0th field and the
+ * opposite field of the 1st frame */
+static inline void
+opposite_parity_fields (FieldAnalysisFields (*history)[2],
+    FieldAnalysisFields * top, FieldAnalysisFields * bottom)
+{
+  if ((*history)[0].parity == TOP_FIELD) {
+    top->frame = (*history)[0].frame;
+    bottom->frame = (*history)[1].frame;
+  } else {
+    top->frame = (*history)[1].frame;
+    bottom->frame = (*history)[0].frame;
+  }
+  top->parity = TOP_FIELD;
+  bottom->parity = BOTTOM_FIELD;
+}
+
+/* vertical [1,-3,4,-3,1] - same as is used in FieldDiff from TIVTC,
+ * tritical's AVISynth IVTC filter */
+static guint64
+opposite_parity_5_tap_band (GstFieldAnalysis * filter,
+    FieldAnalysisBand * band)
+{
+  FieldAnalysisFields top, bottom;
+  const gint width = GST_VIDEO_FRAME_WIDTH (&(*band->history)[0].frame);
+  const gint n_lines =
+      GST_VIDEO_FRAME_HEIGHT (&(*band->history)[0].frame) >> 1;
   /* noise floor needs to be *6 for [1,-3,4,-3,1] */
   const guint32 noise_floor = filter->noise_floor * 6;
+  guint64 sum = 0;
+  guint r;
 
-  sum = 0.0f;
+  opposite_parity_fields (band->history, &top, &bottom);
 
   /* fj is line j of the combined frame made from the top field even lines of
    *   field 0 and the bottom field odd lines from field 1
    * fjp1 is one line down from fj
    * fjm2 is two lines up from fj
-   * fj with j == 0 is the 0th line of the top field
-   * fj with j == 1 is the 0th line of the bottom field or the 1st field of
-   *   the frame*/
-
-  /* unroll first line as it is a special case */
-  if ((*history)[0].parity == TOP_FIELD) {
-    fj = GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame, 0);
-    fjp1 =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0);
-    fjp2 = fj + stride0x2;
-  } else {
-    fj = GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame, 0);
-    fjp1 =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0);
-    fjp2 = fj + stride1x2;
-  }
+   * the first and last lines are special cases that mirror the lines
+   *   around them */
+  for (r = band->first; r < band->last; r++) {
+    const gint j = r * band->step;
+    guint8 *fjm2, *fjm1, *fj, *fjp1, *fjp2;
+    guint32 tempsum = 0;
 
-  tempsum = 0;
-  fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjp2, fjp1, fj,
-      fjp1, fjp2, noise_floor, width);
-  sum += tempsum;
-
-  for (j = 1; j < (height >> 1) - 1; j++) {
-    /* shift everything down a line in the field of interest (means += stridex2) */
-    fjm2 = fj;
-    fjm1 = fjp1;
-    fj = fjp2;
-    if ((*history)[0].parity == TOP_FIELD) {
-      fjp1 += stride1x2;
-      fjp2 += stride0x2;
+    fj = field_line (&top, j);
+    if (j == 0) {
+      fjm2 = fjp2 = field_line (&top, 1);
+      fjm1 = fjp1 = field_line (&bottom, 0);
+    } else if (j == n_lines - 1) {
+      fjm2 = fjp2 = field_line (&top, j - 1);
+      fjm1 = fjp1 = field_line (&bottom, j - 1);
     } else {
-      fjp1 += stride0x2;
-      fjp2 += stride1x2;
+      fjm2 = field_line (&top, j - 1);
+      fjm1 = field_line (&bottom, j - 1);
+      fjp1 = field_line (&bottom, j);
+      fjp2 = field_line (&top, j + 1);
     }
 
-    tempsum = 0;
     fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjm2, fjm1,
         fj, fjp1, fjp2, noise_floor, width);
     sum += tempsum;
   }
 
-  /* unroll the last line as it is a special case */
-  /* shift everything down a line in the field of interest (means += stridex2) */
-  fjm2 = fj;
-  fjm1 = fjp1;
-  fj = fjp2;
+  return sum;
+}
 
-  tempsum = 0;
-  fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjm2, fjm1, fj,
-      fjm1, fjm2, noise_floor, width);
-  sum += tempsum;
+/* 0th field's parity defines operation */
+static gfloat
+opposite_parity_5_tap (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2])
+{
+  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
+  const guint step = filter->decimation;
+  const guint n_rows = gst_field_analysis_n_field_rows (history, step);
+  guint64 sum;
+
+  sum = gst_field_analysis_run_bands (filter, opposite_parity_5_tap_band,
+      history, n_rows, step, FALSE);
 
-  return sum / ((6.0f / 2.0f) * width * height);        /* 1 + 4 + 1 == 3 + 3 == 6; field is half height */
+  return sum / (6.0f * width * n_rows); /* 1 + 4 + 1 == 3 + 3 == 6 */
 }
 
-/* this metric was sourced from HandBrake but originally from transcode
- * the return value is the highest block score for the row of blocks */
-static inline guint64
-block_score_for_row_32detect (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1)
+/* the comb masks are computed branch-free, one byte per sample, so that the
+ * compiler can vectorise them. thresh is clamped to what 8-bit samples can
+ * reach, so it fits in a gint */
+
+/* change in the same direction compared to both neighbours in the other
+ * field */
+#define SAME_DIRECTION(c,u,d,t) \
+  ((((c) - (u) > (t)) & ((c) - (d) > (t))) | \
+   (((c) - (u) < -(t)) & ((c) - (d) < -(t))))
+
+/* this metric was sourced from HandBrake but originally from transcode */
+static inline void
+comb_mask_32detect_stride (guint8 * mask, const guint8 * fjm2,
+    const guint8 * fjm1, const guint8 * fj, const guint8 * fjp1,
+    const guint8 * fjp2, gint incr, gint width, gint thresh)
 {
-  guint64 i, j;
-  guint8 *comb_mask = filter->comb_mask;
-  guint *block_scores = filter->block_scores;
-  guint64 block_score;
-  guint8 *fjm2, *fjm1, *fj, *fjp1;
-  const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (&(*history)[0].frame, 0);
-  const gint stridex2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const guint64 block_width = filter->block_width;
-  const guint64 block_height = filter->block_height;
-  const gint64 spatial_thresh = filter->spatial_thresh;
-  const gint width =
-      GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) -
-      (GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) % block_width);
-
-  fjm2 = base_fj - stridex2;
-  fjm1 = base_fjp1 - stridex2;
-  fj = base_fj;
-  fjp1 = base_fjp1;
-
-  for (j = 0; j < block_height; j++) {
-    /* we have to work one result ahead of ourselves which results in some small
-     * peculiarities below */
-    gint diff1, diff2;
-
-    diff1 = fj[0] - fjm1[0];
-    diff2 = fj[0] - fjp1[0];
-    /* change in the same direction */
-    if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-        || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-      comb_mask[0] = abs (fj[0] - fjm2[0]) < 10 && abs (fj[0] - fjm1[0]) > 15;
-    } else {
-      comb_mask[0] = FALSE;
-    }
+  gint i;
 
-    for (i = 1; i < width; i++) {
-      const guint64 idx = i * incr;
-      const guint64 res_idx = (i - 1) / block_width;
+  for (i = 0; i < width; i++) {
+    const gint c = fj[i * incr], u = fjm1[i * incr], d = fjp1[i * incr];
 
-      diff1 = fj[idx] - fjm1[idx];
-      diff2 = fj[idx] - fjp1[idx];
-      if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-          || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-        comb_mask[i] = abs (fj[idx] - fjm2[idx]) < 10
-            && abs (fj[idx] - fjm1[idx]) > 15;
-      } else {
-        comb_mask[i] = FALSE;
-      }
+    mask[i] = SAME_DIRECTION (c, u, d, thresh)
+        & (abs (c - fjm2[i * incr]) < 10) & (abs (c - u) > 15);
+  }
+}
 
-      if (i == 1 && comb_mask[i - 1] && comb_mask[i]) {
-        /* left edge */
-        block_scores[res_idx]++;
-      } else if (i == width - 1) {
-        /* right edge */
-        if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i])
-          block_scores[res_idx]++;
-        if (comb_mask[i - 1] && comb_mask[i])
-          block_scores[i / block_width]++;
-      } else if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i]) {
-        block_scores[res_idx]++;
-      }
-    }
-    /* advance down a line */
-    fjm2 = fjm1;
-    fjm1 = fj;
-    fj = fjp1;
-    fjp1 = fjm1 + stridex2;
+/* this metric was sourced from HandBrake but originally from
+ * tritical's isCombedT Avisynth function */
+static inline void
+comb_mask_iscombed_stride (guint8 * mask, const guint8 * fjm2,
+    const guint8 * fjm1, const guint8 * fj, const guint8 * fjp1,
+    const guint8 * fjp2, gint incr, gint width, gint thresh)
+{
+  const gint thresh_squared = thresh * thresh;
+  gint i;
+
+  for (i = 0; i < width; i++) {
+    const gint c = fj[i * incr], u = fjm1[i * incr], d = fjp1[i * incr];
+
+    mask[i] = SAME_DIRECTION (c, u, d, thresh)
+        & ((u - c) * (d - c) > thresh_squared);
   }
+}
 
-  block_score = 0;
-  for (i = 0; i < width / block_width; i++) {
-    if (block_scores[i] > block_score)
-      block_score = block_scores[i];
+/* this metric was sourced from HandBrake but originally from
+ * tritical's isCombedT Avisynth function */
+static inline void
+comb_mask_5_tap_stride (guint8 * mask, const guint8 * fjm2,
+    const guint8 * fjm1, const guint8 * fj, const guint8 * fjp1,
+    const guint8 * fjp2, gint incr, gint width, gint thresh)
+{
+  const gint threshx6 = 6 * thresh;
+  gint i;
+
+  /* motion detection that needs previous and next frames
+     this isn't really necessary, but acts as an optimisation if the
+     additional delay isn't a problem
+     if (motion_detection) {
+     if (abs(fpj[idx] - fj[idx]               ) > motion_thresh &&
+     abs(           fjm1[idx] - fnjm1[idx]) > motion_thresh &&
+     abs(           fjp1[idx] - fnjp1[idx]) > motion_thresh)
+     motion++;
+     if (abs(             fj[idx]   - fnj[idx]) > motion_thresh &&
+     abs(fpjm1[idx] - fjm1[idx]           ) > motion_thresh &&
+     abs(fpjp1[idx] - fjp1[idx]           ) > motion_thresh)
+     motion++;
+     } else {
+     motion = 1;
+     }
+   */
+  for (i = 0; i < width; i++) {
+    const gint c = fj[i * incr], u = fjm1[i * incr], d = fjp1[i * incr];
+
+    mask[i] = SAME_DIRECTION (c, u, d, thresh)
+        & (abs (fjm2[i * incr] + (c << 2) + fjp2[i * incr] - 3 * (u + d)) >
+        threshx6);
   }
+}
 
-  g_free (block_scores);
-  g_free (comb_mask);
-  return block_score;
+/* planar formats get their own unit stride loop */
+#define COMB_MASK_FOR_STRIDE(func) G_STMT_START { \
+  if (incr == 1) \
+    func (mask, fjm2, fjm1, fj, fjp1, fjp2, 1, width, thresh); \
+  else \
+    func (mask, fjm2, fjm1, fj, fjp1, fjp2, incr, width, thresh); \
+} G_STMT_END
+
+static void
+comb_mask_32detect (guint8 * mask, const guint8 * fjm2, const guint8 * fjm1,
+    const guint8 * fj, const guint8 * fjp1, const guint8 * fjp2, gint incr,
+    gint width, gint thresh)
+{
+  COMB_MASK_FOR_STRIDE (comb_mask_32detect_stride);
 }
 
-/* this metric was sourced from HandBrake but originally from
- * tritical's isCombedT Avisynth function
- * the return value is the highest block score for the row of blocks */
-static inline guint64
-block_score_for_row_iscombed (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1)
+static void
+comb_mask_iscombed (guint8 * mask, const guint8 * fjm2, const guint8 * fjm1,
+    const guint8 * fj, const guint8 * fjp1, const guint8 * fjp2, gint incr,
+    gint width, gint thresh)
 {
-  guint64 i, j;
-  guint8 *comb_mask = filter->comb_mask;
-  guint *block_scores = filter->block_scores;
-  guint64 block_score;
-  guint8 *fjm1, *fj, *fjp1;
-  const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (&(*history)[0].frame, 0);
-  const gint stridex2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
+  COMB_MASK_FOR_STRIDE (comb_mask_iscombed_stride);
+}
+
+static void
+comb_mask_5_tap (guint8 * mask, const guint8 * fjm2, const guint8 * fjm1,
+    const guint8 * fj, const guint8 * fjp1, const guint8 * fjp2, gint incr,
+    gint width, gint thresh)
+{
+  COMB_MASK_FOR_STRIDE (comb_mask_5_tap_stride);
+}
+
+#undef COMB_MASK_FOR_STRIDE
+#undef SAME_DIRECTION
+
+/* line of the combined frame made from the top field of the 0th frame and
+ * the bottom field of the 1st frame, lines outside of the frame are mirrored
+ * within the same field
+ *
+ * the field is chosen by the parity of the frame line. this used to be
+ * relative to the first line of the row of blocks, so with an odd number of
+ * ignored lines or an odd block height, rows starting on an odd line took
+ * their even lines from the bottom field and were scored differently */
+static inline guint8 *
+combined_line (FieldAnalysisFields * top, FieldAnalysisFields * bottom,
+    gint line, gint height)
+{
+  while (line >= height)
+    line -= 2;
+
+  return frame_line (line & 1 ? &bottom->frame : &top->frame, line);
+}
+
+/* if the samples to the left and right are combed, they contribute to the
+ * block score. the return value is the highest block score for the row of
+ * blocks starting at line */
+static guint
+block_score_for_row (GstFieldAnalysis * filter, FieldAnalysisBand * band,
+    FieldAnalysisFields * top, FieldAnalysisFields * bottom, gint line)
+{
+  const GstVideoFrame *frame = &(*band->history)[0].frame;
+  const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, 0);
+  const gint height = GST_VIDEO_FRAME_HEIGHT (frame);
   const guint64 block_width = filter->block_width;
-  const guint64 block_height = filter->block_height;
-  const gint64 spatial_thresh = filter->spatial_thresh;
-  const gint64 spatial_thresh_squared = spatial_thresh * spatial_thresh;
-  const gint width =
-      GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) -
-      (GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) % block_width);
-
-  fjm1 = base_fjp1 - stridex2;
-  fj = base_fj;
-  fjp1 = base_fjp1;
-
-  for (j = 0; j < block_height; j++) {
-    /* we have to work one result ahead of ourselves which results in some small
-     * peculiarities below */
-    gint diff1, diff2;
-
-    diff1 = fj[0] - fjm1[0];
-    diff2 = fj[0] - fjp1[0];
-    /* change in the same direction */
-    if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-        || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-      comb_mask[0] =
-          (fjm1[0] - fj[0]) * (fjp1[0] - fj[0]) > spatial_thresh_squared;
-    } else {
-      comb_mask[0] = FALSE;
-    }
+  const gint thresh = CLAMP (filter->spatial_thresh, 0, 256);
+  const gint width = GST_VIDEO_FRAME_WIDTH (frame) -
+      (GST_VIDEO_FRAME_WIDTH (frame) % block_width);
+  const gsize n_blocks = width / block_width;
+  guint8 *comb_mask;
+  guint *block_scores;
+  guint block_score;
+  guint64 b;
+  gint i, j;
 
-    for (i = 1; i < width; i++) {
-      const guint64 idx = i * incr;
-      const guint64 res_idx = (i - 1) / block_width;
-
-      diff1 = fj[idx] - fjm1[idx];
-      diff2 = fj[idx] - fjp1[idx];
-      if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-          || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-        comb_mask[i] =
-            (fjm1[idx] - fj[idx]) * (fjp1[idx] - fj[idx]) >
-            spatial_thresh_squared;
-      } else {
-        comb_mask[i] = FALSE;
-      }
+  if (width < 3)
+    return 0;
 
-      if (i == 1 && comb_mask[i - 1] && comb_mask[i]) {
-        /* left edge */
-        block_scores[res_idx]++;
-      } else if (i == width - 1) {
-        /* right edge */
-        if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i])
-          block_scores[res_idx]++;
-        if (comb_mask[i - 1] && comb_mask[i])
-          block_scores[i / block_width]++;
-      } else if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i]) {
-        block_scores[res_idx]++;
-      }
+  if (band->comb_mask_size < (gsize) width) {
+    band->comb_mask = g_realloc (band->comb_mask, width);
+    band->comb_mask_size = width;
+  }
+  if (band->n_block_scores < n_blocks) {
+    band->block_scores = g_renew (guint, band->block_scores, n_blocks);
+    band->n_block_scores = n_blocks;
+  }
+  comb_mask = band->comb_mask;
+  block_scores = band->block_scores;
+  memset (block_scores, 0, n_blocks * sizeof (guint));
+
+  for (j = line; j < line + (gint) filter->block_height; j++) {
+    filter->comb_mask_for_line (comb_mask,
+        combined_line (top, bottom, j - 2, height),
+        combined_line (top, bottom, j - 1, height),
+        combined_line (top, bottom, j, height),
+        combined_line (top, bottom, j + 1, height),
+        combined_line (top, bottom, j + 2, height), incr, width, thresh);
+
+    /* left edge */
+    if (comb_mask[0] && comb_mask[1])
+      block_scores[0]++;
+
+    /* three combed samples in a row count for the block of the middle one */
+    for (b = 0, i = 2; b < n_blocks; b++) {
+      const gint end = MIN ((b + 1) * block_width + 1, (guint64) width - 1);
+      guint score = 0;
+
+      for (; i < end; i++)
+        score += comb_mask[i - 2] & comb_mask[i - 1] & comb_mask[i];
+      block_scores[b] += score;
     }
-    /* advance down a line */
-    fjm1 = fj;
-    fj = fjp1;
-    fjp1 = fjm1 + stridex2;
+
+    /* right edge */
+    i = width - 1;
+    if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i])
+      block_scores[(i - 1) / block_width]++;
+    if (comb_mask[i - 1] && comb_mask[i])
+      block_scores[i / block_width]++;
   }
 
   block_score = 0;
-  for (i = 0; i < width / block_width; i++) {
-    if (block_scores[i] > block_score)
-      block_score = block_scores[i];
+  for (b = 0; b < n_blocks; b++) {
+    if (block_scores[b] > block_score)
+      block_score = block_scores[b];
   }
 
-  g_free (block_scores);
-  g_free (comb_mask);
   return block_score;
 }
 
-/* this metric was sourced from HandBrake but originally from
- * tritical's isCombedT Avisynth function
- * the return value is the highest block score for the row of blocks */
-static inline guint64
-block_score_for_row_5_tap (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1)
+/* returns 2 if a block in the band is combed, 1 if one is slightly combed
+ * and 0 otherwise */
+static guint64
+opposite_parity_windowed_comb_band (GstFieldAnalysis * filter,
+    FieldAnalysisBand * band)
 {
-  guint64 i, j;
-  guint8 *comb_mask = filter->comb_mask;
-  guint *block_scores = filter->block_scores;
-  guint64 block_score;
-  guint8 *fjm2, *fjm1, *fj, *fjp1, *fjp2;
-  const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (&(*history)[0].frame, 0);
-  const gint stridex2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const guint64 block_width = filter->block_width;
-  const guint64 block_height = filter->block_height;
-  const gint64 spatial_thresh = filter->spatial_thresh;
-  const gint64 spatial_threshx6 = 6 * spatial_thresh;
-  const gint width =
-      GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) -
-      (GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) % block_width);
-
-
-  fjm2 = base_fj - stridex2;
-  fjm1 = base_fjp1 - stridex2;
-  fj = base_fj;
-  fjp1 = base_fjp1;
-  fjp2 = fj + stridex2;
-
-  for (j = 0; j < block_height; j++) {
-    /* we have to work one result ahead of ourselves which results in some small
-     * peculiarities below */
-    gint diff1, diff2;
-
-    diff1 = fj[0] - fjm1[0];
-    diff2 = fj[0] - fjp1[0];
-    /* change in the same direction */
-    if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-        || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-      comb_mask[0] =
-          abs (fjm2[0] + (fj[0] << 2) + fjp2[0] - 3 * (fjm1[0] + fjp1[0])) >
-          spatial_threshx6;
-
-      /* motion detection that needs previous and next frames
-         this isn't really necessary, but acts as an optimisation if the
-         additional delay isn't a problem
-         if (motion_detection) {
-         if (abs(fpj[idx] - fj[idx]               ) > motion_thresh &&
-         abs(           fjm1[idx] - fnjm1[idx]) > motion_thresh &&
-         abs(           fjp1[idx] - fnjp1[idx]) > motion_thresh)
-         motion++;
-         if (abs(             fj[idx]   - fnj[idx]) > motion_thresh &&
-         abs(fpjm1[idx] - fjm1[idx]           ) > motion_thresh &&
-         abs(fpjp1[idx] - fjp1[idx]           ) > motion_thresh)
-         motion++;
-         } else {
-         motion = 1;
-         }
-       */
-    } else {
-      comb_mask[0] = FALSE;
-    }
+  FieldAnalysisFields top, bottom;
+  const guint64 block_thresh = filter->block_thresh;
+  guint64 result = 0;
+  guint r;
 
-    for (i = 1; i < width; i++) {
-      const guint64 idx = i * incr;
-      const guint64 res_idx = (i - 1) / block_width;
-
-      diff1 = fj[idx] - fjm1[idx];
-      diff2 = fj[idx] - fjp1[idx];
-      if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-          || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-        comb_mask[i] =
-            abs (fjm2[idx] + (fj[idx] << 2) + fjp2[idx] - 3 * (fjm1[idx] +
-                fjp1[idx])) > spatial_threshx6;
-      } else {
-        comb_mask[i] = FALSE;
-      }
+  opposite_parity_fields (band->history, &top, &bottom);
 
-      if (i == 1 && comb_mask[i - 1] && comb_mask[i]) {
-        /* left edge */
-        block_scores[res_idx]++;
-      } else if (i == width - 1) {
-        /* right edge */
-        if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i])
-          block_scores[res_idx]++;
-        if (comb_mask[i - 1] && comb_mask[i])
-          block_scores[i / block_width]++;
-      } else if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i]) {
-        block_scores[res_idx]++;
-      }
-    }
-    /* advance down a line */
-    fjm2 = fjm1;
-    fjm1 = fj;
-    fj = fjp1;
-    fjp1 = fjp2;
-    fjp2 = fj + stridex2;
-  }
+  for (r = band->first; r < band->last; r++) {
+    const gint line =
+        filter->ignored_lines + r * band->step * filter->block_height;
+    guint block_score =
+        block_score_for_row (filter, band, &top, &bottom, line);
 
-  block_score = 0;
-  for (i = 0; i < width / block_width; i++) {
-    if (block_scores[i] > block_score)
-      block_score = block_scores[i];
+    if (block_score > block_thresh) {
+      return 2;
+    } else if (block_score > (block_thresh >> 1)) {
+      /* blend if nothing more combed comes along */
+      result = 1;
+    }
   }
 
-  g_free (block_scores);
-  g_free (comb_mask);
-  return block_score;
+  return result;
 }
 
 /* a pass is made over the field using one of three comb-detection metrics
-   and the results are then analysed block-wise. if the samples to the left
-   and right are combed, they contribute to the block score. if the block
-   score is above the given threshold, the frame is combed. if the block
-   score is between half the threshold and the threshold, the block is
-   slightly combed. if when analysis is complete, slight combing is detected
-   that is returned. if any results are observed that are above the threshold,
-   the function returns immediately */
+   and the results are then analysed block-wise. if the block score is above
+   the given threshold, the frame is combed. if the block score is between
+   half the threshold and the threshold, the block is slightly combed. if when
+   analysis is complete, slight combing is detected that is returned. */
 /* 0th field's parity defines operation */
 static gfloat
 opposite_parity_windowed_comb (GstFieldAnalysis * filter,
     FieldAnalysisFields (*history)[2])
 {
-  gint j;
-  gboolean slightly_combed;
-
   const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride = GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0);
-  const guint64 block_thresh = filter->block_thresh;
   const guint64 block_height = filter->block_height;
-  guint8 *base_fj, *base_fjp1;
-
-  if ((*history)[0].parity == TOP_FIELD) {
-    base_fj =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame, 0);
-    base_fjp1 =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0);
-  } else {
-    base_fj =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame, 0);
-    base_fjp1 =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0);
+  const guint step = filter->decimation;
+  guint n_rows = 0;
+  guint64 combed;
+
+  /* we operate on a row of blocks of height block_height in each band row */
+  if (block_height > 0
+      && (guint64) height >= filter->ignored_lines + block_height) {
+    n_rows = (height - filter->ignored_lines - block_height) / block_height + 1;
+    n_rows = (n_rows + step - 1) / step;
   }
 
-  /* we operate on a row of blocks of height block_height through each iteration */
-  slightly_combed = FALSE;
-  for (j = 0; j <= height - filter->ignored_lines - block_height;
-      j += block_height) {
-    guint64 line_offset = (filter->ignored_lines + j) * stride;
-    guint block_score =
-        filter->block_score_for_row (filter, history, base_fj + line_offset,
-        base_fjp1 + line_offset);
+  combed = gst_field_analysis_run_bands (filter,
+      opposite_parity_windowed_comb_band, history, n_rows, step, TRUE);
 
-    if (block_score > (block_thresh >> 1)
-        && block_score <= block_thresh) {
-      /* blend if nothing more combed comes along */
-      slightly_combed = TRUE;
-    } else if (block_score > block_thresh) {
-      if (GST_VIDEO_INFO_INTERLACE_MODE (&(*history)[0].frame.info) ==
-          GST_VIDEO_INTERLACE_MODE_INTERLEAVED) {
-        return 1.0f;            /* blend */
-      } else {
-        return 2.0f;            /* deinterlace */
-      }
-    }
-  }
+  if (combed < 2)
+    return (gfloat) combed;     /* TRUE means blend, else don't */
 
-  return (gfloat) slightly_combed;      /* TRUE means blend, else don't */
+  if (GST_VIDEO_INFO_INTERLACE_MODE (&(*history)[0].frame.info) ==
+      GST_VIDEO_INTERLACE_MODE_INTERLEAVED) {
+    return 1.0f;                /* blend */
+  } else {
+    return 2.0f;                /* deinterlace */
+  }
 }
 
 /* this is where the magic happens
@@ -1800,6 +1842,7 @@ gst_field_analysis_change_state (GstElement * element,
     case GST_STATE_CHANGE_NULL_TO_READY:
       break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_field_analysis_start (filter);
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
       break;
@@ -1816,6 +1859,7 @@ gst_field_analysis_change_state (GstElement * element,
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       gst_field_analysis_reset (filter);
+      gst_field_analysis_stop (filter);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
     default:
@@ -1831,6 +1875,9 @@ gst_field_analysis_finalize (GObject * object)
   GstFieldAnalysis *filter = GST_FIELDANALYSIS (object);
 
   gst_field_analysis_reset (filter);
+  gst_field_analysis_stop (filter);
+  g_mutex_clear (&filter->band_lock);
+  g_cond_clear (&filter->band_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
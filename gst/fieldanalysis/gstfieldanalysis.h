@@ -63,6 +63,7 @@ typedef struct _GstFieldAnalysisClass GstFieldAnalysisClass;
 typedef struct _FieldAnalysisFields FieldAnalysisFields;
 typedef struct _FieldAnalysisHistory FieldAnalysisHistory;
 typedef struct _FieldAnalysis FieldAnalysis;
+typedef struct _FieldAnalysisBand FieldAnalysisBand;
 
 typedef enum
 {
@@ -101,6 +102,30 @@ struct _FieldAnalysisHistory
   FieldAnalysis results;
 };
 
+/* a band of rows of one metric, analysed in the streaming thread or in one of
+ * the band threads */
+typedef guint64 (*FieldAnalysisBandFunc) (GstFieldAnalysis *,
+    FieldAnalysisBand *);
+
+struct _FieldAnalysisBand
+{
+  FieldAnalysisBandFunc func;
+  FieldAnalysisFields (*history)[2];
+  /* rows to analyse, in units of the metric (field lines or block rows), of
+   * which every step'th is analysed */
+  guint first, last, step;
+  guint64 result;
+
+  /* scratch space for windowed comb detection */
+  guint8 *comb_mask;
+  guint *block_scores;
+  gsize comb_mask_size, n_block_scores;
+};
+
+typedef void (*FieldAnalysisCombMask) (guint8 *, const guint8 *,
+    const guint8 *, const guint8 *, const guint8 *, const guint8 *, gint,
+    gint, gint);
+
 typedef enum
 {
   METHOD_32DETECT,
@@ -119,12 +144,10 @@ struct _GstFieldAnalysis
   GstVideoInfo vinfo;
   gfloat (*same_field) (GstFieldAnalysis *, FieldAnalysisFields (*)[2]);
   gfloat (*same_frame) (GstFieldAnalysis *, FieldAnalysisFields (*)[2]);
-  guint64 (*block_score_for_row) (GstFieldAnalysis *, FieldAnalysisFields (*)[2], guint8 *, guint8 *);
+  FieldAnalysisCombMask comb_mask_for_line;
   gboolean is_telecine;
   gboolean first_buffer; /* indicates the first buffer for which a buffer will be output
                           * after a discont or flushing seek */
-  guint8 *comb_mask;
-  guint *block_scores;
   gboolean flushing;     /* indicates whether we are flushing or not */
 
   /* properties */
@@ -135,6 +158,17 @@ struct _GstFieldAnalysis
   guint64 block_width, block_height; /* width/height of window used for comb clusted detection */
   guint64 block_thresh;
   guint64 ignored_lines;
+  gint max_threads;
+  guint decimation; /* analyse every decimation'th row */
+
+  /* row bands, the first one is analysed in the streaming thread and the
+   * others in band_pool */
+  guint n_threads;
+  FieldAnalysisBand *bands;
+  GThreadPool *band_pool;
+  GMutex band_lock;
+  GCond band_cond;
+  guint bands_pending;   /* protected by band_lock */
 };
 
 struct _GstFieldAnalysisClass
@@ -130,7 +130,6 @@ static void
 gst_inter_audio_sink_init (GstInterAudioSink * interaudiosink)
 {
   interaudiosink->channel = g_strdup (DEFAULT_CHANNEL);
-  interaudiosink->input_adapter = gst_adapter_new ();
 }
 
 void
@@ -173,7 +172,6 @@ gst_inter_audio_sink_finalize (GObject * object)
 
   /* clean up object here */
   g_free (interaudiosink->channel);
-  gst_object_unref (interaudiosink->input_adapter);
 
   G_OBJECT_CLASS (gst_inter_audio_sink_parent_class)->finalize (object);
 }
@@ -226,14 +224,80 @@ gst_inter_audio_sink_stop (GstBaseSink * sink)
   GST_DEBUG_OBJECT (interaudiosink, "stop");
 
   g_mutex_lock (&interaudiosink->surface->mutex);
-  gst_adapter_clear (interaudiosink->surface->audio_adapter);
+  if (interaudiosink->surface->audio_ring == interaudiosink->ring) {
+    if (interaudiosink->surface->audio_ring)
+      gst_inter_audio_ring_unref (interaudiosink->surface->audio_ring);
+    interaudiosink->surface->audio_ring = NULL;
+  }
   memset (&interaudiosink->surface->audio_info, 0, sizeof (GstAudioInfo));
+  g_atomic_int_inc (&interaudiosink->surface->audio_cookie);
   g_mutex_unlock (&interaudiosink->surface->mutex);
 
   gst_inter_surface_unref (interaudiosink->surface);
   interaudiosink->surface = NULL;
 
-  gst_adapter_clear (interaudiosink->input_adapter);
+  if (interaudiosink->ring) {
+    gst_inter_audio_ring_unref (interaudiosink->ring);
+    interaudiosink->ring = NULL;
+  }
+
+  return TRUE;
+}
+
+/* Updates the period size from the surface and (re)creates the ring if there
+ * is none yet for the current format or if it is too small for the
+ * buffer-time of the source */
+static gboolean
+gst_inter_audio_sink_update_ring (GstInterAudioSink * interaudiosink)
+{
+  GstInterSurface *surface = interaudiosink->surface;
+  guint64 period_time, buffer_time;
+  guint64 period_samples, buffer_samples;
+  guint bpf = interaudiosink->info.bpf;
+  guint size;
+
+  g_mutex_lock (&surface->mutex);
+  interaudiosink->cookie = g_atomic_int_get (&surface->audio_cookie);
+
+  buffer_time = surface->audio_buffer_time;
+  period_time = surface->audio_period_time;
+
+  if (buffer_time < period_time) {
+    GST_ERROR_OBJECT (interaudiosink,
+        "Buffer time smaller than period time (%" GST_TIME_FORMAT " < %"
+        GST_TIME_FORMAT ")", GST_TIME_ARGS (buffer_time),
+        GST_TIME_ARGS (period_time));
+    g_mutex_unlock (&surface->mutex);
+    return FALSE;
+  }
+
+  buffer_samples =
+      gst_util_uint64_scale (buffer_time, interaudiosink->info.rate,
+      GST_SECOND);
+  period_samples =
+      gst_util_uint64_scale (period_time, interaudiosink->info.rate,
+      GST_SECOND);
+  interaudiosink->period_size = period_samples * bpf;
+
+  /* the source trims to buffer-time itself, leave room for one more period
+   * that might still be uncommitted */
+  size = (buffer_samples + 2 * period_samples) * bpf;
+
+  if (!interaudiosink->ring
+      || interaudiosink->ring->size - interaudiosink->ring->size % bpf < size) {
+    GST_DEBUG_OBJECT (interaudiosink, "creating ring for %u bytes", size);
+
+    if (interaudiosink->ring)
+      gst_inter_audio_ring_unref (interaudiosink->ring);
+    interaudiosink->ring = gst_inter_audio_ring_new (bpf, size);
+    interaudiosink->write_pos = interaudiosink->commit_pos = 0;
+
+    if (surface->audio_ring)
+      gst_inter_audio_ring_unref (surface->audio_ring);
+    surface->audio_ring = gst_inter_audio_ring_ref (interaudiosink->ring);
+    interaudiosink->cookie = g_atomic_int_add (&surface->audio_cookie, 1) + 1;
+  }
+  g_mutex_unlock (&surface->mutex);
 
   return TRUE;
 }
@@ -252,11 +316,15 @@ gst_inter_audio_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
   g_mutex_lock (&interaudiosink->surface->mutex);
   interaudiosink->surface->audio_info = info;
   interaudiosink->info = info;
-  /* TODO: Ideally we would drain the source here */
-  gst_adapter_clear (interaudiosink->surface->audio_adapter);
   g_mutex_unlock (&interaudiosink->surface->mutex);
 
-  return TRUE;
+  /* TODO: Ideally we would drain the source here */
+  if (interaudiosink->ring) {
+    gst_inter_audio_ring_unref (interaudiosink->ring);
+    interaudiosink->ring = NULL;
+  }
+
+  return gst_inter_audio_sink_update_ring (interaudiosink);
 }
 
 static gboolean
@@ -265,18 +333,14 @@ gst_inter_audio_sink_event (GstBaseSink * sink, GstEvent * event)
   GstInterAudioSink *interaudiosink = GST_INTER_AUDIO_SINK (sink);
 
   switch (GST_EVENT_TYPE (event)) {
-    case GST_EVENT_EOS:{
-      GstBuffer *tmp;
-      guint n;
-
-      if ((n = gst_adapter_available (interaudiosink->input_adapter)) > 0) {
-        g_mutex_lock (&interaudiosink->surface->mutex);
-        tmp = gst_adapter_take_buffer (interaudiosink->input_adapter, n);
-        gst_adapter_push (interaudiosink->surface->audio_adapter, tmp);
-        g_mutex_unlock (&interaudiosink->surface->mutex);
+    case GST_EVENT_EOS:
+      if (interaudiosink->ring
+          && interaudiosink->write_pos != interaudiosink->commit_pos) {
+        gst_inter_audio_ring_commit (interaudiosink->ring,
+            interaudiosink->write_pos);
+        interaudiosink->commit_pos = interaudiosink->write_pos;
       }
       break;
-    }
     default:
       break;
   }
@@ -288,58 +352,34 @@ static GstFlowReturn
 gst_inter_audio_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 {
   GstInterAudioSink *interaudiosink = GST_INTER_AUDIO_SINK (sink);
-  guint n, bpf;
-  guint64 period_time, buffer_time;
-  guint64 period_samples, buffer_samples;
+  GstMapInfo map;
 
   GST_DEBUG_OBJECT (interaudiosink, "render %" G_GSIZE_FORMAT,
       gst_buffer_get_size (buffer));
-  bpf = interaudiosink->info.bpf;
-
-  g_mutex_lock (&interaudiosink->surface->mutex);
-
-  buffer_time = interaudiosink->surface->audio_buffer_time;
-  period_time = interaudiosink->surface->audio_period_time;
 
-  if (buffer_time < period_time) {
-    GST_ERROR_OBJECT (interaudiosink,
-        "Buffer time smaller than period time (%" GST_TIME_FORMAT " < %"
-        GST_TIME_FORMAT ")", GST_TIME_ARGS (buffer_time),
-        GST_TIME_ARGS (period_time));
-    g_mutex_unlock (&interaudiosink->surface->mutex);
-    return GST_FLOW_ERROR;
+  /* Only look at the surface again if the source changed its settings */
+  if (g_atomic_int_get (&interaudiosink->surface->audio_cookie) !=
+      interaudiosink->cookie || !interaudiosink->ring) {
+    if (!gst_inter_audio_sink_update_ring (interaudiosink))
+      return GST_FLOW_ERROR;
   }
 
-  buffer_samples =
-      gst_util_uint64_scale (buffer_time, interaudiosink->info.rate,
-      GST_SECOND);
-  period_samples =
-      gst_util_uint64_scale (period_time, interaudiosink->info.rate,
-      GST_SECOND);
-
-  n = gst_adapter_available (interaudiosink->surface->audio_adapter) / bpf;
-  while (n > buffer_samples) {
-    GST_DEBUG_OBJECT (interaudiosink, "flushing %" GST_TIME_FORMAT,
-        GST_TIME_ARGS (period_time));
-    gst_adapter_flush (interaudiosink->surface->audio_adapter,
-        period_samples * bpf);
-    n -= period_samples;
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (interaudiosink, RESOURCE, READ, (NULL),
+        ("Failed to map buffer"));
+    return GST_FLOW_ERROR;
   }
-
-  n = gst_adapter_available (interaudiosink->input_adapter);
-  if (period_samples * bpf > gst_buffer_get_size (buffer) + n) {
-    gst_adapter_push (interaudiosink->input_adapter, gst_buffer_ref (buffer));
-  } else {
-    GstBuffer *tmp;
-
-    if (n > 0) {
-      tmp = gst_adapter_take_buffer (interaudiosink->input_adapter, n);
-      gst_adapter_push (interaudiosink->surface->audio_adapter, tmp);
-    }
-    gst_adapter_push (interaudiosink->surface->audio_adapter,
-        gst_buffer_ref (buffer));
+  gst_inter_audio_ring_write (interaudiosink->ring, &interaudiosink->write_pos,
+      map.data, map.size - map.size % interaudiosink->info.bpf);
+  gst_buffer_unmap (buffer, &map);
+
+  /* Make the samples available to the source a period at a time */
+  if (interaudiosink->write_pos - interaudiosink->commit_pos >=
+      interaudiosink->period_size) {
+    gst_inter_audio_ring_commit (interaudiosink->ring,
+        interaudiosink->write_pos);
+    interaudiosink->commit_pos = interaudiosink->write_pos;
   }
-  g_mutex_unlock (&interaudiosink->surface->mutex);
 
   return GST_FLOW_OK;
 }
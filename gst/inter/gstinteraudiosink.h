@@ -41,8 +41,15 @@ struct _GstInterAudioSink
   GstInterSurface *surface;
   char *channel;
 
-  GstAdapter *input_adapter;
   GstAudioInfo info;
+
+  /* our reference to the surface's audio ring, samples up to write_pos are
+   * written but only made visible to the source once a period is complete */
+  GstInterAudioRing *ring;
+  guint write_pos;
+  guint commit_pos;
+  guint period_size;
+  gint cookie;
 };
 
 struct _GstInterAudioSinkClass
@@ -33,6 +33,11 @@
  * See the gstintertest.c example in the gst-plugins-bad source code for
  * more details.
  *
+ * The #GstInterAudioSrc:stats property can be used to monitor how well the
+ * source keeps up with the sink: how much silence had to be inserted, how
+ * many samples were dropped because the buffer was full and how much audio
+ * was queued between the two elements.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -77,7 +82,8 @@ enum
   PROP_CHANNEL,
   PROP_BUFFER_TIME,
   PROP_LATENCY_TIME,
-  PROP_PERIOD_TIME
+  PROP_PERIOD_TIME,
+  PROP_STATS
 };
 
 #define DEFAULT_CHANNEL ("default")
@@ -148,6 +154,24 @@ gst_inter_audio_src_class_init (GstInterAudioSrcClass * klass)
           "The minimum amount of data to read in each iteration",
           1, G_MAXUINT64, DEFAULT_AUDIO_PERIOD_TIME,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstInterAudioSrc:stats:
+   *
+   * Statistics about the audio exchanged with the sink. Contains the number
+   * of samples of silence that were inserted (silence-samples), the number
+   * of samples that were dropped because the sink produced faster than this
+   * source consumed (dropped-samples), the number of times the sink
+   * overwrote samples that were not read yet (overruns) and the current and
+   * maximum amount of audio queued after a read (queued-time,
+   * max-queued-time).
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Statistics about the audio exchanged with the sink",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -208,6 +232,23 @@ gst_inter_audio_src_get_property (GObject * object, guint property_id,
     case PROP_PERIOD_TIME:
       g_value_set_uint64 (value, interaudiosrc->period_time);
       break;
+    case PROP_STATS:{
+      guint overruns = 0;
+
+      GST_OBJECT_LOCK (interaudiosrc);
+      if (interaudiosrc->ring)
+        overruns = g_atomic_int_get (&interaudiosrc->ring->overruns);
+      g_value_take_boxed (value,
+          gst_structure_new ("application/x-inter-audio-src-stats",
+              "silence-samples", G_TYPE_UINT64, interaudiosrc->silence_samples,
+              "dropped-samples", G_TYPE_UINT64, interaudiosrc->dropped_samples,
+              "overruns", G_TYPE_UINT, overruns,
+              "queued-time", G_TYPE_UINT64, interaudiosrc->queued_time,
+              "max-queued-time", G_TYPE_UINT64,
+              interaudiosrc->max_queued_time, NULL));
+      GST_OBJECT_UNLOCK (interaudiosrc);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -282,11 +323,22 @@ gst_inter_audio_src_start (GstBaseSrc * src)
   interaudiosrc->surface = gst_inter_surface_get (interaudiosrc->channel);
   interaudiosrc->timestamp_offset = 0;
   interaudiosrc->n_samples = 0;
+  memset (&interaudiosrc->surface_info, 0, sizeof (GstAudioInfo));
+
+  GST_OBJECT_LOCK (interaudiosrc);
+  interaudiosrc->silence_samples = 0;
+  interaudiosrc->dropped_samples = 0;
+  interaudiosrc->queued_time = 0;
+  interaudiosrc->max_queued_time = 0;
+  GST_OBJECT_UNLOCK (interaudiosrc);
 
   g_mutex_lock (&interaudiosrc->surface->mutex);
   interaudiosrc->surface->audio_buffer_time = interaudiosrc->buffer_time;
   interaudiosrc->surface->audio_latency_time = interaudiosrc->latency_time;
   interaudiosrc->surface->audio_period_time = interaudiosrc->period_time;
+  /* make sure the sink picks up our settings and we pick up its ring */
+  interaudiosrc->cookie =
+      g_atomic_int_add (&interaudiosrc->surface->audio_cookie, 1);
   g_mutex_unlock (&interaudiosrc->surface->mutex);
 
   return TRUE;
@@ -302,6 +354,13 @@ gst_inter_audio_src_stop (GstBaseSrc * src)
   gst_inter_surface_unref (interaudiosrc->surface);
   interaudiosrc->surface = NULL;
 
+  GST_OBJECT_LOCK (interaudiosrc);
+  if (interaudiosrc->ring) {
+    gst_inter_audio_ring_unref (interaudiosrc->ring);
+    interaudiosrc->ring = NULL;
+  }
+  GST_OBJECT_UNLOCK (interaudiosrc);
+
   return TRUE;
 }
 
@@ -337,20 +396,39 @@ gst_inter_audio_src_create (GstBaseSrc * src, guint64 offset, guint size,
   GstInterAudioSrc *interaudiosrc = GST_INTER_AUDIO_SRC (src);
   GstCaps *caps;
   GstBuffer *buffer;
-  guint n, bpf;
-  guint64 period_time;
-  guint64 period_samples;
+  GstMapInfo map;
+  GstInterAudioRing *ring;
+  guint n, bpf, dropped, queued;
+  guint64 period_samples, buffer_samples;
 
   GST_DEBUG_OBJECT (interaudiosrc, "create");
 
-  buffer = NULL;
   caps = NULL;
 
-  g_mutex_lock (&interaudiosrc->surface->mutex);
-  if (interaudiosrc->surface->audio_info.finfo) {
-    if (!gst_audio_info_is_equal (&interaudiosrc->surface->audio_info,
+  /* The surface only needs to be looked at if the sink changed the format
+   * or replaced the ring, everything else is lock-free */
+  if (g_atomic_int_get (&interaudiosrc->surface->audio_cookie) !=
+      interaudiosrc->cookie) {
+    g_mutex_lock (&interaudiosrc->surface->mutex);
+    interaudiosrc->cookie =
+        g_atomic_int_get (&interaudiosrc->surface->audio_cookie);
+    interaudiosrc->surface_info = interaudiosrc->surface->audio_info;
+    ring = interaudiosrc->surface->audio_ring;
+    if (ring)
+      gst_inter_audio_ring_ref (ring);
+    g_mutex_unlock (&interaudiosrc->surface->mutex);
+
+    GST_OBJECT_LOCK (interaudiosrc);
+    if (interaudiosrc->ring)
+      gst_inter_audio_ring_unref (interaudiosrc->ring);
+    interaudiosrc->ring = ring;
+    GST_OBJECT_UNLOCK (interaudiosrc);
+  }
+
+  if (interaudiosrc->surface_info.finfo) {
+    if (!gst_audio_info_is_equal (&interaudiosrc->surface_info,
             &interaudiosrc->info)) {
-      caps = gst_audio_info_to_caps (&interaudiosrc->surface->audio_info);
+      caps = gst_audio_info_to_caps (&interaudiosrc->surface_info);
       interaudiosrc->timestamp_offset +=
           gst_util_uint64_scale (interaudiosrc->n_samples, GST_SECOND,
           interaudiosrc->info.rate);
@@ -358,56 +436,77 @@ gst_inter_audio_src_create (GstBaseSrc * src, guint64 offset, guint size,
     }
   }
 
-  bpf = interaudiosrc->surface->audio_info.bpf;
-  period_time = interaudiosrc->surface->audio_period_time;
-  period_samples =
-      gst_util_uint64_scale (period_time, interaudiosrc->info.rate, GST_SECOND);
-
-  if (bpf > 0)
-    n = gst_adapter_available (interaudiosrc->surface->audio_adapter) / bpf;
-  else
-    n = 0;
-
-  if (n > period_samples)
-    n = period_samples;
-  if (n > 0) {
-    buffer = gst_adapter_take_buffer (interaudiosrc->surface->audio_adapter,
-        n * bpf);
-  } else {
-    buffer = gst_buffer_new ();
-    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_GAP);
-  }
-  g_mutex_unlock (&interaudiosrc->surface->mutex);
-
   if (caps) {
     gboolean ret = gst_base_src_set_caps (src, caps);
     gst_caps_unref (caps);
     if (!ret) {
       GST_ERROR_OBJECT (src, "Failed to set caps %" GST_PTR_FORMAT, caps);
-      if (buffer)
-        gst_buffer_unref (buffer);
       return GST_FLOW_NOT_NEGOTIATED;
     }
   }
 
-  buffer = gst_buffer_make_writable (buffer);
-
   bpf = interaudiosrc->info.bpf;
-  if (n < period_samples) {
-    GstMapInfo map;
-    GstMemory *mem;
+  period_samples =
+      gst_util_uint64_scale (interaudiosrc->period_time,
+      interaudiosrc->info.rate, GST_SECOND);
+  buffer_samples =
+      gst_util_uint64_scale (interaudiosrc->buffer_time,
+      interaudiosrc->info.rate, GST_SECOND);
+
+  buffer = gst_buffer_new_allocate (NULL, period_samples * bpf, NULL);
+  if (!buffer || !gst_buffer_map (buffer, &map, GST_MAP_WRITE)) {
+    GST_ELEMENT_ERROR (interaudiosrc, RESOURCE, FAILED, (NULL),
+        ("Failed to allocate buffer"));
+    if (buffer)
+      gst_buffer_unref (buffer);
+    return GST_FLOW_ERROR;
+  }
 
+  ring = interaudiosrc->ring;
+  n = dropped = queued = 0;
+  if (ring && bpf > 0 && ring->bpf == bpf) {
+    guint offset, read;
+
+    /* drop whatever exceeds our buffer-time, the sink can't do that for us
+     * without taking the read position from under our feet */
+    dropped = gst_inter_audio_ring_trim (ring, buffer_samples * bpf) / bpf;
+    if (dropped > 0)
+      GST_DEBUG_OBJECT (interaudiosrc, "dropped %u samples", dropped);
+
+    n = MIN (gst_inter_audio_ring_available (ring) / bpf, period_samples);
+    offset = (period_samples - n) * bpf;
+    read = gst_inter_audio_ring_read (ring, map.data + offset, n * bpf);
+    if (read < n * bpf) {
+      /* the sink overwrote some of the samples in the meantime */
+      memmove (map.data + map.size - read, map.data + offset, read);
+      n = read / bpf;
+    }
+    queued = gst_inter_audio_ring_available (ring) / bpf;
+  }
+
+  if (n < period_samples) {
     GST_DEBUG_OBJECT (interaudiosrc,
         "creating %" G_GUINT64_FORMAT " samples of silence",
         period_samples - n);
-    mem = gst_allocator_alloc (NULL, (period_samples - n) * bpf, NULL);
-    if (gst_memory_map (mem, &map, GST_MAP_WRITE)) {
-      gst_audio_format_fill_silence (interaudiosrc->info.finfo, map.data,
-          map.size);
-      gst_memory_unmap (mem, &map);
-    }
-    gst_buffer_prepend_memory (buffer, mem);
+    gst_audio_format_fill_silence (interaudiosrc->info.finfo, map.data,
+        (period_samples - n) * bpf);
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  if (n == 0)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_GAP);
+
+  GST_OBJECT_LOCK (interaudiosrc);
+  interaudiosrc->silence_samples += period_samples - n;
+  interaudiosrc->dropped_samples += dropped;
+  if (interaudiosrc->info.rate > 0) {
+    interaudiosrc->queued_time =
+        gst_util_uint64_scale (queued, GST_SECOND, interaudiosrc->info.rate);
+    interaudiosrc->max_queued_time =
+        MAX (interaudiosrc->max_queued_time, interaudiosrc->queued_time);
   }
+  GST_OBJECT_UNLOCK (interaudiosrc);
+
   n = period_samples;
 
   GST_BUFFER_OFFSET (buffer) = interaudiosrc->n_samples;
@@ -46,6 +46,16 @@ struct _GstInterAudioSrc
   GstClockTime timestamp_offset;
   GstAudioInfo info;
   guint64 buffer_time, latency_time, period_time;
+
+  GstInterAudioRing *ring;
+  gint cookie;
+  GstAudioInfo surface_info;
+
+  /* protected by the object lock */
+  guint64 silence_samples;
+  guint64 dropped_samples;
+  GstClockTime queued_time;
+  GstClockTime max_queued_time;
 };
 
 struct _GstInterAudioSrcClass
@@ -48,7 +48,7 @@ gst_inter_surface_get (const char *name)
   surface->ref_count = 1;
   surface->name = g_strdup (name);
   g_mutex_init (&surface->mutex);
-  surface->audio_adapter = gst_adapter_new ();
+  g_cond_init (&surface->video_cond);
   surface->audio_buffer_time = DEFAULT_AUDIO_BUFFER_TIME;
   surface->audio_latency_time = DEFAULT_AUDIO_LATENCY_TIME;
   surface->audio_period_time = DEFAULT_AUDIO_PERIOD_TIME;
@@ -78,11 +78,156 @@ gst_inter_surface_unref (GstInterSurface * surface)
     }
 
     g_mutex_clear (&surface->mutex);
+    g_cond_clear (&surface->video_cond);
     gst_buffer_replace (&surface->video_buffer, NULL);
     gst_buffer_replace (&surface->sub_buffer, NULL);
-    gst_object_unref (surface->audio_adapter);
+    if (surface->audio_ring)
+      gst_inter_audio_ring_unref (surface->audio_ring);
     g_free (surface->name);
     g_free (surface);
   }
   g_mutex_unlock (&mutex);
 }
+
+GstInterAudioRing *
+gst_inter_audio_ring_new (guint bpf, guint min_size)
+{
+  GstInterAudioRing *ring;
+
+  g_return_val_if_fail (bpf > 0, NULL);
+
+  ring = g_new0 (GstInterAudioRing, 1);
+  ring->ref_count = 1;
+  ring->bpf = bpf;
+  /* a power of two so that the wrapping byte counters map to the same
+   * offset before and after they wrap */
+  ring->size = g_bit_storage (MAX (min_size, bpf) - 1);
+  ring->size = 1U << MIN (ring->size, 30);
+  ring->data = g_malloc (ring->size);
+
+  return ring;
+}
+
+GstInterAudioRing *
+gst_inter_audio_ring_ref (GstInterAudioRing * ring)
+{
+  g_atomic_int_inc (&ring->ref_count);
+
+  return ring;
+}
+
+void
+gst_inter_audio_ring_unref (GstInterAudioRing * ring)
+{
+  if (g_atomic_int_dec_and_test (&ring->ref_count)) {
+    g_free (ring->data);
+    g_free (ring);
+  }
+}
+
+/* Producer side: copies len bytes to *write_pos without making them visible
+ * to the consumer yet, dropping the oldest samples if there is not enough
+ * space. Returns the number of bytes written */
+guint
+gst_inter_audio_ring_write (GstInterAudioRing * ring, guint * write_pos,
+    const guint8 * data, guint len)
+{
+  guint capacity = ring->size - ring->size % ring->bpf;
+  guint read_pos, used, offset, first;
+
+  if (len > capacity) {
+    data += len - capacity;
+    len = capacity;
+  }
+
+  while (TRUE) {
+    read_pos = g_atomic_int_get (&ring->read_pos);
+    used = *write_pos - read_pos;
+    if (used + len <= capacity)
+      break;
+
+    if (g_atomic_int_compare_and_exchange (&ring->read_pos, (gint) read_pos,
+            (gint) (read_pos + used + len - capacity))) {
+      g_atomic_int_inc (&ring->overruns);
+      break;
+    }
+  }
+
+  offset = *write_pos & (ring->size - 1);
+  first = MIN (len, ring->size - offset);
+  memcpy (ring->data + offset, data, first);
+  memcpy (ring->data, data + first, len - first);
+  *write_pos += len;
+
+  return len;
+}
+
+/* Producer side: makes everything up to write_pos visible to the consumer */
+void
+gst_inter_audio_ring_commit (GstInterAudioRing * ring, guint write_pos)
+{
+  g_atomic_int_set (&ring->write_pos, (gint) write_pos);
+}
+
+/* Consumer side: number of bytes that can currently be read */
+guint
+gst_inter_audio_ring_available (GstInterAudioRing * ring)
+{
+  gint avail = g_atomic_int_get (&ring->write_pos) -
+      g_atomic_int_get (&ring->read_pos);
+
+  /* negative if the producer dropped samples it did not commit yet */
+  return MAX (avail, 0);
+}
+
+/* Consumer side: reads up to len bytes into data, returns the number of bytes
+ * read */
+guint
+gst_inter_audio_ring_read (GstInterAudioRing * ring, guint8 * data, guint len)
+{
+  guint read_pos, offset, first;
+  gint avail;
+
+  do {
+    read_pos = g_atomic_int_get (&ring->read_pos);
+    avail = g_atomic_int_get (&ring->write_pos) - (gint) read_pos;
+    if (avail <= 0)
+      return 0;
+    len = MIN (len, (guint) avail);
+    len -= len % ring->bpf;
+    if (len == 0)
+      return 0;
+
+    offset = read_pos & (ring->size - 1);
+    first = MIN (len, ring->size - offset);
+    memcpy (data, ring->data + offset, first);
+    memcpy (data + first, ring->data, len - first);
+
+    /* if the producer moved read_pos meanwhile it might have overwritten
+     * what we just copied, try again */
+  } while (!g_atomic_int_compare_and_exchange (&ring->read_pos,
+          (gint) read_pos, (gint) (read_pos + len)));
+
+  return len;
+}
+
+/* Consumer side: drops the oldest samples until at most max_len bytes are
+ * left, returns the number of bytes dropped */
+guint
+gst_inter_audio_ring_trim (GstInterAudioRing * ring, guint max_len)
+{
+  guint read_pos, skip;
+  gint avail;
+
+  do {
+    read_pos = g_atomic_int_get (&ring->read_pos);
+    avail = g_atomic_int_get (&ring->write_pos) - (gint) read_pos;
+    if (avail <= 0 || (guint) avail <= max_len)
+      return 0;
+    skip = avail - max_len;
+    skip += (ring->bpf - skip % ring->bpf) % ring->bpf;
+  } while (!g_atomic_int_compare_and_exchange (&ring->read_pos,
+          (gint) read_pos, (gint) (read_pos + skip)));
+
+  return skip;
+}
@@ -20,13 +20,33 @@
 #ifndef _GST_INTER_SURFACE_H_
 #define _GST_INTER_SURFACE_H_
 
-#include <gst/base/gstadapter.h>
 #include <gst/audio/audio.h>
 #include <gst/video/video.h>
 
 G_BEGIN_DECLS
 
 typedef struct _GstInterSurface GstInterSurface;
+typedef struct _GstInterAudioRing GstInterAudioRing;
+
+/* Single producer, single consumer ring of audio samples. Positions are byte
+ * counters that wrap around at 2^32 and are only accessed atomically, so
+ * neither side needs to take the surface mutex for the samples themselves.
+ * The producer may drop the oldest samples by moving read_pos forward, the
+ * consumer detects this because its own update of read_pos fails then. */
+struct _GstInterAudioRing
+{
+  gint ref_count;
+
+  guint8 *data;
+  guint size;
+  guint bpf;
+
+  gint write_pos;
+  gint read_pos;
+
+  /* number of times the producer had to drop samples */
+  gint overruns;
+};
 
 struct _GstInterSurface
 {
@@ -38,16 +58,23 @@ struct _GstInterSurface
   /* video */
   GstVideoInfo video_info;
   int video_buffer_count;
+  /* signalled whenever a new video_buffer is set */
+  GCond video_cond;
+  guint64 video_seqnum;
+  gint64 video_buffer_time;
 
   /* audio */
   GstAudioInfo audio_info;
   guint64 audio_buffer_time;
   guint64 audio_latency_time;
   guint64 audio_period_time;
+  /* atomic, changed whenever one of the audio fields above or the ring
+   * changes so that sink and source know when to update their copies */
+  gint audio_cookie;
 
   GstBuffer *video_buffer;
   GstBuffer *sub_buffer;
-  GstAdapter *audio_adapter;
+  GstInterAudioRing *audio_ring;
 };
 
 #define DEFAULT_AUDIO_BUFFER_TIME  (GST_SECOND)
@@ -58,6 +85,19 @@ struct _GstInterSurface
 GstInterSurface * gst_inter_surface_get (const char *name);
 void gst_inter_surface_unref (GstInterSurface *surface);
 
+GstInterAudioRing * gst_inter_audio_ring_new (guint bpf, guint min_size);
+GstInterAudioRing * gst_inter_audio_ring_ref (GstInterAudioRing *ring);
+void gst_inter_audio_ring_unref (GstInterAudioRing *ring);
+
+guint gst_inter_audio_ring_write (GstInterAudioRing *ring, guint *write_pos,
+    const guint8 *data, guint len);
+void gst_inter_audio_ring_commit (GstInterAudioRing *ring, guint write_pos);
+
+guint gst_inter_audio_ring_available (GstInterAudioRing *ring);
+guint gst_inter_audio_ring_read (GstInterAudioRing *ring, guint8 *data,
+    guint len);
+guint gst_inter_audio_ring_trim (GstInterAudioRing *ring, guint max_len);
+
 
 G_END_DECLS
 
@@ -256,6 +256,9 @@ gst_inter_video_sink_show_frame (GstVideoSink * sink, GstBuffer * buffer)
   }
   intervideosink->surface->video_buffer = gst_buffer_ref (buffer);
   intervideosink->surface->video_buffer_count = 0;
+  intervideosink->surface->video_seqnum++;
+  intervideosink->surface->video_buffer_time = g_get_monotonic_time ();
+  g_cond_broadcast (&intervideosink->surface->video_cond);
   g_mutex_unlock (&intervideosink->surface->mutex);
 
   return GST_FLOW_OK;
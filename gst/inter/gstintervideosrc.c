@@ -32,6 +32,14 @@
  * The intersubsrc element cannot be used effectively with gst-launch-1.0,
  * as it requires a second pipeline in the application to send subtitles.
  *
+ * By default the source produces frames at its own pace and repeats the last
+ * frame if the sink did not provide a new one in time. With
+ * #GstInterVideoSrc:wait-for-frame the source instead waits up to one frame
+ * duration for the sink, which avoids needless repeats when both pipelines
+ * run at the same rate but are slightly out of phase. The
+ * #GstInterVideoSrc:stats property reports how many frames were new or
+ * repeated and how long frames took to get from the sink to the source.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -66,16 +74,21 @@ gst_inter_video_src_get_times (GstBaseSrc * src, GstBuffer * buffer,
 static GstFlowReturn
 gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
     GstBuffer ** buf);
+static gboolean gst_inter_video_src_unlock (GstBaseSrc * src);
+static gboolean gst_inter_video_src_unlock_stop (GstBaseSrc * src);
 
 enum
 {
   PROP_0,
   PROP_CHANNEL,
-  PROP_TIMEOUT
+  PROP_TIMEOUT,
+  PROP_WAIT_FOR_FRAME,
+  PROP_STATS
 };
 
 #define DEFAULT_CHANNEL ("default")
 #define DEFAULT_TIMEOUT (GST_SECOND)
+#define DEFAULT_WAIT_FOR_FRAME FALSE
 
 /* pad templates */
 static GstStaticPadTemplate gst_inter_video_src_src_template =
@@ -119,6 +132,9 @@ gst_inter_video_src_class_init (GstInterVideoSrcClass * klass)
   base_src_class->stop = GST_DEBUG_FUNCPTR (gst_inter_video_src_stop);
   base_src_class->get_times = GST_DEBUG_FUNCPTR (gst_inter_video_src_get_times);
   base_src_class->create = GST_DEBUG_FUNCPTR (gst_inter_video_src_create);
+  base_src_class->unlock = GST_DEBUG_FUNCPTR (gst_inter_video_src_unlock);
+  base_src_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_inter_video_src_unlock_stop);
 
   g_object_class_install_property (gobject_class, PROP_CHANNEL,
       g_param_spec_string ("channel", "Channel",
@@ -130,6 +146,36 @@ gst_inter_video_src_class_init (GstInterVideoSrcClass * klass)
           "Timeout after which to start outputting black frames",
           0, G_MAXUINT64, DEFAULT_TIMEOUT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstInterVideoSrc:wait-for-frame:
+   *
+   * Wait up to one frame duration for the sink to provide a new frame
+   * before repeating the previous one.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_WAIT_FOR_FRAME,
+      g_param_spec_boolean ("wait-for-frame", "Wait for frame",
+          "Wait up to one frame duration for a new frame from the sink "
+          "before repeating the previous one", DEFAULT_WAIT_FOR_FRAME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstInterVideoSrc:stats:
+   *
+   * Statistics about the frames received from the sink. Contains the number
+   * of new (frames-new) and repeated or black (frames-repeated) frames that
+   * were produced, and the average and maximum time between the sink
+   * receiving a frame and this source picking it up (average-latency,
+   * max-latency).
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Statistics about the frames received from the sink",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -140,6 +186,7 @@ gst_inter_video_src_init (GstInterVideoSrc * intervideosrc)
 
   intervideosrc->channel = g_strdup (DEFAULT_CHANNEL);
   intervideosrc->timeout = DEFAULT_TIMEOUT;
+  intervideosrc->wait_for_frame = DEFAULT_WAIT_FOR_FRAME;
 }
 
 void
@@ -156,6 +203,9 @@ gst_inter_video_src_set_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       intervideosrc->timeout = g_value_get_uint64 (value);
       break;
+    case PROP_WAIT_FOR_FRAME:
+      intervideosrc->wait_for_frame = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -175,6 +225,24 @@ gst_inter_video_src_get_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       g_value_set_uint64 (value, intervideosrc->timeout);
       break;
+    case PROP_WAIT_FOR_FRAME:
+      g_value_set_boolean (value, intervideosrc->wait_for_frame);
+      break;
+    case PROP_STATS:{
+      guint64 frames_new;
+
+      GST_OBJECT_LOCK (intervideosrc);
+      frames_new = intervideosrc->frames_new;
+      g_value_take_boxed (value,
+          gst_structure_new ("application/x-inter-video-src-stats",
+              "frames-new", G_TYPE_UINT64, frames_new,
+              "frames-repeated", G_TYPE_UINT64, intervideosrc->frames_repeated,
+              "average-latency", G_TYPE_UINT64,
+              frames_new ? intervideosrc->total_latency / frames_new : 0,
+              "max-latency", G_TYPE_UINT64, intervideosrc->max_latency, NULL));
+      GST_OBJECT_UNLOCK (intervideosrc);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -277,6 +345,18 @@ gst_inter_video_src_start (GstBaseSrc * src)
   intervideosrc->timestamp_offset = 0;
   intervideosrc->n_frames = 0;
 
+  g_mutex_lock (&intervideosrc->surface->mutex);
+  intervideosrc->flushing = FALSE;
+  intervideosrc->last_seqnum = intervideosrc->surface->video_seqnum;
+  g_mutex_unlock (&intervideosrc->surface->mutex);
+
+  GST_OBJECT_LOCK (intervideosrc);
+  intervideosrc->frames_new = 0;
+  intervideosrc->frames_repeated = 0;
+  intervideosrc->total_latency = 0;
+  intervideosrc->max_latency = 0;
+  GST_OBJECT_UNLOCK (intervideosrc);
+
   return TRUE;
 }
 
@@ -294,6 +374,39 @@ gst_inter_video_src_stop (GstBaseSrc * src)
   return TRUE;
 }
 
+static gboolean
+gst_inter_video_src_unlock (GstBaseSrc * src)
+{
+  GstInterVideoSrc *intervideosrc = GST_INTER_VIDEO_SRC (src);
+
+  GST_DEBUG_OBJECT (intervideosrc, "unlock");
+
+  if (intervideosrc->surface) {
+    g_mutex_lock (&intervideosrc->surface->mutex);
+    intervideosrc->flushing = TRUE;
+    g_cond_broadcast (&intervideosrc->surface->video_cond);
+    g_mutex_unlock (&intervideosrc->surface->mutex);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_inter_video_src_unlock_stop (GstBaseSrc * src)
+{
+  GstInterVideoSrc *intervideosrc = GST_INTER_VIDEO_SRC (src);
+
+  GST_DEBUG_OBJECT (intervideosrc, "unlock_stop");
+
+  if (intervideosrc->surface) {
+    g_mutex_lock (&intervideosrc->surface->mutex);
+    intervideosrc->flushing = FALSE;
+    g_mutex_unlock (&intervideosrc->surface->mutex);
+  }
+
+  return TRUE;
+}
+
 static void
 gst_inter_video_src_get_times (GstBaseSrc * src, GstBuffer * buffer,
     GstClockTime * start, GstClockTime * end)
@@ -328,6 +441,8 @@ gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
   GstBuffer *buffer;
   guint64 frames;
   gboolean is_gap = FALSE;
+  gboolean is_new = FALSE;
+  gint64 latency = 0;
 
   GST_DEBUG_OBJECT (intervideosrc, "create");
 
@@ -339,6 +454,41 @@ gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
       GST_VIDEO_INFO_FPS_D (&intervideosrc->info) * GST_SECOND);
 
   g_mutex_lock (&intervideosrc->surface->mutex);
+
+  /* Give the sink up to one frame duration to provide a new frame before
+   * repeating the previous one */
+  if (intervideosrc->wait_for_frame && intervideosrc->surface->video_buffer
+      && intervideosrc->surface->video_seqnum == intervideosrc->last_seqnum) {
+    gint64 end_time;
+
+    if (GST_VIDEO_INFO_FPS_N (&intervideosrc->info) > 0)
+      end_time = g_get_monotonic_time () +
+          gst_util_uint64_scale_int (G_TIME_SPAN_SECOND,
+          GST_VIDEO_INFO_FPS_D (&intervideosrc->info),
+          GST_VIDEO_INFO_FPS_N (&intervideosrc->info));
+    else
+      end_time = g_get_monotonic_time () + G_TIME_SPAN_SECOND / 30;
+
+    while (!intervideosrc->flushing
+        && intervideosrc->surface->video_seqnum == intervideosrc->last_seqnum) {
+      if (!g_cond_wait_until (&intervideosrc->surface->video_cond,
+              &intervideosrc->surface->mutex, end_time))
+        break;
+    }
+
+    if (intervideosrc->flushing) {
+      g_mutex_unlock (&intervideosrc->surface->mutex);
+      return GST_FLOW_FLUSHING;
+    }
+  }
+
+  if (intervideosrc->surface->video_seqnum != intervideosrc->last_seqnum) {
+    intervideosrc->last_seqnum = intervideosrc->surface->video_seqnum;
+    latency = g_get_monotonic_time () -
+        intervideosrc->surface->video_buffer_time;
+    is_new = TRUE;
+  }
+
   if (intervideosrc->surface->video_info.finfo) {
     GstVideoInfo tmp_info = intervideosrc->surface->video_info;
 
@@ -380,6 +530,19 @@ gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
   intervideosrc->surface->video_buffer_count++;
   g_mutex_unlock (&intervideosrc->surface->mutex);
 
+  GST_OBJECT_LOCK (intervideosrc);
+  if (is_new) {
+    GstClockTime latency_time = latency * GST_USECOND;
+
+    intervideosrc->frames_new++;
+    intervideosrc->total_latency += latency_time;
+    intervideosrc->max_latency =
+        MAX (intervideosrc->max_latency, latency_time);
+  } else {
+    intervideosrc->frames_repeated++;
+  }
+  GST_OBJECT_UNLOCK (intervideosrc);
+
   if (caps) {
     gboolean ret;
     GstStructure *s;
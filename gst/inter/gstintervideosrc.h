@@ -43,11 +43,22 @@ struct _GstInterVideoSrc
 
   char *channel;
   guint64 timeout;
+  gboolean wait_for_frame;
 
   GstVideoInfo info;
   GstBuffer *black_frame;
   int n_frames;
   GstClockTime timestamp_offset;
+
+  /* protected by the surface mutex */
+  gboolean flushing;
+  guint64 last_seqnum;
+
+  /* protected by the object lock */
+  guint64 frames_new;
+  guint64 frames_repeated;
+  GstClockTime total_latency;
+  GstClockTime max_latency;
 };
 
 struct _GstInterVideoSrcClass
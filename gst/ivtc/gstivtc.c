@@ -67,13 +67,17 @@ static gboolean gst_ivtc_set_caps (GstBaseTransform * trans, GstCaps * incaps,
     GstCaps * outcaps);
 static gboolean gst_ivtc_sink_event (GstBaseTransform * trans,
     GstEvent * event);
+static GstFlowReturn gst_ivtc_prepare_output_buffer (GstBaseTransform *
+    trans, GstBuffer * inbuf, GstBuffer ** outbuf);
 static GstFlowReturn gst_ivtc_transform (GstBaseTransform * trans,
     GstBuffer * inbuf, GstBuffer * outbuf);
 static void gst_ivtc_flush (GstIvtc * ivtc);
 static void gst_ivtc_retire_fields (GstIvtc * ivtc, int n_fields);
 static void gst_ivtc_construct_frame (GstIvtc * itvc, GstBuffer * outbuf);
+static void gst_ivtc_match_fields (GstIvtc * ivtc, GstIvtcMatch * match);
 
-static int get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom);
+static int get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom,
+    int max_score);
 
 enum
 {
@@ -83,6 +87,7 @@ enum
 /* pad templates */
 
 #define MAX_WIDTH 2048
+#define THRESHOLD 100
 #define VIDEO_CAPS \
   "video/x-raw, " \
   "format = (string) { I420, Y444, Y42B }, " \
@@ -133,6 +138,8 @@ gst_ivtc_class_init (GstIvtcClass * klass)
   base_transform_class->fixate_caps = GST_DEBUG_FUNCPTR (gst_ivtc_fixate_caps);
   base_transform_class->set_caps = GST_DEBUG_FUNCPTR (gst_ivtc_set_caps);
   base_transform_class->sink_event = GST_DEBUG_FUNCPTR (gst_ivtc_sink_event);
+  base_transform_class->prepare_output_buffer =
+      GST_DEBUG_FUNCPTR (gst_ivtc_prepare_output_buffer);
   base_transform_class->transform = GST_DEBUG_FUNCPTR (gst_ivtc_transform);
 }
 
@@ -271,6 +278,7 @@ gst_ivtc_flush (GstIvtc * ivtc)
   }
 
   gst_ivtc_retire_fields (ivtc, ivtc->n_fields);
+  ivtc->have_match = FALSE;
 }
 
 enum
@@ -299,6 +307,7 @@ add_field (GstIvtc * ivtc, GstBuffer * buffer, int parity, int index)
   field->buffer = gst_buffer_ref (buffer);
   field->parity = parity;
   field->ts = ts;
+  field->comb_score = -1;
 
   gst_video_frame_map (&ivtc->fields[i].frame, &ivtc->sink_video_info,
       buffer, GST_MAP_READ);
@@ -318,14 +327,23 @@ similarity (GstIvtc * ivtc, int i1, int i2)
   f1 = &ivtc->fields[i1];
   f2 = &ivtc->fields[i2];
 
+  /* fields are compared with the next one and each pair is usually compared
+   * twice as it moves through the queue */
+  if (i2 == i1 + 1 && f1->comb_score >= 0)
+    return f1->comb_score;
+
+  /* scores of THRESHOLD * 2 and above are all treated the same */
   if (f1->parity == TOP_FIELD) {
-    score = get_comb_score (&f1->frame, &f2->frame);
+    score = get_comb_score (&f1->frame, &f2->frame, THRESHOLD * 2);
   } else {
-    score = get_comb_score (&f2->frame, &f1->frame);
+    score = get_comb_score (&f2->frame, &f1->frame, THRESHOLD * 2);
   }
 
   GST_DEBUG ("score %d", score);
 
+  if (i2 == i1 + 1)
+    f1->comb_score = score;
+
   return score;
 }
 
@@ -356,6 +374,16 @@ reconstruct (GstIvtc * ivtc, GstVideoFrame * dest_frame, int i1, int i2)
   for (k = 0; k < 3; k++) {
     height = GST_VIDEO_FRAME_COMP_HEIGHT (top, k);
     width = GST_VIDEO_FRAME_COMP_WIDTH (top, k);
+
+    /* both fields are from the same buffer, copy the whole plane at once */
+    if (top->data[k] == bottom->data[k] &&
+        GST_VIDEO_FRAME_COMP_STRIDE (top, k) ==
+        GST_VIDEO_FRAME_COMP_STRIDE (dest_frame, k)) {
+      memcpy (GET_LINE (dest_frame, k, 0), GET_LINE (top, k, 0),
+          (height - 1) * GST_VIDEO_FRAME_COMP_STRIDE (top, k) + width);
+      continue;
+    }
+
     for (j = 0; j < height; j++) {
       guint8 *dest = GET_LINE (dest_frame, k, j);
       guint8 *src = GET_LINE_IL (top, bottom, k, j);
@@ -506,15 +534,9 @@ gst_ivtc_retire_fields (GstIvtc * ivtc, int n_fields)
   ivtc->n_fields -= n_fields;
 }
 
-static GstFlowReturn
-gst_ivtc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
-    GstBuffer * outbuf)
+static void
+gst_ivtc_queue_fields (GstIvtc * ivtc, GstBuffer * inbuf)
 {
-  GstIvtc *ivtc = GST_IVTC (trans);
-  GstFlowReturn ret;
-
-  GST_DEBUG_OBJECT (ivtc, "transform");
-
   if (GST_BUFFER_FLAG_IS_SET (inbuf, GST_VIDEO_BUFFER_FLAG_TFF)) {
     add_field (ivtc, inbuf, TOP_FIELD, 0);
     if (!GST_BUFFER_FLAG_IS_SET (inbuf, GST_VIDEO_BUFFER_FLAG_ONEFIELD)) {
@@ -538,6 +560,71 @@ gst_ivtc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
     GST_DEBUG ("retiring early field");
     gst_ivtc_retire_fields (ivtc, 1);
   }
+}
+
+/* whether the memory layout of the frame is the one of the output caps */
+static gboolean
+gst_ivtc_frame_has_src_layout (GstIvtc * ivtc, GstVideoFrame * frame)
+{
+  int k;
+
+  for (k = 0; k < GST_VIDEO_FRAME_N_PLANES (frame); k++) {
+    if (GST_VIDEO_FRAME_PLANE_STRIDE (frame, k) !=
+        GST_VIDEO_INFO_PLANE_STRIDE (&ivtc->src_video_info, k) ||
+        GST_VIDEO_FRAME_PLANE_OFFSET (frame, k) !=
+        GST_VIDEO_INFO_PLANE_OFFSET (&ivtc->src_video_info, k))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* The fields are queued here rather than in transform, so that a frame made
+ * of both fields of one input buffer can be output as that buffer instead of
+ * being copied */
+static GstFlowReturn
+gst_ivtc_prepare_output_buffer (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer ** outbuf)
+{
+  GstIvtc *ivtc = GST_IVTC (trans);
+
+  gst_ivtc_queue_fields (ivtc, inbuf);
+
+  ivtc->have_match = FALSE;
+  if (ivtc->n_fields >= 4) {
+    gst_ivtc_match_fields (ivtc, &ivtc->match);
+    ivtc->have_match = TRUE;
+
+    if (ivtc->match.zero_copy) {
+      GstBaseTransformClass *klass = GST_BASE_TRANSFORM_GET_CLASS (trans);
+
+      GST_LOG_OBJECT (ivtc, "outputting input buffer without copying");
+      /* only the memory is shared, the flags and metas are those of the
+       * current input buffer like for any other output buffer */
+      *outbuf = gst_buffer_copy_region (ivtc->fields[ivtc->match.i1].buffer,
+          GST_BUFFER_COPY_MEMORY, 0, -1);
+      if (klass->copy_metadata && !klass->copy_metadata (trans, inbuf,
+              *outbuf)) {
+        GST_ELEMENT_WARNING (trans, STREAM, NOT_IMPLEMENTED,
+            ("could not copy metadata"), (NULL));
+      }
+      return GST_FLOW_OK;
+    }
+  }
+
+  return
+      GST_BASE_TRANSFORM_CLASS (gst_ivtc_parent_class)->prepare_output_buffer
+      (trans, inbuf, outbuf);
+}
+
+static GstFlowReturn
+gst_ivtc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstIvtc *ivtc = GST_IVTC (trans);
+  GstFlowReturn ret;
+
+  GST_DEBUG_OBJECT (ivtc, "transform");
 
   GST_DEBUG ("n_fields %d", ivtc->n_fields);
   if (ivtc->n_fields < 4) {
@@ -561,12 +648,10 @@ gst_ivtc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
 }
 
 static void
-gst_ivtc_construct_frame (GstIvtc * ivtc, GstBuffer * outbuf)
+gst_ivtc_match_fields (GstIvtc * ivtc, GstIvtcMatch * match)
 {
   int anchor_index;
   int prev_score, next_score;
-  GstVideoFrame dest_frame;
-  int n_retire;
   gboolean forward_ok;
 
   anchor_index = 1;
@@ -579,43 +664,70 @@ gst_ivtc_construct_frame (GstIvtc * ivtc, GstBuffer * outbuf)
   prev_score = similarity (ivtc, anchor_index - 1, anchor_index);
   next_score = similarity (ivtc, anchor_index, anchor_index + 1);
 
-  gst_video_frame_map (&dest_frame, &ivtc->src_video_info, outbuf,
-      GST_MAP_WRITE);
-
-#define THRESHOLD 100
+  match->i1 = anchor_index;
   if (prev_score < THRESHOLD) {
     if (forward_ok && next_score < prev_score) {
-      reconstruct (ivtc, &dest_frame, anchor_index, anchor_index + 1);
-      n_retire = anchor_index + 2;
+      match->i2 = anchor_index + 1;
+      match->n_retire = anchor_index + 2;
     } else {
       if (prev_score >= THRESHOLD / 2) {
         GST_INFO ("borderline prev (%d, %d)", prev_score, next_score);
       }
-      reconstruct (ivtc, &dest_frame, anchor_index, anchor_index - 1);
-      n_retire = anchor_index + 1;
+      match->i2 = anchor_index - 1;
+      match->n_retire = anchor_index + 1;
     }
   } else if (next_score < THRESHOLD) {
     if (next_score >= THRESHOLD / 2) {
       GST_INFO ("borderline prev (%d, %d)", prev_score, next_score);
     }
-    reconstruct (ivtc, &dest_frame, anchor_index, anchor_index + 1);
+    match->i2 = anchor_index + 1;
     if (forward_ok) {
-      n_retire = anchor_index + 2;
+      match->n_retire = anchor_index + 2;
     } else {
-      n_retire = anchor_index + 1;
+      match->n_retire = anchor_index + 1;
     }
   } else {
     if (prev_score < THRESHOLD * 2 || next_score < THRESHOLD * 2) {
       GST_INFO ("borderline single (%d, %d)", prev_score, next_score);
     }
-    reconstruct_single (ivtc, &dest_frame, anchor_index);
-    n_retire = anchor_index + 1;
+    match->i2 = -1;
+    match->n_retire = anchor_index + 1;
+  }
+
+  match->zero_copy = match->i2 >= 0 &&
+      ivtc->fields[match->i1].buffer == ivtc->fields[match->i2].buffer &&
+      gst_ivtc_frame_has_src_layout (ivtc, &ivtc->fields[match->i1].frame);
+}
+
+static void
+gst_ivtc_construct_frame (GstIvtc * ivtc, GstBuffer * outbuf)
+{
+  GstIvtcMatch match;
+
+  if (ivtc->have_match) {
+    match = ivtc->match;
+    ivtc->have_match = FALSE;
+  } else {
+    gst_ivtc_match_fields (ivtc, &match);
+    match.zero_copy = FALSE;
   }
 
-  GST_DEBUG ("retiring %d", n_retire);
-  gst_ivtc_retire_fields (ivtc, n_retire);
+  /* outbuf already holds the frame if it was made from the input buffer */
+  if (!match.zero_copy) {
+    GstVideoFrame dest_frame;
 
-  gst_video_frame_unmap (&dest_frame);
+    gst_video_frame_map (&dest_frame, &ivtc->src_video_info, outbuf,
+        GST_MAP_WRITE);
+    if (match.i2 >= 0) {
+      reconstruct (ivtc, &dest_frame, match.i1, match.i2);
+    } else {
+      reconstruct_single (ivtc, &dest_frame, match.i1);
+    }
+    gst_video_frame_unmap (&dest_frame);
+  }
+
+  GST_DEBUG ("retiring %d", match.n_retire);
+  gst_ivtc_retire_fields (ivtc, match.n_retire);
 
   GST_BUFFER_PTS (outbuf) = ivtc->current_ts;
   GST_BUFFER_DTS (outbuf) = ivtc->current_ts;
@@ -629,20 +741,25 @@ gst_ivtc_construct_frame (GstIvtc * ivtc, GstBuffer * outbuf)
 
 }
 
+/* the score is the number of samples in long runs of combing. Scoring
+ * stops once max_score is reached */
 static int
-get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom)
+get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom, int max_score)
 {
   int j;
   int thisline[MAX_WIDTH];
+  guint8 combed[MAX_WIDTH];
   int score = 0;
   int height;
   int width;
   int k;
+  gboolean cleared;
 
   height = GST_VIDEO_FRAME_COMP_HEIGHT (top, 0);
   width = GST_VIDEO_FRAME_COMP_WIDTH (top, 0);
 
-  memset (thisline, 0, sizeof (thisline));
+  memset (thisline, 0, width * sizeof (int));
+  cleared = TRUE;
 
   k = 0;
   /* remove a few lines from top and bottom, as they sometimes contain
@@ -651,11 +768,30 @@ get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom)
     guint8 *src1 = GET_LINE_IL (top, bottom, 0, j - 1);
     guint8 *src2 = GET_LINE_IL (top, bottom, 0, j);
     guint8 *src3 = GET_LINE_IL (top, bottom, 0, j + 1);
+    int n_combed = 0;
     int i;
 
+    /* branch-free, so that the compiler can vectorise it */
     for (i = 0; i < width; i++) {
-      if (src2[i] < MIN (src1[i], src3[i]) - 5 ||
-          src2[i] > MAX (src1[i], src3[i]) + 5) {
+      const int lo = MIN (src1[i], src3[i]) - 5;
+      const int hi = MAX (src1[i], src3[i]) + 5;
+
+      combed[i] = (src2[i] < lo) | (src2[i] > hi);
+      n_combed += combed[i];
+    }
+
+    /* most lines of a good match have no combing at all */
+    if (n_combed == 0) {
+      if (!cleared) {
+        memset (thisline, 0, width * sizeof (int));
+        cleared = TRUE;
+      }
+      continue;
+    }
+    cleared = FALSE;
+
+    for (i = 0; i < width; i++) {
+      if (combed[i]) {
         if (i > 0) {
           thisline[i] += thisline[i - 1];
         }
@@ -669,6 +805,11 @@ get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom)
         score++;
       }
     }
+
+    if (score >= max_score) {
+      score = max_score;
+      break;
+    }
   }
 
   GST_DEBUG ("score %d", score);
@@ -34,6 +34,7 @@ G_BEGIN_DECLS
 typedef struct _GstIvtc GstIvtc;
 typedef struct _GstIvtcClass GstIvtcClass;
 typedef struct _GstIvtcField GstIvtcField;
+typedef struct _GstIvtcMatch GstIvtcMatch;
 
 struct _GstIvtcField
 {
@@ -41,6 +42,19 @@ struct _GstIvtcField
   int parity;
   GstVideoFrame frame;
   GstClockTime ts;
+  /* comb score of this field woven with the next one, -1 if not known yet */
+  int comb_score;
+};
+
+struct _GstIvtcMatch
+{
+  /* fields woven into the output frame, i2 is -1 if field i1 is
+   * interpolated on its own */
+  int i1, i2;
+  int n_retire;
+  /* the output buffer shares the memory of the input buffer both fields
+   * come from */
+  gboolean zero_copy;
 };
 
 #define GST_IVTC_MAX_FIELDS 10
@@ -58,6 +72,10 @@ struct _GstIvtc
 
   int n_fields;
   GstIvtcField fields[GST_IVTC_MAX_FIELDS];
+
+  /* chosen in prepare_output_buffer for the next constructed frame */
+  gboolean have_match;
+  GstIvtcMatch match;
 };
 
 struct _GstIvtcClass
@@ -178,7 +178,7 @@ gst_jp2k_decimator_decimate_jpc (GstJP2kDecimator * self, GstBuffer * inbuf,
   GstFlowReturn ret = GST_FLOW_OK;
   GstMapInfo info;
   GstByteReader reader;
-  GstByteWriter writer;
+  Output output;
   MainHeader main_header;
 
 
@@ -190,7 +190,7 @@ gst_jp2k_decimator_decimate_jpc (GstJP2kDecimator * self, GstBuffer * inbuf,
   }
 
   gst_byte_reader_init (&reader, info.data, info.size);
-  gst_byte_writer_init_with_size (&writer, gst_buffer_get_size (inbuf), FALSE);
+  init_output (self, &output, info.data);
 
   /* main header */
   memset (&main_header, 0, sizeof (MainHeader));
@@ -202,11 +202,12 @@ gst_jp2k_decimator_decimate_jpc (GstJP2kDecimator * self, GstBuffer * inbuf,
   if (ret != GST_FLOW_OK)
     goto done;
 
-  ret = write_main_header (self, &writer, &main_header);
+  ret = write_main_header (self, &output, &main_header);
   if (ret != GST_FLOW_OK)
     goto done;
 
-  outbuf = gst_byte_writer_reset_and_get_buffer (&writer);
+  /* Unchanged parts of the codestream are shared with the input buffer */
+  outbuf = create_output_buffer (self, &output, inbuf);
   gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_METADATA, 0, -1);
 
   GST_DEBUG_OBJECT (self,
@@ -221,6 +222,7 @@ done:
 
   *outbuf_ = outbuf;
   reset_main_header (self, &main_header);
+  reset_output (self, &output);
   gst_buffer_unref (inbuf);
 
   return ret;
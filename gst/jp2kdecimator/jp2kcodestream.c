@@ -477,6 +477,161 @@ init_packet_iterator (GstJP2kDecimator * self, PacketIterator * it,
   return GST_FLOW_OK;
 }
 
+/* Ranges of the input shorter than this are copied into the output instead
+ * of being shared with it */
+#define MIN_SHARED_RANGE_LENGTH 1024
+
+void
+init_output (GstJP2kDecimator * self, Output * output, const guint8 * input)
+{
+  output->input = input;
+  gst_byte_writer_init (&output->fresh);
+  output->ranges = g_array_new (FALSE, FALSE, sizeof (OutputRange));
+}
+
+void
+reset_output (GstJP2kDecimator * self, Output * output)
+{
+  gst_byte_writer_reset (&output->fresh);
+  if (output->ranges)
+    g_array_free (output->ranges, TRUE);
+  memset (output, 0, sizeof (Output));
+}
+
+static void
+output_add_range (Output * output, gboolean fresh, guint offset, guint length)
+{
+  OutputRange *last = NULL;
+
+  if (length == 0)
+    return;
+
+  if (output->ranges->len > 0)
+    last =
+        &g_array_index (output->ranges, OutputRange, output->ranges->len - 1);
+
+  /* Merge with the previous range if this continues it */
+  if (last && last->fresh == fresh && last->offset + last->length == offset) {
+    last->length += length;
+  } else {
+    OutputRange range;
+
+    range.fresh = fresh;
+    range.offset = offset;
+    range.length = length;
+    g_array_append_val (output->ranges, range);
+  }
+}
+
+/* Passes length bytes of the input at data through to the output */
+static void
+output_passthrough (Output * output, const guint8 * data, guint length)
+{
+  output_add_range (output, FALSE, data - output->input, length);
+}
+
+/* Adds everything written to the fresh data since start to the output */
+static void
+output_add_fresh (Output * output, guint start)
+{
+  output_add_range (output, TRUE, start,
+      gst_byte_writer_get_pos (&output->fresh) - start);
+}
+
+static gint
+compare_range_length (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const GArray *ranges = user_data;
+  guint la = g_array_index (ranges, OutputRange, *(const guint *) a).length;
+  guint lb = g_array_index (ranges, OutputRange, *(const guint *) b).length;
+
+  /* Longest first */
+  return (la < lb) - (la > lb);
+}
+
+/* Appends the data copied so far as a new memory */
+static GstBuffer *
+append_copied (GstBuffer * outbuf, GstByteWriter * copy)
+{
+  if (gst_byte_writer_get_pos (copy) == 0)
+    return outbuf;
+
+  outbuf = gst_buffer_append (outbuf,
+      gst_byte_writer_reset_and_get_buffer (copy));
+  gst_byte_writer_init (copy);
+
+  return outbuf;
+}
+
+GstBuffer *
+create_output_buffer (GstJP2kDecimator * self, Output * output,
+    GstBuffer * inbuf)
+{
+  const guint8 *fresh_data = output->fresh.parent.data;
+  GstBuffer *outbuf;
+  GstByteWriter copy;
+  GArray *candidates;
+  gboolean *shared;
+  guint i, max_shared, shared_size = 0;
+
+  /* Only the longest ranges of the input are shared, each of them might need
+   * a memory with copied data before and after it and the buffer can only
+   * hold a limited number of memories without merging them */
+  max_shared = (gst_buffer_get_max_memory () - 1) / 2;
+
+  candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+  for (i = 0; i < output->ranges->len; i++) {
+    const OutputRange *range =
+        &g_array_index (output->ranges, OutputRange, i);
+
+    if (!range->fresh && range->length >= MIN_SHARED_RANGE_LENGTH)
+      g_array_append_val (candidates, i);
+  }
+  if (candidates->len > max_shared) {
+    g_array_sort_with_data (candidates, compare_range_length, output->ranges);
+    g_array_set_size (candidates, max_shared);
+  }
+
+  shared = g_new0 (gboolean, output->ranges->len);
+  for (i = 0; i < candidates->len; i++)
+    shared[g_array_index (candidates, guint, i)] = TRUE;
+  g_array_free (candidates, TRUE);
+
+  outbuf = gst_buffer_new ();
+  gst_byte_writer_init (&copy);
+
+  for (i = 0; i < output->ranges->len; i++) {
+    const OutputRange *range =
+        &g_array_index (output->ranges, OutputRange, i);
+
+    if (shared[i]) {
+      GstBuffer *sub;
+
+      outbuf = append_copied (outbuf, &copy);
+      sub = gst_buffer_copy_region (inbuf, GST_BUFFER_COPY_MEMORY,
+          range->offset, range->length);
+      outbuf = gst_buffer_append (outbuf, sub);
+      shared_size += range->length;
+    } else if (range->fresh) {
+      gst_byte_writer_put_data (&copy, fresh_data + range->offset,
+          range->length);
+    } else {
+      gst_byte_writer_put_data (&copy, output->input + range->offset,
+          range->length);
+    }
+  }
+
+  outbuf = append_copied (outbuf, &copy);
+  gst_byte_writer_reset (&copy);
+  g_free (shared);
+
+  GST_LOG_OBJECT (self, "Shared %u of %" G_GSIZE_FORMAT " bytes with the "
+      "input in %u memories", shared_size, gst_buffer_get_size (outbuf),
+      gst_buffer_n_memory (outbuf));
+
+  return outbuf;
+}
+
 static GstFlowReturn
 parse_siz (GstJP2kDecimator * self, GstByteReader * reader,
     ImageSize * siz, guint16 length)
@@ -514,12 +669,6 @@ parse_siz (GstJP2kDecimator * self, GstByteReader * reader,
   return GST_FLOW_OK;
 }
 
-static guint
-sizeof_siz (GstJP2kDecimator * self, const ImageSize * siz)
-{
-  return 2 + 38 + 3 * siz->n_components;
-}
-
 static void
 reset_siz (GstJP2kDecimator * self, ImageSize * siz)
 {
@@ -528,40 +677,6 @@ reset_siz (GstJP2kDecimator * self, ImageSize * siz)
   memset (siz, 0, sizeof (ImageSize));
 }
 
-static GstFlowReturn
-write_siz (GstJP2kDecimator * self, GstByteWriter * writer,
-    const ImageSize * siz)
-{
-  gint i;
-
-  if (!gst_byte_writer_ensure_free_space (writer,
-          2 + 38 + 3 * siz->n_components)) {
-    GST_ERROR_OBJECT (self, "Could not ensure free space");
-    return GST_FLOW_ERROR;
-  }
-
-  gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_SIZ);
-  gst_byte_writer_put_uint16_be_unchecked (writer, 38 + 3 * siz->n_components);
-  gst_byte_writer_put_uint16_be_unchecked (writer, siz->caps);
-  gst_byte_writer_put_uint32_be_unchecked (writer, siz->x);
-  gst_byte_writer_put_uint32_be_unchecked (writer, siz->y);
-  gst_byte_writer_put_uint32_be_unchecked (writer, siz->xo);
-  gst_byte_writer_put_uint32_be_unchecked (writer, siz->yo);
-  gst_byte_writer_put_uint32_be_unchecked (writer, siz->xt);
-  gst_byte_writer_put_uint32_be_unchecked (writer, siz->yt);
-  gst_byte_writer_put_uint32_be_unchecked (writer, siz->xto);
-  gst_byte_writer_put_uint32_be_unchecked (writer, siz->yto);
-  gst_byte_writer_put_uint16_be_unchecked (writer, siz->n_components);
-
-  for (i = 0; i < siz->n_components; i++) {
-    gst_byte_writer_put_uint8_unchecked (writer, siz->components[i].s);
-    gst_byte_writer_put_uint8_unchecked (writer, siz->components[i].xr);
-    gst_byte_writer_put_uint8_unchecked (writer, siz->components[i].yr);
-  }
-
-  return GST_FLOW_OK;
-}
-
 static GstFlowReturn
 parse_cod (GstJP2kDecimator * self, GstByteReader * reader,
     CodingStyleDefault * cod, guint16 length)
@@ -599,6 +714,7 @@ parse_cod (GstJP2kDecimator * self, GstByteReader * reader,
     }
 
     cod->PPx = g_slice_alloc (sizeof (guint8) * (cod->n_decompositions + 1));
+    cod->PPy = g_slice_alloc (sizeof (guint8) * (cod->n_decompositions + 1));
     for (i = 0; i < cod->n_decompositions + 1; i++) {
       guint8 v = gst_byte_reader_get_uint8_unchecked (reader);
       cod->PPx[i] = (v & 0x0f);
@@ -609,12 +725,6 @@ parse_cod (GstJP2kDecimator * self, GstByteReader * reader,
   return GST_FLOW_OK;
 }
 
-static guint
-sizeof_cod (GstJP2kDecimator * self, const CodingStyleDefault * cod)
-{
-  return 2 + 12 + (cod->PPx ? (cod->n_decompositions + 1) : 0);
-}
-
 static void
 reset_cod (GstJP2kDecimator * self, CodingStyleDefault * cod)
 {
@@ -625,254 +735,314 @@ reset_cod (GstJP2kDecimator * self, CodingStyleDefault * cod)
   memset (cod, 0, sizeof (CodingStyleDefault));
 }
 
-static GstFlowReturn
-write_cod (GstJP2kDecimator * self, GstByteWriter * writer,
-    const CodingStyleDefault * cod)
+/* Remembers a marker segment that is passed through to the output. data
+ * points at the marker, length includes the marker */
+static void
+add_marker (GArray ** markers, const guint8 * data, guint length)
 {
-  guint tmp;
-
-  tmp = 12 + (cod->PPx ? (1 + cod->n_decompositions) : 0);
-  if (!gst_byte_writer_ensure_free_space (writer, tmp)) {
-    GST_ERROR_OBJECT (self, "Could not ensure free space");
-    return GST_FLOW_ERROR;
-  }
+  Buffer b;
 
-  gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_COD);
-  gst_byte_writer_put_uint16_be_unchecked (writer, tmp);
+  if (!*markers)
+    *markers = g_array_new (FALSE, FALSE, sizeof (Buffer));
 
-  /* Scod */
-  tmp =
-      (cod->PPx ? 0x01 : 0x00) | (cod->sop ? 0x02 : 0x00) | (cod->
-      eph ? 0x04 : 0x00);
-  gst_byte_writer_put_uint8_unchecked (writer, tmp);
+  b.data = data;
+  b.length = length;
+  g_array_append_val (*markers, b);
+}
 
-  /* SGcod */
-  gst_byte_writer_put_uint8_unchecked (writer, cod->progression_order);
-  gst_byte_writer_put_uint16_be_unchecked (writer, cod->n_layers);
-  gst_byte_writer_put_uint8_unchecked (writer, cod->multi_component_transform);
+/* Writes the length of the marker segment that started at pos, i.e. whose
+ * length field is at pos, up to the current position */
+static void
+finish_marker_segment (GstByteWriter * writer, guint pos)
+{
+  guint end_pos = gst_byte_writer_get_pos (writer);
 
-  /* SPcod */
-  gst_byte_writer_put_uint8_unchecked (writer, cod->n_decompositions);
-  gst_byte_writer_put_uint8_unchecked (writer, cod->xcb - 2);
-  gst_byte_writer_put_uint8_unchecked (writer, cod->ycb - 2);
-  gst_byte_writer_put_uint8_unchecked (writer, cod->code_block_style);
-  gst_byte_writer_put_uint8_unchecked (writer, cod->transformation);
+  gst_byte_writer_set_pos (writer, pos);
+  gst_byte_writer_put_uint16_be_unchecked (writer, end_pos - pos);
+  gst_byte_writer_set_pos (writer, end_pos);
+}
 
-  if (cod->PPx) {
-    gint i;
+/* Packet lengths in PLT and PLM markers are stored in groups of 7 bits,
+ * most significant first, with the high bit set on all but the last */
+static guint
+sizeof_packet_length (guint32 len)
+{
+  if (len < (1 << 7))
+    return 1;
+  else if (len < (1 << 14))
+    return 2;
+  else if (len < (1 << 21))
+    return 3;
+  else if (len < (1 << 28))
+    return 4;
+  else
+    return 5;
+}
 
-    for (i = 0; i < cod->n_decompositions + 1; i++) {
-      tmp = (cod->PPx[i]) | (cod->PPy[i] << 4);
-      gst_byte_writer_put_uint8_unchecked (writer, tmp);
-    }
-  }
+static void
+write_packet_length (GstByteWriter * writer, guint32 len)
+{
+  gint i;
 
-  return GST_FLOW_OK;
+  for (i = sizeof_packet_length (len) - 1; i > 0; i--)
+    gst_byte_writer_put_uint8_unchecked (writer,
+        (0x80 | ((len >> (7 * i)) & 0x7f)));
+  gst_byte_writer_put_uint8_unchecked (writer, (0x00 | (len & 0x7f)));
 }
 
 static GstFlowReturn
-parse_plt (GstJP2kDecimator * self, GstByteReader * reader,
-    PacketLengthTilePart * plt, guint length)
+parse_packet_lengths (GstJP2kDecimator * self, GstByteReader * reader,
+    GArray * packet_lengths, guint length)
 {
   guint32 n;
   guint8 b = 0;
   gint i;
 
-  if (length < 3) {
-    GST_ERROR_OBJECT (self, "Invalid PLT");
-    return GST_FLOW_ERROR;
-  }
-
-  plt->index = gst_byte_reader_get_uint8_unchecked (reader);
-  plt->packet_lengths = g_array_new (FALSE, FALSE, sizeof (guint32));
-
-  length -= 3;
-
   n = 0;
   for (i = 0; i < length; i++) {
     b = gst_byte_reader_get_uint8_unchecked (reader);
 
     if ((n & 0xfe000000)) {
-      GST_ERROR_OBJECT (self, "PLT element overflow");
+      GST_ERROR_OBJECT (self, "Packet length overflow");
       return GST_FLOW_ERROR;
     }
 
     n = (n << 7) | (b & 0x7f);
     if ((b & 0x80) == 0x00) {
-      g_array_append_val (plt->packet_lengths, n);
+      g_array_append_val (packet_lengths, n);
       n = 0;
     }
   }
 
   if ((b & 0x80) != 0x00) {
-    GST_ERROR_OBJECT (self, "Truncated PLT");
+    GST_ERROR_OBJECT (self, "Truncated packet lengths");
     return GST_FLOW_ERROR;
   }
   return GST_FLOW_OK;
 }
 
+/* The packet lengths of all PLT markers of a tile are collected in order */
+static GstFlowReturn
+parse_plt (GstJP2kDecimator * self, GstByteReader * reader, Tile * tile,
+    guint length)
+{
+  if (length < 3) {
+    GST_ERROR_OBJECT (self, "Invalid PLT");
+    return GST_FLOW_ERROR;
+  }
+
+  /* Zplt */
+  gst_byte_reader_skip_unchecked (reader, 1);
+
+  if (!tile->plt)
+    tile->plt = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  return parse_packet_lengths (self, reader, tile->plt, length - 3);
+}
+
+/* Maximum number of packet length bytes in a PLT or PLM marker segment */
+#define MAX_PACKET_LENGTHS_SIZE (65535 - 2 - 1)
+
 static guint
-sizeof_plt (GstJP2kDecimator * self, const PacketLengthTilePart * plt)
+sizeof_plt (GstJP2kDecimator * self, const GArray * packet_lengths)
 {
-  guint size = 2 + 3;
+  guint size = 0, segment_size = MAX_PACKET_LENGTHS_SIZE;
   gint i, n;
 
-  n = plt->packet_lengths->len;
+  n = packet_lengths->len;
   for (i = 0; i < n; i++) {
-    guint32 len = g_array_index (plt->packet_lengths, guint32, i);
-
-    if (len < (1 << 7)) {
-      size += 1;
-    } else if (len < (1 << 14)) {
-      size += 2;
-    } else if (len < (1 << 21)) {
-      size += 3;
-    } else if (len < (1 << 28)) {
-      size += 4;
-    } else {
-      size += 5;
+    guint len =
+        sizeof_packet_length (g_array_index (packet_lengths, guint32, i));
+
+    if (segment_size + len > MAX_PACKET_LENGTHS_SIZE) {
+      size += 2 + 2 + 1;
+      segment_size = 0;
     }
+    size += len;
+    segment_size += len;
   }
 
   return size;
 }
 
-static void
-reset_plt (GstJP2kDecimator * self, PacketLengthTilePart * plt)
+/* Writes as many PLT marker segments as are needed for the packet lengths */
+static GstFlowReturn
+write_plt (GstJP2kDecimator * self, GstByteWriter * writer,
+    const GArray * packet_lengths)
 {
-  if (plt->packet_lengths)
-    g_array_free (plt->packet_lengths, TRUE);
-  memset (plt, 0, sizeof (PacketLengthTilePart));
+  guint segment_size = MAX_PACKET_LENGTHS_SIZE, plt_start_pos = 0;
+  gint i, n, index = -1;
+
+  n = packet_lengths->len;
+  for (i = 0; i < n; i++) {
+    guint32 len = g_array_index (packet_lengths, guint32, i);
+
+    if (!gst_byte_writer_ensure_free_space (writer, 2 + 2 + 1 + 5)) {
+      GST_ERROR_OBJECT (self, "Could not ensure free space");
+      return GST_FLOW_ERROR;
+    }
+
+    if (segment_size + sizeof_packet_length (len) > MAX_PACKET_LENGTHS_SIZE) {
+      if (index >= 0)
+        finish_marker_segment (writer, plt_start_pos);
+
+      if (++index > 255) {
+        GST_ERROR_OBJECT (self, "Too many PLT marker segments");
+        return GST_FLOW_ERROR;
+      }
+
+      gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_PLT);
+      plt_start_pos = gst_byte_writer_get_pos (writer);
+      gst_byte_writer_put_uint16_be_unchecked (writer, 0);
+      gst_byte_writer_put_uint8_unchecked (writer, index);
+      segment_size = 0;
+    }
+
+    write_packet_length (writer, len);
+    segment_size += sizeof_packet_length (len);
+  }
+
+  if (index >= 0)
+    finish_marker_segment (writer, plt_start_pos);
+
+  return GST_FLOW_OK;
 }
 
+/* The packet lengths of all PLM markers are collected in order, each tile
+ * takes as many of them as it has packets */
 static GstFlowReturn
-write_plt (GstJP2kDecimator * self, GstByteWriter * writer,
-    const PacketLengthTilePart * plt)
+parse_plm (GstJP2kDecimator * self, GstByteReader * reader,
+    MainHeader * header, guint length)
 {
-  gint i, n;
-  guint plt_start_pos, plt_end_pos;
+  GstFlowReturn ret;
 
-  if (!gst_byte_writer_ensure_free_space (writer, 2 + 2 + 1)) {
-    GST_ERROR_OBJECT (self, "Could not ensure free space");
+  if (length < 3) {
+    GST_ERROR_OBJECT (self, "Invalid PLM");
     return GST_FLOW_ERROR;
   }
 
-  gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_PLT);
-  plt_start_pos = gst_byte_writer_get_pos (writer);
-  gst_byte_writer_put_uint16_be_unchecked (writer, 0);
+  /* Zplm */
+  gst_byte_reader_skip_unchecked (reader, 1);
+  length -= 3;
 
-  gst_byte_writer_put_uint8_unchecked (writer, plt->index);
+  if (!header->plm)
+    header->plm = g_array_new (FALSE, FALSE, sizeof (guint32));
 
-  n = plt->packet_lengths->len;
-  for (i = 0; i < n; i++) {
-    guint32 len = g_array_index (plt->packet_lengths, guint32, i);
+  /* Nplm bytes of packet lengths per tile-part */
+  while (length > 0) {
+    guint8 n = gst_byte_reader_get_uint8_unchecked (reader);
 
-    /* FIXME: Write multiple plt here */
-    if (gst_byte_writer_get_pos (writer) - plt_start_pos > 65535 - 5) {
-      GST_ERROR_OBJECT (self, "Too big PLT");
+    length--;
+    if (n > length) {
+      GST_ERROR_OBJECT (self, "Invalid PLM");
       return GST_FLOW_ERROR;
     }
 
-    if (len < (1 << 7)) {
-      if (!gst_byte_writer_ensure_free_space (writer, 1)) {
-        GST_ERROR_OBJECT (self, "Could not ensure free space");
-        return GST_FLOW_ERROR;
-      }
-      gst_byte_writer_put_uint8_unchecked (writer, (0x00 | (len & 0x7f)));
-    } else if (len < (1 << 14)) {
-      if (!gst_byte_writer_ensure_free_space (writer, 2)) {
-        GST_ERROR_OBJECT (self, "Could not ensure free space");
-        return GST_FLOW_ERROR;
-      }
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 7) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer, (0x00 | (len & 0x7f)));
-    } else if (len < (1 << 21)) {
-      if (!gst_byte_writer_ensure_free_space (writer, 3)) {
-        GST_ERROR_OBJECT (self, "Could not ensure free space");
-        return GST_FLOW_ERROR;
+    ret = parse_packet_lengths (self, reader, header->plm, n);
+    if (ret != GST_FLOW_OK)
+      return ret;
+    length -= n;
+  }
+
+  return GST_FLOW_OK;
+}
+
+static guint
+sizeof_packet (GstJP2kDecimator * self, const Packet * packet)
+{
+  return packet->length + (packet->sop ? 6 : 0) + ((packet->eph
+          && !packet->data) ? 2 : 0);
+}
+
+/* Writes the packet lengths of all tiles as PLM marker segments. Nplm can
+ * only describe 255 bytes of packet lengths, longer tiles are continued in
+ * the next marker segment */
+static GstFlowReturn
+write_plm (GstJP2kDecimator * self, GstByteWriter * writer,
+    const MainHeader * header)
+{
+  guint segment_size = MAX_PACKET_LENGTHS_SIZE, plm_start_pos = 0;
+  gint i, index = -1;
+
+  for (i = 0; i < header->n_tiles; i++) {
+    const GArray *packets = header->tiles[i].packets;
+    gboolean first = TRUE;
+    guint j = 0, k, n;
+
+    do {
+      /* Packet lengths that fit into one Nplm */
+      n = 0;
+      for (k = j; k < packets->len; k++) {
+        guint len = sizeof_packet_length (sizeof_packet (self,
+                &g_array_index (packets, Packet, k)));
+
+        if (n + len > 255)
+          break;
+        n += len;
       }
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 14) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 7) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer, (0x00 | (len & 0x7f)));
-    } else if (len < (1 << 28)) {
-      if (!gst_byte_writer_ensure_free_space (writer, 4)) {
+
+      if (!gst_byte_writer_ensure_free_space (writer, 2 + 2 + 1 + 1 + n)) {
         GST_ERROR_OBJECT (self, "Could not ensure free space");
         return GST_FLOW_ERROR;
       }
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 21) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 14) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 7) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer, (0x00 | (len & 0x7f)));
-    } else {
-      if (!gst_byte_writer_ensure_free_space (writer, 5)) {
-        GST_ERROR_OBJECT (self, "Could not ensure free space");
-        return GST_FLOW_ERROR;
+
+      if (!first || segment_size + 1 + n > MAX_PACKET_LENGTHS_SIZE) {
+        if (index >= 0)
+          finish_marker_segment (writer, plm_start_pos);
+
+        if (++index > 255) {
+          GST_ERROR_OBJECT (self, "Too many PLM marker segments");
+          return GST_FLOW_ERROR;
+        }
+
+        gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_PLM);
+        plm_start_pos = gst_byte_writer_get_pos (writer);
+        gst_byte_writer_put_uint16_be_unchecked (writer, 0);
+        gst_byte_writer_put_uint8_unchecked (writer, index);
+        segment_size = 0;
       }
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 28) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 21) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 14) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer,
-          (0x80 | ((len >> 7) & 0x7f)));
-      gst_byte_writer_put_uint8_unchecked (writer, (0x00 | (len & 0x7f)));
-    }
-  }
 
-  plt_end_pos = gst_byte_writer_get_pos (writer);
-  gst_byte_writer_set_pos (writer, plt_start_pos);
-  if (!gst_byte_writer_put_uint16_be (writer, plt_end_pos - plt_start_pos)) {
-    GST_ERROR_OBJECT (self, "Not enough space to write plt size");
-    return GST_FLOW_ERROR;
+      gst_byte_writer_put_uint8_unchecked (writer, n);
+      for (; j < k; j++)
+        write_packet_length (writer, sizeof_packet (self,
+                &g_array_index (packets, Packet, j)));
+      segment_size += 1 + n;
+      first = FALSE;
+    } while (j < packets->len);
   }
 
-  gst_byte_writer_set_pos (writer, plt_end_pos);
+  if (index >= 0)
+    finish_marker_segment (writer, plm_start_pos);
 
   return GST_FLOW_OK;
 }
 
 static GstFlowReturn
 parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
-    const MainHeader * header, Tile * tile, const PacketIterator * it)
+    const MainHeader * header, Tile * tile, const PacketIterator * it,
+    const GArray * packet_lengths, guint first_packet)
 {
   GstFlowReturn ret = GST_FLOW_OK;
   guint16 marker = 0, length;
   guint16 seqno = 0;
-  guint packet_start_pos;
   const guint8 *packet_start_data;
   gboolean sop, eph;
-  PacketLengthTilePart *plt = NULL;
+  Packet p;
 
   sop = (tile->cod) ? tile->cod->sop : header->cod.sop;
   eph = (tile->cod) ? tile->cod->eph : header->cod.eph;
-  if (tile->plt) {
-    if (g_list_length (tile->plt) > 1) {
-      GST_ERROR_OBJECT (self,
-          "Only a single PLT per tile is supported currently");
-      ret = GST_FLOW_ERROR;
-      goto done;
-    }
-    plt = tile->plt->data;
-  }
 
-  if (plt) {
+  if (packet_lengths) {
     guint32 length;
-    Packet *p;
 
-    if (plt->packet_lengths->len <= it->cur_packet) {
-      GST_ERROR_OBJECT (self, "Truncated PLT");
+    if (packet_lengths->len <= first_packet + it->cur_packet) {
+      GST_ERROR_OBJECT (self, "Truncated packet lengths");
       ret = GST_FLOW_ERROR;
       goto done;
     }
 
-    length = g_array_index (plt->packet_lengths, guint32, it->cur_packet);
+    length =
+        g_array_index (packet_lengths, guint32, first_packet + it->cur_packet);
 
     if (gst_byte_reader_get_remaining (reader) < length) {
       GST_ERROR_OBJECT (self, "Truncated file");
@@ -880,53 +1050,35 @@ parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
       goto done;
     }
 
-    p = g_slice_new0 (Packet);
+    p.data = NULL;
 
     /* If there is a SOP keep the seqno */
-    if (sop && length > 6) {
-      if (!gst_byte_reader_peek_uint16_be (reader, &marker)) {
-        GST_ERROR_OBJECT (self, "Truncated file");
-        ret = GST_FLOW_ERROR;
-        g_slice_free (Packet, p);
-        goto done;
-      }
+    if (sop && length >= 6) {
+      marker = gst_byte_reader_peek_uint16_be_unchecked (reader);
 
       if (marker == MARKER_SOP) {
-        guint16 dummy;
-
-        gst_byte_reader_skip_unchecked (reader, 2);
-
-        if (!gst_byte_reader_get_uint16_be (reader, &dummy)) {
-          GST_ERROR_OBJECT (self, "Truncated file");
-          ret = GST_FLOW_ERROR;
-          g_slice_free (Packet, p);
-          goto done;
-        }
-
-        if (!gst_byte_reader_get_uint16_be (reader, &seqno)) {
-          GST_ERROR_OBJECT (self, "Truncated file");
-          ret = GST_FLOW_ERROR;
-          g_slice_free (Packet, p);
-          goto done;
-        }
-        p->data = gst_byte_reader_peek_data_unchecked (reader);
-        p->length = length - 6;
-        p->sop = TRUE;
-        p->eph = eph;
-        p->seqno = seqno;
+        gst_byte_reader_skip_unchecked (reader, 4);
+        seqno = gst_byte_reader_get_uint16_be_unchecked (reader);
+
+        p.data = gst_byte_reader_peek_data_unchecked (reader);
+        p.length = length - 6;
+        p.sop = TRUE;
+        p.eph = eph;
+        p.seqno = seqno;
         gst_byte_reader_skip_unchecked (reader, length - 6);
       }
     }
 
-    if (!p->data) {
-      p->data = gst_byte_reader_peek_data_unchecked (reader);
-      p->length = length;
-      p->sop = FALSE;
-      p->eph = eph;
+    if (!p.data) {
+      p.data = gst_byte_reader_peek_data_unchecked (reader);
+      p.length = length;
+      p.sop = FALSE;
+      p.eph = eph;
+      p.seqno = 0;
       gst_byte_reader_skip_unchecked (reader, length);
     }
 
-    tile->packets = g_list_prepend (tile->packets, p);
+    g_array_append_val (tile->packets, p);
   } else if (sop) {
     if (!gst_byte_reader_peek_uint16_be (reader, &marker)) {
       GST_ERROR_OBJECT (self, "Truncated file");
@@ -955,36 +1107,37 @@ parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
     }
 
     packet_start_data = reader->data + reader->byte;
-    packet_start_pos = gst_byte_reader_get_pos (reader);
 
-    /* Find end of packet */
+    /* Find end of packet. Inside packets 0xff is never followed by a
+     * byte above 0x8f, so only look at the 0xff bytes */
     while (TRUE) {
-      if (!gst_byte_reader_peek_uint16_be (reader, &marker)) {
+      const guint8 *data = reader->data + reader->byte;
+      guint remaining = gst_byte_reader_get_remaining (reader);
+      const guint8 *ff = memchr (data, 0xff, remaining);
+
+      if (!ff || ff == data + remaining - 1) {
         GST_ERROR_OBJECT (self, "Truncated file");
         ret = GST_FLOW_ERROR;
         goto done;
       }
 
-      if (marker == MARKER_SOP || marker == MARKER_EOC || marker == MARKER_SOT) {
-        Packet *p = g_slice_new (Packet);
-
-        p->sop = TRUE;
-        p->eph = eph;
-        p->seqno = seqno;
-        p->data = packet_start_data;
-        p->length = reader->byte - packet_start_pos;
-        tile->packets = g_list_prepend (tile->packets, p);
+      gst_byte_reader_skip_unchecked (reader, ff - data);
+      marker = GST_READ_UINT16_BE (ff);
 
-        if (marker == MARKER_EOC || marker == MARKER_SOT)
-          goto done;
-        else
-          break;
+      if (marker == MARKER_SOP || marker == MARKER_EOC || marker == MARKER_SOT) {
+        p.sop = TRUE;
+        p.eph = eph;
+        p.seqno = seqno;
+        p.data = packet_start_data;
+        p.length = ff - packet_start_data;
+        g_array_append_val (tile->packets, p);
+        break;
       }
 
       gst_byte_reader_skip_unchecked (reader, 1);
     }
   } else {
-    GST_ERROR_OBJECT (self, "Either PLT or SOP are required");
+    GST_ERROR_OBJECT (self, "Either PLT, PLM or SOP are required");
     ret = GST_FLOW_ERROR;
     goto done;
   }
@@ -994,39 +1147,47 @@ done:
   return ret;
 }
 
-static guint
-sizeof_packet (GstJP2kDecimator * self, const Packet * packet)
-{
-  return packet->length + (packet->sop ? 6 : 0) + ((packet->eph
-          && !packet->data) ? 2 : 0);
-}
-
 static GstFlowReturn
 parse_packets (GstJP2kDecimator * self, GstByteReader * reader,
-    const MainHeader * header, Tile * tile)
+    const MainHeader * header, Tile * tile, guint * plm_pos)
 {
   guint16 marker = 0;
   GstFlowReturn ret = GST_FLOW_OK;
   PacketIterator it;
+  const GArray *packet_lengths = NULL;
+  guint first_packet = 0;
 
   /* Start of data here */
+  tile->sod = reader->data + reader->byte;
   if (!gst_byte_reader_get_uint16_be (reader, &marker)
-      && marker != MARKER_SOD) {
+      || marker != MARKER_SOD) {
     GST_ERROR_OBJECT (self, "No SOD in tile");
     return GST_FLOW_ERROR;
   }
 
+  /* Packet lengths from PLT are preferred over the ones from PLM */
+  if (tile->plt) {
+    packet_lengths = tile->plt;
+  } else if (header->plm) {
+    packet_lengths = header->plm;
+    first_packet = *plm_pos;
+  }
+
   ret = init_packet_iterator (self, &it, header, tile);
   if (ret != GST_FLOW_OK)
     goto done;
 
+  tile->packets = g_array_new (FALSE, FALSE, sizeof (Packet));
+
   while ((it.next (&it))) {
-    ret = parse_packet (self, reader, header, tile, &it);
+    ret = parse_packet (self, reader, header, tile, &it, packet_lengths,
+        first_packet);
     if (ret != GST_FLOW_OK)
       goto done;
   }
 
-  tile->packets = g_list_reverse (tile->packets);
+  if (header->plm)
+    *plm_pos += tile->packets->len;
 
 done:
 
@@ -1035,10 +1196,12 @@ done:
 
 static GstFlowReturn
 parse_tile (GstJP2kDecimator * self, GstByteReader * reader,
-    const MainHeader * header, Tile * tile)
+    const MainHeader * header, Tile * tile, guint * plm_pos)
 {
   GstFlowReturn ret = GST_FLOW_OK;
   guint16 marker = 0, length;
+  const guint8 *marker_data;
+  gboolean have_qcd = FALSE;
 
   if (!gst_byte_reader_peek_uint16_be (reader, &marker)) {
     GST_ERROR_OBJECT (self, "Could not read marker");
@@ -1115,6 +1278,7 @@ parse_tile (GstJP2kDecimator * self, GstByteReader * reader,
     }
 
     /* Skip the marker */
+    marker_data = reader->data + reader->byte;
     gst_byte_reader_skip_unchecked (reader, 2);
 
     /* All markers here have a length */
@@ -1147,6 +1311,10 @@ parse_tile (GstJP2kDecimator * self, GstByteReader * reader,
         ret = parse_cod (self, reader, tile->cod, length);
         if (ret != GST_FLOW_OK)
           goto done;
+
+        gst_byte_reader_set_pos (reader,
+            marker_data + 2 + length - reader->data);
+        add_marker (&tile->markers, marker_data, 2 + length);
         break;
       case MARKER_COC:
         GST_ERROR_OBJECT (self, "COC marker not supported yet");
@@ -1164,45 +1332,24 @@ parse_tile (GstJP2kDecimator * self, GstByteReader * reader,
         GST_ERROR_OBJECT (self, "PPT marker not supported yet");
         ret = GST_FLOW_ERROR;
         goto done;
-      case MARKER_PLT:{
-        PacketLengthTilePart *plt = g_slice_new (PacketLengthTilePart);
-
-        ret = parse_plt (self, reader, plt, length);
-        if (ret != GST_FLOW_OK) {
-          g_slice_free (PacketLengthTilePart, plt);
+      case MARKER_PLT:
+        ret = parse_plt (self, reader, tile, length);
+        if (ret != GST_FLOW_OK)
           goto done;
-        }
-
-        tile->plt = g_list_append (tile->plt, plt);
         break;
-      }
       case MARKER_QCD:
-        if (tile->qcd != NULL) {
+        if (have_qcd) {
           GST_ERROR_OBJECT (self, "Multiple QCD markers");
           ret = GST_FLOW_ERROR;
           goto done;
         }
-        tile->qcd = g_slice_new (Buffer);
-        tile->qcd->data = gst_byte_reader_peek_data_unchecked (reader);
-        tile->qcd->length = length - 2;
-        gst_byte_reader_skip_unchecked (reader, length - 2);
-        break;
-      case MARKER_QCC:{
-        Buffer *p = g_slice_new (Buffer);
-        p->data = gst_byte_reader_peek_data_unchecked (reader);
-        p->length = length - 2;
-        tile->qcc = g_list_append (tile->qcc, p);
+        have_qcd = TRUE;
+        /* fall through */
+      case MARKER_QCC:
+      case MARKER_COM:
+        add_marker (&tile->markers, marker_data, 2 + length);
         gst_byte_reader_skip_unchecked (reader, length - 2);
         break;
-      }
-      case MARKER_COM:{
-        Buffer *p = g_slice_new (Buffer);
-        p->data = gst_byte_reader_peek_data_unchecked (reader);
-        p->length = length - 2;
-        tile->com = g_list_append (tile->com, p);
-        gst_byte_reader_skip_unchecked (reader, length - 2);
-        break;
-      }
       default:
         GST_DEBUG_OBJECT (self, "Skipping unknown marker 0x%04x", marker);
         gst_byte_reader_skip_unchecked (reader, length - 2);
@@ -1210,7 +1357,7 @@ parse_tile (GstJP2kDecimator * self, GstByteReader * reader,
     }
   }
 
-  ret = parse_packets (self, reader, header, tile);
+  ret = parse_packets (self, reader, header, tile, plm_pos);
 
 done:
 
@@ -1221,39 +1368,24 @@ static guint
 sizeof_tile (GstJP2kDecimator * self, const Tile * tile)
 {
   guint size = 0;
-  GList *l;
+  guint i;
 
   /* SOT */
   size += 2 + 2 + 2 + 4 + 1 + 1;
 
-  if (tile->cod)
-    size += sizeof_cod (self, tile->cod);
-
-  if (tile->qcd)
-    size += 2 + 2 + tile->qcd->length;
-
-  for (l = tile->qcc; l; l = l->next) {
-    Buffer *b = l->data;
-    size += 2 + 2 + b->length;
+  if (tile->markers) {
+    for (i = 0; i < tile->markers->len; i++)
+      size += g_array_index (tile->markers, Buffer, i).length;
   }
 
-  for (l = tile->plt; l; l = l->next) {
-    PacketLengthTilePart *plt = l->data;
-    size += sizeof_plt (self, plt);
-  }
-
-  for (l = tile->com; l; l = l->next) {
-    Buffer *b = l->data;
-    size += 2 + 2 + b->length;
-  }
+  if (tile->plt)
+    size += sizeof_plt (self, tile->plt);
 
   /* SOD */
   size += 2;
 
-  for (l = tile->packets; l; l = l->next) {
-    Packet *p = l->data;
-    size += sizeof_packet (self, p);
-  }
+  for (i = 0; i < tile->packets->len; i++)
+    size += sizeof_packet (self, &g_array_index (tile->packets, Packet, i));
 
   return size;
 }
@@ -1261,107 +1393,78 @@ sizeof_tile (GstJP2kDecimator * self, const Tile * tile)
 static void
 reset_tile (GstJP2kDecimator * self, const MainHeader * header, Tile * tile)
 {
-  GList *l;
-
   if (tile->cod) {
     reset_cod (self, tile->cod);
     g_slice_free (CodingStyleDefault, tile->cod);
   }
 
-  for (l = tile->plt; l; l = l->next) {
-    PacketLengthTilePart *plt = l->data;
+  if (tile->markers)
+    g_array_free (tile->markers, TRUE);
 
-    reset_plt (self, plt);
+  if (tile->plt)
+    g_array_free (tile->plt, TRUE);
 
-    g_slice_free (PacketLengthTilePart, plt);
-  }
-  g_list_free (tile->plt);
-
-  if (tile->qcd)
-    g_slice_free (Buffer, tile->qcd);
-
-  for (l = tile->qcc; l; l = l->next) {
-    g_slice_free (Buffer, l->data);
-  }
-  g_list_free (tile->qcc);
-
-  for (l = tile->com; l; l = l->next) {
-    g_slice_free (Buffer, l->data);
-  }
-  g_list_free (tile->com);
-
-  for (l = tile->packets; l; l = l->next) {
-    Packet *p = l->data;
-
-    g_slice_free (Packet, p);
-  }
-  g_list_free (tile->packets);
+  if (tile->packets)
+    g_array_free (tile->packets, TRUE);
 
   memset (tile, 0, sizeof (Tile));
 }
 
+/* Packets that are kept are passed through together with their SOP marker
+ * segment, only the empty packets replacing dropped ones are written */
 static GstFlowReturn
-write_marker_buffer (GstJP2kDecimator * self, GstByteWriter * writer,
-    guint16 marker, const Buffer * buffer)
+write_packet (GstJP2kDecimator * self, Output * output, const Packet * packet)
 {
-  if (!gst_byte_writer_ensure_free_space (writer, 2 + 2 + buffer->length)) {
-    GST_ERROR_OBJECT (self, "Could not ensure free space");
-    return GST_FLOW_ERROR;
-  }
+  GstByteWriter *writer = &output->fresh;
+  guint start_pos;
 
-  gst_byte_writer_put_uint16_be_unchecked (writer, marker);
-  gst_byte_writer_put_uint16_be_unchecked (writer, buffer->length + 2);
-  gst_byte_writer_put_data_unchecked (writer, buffer->data, buffer->length);
-
-  return GST_FLOW_OK;
-}
-
-static GstFlowReturn
-write_packet (GstJP2kDecimator * self, GstByteWriter * writer,
-    const Packet * packet)
-{
-  guint size = packet->length;
-
-  if (packet->sop)
-    size += 6;
-  if (packet->eph && !packet->data)
-    size += 2;
+  if (packet->data) {
+    if (packet->sop)
+      output_passthrough (output, packet->data - 6, packet->length + 6);
+    else
+      output_passthrough (output, packet->data, packet->length);
+    return GST_FLOW_OK;
+  }
 
-  if (!gst_byte_writer_ensure_free_space (writer, size)) {
+  if (!gst_byte_writer_ensure_free_space (writer, sizeof_packet (self,
+              packet))) {
     GST_ERROR_OBJECT (self, "Could not ensure free space");
     return GST_FLOW_ERROR;
   }
 
+  start_pos = gst_byte_writer_get_pos (writer);
+
   if (packet->sop) {
     gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_SOP);
     gst_byte_writer_put_uint16_be_unchecked (writer, 4);
     gst_byte_writer_put_uint16_be_unchecked (writer, packet->seqno);
   }
 
-  if (packet->data) {
-    gst_byte_writer_put_data_unchecked (writer, packet->data, packet->length);
-  } else {
-    gst_byte_writer_put_uint8_unchecked (writer, 0);
-    if (packet->eph) {
-      gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_EPH);
-    }
+  gst_byte_writer_put_uint8_unchecked (writer, 0);
+  if (packet->eph) {
+    gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_EPH);
   }
 
+  output_add_fresh (output, start_pos);
+
   return GST_FLOW_OK;
 }
 
 static GstFlowReturn
-write_tile (GstJP2kDecimator * self, GstByteWriter * writer,
+write_tile (GstJP2kDecimator * self, Output * output,
     const MainHeader * header, Tile * tile)
 {
-  GList *l;
+  GstByteWriter *writer = &output->fresh;
   GstFlowReturn ret = GST_FLOW_OK;
+  guint i, start_pos;
 
   if (!gst_byte_writer_ensure_free_space (writer, 12)) {
     GST_ERROR_OBJECT (self, "Could not ensure free space");
     return GST_FLOW_ERROR;
   }
 
+  start_pos = gst_byte_writer_get_pos (writer);
+
   gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_SOT);
   gst_byte_writer_put_uint16_be_unchecked (writer, 10);
 
@@ -1370,52 +1473,29 @@ write_tile (GstJP2kDecimator * self, GstByteWriter * writer,
   gst_byte_writer_put_uint8_unchecked (writer, tile->sot.tile_part_index);
   gst_byte_writer_put_uint8_unchecked (writer, tile->sot.n_tile_parts);
 
-  if (tile->cod) {
-    ret = write_cod (self, writer, tile->cod);
-    if (ret != GST_FLOW_OK)
-      goto done;
-  }
-
-  if (tile->qcd) {
-    ret = write_marker_buffer (self, writer, MARKER_QCD, tile->qcd);
-    if (ret != GST_FLOW_OK)
-      goto done;
-  }
-
-  for (l = tile->qcc; l; l = l->next) {
-    Buffer *p = l->data;
-
-    ret = write_marker_buffer (self, writer, MARKER_QCC, p);
-    if (ret != GST_FLOW_OK)
-      goto done;
-  }
+  output_add_fresh (output, start_pos);
 
-  for (l = tile->plt; l; l = l->next) {
-    PacketLengthTilePart *plt = l->data;
+  if (tile->markers) {
+    for (i = 0; i < tile->markers->len; i++) {
+      const Buffer *b = &g_array_index (tile->markers, Buffer, i);
 
-    ret = write_plt (self, writer, plt);
-    if (ret != GST_FLOW_OK)
-      goto done;
+      output_passthrough (output, b->data, b->length);
+    }
   }
 
-  for (l = tile->com; l; l = l->next) {
-    Buffer *p = l->data;
-
-    ret = write_marker_buffer (self, writer, MARKER_COM, p);
+  if (tile->plt) {
+    start_pos = gst_byte_writer_get_pos (writer);
+    ret = write_plt (self, writer, tile->plt);
     if (ret != GST_FLOW_OK)
       goto done;
+    output_add_fresh (output, start_pos);
   }
 
-  if (!gst_byte_writer_put_uint16_be (writer, MARKER_SOD)) {
-    GST_ERROR_OBJECT (self, "Could not ensure free space");
-    ret = GST_FLOW_ERROR;
-    goto done;
-  }
+  output_passthrough (output, tile->sod, 2);
 
-  for (l = tile->packets; l; l = l->next) {
-    Packet *p = l->data;
-
-    ret = write_packet (self, writer, p);
+  for (i = 0; i < tile->packets->len; i++) {
+    ret = write_packet (self, output,
+        &g_array_index (tile->packets, Packet, i));
     if (ret != GST_FLOW_OK)
       goto done;
   }
@@ -1431,14 +1511,19 @@ parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
 {
   GstFlowReturn ret = GST_FLOW_OK;
   guint16 marker = 0, length = 0;
+  const guint8 *marker_data;
+  gboolean have_qcd = FALSE;
+  guint plm_pos = 0;
 
   /* First SOC */
+  marker_data = reader->data + reader->byte;
   if (!gst_byte_reader_get_uint16_be (reader, &marker)
       || marker != MARKER_SOC) {
     GST_ERROR_OBJECT (self, "Frame does not start with SOC");
     ret = GST_FLOW_ERROR;
     goto done;
   }
+  add_marker (&header->markers, marker_data, 2);
 
   while (TRUE) {
     if (!gst_byte_reader_peek_uint16_be (reader, &marker)) {
@@ -1464,6 +1549,7 @@ parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
     }
 
     /* Now skip the marker */
+    marker_data = reader->data + reader->byte;
     gst_byte_reader_skip_unchecked (reader, 2);
 
     /* All markers here have a length */
@@ -1494,6 +1580,10 @@ parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
         ret = parse_siz (self, reader, &header->siz, length);
         if (ret != GST_FLOW_OK)
           goto done;
+
+        gst_byte_reader_set_pos (reader,
+            marker_data + 2 + length - reader->data);
+        add_marker (&header->markers, marker_data, 2 + length);
         break;
       case MARKER_COD:
         if (header->siz.n_components == 0) {
@@ -1512,6 +1602,9 @@ parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
         if (ret != GST_FLOW_OK)
           goto done;
 
+        gst_byte_reader_set_pos (reader,
+            marker_data + 2 + length - reader->data);
+        add_marker (&header->markers, marker_data, 2 + length);
         break;
       case MARKER_POC:
         GST_ERROR_OBJECT (self, "POC marker not supported yet");
@@ -1530,47 +1623,28 @@ parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
         ret = GST_FLOW_ERROR;
         goto done;
       case MARKER_PLM:
-        GST_ERROR_OBJECT (self, "PLM marker not supported yet");
-        ret = GST_FLOW_ERROR;
-        goto done;
+        ret = parse_plm (self, reader, header, length);
+        if (ret != GST_FLOW_OK)
+          goto done;
+        break;
       case MARKER_PPM:
         GST_ERROR_OBJECT (self, "PPM marker not supported yet");
         ret = GST_FLOW_ERROR;
         goto done;
       case MARKER_QCD:
-        if (header->qcd.data != NULL) {
+        if (have_qcd) {
           GST_ERROR_OBJECT (self, "Multiple QCD markers");
           ret = GST_FLOW_ERROR;
           goto done;
         }
-        header->qcd.data = gst_byte_reader_peek_data_unchecked (reader);
-        header->qcd.length = length - 2;
+        have_qcd = TRUE;
+        /* fall through */
+      case MARKER_QCC:
+      case MARKER_COM:
+      case MARKER_CRG:
+        add_marker (&header->markers, marker_data, 2 + length);
         gst_byte_reader_skip_unchecked (reader, length - 2);
         break;
-      case MARKER_QCC:{
-        Buffer *p = g_slice_new (Buffer);
-        p->data = gst_byte_reader_peek_data_unchecked (reader);
-        p->length = length - 2;
-        header->qcc = g_list_append (header->qcc, p);
-        gst_byte_reader_skip_unchecked (reader, length - 2);
-        break;
-      }
-      case MARKER_COM:{
-        Buffer *p = g_slice_new (Buffer);
-        p->data = gst_byte_reader_peek_data_unchecked (reader);
-        p->length = length - 2;
-        header->com = g_list_append (header->com, p);
-        gst_byte_reader_skip_unchecked (reader, length - 2);
-        break;
-      }
-      case MARKER_CRG:{
-        Buffer *p = g_slice_new (Buffer);
-        p->data = gst_byte_reader_peek_data_unchecked (reader);
-        p->length = length - 2;
-        header->crg = g_list_append (header->crg, p);
-        gst_byte_reader_skip_unchecked (reader, length - 2);
-        break;
-      }
       default:
         GST_DEBUG_OBJECT (self, "Skipping unknown marker 0x%04x", marker);
         gst_byte_reader_skip_unchecked (reader, length - 2);
@@ -1596,13 +1670,14 @@ parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
     gint i;
 
     for (i = 0; i < header->n_tiles; i++) {
-      ret = parse_tile (self, reader, header, &header->tiles[i]);
+      ret = parse_tile (self, reader, header, &header->tiles[i], &plm_pos);
       if (ret != GST_FLOW_OK)
         goto done;
     }
   }
 
   /* now there must be the EOC marker */
+  header->eoc = reader->data + reader->byte;
   if (!gst_byte_reader_get_uint16_be (reader, &marker)
       || marker != MARKER_EOC) {
     GST_ERROR_OBJECT (self, "Frame does not end with EOC");
@@ -1615,47 +1690,10 @@ done:
   return ret;
 }
 
-guint
-sizeof_main_header (GstJP2kDecimator * self, const MainHeader * header)
-{
-  guint size = 2;
-  GList *l;
-  gint i;
-
-  size += sizeof_siz (self, &header->siz);
-  size += sizeof_cod (self, &header->cod);
-  size += 2 + 2 + header->qcd.length;
-
-  for (l = header->qcc; l; l = l->next) {
-    Buffer *b = l->data;
-    size += 2 + 2 + b->length;
-  }
-
-  for (l = header->crg; l; l = l->next) {
-    Buffer *b = l->data;
-    size += 2 + 2 + b->length;
-  }
-
-  for (l = header->com; l; l = l->next) {
-    Buffer *b = l->data;
-    size += 2 + 2 + b->length;
-  }
-
-  for (i = 0; i < header->n_tiles; i++) {
-    size += sizeof_tile (self, &header->tiles[i]);
-  }
-
-  /* EOC */
-  size += 2;
-
-  return size;
-}
-
 void
 reset_main_header (GstJP2kDecimator * self, MainHeader * header)
 {
   gint i;
-  GList *l;
 
   if (header->tiles) {
     for (i = 0; i < header->n_tiles; i++) {
@@ -1664,17 +1702,11 @@ reset_main_header (GstJP2kDecimator * self, MainHeader * header)
     g_slice_free1 (sizeof (Tile) * header->n_tiles, header->tiles);
   }
 
-  for (l = header->qcc; l; l = l->next)
-    g_slice_free (Buffer, l->data);
-  g_list_free (header->qcc);
-
-  for (l = header->com; l; l = l->next)
-    g_slice_free (Buffer, l->data);
-  g_list_free (header->com);
+  if (header->markers)
+    g_array_free (header->markers, TRUE);
 
-  for (l = header->crg; l; l = l->next)
-    g_slice_free (Buffer, l->data);
-  g_list_free (header->crg);
+  if (header->plm)
+    g_array_free (header->plm, TRUE);
 
   reset_cod (self, &header->cod);
   reset_siz (self, &header->siz);
@@ -1682,69 +1714,37 @@ reset_main_header (GstJP2kDecimator * self, MainHeader * header)
   memset (header, 0, sizeof (MainHeader));
 }
 
+/* The markers of the main header, the tile headers up to the packet data and
+ * the kept packets are passed through from the input. Only SOT, PLT, PLM and
+ * the empty packets replacing dropped packets are written freshly */
 GstFlowReturn
-write_main_header (GstJP2kDecimator * self, GstByteWriter * writer,
+write_main_header (GstJP2kDecimator * self, Output * output,
     const MainHeader * header)
 {
   GstFlowReturn ret = GST_FLOW_OK;
-  GList *l;
-  gint i;
+  guint i, start_pos;
 
-  if (!gst_byte_writer_ensure_free_space (writer, 2)) {
-    GST_ERROR_OBJECT (self, "Could not ensure free space");
-    return GST_FLOW_ERROR;
-  }
+  for (i = 0; i < header->markers->len; i++) {
+    const Buffer *b = &g_array_index (header->markers, Buffer, i);
 
-  gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_SOC);
-
-  ret = write_siz (self, writer, &header->siz);
-  if (ret != GST_FLOW_OK)
-    goto done;
-
-  ret = write_cod (self, writer, &header->cod);
-  if (ret != GST_FLOW_OK)
-    goto done;
-
-  ret = write_marker_buffer (self, writer, MARKER_QCD, &header->qcd);
-  if (ret != GST_FLOW_OK)
-    goto done;
-
-  for (l = header->qcc; l; l = l->next) {
-    Buffer *p = l->data;
-
-    ret = write_marker_buffer (self, writer, MARKER_QCC, p);
-    if (ret != GST_FLOW_OK)
-      goto done;
+    output_passthrough (output, b->data, b->length);
   }
 
-  for (l = header->crg; l; l = l->next) {
-    Buffer *p = l->data;
-
-    ret = write_marker_buffer (self, writer, MARKER_CRG, p);
-    if (ret != GST_FLOW_OK)
-      goto done;
-  }
-
-  for (l = header->com; l; l = l->next) {
-    Buffer *p = l->data;
-
-    ret = write_marker_buffer (self, writer, MARKER_COM, p);
+  if (header->plm) {
+    start_pos = gst_byte_writer_get_pos (&output->fresh);
+    ret = write_plm (self, &output->fresh, header);
     if (ret != GST_FLOW_OK)
       goto done;
+    output_add_fresh (output, start_pos);
   }
 
   for (i = 0; i < header->n_tiles; i++) {
-    ret = write_tile (self, writer, header, &header->tiles[i]);
+    ret = write_tile (self, output, header, &header->tiles[i]);
     if (ret != GST_FLOW_OK)
       goto done;
   }
 
-  if (!gst_byte_writer_ensure_free_space (writer, 2)) {
-    GST_ERROR_OBJECT (self, "Could not ensure free space");
-    ret = GST_FLOW_ERROR;
-    goto done;
-  }
-  gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_EOC);
+  output_passthrough (output, header->eoc, 2);
 
 done:
   return ret;
@@ -1758,59 +1758,46 @@ decimate_main_header (GstJP2kDecimator * self, MainHeader * header)
 
   for (i = 0; i < header->n_tiles; i++) {
     Tile *tile = &header->tiles[i];
-    GList *l;
     PacketIterator it;
-    PacketLengthTilePart *plt = NULL;
-
-    if (tile->plt) {
-      if (g_list_length (tile->plt) > 1) {
-        GST_ERROR_OBJECT (self, "Multiple PLT per tile not supported yet");
-        ret = GST_FLOW_ERROR;
-        goto done;
-      }
-      plt = g_slice_new (PacketLengthTilePart);
-      plt->index = 0;
-      plt->packet_lengths = g_array_new (FALSE, FALSE, sizeof (guint32));
-    }
+    guint j;
 
-    init_packet_iterator (self, &it, header, tile);
+    ret = init_packet_iterator (self, &it, header, tile);
+    if (ret != GST_FLOW_OK)
+      goto done;
 
-    l = tile->packets;
-    while ((it.next (&it))) {
+    for (j = 0; (it.next (&it)); j++) {
       Packet *p;
 
-      if (l == NULL) {
+      if (j >= tile->packets->len) {
         GST_ERROR_OBJECT (self, "Not enough packets");
         ret = GST_FLOW_ERROR;
-        g_array_free (plt->packet_lengths, TRUE);
-        g_slice_free (PacketLengthTilePart, plt);
         goto done;
       }
 
-      p = l->data;
+      p = &g_array_index (tile->packets, Packet, j);
 
-      if ((self->max_layers != 0 && it.cur_layer >= self->max_layers) ||
-          (self->max_decomposition_levels != -1
-              && it.cur_resolution > self->max_decomposition_levels)) {
+      if (p->data && ((self->max_layers != 0
+                  && it.cur_layer >= self->max_layers)
+              || (self->max_decomposition_levels != -1
+                  && it.cur_resolution > self->max_decomposition_levels))) {
         p->data = NULL;
         p->length = 1;
+        tile->n_dropped++;
       }
-
-      if (plt) {
-        guint32 len = sizeof_packet (self, p);
-        g_array_append_val (plt->packet_lengths, len);
-      }
-
-      l = l->next;
     }
 
-    if (plt) {
-      reset_plt (self, tile->plt->data);
-      g_slice_free (PacketLengthTilePart, tile->plt->data);
-      tile->plt->data = plt;
+    /* The new packet lengths replace the ones from the input */
+    if (tile->plt) {
+      g_array_set_size (tile->plt, tile->packets->len);
+      for (j = 0; j < tile->packets->len; j++)
+        g_array_index (tile->plt, guint32, j) =
+            sizeof_packet (self, &g_array_index (tile->packets, Packet, j));
     }
 
     tile->sot.tile_part_size = sizeof_tile (self, tile);
+
+    GST_LOG_OBJECT (self, "Dropped %u of %u packets of tile %u",
+        tile->n_dropped, tile->packets->len, tile->sot.tile_index);
   }
 
 done:
@@ -28,7 +28,9 @@
 
 #include "gstjp2kdecimator.h"
 
-/* Used to represent codestream packets */
+/* Used to represent codestream packets. data points into the input
+ * after the SOP marker segment, or is NULL for packets that are replaced
+ * by an empty packet */
 typedef struct
 {
   gboolean sop;
@@ -39,7 +41,8 @@ typedef struct
   guint length;
 } Packet;
 
-/* Used to represent unparsed markers for passthrough */
+/* Used to represent unparsed markers for passthrough, including the marker
+ * and its length */
 typedef struct
 {
   const guint8 *data;
@@ -106,26 +109,20 @@ typedef struct
   guint8 tile_part_index, n_tile_parts;
 } StartOfTile;
 
-/* PLT */
-typedef struct
-{
-  guint8 index;
-  GArray *packet_lengths;       /* array of guint32 */
-} PacketLengthTilePart;
-
 typedef struct
 {
   StartOfTile sot;
   CodingStyleDefault *cod;
 
-  Buffer *qcd;
-  GList *qcc;                   /* list of Buffer */
-
-  GList *plt;                   /* list of PacketLengthTilePart */
+  /* QCD, QCC and COM, passed through */
+  GArray *markers;              /* array of Buffer */
 
-  GList *com;                   /* list of Buffer */
+  /* packet lengths of all PLT markers, NULL if there are none */
+  GArray *plt;                  /* array of guint32 */
 
-  GList *packets;               /* list of Packet, codestream */
+  const guint8 *sod;            /* SOD marker in the input */
+  GArray *packets;              /* array of Packet, codestream order */
+  guint n_dropped;              /* number of packets replaced by empty ones */
 
   /* TODO: COC, PPT */
 
@@ -140,11 +137,15 @@ typedef struct
   ImageSize siz;
   CodingStyleDefault cod;
 
-  Buffer qcd;
-  GList *qcc;                   /* list of Buffer */
-  GList *crg, *com;             /* lists of Buffer */
+  /* SOC, SIZ, COD, QCD, QCC, CRG and COM, passed through */
+  GArray *markers;              /* array of Buffer */
 
-  /* TODO: COC, PPM, TLM, PLM */
+  /* packet lengths of all PLM markers, NULL if there are none */
+  GArray *plm;                  /* array of guint32 */
+
+  const guint8 *eoc;            /* EOC marker in the input */
+
+  /* TODO: COC, PPM, TLM */
 
   guint n_tiles_x, n_tiles_y, n_tiles;  /* calculated */
   Tile *tiles;
@@ -184,10 +185,31 @@ struct _PacketIterator
   gint cur_packet;
 };
 
+/* A range of the output codestream, either passed through from the input or
+ * freshly written */
+typedef struct
+{
+  gboolean fresh;
+  guint offset;                 /* in the input or the fresh data */
+  guint length;
+} OutputRange;
+
+/* The output codestream, built from ranges of the input and of freshly
+ * written data for the rewritten markers and packets */
+typedef struct
+{
+  const guint8 *input;
+  GstByteWriter fresh;
+  GArray *ranges;               /* array of OutputRange */
+} Output;
+
 GstFlowReturn parse_main_header (GstJP2kDecimator * self, GstByteReader * reader, MainHeader * header);
-guint sizeof_main_header (GstJP2kDecimator * self, const MainHeader * header);
 void reset_main_header (GstJP2kDecimator * self, MainHeader * header);
-GstFlowReturn write_main_header (GstJP2kDecimator * self, GstByteWriter * writer, const MainHeader * header);
+GstFlowReturn write_main_header (GstJP2kDecimator * self, Output * output, const MainHeader * header);
 GstFlowReturn decimate_main_header (GstJP2kDecimator * self, MainHeader * header);
 
+void init_output (GstJP2kDecimator * self, Output * output, const guint8 * input);
+void reset_output (GstJP2kDecimator * self, Output * output);
+GstBuffer * create_output_buffer (GstJP2kDecimator * self, Output * output, GstBuffer * inbuf);
+
 #endif /* __JP2K_CODESTREAM_H__ */
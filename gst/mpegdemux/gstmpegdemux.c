@@ -64,6 +64,11 @@
 
 #define DURATION_SCAN_LIMIT         4 * 1024 * 1024
 
+/* Minimum SCR distance between index entries of packs without keyframe */
+#define INDEX_SCR_INTERVAL          (CLOCK_FREQ / 2)
+/* Maximum SCR distance before the seek target of the keyframe to start at */
+#define INDEX_MAX_KEYFRAME_DISTANCE (2 * CLOCK_FREQ)
+
 typedef enum
 {
   SCAN_SCR,
@@ -275,6 +280,7 @@ gst_ps_demux_init (GstPsDemux * demux)
   demux->adapter = gst_adapter_new ();
   demux->rev_adapter = gst_adapter_new ();
   demux->flowcombiner = gst_flow_combiner_new ();
+  demux->index = g_array_new (FALSE, FALSE, sizeof (GstPsDemuxIndexEntry));
 
   gst_ps_demux_reset (demux);
 }
@@ -289,6 +295,7 @@ gst_ps_demux_finalize (GstPsDemux * demux)
   gst_flow_combiner_free (demux->flowcombiner);
   g_object_unref (demux->adapter);
   g_object_unref (demux->rev_adapter);
+  g_array_free (demux->index, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (G_OBJECT (demux));
 }
@@ -335,6 +342,7 @@ gst_ps_demux_reset (GstPsDemux * demux)
   demux->mux_rate = G_MAXUINT64;
   demux->next_pts = G_MAXUINT64;
   demux->next_dts = G_MAXUINT64;
+  g_array_set_size (demux->index, 0);
   demux->need_no_more_pads = TRUE;
   demux->adjust_segment = TRUE;
   gst_ps_demux_reset_psm (demux);
@@ -900,6 +908,8 @@ gst_ps_demux_flush (GstPsDemux * demux)
   gst_pes_filter_drain (&demux->filter);
   gst_ps_demux_clear_times (demux);
   demux->adapter_offset = G_MAXUINT64;
+  demux->adapter_end_offset = G_MAXUINT64;
+  demux->pack_offset = G_MAXUINT64;
   demux->current_scr = G_MAXUINT64;
   demux->bytes_since_scr = 0;
 }
@@ -1117,6 +1127,170 @@ not_supported:
   }
 }
 
+/* Returns the position of the first index entry at or after @offset */
+static guint
+gst_ps_demux_index_search_offset (GstPsDemux * demux, guint64 offset)
+{
+  guint lo = 0, hi = demux->index->len, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (g_array_index (demux->index, GstPsDemuxIndexEntry, mid).offset <
+        offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* Returns the position of the first index entry after @scr */
+static guint
+gst_ps_demux_index_search_scr (GstPsDemux * demux, guint64 scr)
+{
+  guint lo = 0, hi = demux->index->len, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (g_array_index (demux->index, GstPsDemuxIndexEntry, mid).scr <= scr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* Adds the pack at @offset to the index. Entries are kept sorted by both
+ * offset and SCR so they can be binary searched, packs after SCR
+ * discontinuities are left out. Packs without keyframe are only indexed
+ * every INDEX_SCR_INTERVAL. */
+static void
+gst_ps_demux_index_add (GstPsDemux * demux, guint64 scr, guint64 offset,
+    gboolean keyframe)
+{
+  GstPsDemuxIndexEntry *prev = NULL, *next = NULL, entry;
+  guint i;
+
+  i = gst_ps_demux_index_search_offset (demux, offset);
+  if (i < demux->index->len) {
+    next = &g_array_index (demux->index, GstPsDemuxIndexEntry, i);
+    if (next->offset == offset) {
+      next->keyframe |= keyframe;
+      return;
+    }
+  }
+  if (i > 0)
+    prev = &g_array_index (demux->index, GstPsDemuxIndexEntry, i - 1);
+
+  if ((prev && scr < prev->scr) || (next && scr > next->scr))
+    return;
+  if (!keyframe && ((prev && scr - prev->scr < INDEX_SCR_INTERVAL) ||
+          (next && next->scr - scr < INDEX_SCR_INTERVAL)))
+    return;
+
+  GST_LOG_OBJECT (demux, "indexing SCR %" G_GUINT64_FORMAT " at offset %"
+      G_GUINT64_FORMAT "%s", scr, offset, keyframe ? " (keyframe)" : "");
+
+  entry.scr = scr;
+  entry.offset = offset;
+  entry.keyframe = keyframe;
+  g_array_insert_val (demux->index, i, entry);
+}
+
+/* Narrows [min_scr, max_scr] down to the indexed packs around @scr */
+static void
+gst_ps_demux_index_lookup (GstPsDemux * demux, guint64 scr,
+    guint64 * min_scr, guint64 * min_scr_offset, guint64 * max_scr,
+    guint64 * max_scr_offset)
+{
+  GstPsDemuxIndexEntry *entry;
+  guint i;
+
+  i = gst_ps_demux_index_search_scr (demux, scr);
+  if (i > 0) {
+    entry = &g_array_index (demux->index, GstPsDemuxIndexEntry, i - 1);
+    if (entry->scr >= *min_scr) {
+      *min_scr = entry->scr;
+      *min_scr_offset = entry->offset;
+    }
+  }
+  if (i < demux->index->len) {
+    entry = &g_array_index (demux->index, GstPsDemuxIndexEntry, i);
+    if (entry->scr <= *max_scr) {
+      *max_scr = entry->scr;
+      *max_scr_offset = entry->offset;
+    }
+  }
+}
+
+/* Finds the last keyframe before @scr. Only the parts of the file that were
+ * played are indexed densely enough to know it, which is checked by looking
+ * at the distance between the index entries up to the first one after
+ * @scr. */
+static gboolean
+gst_ps_demux_index_find_keyframe (GstPsDemux * demux, guint64 scr,
+    guint64 * kf_scr, guint64 * kf_offset)
+{
+  GstPsDemuxIndexEntry *entry;
+  guint64 next_scr;
+  guint i;
+
+  i = gst_ps_demux_index_search_scr (demux, scr);
+  if (i == 0 || i == demux->index->len)
+    return FALSE;
+
+  next_scr = g_array_index (demux->index, GstPsDemuxIndexEntry, i).scr;
+  while (i-- > 0) {
+    entry = &g_array_index (demux->index, GstPsDemuxIndexEntry, i);
+    if (next_scr - entry->scr > 2 * INDEX_SCR_INTERVAL ||
+        scr - entry->scr > INDEX_MAX_KEYFRAME_DISTANCE)
+      break;
+    if (entry->keyframe) {
+      *kf_scr = entry->scr;
+      *kf_offset = entry->offset;
+      return TRUE;
+    }
+    next_scr = entry->scr;
+  }
+  return FALSE;
+}
+
+/* Whether a video keyframe starts in the beginning of a PES payload */
+static gboolean
+gst_ps_demux_is_keyframe (gint stream_type, const guint8 * data, gsize size)
+{
+  gsize i;
+
+  if (stream_type != ST_VIDEO_MPEG1 && stream_type != ST_VIDEO_MPEG2 &&
+      stream_type != ST_GST_VIDEO_MPEG1_OR_2 && stream_type != ST_VIDEO_H264)
+    return FALSE;
+
+  for (i = 0; i + 4 <= size; i++) {
+    if (data[i] != 0x00 || data[i + 1] != 0x00 || data[i + 2] != 0x01)
+      continue;
+
+    if (stream_type == ST_VIDEO_H264) {
+      switch (data[i + 3] & 0x1f) {
+        case 5:                /* IDR slice */
+        case 7:                /* SPS */
+          return TRUE;
+        case 1:                /* non-IDR slice */
+          return FALSE;
+        default:
+          break;
+      }
+    } else {
+      /* sequence or GOP header */
+      if (data[i + 3] == 0xb3 || data[i + 3] == 0xb8)
+        return TRUE;
+      /* picture header, I picture */
+      if (data[i + 3] == 0x00)
+        return i + 5 < size && ((data[i + 5] >> 3) & 0x7) == 1;
+    }
+  }
+  return FALSE;
+}
+
 #define MAX_RECURSION_COUNT 100
 
 /* Binary search for requested SCR */
@@ -1138,9 +1312,9 @@ find_offset (GstPsDemux * demux, guint64 scr,
       MIN (gst_util_uint64_scale (scr - min_scr, scr_rate_n,
           scr_rate_d), demux->sink_segment.stop);
 
-  if (!gst_ps_demux_scan_forward_ts (demux, &offset, SCAN_SCR, &fscr, 0)) {
-    gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0);
-  }
+  if (gst_ps_demux_scan_forward_ts (demux, &offset, SCAN_SCR, &fscr, 0) ||
+      gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0))
+    gst_ps_demux_index_add (demux, fscr, offset, FALSE);
 
   if (fscr == scr || fscr == min_scr || fscr == max_scr) {
     return offset;
@@ -1161,6 +1335,7 @@ gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
   gboolean found;
   guint64 fscr, offset;
   guint64 scr = GSTTIME_TO_MPEGTIME (seeksegment->position + demux->base_time);
+  guint64 min_scr, min_scr_offset, max_scr, max_scr_offset;
 
   /* In some clips the PTS values are completely unaligned with SCR values.
    * To improve the seek in that situation we apply a factor considering the
@@ -1175,9 +1350,29 @@ gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
   GST_INFO_OBJECT (demux, "sink segment configured %" GST_SEGMENT_FORMAT
       ", trying to go at SCR: %" G_GUINT64_FORMAT, &demux->sink_segment, scr);
 
-  offset =
-      find_offset (demux, scr, demux->first_scr, demux->first_scr_offset,
-      demux->last_scr, demux->last_scr_offset, 0);
+  /* Start at the last keyframe before the target when it is known, so that
+   * decoding can start right away */
+  if (gst_ps_demux_index_find_keyframe (demux, scr, &fscr, &offset)) {
+    GST_INFO_OBJECT (demux, "doing seek at keyframe at offset %"
+        G_GUINT64_FORMAT " SCR: %" G_GUINT64_FORMAT " %" GST_TIME_FORMAT,
+        offset, fscr, GST_TIME_ARGS (MPEGTIME_TO_GSTTIME (fscr)));
+    gst_segment_set_position (&demux->sink_segment, GST_FORMAT_BYTES, offset);
+    return TRUE;
+  }
+
+  /* Otherwise search between the indexed packs around it */
+  min_scr = demux->first_scr;
+  min_scr_offset = demux->first_scr_offset;
+  max_scr = demux->last_scr;
+  max_scr_offset = demux->last_scr_offset;
+  gst_ps_demux_index_lookup (demux, scr, &min_scr, &min_scr_offset, &max_scr,
+      &max_scr_offset);
+
+  if (min_scr == scr)
+    offset = min_scr_offset;
+  else
+    offset = find_offset (demux, scr, min_scr, min_scr_offset, max_scr,
+        max_scr_offset, 0);
 
   if (offset == (guint64) - 1) {
     return FALSE;
@@ -1718,6 +1913,16 @@ gst_ps_demux_parse_pack_start (GstPsDemux * demux)
   }
   new_rate *= MPEG_MUX_RATE_MULT;
 
+  /* index the packs while playing forward in pull mode */
+  if (demux->random_access && demux->sink_segment.rate >= 0.0 &&
+      demux->adapter_end_offset != G_MAXUINT64) {
+    demux->pack_scr = scr;
+    demux->pack_offset = demux->adapter_end_offset - avail;
+    gst_ps_demux_index_add (demux, scr, demux->pack_offset, FALSE);
+  } else {
+    demux->pack_offset = G_MAXUINT64;
+  }
+
   /* scr adjusted is the new scr found + the colected adjustment */
   scr_adjusted = scr + demux->scr_adjust;
 
@@ -2279,6 +2484,11 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
     goto done;
   }
 
+  if (first && demux->pack_offset != G_MAXUINT64 &&
+      gst_ps_demux_is_keyframe (demux->current_stream->type,
+          map.data + offset, datalen))
+    gst_ps_demux_index_add (demux, demux->pack_scr, demux->pack_offset, TRUE);
+
   /* After 2 seconds of bitstream emit no more pads */
   if (demux->need_no_more_pads
       && (demux->current_scr - demux->first_scr) > 2 * CLOCK_FREQ) {
@@ -3055,6 +3265,11 @@ gst_ps_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
   /* We keep the offset to interpolate SCR */
   demux->adapter_offset = GST_BUFFER_OFFSET (buffer);
+  if (GST_BUFFER_OFFSET_IS_VALID (buffer))
+    demux->adapter_end_offset =
+        GST_BUFFER_OFFSET (buffer) + gst_buffer_get_size (buffer);
+  else
+    demux->adapter_end_offset = G_MAXUINT64;
   gst_adapter_push (demux->adapter, buffer);
   demux->bytes_since_scr += gst_buffer_get_size (buffer);
   avail = gst_adapter_available (demux->rev_adapter);
@@ -61,6 +61,7 @@ G_BEGIN_DECLS
 #define GST_IS_PS_DEMUX_CLASS(obj)	(G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_PS_DEMUX))
 
 typedef struct _GstPsStream GstPsStream;
+typedef struct _GstPsDemuxIndexEntry GstPsDemuxIndexEntry;
 typedef struct _GstPsDemux GstPsDemux;
 typedef struct _GstPsDemuxClass GstPsDemuxClass;
 
@@ -102,6 +103,14 @@ struct _GstPsStream
   GstTagList *pending_tags;
 };
 
+/* A pack seen while playing or seeking in pull mode */
+struct _GstPsDemuxIndexEntry
+{
+  guint64 scr;
+  guint64 offset;
+  gboolean keyframe;            /* a video keyframe starts in this pack */
+};
+
 struct _GstPsDemux
 {
   GstElement parent;
@@ -137,6 +146,14 @@ struct _GstPsDemux
   guint64 first_pts;
   guint64 last_pts;
 
+  /* SCR index of GstPsDemuxIndexEntry, sorted by offset and SCR */
+  GArray *index;
+  /* file offset of the end of the adapter, and SCR and offset of the last
+   * pack in pull mode */
+  guint64 adapter_end_offset;
+  guint64 pack_scr;
+  guint64 pack_offset;
+
   gint16 psm[GST_PS_DEMUX_MAX_PSM];
 
   GstSegment sink_segment;
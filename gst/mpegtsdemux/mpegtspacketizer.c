@@ -61,6 +61,9 @@ static void record_pcr (MpegTSPacketizer2 * packetizer, MpegTSPCR * pcrtable,
 #define TABLE_ID_UNSET 0xFF
 #define PACKET_SYNC_BYTE 0x47
 
+/* Number of SI sections kept to avoid checking and parsing them again */
+#define SECTION_CACHE_SIZE 1024
+
 static inline MpegTSPCR *
 get_pcr_table (MpegTSPacketizer2 * packetizer, guint16 pid)
 {
@@ -289,6 +292,11 @@ mpegts_packetizer_dispose (GObject * object)
       g_free (packetizer->streams);
     }
 
+    if (packetizer->section_cache) {
+      gst_mpegts_section_cache_free (packetizer->section_cache);
+      packetizer->section_cache = NULL;
+    }
+
     gst_adapter_clear (packetizer->adapter);
     g_object_unref (packetizer->adapter);
     g_mutex_clear (&packetizer->group_lock);
@@ -548,6 +556,17 @@ mpegts_packetizer_parse_section_header (MpegTSPacketizer2 * packetizer,
      * */
     MPEGTS_BIT_SET (subtable->seen_section, stream->section_number);
     res->offset = stream->offset;
+
+    /* The DVB/ATSC SI tables all come again after every flush, let
+     * identical ones share their parsed tables. PSI tables are few and
+     * cheap to parse, so don't bother comparing those */
+    if (!res->short_section && res->table_id >=
+        GST_MTS_TABLE_ID_NETWORK_INFORMATION_ACTUAL_NETWORK) {
+      if (!packetizer->section_cache)
+        packetizer->section_cache =
+            gst_mpegts_section_cache_new (SECTION_CACHE_SIZE);
+      gst_mpegts_section_cache_add (packetizer->section_cache, res);
+    }
   }
 
   return res;
@@ -571,6 +590,11 @@ mpegts_packetizer_clear (MpegTSPacketizer2 * packetizer)
     memset (packetizer->streams, 0, 8192 * sizeof (MpegTSPacketizerStream *));
   }
 
+  if (packetizer->section_cache) {
+    gst_mpegts_section_cache_free (packetizer->section_cache);
+    packetizer->section_cache = NULL;
+  }
+
   gst_adapter_clear (packetizer->adapter);
   packetizer->offset = 0;
   packetizer->empty = TRUE;
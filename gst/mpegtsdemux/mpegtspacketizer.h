@@ -250,6 +250,8 @@ struct _MpegTSPacketizer2 {
   /* streams hashed by pid */
   /* FIXME : be more memory efficient (see how it's done in mpegtsbase) */
   MpegTSPacketizerStream **streams;
+  /* recently seen SI sections, created on first use */
+  GstMpegtsSectionCache *section_cache;
   gboolean    disposed;
   guint16     packet_size;
 
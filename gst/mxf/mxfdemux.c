@@ -71,14 +71,37 @@ GST_STATIC_PAD_TEMPLATE ("track_%u",
 GST_DEBUG_CATEGORY_STATIC (mxfdemux_debug);
 #define GST_CAT_DEFAULT mxfdemux_debug
 
+/* Size of the first read after a seek or a jump in pull mode. Subsequent
+ * sequential reads double it up to the read-ahead-size property */
+#define MIN_READ_BLOCK_SIZE (16 * 1024)
+
 static GstFlowReturn
 gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
     GstBuffer ** outbuf, guint * read);
 static GstFlowReturn
+gst_mxf_demux_peek_klv_packet (GstMXFDemux * demux, guint64 offset,
+    MXFUL * key, guint * read);
+static GstFlowReturn
 gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer, guint64 offset);
 
 static void collect_index_table_segments (GstMXFDemux * demux);
+static void gst_mxf_demux_clear_read_cache_locked (GstMXFDemux * demux);
+
+static gint16
+gst_mxf_demux_index_delta (guint64 position, guint64 value)
+{
+  gint64 delta;
+
+  if (value == G_MAXUINT64)
+    return GST_MXF_DEMUX_INDEX_NO_DELTA;
+
+  delta = (gint64) (value - position);
+  if (delta <= G_MININT16 || delta > G_MAXINT16)
+    return GST_MXF_DEMUX_INDEX_NO_DELTA;
+
+  return delta;
+}
 
 GType gst_mxf_demux_pad_get_type (void);
 G_DEFINE_TYPE (GstMXFDemuxPad, gst_mxf_demux_pad, GST_TYPE_PAD);
@@ -116,9 +139,14 @@ enum
   PROP_0,
   PROP_PACKAGE,
   PROP_MAX_DRIFT,
-  PROP_STRUCTURE
+  PROP_STRUCTURE,
+  PROP_READ_AHEAD_SIZE,
+  PROP_THREADED_READ_AHEAD
 };
 
+#define DEFAULT_READ_AHEAD_SIZE (2 * 1024 * 1024)
+#define DEFAULT_THREADED_READ_AHEAD FALSE
+
 static gboolean gst_mxf_demux_sink_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
 static gboolean gst_mxf_demux_src_event (GstPad * pad, GstObject * parent,
@@ -286,6 +314,7 @@ gst_mxf_demux_reset (GstMXFDemux * demux)
     for (l = demux->index_tables; l; l = l->next) {
       GstMXFDemuxIndexTable *t = l->data;
       g_array_free (t->offsets, TRUE);
+      g_array_free (t->edit_unit_offsets, TRUE);
       g_free (t);
     }
     g_list_free (demux->index_tables);
@@ -294,6 +323,10 @@ gst_mxf_demux_reset (GstMXFDemux * demux)
 
   demux->index_table_segments_collected = FALSE;
 
+  g_mutex_lock (&demux->read_lock);
+  gst_mxf_demux_clear_read_cache_locked (demux);
+  g_mutex_unlock (&demux->read_lock);
+
   gst_mxf_demux_reset_mxf_state (demux);
   gst_mxf_demux_reset_metadata (demux);
 
@@ -301,13 +334,272 @@ gst_mxf_demux_reset (GstMXFDemux * demux)
   demux->group_id = G_MAXUINT;
 }
 
+/* Returns the end offset for a read of at least size bytes at offset, moved
+ * to the start of the next edit unit from the index tables if that is close
+ * so that content packages are not split between two reads */
+static guint64
+gst_mxf_demux_plan_read (GstMXFDemux * demux, guint64 offset, guint size)
+{
+  guint64 end = offset + size, best = end;
+  GList *l;
+
+  if (demux->run_in == -1 || end <= demux->run_in)
+    return end;
+
+  for (l = demux->index_tables; l; l = l->next) {
+    GstMXFDemuxIndexTable *t = l->data;
+    GArray *offsets = t->edit_unit_offsets;
+    guint64 rel_end = end - demux->run_in, next;
+    guint lo = 0, hi = offsets->len;
+
+    /* first edit unit starting at or after the end of the read */
+    while (lo < hi) {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (g_array_index (offsets, guint64, mid) < rel_end)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    if (lo == 0 || lo == offsets->len)
+      continue;
+
+    next = g_array_index (offsets, guint64, lo) + demux->run_in;
+    if (next - end <= size && (best == end || next < best))
+      best = next;
+  }
+
+  return MIN (best, offset + G_MAXUINT);
+}
+
+static void
+gst_mxf_demux_clear_read_cache_locked (GstMXFDemux * demux)
+{
+  gst_buffer_replace (&demux->read_cache, NULL);
+  gst_buffer_replace (&demux->read_ahead_buffer, NULL);
+  demux->read_ahead_pending = FALSE;
+  demux->read_ahead_cookie++;
+  demux->read_block_size = MIN_READ_BLOCK_SIZE;
+}
+
+static gpointer
+gst_mxf_demux_read_ahead_thread (GstMXFDemux * demux)
+{
+  g_mutex_lock (&demux->read_lock);
+  while (demux->read_ahead_running) {
+    GstBuffer *buffer = NULL;
+    GstFlowReturn ret;
+    guint64 offset;
+    guint size, cookie;
+
+    if (!demux->read_ahead_pending) {
+      g_cond_wait (&demux->read_ahead_cond, &demux->read_lock);
+      continue;
+    }
+
+    offset = demux->read_ahead_request_offset;
+    size = demux->read_ahead_request_size;
+    cookie = demux->read_ahead_cookie;
+    demux->read_ahead_pending = FALSE;
+    demux->read_ahead_busy = TRUE;
+    g_mutex_unlock (&demux->read_lock);
+
+    GST_LOG_OBJECT (demux, "reading ahead %u bytes at offset %"
+        G_GUINT64_FORMAT, size, offset);
+    ret = gst_pad_pull_range (demux->sinkpad, offset, size, &buffer);
+
+    g_mutex_lock (&demux->read_lock);
+    demux->read_ahead_busy = FALSE;
+    if (ret == GST_FLOW_OK && cookie == demux->read_ahead_cookie) {
+      gst_buffer_replace (&demux->read_ahead_buffer, NULL);
+      demux->read_ahead_buffer = buffer;
+      demux->read_ahead_buffer_offset = offset;
+    } else if (buffer) {
+      gst_buffer_unref (buffer);
+    }
+    g_cond_broadcast (&demux->read_ahead_cond);
+  }
+  g_mutex_unlock (&demux->read_lock);
+
+  return NULL;
+}
+
+static void
+gst_mxf_demux_start_read_ahead (GstMXFDemux * demux)
+{
+  gboolean threaded;
+
+  GST_OBJECT_LOCK (demux);
+  threaded = demux->threaded_read_ahead && demux->read_ahead_size > 0;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (!threaded)
+    return;
+
+  g_mutex_lock (&demux->read_lock);
+  demux->read_ahead_running = TRUE;
+  g_mutex_unlock (&demux->read_lock);
+
+  demux->read_ahead_thread = g_thread_new ("mxfdemux-readahead",
+      (GThreadFunc) gst_mxf_demux_read_ahead_thread, demux);
+}
+
+static void
+gst_mxf_demux_stop_read_ahead (GstMXFDemux * demux)
+{
+  g_mutex_lock (&demux->read_lock);
+  demux->read_ahead_running = FALSE;
+  g_cond_broadcast (&demux->read_ahead_cond);
+  g_mutex_unlock (&demux->read_lock);
+
+  if (demux->read_ahead_thread) {
+    g_thread_join (demux->read_ahead_thread);
+    demux->read_ahead_thread = NULL;
+  }
+
+  g_mutex_lock (&demux->read_lock);
+  gst_mxf_demux_clear_read_cache_locked (demux);
+  g_mutex_unlock (&demux->read_lock);
+}
+
+/* Tries to serve a read from the read cache, refilling it with one large
+ * read of at most @read_ahead_size if necessary. Returns
+ * GST_FLOW_CUSTOM_SUCCESS if the read should go upstream directly instead */
+static GstFlowReturn
+gst_mxf_demux_pull_range_cached (GstMXFDemux * demux, guint64 offset,
+    guint size, guint read_ahead_size, GstBuffer ** buffer)
+{
+  GstFlowReturn ret;
+  GstBuffer *block = NULL;
+  guint64 block_offset = 0, end;
+  gsize block_size;
+  gboolean sequential;
+
+  if (demux->read_cache) {
+    guint64 cache_end =
+        demux->read_cache_offset + gst_buffer_get_size (demux->read_cache);
+
+    if (offset >= demux->read_cache_offset && offset + size <= cache_end)
+      goto hit;
+
+    sequential = offset >= demux->read_cache_offset && offset <= cache_end;
+  } else {
+    sequential = FALSE;
+  }
+
+  /* wait for the read-ahead worker if it is reading the next block */
+  while (demux->read_ahead_busy)
+    g_cond_wait (&demux->read_ahead_cond, &demux->read_lock);
+
+  if (demux->read_ahead_buffer) {
+    block = demux->read_ahead_buffer;
+    block_offset = demux->read_ahead_buffer_offset;
+    demux->read_ahead_buffer = NULL;
+
+    /* packets crossing into the prefetched block get the end of the
+     * current one prepended, without copying */
+    if (sequential && offset < block_offset && demux->read_cache
+        && block_offset == demux->read_cache_offset +
+        gst_buffer_get_size (demux->read_cache)) {
+      GstBuffer *tail = gst_buffer_copy_region (demux->read_cache,
+          GST_BUFFER_COPY_MEMORY, offset - demux->read_cache_offset,
+          block_offset - offset);
+
+      block = gst_buffer_append (tail, block);
+      block_offset = offset;
+    }
+
+    if (offset < block_offset
+        || offset + size > block_offset + gst_buffer_get_size (block)) {
+      gst_buffer_unref (block);
+      block = NULL;
+    }
+  }
+
+  if (sequential) {
+    demux->read_block_size =
+        MIN (demux->read_block_size * 2, read_ahead_size);
+  } else {
+    demux->read_block_size = MIN (MIN_READ_BLOCK_SIZE, read_ahead_size);
+  }
+
+  if (!block) {
+    /* big reads after a jump, e.g. when peeking essence elements while
+     * seeking, are not worth caching */
+    if (!sequential && size > demux->read_block_size)
+      return GST_FLOW_CUSTOM_SUCCESS;
+
+    end =
+        gst_mxf_demux_plan_read (demux, offset, MAX (size,
+            demux->read_block_size));
+
+    GST_LOG_OBJECT (demux, "reading %" G_GUINT64_FORMAT " bytes at offset %"
+        G_GUINT64_FORMAT " for %u bytes", end - offset, offset, size);
+    ret = gst_pad_pull_range (demux->sinkpad, offset, end - offset, &block);
+    if (ret != GST_FLOW_OK)
+      return ret;
+    block_offset = offset;
+  }
+
+  block_size = gst_buffer_get_size (block);
+  gst_buffer_replace (&demux->read_cache, NULL);
+  demux->read_cache = block;
+  demux->read_cache_offset = block_offset;
+
+  /* a short read means we hit the end of the file */
+  if (offset + size > block_offset + block_size) {
+    GST_WARNING_OBJECT (demux,
+        "partial pull got %" G_GSIZE_FORMAT " when expecting %u from offset %"
+        G_GUINT64_FORMAT, block_size, size, offset);
+    return GST_FLOW_EOS;
+  }
+
+  /* prefetch the following block while this one is being parsed, unless
+   * this one was short and thus hit the end of the file */
+  if (demux->read_ahead_running && sequential && block_size >= size
+      && block_size >= demux->read_block_size) {
+    guint64 next = block_offset + block_size;
+
+    end = gst_mxf_demux_plan_read (demux, next, demux->read_block_size);
+    demux->read_ahead_request_offset = next;
+    demux->read_ahead_request_size = end - next;
+    demux->read_ahead_pending = TRUE;
+    g_cond_broadcast (&demux->read_ahead_cond);
+  }
+
+hit:
+  *buffer =
+      gst_buffer_copy_region (demux->read_cache, GST_BUFFER_COPY_MEMORY,
+      offset - demux->read_cache_offset, size);
+  GST_BUFFER_OFFSET (*buffer) = offset;
+  GST_BUFFER_OFFSET_END (*buffer) = offset + size;
+
+  return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 gst_mxf_demux_pull_range (GstMXFDemux * demux, guint64 offset,
     guint size, GstBuffer ** buffer)
 {
-  GstFlowReturn ret;
+  GstFlowReturn ret = GST_FLOW_CUSTOM_SUCCESS;
+  guint read_ahead_size;
+
+  /* the property can be changed at any time */
+  GST_OBJECT_LOCK (demux);
+  read_ahead_size = demux->read_ahead_size;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (read_ahead_size > 0) {
+    g_mutex_lock (&demux->read_lock);
+    ret = gst_mxf_demux_pull_range_cached (demux, offset, size,
+        read_ahead_size, buffer);
+    g_mutex_unlock (&demux->read_lock);
+  }
+
+  if (ret == GST_FLOW_CUSTOM_SUCCESS)
+    ret = gst_pad_pull_range (demux->sinkpad, offset, size, buffer);
 
-  ret = gst_pad_pull_range (demux->sinkpad, offset, size, buffer);
   if (G_UNLIKELY (ret != GST_FLOW_OK)) {
     GST_WARNING_OBJECT (demux,
         "failed when pulling %u bytes from offset %" G_GUINT64_FORMAT ": %s",
@@ -1771,10 +2063,12 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
         &g_array_index (etrack->offsets, GstMXFDemuxIndex, etrack->position);
     if (index->initialized && index->offset != 0)
       keyframe = index->keyframe;
-    if (index->initialized && index->pts != G_MAXUINT64)
-      pts = index->pts;
-    if (index->initialized && index->dts != G_MAXUINT64)
-      dts = index->dts;
+    if (index->initialized
+        && index->pts_delta != GST_MXF_DEMUX_INDEX_NO_DELTA)
+      pts = etrack->position + index->pts_delta;
+    if (index->initialized
+        && index->dts_delta != GST_MXF_DEMUX_INDEX_NO_DELTA)
+      dts = etrack->position + index->dts_delta;
   }
 
   /* Create subbuffer to be able to change metadata */
@@ -1839,10 +2133,12 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
         }
       }
 
-      if (index->initialized && index->pts != G_MAXUINT64)
-        pts = index->pts;
-      if (index->initialized && index->dts != G_MAXUINT64)
-        dts = index->dts;
+      if (index->initialized
+          && index->pts_delta != GST_MXF_DEMUX_INDEX_NO_DELTA)
+        pts = etrack->position + index->pts_delta;
+      if (index->initialized
+          && index->dts_delta != GST_MXF_DEMUX_INDEX_NO_DELTA)
+        dts = etrack->position + index->dts_delta;
     }
   }
 
@@ -1856,16 +2152,16 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
 
       index->offset = demux->offset - demux->run_in;
       index->initialized = TRUE;
-      index->pts = pts;
-      index->dts = dts;
+      index->pts_delta = gst_mxf_demux_index_delta (etrack->position, pts);
+      index->dts_delta = gst_mxf_demux_index_delta (etrack->position, dts);
       index->keyframe = keyframe;
     } else if (etrack->position < G_MAXINT) {
       GstMXFDemuxIndex index;
 
       index.offset = demux->offset - demux->run_in;
       index.initialized = TRUE;
-      index.pts = pts;
-      index.dts = dts;
+      index.pts_delta = gst_mxf_demux_index_delta (etrack->position, pts);
+      index.dts_delta = gst_mxf_demux_index_delta (etrack->position, dts);
       index.keyframe = keyframe;
       if (etrack->offsets->len < etrack->position)
         g_array_set_size (etrack->offsets, etrack->position + 1);
@@ -2099,31 +2395,30 @@ read_partition_header (GstMXFDemux * demux)
   demux->offset += read;
   gst_buffer_unref (buf);
 
-  if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
+  /* Only the keys and lengths of everything but the index table segments
+   * are needed here, so don't pull the packet contents */
+  if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key, &read)
       != GST_FLOW_OK)
     return;
 
   while (mxf_is_fill (&key)) {
     demux->offset += read;
-    gst_buffer_unref (buf);
-    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
+    if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key, &read)
         != GST_FLOW_OK)
       return;
   }
 
   if (!mxf_is_index_table_segment (&key)
       && demux->current_partition->partition.header_byte_count) {
-    gst_buffer_unref (buf);
     demux->offset += demux->current_partition->partition.header_byte_count;
-    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
+    if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key, &read)
         != GST_FLOW_OK)
       return;
   }
 
   while (mxf_is_fill (&key)) {
     demux->offset += read;
-    gst_buffer_unref (buf);
-    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
+    if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key, &read)
         != GST_FLOW_OK)
       return;
   }
@@ -2135,14 +2430,16 @@ read_partition_header (GstMXFDemux * demux)
 
     while (demux->offset < index_end_offset) {
       if (mxf_is_index_table_segment (&key)) {
+        if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf,
+                &read) != GST_FLOW_OK)
+          return;
         gst_mxf_demux_handle_index_table_segment (demux, &key, buf,
             demux->offset);
+        gst_buffer_unref (buf);
       }
       demux->offset += read;
 
-      gst_buffer_unref (buf);
-      if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf,
-              &read)
+      if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key, &read)
           != GST_FLOW_OK)
         return;
     }
@@ -2150,8 +2447,7 @@ read_partition_header (GstMXFDemux * demux)
 
   while (mxf_is_fill (&key)) {
     demux->offset += read;
-    gst_buffer_unref (buf);
-    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
+    if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key, &read)
         != GST_FLOW_OK)
       return;
   }
@@ -2164,8 +2460,6 @@ read_partition_header (GstMXFDemux * demux)
           demux->offset - demux->current_partition->partition.this_partition -
           demux->run_in;
   }
-
-  gst_buffer_unref (buf);
 }
 
 static GstFlowReturn
@@ -2271,14 +2565,14 @@ gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
   return GST_FLOW_OK;
 }
 
+/* Reads the key and length of the KLV packet at offset. data_offset is set
+ * to the size of key and length */
 static GstFlowReturn
-gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
-    GstBuffer ** outbuf, guint * read)
+gst_mxf_demux_pull_klv_header (GstMXFDemux * demux, guint64 offset,
+    MXFUL * key, guint * data_offset, guint64 * length)
 {
   GstBuffer *buffer = NULL;
   const guint8 *data;
-  guint64 data_offset = 0;
-  guint64 length;
   GstFlowReturn ret = GST_FLOW_OK;
   GstMapInfo map;
 #ifndef GST_DISABLE_GST_DEBUG
@@ -2301,12 +2595,12 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
 
   /* Decode BER encoded packet length */
   if ((map.data[16] & 0x80) == 0) {
-    length = map.data[16];
-    data_offset = 17;
+    *length = map.data[16];
+    *data_offset = 17;
   } else {
     guint slen = map.data[16] & 0x7f;
 
-    data_offset = 16 + 1 + slen;
+    *data_offset = 16 + 1 + slen;
 
     gst_buffer_unmap (buffer, &map);
     gst_buffer_unref (buffer);
@@ -2327,9 +2621,9 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
     gst_buffer_map (buffer, &map, GST_MAP_READ);
 
     data = map.data;
-    length = 0;
+    *length = 0;
     while (slen) {
-      length = (length << 8) | *data;
+      *length = (*length << 8) | *data;
       data++;
       slen--;
     }
@@ -2341,30 +2635,61 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
 
   /* GStreamer's buffer sizes are stored in a guint so we
    * limit ourself to G_MAXUINT large buffers */
-  if (length > G_MAXUINT) {
+  if (*length > G_MAXUINT) {
     GST_ERROR_OBJECT (demux,
-        "Unsupported KLV packet length: %" G_GUINT64_FORMAT, length);
+        "Unsupported KLV packet length: %" G_GUINT64_FORMAT, *length);
     ret = GST_FLOW_ERROR;
     goto beach;
   }
 
   GST_DEBUG_OBJECT (demux, "KLV packet with key %s has length "
-      "%" G_GUINT64_FORMAT, mxf_ul_to_string (key, str), length);
+      "%" G_GUINT64_FORMAT, mxf_ul_to_string (key, str), *length);
+
+beach:
+  if (buffer)
+    gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_mxf_demux_peek_klv_packet (GstMXFDemux * demux, guint64 offset,
+    MXFUL * key, guint * read)
+{
+  GstFlowReturn ret;
+  guint data_offset;
+  guint64 length;
+
+  ret = gst_mxf_demux_pull_klv_header (demux, offset, key, &data_offset,
+      &length);
+  if (ret == GST_FLOW_OK)
+    *read = data_offset + length;
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
+    GstBuffer ** outbuf, guint * read)
+{
+  GstBuffer *buffer = NULL;
+  guint data_offset = 0;
+  guint64 length;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if ((ret = gst_mxf_demux_pull_klv_header (demux, offset, key, &data_offset,
+              &length)) != GST_FLOW_OK)
+    return ret;
 
   /* Pull the complete KLV packet */
   if ((ret = gst_mxf_demux_pull_range (demux, offset + data_offset, length,
               &buffer)) != GST_FLOW_OK)
-    goto beach;
+    return ret;
 
   *outbuf = buffer;
-  buffer = NULL;
   if (read)
     *read = data_offset + length;
 
-beach:
-  if (buffer)
-    gst_buffer_unref (buffer);
-
   return ret;
 }
 
@@ -3663,6 +3988,16 @@ no_new_offset:
   }
 }
 
+static gint
+gst_mxf_demux_offset_compare (const guint64 * a, const guint64 * b)
+{
+  if (*a < *b)
+    return -1;
+  else if (*a > *b)
+    return 1;
+  return 0;
+}
+
 static void
 collect_index_table_segments (GstMXFDemux * demux)
 {
@@ -3711,6 +4046,7 @@ collect_index_table_segments (GstMXFDemux * demux)
       t->body_sid = segment->body_sid;
       t->index_sid = segment->index_sid;
       t->offsets = g_array_new (FALSE, TRUE, sizeof (GstMXFDemuxIndex));
+      t->edit_unit_offsets = g_array_new (FALSE, FALSE, sizeof (guint64));
       demux->index_tables = g_list_prepend (demux->index_tables, t);
     }
 
@@ -3719,6 +4055,7 @@ collect_index_table_segments (GstMXFDemux * demux)
     if (end > G_MAXINT / sizeof (GstMXFDemuxIndex)) {
       demux->index_tables = g_list_remove (demux->index_tables, t);
       g_array_free (t->offsets, TRUE);
+      g_array_free (t->edit_unit_offsets, TRUE);
       g_free (t);
       continue;
     }
@@ -3766,39 +4103,59 @@ collect_index_table_segments (GstMXFDemux * demux)
               (temporal_offset < 0 && start + i >= -(gint) temporal_offset)) {
             pts_i = start + i + temporal_offset;
 
-            if (t->offsets->len < pts_i)
+            if (t->offsets->len <= pts_i)
               g_array_set_size (t->offsets, pts_i + 1);
 
             index = &g_array_index (t->offsets, GstMXFDemuxIndex, pts_i);
             if (!index->initialized) {
               index->initialized = TRUE;
               index->offset = 0;
-              index->pts = G_MAXUINT64;
-              index->dts = G_MAXUINT64;
+              index->pts_delta = GST_MXF_DEMUX_INDEX_NO_DELTA;
+              index->dts_delta = GST_MXF_DEMUX_INDEX_NO_DELTA;
               index->keyframe = FALSE;
             }
 
-            index->pts = start + i;
+            index->pts_delta = -temporal_offset;
           }
 
           index = &g_array_index (t->offsets, GstMXFDemuxIndex, start + i);
           if (!index->initialized) {
             index->initialized = TRUE;
             index->offset = 0;
-            index->pts = G_MAXUINT64;
-            index->dts = G_MAXUINT64;
+            index->pts_delta = GST_MXF_DEMUX_INDEX_NO_DELTA;
+            index->dts_delta = GST_MXF_DEMUX_INDEX_NO_DELTA;
             index->keyframe = FALSE;
           }
 
           index->offset = offset;
           index->keyframe = ! !(segment->index_entries[i].flags & 0x80)
               || (segment->index_entries[i].key_frame_offset == 0);
-          index->dts = pts_i;
+          index->dts_delta = gst_mxf_demux_index_delta (start + i, pts_i);
+          g_array_append_val (t->edit_unit_offsets, offset);
         }
       }
     }
   }
 
+  for (l = demux->index_tables; l; l = l->next) {
+    GstMXFDemuxIndexTable *t = l->data;
+    GArray *offsets = t->edit_unit_offsets;
+    guint n = 0;
+
+    g_array_sort (offsets, (GCompareFunc) gst_mxf_demux_offset_compare);
+    for (i = 0; i < offsets->len; i++) {
+      if (n == 0 || g_array_index (offsets, guint64, n - 1)
+          != g_array_index (offsets, guint64, i))
+        g_array_index (offsets, guint64, n++) =
+            g_array_index (offsets, guint64, i);
+    }
+    g_array_set_size (offsets, n);
+
+    GST_DEBUG_OBJECT (demux, "Index table for body SID %u, index SID %u "
+        "has %u entries and %u edit units", t->body_sid, t->index_sid,
+        t->offsets->len, n);
+  }
+
   for (l = demux->pending_index_table_segments; l; l = l->next) {
     MXFIndexTableSegment *s = l->data;
     mxf_index_table_segment_reset (s);
@@ -3860,6 +4217,11 @@ gst_mxf_demux_seek_pull (GstMXFDemux * demux, GstEvent * event)
   /* Take the stream lock */
   GST_PAD_STREAM_LOCK (demux->sinkpad);
 
+  /* Whatever was read ahead is most likely useless now */
+  g_mutex_lock (&demux->read_lock);
+  gst_mxf_demux_clear_read_cache_locked (demux);
+  g_mutex_unlock (&demux->read_lock);
+
   if (flush) {
     GstEvent *e;
 
@@ -4236,11 +4598,16 @@ gst_mxf_demux_sink_activate_mode (GstPad * sinkpad, GstObject * parent,
   } else {
     if (active) {
       demux->random_access = TRUE;
+      gst_mxf_demux_start_read_ahead (demux);
       return gst_pad_start_task (sinkpad, (GstTaskFunction) gst_mxf_demux_loop,
           sinkpad, NULL);
     } else {
+      gboolean ret;
+
       demux->random_access = FALSE;
-      return gst_pad_stop_task (sinkpad);
+      ret = gst_pad_stop_task (sinkpad);
+      gst_mxf_demux_stop_read_ahead (demux);
+      return ret;
     }
   }
 
@@ -4549,6 +4916,16 @@ gst_mxf_demux_set_property (GObject * object, guint prop_id,
     case PROP_MAX_DRIFT:
       demux->max_drift = g_value_get_uint64 (value);
       break;
+    case PROP_READ_AHEAD_SIZE:
+      GST_OBJECT_LOCK (demux);
+      demux->read_ahead_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_THREADED_READ_AHEAD:
+      GST_OBJECT_LOCK (demux);
+      demux->threaded_read_ahead = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -4568,6 +4945,16 @@ gst_mxf_demux_get_property (GObject * object, guint prop_id,
     case PROP_MAX_DRIFT:
       g_value_set_uint64 (value, demux->max_drift);
       break;
+    case PROP_READ_AHEAD_SIZE:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint (value, demux->read_ahead_size);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_THREADED_READ_AHEAD:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_boolean (value, demux->threaded_read_ahead);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     case PROP_STRUCTURE:{
       GstStructure *s;
 
@@ -4628,6 +5015,8 @@ gst_mxf_demux_finalize (GObject * object)
   g_hash_table_destroy (demux->metadata);
 
   g_rw_lock_clear (&demux->metadata_lock);
+  g_mutex_clear (&demux->read_lock);
+  g_cond_clear (&demux->read_ahead_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -4662,6 +5051,21 @@ gst_mxf_demux_class_init (GstMXFDemuxClass * klass)
           "Structural metadata of the MXF file",
           GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_READ_AHEAD_SIZE,
+      g_param_spec_uint ("read-ahead-size", "Read-ahead size",
+          "Maximum number of bytes to read from upstream at once in pull "
+          "mode, reads are extended to edit unit boundaries from the index "
+          "tables (0 = read every KLV packet separately)",
+          0, 256 * 1024 * 1024, DEFAULT_READ_AHEAD_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_THREADED_READ_AHEAD,
+      g_param_spec_boolean ("threaded-read-ahead", "Threaded read-ahead",
+          "Read the next block from upstream in a separate thread while the "
+          "current one is demuxed in pull mode",
+          DEFAULT_THREADED_READ_AHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_mxf_demux_change_state);
   gstelement_class->query = GST_DEBUG_FUNCPTR (gst_mxf_demux_query);
@@ -4693,10 +5097,14 @@ gst_mxf_demux_init (GstMXFDemux * demux)
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 
   demux->max_drift = 500 * GST_MSECOND;
+  demux->read_ahead_size = DEFAULT_READ_AHEAD_SIZE;
+  demux->threaded_read_ahead = DEFAULT_THREADED_READ_AHEAD;
 
   demux->adapter = gst_adapter_new ();
   demux->flowcombiner = gst_flow_combiner_new ();
   g_rw_lock_init (&demux->metadata_lock);
+  g_mutex_init (&demux->read_lock);
+  g_cond_init (&demux->read_ahead_cond);
 
   demux->src = g_ptr_array_new ();
   demux->essence_tracks =
@@ -84,19 +84,25 @@ typedef struct
   gboolean intra_only;
 } GstMXFDemuxEssenceTrack;
 
+/* Marks an unknown PTS/DTS in GstMXFDemuxIndex */
+#define GST_MXF_DEMUX_INDEX_NO_DELTA G_MININT16
+
 typedef struct
 {
   /* 0 if uninitialized */
   guint64 offset;
 
-  /* PTS edit unit number or G_MAXUINT64 */
-  guint64 pts;
+  /* PTS edit unit number relative to the position of this entry or
+   * GST_MXF_DEMUX_INDEX_NO_DELTA. Temporal offsets in index tables are 8 bit
+   * so this always fits */
+  gint16 pts_delta;
 
-  /* DTS edit unit number if we got here via PTS */
-  guint64 dts;
+  /* DTS edit unit number if we got here via PTS, relative to the position of
+   * this entry or GST_MXF_DEMUX_INDEX_NO_DELTA */
+  gint16 dts_delta;
 
-  gboolean keyframe;
-  gboolean initialized;
+  guint8 keyframe;
+  guint8 initialized;
 } GstMXFDemuxIndex;
 
 typedef struct
@@ -106,6 +112,10 @@ typedef struct
 
   /* offsets indexed by DTS */
   GArray *offsets;
+
+  /* sorted, unique offsets of all edit units in this table, used for
+   * planning reads along edit unit boundaries */
+  GArray *edit_unit_offsets;
 } GstMXFDemuxIndexTable;
 
 struct _GstMXFDemuxPad
@@ -205,9 +215,30 @@ struct _GstMXFDemux
 
   GstTagList *tags;
 
+  /* Pull mode read cache, protected by read_lock */
+  GMutex read_lock;
+  GstBuffer *read_cache;
+  guint64 read_cache_offset;
+  guint read_block_size;
+
+  /* Read-ahead worker, protected by read_lock */
+  GThread *read_ahead_thread;
+  GCond read_ahead_cond;
+  gboolean read_ahead_running;
+  guint read_ahead_cookie;
+  gboolean read_ahead_pending;
+  guint64 read_ahead_request_offset;
+  guint read_ahead_request_size;
+  gboolean read_ahead_busy;
+  GstBuffer *read_ahead_buffer;
+  guint64 read_ahead_buffer_offset;
+
   /* Properties */
   gchar *requested_package_string;
   GstClockTime max_drift;
+  /* protected by the object lock */
+  guint read_ahead_size;
+  gboolean threaded_read_ahead;
 };
 
 struct _GstMXFDemuxClass
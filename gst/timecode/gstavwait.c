@@ -243,16 +243,24 @@ gst_avwait_init (GstAvWait * self)
 
   self->running_time_to_wait_for = GST_CLOCK_TIME_NONE;
   self->last_seen_video_running_time = GST_CLOCK_TIME_NONE;
-  self->last_seen_tc = NULL;
+  self->have_last_seen_tc = FALSE;
 
   self->video_eos_flag = FALSE;
   self->audio_flush_flag = FALSE;
   self->shutdown_flag = FALSE;
   self->dropping = TRUE;
   self->tc = gst_video_time_code_new_empty ();
+  self->tc_index = G_MAXUINT64;
   self->end_tc = NULL;
+  self->end_tc_index = G_MAXUINT64;
   self->running_time_to_end_at = GST_CLOCK_TIME_NONE;
 
+  self->gate.start = GST_CLOCK_TIME_NONE;
+  self->gate.end = GST_CLOCK_TIME_NONE;
+  self->gate.video_running_time = GST_CLOCK_TIME_NONE;
+  self->gate.vsign = 1;
+  self->audio_window_valid = FALSE;
+
   self->target_running_time = DEFAULT_TARGET_RUNNING_TIME;
   self->mode = DEFAULT_MODE;
 
@@ -274,6 +282,83 @@ gst_avwait_send_element_message (GstAvWait * self, gboolean dropping,
   }
 }
 
+/* Index of a timecode that orders it among the timecodes of the same frame
+ * rate, or G_MAXUINT64 if it is not valid */
+static guint64
+gst_avwait_timecode_index (const GstVideoTimeCode * tc)
+{
+  if (tc == NULL || !gst_video_time_code_is_valid (tc))
+    return G_MAXUINT64;
+
+  return gst_video_time_code_frames_since_daily_jam (tc) * 3 + tc->field_count;
+}
+
+/* Called with the mutex after the target or end timecode or their frame rate
+ * changed */
+static void
+gst_avwait_update_timecode_index (GstAvWait * self)
+{
+  self->tc_index = gst_avwait_timecode_index (self->tc);
+  self->end_tc_index = gst_avwait_timecode_index (self->end_tc);
+}
+
+/* Compares the timecode of a frame with the target or end timecode. They
+ * usually have the same frame rate, then only the frame's index needs to be
+ * computed and compared with the target's */
+static gint
+gst_avwait_compare_timecode (const GstVideoTimeCode * tc,
+    const GstVideoTimeCode * target, guint64 target_index)
+{
+  guint64 index;
+
+  if (target_index != G_MAXUINT64
+      && tc->config.fps_n == target->config.fps_n
+      && tc->config.fps_d == target->config.fps_d
+      && tc->config.flags == target->config.flags
+      && (tc->config.latest_daily_jam == NULL
+          || target->config.latest_daily_jam == NULL)) {
+    index = gst_avwait_timecode_index (tc);
+    if (index != G_MAXUINT64)
+      return index < target_index ? -1 : (index > target_index ? 1 : 0);
+  }
+
+  return gst_video_time_code_compare (tc, target);
+}
+
+/* Publishes the state the audio thread needs and wakes it up if it waits.
+ * Called with the mutex after changing any of it. The video only moving
+ * ahead keeps the window of the audio thread valid, as it then only gets
+ * wider */
+static void
+gst_avwait_publish_gate (GstAvWait * self)
+{
+  GstClockTime video_running_time = GST_CLOCK_TIME_NONE;
+  gint vsign = 1;
+
+  if (self->vsegment.format == GST_FORMAT_TIME) {
+    vsign =
+        gst_segment_to_running_time_full (&self->vsegment, GST_FORMAT_TIME,
+        self->vsegment.position, &video_running_time);
+    if (vsign == 0)
+      video_running_time = GST_CLOCK_TIME_NONE;
+  }
+
+  if (self->gate.start != self->running_time_to_wait_for
+      || self->gate.end != self->running_time_to_end_at
+      || video_running_time == GST_CLOCK_TIME_NONE || vsign < 0
+      || (self->gate.video_running_time != GST_CLOCK_TIME_NONE
+          && self->gate.vsign > 0
+          && video_running_time < self->gate.video_running_time))
+    g_atomic_int_set (&self->audio_window_valid, FALSE);
+
+  self->gate.start = self->running_time_to_wait_for;
+  self->gate.end = self->running_time_to_end_at;
+  self->gate.video_running_time = video_running_time;
+  self->gate.vsign = vsign;
+
+  g_cond_signal (&self->cond);
+}
+
 static GstStateChangeReturn
 gst_avwait_change_state (GstElement * element, GstStateChange transition)
 {
@@ -283,15 +368,15 @@ gst_avwait_change_state (GstElement * element, GstStateChange transition)
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       g_mutex_lock (&self->mutex);
-      self->shutdown_flag = TRUE;
+      g_atomic_int_set (&self->shutdown_flag, TRUE);
       g_cond_signal (&self->cond);
       g_mutex_unlock (&self->mutex);
       break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
       g_mutex_lock (&self->mutex);
-      self->shutdown_flag = FALSE;
-      self->video_eos_flag = FALSE;
-      self->audio_flush_flag = FALSE;
+      g_atomic_int_set (&self->shutdown_flag, FALSE);
+      g_atomic_int_set (&self->video_eos_flag, FALSE);
+      g_atomic_int_set (&self->audio_flush_flag, FALSE);
       g_mutex_unlock (&self->mutex);
     default:
       break;
@@ -317,7 +402,8 @@ gst_avwait_change_state (GstElement * element, GstStateChange transition)
       self->vsegment.position = GST_CLOCK_TIME_NONE;
       gst_video_info_init (&self->vinfo);
       self->last_seen_video_running_time = GST_CLOCK_TIME_NONE;
-      self->last_seen_tc = NULL;
+      self->have_last_seen_tc = FALSE;
+      gst_avwait_publish_gate (self);
       g_mutex_unlock (&self->mutex);
       break;
     default:
@@ -390,6 +476,7 @@ gst_avwait_set_property (GObject * object, guint prop_id,
 {
   GstAvWait *self = GST_AVWAIT (object);
 
+  g_mutex_lock (&self->mutex);
   switch (prop_id) {
     case PROP_TARGET_TIME_CODE_STRING:{
       gchar **parts;
@@ -403,7 +490,7 @@ gst_avwait_set_property (GObject * object, guint prop_id,
             "Error: Could not parse timecode %s. Please input a timecode in the form 00:00:00:00",
             tc_str);
         g_strfreev (parts);
-        return;
+        break;
       }
       hours = g_ascii_strtoll (parts[0], NULL, 10);
       minutes = g_ascii_strtoll (parts[1], NULL, 10);
@@ -503,9 +590,9 @@ gst_avwait_set_property (GObject * object, guint prop_id,
       if (self->mode != old_mode) {
         switch (self->mode) {
           case MODE_TIMECODE:
-            if (self->last_seen_tc && self->tc &&
-                gst_video_time_code_compare (self->last_seen_tc,
-                    self->tc) < 0) {
+            if (self->have_last_seen_tc && self->tc &&
+                gst_avwait_compare_timecode (&self->last_seen_tc, self->tc,
+                    self->tc_index) < 0) {
               self->running_time_to_wait_for = GST_CLOCK_TIME_NONE;
               self->dropping = TRUE;
               gst_avwait_send_element_message (self, TRUE, GST_CLOCK_TIME_NONE);
@@ -531,6 +618,9 @@ gst_avwait_set_property (GObject * object, guint prop_id,
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  gst_avwait_update_timecode_index (self);
+  gst_avwait_publish_gate (self);
+  g_mutex_unlock (&self->mutex);
 }
 
 static gboolean
@@ -559,6 +649,7 @@ gst_avwait_vsink_event (GstPad * pad, GstObject * parent, GstEvent * event)
         }
       }
       self->vsegment.position = GST_CLOCK_TIME_NONE;
+      gst_avwait_publish_gate (self);
       g_mutex_unlock (&self->mutex);
       break;
     case GST_EVENT_GAP:
@@ -566,7 +657,7 @@ gst_avwait_vsink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       return TRUE;
     case GST_EVENT_EOS:
       g_mutex_lock (&self->mutex);
-      self->video_eos_flag = TRUE;
+      g_atomic_int_set (&self->video_eos_flag, TRUE);
       g_cond_signal (&self->cond);
       g_mutex_unlock (&self->mutex);
       break;
@@ -583,6 +674,7 @@ gst_avwait_vsink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       }
       gst_segment_init (&self->vsegment, GST_FORMAT_UNDEFINED);
       self->vsegment.position = GST_CLOCK_TIME_NONE;
+      gst_avwait_publish_gate (self);
       g_mutex_unlock (&self->mutex);
       break;
     case GST_EVENT_CAPS:{
@@ -603,6 +695,7 @@ gst_avwait_vsink_event (GstPad * pad, GstObject * parent, GstEvent * event)
         self->end_tc->config.fps_n = self->vinfo.fps_n;
         self->end_tc->config.fps_d = self->vinfo.fps_d;
       }
+      gst_avwait_update_timecode_index (self);
       g_mutex_unlock (&self->mutex);
       break;
     }
@@ -632,13 +725,13 @@ gst_avwait_asink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       break;
     case GST_EVENT_FLUSH_START:
       g_mutex_lock (&self->mutex);
-      self->audio_flush_flag = TRUE;
+      g_atomic_int_set (&self->audio_flush_flag, TRUE);
       g_cond_signal (&self->cond);
       g_mutex_unlock (&self->mutex);
       break;
     case GST_EVENT_FLUSH_STOP:
       g_mutex_lock (&self->mutex);
-      self->audio_flush_flag = FALSE;
+      g_atomic_int_set (&self->audio_flush_flag, FALSE);
       gst_segment_init (&self->asegment, GST_FORMAT_UNDEFINED);
       self->asegment.position = GST_CLOCK_TIME_NONE;
       g_mutex_unlock (&self->mutex);
@@ -686,14 +779,18 @@ gst_avwait_vsink_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
   tc_meta = gst_buffer_get_video_time_code_meta (inbuf);
   if (tc_meta) {
     tc = &tc_meta->tc;
-    self->last_seen_tc = tc;
+    /* the meta goes away with the buffer, keep a copy without the daily jam
+     * for comparing with it later */
+    self->last_seen_tc = *tc;
+    self->last_seen_tc.config.latest_daily_jam = NULL;
+    self->have_last_seen_tc = TRUE;
   }
   switch (self->mode) {
     case MODE_TIMECODE:{
       if (self->tc != NULL && tc != NULL) {
         gboolean emit_passthrough_signal = FALSE;
-        if (gst_video_time_code_compare (tc, self->tc) < 0
-            && self->running_time_to_wait_for == GST_CLOCK_TIME_NONE) {
+        if (self->running_time_to_wait_for == GST_CLOCK_TIME_NONE
+            && gst_avwait_compare_timecode (tc, self->tc, self->tc_index) < 0) {
           GST_DEBUG_OBJECT (self, "Timecode not yet reached, ignoring frame");
           gst_buffer_unref (inbuf);
           inbuf = NULL;
@@ -708,7 +805,9 @@ gst_avwait_vsink_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
               gst_segment_to_running_time (&self->vsegment, GST_FORMAT_TIME,
               self->vsegment.position);
         }
-        if (self->end_tc && gst_video_time_code_compare (tc, self->end_tc) >= 0) {
+        if (self->end_tc
+            && gst_avwait_compare_timecode (tc, self->end_tc,
+                self->end_tc_index) >= 0) {
           if (self->running_time_to_end_at == GST_CLOCK_TIME_NONE) {
             GST_INFO_OBJECT (self, "End timecode reached at %" GST_TIME_FORMAT,
                 GST_TIME_ARGS (self->vsegment.position));
@@ -764,7 +863,7 @@ gst_avwait_vsink_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
       break;
     }
   }
-  g_cond_signal (&self->cond);
+  gst_avwait_publish_gate (self);
   g_mutex_unlock (&self->mutex);
   if (inbuf)
     return gst_pad_push (self->vsrcpad, inbuf);
@@ -790,63 +889,59 @@ gst_avwait_compare_guint64_with_signs (gint sign1,
     return num1 > num2 ? sign1 : -sign1;
 }
 
+/* Whether audio at the given running time has to wait for the video. The
+ * flags are only set with the mutex, but can be read without it */
+static gboolean
+gst_avwait_audio_must_wait (GstAvWait * self, const GstAvWaitGate * gate,
+    gint asign, GstClockTime running_time)
+{
+  if (g_atomic_int_get (&self->video_eos_flag)
+      || g_atomic_int_get (&self->audio_flush_flag)
+      || g_atomic_int_get (&self->shutdown_flag))
+    return FALSE;
+
+  /* Start at timecode */
+  /* Wait if we haven't received video yet */
+  return gate->video_running_time == GST_CLOCK_TIME_NONE
+      /* Wait if audio is after the video: dunno what to do */
+      || gst_avwait_compare_guint64_with_signs (asign, running_time,
+      gate->vsign, gate->video_running_time) == 1
+      /* Wait if we don't even know what to wait for yet */
+      || gate->start == GST_CLOCK_TIME_NONE;
+}
+
 static GstFlowReturn
 gst_avwait_asink_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
 {
   GstClockTime timestamp;
   GstAvWait *self = GST_AVWAIT (parent);
   GstClockTime current_running_time;
-  GstClockTime video_running_time = GST_CLOCK_TIME_NONE;
   GstClockTime duration;
   GstClockTime running_time_at_end = GST_CLOCK_TIME_NONE;
-  gint asign, vsign = 1, esign = 1;
+  GstAvWaitGate gate;
+  gint asign, esign = 1;
 
   timestamp = GST_BUFFER_TIMESTAMP (inbuf);
   if (timestamp == GST_CLOCK_TIME_NONE) {
     gst_buffer_unref (inbuf);
     return GST_FLOW_ERROR;
   }
-  g_mutex_lock (&self->mutex);
+  /* The audio segment is only changed from the audio streaming thread, so
+   * it doesn't need the mutex here */
   self->asegment.position = timestamp;
   asign =
       gst_segment_to_running_time_full (&self->asegment, GST_FORMAT_TIME,
       self->asegment.position, &current_running_time);
   if (asign == 0) {
-    g_mutex_unlock (&self->mutex);
     gst_buffer_unref (inbuf);
     GST_ERROR_OBJECT (self, "Could not get current running time");
     return GST_FLOW_ERROR;
   }
-  if (self->vsegment.format == GST_FORMAT_TIME) {
-    vsign =
-        gst_segment_to_running_time_full (&self->vsegment, GST_FORMAT_TIME,
-        self->vsegment.position, &video_running_time);
-    if (vsign == 0) {
-      video_running_time = GST_CLOCK_TIME_NONE;
-    }
-  }
-  while (!(self->video_eos_flag || self->audio_flush_flag
-          || self->shutdown_flag) &&
-      /* Start at timecode */
-      /* Wait if we haven't received video yet */
-      (video_running_time == GST_CLOCK_TIME_NONE
-          /* Wait if audio is after the video: dunno what to do */
-          || gst_avwait_compare_guint64_with_signs (asign,
-              current_running_time, vsign, video_running_time) == 1
-          /* Wait if we don't even know what to wait for yet */
-          || self->running_time_to_wait_for == GST_CLOCK_TIME_NONE)) {
-    g_cond_wait (&self->cond, &self->mutex);
-    vsign =
-        gst_segment_to_running_time_full (&self->vsegment, GST_FORMAT_TIME,
-        self->vsegment.position, &video_running_time);
-    if (vsign == 0) {
-      video_running_time = GST_CLOCK_TIME_NONE;
-    }
-  }
-  if (self->audio_flush_flag || self->shutdown_flag) {
+
+  if (g_atomic_int_get (&self->audio_flush_flag)
+      || g_atomic_int_get (&self->shutdown_flag)) {
     GST_DEBUG_OBJECT (self, "Shutting down, ignoring frame");
     gst_buffer_unref (inbuf);
-    g_mutex_unlock (&self->mutex);
     return GST_FLOW_FLUSHING;
   }
   duration =
@@ -857,42 +952,68 @@ gst_avwait_asink_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
         gst_segment_to_running_time_full (&self->asegment, GST_FORMAT_TIME,
         self->asegment.position + duration, &running_time_at_end);
     if (esign == 0) {
-      g_mutex_unlock (&self->mutex);
       GST_ERROR_OBJECT (self, "Could not get running time at end");
       gst_buffer_unref (inbuf);
       return GST_FLOW_ERROR;
     }
   }
-  if (self->running_time_to_wait_for == GST_CLOCK_TIME_NONE
+
+  /* Audio after the start, not after the video and before the end passes
+   * unchanged without taking the mutex. If the gate changes meanwhile, this
+   * is as if the buffer arrived just before */
+  if (asign > 0 && esign > 0 && g_atomic_int_get (&self->audio_window_valid)
+      && current_running_time >= self->audio_window_start
+      && current_running_time <= self->audio_window_video
+      && running_time_at_end < self->audio_window_end)
+    return gst_pad_push (self->asrcpad, inbuf);
+
+  g_mutex_lock (&self->mutex);
+  while (gst_avwait_audio_must_wait (self, &self->gate, asign,
+          current_running_time))
+    g_cond_wait (&self->cond, &self->mutex);
+  gate = self->gate;
+  if (gate.start != GST_CLOCK_TIME_NONE
+      && gate.video_running_time != GST_CLOCK_TIME_NONE && gate.vsign > 0) {
+    self->audio_window_start = gate.start;
+    self->audio_window_video = gate.video_running_time;
+    self->audio_window_end = gate.end;
+    g_atomic_int_set (&self->audio_window_valid, TRUE);
+  }
+  g_mutex_unlock (&self->mutex);
+  if (g_atomic_int_get (&self->audio_flush_flag)
+      || g_atomic_int_get (&self->shutdown_flag)) {
+    GST_DEBUG_OBJECT (self, "Shutting down, ignoring frame");
+    gst_buffer_unref (inbuf);
+    return GST_FLOW_FLUSHING;
+  }
+  if (gate.start == GST_CLOCK_TIME_NONE
       /* Audio ends before start : drop */
       || gst_avwait_compare_guint64_with_signs (esign,
-          running_time_at_end, 1, self->running_time_to_wait_for) == -1
+          running_time_at_end, 1, gate.start) == -1
       /* Audio starts after end: drop */
-      || current_running_time >= self->running_time_to_end_at) {
+      || current_running_time >= gate.end) {
     GST_DEBUG_OBJECT (self,
         "Dropped an audio buf at %" GST_TIME_FORMAT " waiting for %"
         GST_TIME_FORMAT " video time %" GST_TIME_FORMAT,
         GST_TIME_ARGS (current_running_time),
-        GST_TIME_ARGS (self->running_time_to_wait_for),
-        GST_TIME_ARGS (video_running_time));
+        GST_TIME_ARGS (gate.start), GST_TIME_ARGS (gate.video_running_time));
     GST_DEBUG_OBJECT (self, "Would have ended at %i %" GST_TIME_FORMAT,
         esign, GST_TIME_ARGS (running_time_at_end));
     gst_buffer_unref (inbuf);
     inbuf = NULL;
   } else if (gst_avwait_compare_guint64_with_signs (esign, running_time_at_end,
-          1, self->running_time_to_wait_for) >= 0
+          1, gate.start) >= 0
       && gst_avwait_compare_guint64_with_signs (esign, running_time_at_end, 1,
-          self->running_time_to_end_at) == -1) {
+          gate.end) == -1) {
     /* Audio ends after start, but before end: clip */
     GstSegment asegment2 = self->asegment;
 
-    gst_segment_set_running_time (&asegment2, GST_FORMAT_TIME,
-        self->running_time_to_wait_for);
+    gst_segment_set_running_time (&asegment2, GST_FORMAT_TIME, gate.start);
     inbuf =
         gst_audio_buffer_clip (inbuf, &asegment2, self->ainfo.rate,
         self->ainfo.bpf);
   } else if (gst_avwait_compare_guint64_with_signs (esign, running_time_at_end,
-          1, self->running_time_to_end_at) >= 0) {
+          1, gate.end) >= 0) {
     /* Audio starts after start, but before end: clip from the other side */
     GstSegment asegment2 = self->asegment;
     guint64 stop;
@@ -900,7 +1021,7 @@ gst_avwait_asink_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
 
     ssign =
         gst_segment_position_from_running_time_full (&asegment2,
-        GST_FORMAT_TIME, self->running_time_to_end_at, &stop);
+        GST_FORMAT_TIME, gate.end, &stop);
     if (ssign > 0) {
       asegment2.stop = stop;
     } else {
@@ -919,7 +1040,6 @@ gst_avwait_asink_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
     /* Programming error? Shouldn't happen */
     g_assert_not_reached ();
   }
-  g_mutex_unlock (&self->mutex);
   if (inbuf)
     return gst_pad_push (self->asrcpad, inbuf);
   else
@@ -35,6 +35,7 @@ G_BEGIN_DECLS
 #define GST_TYPE_AVWAIT_MODE (gst_avwait_mode_get_type ())
 typedef struct _GstAvWait GstAvWait;
 typedef struct _GstAvWaitClass GstAvWaitClass;
+typedef struct _GstAvWaitGate GstAvWaitGate;
 
 typedef enum
 {
@@ -43,15 +44,27 @@ typedef enum
   MODE_VIDEO_FIRST
 } GstAvWaitMode;
 
+/* The state the audio thread needs for deciding what to pass. It is
+ * written and read with the mutex held */
+struct _GstAvWaitGate
+{
+  GstClockTime start;           /* running_time_to_wait_for */
+  GstClockTime end;             /* running_time_to_end_at */
+  GstClockTime video_running_time;
+  gint vsign;
+};
+
 struct _GstAvWait
 {
   GstElement parent;
 
   GstVideoTimeCode *tc;
+  guint64 tc_index;
   GstClockTime target_running_time;
   GstAvWaitMode mode;
 
   GstVideoTimeCode *end_tc;
+  guint64 end_tc_index;
   GstClockTime running_time_to_end_at;
 
   GstPad *asrcpad, *asinkpad, *vsrcpad, *vsinkpad;
@@ -63,7 +76,8 @@ struct _GstAvWait
 
   GstClockTime running_time_to_wait_for;
   GstClockTime last_seen_video_running_time;
-  GstVideoTimeCode *last_seen_tc;
+  GstVideoTimeCode last_seen_tc;
+  gboolean have_last_seen_tc;
 
   gboolean video_eos_flag;
   gboolean audio_flush_flag;
@@ -71,6 +85,17 @@ struct _GstAvWait
 
   gboolean dropping;
 
+  GstAvWaitGate gate;
+
+  /* Audio running times the audio thread last saw it can pass unchanged.
+   * Only used by the audio streaming thread, and only while the flag is set.
+   * The flag is cleared with the mutex whenever the gate changes other than
+   * by the video moving ahead */
+  GstClockTime audio_window_start;
+  GstClockTime audio_window_video;
+  GstClockTime audio_window_end;
+  volatile gint audio_window_valid;
+
   GCond cond;
   GMutex mutex;
 };
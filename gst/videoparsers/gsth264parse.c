@@ -197,6 +197,7 @@ gst_h264_parse_reset_frame (GstH264Parse * h264parse)
   h264parse->frame_start = FALSE;
   h264parse->aud_insert = TRUE;
   gst_adapter_clear (h264parse->frame_out);
+  h264parse->frame_out_n_mem = 0;
 }
 
 static void
@@ -266,6 +267,8 @@ gst_h264_parse_start (GstBaseParse * parse)
   gst_h264_parse_reset (h264parse);
 
   h264parse->nalparser = gst_h264_nal_parser_new ();
+  h264parse->n_param_sets = 0;
+  h264parse->n_param_sets_unchanged = 0;
 
   h264parse->dts = GST_CLOCK_TIME_NONE;
   h264parse->ts_trn_nb = GST_CLOCK_TIME_NONE;
@@ -284,6 +287,8 @@ gst_h264_parse_stop (GstBaseParse * parse)
   GstH264Parse *h264parse = GST_H264_PARSE (parse);
 
   GST_DEBUG_OBJECT (parse, "stop");
+  GST_INFO_OBJECT (parse, "%u of %u parameter sets were unchanged repeats",
+      h264parse->n_param_sets_unchanged, h264parse->n_param_sets);
   gst_h264_parse_reset (h264parse);
 
   gst_h264_nal_parser_free (h264parse->nalparser);
@@ -417,19 +422,28 @@ gst_h264_parse_negotiate (GstH264Parse * h264parse, gint in_format,
     gst_caps_unref (caps);
 }
 
-static GstBuffer *
-gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format, guint8 * data,
-    guint size)
+static const guint8 nal_start_code[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+/* appends @size bytes of nal payload found at @offset in @src to @dest,
+ * preceded by the start code or length prefix that @format requires.
+ * The payload memory is shared with @src rather than copied; if @data
+ * (the mapped content of @src) already has the required prefix in the
+ * @prefix_avail bytes in front of the payload, that is shared as well. */
+static void
+gst_h264_parse_append_nal (GstH264Parse * h264parse, guint format,
+    GstBuffer * dest, GstBuffer * src, const guint8 * data, guint offset,
+    guint prefix_avail, guint size)
 {
-  GstBuffer *buf;
+  GstMemory *mem;
   guint nl = h264parse->nal_length_size;
   guint32 tmp;
+  gboolean bs;
 
   GST_DEBUG_OBJECT (h264parse, "nal length %d", size);
 
-  buf = gst_buffer_new_allocate (NULL, 4 + size, NULL);
-  if (format == GST_H264_PARSE_FORMAT_AVC
-      || format == GST_H264_PARSE_FORMAT_AVC3) {
+  bs = format != GST_H264_PARSE_FORMAT_AVC
+      && format != GST_H264_PARSE_FORMAT_AVC3;
+  if (!bs) {
     tmp = GUINT32_TO_BE (size << (32 - 8 * nl));
   } else {
     /* HACK: nl should always be 4 here, otherwise this won't work. 
@@ -439,13 +453,76 @@ gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format, guint8 * data,
     tmp = GUINT32_TO_BE (1);
   }
 
-  gst_buffer_fill (buf, 0, &tmp, sizeof (guint32));
-  gst_buffer_fill (buf, nl, data, size);
-  gst_buffer_set_size (buf, size + nl);
+  if (data && prefix_avail >= nl && offset >= nl
+      && memcmp (data + offset - nl, &tmp, nl) == 0) {
+    gst_buffer_copy_into (dest, src, GST_BUFFER_COPY_MEMORY, offset - nl,
+        size + nl);
+    return;
+  }
+
+  if (bs) {
+    mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+        (guint8 *) nal_start_code, 4, 0, 4, NULL, NULL);
+  } else {
+    guint8 *prefix = g_memdup (&tmp, nl);
+
+    mem = gst_memory_new_wrapped (0, prefix, nl, 0, nl, prefix, g_free);
+  }
+  gst_buffer_append_memory (dest, mem);
+  gst_buffer_copy_into (dest, src, GST_BUFFER_COPY_MEMORY, offset, size);
+}
+
+/* wraps @size bytes at @offset in @src into a new buffer carrying the
+ * prefix required by @format, without copying the payload */
+static GstBuffer *
+gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format,
+    GstBuffer * src, const guint8 * data, guint offset, guint prefix_avail,
+    guint size)
+{
+  GstBuffer *buf;
+
+  buf = gst_buffer_new ();
+  gst_h264_parse_append_nal (h264parse, format, buf, src, data, offset,
+      prefix_avail, size);
 
   return buf;
 }
 
+/* adds @buf to the nals collected for the outgoing frame */
+static void
+gst_h264_parse_collect_out (GstH264Parse * h264parse, GstBuffer * buf)
+{
+  h264parse->frame_out_n_mem += gst_buffer_n_memory (buf);
+  gst_adapter_push (h264parse->frame_out, buf);
+}
+
+/* takes all collected nals as one buffer. They share memory with their
+ * source, but beyond the maximum number of memories a buffer would merge
+ * them again on every further append, so copy them once in that case */
+static GstBuffer *
+gst_h264_parse_take_out (GstH264Parse * h264parse)
+{
+  gsize av = gst_adapter_available (h264parse->frame_out);
+  guint n_mem = h264parse->frame_out_n_mem;
+
+  h264parse->frame_out_n_mem = 0;
+  if (n_mem > gst_buffer_get_max_memory ())
+    return gst_adapter_take_buffer (h264parse->frame_out, av);
+
+  return gst_adapter_take_buffer_fast (h264parse->frame_out, av);
+}
+
+/* checks whether @nalu has the same bytes as the nal stored at @id */
+static gboolean
+gst_h264_parse_nal_unchanged (GstBuffer ** store, guint store_size, guint id,
+    GstH264NalUnit * nalu)
+{
+  return id < store_size && store[id] != NULL
+      && gst_buffer_get_size (store[id]) == nalu->size
+      && gst_buffer_memcmp (store[id], 0, nalu->data + nalu->offset,
+      nalu->size) == 0;
+}
+
 static void
 gst_h264_parser_store_nal (GstH264Parse * h264parse, guint id,
     GstH264NalUnitType naltype, GstH264NalUnit * nalu)
@@ -698,15 +775,20 @@ gst_h264_parse_process_sei (GstH264Parse * h264parse, GstH264NalUnit * nalu)
   g_array_free (messages, TRUE);
 }
 
-/* caller guarantees 2 bytes of nal payload */
+/* caller guarantees 2 bytes of nal payload;
+ * @buffer is the buffer that nalu->data is a mapping of */
 static gboolean
-gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
+gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu,
+    GstBuffer * buffer)
 {
   guint nal_type;
   GstH264PPS pps = { 0, };
   GstH264SPS sps = { 0, };
   GstH264NalParser *nalparser = h264parse->nalparser;
+  GstH264SPS *last_sps = nalparser->last_sps;
+  GstH264PPS *last_pps = nalparser->last_pps;
   GstH264ParserResult pres;
+  gboolean unchanged;
 
   /* nothing to do for broken input */
   if (G_UNLIKELY (nalu->size < 2)) {
@@ -739,8 +821,19 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
         return FALSE;
       }
 
-      GST_DEBUG_OBJECT (h264parse, "triggering src caps check");
-      h264parse->update_caps = TRUE;
+      /* broadcast streams repeat the SPS before every IDR; if it is the one
+       * the current caps were made from, there is nothing to update */
+      unchanged = last_sps == &nalparser->sps[sps.id] &&
+          gst_h264_parse_nal_unchanged (h264parse->sps_nals,
+          GST_H264_MAX_SPS_COUNT, sps.id, nalu);
+      h264parse->n_param_sets++;
+      if (unchanged) {
+        GST_LOG_OBJECT (h264parse, "SPS %d unchanged", sps.id);
+        h264parse->n_param_sets_unchanged++;
+      } else {
+        GST_DEBUG_OBJECT (h264parse, "triggering src caps check");
+        h264parse->update_caps = TRUE;
+      }
       h264parse->have_sps = TRUE;
       if (h264parse->push_codec && h264parse->have_pps) {
         /* SPS and PPS found in stream before the first pre_push_frame, no need
@@ -751,7 +844,8 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
         h264parse->have_pps = FALSE;
       }
 
-      gst_h264_parser_store_nal (h264parse, sps.id, nal_type, nalu);
+      if (!unchanged)
+        gst_h264_parser_store_nal (h264parse, sps.id, nal_type, nalu);
       gst_h264_sps_clear (&sps);
       h264parse->state |= GST_H264_PARSE_STATE_GOT_SPS;
       h264parse->header |= TRUE;
@@ -770,6 +864,13 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
           return FALSE;
       }
 
+      unchanged = last_pps == &nalparser->pps[pps.id] &&
+          gst_h264_parse_nal_unchanged (h264parse->pps_nals,
+          GST_H264_MAX_PPS_COUNT, pps.id, nalu);
+      h264parse->n_param_sets++;
+      if (unchanged)
+        h264parse->n_param_sets_unchanged++;
+
       /* parameters might have changed, force caps check */
       if (!h264parse->have_pps) {
         GST_DEBUG_OBJECT (h264parse, "triggering src caps check");
@@ -785,7 +886,8 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
         h264parse->have_pps = FALSE;
       }
 
-      gst_h264_parser_store_nal (h264parse, pps.id, nal_type, nalu);
+      if (!unchanged)
+        gst_h264_parser_store_nal (h264parse, pps.id, nal_type, nalu);
       gst_h264_pps_clear (&pps);
       h264parse->state |= GST_H264_PARSE_STATE_GOT_PPS;
       h264parse->header |= TRUE;
@@ -893,9 +995,9 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
     GstBuffer *buf;
 
     GST_LOG_OBJECT (h264parse, "collecting NAL in AVC frame");
-    buf = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
-        nalu->data + nalu->offset, nalu->size);
-    gst_adapter_push (h264parse->frame_out, buf);
+    buf = gst_h264_parse_wrap_nal (h264parse, h264parse->format, buffer,
+        nalu->data, nalu->offset, nalu->offset - nalu->sc_offset, nalu->size);
+    gst_h264_parse_collect_out (h264parse, buf);
   }
   return TRUE;
 }
@@ -992,7 +1094,7 @@ gst_h264_parse_handle_frame_packetized (GstBaseParse * parse,
     GST_DEBUG_OBJECT (h264parse, "AVC nal offset %d", nalu.offset + nalu.size);
 
     /* either way, have a look at it */
-    gst_h264_parse_process_nal (h264parse, &nalu);
+    gst_h264_parse_process_nal (h264parse, &nalu, buffer);
 
     /* dispatch per NALU if needed */
     if (h264parse->split_packetized) {
@@ -1230,7 +1332,7 @@ gst_h264_parse_handle_frame (GstBaseParse * parse,
       }
     }
 
-    if (!gst_h264_parse_process_nal (h264parse, &nalu)) {
+    if (!gst_h264_parse_process_nal (h264parse, &nalu, buffer)) {
       GST_WARNING_OBJECT (h264parse,
           "broken/invalid nal Type: %d %s, Size: %u will be dropped",
           nalu.type, _nal_name (nalu.type), nalu.size);
@@ -2168,12 +2270,13 @@ gst_h264_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
     h264parse->discont = FALSE;
   }
 
-  /* replace with transformed AVC output if applicable */
+  /* replace with transformed AVC output if applicable; the collected
+   * nals share memory with the input where possible */
   av = gst_adapter_available (h264parse->frame_out);
   if (av) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h264parse->frame_out, av);
+    buf = gst_h264_parse_take_out (h264parse);
     gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
     gst_buffer_replace (&frame->out_buffer, buf);
     gst_buffer_unref (buf);
@@ -2188,12 +2291,8 @@ static GstFlowReturn
 gst_h264_parse_push_codec_buffer (GstH264Parse * h264parse,
     GstBuffer * nal, GstClockTime ts)
 {
-  GstMapInfo map;
-
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  nal = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
-      map.data, map.size);
-  gst_buffer_unmap (nal, &map);
+  nal = gst_h264_parse_wrap_nal (h264parse, h264parse->format, nal, NULL, 0,
+      0, gst_buffer_get_size (nal));
 
   GST_BUFFER_TIMESTAMP (nal) = ts;
   GST_BUFFER_DURATION (nal) = 0;
@@ -2323,60 +2422,43 @@ gst_h264_parse_handle_sps_pps_nals (GstH264Parse * h264parse,
       }
     }
   } else {
-    /* insert config NALs into AU */
-    GstByteWriter bw;
+    /* insert config NALs into AU, sharing memory with the AU and the
+     * stored config NALs. The AU was already taken out of frame_out,
+     * so collect the pieces there */
     GstBuffer *new_buf;
-    const gboolean bs = h264parse->format == GST_H264_PARSE_FORMAT_BYTE;
-    const gint nls = 4 - h264parse->nal_length_size;
-    gboolean ok;
 
-    gst_byte_writer_init_with_size (&bw, gst_buffer_get_size (buffer), FALSE);
-    ok = gst_byte_writer_put_buffer (&bw, buffer, 0, h264parse->idr_pos);
+    if (h264parse->idr_pos > 0)
+      gst_h264_parse_collect_out (h264parse, gst_buffer_copy_region (buffer,
+              GST_BUFFER_COPY_MEMORY, 0, h264parse->idr_pos));
     GST_DEBUG_OBJECT (h264parse, "- inserting SPS/PPS");
     for (i = 0; i < GST_H264_MAX_SPS_COUNT; i++) {
       if ((codec_nal = h264parse->sps_nals[i])) {
-        gsize nal_size = gst_buffer_get_size (codec_nal);
         GST_DEBUG_OBJECT (h264parse, "inserting SPS nal");
-        if (bs) {
-          ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-        } else {
-          ok &= gst_byte_writer_put_uint32_be (&bw, (nal_size << (nls * 8)));
-          ok &= gst_byte_writer_set_pos (&bw,
-              gst_byte_writer_get_pos (&bw) - nls);
-        }
-
-        ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+        gst_h264_parse_collect_out (h264parse,
+            gst_h264_parse_wrap_nal (h264parse, h264parse->format, codec_nal,
+                NULL, 0, 0, gst_buffer_get_size (codec_nal)));
         send_done = TRUE;
       }
     }
     for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++) {
       if ((codec_nal = h264parse->pps_nals[i])) {
-        gsize nal_size = gst_buffer_get_size (codec_nal);
         GST_DEBUG_OBJECT (h264parse, "inserting PPS nal");
-        if (bs) {
-          ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-        } else {
-          ok &= gst_byte_writer_put_uint32_be (&bw, (nal_size << (nls * 8)));
-          ok &= gst_byte_writer_set_pos (&bw,
-              gst_byte_writer_get_pos (&bw) - nls);
-        }
-        ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+        gst_h264_parse_collect_out (h264parse,
+            gst_h264_parse_wrap_nal (h264parse, h264parse->format, codec_nal,
+                NULL, 0, 0, gst_buffer_get_size (codec_nal)));
         send_done = TRUE;
       }
     }
-    ok &= gst_byte_writer_put_buffer (&bw, buffer, h264parse->idr_pos, -1);
+    gst_h264_parse_collect_out (h264parse, gst_buffer_copy_region (buffer,
+            GST_BUFFER_COPY_MEMORY, h264parse->idr_pos, -1));
+    new_buf = gst_h264_parse_take_out (h264parse);
     /* collect result and push */
-    new_buf = gst_byte_writer_reset_and_get_buffer (&bw);
     gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
     /* should already be keyframe/IDR, but it may not have been,
      * so mark it as such to avoid being discarded by picky decoder */
     GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
     gst_buffer_replace (&frame->out_buffer, new_buf);
     gst_buffer_unref (new_buf);
-    /* some result checking seems to make some compilers happy */
-    if (G_UNLIKELY (!ok)) {
-      GST_ERROR_OBJECT (h264parse, "failed to insert SPS/PPS");
-    }
   }
 
   return send_done;
@@ -2669,7 +2751,7 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
         goto avcc_too_small;
       }
 
-      gst_h264_parse_process_nal (h264parse, &nalu);
+      gst_h264_parse_process_nal (h264parse, &nalu, codec_data);
       off = nalu.offset + nalu.size;
     }
 
@@ -2688,7 +2770,7 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
         goto avcc_too_small;
       }
 
-      gst_h264_parse_process_nal (h264parse, &nalu);
+      gst_h264_parse_process_nal (h264parse, &nalu, codec_data);
       off = nalu.offset + nalu.size;
     }
 
@@ -90,6 +90,9 @@ struct _GstH264Parse
   /* collected SPS and PPS NALUs */
   GstBuffer *sps_nals[GST_H264_MAX_SPS_COUNT];
   GstBuffer *pps_nals[GST_H264_MAX_PPS_COUNT];
+  /* number of SPS/PPS seen, and how many repeated the stored one */
+  guint n_param_sets;
+  guint n_param_sets_unchanged;
 
   /* Infos we need to keep track of */
   guint32 sei_cpb_removal_delay;
@@ -112,6 +115,7 @@ struct _GstH264Parse
   gint idr_pos, sei_pos;
   gboolean update_caps;
   GstAdapter *frame_out;
+  guint frame_out_n_mem;
   gboolean keyframe;
   gboolean header;
   gboolean frame_start;
@@ -168,6 +168,7 @@ gst_h265_parse_reset_frame (GstH265Parse * h265parse)
   h265parse->keyframe = FALSE;
   h265parse->header = FALSE;
   gst_adapter_clear (h265parse->frame_out);
+  h265parse->frame_out_n_mem = 0;
 }
 
 static void
@@ -213,6 +214,8 @@ gst_h265_parse_start (GstBaseParse * parse)
   gst_h265_parse_reset (h265parse);
 
   h265parse->nalparser = gst_h265_parser_new ();
+  h265parse->n_param_sets = 0;
+  h265parse->n_param_sets_unchanged = 0;
 
   gst_base_parse_set_min_frame_size (parse, 7);
 
@@ -226,6 +229,8 @@ gst_h265_parse_stop (GstBaseParse * parse)
   GstH265Parse *h265parse = GST_H265_PARSE (parse);
 
   GST_DEBUG_OBJECT (parse, "stop");
+  GST_INFO_OBJECT (parse, "%u of %u parameter sets were unchanged repeats",
+      h265parse->n_param_sets_unchanged, h265parse->n_param_sets);
   gst_h265_parse_reset (h265parse);
 
   for (i = 0; i < GST_H265_MAX_VPS_COUNT; i++)
@@ -362,19 +367,28 @@ gst_h265_parse_negotiate (GstH265Parse * h265parse, gint in_format,
     gst_caps_unref (caps);
 }
 
-static GstBuffer *
-gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format, guint8 * data,
-    guint size)
+static const guint8 nal_start_code[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+/* appends @size bytes of nal payload found at @offset in @src to @dest,
+ * preceded by the start code or length prefix that @format requires.
+ * The payload memory is shared with @src rather than copied; if @data
+ * (the mapped content of @src) already has the required prefix in the
+ * @prefix_avail bytes in front of the payload, that is shared as well. */
+static void
+gst_h265_parse_append_nal (GstH265Parse * h265parse, guint format,
+    GstBuffer * dest, GstBuffer * src, const guint8 * data, guint offset,
+    guint prefix_avail, guint size)
 {
-  GstBuffer *buf;
+  GstMemory *mem;
   guint nl = h265parse->nal_length_size;
   guint32 tmp;
+  gboolean bs;
 
   GST_DEBUG_OBJECT (h265parse, "nal length %d", size);
 
-  buf = gst_buffer_new_allocate (NULL, 4 + size, NULL);
-  if (format == GST_H265_PARSE_FORMAT_HVC1
-      || format == GST_H265_PARSE_FORMAT_HEV1) {
+  bs = format != GST_H265_PARSE_FORMAT_HVC1
+      && format != GST_H265_PARSE_FORMAT_HEV1;
+  if (!bs) {
     tmp = GUINT32_TO_BE (size << (32 - 8 * nl));
   } else {
     /* HACK: nl should always be 4 here, otherwise this won't work.
@@ -384,13 +398,76 @@ gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format, guint8 * data,
     tmp = GUINT32_TO_BE (1);
   }
 
-  gst_buffer_fill (buf, 0, &tmp, sizeof (guint32));
-  gst_buffer_fill (buf, nl, data, size);
-  gst_buffer_set_size (buf, size + nl);
+  if (data && prefix_avail >= nl && offset >= nl
+      && memcmp (data + offset - nl, &tmp, nl) == 0) {
+    gst_buffer_copy_into (dest, src, GST_BUFFER_COPY_MEMORY, offset - nl,
+        size + nl);
+    return;
+  }
+
+  if (bs) {
+    mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+        (guint8 *) nal_start_code, 4, 0, 4, NULL, NULL);
+  } else {
+    guint8 *prefix = g_memdup (&tmp, nl);
+
+    mem = gst_memory_new_wrapped (0, prefix, nl, 0, nl, prefix, g_free);
+  }
+  gst_buffer_append_memory (dest, mem);
+  gst_buffer_copy_into (dest, src, GST_BUFFER_COPY_MEMORY, offset, size);
+}
+
+/* wraps @size bytes at @offset in @src into a new buffer carrying the
+ * prefix required by @format, without copying the payload */
+static GstBuffer *
+gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format,
+    GstBuffer * src, const guint8 * data, guint offset, guint prefix_avail,
+    guint size)
+{
+  GstBuffer *buf;
+
+  buf = gst_buffer_new ();
+  gst_h265_parse_append_nal (h265parse, format, buf, src, data, offset,
+      prefix_avail, size);
 
   return buf;
 }
 
+/* adds @buf to the nals collected for the outgoing frame */
+static void
+gst_h265_parse_collect_out (GstH265Parse * h265parse, GstBuffer * buf)
+{
+  h265parse->frame_out_n_mem += gst_buffer_n_memory (buf);
+  gst_adapter_push (h265parse->frame_out, buf);
+}
+
+/* takes all collected nals as one buffer. They share memory with their
+ * source, but beyond the maximum number of memories a buffer would merge
+ * them again on every further append, so copy them once in that case */
+static GstBuffer *
+gst_h265_parse_take_out (GstH265Parse * h265parse)
+{
+  gsize av = gst_adapter_available (h265parse->frame_out);
+  guint n_mem = h265parse->frame_out_n_mem;
+
+  h265parse->frame_out_n_mem = 0;
+  if (n_mem > gst_buffer_get_max_memory ())
+    return gst_adapter_take_buffer (h265parse->frame_out, av);
+
+  return gst_adapter_take_buffer_fast (h265parse->frame_out, av);
+}
+
+/* checks whether @nalu has the same bytes as the nal stored at @id */
+static gboolean
+gst_h265_parse_nal_unchanged (GstBuffer ** store, guint store_size, guint id,
+    GstH265NalUnit * nalu)
+{
+  return id < store_size && store[id] != NULL
+      && gst_buffer_get_size (store[id]) == nalu->size
+      && gst_buffer_memcmp (store[id], 0, nalu->data + nalu->offset,
+      nalu->size) == 0;
+}
+
 static void
 gst_h265_parser_store_nal (GstH265Parse * h265parse, guint id,
     GstH265NalUnitType naltype, GstH265NalUnit * nalu)
@@ -485,9 +562,11 @@ _nal_name (GstH265NalUnitType nal_type)
 }
 #endif
 
-/* caller guarantees 2 bytes of nal payload */
+/* caller guarantees 2 bytes of nal payload;
+ * @buffer is the buffer that nalu->data is a mapping of */
 static void
-gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
+gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu,
+    GstBuffer * buffer)
 {
   GstH265PPS pps = { 0, };
   GstH265SPS sps = { 0, };
@@ -495,7 +574,11 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
   gboolean is_irap;
   guint nal_type;
   GstH265Parser *nalparser = h265parse->nalparser;
+  GstH265VPS *last_vps = nalparser->last_vps;
+  GstH265SPS *last_sps = nalparser->last_sps;
+  GstH265PPS *last_pps = nalparser->last_pps;
   GstH265ParserResult pres = GST_H265_PARSER_ERROR;
+  gboolean unchanged;
 
   /* nothing to do for broken input */
   if (G_UNLIKELY (nalu->size < 2)) {
@@ -516,8 +599,20 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       if (pres != GST_H265_PARSER_OK)
         GST_WARNING_OBJECT (h265parse, "failed to parse VPS");
 
-      GST_DEBUG_OBJECT (h265parse, "triggering src caps check");
-      h265parse->update_caps = TRUE;
+      /* broadcast streams repeat their parameter sets before every IRAP; if
+       * it is the one the current caps were made from, nothing changes */
+      unchanged = pres == GST_H265_PARSER_OK &&
+          last_vps == &nalparser->vps[vps.id] &&
+          gst_h265_parse_nal_unchanged (h265parse->vps_nals,
+          GST_H265_MAX_VPS_COUNT, vps.id, nalu);
+      h265parse->n_param_sets++;
+      if (unchanged) {
+        GST_LOG_OBJECT (h265parse, "VPS %d unchanged", vps.id);
+        h265parse->n_param_sets_unchanged++;
+      } else {
+        GST_DEBUG_OBJECT (h265parse, "triggering src caps check");
+        h265parse->update_caps = TRUE;
+      }
       h265parse->have_vps = TRUE;
       if (h265parse->push_codec && h265parse->have_pps) {
         /* VPS/SPS/PPS found in stream before the first pre_push_frame, no need
@@ -529,7 +624,8 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
         h265parse->have_pps = FALSE;
       }
 
-      gst_h265_parser_store_nal (h265parse, vps.id, nal_type, nalu);
+      if (!unchanged)
+        gst_h265_parser_store_nal (h265parse, vps.id, nal_type, nalu);
       h265parse->header |= TRUE;
       break;
     case GST_H265_NAL_SPS:
@@ -540,8 +636,18 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       if (pres != GST_H265_PARSER_OK)
         GST_WARNING_OBJECT (h265parse, "failed to parse SPS:");
 
-      GST_DEBUG_OBJECT (h265parse, "triggering src caps check");
-      h265parse->update_caps = TRUE;
+      unchanged = pres == GST_H265_PARSER_OK &&
+          last_sps == &nalparser->sps[sps.id] &&
+          gst_h265_parse_nal_unchanged (h265parse->sps_nals,
+          GST_H265_MAX_SPS_COUNT, sps.id, nalu);
+      h265parse->n_param_sets++;
+      if (unchanged) {
+        GST_LOG_OBJECT (h265parse, "SPS %d unchanged", sps.id);
+        h265parse->n_param_sets_unchanged++;
+      } else {
+        GST_DEBUG_OBJECT (h265parse, "triggering src caps check");
+        h265parse->update_caps = TRUE;
+      }
       h265parse->have_sps = TRUE;
       if (h265parse->push_codec && h265parse->have_pps) {
         /* SPS and PPS found in stream before the first pre_push_frame, no need
@@ -552,7 +658,8 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
         h265parse->have_pps = FALSE;
       }
 
-      gst_h265_parser_store_nal (h265parse, sps.id, nal_type, nalu);
+      if (!unchanged)
+        gst_h265_parser_store_nal (h265parse, sps.id, nal_type, nalu);
       h265parse->header |= TRUE;
       break;
     case GST_H265_NAL_PPS:
@@ -563,6 +670,14 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       if (pres != GST_H265_PARSER_OK)
         GST_WARNING_OBJECT (h265parse, "failed to parse PPS:");
 
+      unchanged = pres == GST_H265_PARSER_OK &&
+          last_pps == &nalparser->pps[pps.id] &&
+          gst_h265_parse_nal_unchanged (h265parse->pps_nals,
+          GST_H265_MAX_PPS_COUNT, pps.id, nalu);
+      h265parse->n_param_sets++;
+      if (unchanged)
+        h265parse->n_param_sets_unchanged++;
+
       /* parameters might have changed, force caps check */
       if (!h265parse->have_pps) {
         GST_DEBUG_OBJECT (h265parse, "triggering src caps check");
@@ -578,7 +693,8 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
         h265parse->have_pps = FALSE;
       }
 
-      gst_h265_parser_store_nal (h265parse, pps.id, nal_type, nalu);
+      if (!unchanged)
+        gst_h265_parser_store_nal (h265parse, pps.id, nal_type, nalu);
       h265parse->header |= TRUE;
       break;
     case GST_H265_NAL_PREFIX_SEI:
@@ -666,9 +782,9 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
     GstBuffer *buf;
 
     GST_LOG_OBJECT (h265parse, "collecting NAL in HEVC frame");
-    buf = gst_h265_parse_wrap_nal (h265parse, h265parse->format,
-        nalu->data + nalu->offset, nalu->size);
-    gst_adapter_push (h265parse->frame_out, buf);
+    buf = gst_h265_parse_wrap_nal (h265parse, h265parse->format, buffer,
+        nalu->data, nalu->offset, nalu->offset - nalu->sc_offset, nalu->size);
+    gst_h265_parse_collect_out (h265parse, buf);
   }
 }
 
@@ -758,7 +874,7 @@ gst_h265_parse_handle_frame_packetized (GstBaseParse * parse,
     GST_DEBUG_OBJECT (h265parse, "HEVC nal offset %d", nalu.offset + nalu.size);
 
     /* either way, have a look at it */
-    gst_h265_parse_process_nal (h265parse, &nalu);
+    gst_h265_parse_process_nal (h265parse, &nalu, buffer);
 
     /* dispatch per NALU if needed */
     if (h265parse->split_packetized) {
@@ -976,7 +1092,7 @@ gst_h265_parse_handle_frame (GstBaseParse * parse,
         nalu.type == GST_H265_NAL_SPS ||
         nalu.type == GST_H265_NAL_PPS ||
         (h265parse->have_sps && h265parse->have_pps)) {
-      gst_h265_parse_process_nal (h265parse, &nalu);
+      gst_h265_parse_process_nal (h265parse, &nalu, buffer);
     } else {
       GST_WARNING_OBJECT (h265parse,
           "no SPS/PPS yet, nal Type: %d %s, Size: %u will be dropped",
@@ -1677,12 +1793,13 @@ gst_h265_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
   else
     GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_HEADER);
 
-  /* replace with transformed HEVC output if applicable */
+  /* replace with transformed HEVC output if applicable; the collected
+   * nals share memory with the input where possible */
   av = gst_adapter_available (h265parse->frame_out);
   if (av) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h265parse->frame_out, av);
+    buf = gst_h265_parse_take_out (h265parse);
     gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
     gst_buffer_replace (&frame->out_buffer, buf);
     gst_buffer_unref (buf);
@@ -1697,12 +1814,8 @@ static GstFlowReturn
 gst_h265_parse_push_codec_buffer (GstH265Parse * h265parse, GstBuffer * nal,
     GstClockTime ts)
 {
-  GstMapInfo map;
-
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  nal = gst_h265_parse_wrap_nal (h265parse, h265parse->format,
-      map.data, map.size);
-  gst_buffer_unmap (nal, &map);
+  nal = gst_h265_parse_wrap_nal (h265parse, h265parse->format, nal, NULL, 0,
+      0, gst_buffer_get_size (nal));
 
   GST_BUFFER_TIMESTAMP (nal) = ts;
   GST_BUFFER_DURATION (nal) = 0;
@@ -1920,71 +2033,48 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
             }
           }
         } else {
-          /* insert config NALs into AU */
-          GstByteWriter bw;
+          /* insert config NALs into AU, sharing memory with the AU and
+           * the stored config NALs. The AU was already taken out of
+           * frame_out, so collect the pieces there */
           GstBuffer *new_buf;
-          const gboolean bs = h265parse->format == GST_H265_PARSE_FORMAT_BYTE;
-          const gint nls = 4 - h265parse->nal_length_size;
-          gboolean ok;
 
-          gst_byte_writer_init_with_size (&bw, gst_buffer_get_size (buffer),
-              FALSE);
-          ok = gst_byte_writer_put_buffer (&bw, buffer, 0, h265parse->idr_pos);
+          if (h265parse->idr_pos > 0)
+            gst_h265_parse_collect_out (h265parse,
+                gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY, 0,
+                    h265parse->idr_pos));
           GST_DEBUG_OBJECT (h265parse, "- inserting VPS/SPS/PPS");
           for (i = 0; i < GST_H265_MAX_VPS_COUNT; i++) {
             if ((codec_nal = h265parse->vps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting VPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              gst_h265_parse_collect_out (h265parse,
+                  gst_h265_parse_wrap_nal (h265parse, h265parse->format,
+                      codec_nal, NULL, 0, 0, gst_buffer_get_size (codec_nal)));
               h265parse->last_report = new_ts;
             }
           }
           for (i = 0; i < GST_H265_MAX_SPS_COUNT; i++) {
             if ((codec_nal = h265parse->sps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting SPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              gst_h265_parse_collect_out (h265parse,
+                  gst_h265_parse_wrap_nal (h265parse, h265parse->format,
+                      codec_nal, NULL, 0, 0, gst_buffer_get_size (codec_nal)));
               h265parse->last_report = new_ts;
             }
           }
           for (i = 0; i < GST_H265_MAX_PPS_COUNT; i++) {
             if ((codec_nal = h265parse->pps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting PPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              gst_h265_parse_collect_out (h265parse,
+                  gst_h265_parse_wrap_nal (h265parse, h265parse->format,
+                      codec_nal, NULL, 0, 0, gst_buffer_get_size (codec_nal)));
               h265parse->last_report = new_ts;
             }
           }
-          ok &=
-              gst_byte_writer_put_buffer (&bw, buffer, h265parse->idr_pos, -1);
+          gst_h265_parse_collect_out (h265parse,
+              gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+                  h265parse->idr_pos, -1));
+          new_buf = gst_h265_parse_take_out (h265parse);
           /* collect result and push */
-          new_buf = gst_byte_writer_reset_and_get_buffer (&bw);
           gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0,
               -1);
           /* should already be keyframe/IDR, but it may not have been,
@@ -1992,10 +2082,6 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
           GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
           gst_buffer_replace (&frame->out_buffer, new_buf);
           gst_buffer_unref (new_buf);
-          /* some result checking seems to make some compilers happy */
-          if (G_UNLIKELY (!ok)) {
-            GST_ERROR_OBJECT (h265parse, "failed to insert SPS/PPS");
-          }
         }
       }
       /* we pushed whatever we had */
@@ -2096,7 +2182,7 @@ gst_h265_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
           goto hvcc_too_small;
         }
 
-        gst_h265_parse_process_nal (h265parse, &nalu);
+        gst_h265_parse_process_nal (h265parse, &nalu, codec_data);
         off = nalu.offset + nalu.size;
       }
     }
@@ -77,11 +77,15 @@ struct _GstH265Parse
   GstBuffer *vps_nals[GST_H265_MAX_VPS_COUNT];
   GstBuffer *sps_nals[GST_H265_MAX_SPS_COUNT];
   GstBuffer *pps_nals[GST_H265_MAX_PPS_COUNT];
+  /* number of VPS/SPS/PPS seen, and how many repeated the stored one */
+  guint n_param_sets;
+  guint n_param_sets_unchanged;
 
   /* frame parsing */
   gint idr_pos, sei_pos;
   gboolean update_caps;
   GstAdapter *frame_out;
+  guint frame_out_n_mem;
   gboolean keyframe;
   gboolean header;
   /* AU state */
@@ -27,6 +27,10 @@
  * gst-launch-1.0 -v filesrc location=file.y4m ! y4mdec ! xvimagesink
  * ]|
  *
+ * If upstream supports random access the element reads the frames itself in
+ * pull mode. An index of the frame positions is then built while reading,
+ * so that seeking also works with files containing per-frame parameters.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -41,10 +45,19 @@
 #include <string.h>
 
 #define MAX_SIZE 32768
+#define MAX_HEADER_LENGTH 80
 
 GST_DEBUG_CATEGORY (y4mdec_debug);
 #define GST_CAT_DEFAULT y4mdec_debug
 
+typedef struct
+{
+  /* offset of the FRAME header */
+  guint64 offset;
+  /* size of the FRAME header including parameters and newline */
+  guint header_size;
+} GstY4mDecIndexEntry;
+
 /* prototypes */
 
 
@@ -59,6 +72,10 @@ static GstFlowReturn gst_y4m_dec_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buffer);
 static gboolean gst_y4m_dec_sink_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
+static gboolean gst_y4m_dec_sink_activate (GstPad * pad, GstObject * parent);
+static gboolean gst_y4m_dec_sink_activate_mode (GstPad * pad,
+    GstObject * parent, GstPadMode mode, gboolean active);
+static void gst_y4m_dec_loop (GstY4mDec * y4mdec);
 
 static gboolean gst_y4m_dec_src_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
@@ -120,6 +137,7 @@ static void
 gst_y4m_dec_init (GstY4mDec * y4mdec)
 {
   y4mdec->adapter = gst_adapter_new ();
+  y4mdec->index = g_array_new (FALSE, FALSE, sizeof (GstY4mDecIndexEntry));
 
   y4mdec->sinkpad =
       gst_pad_new_from_static_template (&gst_y4m_dec_sink_template, "sink");
@@ -127,6 +145,10 @@ gst_y4m_dec_init (GstY4mDec * y4mdec)
       GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_event));
   gst_pad_set_chain_function (y4mdec->sinkpad,
       GST_DEBUG_FUNCPTR (gst_y4m_dec_chain));
+  gst_pad_set_activate_function (y4mdec->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_activate));
+  gst_pad_set_activatemode_function (y4mdec->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_activate_mode));
   gst_element_add_pad (GST_ELEMENT (y4mdec), y4mdec->sinkpad);
 
   y4mdec->srcpad = gst_pad_new_from_static_template (&gst_y4m_dec_src_template,
@@ -186,9 +208,13 @@ gst_y4m_dec_dispose (GObject * object)
 void
 gst_y4m_dec_finalize (GObject * object)
 {
+  GstY4mDec *y4mdec;
+
   g_return_if_fail (GST_IS_Y4M_DEC (object));
+  y4mdec = GST_Y4M_DEC (object);
 
   /* clean up object here */
+  g_array_free (y4mdec->index, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -207,6 +233,12 @@ gst_y4m_dec_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_NULL_TO_READY:
       break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      y4mdec->have_header = FALSE;
+      y4mdec->frame_index = 0;
+      y4mdec->offset = 0;
+      y4mdec->index_offset = 0;
+      g_array_set_size (y4mdec->index, 0);
+      gst_adapter_clear (y4mdec->adapter);
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
       break;
@@ -263,7 +295,26 @@ gst_y4m_dec_bytes_to_frames (GstY4mDec * y4mdec, gint64 bytes)
 
   if (bytes < y4mdec->header_size)
     return 0;
-  return (bytes - y4mdec->header_size) / (y4mdec->info.size + 6);
+
+  /* Estimate from the last indexed frame, assuming no frame parameters */
+  if (y4mdec->index->len == 0 || bytes >= y4mdec->index_offset)
+    return y4mdec->index->len + (bytes - MAX (y4mdec->index_offset,
+            y4mdec->header_size)) / (y4mdec->info.size + 6);
+  else {
+    guint lo = 0, hi = y4mdec->index->len - 1;
+
+    /* last frame starting at or before bytes */
+    while (lo < hi) {
+      guint mid = (lo + hi + 1) / 2;
+
+      if (g_array_index (y4mdec->index, GstY4mDecIndexEntry, mid).offset <=
+          bytes)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    return lo;
+  }
 }
 
 static guint64
@@ -272,7 +323,46 @@ gst_y4m_dec_frames_to_bytes (GstY4mDec * y4mdec, gint64 frame_index)
   if (frame_index == -1)
     return -1;
 
-  return y4mdec->header_size + (y4mdec->info.size + 6) * frame_index;
+  if (frame_index < y4mdec->index->len)
+    return g_array_index (y4mdec->index, GstY4mDecIndexEntry,
+        frame_index).offset;
+
+  return MAX (y4mdec->index_offset, y4mdec->header_size) +
+      (y4mdec->info.size + 6) * (frame_index - y4mdec->index->len);
+}
+
+static void
+gst_y4m_dec_add_index_entry (GstY4mDec * y4mdec, gint64 frame_index,
+    guint64 offset, guint header_size)
+{
+  GstY4mDecIndexEntry entry;
+
+  /* Only frames directly following the indexed ones have a known number */
+  if (frame_index != y4mdec->index->len)
+    return;
+
+  entry.offset = offset;
+  entry.header_size = header_size;
+  g_array_append_val (y4mdec->index, entry);
+  y4mdec->index_offset = offset + header_size + y4mdec->info.size;
+}
+
+/* Returns the size of the FRAME header at data including parameters and the
+ * newline, 0 if more data is needed or -1 if this is not a frame header */
+static gint
+gst_y4m_dec_frame_header_length (const guint8 * data, gsize size)
+{
+  gsize i;
+
+  if (memcmp (data, "FRAME", MIN (size, 5)) != 0)
+    return -1;
+
+  for (i = 5; i < size && i < MAX_HEADER_LENGTH; i++) {
+    if (data[i] == '\n')
+      return i + 1;
+  }
+
+  return size < MAX_HEADER_LENGTH ? 0 : -1;
 }
 
 static GstClockTime
@@ -481,15 +571,193 @@ error:
   return FALSE;
 }
 
+/* Parses the MAX_HEADER_LENGTH bytes of stream header in header */
+static gboolean
+gst_y4m_dec_handle_header (GstY4mDec * y4mdec, char *header)
+{
+  int i;
+
+  header[MAX_HEADER_LENGTH - 1] = 0;
+  for (i = 0; i < MAX_HEADER_LENGTH; i++) {
+    if (header[i] == 0x0a)
+      header[i] = 0;
+  }
+
+  if (!gst_y4m_dec_parse_header (y4mdec, header)) {
+    GST_ELEMENT_ERROR (y4mdec, STREAM, DECODE,
+        ("Failed to parse YUV4MPEG header"), (NULL));
+    return FALSE;
+  }
+
+  y4mdec->header_size = strlen (header) + 1;
+  y4mdec->index_offset = y4mdec->header_size;
+  g_array_set_size (y4mdec->index, 0);
+
+  return TRUE;
+}
+
+static gboolean
+gst_y4m_dec_negotiate (GstY4mDec * y4mdec)
+{
+  gboolean ret;
+  GstCaps *caps;
+  GstQuery *query;
+
+  caps = gst_video_info_to_caps (&y4mdec->info);
+  ret = gst_pad_set_caps (y4mdec->srcpad, caps);
+
+  query = gst_query_new_allocation (caps, FALSE);
+  y4mdec->video_meta = FALSE;
+
+  if (y4mdec->pool) {
+    gst_buffer_pool_set_active (y4mdec->pool, FALSE);
+    gst_object_unref (y4mdec->pool);
+  }
+  y4mdec->pool = NULL;
+
+  if (gst_pad_peer_query (y4mdec->srcpad, query)) {
+    y4mdec->video_meta =
+        gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+    /* We only need a pool if we need to do stride conversion for downstream */
+    if (!y4mdec->video_meta && memcmp (&y4mdec->info, &y4mdec->out_info,
+            sizeof (y4mdec->info)) != 0) {
+      GstBufferPool *pool = NULL;
+      GstAllocator *allocator = NULL;
+      GstAllocationParams params;
+      GstStructure *config;
+      guint size, min, max;
+
+      if (gst_query_get_n_allocation_params (query) > 0) {
+        gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
+      } else {
+        allocator = NULL;
+        gst_allocation_params_init (&params);
+      }
+
+      if (gst_query_get_n_allocation_pools (query) > 0) {
+        gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min,
+            &max);
+        size = MAX (size, y4mdec->out_info.size);
+      } else {
+        pool = NULL;
+        size = y4mdec->out_info.size;
+        min = max = 0;
+      }
+
+      if (pool == NULL) {
+        pool = gst_video_buffer_pool_new ();
+      }
+
+      config = gst_buffer_pool_get_config (pool);
+      gst_buffer_pool_config_set_params (config, caps, size, min, max);
+      gst_buffer_pool_config_set_allocator (config, allocator, &params);
+      gst_buffer_pool_set_config (pool, config);
+
+      if (allocator)
+        gst_object_unref (allocator);
+
+      y4mdec->pool = pool;
+    }
+  } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
+          sizeof (y4mdec->info)) != 0) {
+    GstBufferPool *pool;
+    GstStructure *config;
+
+    /* No pool, create our own if we need to do stride conversion */
+    pool = gst_video_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, y4mdec->out_info.size, 0,
+        0);
+    gst_buffer_pool_set_config (pool, config);
+    y4mdec->pool = pool;
+  }
+  if (y4mdec->pool) {
+    gst_buffer_pool_set_active (y4mdec->pool, TRUE);
+  }
+  gst_query_unref (query);
+  gst_caps_unref (caps);
+  if (!ret) {
+    GST_DEBUG_OBJECT (y4mdec, "Couldn't set caps on src pad");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Timestamps and pushes the frame data in buffer, converting strides for
+ * downstream if needed */
+static GstFlowReturn
+gst_y4m_dec_push_frame (GstY4mDec * y4mdec, GstBuffer * buffer)
+{
+  GstFlowReturn flow_ret;
+
+  GST_BUFFER_TIMESTAMP (buffer) =
+      gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index);
+  GST_BUFFER_DURATION (buffer) =
+      gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index + 1) -
+      GST_BUFFER_TIMESTAMP (buffer);
+
+  y4mdec->frame_index++;
+
+  if (y4mdec->video_meta) {
+    gst_buffer_add_video_meta_full (buffer, 0, y4mdec->info.finfo->format,
+        y4mdec->info.width, y4mdec->info.height, y4mdec->info.finfo->n_planes,
+        y4mdec->info.offset, y4mdec->info.stride);
+  } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
+          sizeof (y4mdec->info)) != 0) {
+    GstBuffer *outbuf;
+    GstVideoFrame iframe, oframe;
+    gint i, j;
+    gint w, h, istride, ostride;
+    guint8 *src, *dest;
+
+    /* Allocate a new buffer and do stride conversion */
+    g_assert (y4mdec->pool != NULL);
+
+    flow_ret = gst_buffer_pool_acquire_buffer (y4mdec->pool, &outbuf, NULL);
+    if (flow_ret != GST_FLOW_OK) {
+      gst_buffer_unref (buffer);
+      return flow_ret;
+    }
+
+    gst_video_frame_map (&iframe, &y4mdec->info, buffer, GST_MAP_READ);
+    gst_video_frame_map (&oframe, &y4mdec->out_info, outbuf, GST_MAP_WRITE);
+
+    for (i = 0; i < 3; i++) {
+      w = GST_VIDEO_FRAME_COMP_WIDTH (&iframe, i);
+      h = GST_VIDEO_FRAME_COMP_HEIGHT (&iframe, i);
+      istride = GST_VIDEO_FRAME_COMP_STRIDE (&iframe, i);
+      ostride = GST_VIDEO_FRAME_COMP_STRIDE (&oframe, i);
+      src = GST_VIDEO_FRAME_COMP_DATA (&iframe, i);
+      dest = GST_VIDEO_FRAME_COMP_DATA (&oframe, i);
+
+      for (j = 0; j < h; j++) {
+        memcpy (dest, src, w);
+
+        dest += ostride;
+        src += istride;
+      }
+    }
+
+    gst_video_frame_unmap (&iframe);
+    gst_video_frame_unmap (&oframe);
+    gst_buffer_copy_into (outbuf, buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+    gst_buffer_unref (buffer);
+    buffer = outbuf;
+  }
+
+  return gst_pad_push (y4mdec->srcpad, buffer);
+}
+
 static GstFlowReturn
 gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 {
   GstY4mDec *y4mdec;
   int n_avail;
   GstFlowReturn flow_ret = GST_FLOW_OK;
-#define MAX_HEADER_LENGTH 80
   char header[MAX_HEADER_LENGTH];
-  int i;
+  const guint8 *data;
   int len;
 
   y4mdec = GST_Y4M_DEC (parent);
@@ -505,109 +773,18 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   n_avail = gst_adapter_available (y4mdec->adapter);
 
   if (!y4mdec->have_header) {
-    gboolean ret;
-    GstCaps *caps;
-    GstQuery *query;
-
     if (n_avail < MAX_HEADER_LENGTH)
       return GST_FLOW_OK;
 
     gst_adapter_copy (y4mdec->adapter, (guint8 *) header, 0, MAX_HEADER_LENGTH);
-
-    header[MAX_HEADER_LENGTH - 1] = 0;
-    for (i = 0; i < MAX_HEADER_LENGTH; i++) {
-      if (header[i] == 0x0a)
-        header[i] = 0;
-    }
-
-    ret = gst_y4m_dec_parse_header (y4mdec, header);
-    if (!ret) {
-      GST_ELEMENT_ERROR (y4mdec, STREAM, DECODE,
-          ("Failed to parse YUV4MPEG header"), (NULL));
+    if (!gst_y4m_dec_handle_header (y4mdec, header))
       return GST_FLOW_ERROR;
-    }
 
-    y4mdec->header_size = strlen (header) + 1;
     gst_adapter_flush (y4mdec->adapter, y4mdec->header_size);
+    y4mdec->offset = y4mdec->header_size;
 
-    caps = gst_video_info_to_caps (&y4mdec->info);
-    ret = gst_pad_set_caps (y4mdec->srcpad, caps);
-
-    query = gst_query_new_allocation (caps, FALSE);
-    y4mdec->video_meta = FALSE;
-
-    if (y4mdec->pool) {
-      gst_buffer_pool_set_active (y4mdec->pool, FALSE);
-      gst_object_unref (y4mdec->pool);
-    }
-    y4mdec->pool = NULL;
-
-    if (gst_pad_peer_query (y4mdec->srcpad, query)) {
-      y4mdec->video_meta =
-          gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
-
-      /* We only need a pool if we need to do stride conversion for downstream */
-      if (!y4mdec->video_meta && memcmp (&y4mdec->info, &y4mdec->out_info,
-              sizeof (y4mdec->info)) != 0) {
-        GstBufferPool *pool = NULL;
-        GstAllocator *allocator = NULL;
-        GstAllocationParams params;
-        GstStructure *config;
-        guint size, min, max;
-
-        if (gst_query_get_n_allocation_params (query) > 0) {
-          gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
-        } else {
-          allocator = NULL;
-          gst_allocation_params_init (&params);
-        }
-
-        if (gst_query_get_n_allocation_pools (query) > 0) {
-          gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min,
-              &max);
-          size = MAX (size, y4mdec->out_info.size);
-        } else {
-          pool = NULL;
-          size = y4mdec->out_info.size;
-          min = max = 0;
-        }
-
-        if (pool == NULL) {
-          pool = gst_video_buffer_pool_new ();
-        }
-
-        config = gst_buffer_pool_get_config (pool);
-        gst_buffer_pool_config_set_params (config, caps, size, min, max);
-        gst_buffer_pool_config_set_allocator (config, allocator, &params);
-        gst_buffer_pool_set_config (pool, config);
-
-        if (allocator)
-          gst_object_unref (allocator);
-
-        y4mdec->pool = pool;
-      }
-    } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
-            sizeof (y4mdec->info)) != 0) {
-      GstBufferPool *pool;
-      GstStructure *config;
-
-      /* No pool, create our own if we need to do stride conversion */
-      pool = gst_video_buffer_pool_new ();
-      config = gst_buffer_pool_get_config (pool);
-      gst_buffer_pool_config_set_params (config, caps, y4mdec->out_info.size, 0,
-          0);
-      gst_buffer_pool_set_config (pool, config);
-      y4mdec->pool = pool;
-    }
-    if (y4mdec->pool) {
-      gst_buffer_pool_set_active (y4mdec->pool, TRUE);
-    }
-    gst_query_unref (query);
-    gst_caps_unref (caps);
-    if (!ret) {
-      GST_DEBUG_OBJECT (y4mdec, "Couldn't set caps on src pad");
+    if (!gst_y4m_dec_negotiate (y4mdec))
       return GST_FLOW_ERROR;
-    }
 
     y4mdec->have_header = TRUE;
   }
@@ -634,103 +811,233 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
     y4mdec->have_new_segment = FALSE;
     y4mdec->frame_index = gst_y4m_dec_bytes_to_frames (y4mdec,
         y4mdec->segment.time);
+    y4mdec->offset = MAX (y4mdec->segment.start, y4mdec->header_size);
     GST_DEBUG ("new frame_index %d", y4mdec->frame_index);
 
   }
 
   while (1) {
     n_avail = gst_adapter_available (y4mdec->adapter);
-    if (n_avail < MAX_HEADER_LENGTH)
+    if (n_avail == 0)
       break;
 
-    gst_adapter_copy (y4mdec->adapter, (guint8 *) header, 0, MAX_HEADER_LENGTH);
-    header[MAX_HEADER_LENGTH - 1] = 0;
-    for (i = 0; i < MAX_HEADER_LENGTH; i++) {
-      if (header[i] == 0x0a)
-        header[i] = 0;
-    }
-    if (memcmp (header, "FRAME", 5) != 0) {
+    data = gst_adapter_map (y4mdec->adapter, MIN (n_avail, MAX_HEADER_LENGTH));
+    len = gst_y4m_dec_frame_header_length (data,
+        MIN (n_avail, MAX_HEADER_LENGTH));
+    gst_adapter_unmap (y4mdec->adapter);
+
+    if (len < 0) {
       GST_ELEMENT_ERROR (y4mdec, STREAM, DECODE,
           ("Failed to parse YUV4MPEG frame"), (NULL));
       flow_ret = GST_FLOW_ERROR;
       break;
     }
 
-    len = strlen (header);
-    if (n_avail < y4mdec->info.size + len + 1) {
+    if (len == 0 || n_avail < y4mdec->info.size + len) {
       /* not enough data */
       GST_DEBUG ("not enough data for frame %d < %" G_GSIZE_FORMAT,
-          n_avail, y4mdec->info.size + len + 1);
+          n_avail, y4mdec->info.size + len);
       break;
     }
 
-    gst_adapter_flush (y4mdec->adapter, len + 1);
+    gst_y4m_dec_add_index_entry (y4mdec, y4mdec->frame_index, y4mdec->offset,
+        len);
 
+    gst_adapter_flush (y4mdec->adapter, len);
     buffer = gst_adapter_take_buffer (y4mdec->adapter, y4mdec->info.size);
+    y4mdec->offset += len + y4mdec->info.size;
 
-    GST_BUFFER_TIMESTAMP (buffer) =
-        gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index);
-    GST_BUFFER_DURATION (buffer) =
-        gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index + 1) -
-        GST_BUFFER_TIMESTAMP (buffer);
+    flow_ret = gst_y4m_dec_push_frame (y4mdec, buffer);
+    if (flow_ret != GST_FLOW_OK)
+      break;
+  }
 
-    y4mdec->frame_index++;
+  GST_DEBUG ("returning %d", flow_ret);
 
-    if (y4mdec->video_meta) {
-      gst_buffer_add_video_meta_full (buffer, 0, y4mdec->info.finfo->format,
-          y4mdec->info.width, y4mdec->info.height, y4mdec->info.finfo->n_planes,
-          y4mdec->info.offset, y4mdec->info.stride);
-    } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
-            sizeof (y4mdec->info)) != 0) {
-      GstBuffer *outbuf;
-      GstVideoFrame iframe, oframe;
-      gint i, j;
-      gint w, h, istride, ostride;
-      guint8 *src, *dest;
-
-      /* Allocate a new buffer and do stride conversion */
-      g_assert (y4mdec->pool != NULL);
-
-      flow_ret = gst_buffer_pool_acquire_buffer (y4mdec->pool, &outbuf, NULL);
-      if (flow_ret != GST_FLOW_OK) {
-        gst_buffer_unref (buffer);
-        break;
-      }
+  return flow_ret;
+}
 
-      gst_video_frame_map (&iframe, &y4mdec->info, buffer, GST_MAP_READ);
-      gst_video_frame_map (&oframe, &y4mdec->out_info, outbuf, GST_MAP_WRITE);
+static GstFlowReturn
+gst_y4m_dec_pull_header (GstY4mDec * y4mdec)
+{
+  GstFlowReturn ret;
+  GstBuffer *buffer = NULL;
+  char header[MAX_HEADER_LENGTH];
+  gchar *stream_id;
 
-      for (i = 0; i < 3; i++) {
-        w = GST_VIDEO_FRAME_COMP_WIDTH (&iframe, i);
-        h = GST_VIDEO_FRAME_COMP_HEIGHT (&iframe, i);
-        istride = GST_VIDEO_FRAME_COMP_STRIDE (&iframe, i);
-        ostride = GST_VIDEO_FRAME_COMP_STRIDE (&oframe, i);
-        src = GST_VIDEO_FRAME_COMP_DATA (&iframe, i);
-        dest = GST_VIDEO_FRAME_COMP_DATA (&oframe, i);
+  ret = gst_pad_pull_range (y4mdec->sinkpad, 0, MAX_HEADER_LENGTH, &buffer);
+  if (ret != GST_FLOW_OK)
+    return ret;
 
-        for (j = 0; j < h; j++) {
-          memcpy (dest, src, w);
+  memset (header, 0, sizeof (header));
+  gst_buffer_extract (buffer, 0, header, MAX_HEADER_LENGTH);
+  gst_buffer_unref (buffer);
 
-          dest += ostride;
-          src += istride;
-        }
-      }
+  if (!gst_y4m_dec_handle_header (y4mdec, header))
+    return GST_FLOW_ERROR;
 
-      gst_video_frame_unmap (&iframe);
-      gst_video_frame_unmap (&oframe);
-      gst_buffer_copy_into (outbuf, buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
-      gst_buffer_unref (buffer);
-      buffer = outbuf;
-    }
+  stream_id = gst_pad_create_stream_id (y4mdec->srcpad,
+      GST_ELEMENT_CAST (y4mdec), NULL);
+  gst_pad_push_event (y4mdec->srcpad, gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
 
-    flow_ret = gst_pad_push (y4mdec->srcpad, buffer);
-    if (flow_ret != GST_FLOW_OK)
+  if (!gst_y4m_dec_negotiate (y4mdec))
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  y4mdec->have_header = TRUE;
+
+  return GST_FLOW_OK;
+}
+
+/* Makes sure the index has an entry for frame_index by reading the FRAME
+ * headers of all frames up to it. Only the headers are read, the frame data
+ * is skipped */
+static GstFlowReturn
+gst_y4m_dec_index_to_frame (GstY4mDec * y4mdec, gint64 frame_index)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  while (y4mdec->index->len <= frame_index) {
+    GstBuffer *buffer = NULL;
+    GstMapInfo map;
+    gint len;
+
+    ret = gst_pad_pull_range (y4mdec->sinkpad, y4mdec->index_offset,
+        MAX_HEADER_LENGTH, &buffer);
+    if (ret != GST_FLOW_OK)
+      break;
+
+    gst_buffer_map (buffer, &map, GST_MAP_READ);
+    len = gst_y4m_dec_frame_header_length (map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+    gst_buffer_unref (buffer);
+
+    if (len == 0) {
+      GST_DEBUG_OBJECT (y4mdec, "truncated frame header at %" G_GUINT64_FORMAT,
+          y4mdec->index_offset);
+      ret = GST_FLOW_EOS;
       break;
+    } else if (len < 0) {
+      GST_ELEMENT_ERROR (y4mdec, STREAM, DECODE,
+          ("Failed to parse YUV4MPEG frame"), (NULL));
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+
+    gst_y4m_dec_add_index_entry (y4mdec, y4mdec->index->len,
+        y4mdec->index_offset, len);
   }
 
-  GST_DEBUG ("returning %d", flow_ret);
+  return ret;
+}
 
-  return flow_ret;
+static void
+gst_y4m_dec_loop (GstY4mDec * y4mdec)
+{
+  GstFlowReturn ret;
+  GstY4mDecIndexEntry *entry;
+  GstBuffer *buffer = NULL;
+
+  if (!y4mdec->have_header) {
+    ret = gst_y4m_dec_pull_header (y4mdec);
+    if (ret != GST_FLOW_OK)
+      goto pause;
+  }
+
+  if (y4mdec->have_new_segment) {
+    gst_pad_push_event (y4mdec->srcpad,
+        gst_event_new_segment (&y4mdec->segment));
+    y4mdec->have_new_segment = FALSE;
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (y4mdec->segment.stop) &&
+      gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index) >=
+      y4mdec->segment.stop) {
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  ret = gst_y4m_dec_index_to_frame (y4mdec, y4mdec->frame_index);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  entry = &g_array_index (y4mdec->index, GstY4mDecIndexEntry,
+      y4mdec->frame_index);
+
+  /* Read the frame data directly, upstream allocates the memory so no
+   * copies are made in between */
+  ret = gst_pad_pull_range (y4mdec->sinkpad,
+      entry->offset + entry->header_size, y4mdec->info.size, &buffer);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  if (gst_buffer_get_size (buffer) < y4mdec->info.size) {
+    GST_DEBUG_OBJECT (y4mdec, "truncated frame %d", y4mdec->frame_index);
+    gst_buffer_unref (buffer);
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  ret = gst_y4m_dec_push_frame (y4mdec, buffer);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  return;
+
+pause:
+  {
+    GST_DEBUG_OBJECT (y4mdec, "pausing task, reason %s",
+        gst_flow_get_name (ret));
+    gst_pad_pause_task (y4mdec->sinkpad);
+    if (ret == GST_FLOW_EOS) {
+      gst_pad_push_event (y4mdec->srcpad, gst_event_new_eos ());
+    } else if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+      GST_ELEMENT_FLOW_ERROR (y4mdec, ret);
+      gst_pad_push_event (y4mdec->srcpad, gst_event_new_eos ());
+    }
+  }
+}
+
+static gboolean
+gst_y4m_dec_sink_activate (GstPad * sinkpad, GstObject * parent)
+{
+  GstQuery *query;
+  GstPadMode mode = GST_PAD_MODE_PUSH;
+
+  query = gst_query_new_scheduling ();
+
+  if (gst_pad_peer_query (sinkpad, query)) {
+    if (gst_query_has_scheduling_mode_with_flags (query,
+            GST_PAD_MODE_PULL, GST_SCHEDULING_FLAG_SEEKABLE))
+      mode = GST_PAD_MODE_PULL;
+  }
+  gst_query_unref (query);
+
+  return gst_pad_activate_mode (sinkpad, mode, TRUE);
+}
+
+static gboolean
+gst_y4m_dec_sink_activate_mode (GstPad * sinkpad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  GstY4mDec *y4mdec = GST_Y4M_DEC (parent);
+
+  if (mode == GST_PAD_MODE_PUSH) {
+    y4mdec->pull_mode = FALSE;
+  } else {
+    if (active) {
+      y4mdec->pull_mode = TRUE;
+      gst_segment_init (&y4mdec->segment, GST_FORMAT_TIME);
+      y4mdec->have_new_segment = TRUE;
+      return gst_pad_start_task (sinkpad, (GstTaskFunction) gst_y4m_dec_loop,
+          y4mdec, NULL);
+    } else {
+      y4mdec->pull_mode = FALSE;
+      return gst_pad_stop_task (sinkpad);
+    }
+  }
+
+  return TRUE;
 }
 
 static gboolean
@@ -779,6 +1086,76 @@ gst_y4m_dec_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
   return res;
 }
 
+static gboolean
+gst_y4m_dec_pull_seek (GstY4mDec * y4mdec, GstEvent * event)
+{
+  gdouble rate;
+  GstFormat format;
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  gint64 start, stop;
+  gint64 framenum;
+  GstSegment seeksegment;
+  gboolean flush;
+  guint32 seqnum;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type,
+      &start, &stop_type, &stop);
+  seqnum = gst_event_get_seqnum (event);
+
+  if (format != GST_FORMAT_TIME || rate <= 0.0) {
+    GST_DEBUG_OBJECT (y4mdec, "unsupported seek");
+    return FALSE;
+  }
+
+  if (!y4mdec->have_header) {
+    GST_DEBUG_OBJECT (y4mdec, "can't seek before the header was parsed");
+    return FALSE;
+  }
+
+  flush = ! !(flags & GST_SEEK_FLAG_FLUSH);
+
+  if (flush) {
+    GstEvent *e = gst_event_new_flush_start ();
+
+    gst_event_set_seqnum (e, seqnum);
+    gst_pad_push_event (y4mdec->srcpad, e);
+  } else {
+    gst_pad_pause_task (y4mdec->sinkpad);
+  }
+
+  GST_PAD_STREAM_LOCK (y4mdec->sinkpad);
+
+  seeksegment = y4mdec->segment;
+  gst_segment_do_seek (&seeksegment, rate, format, flags, start_type, start,
+      stop_type, stop, NULL);
+
+  framenum = gst_y4m_dec_timestamp_to_frames (y4mdec, seeksegment.position);
+  GST_DEBUG_OBJECT (y4mdec, "seeking to frame %" G_GINT64_FORMAT, framenum);
+
+  /* Index up to the target already, if it is past the end the streaming
+   * thread will run into EOS again */
+  gst_y4m_dec_index_to_frame (y4mdec, framenum);
+
+  if (flush) {
+    GstEvent *e = gst_event_new_flush_stop (TRUE);
+
+    gst_event_set_seqnum (e, seqnum);
+    gst_pad_push_event (y4mdec->srcpad, e);
+  }
+
+  y4mdec->segment = seeksegment;
+  y4mdec->frame_index = framenum;
+  y4mdec->have_new_segment = TRUE;
+
+  gst_pad_start_task (y4mdec->sinkpad, (GstTaskFunction) gst_y4m_dec_loop,
+      y4mdec, NULL);
+
+  GST_PAD_STREAM_UNLOCK (y4mdec->sinkpad);
+
+  return TRUE;
+}
+
 static gboolean
 gst_y4m_dec_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
@@ -800,6 +1177,12 @@ gst_y4m_dec_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
       gint64 framenum;
       guint64 byte;
 
+      if (y4mdec->pull_mode) {
+        res = gst_y4m_dec_pull_seek (y4mdec, event);
+        gst_event_unref (event);
+        break;
+      }
+
       gst_event_parse_seek (event, &rate, &format, &flags, &start_type,
           &start, &stop_type, &stop);
 
@@ -47,6 +47,15 @@ struct _GstY4mDec
   int frame_index;
   int header_size;
 
+  /* byte offset of the next buffer from the adapter in push mode */
+  guint64 offset;
+  gboolean pull_mode;
+
+  /* lazily built index of GstY4mDecIndexEntry, one per frame in order */
+  GArray *index;
+  /* offset of the FRAME header following the last indexed frame */
+  guint64 index_offset;
+
   gboolean have_new_segment;
   GstSegment segment;
 
@@ -1102,6 +1102,154 @@ GST_START_TEST (test_audiointerleave_2ch_smallbuf)
 
 GST_END_TEST;
 
+#define N_INPUTS 5
+#define RATE 48000
+/* output buffers of 1200 frames, which are interleaved in blocks of 8kB */
+#define OUT_DURATION (25 * GST_MSECOND)
+#define TOTAL_FRAMES 4800
+
+typedef struct
+{
+  GstHarness *h;
+  gint channel;
+  guint width;
+  guint buffer_frames;
+} InputStream;
+
+static guint32
+input_sample (gint channel, guint64 frame)
+{
+  return (channel << 12) | (frame & 0xfff);
+}
+
+/* Pushes mono little-endian samples of @width bytes in buffers that are
+ * not aligned to the output buffers or blocks */
+static gpointer
+push_input_thread (InputStream * input)
+{
+  guint64 offset;
+  guint i, j;
+
+  for (offset = 0; offset < TOTAL_FRAMES; offset += input->buffer_frames) {
+    GstBuffer *buf;
+    GstMapInfo map;
+
+    buf = gst_buffer_new_allocate (NULL, input->buffer_frames * input->width,
+        NULL);
+    gst_buffer_map (buf, &map, GST_MAP_WRITE);
+    for (i = 0; i < input->buffer_frames; i++) {
+      guint32 sample = input_sample (input->channel, offset + i);
+
+      for (j = 0; j < input->width; j++)
+        map.data[i * input->width + j] = (sample >> (8 * j)) & 0xff;
+    }
+    gst_buffer_unmap (buf, &map);
+
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (offset, GST_SECOND, RATE);
+    GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (offset +
+        input->buffer_frames, GST_SECOND, RATE) - GST_BUFFER_PTS (buf);
+    GST_BUFFER_OFFSET (buf) = offset;
+    fail_unless_equals_int (gst_harness_push (input->h, buf), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (input->h, gst_event_new_eos ()));
+
+  return NULL;
+}
+
+/* Interleaves N_INPUTS mono streams, where input i comes in buffers of
+ * @buffer_frames + i * @frames_step frames, and compares the output with
+ * the expected interleaved samples */
+static void
+check_interleave_inputs (const gchar * format, guint width,
+    guint buffer_frames, guint frames_step)
+{
+  GstElement *audiointerleave;
+  InputStream inputs[N_INPUTS];
+  GThread *threads[N_INPUTS];
+  guint64 n_frames = 0;
+  guint i, c;
+
+  audiointerleave = gst_element_factory_make ("audiointerleave", NULL);
+  g_object_set (audiointerleave, "output-buffer-duration", OUT_DURATION,
+      NULL);
+
+  for (i = 0; i < N_INPUTS; i++) {
+    gchar *name, *caps;
+
+    /* the positions are in the default order, so input i is channel i */
+    name = g_strdup_printf ("sink_%u", i);
+    inputs[i].h = gst_harness_new_with_element (audiointerleave, name,
+        i == 0 ? "src" : NULL);
+    g_free (name);
+    caps = g_strdup_printf ("audio/x-raw, format=(string)%s, "
+        "channels=(int)1, layout=(string)interleaved, rate=(int)%d, "
+        "channel-mask=(bitmask)0x%x", format, RATE, 1 << i);
+    gst_harness_set_src_caps_str (inputs[i].h, caps);
+    g_free (caps);
+
+    inputs[i].channel = i;
+    inputs[i].width = width;
+    inputs[i].buffer_frames = buffer_frames + i * frames_step;
+  }
+
+  /* every input blocks until the others caught up, so they need their own
+   * threads */
+  for (i = 0; i < N_INPUTS; i++)
+    threads[i] = g_thread_new ("input", (GThreadFunc) push_input_thread,
+        &inputs[i]);
+
+  while (n_frames < TOTAL_FRAMES) {
+    GstBuffer *buf = gst_harness_pull (inputs[0].h);
+    GstMapInfo map;
+    guint frames;
+
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    frames = map.size / (N_INPUTS * width);
+    for (i = 0; i < frames && n_frames + i < TOTAL_FRAMES; i++) {
+      for (c = 0; c < N_INPUTS; c++) {
+        const guint8 *p = map.data + (i * N_INPUTS + c) * width;
+        guint32 sample = 0;
+        guint j;
+
+        for (j = 0; j < width; j++)
+          sample |= p[j] << (8 * j);
+        fail_unless_equals_int (sample, input_sample (c, n_frames + i));
+      }
+    }
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+    n_frames += frames;
+  }
+
+  for (i = 0; i < N_INPUTS; i++)
+    g_thread_join (threads[i]);
+  for (i = 0; i < N_INPUTS; i++)
+    gst_harness_teardown (inputs[i].h);
+  gst_object_unref (audiointerleave);
+}
+
+/* Same ranges on all inputs, so the first four channels are interleaved
+ * together */
+GST_START_TEST (test_audiointerleave_5ch_same_ranges)
+{
+  check_interleave_inputs ("S16LE", 2, 441, 0);
+  check_interleave_inputs ("S24LE", 3, 441, 0);
+  check_interleave_inputs ("S32LE", 4, 441, 0);
+}
+
+GST_END_TEST;
+
+/* Different ranges on all inputs, so every channel is interleaved on its
+ * own */
+GST_START_TEST (test_audiointerleave_5ch_different_ranges)
+{
+  check_interleave_inputs ("S16LE", 2, 441, 37);
+  check_interleave_inputs ("S24LE", 3, 441, 37);
+  check_interleave_inputs ("S32LE", 4, 441, 37);
+}
+
+GST_END_TEST;
+
 static Suite *
 audiointerleave_suite (void)
 {
@@ -1121,6 +1269,8 @@ audiointerleave_suite (void)
   tcase_add_test (tc_chain, test_audiointerleave_2ch_pipeline_custom_chanpos);
   tcase_add_test (tc_chain, test_audiointerleave_2ch_pipeline_no_chanpos);
   tcase_add_test (tc_chain, test_audiointerleave_2ch_smallbuf);
+  tcase_add_test (tc_chain, test_audiointerleave_5ch_same_ranges);
+  tcase_add_test (tc_chain, test_audiointerleave_5ch_different_ranges);
 
   return s;
 }
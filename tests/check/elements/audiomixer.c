@@ -1721,6 +1721,178 @@ GST_START_TEST (test_sinkpad_property_controller)
 
 GST_END_TEST;
 
+static GstBuffer *
+new_f32_buffer (guint num_frames, gfloat value, GstClockTime ts,
+    GstClockTime dur)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (num_frames * sizeof (gfloat));
+  GstMapInfo map;
+  guint i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (i = 0; i < num_frames; i++)
+    ((gfloat *) map.data)[i] = value;
+  gst_buffer_unmap (buffer, &map);
+  GST_BUFFER_TIMESTAMP (buffer) = ts;
+  GST_BUFFER_DURATION (buffer) = dur;
+  return buffer;
+}
+
+/* Mix a constant signal at 1000Hz with a linear volume ramp of 10ms and
+ * check that a volume change results in a 10 sample ramp instead of a step */
+GST_START_TEST (test_sinkpad_volume_ramp)
+{
+  GstSegment segment;
+  GstElement *bin, *audiomixer, *sink;
+  GstPad *sinkpad;
+  GstFlowReturn ret;
+  GstCaps *caps;
+  GstQuery *drain;
+  GstMapInfo map;
+  gfloat *samples;
+  gint i;
+
+  bin = gst_pipeline_new ("pipeline");
+  audiomixer = gst_element_factory_make ("audiomixer", "audiomixer");
+  g_object_set (audiomixer, "output-buffer-duration", 20 * GST_MSECOND, NULL);
+  sink = gst_element_factory_make ("fakesink", "sink");
+  g_object_set (sink, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", (GCallback) handoff_buffer_cb, NULL);
+  gst_bin_add_many (GST_BIN (bin), audiomixer, sink, NULL);
+  fail_unless (gst_element_link (audiomixer, sink));
+
+  ck_assert_int_ne (gst_element_set_state (bin, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_FAILURE);
+
+  sinkpad = gst_element_get_request_pad (audiomixer, "sink_%u");
+  fail_if (sinkpad == NULL, NULL);
+  gst_util_set_object_arg (G_OBJECT (sinkpad), "volume-ramp-mode", "linear");
+  g_object_set (sinkpad, "volume-ramp-duration", 10 * GST_MSECOND, NULL);
+
+  gst_pad_send_event (sinkpad, gst_event_new_stream_start ("test"));
+  caps = gst_caps_new_simple ("audio/x-raw",
+      "format", G_TYPE_STRING, GST_AUDIO_NE (F32),
+      "layout", G_TYPE_STRING, "interleaved",
+      "rate", G_TYPE_INT, 1000, "channels", G_TYPE_INT, 1, NULL);
+  gst_pad_set_caps (sinkpad, caps);
+  gst_caps_unref (caps);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_send_event (sinkpad, gst_event_new_segment (&segment));
+
+  gst_buffer_replace (&handoff_buffer, NULL);
+
+  /* the first buffer is mixed at the initial volume of 1.0 */
+  ret = gst_pad_chain (sinkpad, new_f32_buffer (20, 1.0, 0,
+          20 * GST_MSECOND));
+  ck_assert_int_eq (ret, GST_FLOW_OK);
+  drain = gst_query_new_drain ();
+  gst_pad_query (sinkpad, drain);
+  gst_query_unref (drain);
+  fail_unless (handoff_buffer != NULL);
+  gst_buffer_map (handoff_buffer, &map, GST_MAP_READ);
+  samples = (gfloat *) map.data;
+  for (i = 0; i < 20; i++)
+    fail_unless_equals_float (samples[i], 1.0);
+  gst_buffer_unmap (handoff_buffer, &map);
+
+  /* then ramp down to 0.0 over the first 10 samples of the next buffer */
+  g_object_set (sinkpad, "volume", 0.0, NULL);
+  ret = gst_pad_chain (sinkpad, new_f32_buffer (20, 1.0, 20 * GST_MSECOND,
+          20 * GST_MSECOND));
+  ck_assert_int_eq (ret, GST_FLOW_OK);
+  drain = gst_query_new_drain ();
+  gst_pad_query (sinkpad, drain);
+  gst_query_unref (drain);
+  gst_buffer_map (handoff_buffer, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, 20 * sizeof (gfloat));
+  samples = (gfloat *) map.data;
+  for (i = 0; i < 10; i++)
+    fail_unless (ABS (samples[i] - (1.0 - i / 10.0)) < 1e-5);
+  for (i = 10; i < 20; i++)
+    fail_unless_equals_float (samples[i], 0.0);
+  gst_buffer_unmap (handoff_buffer, &map);
+  gst_buffer_replace (&handoff_buffer, NULL);
+
+  gst_element_release_request_pad (audiomixer, sinkpad);
+  gst_object_unref (sinkpad);
+  gst_element_set_state (bin, GST_STATE_NULL);
+  gst_object_unref (bin);
+}
+
+GST_END_TEST;
+
+#define BENCHMARK_BUFFERS 250
+#define BENCHMARK_SAMPLES_PER_BUFFER 960
+#define BENCHMARK_DURATION (BENCHMARK_BUFFERS * 20 * GST_MSECOND)
+
+static gboolean
+setup_benchmark_pad (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  if (GPOINTER_TO_INT (user_data)) {
+    gst_util_set_object_arg (G_OBJECT (pad), "volume-ramp-mode", "linear");
+    g_object_set (pad, "volume-ramp-duration", 10 * GST_MSECOND, NULL);
+  }
+  set_pad_volume_fade (pad, 0, 0.0, BENCHMARK_DURATION, 1.0);
+
+  return TRUE;
+}
+
+/* Mixes @n_pads streams whose volumes all fade in, so that the volume
+ * changes with every buffer, and logs the time needed */
+static void
+run_mix_benchmark (guint n_pads, gboolean ramp)
+{
+  GstElement *pipeline, *mix;
+  GstMessage *msg;
+  GString *desc;
+  gint64 start, elapsed;
+  GstBus *bus;
+  guint i;
+
+  desc = g_string_new ("audiomixer name=mix ! audio/x-raw,format="
+      GST_AUDIO_NE (F32) ",rate=48000,channels=2 ! fakesink sync=false");
+  for (i = 0; i < n_pads; i++)
+    g_string_append_printf (desc, " audiotestsrc num-buffers=%d "
+        "samplesperbuffer=%d freq=%u ! mix.", BENCHMARK_BUFFERS,
+        BENCHMARK_SAMPLES_PER_BUFFER, 200 + 10 * i);
+  pipeline = gst_parse_launch (desc->str, NULL);
+  g_string_free (desc, TRUE);
+  fail_unless (pipeline != NULL);
+
+  mix = gst_bin_get_by_name (GST_BIN (pipeline), "mix");
+  gst_element_foreach_sink_pad (mix, setup_benchmark_pad,
+      GINT_TO_POINTER (ramp));
+  gst_object_unref (mix);
+
+  start = g_get_monotonic_time ();
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = g_get_monotonic_time () - start;
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  GST_INFO ("%u pads, volume ramping %s: %" GST_TIME_FORMAT
+      " of audio mixed in %" G_GINT64_FORMAT " us", n_pads,
+      ramp ? "on" : "off", GST_TIME_ARGS (BENCHMARK_DURATION), elapsed);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+GST_START_TEST (test_benchmark)
+{
+  run_mix_benchmark (32, FALSE);
+  run_mix_benchmark (32, TRUE);
+  run_mix_benchmark (128, FALSE);
+  run_mix_benchmark (128, TRUE);
+}
+
+GST_END_TEST;
+
 static void
 change_src_caps (GstElement * fakesink, GstBuffer * buffer, GstPad * pad,
     GstElement * capsfilter)
@@ -1874,6 +2046,7 @@ audiomixer_suite (void)
   tcase_add_test (tc_chain, test_sync_unaligned);
   tcase_add_test (tc_chain, test_segment_base_handling);
   tcase_add_test (tc_chain, test_sinkpad_property_controller);
+  tcase_add_test (tc_chain, test_sinkpad_volume_ramp);
   tcase_add_checked_fixture (tc_chain, test_setup, test_teardown);
   tcase_add_test (tc_chain, test_change_output_caps);
 
@@ -1888,6 +2061,15 @@ audiomixer_suite (void)
     /* tcase_set_timeout (tc_chain, 6); */
   }
 
+  /* mixing many pads takes a while, only run when asked for */
+  if (g_getenv ("GST_CHECK_BENCHMARK")) {
+    TCase *tc_benchmark = tcase_create ("benchmark");
+
+    suite_add_tcase (s, tc_benchmark);
+    tcase_set_timeout (tc_benchmark, 120);
+    tcase_add_test (tc_benchmark, test_benchmark);
+  }
+
   return s;
 }
 
@@ -0,0 +1,223 @@
+/* GStreamer unit tests for the audiovisualizers elements
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define RATE 44100
+#define FPS 25
+#define SAMPLES_PER_FRAME (RATE / FPS)
+
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+#define AUDIO_FORMAT "S16BE"
+#define VIDEO_FORMAT "xRGB"
+#else
+#define AUDIO_FORMAT "S16LE"
+#define VIDEO_FORMAT "BGRx"
+#endif
+
+static const gchar *scopes[] = { "spectrascope", "synaescope", "wavescope",
+  "spacescope"
+};
+
+/* One video frame worth of stereo audio with a sawtooth that gets higher
+ * with every frame on the left and its inverse on the right */
+static GstBuffer *
+create_audio_buffer (guint frame)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  gint16 *samples;
+  guint i, period = 200 - 10 * (frame % 16);
+
+  buf = gst_buffer_new_and_alloc (SAMPLES_PER_FRAME * 2 * sizeof (gint16));
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  samples = (gint16 *) map.data;
+  for (i = 0; i < SAMPLES_PER_FRAME; i++) {
+    gint v = ((frame * SAMPLES_PER_FRAME + i) % period) * 32000 / period;
+
+    v -= 16000;
+
+    samples[2 * i] = v;
+    samples[2 * i + 1] = -v / 2;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale_int (frame, GST_SECOND, FPS);
+  GST_BUFFER_DURATION (buf) = GST_SECOND / FPS;
+
+  return buf;
+}
+
+static GstHarness *
+create_harness (const gchar * scope, const gchar * props, gint width,
+    gint height)
+{
+  GstHarness *h;
+  gchar *desc, *caps;
+
+  desc = g_strdup_printf ("%s %s", scope, props);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+
+  caps = g_strdup_printf ("video/x-raw,format=" VIDEO_FORMAT ",width=%d,"
+      "height=%d,framerate=%d/1", width, height, FPS);
+  gst_harness_set_caps_str (h, "audio/x-raw,format=" AUDIO_FORMAT ","
+      "layout=interleaved,rate=44100,channels=2,channel-mask=(bitmask)0x3",
+      caps);
+  g_free (caps);
+
+  return h;
+}
+
+/* Renders frames of the sawtooth and returns their checksums */
+static GPtrArray *
+render (const gchar * scope, const gchar * props, guint n_frames)
+{
+  GPtrArray *checksums = g_ptr_array_new_with_free_func (g_free);
+  GstHarness *h;
+  GstBuffer *outbuf;
+  GstMapInfo map;
+  guint i;
+
+  h = create_harness (scope, props, 320, 200);
+  for (i = 0; i < n_frames; i++) {
+    fail_unless_equals_int (gst_harness_push (h, create_audio_buffer (i)),
+        GST_FLOW_OK);
+    while ((outbuf = gst_harness_try_pull (h))) {
+      gst_buffer_map (outbuf, &map, GST_MAP_READ);
+      g_ptr_array_add (checksums,
+          g_compute_checksum_for_data (G_CHECKSUM_SHA1, map.data, map.size));
+      gst_buffer_unmap (outbuf, &map);
+      gst_buffer_unref (outbuf);
+    }
+  }
+  gst_harness_teardown (h);
+
+  return checksums;
+}
+
+/* With a render interval of n only every n-th frame is rendered, the ones
+ * in between repeat it */
+GST_START_TEST (test_render_interval)
+{
+  GPtrArray *reference, *checksums;
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (scopes); i++) {
+    reference = render (scopes[i], "render-interval=1", 12);
+    checksums = render (scopes[i], "render-interval=3", 12);
+    fail_unless (checksums->len > 3);
+    fail_unless_equals_int (checksums->len, reference->len);
+
+    /* the first frame is rendered the same way by both */
+    fail_unless_equals_string (g_ptr_array_index (checksums, 0),
+        g_ptr_array_index (reference, 0));
+    for (j = 1; j < checksums->len; j++) {
+      if (j % 3 != 0)
+        fail_unless_equals_string (g_ptr_array_index (checksums, j),
+            g_ptr_array_index (checksums, j - 1));
+    }
+
+    g_ptr_array_unref (checksums);
+    g_ptr_array_unref (reference);
+  }
+}
+
+GST_END_TEST;
+
+#define BENCHMARK_STREAMS 8
+#define BENCHMARK_FRAMES 50
+
+/* Renders several streams one after the other, like a server rendering many
+ * radio streams, and logs the CPU time needed per stream */
+static void
+run_benchmark (const gchar * scope, guint interval)
+{
+  GstHarness *h[BENCHMARK_STREAMS];
+  GstBuffer *inbuf[BENCHMARK_FRAMES], *outbuf;
+  gint64 start, elapsed;
+  gchar *props;
+  guint i, j;
+
+  for (i = 0; i < BENCHMARK_FRAMES; i++)
+    inbuf[i] = create_audio_buffer (i);
+
+  props = g_strdup_printf ("render-interval=%u", interval);
+  for (j = 0; j < BENCHMARK_STREAMS; j++)
+    h[j] = create_harness (scope, props, 640, 360);
+  g_free (props);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCHMARK_FRAMES; i++) {
+    for (j = 0; j < BENCHMARK_STREAMS; j++) {
+      fail_unless_equals_int (gst_harness_push (h[j],
+              gst_buffer_ref (inbuf[i])), GST_FLOW_OK);
+      while ((outbuf = gst_harness_try_pull (h[j])))
+        gst_buffer_unref (outbuf);
+    }
+  }
+  elapsed = g_get_monotonic_time () - start;
+
+  /* the share of one CPU needed to render one stream in real time */
+  GST_INFO ("%s render-interval=%u: %d streams of %d frames in %"
+      G_GINT64_FORMAT " us, %.2f%% CPU per stream", scope, interval,
+      BENCHMARK_STREAMS, BENCHMARK_FRAMES, elapsed,
+      100.0 * elapsed / BENCHMARK_STREAMS / (BENCHMARK_FRAMES * 1000000.0 /
+          FPS));
+
+  for (j = 0; j < BENCHMARK_STREAMS; j++)
+    gst_harness_teardown (h[j]);
+  for (i = 0; i < BENCHMARK_FRAMES; i++)
+    gst_buffer_unref (inbuf[i]);
+}
+
+GST_START_TEST (test_benchmark)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (scopes); i++) {
+    run_benchmark (scopes[i], 1);
+    run_benchmark (scopes[i], 5);
+  }
+}
+
+GST_END_TEST;
+
+static Suite *
+audiovisualizers_suite (void)
+{
+  Suite *s = suite_create ("audiovisualizers");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_set_timeout (tc_chain, 120);
+  tcase_add_test (tc_chain, test_render_interval);
+  /* rendering many streams with every scope takes a while, only run when
+   * asked for */
+  if (g_getenv ("GST_CHECK_BENCHMARK"))
+    tcase_add_test (tc_chain, test_benchmark);
+
+  return s;
+}
+
+GST_CHECK_MAIN (audiovisualizers);
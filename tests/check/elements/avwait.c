@@ -0,0 +1,341 @@
+/* GStreamer unit tests for the avwait element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+#define FPS 25
+#define RATE 48000
+#define FRAME_DURATION (GST_SECOND / FPS)
+#define SAMPLES_PER_FRAME (RATE / FPS)
+
+#define VIDEO_CAPS_STRING \
+  "video/x-raw, format=(string)I420, width=(int)64, height=(int)48, " \
+  "framerate=(fraction)25/1"
+#define AUDIO_CAPS_STRING \
+  "audio/x-raw, format=(string)S16LE, rate=(int)48000, channels=(int)1, " \
+  "layout=(string)interleaved"
+
+/* values of the mode property */
+#define MODE_TIMECODE 0
+#define MODE_VIDEO_FIRST 2
+
+/* Time to give the audio thread for blocking in the element */
+#define WAIT_TIME (G_USEC_PER_SEC / 10)
+
+static GstElement *avwait;
+static GstHarness *hv, *ha;
+
+/* The element has to be created and configured before starting the
+ * harnesses on its video and audio pads */
+static void
+start_harnesses (void)
+{
+  hv = gst_harness_new_with_element (avwait, "vsink", "vsrc");
+  gst_harness_set_src_caps_str (hv, VIDEO_CAPS_STRING);
+  ha = gst_harness_new_with_element (avwait, "asink", "asrc");
+  gst_harness_set_src_caps_str (ha, AUDIO_CAPS_STRING);
+}
+
+static void
+teardown_harnesses (void)
+{
+  gst_harness_teardown (ha);
+  gst_harness_teardown (hv);
+  gst_object_unref (avwait);
+}
+
+static GstBuffer *
+create_video_frame (gint n)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, 64 * 48 * 3 / 2, NULL);
+
+  GST_BUFFER_PTS (buf) = n * FRAME_DURATION;
+  GST_BUFFER_DURATION (buf) = FRAME_DURATION;
+  gst_buffer_add_video_time_code_meta_full (buf, FPS, 1, NULL,
+      GST_VIDEO_TIME_CODE_FLAGS_NONE, 0, 0, n / FPS, n % FPS, 0);
+
+  return buf;
+}
+
+static GstBuffer *
+create_audio_buffer (guint64 offset, guint n_samples)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, n_samples * 2, NULL);
+
+  gst_buffer_memset (buf, 0, 0, n_samples * 2);
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale (offset, GST_SECOND, RATE);
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (offset + n_samples,
+      GST_SECOND, RATE) - GST_BUFFER_PTS (buf);
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + n_samples;
+
+  return buf;
+}
+
+/* Pushes audio of the given length in buffers of @n_samples */
+static void
+push_audio (guint64 n_total, guint n_samples)
+{
+  guint64 offset;
+
+  for (offset = 0; offset < n_total; offset += n_samples)
+    fail_unless_equals_int (gst_harness_push (ha,
+            create_audio_buffer (offset, n_samples)), GST_FLOW_OK);
+}
+
+/* Checks that the audio output is contiguous and covers exactly the samples
+ * from @start to @end */
+static void
+check_audio_output (guint64 start, guint64 end)
+{
+  guint64 offset = start;
+  GstBuffer *buf;
+
+  while ((buf = gst_harness_try_pull (ha))) {
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf),
+        gst_util_uint64_scale (offset, GST_SECOND, RATE));
+    offset += gst_buffer_get_size (buf) / 2;
+    gst_buffer_unref (buf);
+  }
+  fail_unless_equals_uint64 (offset, end);
+}
+
+static void
+setup_timecode_mode (void)
+{
+  GstVideoTimeCode *tc, *end_tc;
+
+  avwait = gst_element_factory_make ("avwait", NULL);
+  fail_unless (avwait != NULL);
+  tc = gst_video_time_code_new (FPS, 1, NULL, GST_VIDEO_TIME_CODE_FLAGS_NONE,
+      0, 0, 1, 0, 0);
+  end_tc = gst_video_time_code_new (FPS, 1, NULL,
+      GST_VIDEO_TIME_CODE_FLAGS_NONE, 0, 0, 2, 0, 0);
+  /* the start has to be set first, the end is checked against it */
+  g_object_set (avwait, "mode", MODE_TIMECODE, "target-timecode", tc,
+      "end-timecode", end_tc, NULL);
+  gst_video_time_code_free (tc);
+  gst_video_time_code_free (end_tc);
+  start_harnesses ();
+}
+
+/* Only the video between the start and the end timecode passes, and the
+ * audio of the same running times */
+GST_START_TEST (test_timecode_start_end)
+{
+  GstBuffer *buf;
+  gint i;
+
+  setup_timecode_mode ();
+
+  for (i = 0; i < 3 * FPS; i++)
+    fail_unless_equals_int (gst_harness_push (hv, create_video_frame (i)),
+        GST_FLOW_OK);
+  for (i = FPS; i < 2 * FPS; i++) {
+    buf = gst_harness_pull (hv);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * FRAME_DURATION);
+    gst_buffer_unref (buf);
+  }
+  fail_unless (gst_harness_try_pull (hv) == NULL);
+
+  /* the video is ahead, so no audio waits */
+  push_audio (3 * RATE, SAMPLES_PER_FRAME);
+  check_audio_output (RATE, 2 * RATE);
+
+  teardown_harnesses ();
+}
+
+GST_END_TEST;
+
+/* Audio buffers crossing the start or the end are clipped to them */
+GST_START_TEST (test_audio_clipping)
+{
+  gint i;
+
+  setup_timecode_mode ();
+
+  for (i = 0; i < 3 * FPS; i++)
+    fail_unless_equals_int (gst_harness_push (hv, create_video_frame (i)),
+        GST_FLOW_OK);
+
+  /* 30ms buffers, neither 1s nor 2s is on a buffer boundary */
+  push_audio (3 * RATE, 1440);
+  check_audio_output (RATE, 2 * RATE);
+
+  teardown_harnesses ();
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  guint64 offset;
+  gint n_buffers;
+  GstFlowReturn ret;
+} AudioPush;
+
+/* Pushes audio buffers of one video frame each from another thread, as the
+ * audio can block in the element */
+static gpointer
+push_audio_thread (gpointer data)
+{
+  AudioPush *push = data;
+  gint i;
+
+  for (i = 0; i < push->n_buffers; i++) {
+    push->ret = gst_harness_push (ha, create_audio_buffer (push->offset +
+            i * SAMPLES_PER_FRAME, SAMPLES_PER_FRAME));
+    if (push->ret != GST_FLOW_OK)
+      break;
+  }
+
+  return NULL;
+}
+
+static void
+setup_video_first_mode (void)
+{
+  avwait = gst_element_factory_make ("avwait", NULL);
+  fail_unless (avwait != NULL);
+  g_object_set (avwait, "mode", MODE_VIDEO_FIRST, NULL);
+  start_harnesses ();
+}
+
+/* Audio arriving before the video waits until the video reached it */
+GST_START_TEST (test_audio_before_video)
+{
+  AudioPush push = { 0, 2, GST_FLOW_ERROR };
+  GstBuffer *buf;
+  GThread *thread;
+
+  setup_video_first_mode ();
+
+  thread = g_thread_new ("audio", push_audio_thread, &push);
+  g_usleep (WAIT_TIME);
+  fail_unless_equals_int (gst_harness_buffers_received (ha), 0);
+
+  /* the first audio buffer is not after the video anymore, the second one
+   * is */
+  fail_unless_equals_int (gst_harness_push (hv, create_video_frame (0)),
+      GST_FLOW_OK);
+  buf = gst_harness_pull (ha);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), 0);
+  gst_buffer_unref (buf);
+  g_usleep (WAIT_TIME);
+  fail_unless_equals_int (gst_harness_buffers_received (ha), 1);
+
+  fail_unless_equals_int (gst_harness_push (hv, create_video_frame (1)),
+      GST_FLOW_OK);
+  g_thread_join (thread);
+  fail_unless_equals_int (push.ret, GST_FLOW_OK);
+  buf = gst_harness_pull (ha);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), FRAME_DURATION);
+  gst_buffer_unref (buf);
+
+  teardown_harnesses ();
+}
+
+GST_END_TEST;
+
+/* A flush wakes up the waiting audio, which then returns flushing */
+GST_START_TEST (test_flush_while_waiting)
+{
+  AudioPush push = { 0, 1, GST_FLOW_ERROR };
+  GstSegment segment;
+  GstBuffer *buf;
+  GThread *thread;
+
+  setup_video_first_mode ();
+
+  thread = g_thread_new ("audio", push_audio_thread, &push);
+  g_usleep (WAIT_TIME);
+  fail_unless (gst_harness_push_event (ha, gst_event_new_flush_start ()));
+  g_thread_join (thread);
+  fail_unless_equals_int (push.ret, GST_FLOW_FLUSHING);
+  fail_unless_equals_int (gst_harness_buffers_received (ha), 0);
+
+  fail_unless (gst_harness_push_event (ha, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (ha, gst_event_new_segment (&segment)));
+
+  /* after the flush the audio waits again, until the video arrives */
+  push.ret = GST_FLOW_ERROR;
+  thread = g_thread_new ("audio", push_audio_thread, &push);
+  g_usleep (WAIT_TIME);
+  fail_unless_equals_int (gst_harness_buffers_received (ha), 0);
+  fail_unless_equals_int (gst_harness_push (hv, create_video_frame (0)),
+      GST_FLOW_OK);
+  g_thread_join (thread);
+  fail_unless_equals_int (push.ret, GST_FLOW_OK);
+  buf = gst_harness_pull (ha);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), 0);
+  gst_buffer_unref (buf);
+
+  teardown_harnesses ();
+}
+
+GST_END_TEST;
+
+/* With the video at EOS before it told where to start, the waiting audio is
+ * dropped and later audio doesn't wait anymore */
+GST_START_TEST (test_video_eos_while_waiting)
+{
+  AudioPush push = { 0, 1, GST_FLOW_ERROR };
+  GThread *thread;
+
+  setup_video_first_mode ();
+
+  thread = g_thread_new ("audio", push_audio_thread, &push);
+  g_usleep (WAIT_TIME);
+  fail_unless (gst_harness_push_event (hv, gst_event_new_eos ()));
+  g_thread_join (thread);
+  fail_unless_equals_int (push.ret, GST_FLOW_OK);
+
+  fail_unless_equals_int (gst_harness_push (ha,
+          create_audio_buffer (SAMPLES_PER_FRAME, SAMPLES_PER_FRAME)),
+      GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_received (ha), 0);
+
+  teardown_harnesses ();
+}
+
+GST_END_TEST;
+
+static Suite *
+avwait_suite (void)
+{
+  Suite *s = suite_create ("avwait");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_timecode_start_end);
+  tcase_add_test (tc_chain, test_audio_clipping);
+  tcase_add_test (tc_chain, test_audio_before_video);
+  tcase_add_test (tc_chain, test_flush_while_waiting);
+  tcase_add_test (tc_chain, test_video_eos_while_waiting);
+
+  return s;
+}
+
+GST_CHECK_MAIN (avwait);
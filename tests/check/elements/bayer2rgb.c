@@ -0,0 +1,343 @@
+/* GStreamer unit tests for the bayer2rgb element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define WIDTH 320
+#define HEIGHT 240
+
+static const gchar *patterns[] = { "bggr", "gbrg", "grbg", "rggb" };
+static const gchar *methods[] = { "linear", "malvar" };
+
+/* Bayer samples of the given depth, stored as 16-bit words if deeper than
+ * 8 bits */
+static GstBuffer *
+create_bayer_buffer (const guint16 * samples, gint depth, gboolean big_endian)
+{
+  gint bps = depth > 8 ? 2 : 1;
+  GstBuffer *buf;
+  GstMapInfo map;
+  gint i;
+
+  buf = gst_buffer_new_and_alloc (WIDTH * HEIGHT * bps);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  for (i = 0; i < WIDTH * HEIGHT; i++) {
+    if (depth == 8)
+      map.data[i] = samples[i];
+    else if (big_endian)
+      GST_WRITE_UINT16_BE (map.data + 2 * i, samples[i]);
+    else
+      GST_WRITE_UINT16_LE (map.data + 2 * i, samples[i]);
+  }
+  gst_buffer_unmap (buf, &map);
+
+  return buf;
+}
+
+/* Random samples of the given depth */
+static guint16 *
+create_samples (gint depth)
+{
+  guint16 *samples = g_new (guint16, WIDTH * HEIGHT);
+  GRand *rand = g_rand_new_with_seed (depth);
+  gint i;
+
+  for (i = 0; i < WIDTH * HEIGHT; i++)
+    samples[i] = g_rand_int_range (rand, 0, 1 << depth);
+  g_rand_free (rand);
+
+  return samples;
+}
+
+static gchar *
+bayer_format (const gchar * pattern, gint depth, gboolean big_endian)
+{
+  if (depth == 8)
+    return g_strdup (pattern);
+
+  return g_strdup_printf ("%s%d%s", pattern, depth, big_endian ? "be" : "le");
+}
+
+/* Converts one frame to BGRx */
+static GstBuffer *
+convert (const gchar * format, const gchar * props, GstBuffer * inbuf)
+{
+  GstHarness *h;
+  GstBuffer *outbuf;
+  gchar *desc, *caps;
+
+  desc = g_strdup_printf ("bayer2rgb %s", props);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+
+  caps = g_strdup_printf ("video/x-bayer,format=%s,width=%d,height=%d,"
+      "framerate=30/1", format, WIDTH, HEIGHT);
+  gst_harness_set_caps_str (h, caps, "video/x-raw,format=BGRx");
+  g_free (caps);
+
+  fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (inbuf)),
+      GST_FLOW_OK);
+  outbuf = gst_harness_pull (h);
+  fail_unless (outbuf != NULL);
+  fail_unless_equals_int (gst_buffer_get_size (outbuf), WIDTH * HEIGHT * 4);
+
+  gst_harness_teardown (h);
+
+  return outbuf;
+}
+
+static void
+check_same_frames (GstBuffer * reference, GstBuffer * buf, gint tolerance)
+{
+  GstMapInfo ref_map, map;
+  gsize i;
+
+  gst_buffer_map (reference, &ref_map, GST_MAP_READ);
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, ref_map.size);
+  for (i = 0; i < map.size; i++) {
+    if (ABS (map.data[i] - ref_map.data[i]) > tolerance)
+      fail ("Byte %" G_GSIZE_FORMAT " differs: %u != %u", i, map.data[i],
+          ref_map.data[i]);
+  }
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unmap (reference, &ref_map);
+}
+
+/* Converting in stripes on several threads must give the same frames as
+ * converting in the streaming thread */
+GST_START_TEST (test_threads)
+{
+  const gchar *thread_props[] = { "max-threads=2", "max-threads=3",
+    "max-threads=0"
+  };
+  GstBuffer *inbuf, *reference, *outbuf;
+  guint16 *samples;
+  guint i, j, k;
+  gint depth;
+
+  for (depth = 8; depth <= 12; depth += 4) {
+    samples = create_samples (depth);
+    inbuf = create_bayer_buffer (samples, depth, FALSE);
+    for (i = 0; i < G_N_ELEMENTS (patterns); i++) {
+      gchar *format = bayer_format (patterns[i], depth, FALSE);
+
+      for (j = 0; j < G_N_ELEMENTS (methods); j++) {
+        gchar *props;
+
+        props = g_strdup_printf ("method=%s max-threads=1", methods[j]);
+        reference = convert (format, props, inbuf);
+        g_free (props);
+        for (k = 0; k < G_N_ELEMENTS (thread_props); k++) {
+          props = g_strdup_printf ("method=%s %s", methods[j],
+              thread_props[k]);
+          outbuf = convert (format, props, inbuf);
+          g_free (props);
+          check_same_frames (reference, outbuf, 0);
+          gst_buffer_unref (outbuf);
+        }
+        gst_buffer_unref (reference);
+      }
+      g_free (format);
+    }
+    gst_buffer_unref (inbuf);
+    g_free (samples);
+  }
+}
+
+GST_END_TEST;
+
+/* Deep samples are reduced to 8 bits at the output, so deep frames of 8-bit
+ * samples shifted up must give (up to rounding) the same frames as the 8-bit
+ * samples */
+GST_START_TEST (test_deep_formats)
+{
+  GstBuffer *inbuf, *reference, *outbuf;
+  guint16 *samples, *deep_samples;
+  gint depth, big_endian, i;
+  guint j;
+  gchar *format, *props;
+
+  samples = create_samples (8);
+  deep_samples = g_new (guint16, WIDTH * HEIGHT);
+  inbuf = create_bayer_buffer (samples, 8, FALSE);
+
+  for (j = 0; j < G_N_ELEMENTS (methods); j++) {
+    props = g_strdup_printf ("method=%s", methods[j]);
+    reference = convert ("bggr", props, inbuf);
+
+    for (depth = 10; depth <= 16; depth += 2) {
+      for (i = 0; i < WIDTH * HEIGHT; i++)
+        deep_samples[i] = samples[i] << (depth - 8);
+      for (big_endian = 0; big_endian <= 1; big_endian++) {
+        GstBuffer *deep_inbuf;
+
+        deep_inbuf = create_bayer_buffer (deep_samples, depth, big_endian);
+        format = bayer_format ("bggr", depth, big_endian);
+        outbuf = convert (format, props, deep_inbuf);
+        /* the linear method reduces the samples to 8 bits before
+         * interpolating, malvar after */
+        check_same_frames (reference, outbuf, j == 0 ? 0 : 1);
+        gst_buffer_unref (outbuf);
+        gst_buffer_unref (deep_inbuf);
+        g_free (format);
+      }
+    }
+    gst_buffer_unref (reference);
+    g_free (props);
+  }
+
+  gst_buffer_unref (inbuf);
+  g_free (deep_samples);
+  g_free (samples);
+}
+
+GST_END_TEST;
+
+/* A frame of a single colour converts to that colour everywhere, including
+ * the borders */
+GST_START_TEST (test_flat_colour)
+{
+  const guint8 colour[3] = { 200, 120, 40 };    /* R, G, B */
+  guint16 *samples;
+  GstBuffer *inbuf, *outbuf;
+  GstMapInfo map;
+  guint i, j;
+  gint x, y;
+
+  samples = g_new (guint16, WIDTH * HEIGHT);
+  for (i = 0; i < G_N_ELEMENTS (patterns); i++) {
+    for (y = 0; y < HEIGHT; y++) {
+      for (x = 0; x < WIDTH; x++) {
+        gchar c = patterns[i][(y & 1) * 2 + (x & 1)];
+
+        samples[y * WIDTH + x] = colour[c == 'r' ? 0 : c == 'g' ? 1 : 2];
+      }
+    }
+    inbuf = create_bayer_buffer (samples, 8, FALSE);
+
+    for (j = 0; j < G_N_ELEMENTS (methods); j++) {
+      gchar *props = g_strdup_printf ("method=%s", methods[j]);
+
+      outbuf = convert (patterns[i], props, inbuf);
+      g_free (props);
+
+      gst_buffer_map (outbuf, &map, GST_MAP_READ);
+      for (x = 0; x < WIDTH * HEIGHT; x++) {
+        fail_unless_equals_int (map.data[4 * x + 0], colour[2]);
+        fail_unless_equals_int (map.data[4 * x + 1], colour[1]);
+        fail_unless_equals_int (map.data[4 * x + 2], colour[0]);
+      }
+      gst_buffer_unmap (outbuf, &map);
+      gst_buffer_unref (outbuf);
+    }
+    gst_buffer_unref (inbuf);
+  }
+  g_free (samples);
+}
+
+GST_END_TEST;
+
+#define BENCHMARK_WIDTH 1920
+#define BENCHMARK_HEIGHT 1080
+#define BENCHMARK_FRAMES 30
+
+static void
+run_benchmark (const gchar * method, gint depth, gint max_threads)
+{
+  GstHarness *h;
+  GstBuffer *inbuf, *outbuf;
+  gint64 start, elapsed;
+  gchar *desc, *format, *caps;
+  gint i;
+
+  /* the content does not matter, only the amount of data */
+  inbuf = gst_buffer_new_and_alloc (BENCHMARK_WIDTH * BENCHMARK_HEIGHT *
+      (depth > 8 ? 2 : 1));
+  gst_buffer_memset (inbuf, 0, 0x5a, gst_buffer_get_size (inbuf));
+
+  desc = g_strdup_printf ("bayer2rgb method=%s max-threads=%d", method,
+      max_threads);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+
+  format = bayer_format ("bggr", depth, FALSE);
+  caps = g_strdup_printf ("video/x-bayer,format=%s,width=%d,height=%d,"
+      "framerate=30/1", format, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+  gst_harness_set_caps_str (h, caps, "video/x-raw,format=BGRx");
+  g_free (caps);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCHMARK_FRAMES; i++) {
+    fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (inbuf)),
+        GST_FLOW_OK);
+    outbuf = gst_harness_pull (h);
+    fail_unless (outbuf != NULL);
+    gst_buffer_unref (outbuf);
+  }
+  elapsed = g_get_monotonic_time () - start;
+
+  GST_INFO ("bayer2rgb %s, %s, max-threads=%d: %d frames in %" G_GINT64_FORMAT
+      " us, %.1f Mpixel/s", method, format, max_threads, BENCHMARK_FRAMES,
+      elapsed, (gdouble) BENCHMARK_WIDTH * BENCHMARK_HEIGHT *
+      BENCHMARK_FRAMES / MAX (elapsed, 1));
+
+  gst_harness_teardown (h);
+  gst_buffer_unref (inbuf);
+  g_free (format);
+}
+
+GST_START_TEST (test_benchmark)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (methods); i++) {
+    run_benchmark (methods[i], 8, 1);
+    run_benchmark (methods[i], 8, 0);
+    run_benchmark (methods[i], 12, 1);
+    run_benchmark (methods[i], 12, 0);
+  }
+}
+
+GST_END_TEST;
+
+static Suite *
+bayer2rgb_suite (void)
+{
+  Suite *s = suite_create ("bayer2rgb");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_set_timeout (tc_chain, 120);
+  tcase_add_test (tc_chain, test_threads);
+  tcase_add_test (tc_chain, test_deep_formats);
+  tcase_add_test (tc_chain, test_flat_colour);
+  /* converting 1080p frames with every method takes a while, only run
+   * when asked for */
+  if (g_getenv ("GST_CHECK_BENCHMARK"))
+    tcase_add_test (tc_chain, test_benchmark);
+
+  return s;
+}
+
+GST_CHECK_MAIN (bayer2rgb);
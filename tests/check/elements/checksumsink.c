@@ -0,0 +1,283 @@
+/* GStreamer unit tests for the checksumsink element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* Pushes @n_buffers buffers through a checksumsink writing to a temporary
+ * location and returns the lines written there */
+static gchar **
+run_checksumsink (const gchar * hash, gboolean video_planes,
+    gboolean threaded, const gchar * caps, GstBuffer ** buffers,
+    guint n_buffers)
+{
+  GstElement *sink;
+  GstHarness *h;
+  gchar *location, *contents, **lines;
+  gint fd;
+  guint i;
+
+  fd = g_file_open_tmp ("checksumsink-XXXXXX.txt", &location, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+
+  sink = gst_element_factory_make ("checksumsink", NULL);
+  fail_unless (sink != NULL);
+  gst_util_set_object_arg (G_OBJECT (sink), "hash", hash);
+  g_object_set (sink, "video-planes", video_planes, "threaded", threaded,
+      "location", location, NULL);
+
+  h = gst_harness_new_with_element (sink, "sink", NULL);
+  if (caps)
+    gst_harness_set_src_caps_str (h, caps);
+  for (i = 0; i < n_buffers; i++)
+    fail_unless_equals_int (gst_harness_push (h, buffers[i]), GST_FLOW_OK);
+  /* waits for the worker thread and flushes the file */
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless (g_file_get_contents (location, &contents, NULL, NULL));
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+  fail_unless_equals_int (g_strv_length (lines), n_buffers + 1);
+  fail_unless_equals_string (lines[n_buffers], "");
+
+  gst_harness_teardown (h);
+  gst_object_unref (sink);
+  g_remove (location);
+  g_free (location);
+
+  return lines;
+}
+
+static GstBuffer *
+new_string_buffer (const gchar * s)
+{
+  if (*s == '\0')
+    return gst_buffer_new ();
+
+  return gst_buffer_new_wrapped (g_strdup (s), strlen (s));
+}
+
+static void
+check_string_checksum (const gchar * hash, const gchar * s,
+    const gchar * expected)
+{
+  GstBuffer *buf = new_string_buffer (s);
+  gchar **lines, *line;
+
+  lines = run_checksumsink (hash, FALSE, FALSE, NULL, &buf, 1);
+  /* index, unknown PTS and duration, checksum */
+  line = g_strdup_printf ("0\t-1\t-1\t%s", expected);
+  fail_unless_equals_string (lines[0], line);
+  g_free (line);
+  g_strfreev (lines);
+}
+
+GST_START_TEST (test_crc32c)
+{
+  check_string_checksum ("crc32c", "123456789", "e3069283");
+  check_string_checksum ("crc32c", "", "00000000");
+}
+
+GST_END_TEST;
+
+/* the reference values published with xxHash, seed 0 */
+GST_START_TEST (test_xxhash64)
+{
+  check_string_checksum ("xxhash64", "", "ef46db3751d8e999");
+  check_string_checksum ("xxhash64", "a", "d24ec4f1a98c6e5b");
+  check_string_checksum ("xxhash64", "abc", "44bc2cf5ad770999");
+  check_string_checksum ("xxhash64",
+      "The quick brown fox jumps over the lazy dog", "0b242d361fda71bc");
+}
+
+GST_END_TEST;
+
+#define WIDTH 16
+#define HEIGHT 16
+#define I420_CAPS_STRING \
+  "video/x-raw, format=(string)I420, width=(int)16, height=(int)16, " \
+  "framerate=(fraction)25/1"
+
+/* An I420 frame with the given strides, with WIDTH and WIDTH / 2 it is
+ * packed. The padding is filled with garbage */
+static GstBuffer *
+new_i420_frame (gint y_stride, gint uv_stride)
+{
+  gsize offset[GST_VIDEO_MAX_PLANES] = { 0, };
+  gint stride[GST_VIDEO_MAX_PLANES] = { y_stride, uv_stride, uv_stride };
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint plane, x, y;
+
+  offset[1] = y_stride * HEIGHT;
+  offset[2] = offset[1] + uv_stride * HEIGHT / 2;
+  buf = gst_buffer_new_allocate (NULL, offset[2] + uv_stride * HEIGHT / 2,
+      NULL);
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  memset (map.data, 0xff, map.size);
+  for (plane = 0; plane < 3; plane++) {
+    guint w = plane ? WIDTH / 2 : WIDTH;
+    guint h = plane ? HEIGHT / 2 : HEIGHT;
+
+    for (y = 0; y < h; y++)
+      for (x = 0; x < w; x++)
+        map.data[offset[plane] + y * stride[plane] + x] = plane * 64 + x + y;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  gst_buffer_add_video_meta_full (buf, GST_VIDEO_FRAME_FLAG_NONE,
+      GST_VIDEO_FORMAT_I420, WIDTH, HEIGHT, 3, offset, stride);
+
+  return buf;
+}
+
+static const gchar *
+get_checksum (const gchar * line)
+{
+  const gchar *checksum = strrchr (line, '\t');
+
+  fail_unless (checksum != NULL);
+  return checksum + 1;
+}
+
+/* With video-planes the checksum of a frame doesn't depend on its strides */
+GST_START_TEST (test_video_planes_padded)
+{
+  GstBuffer *bufs[2];
+  gchar **packed, **planes;
+
+  bufs[0] = new_i420_frame (WIDTH, WIDTH / 2);
+  packed = run_checksumsink ("xxhash64", FALSE, FALSE, I420_CAPS_STRING,
+      bufs, 1);
+
+  bufs[0] = new_i420_frame (WIDTH, WIDTH / 2);
+  bufs[1] = new_i420_frame (WIDTH + 13, WIDTH / 2 + 7);
+  planes = run_checksumsink ("xxhash64", TRUE, FALSE, I420_CAPS_STRING,
+      bufs, 2);
+  fail_unless_equals_string (get_checksum (planes[0]),
+      get_checksum (packed[0]));
+  fail_unless_equals_string (get_checksum (planes[1]),
+      get_checksum (packed[0]));
+  g_strfreev (planes);
+
+  /* without it the padding is hashed too */
+  bufs[0] = new_i420_frame (WIDTH + 13, WIDTH / 2 + 7);
+  planes = run_checksumsink ("xxhash64", FALSE, FALSE, I420_CAPS_STRING,
+      bufs, 1);
+  fail_if (g_str_equal (get_checksum (planes[0]), get_checksum (packed[0])));
+  g_strfreev (planes);
+
+  g_strfreev (packed);
+}
+
+GST_END_TEST;
+
+#define N_BUFFERS 40
+
+static void
+create_timed_buffers (GstBuffer ** bufs)
+{
+  guint i;
+
+  for (i = 0; i < N_BUFFERS; i++) {
+    bufs[i] = gst_buffer_new_allocate (NULL, 100 * i + 1, NULL);
+    gst_buffer_memset (bufs[i], 0, i, 100 * i + 1);
+    GST_BUFFER_PTS (bufs[i]) = i * GST_MSECOND;
+    GST_BUFFER_DURATION (bufs[i]) = GST_MSECOND;
+  }
+}
+
+/* The worker thread writes the same lines in the same order */
+GST_START_TEST (test_threaded)
+{
+  GstBuffer *bufs[N_BUFFERS];
+  gchar **lines, **threaded_lines, *prefix;
+  guint i;
+
+  create_timed_buffers (bufs);
+  lines = run_checksumsink ("sha1", FALSE, FALSE, NULL, bufs, N_BUFFERS);
+  create_timed_buffers (bufs);
+  threaded_lines = run_checksumsink ("sha1", FALSE, TRUE, NULL, bufs,
+      N_BUFFERS);
+
+  for (i = 0; i < N_BUFFERS; i++) {
+    prefix = g_strdup_printf ("%u\t%" G_GUINT64_FORMAT "\t%"
+        G_GUINT64_FORMAT "\t", i, i * GST_MSECOND, GST_MSECOND);
+    fail_unless (g_str_has_prefix (lines[i], prefix));
+    g_free (prefix);
+    fail_unless_equals_string (threaded_lines[i], lines[i]);
+  }
+
+  g_strfreev (lines);
+  g_strfreev (threaded_lines);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_location_error)
+{
+  GstElement *sink;
+  gchar *file, *location;
+  gint fd;
+
+  /* a regular file can't be a directory */
+  fd = g_file_open_tmp ("checksumsink-XXXXXX", &file, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+  location = g_build_filename (file, "sums.txt", NULL);
+
+  sink = gst_element_factory_make ("checksumsink", NULL);
+  g_object_set (sink, "location", location, NULL);
+  fail_unless_equals_int (gst_element_set_state (sink, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_FAILURE);
+  gst_element_set_state (sink, GST_STATE_NULL);
+  gst_object_unref (sink);
+
+  g_remove (file);
+  g_free (file);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+static Suite *
+checksumsink_suite (void)
+{
+  Suite *s = suite_create ("checksumsink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_crc32c);
+  tcase_add_test (tc_chain, test_xxhash64);
+  tcase_add_test (tc_chain, test_video_planes_padded);
+  tcase_add_test (tc_chain, test_threaded);
+  tcase_add_test (tc_chain, test_location_error);
+
+  return s;
+}
+
+GST_CHECK_MAIN (checksumsink);
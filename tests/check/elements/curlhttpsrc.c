@@ -0,0 +1,225 @@
+/* GStreamer unit tests for the curlhttpsrc element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gio/gio.h>
+#include <string.h>
+
+/* Size of the body served by the local HTTP server, larger when measuring
+ * the throughput */
+#define BODY_SIZE (2 * 1024 * 1024)
+#define BENCHMARK_BODY_SIZE (32 * 1024 * 1024)
+
+/* curl hands the body over in chunks of at most CURL_MAX_WRITE_SIZE */
+#define MAX_CHUNK_SIZE 16384
+
+static GSocketService *service;
+static guint16 port;
+static guint body_size = BODY_SIZE;
+
+static inline guint8
+body_byte (guint64 offset)
+{
+  return (guint8) (offset % 251);
+}
+
+/* Minimal HTTP/1.1 server: ignores the request and serves body_size bytes
+ * of a known pattern */
+static gboolean
+run_cb (GThreadedSocketService * service, GSocketConnection * connection,
+    GObject * source_object, gpointer user_data)
+{
+  GInputStream *in = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+  GOutputStream *out =
+      g_io_stream_get_output_stream (G_IO_STREAM (connection));
+  gchar request[4096];
+  gsize len = 0;
+  gssize n;
+  guint8 *block;
+  gchar *header;
+  guint64 offset;
+  gsize i;
+
+  do {
+    n = g_input_stream_read (in, request + len, sizeof (request) - len - 1,
+        NULL, NULL);
+    if (n <= 0)
+      return FALSE;
+    len += n;
+    request[len] = '\0';
+  } while (strstr (request, "\r\n\r\n") == NULL
+      && len < sizeof (request) - 1);
+
+  header = g_strdup_printf ("HTTP/1.1 200 OK\r\n"
+      "Content-Type: application/octet-stream\r\n"
+      "Content-Length: %u\r\n" "Connection: close\r\n\r\n", body_size);
+  g_output_stream_write_all (out, header, strlen (header), NULL, NULL, NULL);
+  g_free (header);
+
+  block = g_malloc (64 * 1024);
+  for (offset = 0; offset < body_size; offset += 64 * 1024) {
+    for (i = 0; i < 64 * 1024; i++)
+      block[i] = body_byte (offset + i);
+    if (!g_output_stream_write_all (out, block, 64 * 1024, NULL, NULL, NULL))
+      break;
+  }
+  g_free (block);
+
+  return FALSE;
+}
+
+static void
+start_server (void)
+{
+  service = g_threaded_socket_service_new (4);
+  port = g_socket_listener_add_any_inet_port (G_SOCKET_LISTENER (service),
+      NULL, NULL);
+  fail_unless (port != 0);
+  g_signal_connect (service, "run", G_CALLBACK (run_cb), NULL);
+  g_socket_service_start (service);
+}
+
+static void
+stop_server (void)
+{
+  g_socket_service_stop (service);
+  g_socket_listener_close (G_SOCKET_LISTENER (service));
+  g_object_unref (service);
+  service = NULL;
+}
+
+typedef struct
+{
+  guint64 offset;
+  guint n_buffers;
+  guint max_n_memory;
+  gboolean corrupted;
+} ReceiveState;
+
+static void
+handoff_cb (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    ReceiveState * state)
+{
+  GstMapInfo map;
+  guint n_memory = gst_buffer_n_memory (buf);
+  gsize i;
+
+  /* the chunks are handed out as separate memories; had the buffer merged
+   * them, one would be larger than a chunk */
+  for (i = 0; i < n_memory; i++)
+    fail_unless (gst_memory_get_sizes (gst_buffer_peek_memory (buf, i), NULL,
+            NULL) <= MAX_CHUNK_SIZE);
+  state->max_n_memory = MAX (state->max_n_memory, n_memory);
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  for (i = 0; i < map.size && !state->corrupted; i++) {
+    if (map.data[i] != body_byte (state->offset + i))
+      state->corrupted = TRUE;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  state->offset += map.size;
+  state->n_buffers++;
+}
+
+GST_START_TEST (test_parallel_download)
+{
+  GstElement *pipe, *src[4], *sink[4];
+  ReceiveState state[4];
+  GstMessage *msg;
+  GstBus *bus;
+  gint64 start, elapsed;
+  gchar *uri;
+  guint i;
+
+  start_server ();
+  uri = g_strdup_printf ("http://127.0.0.1:%u/", port);
+
+  /* several downloads in parallel all share the same curl multi loop */
+  pipe = gst_pipeline_new (NULL);
+  for (i = 0; i < G_N_ELEMENTS (src); i++) {
+    src[i] = gst_element_factory_make ("curlhttpsrc", NULL);
+    fail_unless (src[i] != NULL);
+    sink[i] = gst_element_factory_make ("fakesink", NULL);
+    fail_unless (sink[i] != NULL);
+
+    gst_bin_add_many (GST_BIN (pipe), src[i], sink[i], NULL);
+    fail_unless (gst_element_link (src[i], sink[i]));
+
+    memset (&state[i], 0, sizeof (ReceiveState));
+    g_object_set (src[i], "location", uri, NULL);
+    g_object_set (sink[i], "signal-handoffs", TRUE, "sync", FALSE, NULL);
+    g_signal_connect (sink[i], "handoff", G_CALLBACK (handoff_cb), &state[i]);
+  }
+
+  start = g_get_monotonic_time ();
+  fail_if (gst_element_set_state (pipe, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  /* the pipeline only posts EOS once all sinks are EOS */
+  bus = gst_element_get_bus (pipe);
+  msg = gst_bus_timed_pop_filtered (bus, 60 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  elapsed = g_get_monotonic_time () - start;
+  gst_object_unref (bus);
+
+  for (i = 0; i < G_N_ELEMENTS (src); i++) {
+    fail_unless_equals_uint64 (state[i].offset, body_size);
+    fail_if (state[i].corrupted);
+    /* the server is faster than the checks, so chunks pile up between two
+     * buffers */
+    fail_unless (state[i].max_n_memory > 1);
+    GST_INFO ("download %u: %u buffers", i, state[i].n_buffers);
+  }
+  GST_INFO ("received %u x %u bytes in %" G_GINT64_FORMAT " us, %.1f MB/s",
+      i, body_size, elapsed,
+      (gdouble) body_size * G_N_ELEMENTS (src) / MAX (elapsed, 1));
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+  g_free (uri);
+  stop_server ();
+}
+
+GST_END_TEST;
+
+static Suite *
+curlhttpsrc_suite (void)
+{
+  Suite *s = suite_create ("curlhttpsrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  /* download a large body to measure the throughput only when asked for */
+  if (g_getenv ("GST_CHECK_BENCHMARK")) {
+    body_size = BENCHMARK_BODY_SIZE;
+    tcase_set_timeout (tc_chain, 120);
+  }
+  tcase_add_test (tc_chain, test_parallel_download);
+
+  return s;
+}
+
+GST_CHECK_MAIN (curlhttpsrc);
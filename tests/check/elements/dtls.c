@@ -70,6 +70,21 @@ _wait_for_key_count_to_reach (int n)
   g_mutex_unlock (&key_lock);
 }
 
+static gboolean
+_wait_for_key_count_to_reach_until (int n, gint64 end_time)
+{
+  gboolean reached;
+
+  g_mutex_lock (&key_lock);
+  while (key_count < n)
+    if (!g_cond_wait_until (&key_cond, &key_lock, end_time))
+      break;
+  reached = key_count >= n;
+  g_mutex_unlock (&key_lock);
+
+  return reached;
+}
+
 static gchar data[] = {
   0x00, 0x01, 0x02, 0x03,
 };
@@ -176,6 +191,186 @@ GST_START_TEST (test_data_transfer)
 
 GST_END_TEST;
 
+#define N_CONNECTIONS 32
+
+typedef struct
+{
+  GstElement *s_enc, *s_dec, *c_enc, *c_dec;
+} DtlsPair;
+
+static GstElement *
+_make_dtls_element (const gchar * factory, const gchar * id,
+    gboolean is_client)
+{
+  GstElement *e;
+
+  e = gst_element_factory_make (factory, NULL);
+  fail_unless (e != NULL);
+  g_object_set (e, "connection-id", id, NULL);
+  if (is_client)
+    g_object_set (e, "is-client", TRUE, NULL);
+  g_signal_connect (e, "on-key-received", G_CALLBACK (_on_key_received), NULL);
+
+  return e;
+}
+
+/* Sets up a client/server pair, everything but the client encoder which
+ * starts the handshake. The decoders create the connections the encoders
+ * then look up, and need to be running before any handshake data arrives. */
+static void
+_dtls_pair_init (DtlsPair * pair, const gchar * name)
+{
+  gchar *id;
+
+  id = g_strdup_printf ("%s_server", name);
+  pair->s_dec = _make_dtls_element ("dtlsdec", id, FALSE);
+  pair->s_enc = _make_dtls_element ("dtlsenc", id, FALSE);
+  g_free (id);
+
+  id = g_strdup_printf ("%s_client", name);
+  pair->c_dec = _make_dtls_element ("dtlsdec", id, FALSE);
+  pair->c_enc = _make_dtls_element ("dtlsenc", id, TRUE);
+  g_free (id);
+
+  fail_unless (gst_element_link_pads (pair->s_enc, "src", pair->c_dec,
+          "sink"));
+  fail_unless (gst_element_link_pads (pair->c_enc, "src", pair->s_dec,
+          "sink"));
+
+  gst_element_set_state (pair->s_dec, GST_STATE_PAUSED);
+  gst_element_set_state (pair->c_dec, GST_STATE_PAUSED);
+  gst_element_set_state (pair->s_enc, GST_STATE_PAUSED);
+}
+
+static void
+_dtls_pair_clear (DtlsPair * pair)
+{
+  gst_element_set_state (pair->c_enc, GST_STATE_NULL);
+  gst_element_set_state (pair->s_enc, GST_STATE_NULL);
+  gst_element_set_state (pair->c_dec, GST_STATE_NULL);
+  gst_element_set_state (pair->s_dec, GST_STATE_NULL);
+  gst_object_unref (pair->c_enc);
+  gst_object_unref (pair->s_enc);
+  gst_object_unref (pair->c_dec);
+  gst_object_unref (pair->s_dec);
+}
+
+static gboolean
+_session_resumed (GstElement * dec)
+{
+  gboolean resumed;
+
+  g_object_get (dec, "session-resumed", &resumed, NULL);
+
+  return resumed;
+}
+
+/* Connects N_CONNECTIONS in-process client/server pairs at once and returns
+ * the time it took until all of them got their keys */
+static gint64
+_connect_pairs (gboolean expect_resumed)
+{
+  DtlsPair pairs[N_CONNECTIONS];
+  gint64 start, elapsed;
+  gchar *name;
+  gint i;
+
+  g_mutex_lock (&key_lock);
+  key_count = 0;
+  g_mutex_unlock (&key_lock);
+
+  for (i = 0; i < N_CONNECTIONS; i++) {
+    name = g_strdup_printf ("bench_%d", i);
+    _dtls_pair_init (&pairs[i], name);
+    g_free (name);
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_CONNECTIONS; i++)
+    gst_element_set_state (pairs[i].c_enc, GST_STATE_PAUSED);
+
+  fail_unless (_wait_for_key_count_to_reach_until (4 * N_CONNECTIONS,
+          start + 60 * G_TIME_SPAN_SECOND));
+  elapsed = g_get_monotonic_time () - start;
+
+  for (i = 0; i < N_CONNECTIONS; i++) {
+    fail_unless_equals_int (_session_resumed (pairs[i].c_dec), expect_resumed);
+    fail_unless_equals_int (_session_resumed (pairs[i].s_dec), expect_resumed);
+    _dtls_pair_clear (&pairs[i]);
+  }
+
+  return elapsed;
+}
+
+GST_START_TEST (test_many_connections)
+{
+  gint64 elapsed;
+
+  elapsed = _connect_pairs (FALSE);
+  GST_INFO ("%d connections got their keys in %" G_GINT64_FORMAT " us",
+      N_CONNECTIONS, elapsed);
+
+  /* the same connection ids again, the clients can now resume the sessions
+   * of the previous connections */
+  elapsed = _connect_pairs (TRUE);
+  GST_INFO ("%d resumed connections got their keys in %" G_GINT64_FORMAT
+      " us", N_CONNECTIONS, elapsed);
+}
+
+GST_END_TEST;
+
+static gboolean
+_reject_certificate (GstElement * dec, const gchar * pem, gpointer user_data)
+{
+  return FALSE;
+}
+
+GST_START_TEST (test_resumed_certificate_rejected)
+{
+  DtlsPair pair;
+  GstMessage *msg;
+  GstBus *bus;
+
+  g_mutex_lock (&key_lock);
+  key_count = 0;
+  g_mutex_unlock (&key_lock);
+
+  _dtls_pair_init (&pair, "reject");
+  gst_element_set_state (pair.c_enc, GST_STATE_PAUSED);
+  _wait_for_key_count_to_reach (4);
+  fail_if (_session_resumed (pair.c_dec));
+  _dtls_pair_clear (&pair);
+
+  g_mutex_lock (&key_lock);
+  key_count = 0;
+  g_mutex_unlock (&key_lock);
+
+  /* The session is resumed, but the client doesn't accept the certificate
+   * of the server anymore. The decoder posts an error when the handshake
+   * fails. */
+  _dtls_pair_init (&pair, "reject");
+  g_signal_connect (pair.c_dec, "on-peer-certificate",
+      G_CALLBACK (_reject_certificate), NULL);
+  bus = gst_bus_new ();
+  gst_element_set_bus (pair.c_dec, bus);
+  gst_element_set_state (pair.c_enc, GST_STATE_PAUSED);
+
+  msg = gst_bus_timed_pop_filtered (bus, 30 * GST_SECOND, GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  gst_message_unref (msg);
+
+  fail_if (_session_resumed (pair.c_dec));
+
+  /* only the server, which accepted the session, may have exported keys */
+  fail_if (_wait_for_key_count_to_reach_until (3,
+          g_get_monotonic_time () + G_TIME_SPAN_SECOND / 2));
+
+  _dtls_pair_clear (&pair);
+  gst_object_unref (bus);
+}
+
+GST_END_TEST;
+
 static Suite *
 dtls_suite (void)
 {
@@ -185,6 +380,10 @@ dtls_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_create_and_unref);
   tcase_add_test (tc_chain, test_data_transfer);
+  /* connecting many pairs takes a while, only run when asked for */
+  if (g_getenv ("GST_CHECK_BENCHMARK"))
+    tcase_add_test (tc_chain, test_many_connections);
+  tcase_add_test (tc_chain, test_resumed_certificate_rejected);
 
   return s;
 }
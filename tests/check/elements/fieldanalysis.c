@@ -0,0 +1,379 @@
+/* GStreamer unit tests for the fieldanalysis element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+/* with the default ignored-lines and block-height, the last row of blocks
+ * ends on the last line of the frame */
+#define WIDTH 64
+#define HEIGHT 66
+#define N_FRAMES 20
+#define FRAMES_PER_CYCLE 5
+
+#define OUTPUT_FLAGS (GST_VIDEO_BUFFER_FLAG_INTERLACED | \
+    GST_VIDEO_BUFFER_FLAG_TFF | GST_VIDEO_BUFFER_FLAG_RFF | \
+    GST_VIDEO_BUFFER_FLAG_ONEFIELD)
+
+typedef enum
+{
+  CONTENT_PROGRESSIVE,
+  CONTENT_COMBED,
+  CONTENT_COMBED_BOTTOM,
+  CONTENT_THIN_LINES,
+  CONTENT_TELECINE,
+  CONTENT_MIXED
+} Content;
+
+/* Film frames in a 3:2 telecine cycle of 5 video frames: AA BB BC CD DD */
+static const gint top_film_frame[FRAMES_PER_CYCLE] = { 0, 1, 1, 2, 3 };
+static const gint bottom_film_frame[FRAMES_PER_CYCLE] = { 0, 1, 2, 3, 3 };
+
+/* Vertical bars that move with every frame. Two frames two apart differ by
+ * 120 in every sample, so interleaving their lines combs everywhere */
+static guint8
+bar_pixel (gint n, gint x)
+{
+  return ((x / 4 + n) % 4) * 60 + 20;
+}
+
+static guint8
+luma_pixel (Content content, GRand * rand, gint n, gint x, gint y)
+{
+  switch (content) {
+    case CONTENT_PROGRESSIVE:
+      return bar_pixel (n, x);
+    case CONTENT_COMBED:
+      return bar_pixel ((y & 1) ? n + 2 : n, x);
+    case CONTENT_COMBED_BOTTOM:
+      /* only the last lines comb, which are analysed by mirroring the lines
+       * below the frame */
+      return bar_pixel ((y >= HEIGHT - 10 && (y & 1)) ? n + 2 : n, x);
+    case CONTENT_THIN_LINES:
+      /* two bright lines in every row of blocks, each row scoring below half
+       * the default block threshold */
+      if ((y - 2) % 16 == 5 || (y - 2) % 16 == 11)
+        return 250;
+      return bar_pixel (n, x);
+    case CONTENT_TELECINE:
+      return bar_pixel ((y & 1) ? bottom_film_frame[n % FRAMES_PER_CYCLE] :
+          top_film_frame[n % FRAMES_PER_CYCLE], x);
+    case CONTENT_MIXED:
+      /* a bit of everything, and noise */
+      switch ((n / 4) % 4) {
+        case 0:
+          return luma_pixel (CONTENT_PROGRESSIVE, rand, n, x, y);
+        case 1:
+          return luma_pixel (CONTENT_COMBED, rand, n, x, y);
+        case 2:
+          return luma_pixel (CONTENT_TELECINE, rand, n, x, y);
+        default:
+          return g_rand_int_range (rand, 0, 256);
+      }
+  }
+
+  g_assert_not_reached ();
+  return 0;
+}
+
+static GstBuffer *
+create_frame (GstVideoInfo * info, Content content, GRand * rand, gint n)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, info->size, NULL);
+  GstVideoFrame frame;
+  gint c, x, y;
+
+  fail_unless (gst_video_frame_map (&frame, info, buf, GST_MAP_WRITE));
+  for (c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS (&frame); c++) {
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&frame, c); y++) {
+      guint8 *line = (guint8 *) GST_VIDEO_FRAME_COMP_DATA (&frame, c) +
+          y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, c);
+
+      for (x = 0; x < GST_VIDEO_FRAME_COMP_WIDTH (&frame, c); x++) {
+        line[x * GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, c)] =
+            c == 0 ? luma_pixel (content, rand, n, x, y) : 128;
+      }
+    }
+  }
+  gst_video_frame_unmap (&frame);
+
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale (n, 1001 * GST_SECOND, 30000);
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (1, 1001 * GST_SECOND,
+      30000);
+
+  return buf;
+}
+
+/* Each output is recorded as its flags and the interlace mode of the caps
+ * it was pushed with */
+#define OUTPUT(flags, mode) (((flags) & OUTPUT_FLAGS) | ((mode) << 24))
+#define OUTPUT_MODE(output) ((output) >> 24)
+
+static GstPadProbeReturn
+record_output (GstPad * pad, GstPadProbeInfo * info, GArray * outputs)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  GstVideoInfo vinfo;
+  guint output;
+
+  fail_unless (caps != NULL);
+  fail_unless (gst_video_info_from_caps (&vinfo, caps));
+  gst_caps_unref (caps);
+
+  output = OUTPUT (GST_BUFFER_FLAGS (buf), GST_VIDEO_INFO_INTERLACE_MODE
+      (&vinfo));
+  g_array_append_val (outputs, output);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Runs N_FRAMES frames of @content through fieldanalysis with the
+ * properties described by @properties followed by @more_properties and
+ * returns the outputs */
+static GArray *
+run_fieldanalysis (const gchar * format, Content content,
+    const gchar * properties, const gchar * more_properties)
+{
+  GArray *outputs = g_array_new (FALSE, FALSE, sizeof (guint));
+  GRand *rand = g_rand_new_with_seed (0xf1e1d);
+  GstVideoInfo info;
+  GstHarness *h;
+  GstBuffer *buf;
+  gchar *desc;
+  gint n;
+
+  gst_video_info_set_format (&info, gst_video_format_from_string (format),
+      WIDTH, HEIGHT);
+  GST_VIDEO_INFO_FPS_N (&info) = 30000;
+  GST_VIDEO_INFO_FPS_D (&info) = 1001;
+
+  /* the analysis threads are set up when starting */
+  desc = g_strdup_printf ("fieldanalysis %s%s", properties,
+      more_properties ? more_properties : "");
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+
+  gst_pad_add_probe (h->sinkpad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) record_output, outputs, NULL);
+  gst_harness_set_src_caps (h, gst_video_info_to_caps (&info));
+
+  for (n = 0; n < N_FRAMES; n++) {
+    fail_unless_equals_int (gst_harness_push (h, create_frame (&info, content,
+                rand, n)), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* the last frame is held back for analysis with the next one */
+  fail_unless (outputs->len >= N_FRAMES - 1 && outputs->len <= N_FRAMES);
+  fail_unless_equals_int (gst_harness_buffers_received (h), outputs->len);
+  while ((buf = gst_harness_try_pull (h)))
+    gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+  g_rand_free (rand);
+
+  return outputs;
+}
+
+static void
+assert_outputs_equal (GArray * a, GArray * b)
+{
+  guint i;
+
+  fail_unless_equals_int (a->len, b->len);
+  for (i = 0; i < a->len; i++)
+    fail_unless_equals_int (g_array_index (a, guint, i),
+        g_array_index (b, guint, i));
+}
+
+static void
+assert_all_outputs (GArray * outputs, gboolean interlaced)
+{
+  GstVideoInterlaceMode mode = interlaced ?
+      GST_VIDEO_INTERLACE_MODE_INTERLEAVED :
+      GST_VIDEO_INTERLACE_MODE_PROGRESSIVE;
+  guint i;
+
+  for (i = 0; i < outputs->len; i++) {
+    guint output = g_array_index (outputs, guint, i);
+
+    fail_unless_equals_int (output & GST_VIDEO_BUFFER_FLAG_INTERLACED,
+        interlaced ? GST_VIDEO_BUFFER_FLAG_INTERLACED : 0);
+    fail_if (output & (GST_VIDEO_BUFFER_FLAG_RFF |
+            GST_VIDEO_BUFFER_FLAG_ONEFIELD));
+    fail_unless_equals_int (OUTPUT_MODE (output), mode);
+  }
+}
+
+static const gchar *formats[] = { "I420", "YUY2" };
+
+static const gchar *frame_metrics[] = { "5-tap", "windowed-comb" };
+
+static const gchar *comb_methods[] = { "32-detect", "isCombed", "5-tap" };
+
+/* Analysing the rows of each field in several threads gives the same
+ * results as analysing them all in the streaming thread */
+GST_START_TEST (test_threads_identical)
+{
+  guint f, m, c, d;
+
+  for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+    for (m = 0; m < G_N_ELEMENTS (frame_metrics); m++) {
+      for (c = 0; c < G_N_ELEMENTS (comb_methods); c++) {
+        for (d = 1; d <= 3; d += 2) {
+          GArray *single, *multi;
+          gchar *properties;
+
+          properties = g_strdup_printf ("frame-metric=%s comb-method=%s "
+              "decimation=%u", frame_metrics[m], comb_methods[c], d);
+          GST_DEBUG ("%s, %s", formats[f], properties);
+
+          single = run_fieldanalysis (formats[f], CONTENT_MIXED, properties,
+              " max-threads=1");
+          multi = run_fieldanalysis (formats[f], CONTENT_MIXED, properties,
+              " max-threads=4");
+          assert_outputs_equal (single, multi);
+
+          g_array_unref (single);
+          g_array_unref (multi);
+          g_free (properties);
+        }
+      }
+    }
+  }
+}
+
+GST_END_TEST;
+
+/* Moving progressive content is never flagged, combed content always */
+GST_START_TEST (test_progressive_and_combed)
+{
+  guint m, c, d;
+
+  for (m = 0; m < G_N_ELEMENTS (frame_metrics); m++) {
+    for (c = 0; c < G_N_ELEMENTS (comb_methods); c++) {
+      for (d = 1; d <= 2; d++) {
+        GArray *outputs;
+        gchar *properties;
+
+        properties = g_strdup_printf ("frame-metric=%s comb-method=%s "
+            "decimation=%u", frame_metrics[m], comb_methods[c], d);
+
+        outputs = run_fieldanalysis ("I420", CONTENT_PROGRESSIVE, properties,
+            NULL);
+        assert_all_outputs (outputs, FALSE);
+        g_array_unref (outputs);
+
+        outputs = run_fieldanalysis ("I420", CONTENT_COMBED, properties, NULL);
+        assert_all_outputs (outputs, TRUE);
+        g_array_unref (outputs);
+
+        g_free (properties);
+      }
+    }
+  }
+}
+
+GST_END_TEST;
+
+/* Combing in the last lines of the frame is found by mirroring the lines
+ * below the frame within their field */
+GST_START_TEST (test_windowed_comb_bottom)
+{
+  guint c;
+
+  for (c = 0; c < G_N_ELEMENTS (comb_methods); c++) {
+    GArray *outputs;
+
+    outputs = run_fieldanalysis ("I420", CONTENT_COMBED_BOTTOM,
+        "frame-metric=windowed-comb comb-method=", comb_methods[c]);
+    assert_all_outputs (outputs, TRUE);
+    g_array_unref (outputs);
+  }
+}
+
+GST_END_TEST;
+
+/* Every row of blocks is scored on its own, so slight combing in many rows
+ * does not add up to a combed frame */
+GST_START_TEST (test_windowed_comb_rows_independent)
+{
+  guint c;
+
+  for (c = 0; c < G_N_ELEMENTS (comb_methods); c++) {
+    GArray *outputs;
+
+    outputs = run_fieldanalysis ("I420", CONTENT_THIN_LINES,
+        "frame-metric=windowed-comb comb-method=", comb_methods[c]);
+    assert_all_outputs (outputs, FALSE);
+    g_array_unref (outputs);
+  }
+}
+
+GST_END_TEST;
+
+/* The telecine pattern is found the same way when only every other line is
+ * analysed */
+GST_START_TEST (test_decimation_telecine)
+{
+  GArray *full, *decimated;
+  gboolean mixed = FALSE;
+  guint i;
+
+  full = run_fieldanalysis ("I420", CONTENT_TELECINE, "decimation=1", NULL);
+  decimated = run_fieldanalysis ("I420", CONTENT_TELECINE, "decimation=2",
+      NULL);
+  assert_outputs_equal (full, decimated);
+
+  for (i = 0; i < full->len; i++) {
+    if (OUTPUT_MODE (g_array_index (full, guint,
+                i)) == GST_VIDEO_INTERLACE_MODE_MIXED)
+      mixed = TRUE;
+  }
+  fail_unless (mixed);
+
+  g_array_unref (full);
+  g_array_unref (decimated);
+}
+
+GST_END_TEST;
+
+static Suite *
+fieldanalysis_suite (void)
+{
+  Suite *s = suite_create ("fieldanalysis");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_set_timeout (tc_chain, 60);
+  tcase_add_test (tc_chain, test_threads_identical);
+  tcase_add_test (tc_chain, test_progressive_and_combed);
+  tcase_add_test (tc_chain, test_windowed_comb_bottom);
+  tcase_add_test (tc_chain, test_windowed_comb_rows_independent);
+  tcase_add_test (tc_chain, test_decimation_telecine);
+
+  return s;
+}
+
+GST_CHECK_MAIN (fieldanalysis);
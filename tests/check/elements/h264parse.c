@@ -24,6 +24,7 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
 #include "parser.h"
 
 #define SRC_CAPS_TMPL   "video/x-h264, parsed=(boolean)false"
@@ -517,6 +518,129 @@ h264parse_packetized_suite (void)
 }
 
 
+/* more slices in one AU than a buffer can hold memories */
+#define N_SLICES 20
+
+/* appends @nal, given with its start code, to @au with the prefix that
+ * byte-stream or avc requires */
+static void
+append_nal (GByteArray * au, gboolean avc, const guint8 * nal, guint size)
+{
+  guint8 prefix[4];
+
+  GST_WRITE_UINT32_BE (prefix, avc ? size - 4 : 1);
+  g_byte_array_append (au, prefix, 4);
+  g_byte_array_append (au, nal + 4, size - 4);
+}
+
+/* builds an IDR picture coded as N_SLICES slices, optionally preceded by
+ * the SPS and PPS, with an AUD in front */
+static GByteArray *
+make_multi_slice_au (gboolean avc, gboolean config)
+{
+  GByteArray *au = g_byte_array_new ();
+  guint8 slice[sizeof (h264_idrframe)];
+  gint i;
+
+  append_nal (au, avc, h264_aud, sizeof (h264_aud));
+  if (config) {
+    append_nal (au, avc, h264_sps, sizeof (h264_sps));
+    append_nal (au, avc, h264_pps, sizeof (h264_pps));
+  }
+  append_nal (au, avc, h264_idrframe, sizeof (h264_idrframe));
+
+  /* first_mb_in_slice != 0, so these continue the picture */
+  memcpy (slice, h264_idrframe, sizeof (h264_idrframe));
+  slice[5] = 0x44;
+  for (i = 1; i < N_SLICES; i++)
+    append_nal (au, avc, slice, sizeof (slice));
+
+  return au;
+}
+
+static void
+check_multi_slice_conversion (const gchar * in_caps, const gchar * out_caps,
+    GByteArray * in, GByteArray * expected)
+{
+  GstHarness *h = gst_harness_new ("h264parse");
+  GstBuffer *buf;
+
+  gst_harness_set_src_caps_str (h, in_caps);
+  gst_harness_set_sink_caps_str (h, out_caps);
+
+  buf = gst_buffer_new_wrapped (g_memdup (in->data, in->len), in->len);
+  GST_BUFFER_PTS (buf) = 0;
+  GST_BUFFER_DURATION (buf) = 40 * GST_MSECOND;
+  fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* the whole AU comes out as one buffer, with every nal re-prefixed */
+  buf = gst_harness_pull (h);
+  gst_check_buffer_data (buf, expected->data, expected->len);
+  gst_buffer_unref (buf);
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_multi_slice_bs_to_avc)
+{
+  GByteArray *in = make_multi_slice_au (FALSE, TRUE);
+  GByteArray *expected = make_multi_slice_au (TRUE, TRUE);
+
+  check_multi_slice_conversion ("video/x-h264, stream-format=byte-stream, "
+      "alignment=au", "video/x-h264, stream-format=avc, alignment=au",
+      in, expected);
+
+  g_byte_array_unref (in);
+  g_byte_array_unref (expected);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_multi_slice_avc_to_bs)
+{
+  GByteArray *in = make_multi_slice_au (TRUE, FALSE);
+  GByteArray *expected = make_multi_slice_au (FALSE, TRUE);
+  GstBuffer *cdata;
+  GstCaps *caps;
+  gchar *in_caps;
+
+  /* the SPS and PPS only come in the codec_data and get inserted in front
+   * of the first slice */
+  cdata = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+      h264_avc_codec_data, sizeof (h264_avc_codec_data), 0,
+      sizeof (h264_avc_codec_data), NULL, NULL);
+  caps = gst_caps_new_simple ("video/x-h264", "stream-format", G_TYPE_STRING,
+      "avc", "alignment", G_TYPE_STRING, "au", "codec_data", GST_TYPE_BUFFER,
+      cdata, NULL);
+  in_caps = gst_caps_to_string (caps);
+  gst_caps_unref (caps);
+  gst_buffer_unref (cdata);
+
+  check_multi_slice_conversion (in_caps, "video/x-h264, "
+      "stream-format=byte-stream, alignment=au", in, expected);
+
+  g_free (in_caps);
+  g_byte_array_unref (in);
+  g_byte_array_unref (expected);
+}
+
+GST_END_TEST;
+
+static Suite *
+h264parse_conversion_suite (void)
+{
+  Suite *s = suite_create (ctx_suite);
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_multi_slice_bs_to_avc);
+  tcase_add_test (tc_chain, test_multi_slice_avc_to_bs);
+
+  return s;
+}
+
 /*
  * TODO:
  *   - Both push- and pull-modes need to be tested
@@ -614,5 +738,9 @@ main (int argc, char **argv)
   s = h264parse_packetized_suite ();
   nf += gst_check_run_suite (s, ctx_suite, __FILE__ "_packetized.c");
 
+  ctx_suite = "h264parse_conversion";
+  s = h264parse_conversion_suite ();
+  nf += gst_check_run_suite (s, ctx_suite, __FILE__ "_conversion.c");
+
   return nf;
 }
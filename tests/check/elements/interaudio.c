@@ -0,0 +1,429 @@
+/* GStreamer unit tests for the interaudiosink and interaudiosrc elements
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+/* the ring is internal to the plugin, test it directly */
+#include "../../../gst/inter/gstintersurface.c"
+
+#define BPF 4
+
+static void
+fill_frames (guint32 * frames, guint32 first, guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++)
+    frames[i] = first + i;
+}
+
+static void
+write_frames (GstInterAudioRing * ring, guint * write_pos, guint32 first,
+    guint n)
+{
+  guint32 frames[64];
+
+  fail_unless (n <= G_N_ELEMENTS (frames));
+  fill_frames (frames, first, n);
+  fail_unless_equals_int (gst_inter_audio_ring_write (ring, write_pos,
+          (const guint8 *) frames, n * BPF), n * BPF);
+  gst_inter_audio_ring_commit (ring, *write_pos);
+}
+
+static void
+check_read_frames (GstInterAudioRing * ring, guint32 first, guint n)
+{
+  guint32 frames[64], expected[64];
+
+  fail_unless (n <= G_N_ELEMENTS (frames));
+  fill_frames (expected, first, n);
+  fail_unless_equals_int (gst_inter_audio_ring_read (ring,
+          (guint8 *) frames, sizeof (frames)), n * BPF);
+  fail_unless (memcmp (frames, expected, n * BPF) == 0);
+}
+
+GST_START_TEST (test_ring_wrap_around)
+{
+  GstInterAudioRing *ring;
+  guint write_pos;
+
+  ring = gst_inter_audio_ring_new (BPF, 64);
+  fail_unless_equals_int (ring->size, 64);
+
+  /* the second write wraps around the end of the data */
+  write_pos = 0;
+  write_frames (ring, &write_pos, 0, 12);
+  check_read_frames (ring, 0, 12);
+  write_frames (ring, &write_pos, 12, 10);
+  fail_unless_equals_int (gst_inter_audio_ring_available (ring), 10 * BPF);
+  check_read_frames (ring, 12, 10);
+  fail_unless_equals_int (gst_inter_audio_ring_available (ring), 0);
+
+  /* and the positions wrap around 2^32 */
+  write_pos = G_MAXUINT32 - 7;
+  ring->write_pos = ring->read_pos = (gint) write_pos;
+  write_frames (ring, &write_pos, 100, 6);
+  fail_unless_equals_int (write_pos, 16);
+  fail_unless_equals_int (gst_inter_audio_ring_available (ring), 6 * BPF);
+  check_read_frames (ring, 100, 6);
+  fail_unless_equals_int (ring->overruns, 0);
+
+  gst_inter_audio_ring_unref (ring);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_ring_overrun)
+{
+  GstInterAudioRing *ring;
+  guint write_pos = 0;
+  guint32 frames[18];
+
+  ring = gst_inter_audio_ring_new (BPF, 64);
+
+  /* the oldest frames make room for the new ones */
+  write_frames (ring, &write_pos, 0, 12);
+  write_frames (ring, &write_pos, 12, 8);
+  fail_unless_equals_int (ring->overruns, 1);
+  fail_unless_equals_int (gst_inter_audio_ring_available (ring), 64);
+  check_read_frames (ring, 4, 16);
+
+  /* more than fits at once only keeps the end */
+  write_frames (ring, &write_pos, 20, 20);
+  check_read_frames (ring, 24, 16);
+
+  /* dropping frames that are not committed yet leaves nothing to read */
+  write_frames (ring, &write_pos, 40, 16);
+  fill_frames (frames, 56, 18);
+  gst_inter_audio_ring_write (ring, &write_pos, (const guint8 *) frames,
+      16 * BPF);
+  gst_inter_audio_ring_write (ring, &write_pos,
+      (const guint8 *) (frames + 16), 2 * BPF);
+  fail_unless_equals_int (gst_inter_audio_ring_available (ring), 0);
+  fail_unless_equals_int (gst_inter_audio_ring_read (ring,
+          (guint8 *) frames, sizeof (frames)), 0);
+  fail_unless_equals_int (ring->overruns, 3);
+
+  gst_inter_audio_ring_unref (ring);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_ring_trim)
+{
+  GstInterAudioRing *ring;
+  guint write_pos = 0;
+
+  ring = gst_inter_audio_ring_new (BPF, 64);
+
+  write_frames (ring, &write_pos, 0, 12);
+  fail_unless_equals_int (gst_inter_audio_ring_trim (ring, 64), 0);
+  fail_unless_equals_int (gst_inter_audio_ring_trim (ring, 20), 28);
+  check_read_frames (ring, 7, 5);
+
+  /* only whole frames are dropped */
+  write_frames (ring, &write_pos, 12, 12);
+  fail_unless_equals_int (gst_inter_audio_ring_trim (ring, 18), 32);
+  fail_unless_equals_int (gst_inter_audio_ring_available (ring), 16);
+  check_read_frames (ring, 20, 4);
+  fail_unless_equals_int (ring->overruns, 0);
+
+  gst_inter_audio_ring_unref (ring);
+}
+
+GST_END_TEST;
+
+#define STRESS_FRAMES 200000
+
+static gpointer
+stress_write_thread (gpointer data)
+{
+  GstInterAudioRing *ring = data;
+  guint write_pos = 0;
+  guint32 first = 0;
+
+  while (first < STRESS_FRAMES) {
+    guint n = MIN (37, STRESS_FRAMES - first);
+
+    write_frames (ring, &write_pos, first, n);
+    first += n;
+  }
+
+  return NULL;
+}
+
+/* With the producer overwriting frames while the consumer copies them, the
+ * consumer only ever returns frames that were not overwritten */
+GST_START_TEST (test_ring_concurrent_overrun)
+{
+  GstInterAudioRing *ring;
+  GThread *thread;
+  guint32 frames[50];
+  guint32 next = 0, n_read = 0;
+  guint len, i;
+
+  ring = gst_inter_audio_ring_new (BPF, 256);
+  thread = g_thread_new ("writer", stress_write_thread, ring);
+
+  while (next < STRESS_FRAMES) {
+    len = gst_inter_audio_ring_read (ring, (guint8 *) frames,
+        sizeof (frames));
+    fail_unless_equals_int (len % BPF, 0);
+    for (i = 0; i < len / BPF; i++) {
+      /* frames may be missing after an overrun, but never out of order */
+      fail_unless (frames[i] >= next);
+      if (i > 0)
+        fail_unless_equals_int (frames[i], frames[i - 1] + 1);
+      next = frames[i] + 1;
+    }
+    n_read += len / BPF;
+    if (len == 0)
+      g_thread_yield ();
+  }
+  g_thread_join (thread);
+
+  GST_INFO ("read %u frames with %d overruns", n_read, ring->overruns);
+  if (ring->overruns == 0)
+    fail_unless_equals_int (n_read, STRESS_FRAMES);
+
+  gst_inter_audio_ring_unref (ring);
+}
+
+GST_END_TEST;
+
+#define RATE 48000
+#define AUDIO_CAPS_STRING \
+  "audio/x-raw, format=(string)S16LE, rate=(int)48000, channels=(int)1, " \
+  "layout=(string)interleaved"
+/* samples per buffer of the sink input */
+#define SINK_SAMPLES 480
+/* samples per buffer of the source at the default period-time */
+#define PERIOD_SAMPLES (RATE / 40)
+
+/* The channel has to be set before the harness starts the sink */
+static GstHarness *
+new_sink_harness (const gchar * channel)
+{
+  GstHarness *h;
+  gchar *launch;
+
+  launch = g_strdup_printf ("interaudiosink channel=%s sync=false", channel);
+  h = gst_harness_new_parse (launch);
+  g_free (launch);
+  gst_harness_set_src_caps_str (h, AUDIO_CAPS_STRING);
+
+  return h;
+}
+
+static GstHarness *
+new_src_harness (const gchar * channel)
+{
+  GstHarness *h = gst_harness_new ("interaudiosrc");
+
+  g_object_set (h->element, "channel", channel, NULL);
+  gst_harness_use_systemclock (h);
+  gst_harness_play (h);
+
+  return h;
+}
+
+/* Pushes a ramp of @n_samples samples with values starting at @first, so
+ * that they can't be mistaken for silence */
+static void
+push_ramp (GstHarness * h, gint16 first, guint n_samples)
+{
+  guint offset, i;
+
+  for (offset = 0; offset < n_samples; offset += SINK_SAMPLES) {
+    GstBuffer *buf = gst_buffer_new_allocate (NULL, SINK_SAMPLES * 2, NULL);
+    GstMapInfo map;
+    gint16 *samples;
+
+    gst_buffer_map (buf, &map, GST_MAP_WRITE);
+    samples = (gint16 *) map.data;
+    for (i = 0; i < SINK_SAMPLES; i++)
+      samples[i] = GINT16_TO_LE (first + offset + i);
+    gst_buffer_unmap (buf, &map);
+
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (offset, GST_SECOND, RATE);
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+  /* commits what is left of the last period */
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+}
+
+/* Pulls from the source until the ramp of @n_samples starting at @first
+ * came out, checking that none of it is missing. Returns the number of
+ * samples of silence around it */
+static guint
+pull_ramp (GstHarness * h, gint16 first, guint n_samples)
+{
+  guint n_silence = 0, n_ramp = 0, i;
+
+  while (n_ramp < n_samples) {
+    GstBuffer *buf = gst_harness_pull (h);
+    GstMapInfo map;
+    const gint16 *samples;
+
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    fail_unless_equals_int (map.size, PERIOD_SAMPLES * 2);
+    samples = (const gint16 *) map.data;
+    for (i = 0; i < PERIOD_SAMPLES; i++) {
+      gint16 sample = GINT16_FROM_LE (samples[i]);
+
+      if (sample == 0 || n_ramp == n_samples) {
+        fail_unless_equals_int (sample, 0);
+        n_silence++;
+      } else {
+        fail_unless_equals_int (sample, (gint16) (first + n_ramp));
+        n_ramp++;
+      }
+    }
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+
+  return n_silence;
+}
+
+static GstStructure *
+get_stats (GstHarness * h)
+{
+  GstStructure *stats;
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+
+  return stats;
+}
+
+/* All samples rendered by the sink come out of the source in order, also
+ * after the sink was restarted and created a new ring */
+GST_START_TEST (test_sink_to_src)
+{
+  GstHarness *hsink, *hsrc;
+  GstStructure *stats;
+  guint64 dropped, queued, max_queued;
+  guint overruns;
+
+  /* half of the default buffer-time, so nothing is dropped */
+  hsink = new_sink_harness ("interaudio-test");
+  push_ramp (hsink, 1, RATE / 2);
+
+  /* which the source finds at once, so it comes out in full periods */
+  hsrc = new_src_harness ("interaudio-test");
+  fail_unless_equals_int (pull_ramp (hsrc, 1, RATE / 2), 0);
+
+  stats = get_stats (hsrc);
+  fail_unless (gst_structure_get (stats, "dropped-samples", G_TYPE_UINT64,
+          &dropped, "overruns", G_TYPE_UINT, &overruns, "queued-time",
+          G_TYPE_UINT64, &queued, "max-queued-time", G_TYPE_UINT64,
+          &max_queued, NULL));
+  fail_unless_equals_uint64 (dropped, 0);
+  fail_unless_equals_int (overruns, 0);
+  fail_unless_equals_uint64 (queued, 0);
+  /* all but the first period were queued after the first read */
+  fail_unless_equals_uint64 (max_queued,
+      GST_SECOND / 2 - gst_util_uint64_scale (PERIOD_SAMPLES, GST_SECOND,
+          RATE));
+  gst_structure_free (stats);
+
+  /* a new sink replaces the ring, which the source picks up */
+  gst_harness_teardown (hsink);
+  hsink = new_sink_harness ("interaudio-test");
+  push_ramp (hsink, 1000, RATE / 4);
+  pull_ramp (hsrc, 1000, RATE / 4);
+
+  stats = get_stats (hsrc);
+  fail_unless (gst_structure_get (stats, "dropped-samples", G_TYPE_UINT64,
+          &dropped, "overruns", G_TYPE_UINT, &overruns, NULL));
+  fail_unless_equals_uint64 (dropped, 0);
+  fail_unless_equals_int (overruns, 0);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (hsrc);
+  gst_harness_teardown (hsink);
+}
+
+GST_END_TEST;
+
+/* More audio than fits in the ring or in buffer-time is dropped, and
+ * what remains comes out in order */
+GST_START_TEST (test_sink_to_src_dropped)
+{
+  GstHarness *hsink, *hsrc;
+  GstStructure *stats;
+  guint64 dropped, max_queued;
+  guint overruns;
+
+  hsrc = gst_harness_new ("interaudiosrc");
+  g_object_set (hsrc->element, "channel", "interaudio-drop", "buffer-time",
+      GST_SECOND / 4, NULL);
+  gst_harness_use_systemclock (hsrc);
+  /* publishes the buffer-time for the sink, without reading yet */
+  fail_unless_equals_int (gst_element_set_state (hsrc->element,
+          GST_STATE_PAUSED), GST_STATE_CHANGE_NO_PREROLL);
+
+  /* the sink sizes its ring to 16384 samples for that and overwrites the
+   * oldest ones, the source then only keeps the last quarter second */
+  hsink = new_sink_harness ("interaudio-drop");
+  push_ramp (hsink, 1, RATE / 2);
+  gst_harness_play (hsrc);
+  fail_unless_equals_int (pull_ramp (hsrc, RATE / 4 + 1, RATE / 4), 0);
+
+  stats = get_stats (hsrc);
+  fail_unless (gst_structure_get (stats, "dropped-samples", G_TYPE_UINT64,
+          &dropped, "overruns", G_TYPE_UINT, &overruns, "max-queued-time",
+          G_TYPE_UINT64, &max_queued, NULL));
+  fail_unless_equals_uint64 (dropped, 16384 - RATE / 4);
+  fail_unless (overruns > 0);
+  fail_unless (max_queued < GST_SECOND / 4);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (hsrc);
+  gst_harness_teardown (hsink);
+}
+
+GST_END_TEST;
+
+static Suite *
+interaudio_suite (void)
+{
+  Suite *s = suite_create ("interaudio");
+  TCase *tc_ring = tcase_create ("ring");
+  TCase *tc_elements = tcase_create ("elements");
+
+  suite_add_tcase (s, tc_ring);
+  tcase_add_test (tc_ring, test_ring_wrap_around);
+  tcase_add_test (tc_ring, test_ring_overrun);
+  tcase_add_test (tc_ring, test_ring_trim);
+  tcase_add_test (tc_ring, test_ring_concurrent_overrun);
+
+  suite_add_tcase (s, tc_elements);
+  tcase_add_test (tc_elements, test_sink_to_src);
+  tcase_add_test (tc_elements, test_sink_to_src_dropped);
+
+  return s;
+}
+
+GST_CHECK_MAIN (interaudio);
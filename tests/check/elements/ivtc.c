@@ -0,0 +1,216 @@
+/* GStreamer unit tests for the ivtc element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+#define WIDTH 64
+#define HEIGHT 48
+#define N_CYCLES 6
+#define FRAMES_PER_CYCLE 5
+
+#define VIDEO_CAPS_STRING \
+  "video/x-raw, format=(string)I420, width=(int)64, height=(int)48, " \
+  "framerate=(fraction)30000/1001, interlace-mode=(string)mixed"
+
+/* Film frames in a 3:2 telecine cycle of 5 video frames: AA BB BC CD DD */
+static const gint top_film_frame[FRAMES_PER_CYCLE] = { 0, 1, 1, 2, 3 };
+static const gint bottom_film_frame[FRAMES_PER_CYCLE] = { 0, 1, 2, 3, 3 };
+
+/* Vertical bars that move with every film frame, so that lines of two
+ * different film frames comb */
+static guint8
+film_pixel (gint film_frame, gint x)
+{
+  return ((x / 4 + film_frame) % 4) * 60 + 20;
+}
+
+static GstCaps *reference_caps;
+
+static GstBuffer *
+create_telecined_frame (GstVideoInfo * info, gint n)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, info->size, NULL);
+  gint top = top_film_frame[n % FRAMES_PER_CYCLE];
+  gint bottom = bottom_film_frame[n % FRAMES_PER_CYCLE];
+  GstVideoFrame frame;
+  gint x, y;
+
+  fail_unless (gst_video_frame_map (&frame, info, buf, GST_MAP_WRITE));
+  for (y = 0; y < HEIGHT; y++) {
+    guint8 *line = (guint8 *) GST_VIDEO_FRAME_COMP_DATA (&frame, 0) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, 0);
+
+    for (x = 0; x < WIDTH; x++)
+      line[x] = film_pixel ((y & 1) ? bottom : top, x);
+  }
+  for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&frame, 1); y++) {
+    memset ((guint8 *) GST_VIDEO_FRAME_COMP_DATA (&frame, 1) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, 1), 128,
+        GST_VIDEO_FRAME_COMP_WIDTH (&frame, 1));
+    memset ((guint8 *) GST_VIDEO_FRAME_COMP_DATA (&frame, 2) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, 2), 128,
+        GST_VIDEO_FRAME_COMP_WIDTH (&frame, 2));
+  }
+  gst_video_frame_unmap (&frame);
+
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale (n, 1001 * GST_SECOND, 30000);
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (1, 1001 * GST_SECOND,
+      30000);
+  GST_BUFFER_FLAG_SET (buf, GST_VIDEO_BUFFER_FLAG_INTERLACED |
+      GST_VIDEO_BUFFER_FLAG_TFF);
+  /* flags and metas that tell which input buffer an output came with */
+  if (n % 2 == 0)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+  if (n == 7)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+  gst_buffer_add_reference_timestamp_meta (buf, reference_caps, n, 0);
+
+  return buf;
+}
+
+/* Returns the film frame (modulo 4) the progressive frame shows, or -1 if
+ * it is combed or otherwise broken */
+static gint
+get_film_frame (GstVideoInfo * info, GstBuffer * buf)
+{
+  GstVideoFrame frame;
+  gint film_frame, x, y;
+
+  fail_unless (gst_video_frame_map (&frame, info, buf, GST_MAP_READ));
+  for (film_frame = 0; film_frame < 4; film_frame++) {
+    gboolean match = TRUE;
+
+    for (y = 0; y < HEIGHT && match; y++) {
+      const guint8 *line = (const guint8 *) GST_VIDEO_FRAME_COMP_DATA (&frame,
+          0) + y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, 0);
+
+      for (x = 0; x < WIDTH && match; x++)
+        match = line[x] == film_pixel (film_frame, x);
+    }
+    if (match)
+      break;
+  }
+  gst_video_frame_unmap (&frame);
+
+  return film_frame < 4 ? film_frame : -1;
+}
+
+static gboolean
+shares_memory (GstBuffer * out, GstBuffer ** inputs, gint n_inputs)
+{
+  GstMemory *mem = gst_buffer_peek_memory (out, 0);
+  gint i;
+
+  for (i = 0; i < n_inputs; i++) {
+    if (gst_buffer_peek_memory (inputs[i], 0) == mem)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Frames made of both fields of one input buffer are output without
+ * copying, the others are reconstructed into a new buffer. Either way the
+ * output is a clean film frame, and carries the flags and metas of the input
+ * buffer it was output for */
+GST_START_TEST (test_telecine_zero_copy_and_copy)
+{
+  GstBuffer *inputs[N_CYCLES * FRAMES_PER_CYCLE];
+  gint n_zero_copy = 0, n_copy = 0;
+  GstVideoInfo info;
+  GstCaps *caps;
+  GstHarness *h;
+  gint i;
+
+  reference_caps = gst_caps_new_empty_simple ("timestamp/x-test-input");
+
+  caps = gst_caps_from_string (VIDEO_CAPS_STRING);
+  fail_unless (gst_video_info_from_caps (&info, caps));
+
+  h = gst_harness_new ("ivtc");
+  gst_harness_set_src_caps (h, caps);
+
+  for (i = 0; i < G_N_ELEMENTS (inputs); i++) {
+    GstBuffer *out;
+
+    inputs[i] = create_telecined_frame (&info, i);
+    fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (inputs[i])),
+        GST_FLOW_OK);
+
+    while ((out = gst_harness_try_pull (h))) {
+      GstReferenceTimestampMeta *meta;
+      gpointer state = NULL;
+
+      fail_unless (get_film_frame (&info, out) >= 0);
+
+      fail_if (GST_BUFFER_FLAG_IS_SET (out, GST_VIDEO_BUFFER_FLAG_INTERLACED));
+      fail_if (GST_BUFFER_FLAG_IS_SET (out, GST_VIDEO_BUFFER_FLAG_TFF));
+      fail_unless_equals_int (GST_BUFFER_FLAG_IS_SET (out,
+              GST_BUFFER_FLAG_DELTA_UNIT), i % 2 == 0);
+      if (i == 7)
+        fail_unless (GST_BUFFER_FLAG_IS_SET (out, GST_BUFFER_FLAG_DISCONT));
+
+      /* exactly the meta of the current input buffer */
+      meta = (GstReferenceTimestampMeta *) gst_buffer_iterate_meta_filtered
+          (out, &state, GST_REFERENCE_TIMESTAMP_META_API_TYPE);
+      fail_unless (meta != NULL);
+      fail_unless_equals_uint64 (meta->timestamp, i);
+      fail_unless (gst_buffer_iterate_meta_filtered (out, &state,
+              GST_REFERENCE_TIMESTAMP_META_API_TYPE) == NULL);
+
+      if (shares_memory (out, inputs, i + 1))
+        n_zero_copy++;
+      else
+        n_copy++;
+
+      gst_buffer_unref (out);
+    }
+  }
+
+  GST_INFO ("%d frames output without copying, %d copied", n_zero_copy,
+      n_copy);
+  fail_unless (n_zero_copy > 0);
+  fail_unless (n_copy > 0);
+
+  for (i = 0; i < G_N_ELEMENTS (inputs); i++)
+    gst_buffer_unref (inputs[i]);
+  gst_harness_teardown (h);
+  gst_caps_unref (reference_caps);
+}
+
+GST_END_TEST;
+
+static Suite *
+ivtc_suite (void)
+{
+  Suite *s = suite_create ("ivtc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_telecine_zero_copy_and_copy);
+
+  return s;
+}
+
+GST_CHECK_MAIN (ivtc);
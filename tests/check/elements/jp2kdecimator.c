@@ -0,0 +1,617 @@
+/* GStreamer unit tests for the jp2kdecimator element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/base/gstbytereader.h>
+#include <gst/base/gstbytewriter.h>
+
+#define NUM_FRAMES 4
+#define NUM_LAYERS 3
+#define NUM_RESOLUTIONS 5
+
+#define MARKER_SOC 0xFF4F
+#define MARKER_SOT 0xFF90
+#define MARKER_SOD 0xFF93
+#define MARKER_EOC 0xFFD9
+#define MARKER_PLM 0xFF57
+#define MARKER_PLT 0xFF58
+#define MARKER_SOP 0xFF91
+
+/* Shorter ranges of the input are always copied by the decimator */
+#define MIN_SHARED_RANGE_LENGTH 1024
+
+typedef enum
+{
+  PACKET_LENGTHS_NONE,
+  PACKET_LENGTHS_PLT,
+  PACKET_LENGTHS_PLM
+} PacketLengths;
+
+/* The tile-parts and packets of a codestream. Packets are found from their
+ * SOP markers, independently of any PLT and PLM markers */
+typedef struct
+{
+  guint first_sot;              /* offset of the first SOT marker */
+  GArray *sot;                  /* offsets of the SOT markers */
+  GArray *sod;                  /* offsets of the SOD markers */
+  GArray *tile_n_packets;       /* number of packets per tile-part */
+  GArray *packets;              /* lengths of all packets */
+  GArray *plt;                  /* lengths from all PLT markers, or NULL */
+  GArray *plm;                  /* lengths from all PLM markers, or NULL */
+} Codestream;
+
+static void
+read_packet_lengths (GstByteReader * reader, guint size, GArray ** lengths)
+{
+  guint32 n = 0;
+  guint8 b = 0;
+
+  if (!*lengths)
+    *lengths = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  while (size--) {
+    fail_unless (gst_byte_reader_get_uint8 (reader, &b));
+    n = (n << 7) | (b & 0x7f);
+    if (!(b & 0x80)) {
+      g_array_append_val (*lengths, n);
+      n = 0;
+    }
+  }
+  fail_if (b & 0x80);
+}
+
+static void
+write_packet_length (GstByteWriter * writer, guint32 len)
+{
+  gint i;
+
+  for (i = 4; i > 0; i--) {
+    if (len >> (7 * i))
+      gst_byte_writer_put_uint8 (writer, 0x80 | ((len >> (7 * i)) & 0x7f));
+  }
+  gst_byte_writer_put_uint8 (writer, len & 0x7f);
+}
+
+static void
+parse_codestream (const guint8 * data, gsize size, Codestream * cs)
+{
+  GstByteReader reader;
+  guint16 marker, length;
+
+  memset (cs, 0, sizeof (Codestream));
+  cs->sot = g_array_new (FALSE, FALSE, sizeof (guint));
+  cs->sod = g_array_new (FALSE, FALSE, sizeof (guint));
+  cs->tile_n_packets = g_array_new (FALSE, FALSE, sizeof (guint));
+  cs->packets = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  gst_byte_reader_init (&reader, data, size);
+  fail_unless (gst_byte_reader_get_uint16_be (&reader, &marker));
+  fail_unless_equals_int (marker, MARKER_SOC);
+
+  /* main header */
+  while (TRUE) {
+    fail_unless (gst_byte_reader_peek_uint16_be (&reader, &marker));
+    if (marker == MARKER_SOT)
+      break;
+    gst_byte_reader_skip_unchecked (&reader, 2);
+    fail_unless (gst_byte_reader_get_uint16_be (&reader, &length));
+    fail_unless (length >= 2);
+    if (marker == MARKER_PLM) {
+      guint remaining = length - 3;
+
+      gst_byte_reader_skip (&reader, 1);
+      while (remaining > 0) {
+        guint8 n;
+
+        fail_unless (gst_byte_reader_get_uint8 (&reader, &n));
+        fail_unless (n < remaining);
+        read_packet_lengths (&reader, n, &cs->plm);
+        remaining -= n + 1;
+      }
+    } else {
+      fail_unless (gst_byte_reader_skip (&reader, length - 2));
+    }
+  }
+  cs->first_sot = gst_byte_reader_get_pos (&reader);
+
+  /* tile-parts */
+  while (TRUE) {
+    guint sot, sod, end, pos, n_packets = 0;
+    guint32 psot;
+
+    fail_unless (gst_byte_reader_peek_uint16_be (&reader, &marker));
+    if (marker == MARKER_EOC)
+      break;
+    fail_unless_equals_int (marker, MARKER_SOT);
+
+    sot = gst_byte_reader_get_pos (&reader);
+    g_array_append_val (cs->sot, sot);
+    gst_byte_reader_skip_unchecked (&reader, 6);
+    fail_unless (gst_byte_reader_get_uint32_be (&reader, &psot));
+    fail_unless (psot >= 14 && sot + psot <= size - 2);
+    end = sot + psot;
+    gst_byte_reader_skip_unchecked (&reader, 2);
+
+    /* tile-part header */
+    while (TRUE) {
+      fail_unless (gst_byte_reader_get_uint16_be (&reader, &marker));
+      if (marker == MARKER_SOD)
+        break;
+      fail_unless (gst_byte_reader_get_uint16_be (&reader, &length));
+      if (marker == MARKER_PLT) {
+        gst_byte_reader_skip (&reader, 1);
+        read_packet_lengths (&reader, length - 3, &cs->plt);
+      } else {
+        fail_unless (gst_byte_reader_skip (&reader, length - 2));
+      }
+    }
+    sod = gst_byte_reader_get_pos (&reader) - 2;
+    g_array_append_val (cs->sod, sod);
+
+    /* packets, each starting with a SOP marker. Inside packets 0xff is never
+     * followed by a byte above 0x8f */
+    pos = sod + 2;
+    fail_unless (pos < end);
+    fail_unless_equals_int (GST_READ_UINT16_BE (data + pos), MARKER_SOP);
+    while (pos < end) {
+      guint next = pos + 6;
+      guint32 packet_length;
+
+      while (next < end && !(data[next] == 0xff && data[next + 1] ==
+              (MARKER_SOP & 0xff)))
+        next++;
+      packet_length = next - pos;
+      g_array_append_val (cs->packets, packet_length);
+      n_packets++;
+      pos = next;
+    }
+    g_array_append_val (cs->tile_n_packets, n_packets);
+
+    fail_unless (gst_byte_reader_set_pos (&reader, end));
+  }
+
+  fail_unless_equals_int (gst_byte_reader_get_pos (&reader), size - 2);
+}
+
+static void
+clear_codestream (Codestream * cs)
+{
+  g_array_unref (cs->sot);
+  g_array_unref (cs->sod);
+  g_array_unref (cs->tile_n_packets);
+  g_array_unref (cs->packets);
+  if (cs->plt)
+    g_array_unref (cs->plt);
+  if (cs->plm)
+    g_array_unref (cs->plm);
+}
+
+static void
+assert_lengths_equal (GArray * a, GArray * b)
+{
+  guint i;
+
+  fail_unless (a != NULL && b != NULL);
+  fail_unless_equals_int (a->len, b->len);
+  for (i = 0; i < a->len; i++)
+    fail_unless_equals_int (g_array_index (a, guint32, i),
+        g_array_index (b, guint32, i));
+}
+
+/* Returns a copy of the codestream with the lengths of its packets in a PLT
+ * marker in every tile-part header or in a PLM marker in the main header */
+static GstBuffer *
+add_packet_lengths (GstBuffer * buf, PacketLengths packet_lengths)
+{
+  GstByteWriter writer;
+  Codestream cs;
+  GstMapInfo map;
+  GstBuffer *outbuf;
+  guint i, j, packet = 0;
+
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  parse_codestream (map.data, map.size, &cs);
+  fail_unless (cs.plt == NULL && cs.plm == NULL);
+
+  gst_byte_writer_init (&writer);
+  gst_byte_writer_put_data (&writer, map.data, cs.first_sot);
+
+  if (packet_lengths == PACKET_LENGTHS_PLM) {
+    guint start;
+
+    gst_byte_writer_put_uint16_be (&writer, MARKER_PLM);
+    start = gst_byte_writer_get_pos (&writer);
+    gst_byte_writer_put_uint16_be (&writer, 0);
+    gst_byte_writer_put_uint8 (&writer, 0);
+    for (i = 0; i < cs.sot->len; i++) {
+      guint n_pos = gst_byte_writer_get_pos (&writer), end;
+
+      gst_byte_writer_put_uint8 (&writer, 0);
+      for (j = 0; j < g_array_index (cs.tile_n_packets, guint, i); j++)
+        write_packet_length (&writer, g_array_index (cs.packets, guint32,
+                packet + j));
+      packet += j;
+      end = gst_byte_writer_get_pos (&writer);
+      fail_unless (end - n_pos - 1 <= 255);
+      gst_byte_writer_set_pos (&writer, n_pos);
+      gst_byte_writer_put_uint8 (&writer, end - n_pos - 1);
+      gst_byte_writer_set_pos (&writer, end);
+    }
+    i = gst_byte_writer_get_pos (&writer);
+    gst_byte_writer_set_pos (&writer, start);
+    gst_byte_writer_put_uint16_be (&writer, i - start);
+    gst_byte_writer_set_pos (&writer, i);
+  }
+
+  for (i = 0, packet = 0; i < cs.sot->len; i++) {
+    guint sot = g_array_index (cs.sot, guint, i);
+    guint sod = g_array_index (cs.sod, guint, i);
+    guint32 psot = GST_READ_UINT32_BE (map.data + sot + 6);
+    guint sot_pos = gst_byte_writer_get_pos (&writer), end;
+
+    gst_byte_writer_put_data (&writer, map.data + sot, sod - sot);
+
+    if (packet_lengths == PACKET_LENGTHS_PLT) {
+      guint start;
+
+      gst_byte_writer_put_uint16_be (&writer, MARKER_PLT);
+      start = gst_byte_writer_get_pos (&writer);
+      gst_byte_writer_put_uint16_be (&writer, 0);
+      gst_byte_writer_put_uint8 (&writer, 0);
+      for (j = 0; j < g_array_index (cs.tile_n_packets, guint, i); j++)
+        write_packet_length (&writer, g_array_index (cs.packets, guint32,
+                packet + j));
+      end = gst_byte_writer_get_pos (&writer);
+      fail_unless (end - start <= 65535);
+      gst_byte_writer_set_pos (&writer, start);
+      gst_byte_writer_put_uint16_be (&writer, end - start);
+      gst_byte_writer_set_pos (&writer, end);
+    }
+    packet += g_array_index (cs.tile_n_packets, guint, i);
+
+    gst_byte_writer_put_data (&writer, map.data + sod, sot + psot - sod);
+
+    /* Psot */
+    end = gst_byte_writer_get_pos (&writer);
+    gst_byte_writer_set_pos (&writer, sot_pos + 6);
+    gst_byte_writer_put_uint32_be (&writer, end - sot_pos);
+    gst_byte_writer_set_pos (&writer, end);
+  }
+  gst_byte_writer_put_uint16_be (&writer, MARKER_EOC);
+
+  clear_codestream (&cs);
+  gst_buffer_unmap (buf, &map);
+
+  outbuf = gst_byte_writer_reset_and_get_buffer (&writer);
+  gst_buffer_copy_into (outbuf, buf, GST_BUFFER_COPY_METADATA, 0, -1);
+
+  return outbuf;
+}
+
+typedef struct
+{
+  PacketLengths packet_lengths;
+  gboolean decimate;
+
+  GstBuffer *input;
+  GPtrArray *checksums;
+
+  gsize input_size, output_size;
+  gsize shared_size;
+  guint n_shared;
+} DecimateState;
+
+static GstPadProbeReturn
+decimator_sink_probe (GstPad * pad, GstPadProbeInfo * info,
+    DecimateState * state)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (state->packet_lengths != PACKET_LENGTHS_NONE) {
+    GstBuffer *rewritten = add_packet_lengths (buf, state->packet_lengths);
+
+    gst_buffer_unref (buf);
+    GST_PAD_PROBE_INFO_DATA (info) = buf = rewritten;
+  }
+
+  gst_buffer_replace (&state->input, buf);
+  state->input_size += gst_buffer_get_size (buf);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Returns TRUE if @mem is a sub-memory of one of the memories of @buf */
+static gboolean
+is_shared_with (GstMemory * mem, GstBuffer * buf)
+{
+  guint i;
+
+  for (i = 0; i < gst_buffer_n_memory (buf); i++) {
+    GstMemory *in_mem = gst_buffer_peek_memory (buf, i);
+    GstMemory *root = in_mem->parent ? in_mem->parent : in_mem;
+
+    if (mem == in_mem || (mem->parent && mem->parent == root)) {
+      fail_unless (mem->offset >= in_mem->offset);
+      fail_unless (mem->offset + mem->size <= in_mem->offset + in_mem->size);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static GstPadProbeReturn
+decimator_src_probe (GstPad * pad, GstPadProbeInfo * info,
+    DecimateState * state)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  Codestream in, out;
+  GstMapInfo in_map, out_map;
+  guint i;
+
+  fail_unless (state->input != NULL);
+  state->output_size += gst_buffer_get_size (buf);
+
+  fail_unless (gst_buffer_map (state->input, &in_map, GST_MAP_READ));
+  fail_unless (gst_buffer_map (buf, &out_map, GST_MAP_READ));
+  parse_codestream (in_map.data, in_map.size, &in);
+  parse_codestream (out_map.data, out_map.size, &out);
+
+  /* dropped packets are replaced by empty ones */
+  fail_unless_equals_int (out.packets->len, in.packets->len);
+  fail_unless_equals_int (out.sot->len, in.sot->len);
+  for (i = 0; i < in.packets->len; i++)
+    fail_unless (g_array_index (out.packets, guint32, i) <=
+        g_array_index (in.packets, guint32, i));
+
+  /* the packet length markers describe the rewritten packets */
+  switch (state->packet_lengths) {
+    case PACKET_LENGTHS_NONE:
+      fail_unless (out.plt == NULL && out.plm == NULL);
+      break;
+    case PACKET_LENGTHS_PLT:
+      fail_unless (out.plm == NULL);
+      assert_lengths_equal (out.plt, out.packets);
+      break;
+    case PACKET_LENGTHS_PLM:
+      fail_unless (out.plt == NULL);
+      assert_lengths_equal (out.plm, out.packets);
+      break;
+  }
+
+  gst_buffer_unmap (buf, &out_map);
+  gst_buffer_unmap (state->input, &in_map);
+  clear_codestream (&in);
+  clear_codestream (&out);
+
+  /* unchanged parts of the input are shared with the output */
+  if (state->decimate) {
+    fail_unless (gst_buffer_n_memory (buf) <= gst_buffer_get_max_memory ());
+    for (i = 0; i < gst_buffer_n_memory (buf); i++) {
+      GstMemory *mem = gst_buffer_peek_memory (buf, i);
+
+      if (is_shared_with (mem, state->input)) {
+        fail_unless (mem->size >= MIN_SHARED_RANGE_LENGTH);
+        state->n_shared++;
+        state->shared_size += mem->size;
+      }
+    }
+  } else {
+    fail_unless (buf == state->input);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+handoff_cb (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    DecimateState * state)
+{
+  GstMapInfo map;
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  g_ptr_array_add (state->checksums,
+      g_compute_checksum_for_data (G_CHECKSUM_SHA1, map.data, map.size));
+  gst_buffer_unmap (buf, &map);
+}
+
+static void
+add_probe (GstElement * element, const gchar * pad_name,
+    GstPadProbeCallback callback, DecimateState * state)
+{
+  GstPad *pad = gst_element_get_static_pad (element, pad_name);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, callback, state, NULL);
+  gst_object_unref (pad);
+}
+
+/* Encodes NUM_FRAMES frames with SOP markers, decimates them with the given
+ * properties and decodes them again. Fills @state with the checksums of the
+ * decoded frames and statistics about the decimated codestreams */
+static void
+run_pipeline (const gchar * enc_props, PacketLengths packet_lengths,
+    const gchar * dec_props, DecimateState * state)
+{
+  GstElement *pipe, *elem;
+  GstMessage *msg;
+  GstBus *bus;
+  gchar *desc;
+  gint max_layers, max_decomposition_levels;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d pattern=circular ! "
+      "video/x-raw,format=I420,width=320,height=240,framerate=25/1 ! "
+      "openjpegenc sop-markers=true num-layers=%d num-resolutions=%d %s ! "
+      "image/x-jpc ! jp2kdecimator name=decimator %s ! openjpegdec ! "
+      "fakesink name=sink signal-handoffs=true sync=false", NUM_FRAMES,
+      NUM_LAYERS, NUM_RESOLUTIONS, enc_props, dec_props);
+  pipe = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipe != NULL);
+
+  memset (state, 0, sizeof (DecimateState));
+  state->packet_lengths = packet_lengths;
+  state->checksums = g_ptr_array_new_with_free_func (g_free);
+
+  elem = gst_bin_get_by_name (GST_BIN (pipe), "decimator");
+  g_object_get (elem, "max-layers", &max_layers, "max-decomposition-levels",
+      &max_decomposition_levels, NULL);
+  state->decimate = max_layers != 0 || max_decomposition_levels != -1;
+  add_probe (elem, "sink", (GstPadProbeCallback) decimator_sink_probe, state);
+  add_probe (elem, "src", (GstPadProbeCallback) decimator_src_probe, state);
+  gst_object_unref (elem);
+
+  elem = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+  g_signal_connect (elem, "handoff", G_CALLBACK (handoff_cb), state);
+  gst_object_unref (elem);
+
+  fail_if (gst_element_set_state (pipe, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  bus = gst_element_get_bus (pipe);
+  msg = gst_bus_timed_pop_filtered (bus, 60 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+  gst_buffer_replace (&state->input, NULL);
+
+  fail_unless_equals_int (state->checksums->len, NUM_FRAMES);
+  GST_INFO ("openjpegenc %s, jp2kdecimator %s: %" G_GSIZE_FORMAT " bytes to %"
+      G_GSIZE_FORMAT " bytes, %" G_GSIZE_FORMAT " bytes shared in %u memories",
+      enc_props, dec_props, state->input_size, state->output_size,
+      state->shared_size, state->n_shared);
+}
+
+static gboolean
+checksums_equal (GPtrArray * a, GPtrArray * b)
+{
+  guint i;
+
+  fail_unless_equals_int (a->len, b->len);
+  for (i = 0; i < a->len; i++) {
+    if (strcmp (g_ptr_array_index (a, i), g_ptr_array_index (b, i)) != 0)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+check_decimation (const gchar * enc_props, PacketLengths packet_lengths)
+{
+  const struct
+  {
+    const gchar *props;
+    gboolean lossless;
+    /* the kept packets of each tile are in a few long runs */
+    gboolean shared;
+  } settings[] = {
+    /* keeping all layers and levels drops nothing */
+    {"max-layers=3", TRUE, TRUE},
+    {"max-decomposition-levels=4", TRUE, TRUE},
+    {"max-layers=1", FALSE, FALSE},
+    {"max-layers=2 max-decomposition-levels=3", FALSE, FALSE},
+    {"max-decomposition-levels=3", FALSE, TRUE},
+    {"max-decomposition-levels=1", FALSE, FALSE},
+    {"max-layers=1 max-decomposition-levels=0", FALSE, FALSE},
+  };
+  DecimateState reference, state;
+  guint i;
+
+  /* not decimated at all */
+  run_pipeline (enc_props, packet_lengths, "", &reference);
+
+  for (i = 0; i < G_N_ELEMENTS (settings); i++) {
+    run_pipeline (enc_props, packet_lengths, settings[i].props, &state);
+
+    fail_unless (state.output_size <= state.input_size);
+    if (settings[i].lossless) {
+      fail_unless (checksums_equal (reference.checksums, state.checksums));
+    } else if (strstr (settings[i].props, "decomposition")) {
+      /* the finest rings are only in the highest resolution */
+      fail_unless (state.output_size < state.input_size);
+      fail_if (checksums_equal (reference.checksums, state.checksums));
+    }
+
+    /* the long runs of kept packet data are shared with the input */
+    if (settings[i].shared) {
+      fail_unless (state.n_shared > 0);
+      fail_unless (state.shared_size > state.output_size / 2);
+    }
+
+    g_ptr_array_unref (state.checksums);
+  }
+
+  g_ptr_array_unref (reference.checksums);
+}
+
+GST_START_TEST (test_decimate_sop)
+{
+  check_decimation ("", PACKET_LENGTHS_NONE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_decimate_sop_eph_tiles)
+{
+  check_decimation ("eph-markers=true tile-width=160 tile-height=120 "
+      "progression-order=rpcl", PACKET_LENGTHS_NONE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_decimate_plt)
+{
+  check_decimation ("tile-width=160 tile-height=120", PACKET_LENGTHS_PLT);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_decimate_plm)
+{
+  check_decimation ("tile-width=160 tile-height=120 progression-order=rlcp",
+      PACKET_LENGTHS_PLM);
+}
+
+GST_END_TEST;
+
+static Suite *
+jp2kdecimator_suite (void)
+{
+  Suite *s = suite_create ("jp2kdecimator");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_set_timeout (tc_chain, 120);
+  tcase_add_test (tc_chain, test_decimate_sop);
+  tcase_add_test (tc_chain, test_decimate_sop_eph_tiles);
+  tcase_add_test (tc_chain, test_decimate_plt);
+  tcase_add_test (tc_chain, test_decimate_plm);
+
+  return s;
+}
+
+GST_CHECK_MAIN (jp2kdecimator);
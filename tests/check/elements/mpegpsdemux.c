@@ -0,0 +1,372 @@
+/* GStreamer unit tests for the mpegpsdemux element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define FPS 25
+#define GOP_FRAMES 12
+#define PACK_SIZE 2048
+#define PACKS_PER_FRAME 4
+/* in 90kHz ticks */
+#define FIRST_SCR 90000
+#define FRAME_TICKS (90000 / FPS)
+#define PTS_DELAY 18000
+
+#define FRAME_DURATION (GST_SECOND / FPS)
+#define GOP_DURATION (GOP_FRAMES * FRAME_DURATION)
+
+/* A pack with a part of a video frame. The frames start with a picture
+ * header, the first one of each GOP with a sequence header. */
+static void
+write_pack (guint8 * data, guint64 scr, gint64 pts, gboolean keyframe)
+{
+  guint mux_rate = PACK_SIZE * PACKS_PER_FRAME * FPS / 50;
+  guint8 *pes, *payload;
+
+  memset (data, 0xff, PACK_SIZE);
+
+  GST_WRITE_UINT32_BE (data, 0x000001ba);
+  data[4] = 0x44 | ((scr >> 27) & 0x38) | ((scr >> 28) & 0x03);
+  data[5] = (scr >> 20) & 0xff;
+  data[6] = ((scr >> 12) & 0xf8) | 0x04 | ((scr >> 13) & 0x03);
+  data[7] = (scr >> 5) & 0xff;
+  data[8] = ((scr << 3) & 0xf8) | 0x04;
+  data[9] = 0x01;
+  data[10] = (mux_rate >> 14) & 0xff;
+  data[11] = (mux_rate >> 6) & 0xff;
+  data[12] = ((mux_rate << 2) & 0xfc) | 0x03;
+  data[13] = 0xf8;
+
+  pes = data + 14;
+  GST_WRITE_UINT32_BE (pes, 0x000001e0);
+  GST_WRITE_UINT16_BE (pes + 4, PACK_SIZE - 14 - 6);
+  pes[6] = 0x81;
+  if (pts < 0) {
+    pes[7] = 0x00;
+    pes[8] = 0;
+    return;
+  }
+
+  pes[7] = 0x80;
+  pes[8] = 5;
+  pes[9] = 0x21 | ((pts >> 29) & 0x0e);
+  pes[10] = (pts >> 22) & 0xff;
+  pes[11] = ((pts >> 14) & 0xfe) | 0x01;
+  pes[12] = (pts >> 7) & 0xff;
+  pes[13] = ((pts << 1) & 0xfe) | 0x01;
+
+  payload = pes + 14;
+  if (keyframe) {
+    GST_WRITE_UINT32_BE (payload, 0x000001b3);
+    payload += 12;
+  }
+  GST_WRITE_UINT32_BE (payload, 0x00000100);
+  payload[4] = 0x00;
+  payload[5] = (keyframe ? 1 : 2) << 3;
+}
+
+/* The temporary file of the current test, removed after it */
+static gchar *filename;
+
+static void
+remove_ps_file (void)
+{
+  if (filename) {
+    g_unlink (filename);
+    g_free (filename);
+    filename = NULL;
+  }
+}
+
+/* Writes a program stream with @n_frames frames to a temporary file */
+static void
+create_ps_file (gint n_frames)
+{
+  gsize size = (gsize) n_frames * PACKS_PER_FRAME * PACK_SIZE;
+  guint8 *data;
+  gint fd, i;
+
+  fd = g_file_open_tmp ("mpegpsdemux-XXXXXX.mpg", &filename, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+
+  data = g_malloc (size);
+  for (i = 0; i < n_frames * PACKS_PER_FRAME; i++) {
+    guint64 scr = FIRST_SCR + (guint64) i * FRAME_TICKS / PACKS_PER_FRAME;
+    gint frame = i / PACKS_PER_FRAME;
+    gint64 pts = -1;
+
+    if (i % PACKS_PER_FRAME == 0)
+      pts = scr + PTS_DELAY;
+    write_pack (data + (gsize) i * PACK_SIZE, scr, pts,
+        frame % GOP_FRAMES == 0);
+  }
+  fail_unless (g_file_set_contents (filename, (gchar *) data, size, NULL));
+  g_free (data);
+}
+
+typedef struct
+{
+  GMutex lock;
+  gboolean waiting;
+  GstClockTime pts;
+  guint32 start_code;
+} SeekState;
+
+/* Keeps the first buffer after every flush */
+static GstPadProbeReturn
+sink_probe (GstPad * pad, GstPadProbeInfo * info, SeekState * state)
+{
+  g_mutex_lock (&state->lock);
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_FLUSH) {
+    if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+        GST_EVENT_FLUSH_STOP)
+      state->waiting = TRUE;
+  } else if (state->waiting) {
+    GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+    guint8 data[4] = { 0, };
+
+    gst_buffer_extract (buf, 0, data, 4);
+    state->start_code = GST_READ_UINT32_BE (data);
+    state->pts = GST_BUFFER_PTS (buf);
+    state->waiting = FALSE;
+  }
+  g_mutex_unlock (&state->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstElement *
+create_pipeline (SeekState * state)
+{
+  GstElement *pipe, *sink;
+  GstPad *pad;
+  gchar *desc;
+
+  desc = g_strdup_printf ("filesrc location=%s ! mpegpsdemux name=demux "
+      "demux.video_e0 ! fakesink name=sink sync=false", filename);
+  pipe = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipe != NULL);
+
+  g_mutex_init (&state->lock);
+  state->waiting = FALSE;
+  state->pts = GST_CLOCK_TIME_NONE;
+
+  sink = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      (GstPadProbeCallback) sink_probe, state, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+
+  return pipe;
+}
+
+/* Plays the whole file, which indexes all of it */
+static void
+play_to_eos (GstElement * pipe)
+{
+  GstMessage *msg;
+  GstBus *bus;
+
+  fail_if (gst_element_set_state (pipe, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (pipe);
+  msg = gst_bus_timed_pop_filtered (bus, 60 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_if (gst_element_set_state (pipe, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE);
+}
+
+static void
+do_seek (GstElement * pipe, GstClockTime position)
+{
+  fail_unless (gst_element_seek (pipe, 1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, GST_SEEK_TYPE_SET,
+          position, GST_SEEK_TYPE_NONE, -1));
+  fail_unless (gst_element_get_state (pipe, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+}
+
+/* Once the file was played, seeks start at the keyframe before the target */
+GST_START_TEST (test_seek_to_keyframe)
+{
+  const GstClockTime positions[] = { 10 * GST_SECOND, 37300 * GST_MSECOND,
+    61100 * GST_MSECOND, 5 * GST_SECOND, 70960 * GST_MSECOND
+  };
+  GstClockTime expected;
+  GstElement *pipe;
+  SeekState state;
+  guint i;
+
+  create_ps_file (80 * FPS);
+  pipe = create_pipeline (&state);
+  play_to_eos (pipe);
+
+  for (i = 0; i < G_N_ELEMENTS (positions); i++) {
+    do_seek (pipe, positions[i]);
+
+    /* PTS of the frame at the target */
+    expected = positions[i] + gst_util_uint64_scale (FIRST_SCR + PTS_DELAY,
+        GST_SECOND, 90000);
+    g_mutex_lock (&state.lock);
+    fail_if (state.waiting);
+    GST_DEBUG ("seek to %" GST_TIME_FORMAT ": first buffer at %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (positions[i]),
+        GST_TIME_ARGS (state.pts));
+    fail_unless_equals_int (state.start_code, 0x000001b3);
+    fail_unless (GST_CLOCK_TIME_IS_VALID (state.pts));
+    fail_unless (state.pts <= expected);
+    fail_unless (state.pts + GOP_DURATION + FRAME_DURATION > expected);
+    g_mutex_unlock (&state.lock);
+  }
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+  g_mutex_clear (&state.lock);
+}
+
+GST_END_TEST;
+
+/* Without index, seeks search the pack at the target. The targets are on
+ * frame boundaries and far from each other, so the first buffer after each
+ * seek is the start of the frame at the target */
+GST_START_TEST (test_seek_without_index)
+{
+  const GstClockTime positions[] = { 61200 * GST_MSECOND,
+    37200 * GST_MSECOND, 10 * GST_SECOND, 70960 * GST_MSECOND
+  };
+  GstClockTime expected;
+  GstElement *pipe;
+  SeekState state;
+  guint i;
+
+  create_ps_file (80 * FPS);
+  pipe = create_pipeline (&state);
+  fail_if (gst_element_set_state (pipe, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless (gst_element_get_state (pipe, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < G_N_ELEMENTS (positions); i++) {
+    do_seek (pipe, positions[i]);
+
+    expected = positions[i] + gst_util_uint64_scale (FIRST_SCR + PTS_DELAY,
+        GST_SECOND, 90000);
+    g_mutex_lock (&state.lock);
+    fail_if (state.waiting);
+    GST_DEBUG ("seek to %" GST_TIME_FORMAT ": first buffer at %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (positions[i]),
+        GST_TIME_ARGS (state.pts));
+    fail_unless (GST_CLOCK_TIME_IS_VALID (state.pts));
+    fail_unless (state.pts <= expected);
+    fail_unless (state.pts + FRAME_DURATION > expected);
+    g_mutex_unlock (&state.lock);
+  }
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+  g_mutex_clear (&state.lock);
+}
+
+GST_END_TEST;
+
+#define BENCHMARK_FRAMES (10 * 60 * FPS)
+#define BENCHMARK_SEEKS 20
+
+/* Returns the average seek latency in us */
+static gint64
+run_seeks (GstElement * pipe)
+{
+  GRand *rand = g_rand_new_with_seed (42);
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCHMARK_SEEKS; i++)
+    do_seek (pipe, g_rand_int_range (rand, 0,
+            BENCHMARK_FRAMES - 2 * FPS) * FRAME_DURATION);
+  g_rand_free (rand);
+
+  return (g_get_monotonic_time () - start) / BENCHMARK_SEEKS;
+}
+
+/* Seeks in a large file without index and with the index built while
+ * playing, and logs the average seek latency */
+GST_START_TEST (test_seek_benchmark)
+{
+  gint64 unindexed, indexed;
+  GstElement *pipe;
+  SeekState state;
+
+  create_ps_file (BENCHMARK_FRAMES);
+  pipe = create_pipeline (&state);
+
+  fail_if (gst_element_set_state (pipe, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless (gst_element_get_state (pipe, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+  unindexed = run_seeks (pipe);
+
+  play_to_eos (pipe);
+  indexed = run_seeks (pipe);
+
+  GST_INFO ("%d MB file, average seek latency without index %"
+      G_GINT64_FORMAT " us, with index %" G_GINT64_FORMAT " us",
+      BENCHMARK_FRAMES * PACKS_PER_FRAME * PACK_SIZE / (1024 * 1024),
+      unindexed, indexed);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+  g_mutex_clear (&state.lock);
+}
+
+GST_END_TEST;
+
+static Suite *
+mpegpsdemux_suite (void)
+{
+  Suite *s = suite_create ("mpegpsdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_set_timeout (tc_chain, 120);
+  tcase_add_checked_fixture (tc_chain, NULL, remove_ps_file);
+  tcase_add_test (tc_chain, test_seek_to_keyframe);
+  tcase_add_test (tc_chain, test_seek_without_index);
+  /* writes a 120 MB file, only run when asked for */
+  if (g_getenv ("GST_CHECK_BENCHMARK"))
+    tcase_add_test (tc_chain, test_seek_benchmark);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mpegpsdemux);
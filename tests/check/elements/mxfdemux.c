@@ -21,6 +21,7 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
 #include <string.h>
 #include "mxfdemux.h"
 
@@ -287,11 +288,156 @@ GST_START_TEST (test_push)
 
 GST_END_TEST;
 
+/* The file written by mxfmux for the read-ahead tests, removed after each */
+static gchar *filename;
+
+static void
+remove_file (void)
+{
+  if (filename) {
+    g_unlink (filename);
+    g_free (filename);
+    filename = NULL;
+  }
+}
+
+static void
+run_to_eos (GstElement * pipeline)
+{
+  GstMessage *msg;
+  GstBus *bus;
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, 60 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+/* 100 frames of 9kB each, so that the file spans many read blocks */
+static void
+create_file (void)
+{
+  GstElement *pipeline;
+  gchar *desc;
+  gint fd;
+
+  fd = g_file_open_tmp ("mxfdemux-XXXXXX.mxf", &filename, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=100 pattern=ball ! "
+      "video/x-raw,format=(string)v308,width=64,height=48,framerate=25/1 ! "
+      "mxfmux ! filesink location=%s", filename);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  run_to_eos (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+static void
+log_buffer (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    GString * log)
+{
+  GstMapInfo map;
+  gchar *checksum;
+
+  fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+  checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5, map.data, map.size);
+  gst_buffer_unmap (buffer, &map);
+
+  g_string_append_printf (log, "%" GST_TIME_FORMAT " %s\n",
+      GST_TIME_ARGS (GST_BUFFER_PTS (buffer)), checksum);
+  g_free (checksum);
+}
+
+/* Seeks forwards within and across read blocks and backwards, logging the
+ * buffer prerolled after each seek, and then plays to the end. Returns the
+ * log of all buffers */
+static gchar *
+demux_file (guint read_ahead_size, gboolean threaded)
+{
+  const GstClockTime positions[] = { GST_SECOND, 1120 * GST_MSECOND,
+    3 * GST_SECOND, 200 * GST_MSECOND, 2 * GST_SECOND
+  };
+  GstElement *pipeline, *sink;
+  GString *log = g_string_new (NULL);
+  gchar *desc;
+  guint i;
+
+  desc = g_strdup_printf ("filesrc location=%s ! "
+      "mxfdemux name=demux read-ahead-size=%u threaded-read-ahead=%s "
+      "demux. ! fakesink name=sink sync=false signal-handoffs=true",
+      filename, read_ahead_size, threaded ? "true" : "false");
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "preroll-handoff", G_CALLBACK (log_buffer), log);
+  gst_object_unref (sink);
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < G_N_ELEMENTS (positions); i++) {
+    fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+            GST_SEEK_FLAG_FLUSH, positions[i]));
+    fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+            GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+  }
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (log_buffer), log);
+  gst_object_unref (sink);
+  run_to_eos (pipeline);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return g_string_free (log, FALSE);
+}
+
+/* Reads served from the read cache, with or without the read-ahead thread,
+ * give the same buffers as reading everything upstream directly. The small
+ * read-ahead size makes blocks end inside frames and seeks leave them */
+GST_START_TEST (test_read_ahead)
+{
+  gchar *uncached, *cached, *threaded;
+
+  create_file ();
+
+  uncached = demux_file (0, FALSE);
+  cached = demux_file (64 * 1024, FALSE);
+  threaded = demux_file (64 * 1024, TRUE);
+
+  /* all the seeks prerolled and frames from 2s on were played */
+  fail_unless (strlen (uncached) > 0);
+  fail_unless_equals_string (cached, uncached);
+  fail_unless_equals_string (threaded, uncached);
+
+  g_free (uncached);
+  g_free (cached);
+  g_free (threaded);
+}
+
+GST_END_TEST;
+
 static Suite *
 mxfdemux_suite (void)
 {
   Suite *s = suite_create ("mxfdemux");
   TCase *tc_chain = tcase_create ("general");
+  TCase *tc_read_ahead = tcase_create ("read-ahead");
 
   /* FIXME: remove again once ported */
   if (!gst_registry_check_feature_version (gst_registry_get (), "mxfdemux", 1,
@@ -303,6 +449,11 @@ mxfdemux_suite (void)
   tcase_add_test (tc_chain, test_pull);
   tcase_add_test (tc_chain, test_push);
 
+  suite_add_tcase (s, tc_read_ahead);
+  tcase_set_timeout (tc_read_ahead, 180);
+  tcase_add_checked_fixture (tc_read_ahead, NULL, remove_file);
+  tcase_add_test (tc_read_ahead, test_read_ahead);
+
   return s;
 }
 
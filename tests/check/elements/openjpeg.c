@@ -0,0 +1,391 @@
+/* GStreamer unit tests for the openjpeg elements
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#define NUM_FRAMES 48
+
+typedef struct
+{
+  GPtrArray *checksums;
+  GstClockTime last_pts;
+
+  /* copies of the input frames per PTS, to compare the output with */
+  GMutex lock;
+  GstVideoInfo in_info;
+  GHashTable *inputs;
+
+  /* arrival time at the encoder per PTS, for the encoding latency */
+  GHashTable *arrival;
+  gint64 total_latency;
+  guint n_encoded;
+} DecodeState;
+
+static GstPadProbeReturn
+enc_sink_probe (GstPad * pad, GstPadProbeInfo * info, DecodeState * state)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  gint64 *now = g_new (gint64, 1);
+  GstCaps *caps;
+
+  *now = g_get_monotonic_time ();
+  g_hash_table_insert (state->arrival, g_memdup (&GST_BUFFER_PTS (buf),
+          sizeof (GstClockTime)), now);
+
+  caps = gst_pad_get_current_caps (pad);
+  g_mutex_lock (&state->lock);
+  fail_unless (gst_video_info_from_caps (&state->in_info, caps));
+  /* a deep copy, the source reuses its buffers */
+  g_hash_table_insert (state->inputs, g_memdup (&GST_BUFFER_PTS (buf),
+          sizeof (GstClockTime)), gst_buffer_copy_deep (buf));
+  g_mutex_unlock (&state->lock);
+  gst_caps_unref (caps);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+enc_src_probe (GstPad * pad, GstPadProbeInfo * info, DecodeState * state)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  gint64 *arrival;
+
+  arrival = g_hash_table_lookup (state->arrival, &GST_BUFFER_PTS (buf));
+  fail_unless (arrival != NULL);
+  state->total_latency += g_get_monotonic_time () - *arrival;
+  state->n_encoded++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Checks that a decoded frame equals its input. Every component is 8 bit
+ * and in the same order in both formats, sub-sampled chroma is compared
+ * with the output as upsampled by repeating the samples */
+static void
+check_frame (GstVideoInfo * in_info, GstBuffer * in, GstVideoInfo * out_info,
+    GstBuffer * out)
+{
+  GstVideoFrame in_frame, out_frame;
+  gint c, x, y, w, h;
+
+  fail_unless (gst_video_frame_map (&in_frame, in_info, in, GST_MAP_READ));
+  fail_unless (gst_video_frame_map (&out_frame, out_info, out,
+          GST_MAP_READ));
+  fail_unless_equals_int (GST_VIDEO_FRAME_N_COMPONENTS (&out_frame),
+      GST_VIDEO_FRAME_N_COMPONENTS (&in_frame));
+  w = GST_VIDEO_FRAME_WIDTH (&out_frame);
+  h = GST_VIDEO_FRAME_HEIGHT (&out_frame);
+
+  for (c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS (&in_frame); c++) {
+    gint in_wsub = GST_VIDEO_FORMAT_INFO_W_SUB (in_info->finfo, c);
+    gint in_hsub = GST_VIDEO_FORMAT_INFO_H_SUB (in_info->finfo, c);
+    gint in_pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (&in_frame, c);
+    gint out_wsub = GST_VIDEO_FORMAT_INFO_W_SUB (out_info->finfo, c);
+    gint out_hsub = GST_VIDEO_FORMAT_INFO_H_SUB (out_info->finfo, c);
+    gint out_pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (&out_frame, c);
+
+    fail_unless_equals_int (GST_VIDEO_FRAME_COMP_DEPTH (&out_frame, c), 8);
+
+    for (y = 0; y < h; y++) {
+      const guint8 *in_row, *out_row;
+
+      in_row = (const guint8 *) GST_VIDEO_FRAME_COMP_DATA (&in_frame, c) +
+          (y >> in_hsub) * GST_VIDEO_FRAME_COMP_STRIDE (&in_frame, c);
+      out_row = (const guint8 *) GST_VIDEO_FRAME_COMP_DATA (&out_frame, c) +
+          (y >> out_hsub) * GST_VIDEO_FRAME_COMP_STRIDE (&out_frame, c);
+
+      for (x = 0; x < w; x++) {
+        guint8 expected = in_row[(x >> in_wsub) * in_pstride];
+        guint8 actual = out_row[(x >> out_wsub) * out_pstride];
+
+        if (actual != expected)
+          fail ("component %d at %d,%d is %u instead of %u", c, x, y, actual,
+              expected);
+      }
+    }
+  }
+
+  gst_video_frame_unmap (&out_frame);
+  gst_video_frame_unmap (&in_frame);
+}
+
+static void
+handoff_cb (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    DecodeState * state)
+{
+  GstVideoInfo out_info;
+  GstBuffer *input;
+  GstCaps *caps;
+  GstMapInfo map;
+
+  /* frames must come out in order even when processed in parallel */
+  fail_unless (GST_BUFFER_PTS_IS_VALID (buf));
+  if (GST_CLOCK_TIME_IS_VALID (state->last_pts))
+    fail_unless (GST_BUFFER_PTS (buf) > state->last_pts);
+  state->last_pts = GST_BUFFER_PTS (buf);
+
+  /* the default encoder settings are lossless */
+  caps = gst_pad_get_current_caps (pad);
+  fail_unless (gst_video_info_from_caps (&out_info, caps));
+  gst_caps_unref (caps);
+  g_mutex_lock (&state->lock);
+  input = g_hash_table_lookup (state->inputs, &GST_BUFFER_PTS (buf));
+  fail_unless (input != NULL);
+  check_frame (&state->in_info, input, &out_info, buf);
+  g_hash_table_remove (state->inputs, &GST_BUFFER_PTS (buf));
+  g_mutex_unlock (&state->lock);
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  g_ptr_array_add (state->checksums,
+      g_compute_checksum_for_data (G_CHECKSUM_SHA1, map.data, map.size));
+  gst_buffer_unmap (buf, &map);
+}
+
+/* Encodes NUM_FRAMES frames of the given format to @codec and decodes
+ * them, checks that they decode to the input and returns the checksums of
+ * the decoded frames */
+static GPtrArray *
+run_pipeline (const gchar * format, const gchar * codec,
+    const gchar * enc_props, const gchar * dec_props)
+{
+  GstElement *pipe, *elem;
+  DecodeState state;
+  GstMessage *msg;
+  GstPad *pad;
+  GstBus *bus;
+  gint64 start, elapsed;
+  gchar *desc;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d pattern=ball ! "
+      "video/x-raw,format=%s,width=320,height=240,framerate=25/1 ! "
+      "openjpegenc name=enc %s ! %s ! openjpegdec %s ! "
+      "fakesink name=sink signal-handoffs=true sync=false", NUM_FRAMES,
+      format, enc_props, codec, dec_props);
+  pipe = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipe != NULL);
+
+  state.checksums = g_ptr_array_new_with_free_func (g_free);
+  state.last_pts = GST_CLOCK_TIME_NONE;
+  g_mutex_init (&state.lock);
+  state.inputs = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free,
+      (GDestroyNotify) gst_buffer_unref);
+  state.arrival = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free,
+      g_free);
+  state.total_latency = 0;
+  state.n_encoded = 0;
+
+  elem = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+  g_signal_connect (elem, "handoff", G_CALLBACK (handoff_cb), &state);
+  gst_object_unref (elem);
+
+  elem = gst_bin_get_by_name (GST_BIN (pipe), "enc");
+  pad = gst_element_get_static_pad (elem, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) enc_sink_probe, &state, NULL);
+  gst_object_unref (pad);
+  pad = gst_element_get_static_pad (elem, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) enc_src_probe, &state, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (elem);
+
+  start = g_get_monotonic_time ();
+  fail_if (gst_element_set_state (pipe, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  bus = gst_element_get_bus (pipe);
+  msg = gst_bus_timed_pop_filtered (bus, 60 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  elapsed = g_get_monotonic_time () - start;
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (state.n_encoded, state.checksums->len);
+  GST_INFO ("%s, openjpegenc %s, openjpegdec %s: %u frames in %"
+      G_GINT64_FORMAT " us, %.1f fps, encoding latency %" G_GINT64_FORMAT
+      " us", format, enc_props, dec_props, state.checksums->len, elapsed,
+      state.checksums->len * 1000000.0 / MAX (elapsed, 1),
+      state.total_latency / MAX (state.n_encoded, 1));
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+  g_hash_table_unref (state.arrival);
+  fail_unless_equals_int (g_hash_table_size (state.inputs), 0);
+  g_hash_table_unref (state.inputs);
+  g_mutex_clear (&state.lock);
+
+  return state.checksums;
+}
+
+static void
+check_checksums (GPtrArray * reference, GPtrArray * checksums)
+{
+  guint i;
+
+  fail_unless_equals_int (checksums->len, reference->len);
+  for (i = 0; i < reference->len; i++)
+    fail_unless_equals_string (g_ptr_array_index (checksums, i),
+        g_ptr_array_index (reference, i));
+}
+
+static void
+check_parallel_decoding (const gchar * format, const gchar * codec)
+{
+  const gchar *dec_props[] = { "max-threads=2", "max-threads=4",
+    "max-threads=0"
+  };
+  GPtrArray *reference, *checksums;
+  guint i;
+
+  reference = run_pipeline (format, codec, "max-threads=1", "max-threads=1");
+  fail_unless_equals_int (reference->len, NUM_FRAMES);
+
+  for (i = 0; i < G_N_ELEMENTS (dec_props); i++) {
+    checksums = run_pipeline (format, codec, "max-threads=1", dec_props[i]);
+    check_checksums (reference, checksums);
+    g_ptr_array_unref (checksums);
+  }
+
+  g_ptr_array_unref (reference);
+}
+
+GST_START_TEST (test_parallel_decoding_i420)
+{
+  check_parallel_decoding ("I420", "image/x-j2c");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parallel_decoding_argb)
+{
+  check_parallel_decoding ("ARGB", "image/x-j2c");
+}
+
+GST_END_TEST;
+
+/* Only image/jp2 signals that four components are YUV with alpha, the
+ * decoder then upsamples the 4:2:0 chroma to AYUV */
+GST_START_TEST (test_parallel_decoding_a420)
+{
+  check_parallel_decoding ("A420", "image/jp2");
+}
+
+GST_END_TEST;
+
+/* Encoding in stripes must decode to the same frames */
+static void
+check_parallel_encoding (const gchar * format)
+{
+  const gchar *enc_props[] = { "max-threads=4", "max-threads=0",
+    "max-threads=1 num-stripes=4", "max-threads=4 num-stripes=4",
+    "max-threads=4 num-stripes=3", "max-threads=8 num-stripes=2"
+  };
+  GPtrArray *reference, *checksums;
+  guint i;
+
+  reference = run_pipeline (format, "image/x-j2c", "max-threads=1",
+      "max-threads=1");
+  fail_unless_equals_int (reference->len, NUM_FRAMES);
+
+  for (i = 0; i < G_N_ELEMENTS (enc_props); i++) {
+    checksums = run_pipeline (format, "image/x-j2c", enc_props[i],
+        "max-threads=1");
+    check_checksums (reference, checksums);
+    g_ptr_array_unref (checksums);
+  }
+
+  g_ptr_array_unref (reference);
+}
+
+GST_START_TEST (test_parallel_encoding_i420)
+{
+  check_parallel_encoding ("I420");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parallel_encoding_argb)
+{
+  check_parallel_encoding ("ARGB");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_flush_while_processing)
+{
+  GstElement *pipe;
+  GstMessage *msg;
+  GstBus *bus;
+  guint i;
+
+  pipe = gst_parse_launch ("videotestsrc ! "
+      "video/x-raw,format=AYUV,width=320,height=240,framerate=25/1 ! "
+      "openjpegenc max-threads=4 num-stripes=2 ! openjpegdec max-threads=4 ! "
+      "fakesink", NULL);
+  fail_unless (pipe != NULL);
+
+  fail_if (gst_element_set_state (pipe, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless (gst_element_get_state (pipe, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+
+  /* flushing seeks drop the frames that are still being processed */
+  for (i = 0; i < 5; i++) {
+    fail_unless (gst_element_seek_simple (pipe, GST_FORMAT_TIME,
+            GST_SEEK_FLAG_FLUSH, i * GST_SECOND));
+    g_usleep (G_USEC_PER_SEC / 10);
+  }
+
+  bus = gst_element_get_bus (pipe);
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR);
+  fail_unless (msg == NULL);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+}
+
+GST_END_TEST;
+
+static Suite *
+openjpeg_suite (void)
+{
+  Suite *s = suite_create ("openjpeg");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_set_timeout (tc_chain, 120);
+  tcase_add_test (tc_chain, test_parallel_decoding_i420);
+  tcase_add_test (tc_chain, test_parallel_decoding_argb);
+  tcase_add_test (tc_chain, test_parallel_decoding_a420);
+  tcase_add_test (tc_chain, test_parallel_encoding_i420);
+  tcase_add_test (tc_chain, test_parallel_encoding_argb);
+  tcase_add_test (tc_chain, test_flush_while_processing);
+
+  return s;
+}
+
+GST_CHECK_MAIN (openjpeg);
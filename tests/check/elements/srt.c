@@ -0,0 +1,350 @@
+/* GStreamer unit tests for the SRT elements
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gio/gio.h>
+#include <string.h>
+
+/* the payload of a typical MPEG-TS over SRT message */
+#define PAYLOAD_SIZE 1316
+#define N_PACKETS 200
+/* receive up to ten messages into a buffer, waiting up to 50ms for them */
+#define AGGREGATE_SIZE (10 * PAYLOAD_SIZE)
+#define AGGREGATE_TIME (50 * GST_MSECOND)
+
+static GMutex lock;
+static GCond cond;
+static gint n_clients;
+
+static void
+client_added (GstElement * sink, gint sock, GSocketAddress * addr,
+    gpointer user_data)
+{
+  g_mutex_lock (&lock);
+  n_clients++;
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+}
+
+static void
+wait_for_clients (gint n)
+{
+  gint64 deadline = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&lock);
+  while (n_clients < n)
+    fail_unless (g_cond_wait_until (&cond, &lock, deadline));
+  g_mutex_unlock (&lock);
+}
+
+/* Finds a free UDP port on the loopback interface */
+static guint
+get_free_port (void)
+{
+  GSocketAddress *addr;
+  GInetAddress *loopback;
+  GSocket *socket;
+  guint port;
+
+  socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM,
+      G_SOCKET_PROTOCOL_UDP, NULL);
+  fail_unless (socket != NULL);
+  loopback = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  addr = g_inet_socket_address_new (loopback, 0);
+  fail_unless (g_socket_bind (socket, addr, FALSE, NULL));
+  g_object_unref (addr);
+  g_object_unref (loopback);
+
+  addr = g_socket_get_local_address (socket, NULL);
+  port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (addr));
+  g_object_unref (addr);
+  g_object_unref (socket);
+
+  return port;
+}
+
+static GstHarness *
+start_server_sink (guint port)
+{
+  GstElement *sink;
+  GstHarness *h;
+  gchar *desc;
+
+  n_clients = 0;
+  desc = g_strdup_printf ("srtserversink uri=srt://127.0.0.1:%u", port);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+
+  sink = gst_harness_find_element (h, "srtserversink");
+  g_signal_connect (sink, "client-added", G_CALLBACK (client_added), NULL);
+  gst_object_unref (sink);
+  gst_harness_set_src_caps_str (h, "application/x-test");
+
+  return h;
+}
+
+/* Connects a srtclientsrc to the server sink, @props are extra properties
+ * of the source */
+static GstHarness *
+start_client_src (guint port, const gchar * props)
+{
+  GstHarness *h;
+  gchar *desc;
+
+  desc = g_strdup_printf ("srtclientsrc uri=srt://127.0.0.1:%u %s", port,
+      props ? props : "");
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+
+  /* the received buffers are timestamped with the clock */
+  gst_harness_use_systemclock (h);
+  gst_harness_play (h);
+  wait_for_clients (1);
+
+  return h;
+}
+
+static GstBuffer *
+create_packet (guint i)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, PAYLOAD_SIZE, NULL);
+  GstMapInfo map;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  memset (map.data, i & 0xff, map.size);
+  GST_WRITE_UINT32_BE (map.data, i);
+  gst_buffer_unmap (buf, &map);
+
+  return buf;
+}
+
+static void
+check_packet (GstBuffer * buf, guint i)
+{
+  GstMapInfo map;
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, PAYLOAD_SIZE);
+  fail_unless_equals_int (GST_READ_UINT32_BE (map.data), i);
+  fail_unless_equals_int (map.data[map.size - 1], i & 0xff);
+  gst_buffer_unmap (buf, &map);
+}
+
+/* Checks that @buf holds the consecutive packets from @next on and returns
+ * how many */
+static guint
+check_aggregated_packets (GstBuffer * buf, guint next)
+{
+  GstMapInfo map;
+  guint i, n;
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless (map.size > 0);
+  fail_unless (map.size <= AGGREGATE_SIZE);
+  fail_unless_equals_int (map.size % PAYLOAD_SIZE, 0);
+  n = map.size / PAYLOAD_SIZE;
+  for (i = 0; i < n; i++) {
+    const guint8 *data = map.data + i * PAYLOAD_SIZE;
+
+    fail_unless_equals_int (GST_READ_UINT32_BE (data), next + i);
+    fail_unless_equals_int (data[PAYLOAD_SIZE - 1], (next + i) & 0xff);
+  }
+  gst_buffer_unmap (buf, &map);
+
+  return n;
+}
+
+/* Pushes the first half of the packets one by one and the second half as
+ * buffer lists of ten */
+static void
+push_packets (GstHarness * h)
+{
+  GstBufferList *list = NULL;
+  guint i;
+
+  for (i = 0; i < N_PACKETS / 2; i++)
+    fail_unless_equals_int (gst_harness_push (h, create_packet (i)),
+        GST_FLOW_OK);
+
+  for (; i < N_PACKETS; i++) {
+    if (list == NULL)
+      list = gst_buffer_list_new ();
+    gst_buffer_list_add (list, create_packet (i));
+    if (gst_buffer_list_length (list) == 10) {
+      fail_unless_equals_int (gst_pad_push_list (h->srcpad, list),
+          GST_FLOW_OK);
+      list = NULL;
+    }
+  }
+}
+
+static const GstStructure *
+get_client_stats (GstHarness * h, GValue * stats)
+{
+  GstElement *sink = gst_harness_find_element (h, "srtserversink");
+
+  g_value_init (stats, GST_TYPE_ARRAY);
+  g_object_get_property (G_OBJECT (sink), "stats", stats);
+  gst_object_unref (sink);
+  fail_unless_equals_int (gst_value_array_get_size (stats), 1);
+
+  return gst_value_get_structure (gst_value_array_get_value (stats, 0));
+}
+
+/* Everything the sink queued reaches the client in order, and its queue is
+ * drained without dropping anything */
+GST_START_TEST (test_server_sink_loopback)
+{
+  GstHarness *hsink, *hsrc;
+  const GstStructure *s;
+  GValue stats = G_VALUE_INIT;
+  GstBuffer *buf;
+  guint64 dropped;
+  guint i, port, backlog;
+
+  port = get_free_port ();
+  hsink = start_server_sink (port);
+  hsrc = start_client_src (port, NULL);
+
+  push_packets (hsink);
+  for (i = 0; i < N_PACKETS; i++) {
+    buf = gst_harness_pull (hsrc);
+    fail_unless (buf != NULL);
+    check_packet (buf, i);
+    gst_buffer_unref (buf);
+  }
+
+  s = get_client_stats (hsink, &stats);
+  fail_unless (gst_structure_get_uint (s, "backlog-buffers", &backlog));
+  fail_unless_equals_int (backlog, 0);
+  fail_unless (gst_structure_get_uint64 (s, "buffers-dropped", &dropped));
+  fail_unless_equals_uint64 (dropped, 0);
+  g_value_unset (&stats);
+
+  /* closing the server ends the client's blocking receive */
+  gst_harness_teardown (hsink);
+  gst_harness_teardown (hsrc);
+}
+
+GST_END_TEST;
+
+static guint
+get_blocksize (GstElement * src)
+{
+  guint blocksize;
+
+  g_object_get (src, "blocksize", &blocksize, NULL);
+  return blocksize;
+}
+
+/* Consecutive messages are received into one buffer, and the blocksize is
+ * only raised for that while the source runs */
+GST_START_TEST (test_client_src_aggregate)
+{
+  GstHarness *hsink, *hsrc;
+  GstElement *src;
+  GParamSpec *pspec;
+  const GstStructure *s;
+  GValue stats = G_VALUE_INIT;
+  GstBuffer *buf;
+  guint64 messages, buffers, bytes, max_delay;
+  gdouble per_buffer;
+  guint port, n, n_buffers, blocksize;
+  gchar *props;
+
+  port = get_free_port ();
+  hsink = start_server_sink (port);
+  props = g_strdup_printf ("aggregate-size=%u aggregate-time=%"
+      G_GUINT64_FORMAT, AGGREGATE_SIZE, AGGREGATE_TIME);
+  hsrc = start_client_src (port, props);
+  g_free (props);
+
+  src = gst_harness_find_element (hsrc, "srtclientsrc");
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (src),
+      "blocksize");
+  blocksize = g_value_get_uint (g_param_spec_get_default_value (pspec));
+  fail_unless (blocksize < AGGREGATE_SIZE);
+  fail_unless_equals_int (get_blocksize (src), AGGREGATE_SIZE);
+
+  push_packets (hsink);
+  for (n = 0, n_buffers = 0; n < N_PACKETS; n_buffers++) {
+    buf = gst_harness_pull (hsrc);
+    fail_unless (buf != NULL);
+    n += check_aggregated_packets (buf, n);
+    gst_buffer_unref (buf);
+  }
+  fail_unless_equals_int (n, N_PACKETS);
+  fail_unless (n_buffers < N_PACKETS);
+
+  g_value_init (&stats, GST_TYPE_STRUCTURE);
+  g_object_get_property (G_OBJECT (src), "stats", &stats);
+  s = gst_value_get_structure (&stats);
+  fail_unless (gst_structure_get_uint64 (s, "messages-received", &messages));
+  fail_unless_equals_uint64 (messages, N_PACKETS);
+  fail_unless (gst_structure_get_uint64 (s, "buffers-received", &buffers));
+  fail_unless_equals_uint64 (buffers, n_buffers);
+  fail_unless (gst_structure_get_uint64 (s, "bytes-received", &bytes));
+  fail_unless_equals_uint64 (bytes, N_PACKETS * PAYLOAD_SIZE);
+  fail_unless (gst_structure_get_double (s, "messages-per-buffer",
+          &per_buffer));
+  fail_unless (per_buffer > 1.0);
+  fail_unless (gst_structure_get_uint64 (s, "max-aggregation-delay-us",
+          &max_delay));
+  /* the time limit applies after the first message, with some slack */
+  fail_unless (max_delay < (AGGREGATE_TIME + 100 * GST_MSECOND) /
+      GST_USECOND);
+  fail_unless (gst_structure_has_field (s, "packets-received"));
+  g_value_unset (&stats);
+
+  /* lowering aggregate-size restores the blocksize, raising it again
+   * raises the blocksize again */
+  g_object_set (src, "aggregate-size", 0, NULL);
+  fail_unless_equals_int (get_blocksize (src), blocksize);
+  g_object_set (src, "aggregate-size", AGGREGATE_SIZE, NULL);
+  fail_unless_equals_int (get_blocksize (src), AGGREGATE_SIZE);
+
+  /* closing the server ends the client's blocking receive */
+  gst_harness_teardown (hsink);
+  fail_unless_equals_int (gst_element_set_state (src, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  fail_unless_equals_int (get_blocksize (src), blocksize);
+  gst_object_unref (src);
+  gst_harness_teardown (hsrc);
+}
+
+GST_END_TEST;
+
+static Suite *
+srt_suite (void)
+{
+  Suite *s = suite_create ("srt");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_server_sink_loopback);
+  tcase_add_test (tc_chain, test_client_src_aggregate);
+
+  return s;
+}
+
+GST_CHECK_MAIN (srt);
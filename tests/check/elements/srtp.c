@@ -207,6 +207,250 @@ GST_START_TEST (test_roc)
 
 GST_END_TEST;
 
+#define SSRC 1356955624
+#define KEY "012345678901234567890123456789012345678901234567890123456789"
+/* hmac-sha1-80 */
+#define AUTH_TAG_LEN 10
+
+/* An RTP packet whose payload only depends on @seq, allocated with
+ * @padding bytes of room after it */
+static GstBuffer *
+create_rtp_packet (guint16 seq, gsize payload_size, gsize padding)
+{
+  GstAllocationParams params;
+  GstBuffer *buf;
+  GstMapInfo map;
+  gsize i;
+
+  gst_allocation_params_init (&params);
+  params.padding = padding;
+  buf = gst_buffer_new_allocate (NULL, 12 + payload_size, &params);
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  map.data[0] = 0x80;
+  map.data[1] = 8;
+  GST_WRITE_UINT16_BE (map.data + 2, seq);
+  GST_WRITE_UINT32_BE (map.data + 4, seq * 160);
+  GST_WRITE_UINT32_BE (map.data + 8, SSRC);
+  for (i = 0; i < payload_size; i++)
+    map.data[12 + i] = (seq + i) & 0xff;
+  gst_buffer_unmap (buf, &map);
+
+  return buf;
+}
+
+static void
+check_rtp_packet (GstBuffer * buf, guint16 seq, gsize payload_size)
+{
+  GstBuffer *expected = create_rtp_packet (seq, payload_size, 0);
+  GstMapInfo map;
+
+  gst_buffer_map (expected, &map, GST_MAP_READ);
+  gst_check_buffer_data (buf, map.data, map.size);
+  gst_buffer_unmap (expected, &map);
+  gst_buffer_unref (expected);
+}
+
+static GstHarness *
+create_enc_harness (void)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_padnames ("srtpenc", "rtp_sink_0", "rtp_src_0");
+  gst_util_set_object_arg (G_OBJECT (h->element), "key", KEY);
+  gst_harness_set_src_caps_str (h, "application/x-rtp, payload=(int)8, "
+      "ssrc=(uint)1356955624");
+
+  return h;
+}
+
+static GstHarness *
+create_dec_harness (void)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_padnames ("srtpdec", "rtp_sink", "rtp_src");
+  gst_harness_set_src_caps (h, request_key ());
+
+  return h;
+}
+
+/* Protects packets @first to @first + @n - 1 as one buffer list */
+static void
+push_rtp_list (GstHarness * h, guint16 first, guint n, gsize payload_size)
+{
+  GstBufferList *list = gst_buffer_list_new ();
+  guint i;
+
+  for (i = 0; i < n; i++)
+    gst_buffer_list_add (list, create_rtp_packet (first + i, payload_size,
+            0));
+  fail_unless_equals_int (gst_pad_push_list (h->srcpad, list), GST_FLOW_OK);
+}
+
+#define N_PACKETS 16
+#define PAYLOAD_SIZE 160
+
+GST_START_TEST (test_buffer_list_roundtrip)
+{
+  GstHarness *enc, *dec;
+  GstBufferList *list;
+  GstBuffer *buf;
+  guint i;
+
+  enc = create_enc_harness ();
+  dec = create_dec_harness ();
+
+  push_rtp_list (enc, 0, N_PACKETS, PAYLOAD_SIZE);
+
+  list = gst_buffer_list_new ();
+  for (i = 0; i < N_PACKETS; i++) {
+    buf = gst_harness_pull (enc);
+    fail_unless_equals_int (gst_buffer_get_size (buf),
+        12 + PAYLOAD_SIZE + AUTH_TAG_LEN);
+    gst_buffer_list_add (list, buf);
+  }
+  fail_unless_equals_int (gst_pad_push_list (dec->srcpad, list), GST_FLOW_OK);
+
+  for (i = 0; i < N_PACKETS; i++) {
+    buf = gst_harness_pull (dec);
+    check_rtp_packet (buf, i, PAYLOAD_SIZE);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (enc);
+  gst_harness_teardown (dec);
+}
+
+GST_END_TEST;
+
+/* Packets with room for the trailer are protected in place, others are
+ * copied into pooled buffers or, if too large for those, new ones */
+GST_START_TEST (test_enc_in_place_and_pooled)
+{
+  GstHarness *enc, *dec;
+  GstAllocationParams params;
+  GstQuery *query;
+  GstMemory *mem;
+  GstBuffer *buf, *outbuf;
+  GstCaps *caps;
+
+  enc = create_enc_harness ();
+  dec = create_dec_harness ();
+
+  /* upstream is asked to leave that room */
+  caps = gst_caps_from_string ("application/x-rtp");
+  query = gst_query_new_allocation (caps, TRUE);
+  gst_caps_unref (caps);
+  fail_unless (gst_pad_peer_query (enc->srcpad, query));
+  fail_unless (gst_query_get_n_allocation_params (query) > 0);
+  gst_query_parse_nth_allocation_param (query, 0, NULL, &params);
+  fail_unless (params.padding > AUTH_TAG_LEN);
+  gst_query_unref (query);
+
+  buf = create_rtp_packet (0, PAYLOAD_SIZE, params.padding);
+  mem = gst_buffer_peek_memory (buf, 0);
+  fail_unless_equals_int (gst_harness_push (enc, buf), GST_FLOW_OK);
+  outbuf = gst_harness_pull (enc);
+  fail_unless (gst_buffer_peek_memory (outbuf, 0) == mem);
+  fail_unless_equals_int (gst_harness_push (dec, outbuf), GST_FLOW_OK);
+
+  /* kept by us, so not writable */
+  buf = create_rtp_packet (1, PAYLOAD_SIZE, params.padding);
+  fail_unless_equals_int (gst_harness_push (enc, gst_buffer_ref (buf)),
+      GST_FLOW_OK);
+  outbuf = gst_harness_pull (enc);
+  fail_if (gst_buffer_peek_memory (outbuf, 0) ==
+      gst_buffer_peek_memory (buf, 0));
+  fail_unless (outbuf->pool != NULL);
+  check_rtp_packet (buf, 1, PAYLOAD_SIZE);
+  gst_buffer_unref (buf);
+  fail_unless_equals_int (gst_harness_push (dec, outbuf), GST_FLOW_OK);
+
+  /* no room at all */
+  fail_unless_equals_int (gst_harness_push (enc, create_rtp_packet (2,
+              PAYLOAD_SIZE, 0)), GST_FLOW_OK);
+  outbuf = gst_harness_pull (enc);
+  fail_unless (outbuf->pool != NULL);
+  fail_unless_equals_int (gst_harness_push (dec, outbuf), GST_FLOW_OK);
+
+  /* larger than the pooled buffers */
+  fail_unless_equals_int (gst_harness_push (enc, create_rtp_packet (3,
+              2000, 0)), GST_FLOW_OK);
+  outbuf = gst_harness_pull (enc);
+  fail_unless (outbuf->pool == NULL);
+  fail_unless_equals_int (gst_buffer_get_size (outbuf),
+      12 + 2000 + AUTH_TAG_LEN);
+  fail_unless_equals_int (gst_harness_push (dec, outbuf), GST_FLOW_OK);
+
+  /* all of them decode to the original packets */
+  buf = gst_harness_pull (dec);
+  check_rtp_packet (buf, 0, PAYLOAD_SIZE);
+  gst_buffer_unref (buf);
+  buf = gst_harness_pull (dec);
+  check_rtp_packet (buf, 1, PAYLOAD_SIZE);
+  gst_buffer_unref (buf);
+  buf = gst_harness_pull (dec);
+  check_rtp_packet (buf, 2, PAYLOAD_SIZE);
+  gst_buffer_unref (buf);
+  buf = gst_harness_pull (dec);
+  check_rtp_packet (buf, 3, 2000);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (enc);
+  gst_harness_teardown (dec);
+}
+
+GST_END_TEST;
+
+/* Protected buffers that are not writable are copied before unprotecting,
+ * and the copy is what comes out, not the protected original */
+GST_START_TEST (test_dec_not_writable)
+{
+  GstHarness *enc, *dec;
+  GstBuffer *protected[2], *copies[2], *buf;
+  GstBufferList *list;
+  GstMapInfo map;
+  guint i;
+
+  enc = create_enc_harness ();
+  dec = create_dec_harness ();
+
+  push_rtp_list (enc, 0, 2, PAYLOAD_SIZE);
+  for (i = 0; i < 2; i++) {
+    protected[i] = gst_harness_pull (enc);
+    copies[i] = gst_buffer_copy_deep (protected[i]);
+  }
+
+  fail_unless_equals_int (gst_harness_push (dec,
+          gst_buffer_ref (protected[0])), GST_FLOW_OK);
+  buf = gst_harness_pull (dec);
+  check_rtp_packet (buf, 0, PAYLOAD_SIZE);
+  gst_buffer_unref (buf);
+
+  /* and the same for buffer lists */
+  list = gst_buffer_list_new ();
+  gst_buffer_list_add (list, gst_buffer_ref (protected[1]));
+  fail_unless_equals_int (gst_pad_push_list (dec->srcpad, list), GST_FLOW_OK);
+  buf = gst_harness_pull (dec);
+  check_rtp_packet (buf, 1, PAYLOAD_SIZE);
+  gst_buffer_unref (buf);
+
+  /* the originals were left alone */
+  for (i = 0; i < 2; i++) {
+    gst_buffer_map (copies[i], &map, GST_MAP_READ);
+    gst_check_buffer_data (protected[i], map.data, map.size);
+    gst_buffer_unmap (copies[i], &map);
+    gst_buffer_unref (copies[i]);
+    gst_buffer_unref (protected[i]);
+  }
+
+  gst_harness_teardown (enc);
+  gst_harness_teardown (dec);
+}
+
+GST_END_TEST;
+
 static Suite *
 srtp_suite (void)
 {
@@ -218,6 +462,9 @@ srtp_suite (void)
   tcase_add_test (tc_chain, test_create_and_unref);
   tcase_add_test (tc_chain, test_play);
   tcase_add_test (tc_chain, test_roc);
+  tcase_add_test (tc_chain, test_buffer_list_roundtrip);
+  tcase_add_test (tc_chain, test_enc_in_place_and_pooled);
+  tcase_add_test (tc_chain, test_dec_not_writable);
 
   return s;
 }
@@ -1199,6 +1199,156 @@ GST_START_TEST (test_session_stats)
 
 GST_END_TEST;
 
+GST_START_TEST (test_session_stats_snapshot)
+{
+  struct test_webrtc *t = test_webrtc_new ();
+  const GstStructure *reply;
+  GstPromise *p;
+
+  /* only the selected type of stats */
+  p = gst_promise_new ();
+  g_signal_emit_by_name (t->webrtc1, "get-stats-snapshot", NULL,
+      1 << GST_WEBRTC_STATS_PEER_CONNECTION, FALSE, p);
+  fail_unless_equals_int (gst_promise_wait (p), GST_PROMISE_RESULT_REPLIED);
+  reply = gst_promise_get_reply (p);
+  validate_stats (reply);
+  fail_unless_equals_int (gst_structure_n_fields (reply), 1);
+  fail_unless (gst_structure_has_field (reply, "peer-connection-stats"));
+  gst_promise_unref (p);
+
+  /* nothing changed since the previous snapshot */
+  p = gst_promise_new ();
+  g_signal_emit_by_name (t->webrtc1, "get-stats-snapshot", NULL, 0, TRUE, p);
+  fail_unless_equals_int (gst_promise_wait (p), GST_PROMISE_RESULT_REPLIED);
+  reply = gst_promise_get_reply (p);
+  fail_unless_equals_int (gst_structure_n_fields (reply), 0);
+  gst_promise_unref (p);
+
+  /* but everything is still there when asking for all of it */
+  p = gst_promise_new ();
+  g_signal_emit_by_name (t->webrtc1, "get-stats-snapshot", NULL, 0, FALSE, p);
+  fail_unless_equals_int (gst_promise_wait (p), GST_PROMISE_RESULT_REPLIED);
+  reply = gst_promise_get_reply (p);
+  validate_stats (reply);
+  fail_unless (gst_structure_has_field (reply, "peer-connection-stats"));
+  gst_promise_unref (p);
+
+  test_webrtc_free (t);
+}
+
+GST_END_TEST;
+
+static GstStructure *
+_get_stats_snapshot (GstElement * webrtc, guint types, gboolean only_changed)
+{
+  GstStructure *reply;
+  GstPromise *p;
+
+  p = gst_promise_new ();
+  g_signal_emit_by_name (webrtc, "get-stats-snapshot", NULL, types,
+      only_changed, p);
+  fail_unless_equals_int (gst_promise_wait (p), GST_PROMISE_RESULT_REPLIED);
+  reply = gst_structure_copy (gst_promise_get_reply (p));
+  gst_promise_unref (p);
+
+  return reply;
+}
+
+static gboolean
+_has_field_with_prefix (const GstStructure * s, const gchar * prefix)
+{
+  gint i;
+
+  for (i = 0; i < gst_structure_n_fields (s); i++) {
+    if (g_str_has_prefix (gst_structure_nth_field_name (s, i), prefix))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static void
+_on_periodic_stats (GstElement * webrtc, const GstStructure * stats,
+    struct test_webrtc *t)
+{
+  g_mutex_lock (&t->lock);
+  if (t->user_data)
+    gst_structure_free (t->user_data);
+  t->user_data = gst_structure_copy (stats);
+  g_cond_broadcast (&t->cond);
+  g_mutex_unlock (&t->lock);
+}
+
+GST_START_TEST (test_session_stats_snapshot_types)
+{
+  struct test_webrtc *t = test_webrtc_new ();
+  GstStructure *stats;
+  GstHarness *h;
+
+  t->on_negotiation_needed = NULL;
+  t->on_pad_added = _pad_added_fakesink;
+  t->on_offer_created = NULL;
+  t->on_answer_created = NULL;
+  t->on_ice_candidate = NULL;
+  t->data_notify = (GDestroyNotify) gst_structure_free;
+
+  /* start from a baseline for both types, before there is any stream */
+  stats = _get_stats_snapshot (t->webrtc1, 1 << GST_WEBRTC_STATS_CODEC, TRUE);
+  fail_unless_equals_int (gst_structure_n_fields (stats), 0);
+  gst_structure_free (stats);
+  stats = _get_stats_snapshot (t->webrtc1, 1 << GST_WEBRTC_STATS_TRANSPORT,
+      TRUE);
+  fail_unless_equals_int (gst_structure_n_fields (stats), 0);
+  gst_structure_free (stats);
+
+  h = gst_harness_new_with_element (t->webrtc1, "sink_0", NULL);
+  add_fake_audio_src_harness (h, 96);
+  t->harnesses = g_list_prepend (t->harnesses, h);
+
+  g_signal_connect (t->webrtc1, "on-stats", G_CALLBACK (_on_periodic_stats),
+      t);
+  g_object_set (t->webrtc1, "stats-interval", 50, NULL);
+
+  /* the new pad added the codec stats, negotiating adds the transport */
+  test_webrtc_create_offer (t, t->webrtc1);
+  test_webrtc_wait_for_answer_error_eos (t);
+  fail_unless_equals_int (STATE_ANSWER_CREATED, t->state);
+
+  /* the periodic reports have their own baselines */
+  g_mutex_lock (&t->lock);
+  while (!t->user_data
+      || !_has_field_with_prefix (t->user_data, "transport-stats_"))
+    g_cond_wait (&t->cond, &t->lock);
+  validate_stats (t->user_data);
+  g_mutex_unlock (&t->lock);
+  g_object_set (t->webrtc1, "stats-interval", 0, NULL);
+
+  /* querying the codec stats must not hide the changed transport stats
+   * from the next query of those */
+  stats = _get_stats_snapshot (t->webrtc1, 1 << GST_WEBRTC_STATS_CODEC, TRUE);
+  validate_stats (stats);
+  fail_unless (gst_structure_has_field (stats, "codec-stats-sink_0"));
+  fail_if (_has_field_with_prefix (stats, "transport-stats_"));
+  gst_structure_free (stats);
+
+  stats = _get_stats_snapshot (t->webrtc1, 1 << GST_WEBRTC_STATS_TRANSPORT,
+      TRUE);
+  validate_stats (stats);
+  fail_unless (_has_field_with_prefix (stats, "transport-stats_"));
+  fail_if (gst_structure_has_field (stats, "codec-stats-sink_0"));
+  gst_structure_free (stats);
+
+  /* both are reported now */
+  stats = _get_stats_snapshot (t->webrtc1,
+      (1 << GST_WEBRTC_STATS_CODEC) | (1 << GST_WEBRTC_STATS_TRANSPORT), TRUE);
+  fail_unless_equals_int (gst_structure_n_fields (stats), 0);
+  gst_structure_free (stats);
+
+  test_webrtc_free (t);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_add_transceiver)
 {
   struct test_webrtc *t = test_webrtc_new ();
@@ -1358,11 +1508,13 @@ webrtcbin_suite (void)
   tcase_add_test (tc, test_no_nice_elements_request_pad);
   tcase_add_test (tc, test_no_nice_elements_state_change);
   tcase_add_test (tc, test_session_stats);
+  tcase_add_test (tc, test_session_stats_snapshot);
   if (nicesrc && nicesink) {
     tcase_add_test (tc, test_audio);
     tcase_add_test (tc, test_audio_video);
     tcase_add_test (tc, test_media_direction);
     tcase_add_test (tc, test_media_setup);
+    tcase_add_test (tc, test_session_stats_snapshot_types);
     tcase_add_test (tc, test_add_transceiver);
     tcase_add_test (tc, test_get_transceivers);
     tcase_add_test (tc, test_add_recvonly_transceiver);
@@ -0,0 +1,265 @@
+/* GStreamer unit tests for the y4mdec element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define FPS 25
+#define N_FRAMES 10
+/* 16x8 I420, packed as in the file */
+#define FRAME_SIZE (16 * 8 * 3 / 2)
+#define FRAME_DURATION (GST_SECOND / FPS)
+
+/* The temporary file of the current test, removed after it */
+static gchar *filename;
+
+static void
+remove_y4m_file (void)
+{
+  if (filename) {
+    g_unlink (filename);
+    g_free (filename);
+    filename = NULL;
+  }
+}
+
+/* Writes a file where every byte of frame i is i, and every third frame has
+ * parameters in its FRAME header, so frames are not all the same size */
+static void
+create_y4m_file (void)
+{
+  GString *s;
+  gint fd, i, j;
+
+  fd = g_file_open_tmp ("y4mdec-XXXXXX.y4m", &filename, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+
+  s = g_string_new ("YUV4MPEG2 W16 H8 F25:1 Ip A1:1 C420\n");
+  for (i = 0; i < N_FRAMES; i++) {
+    if (i % 3 == 1)
+      g_string_append_printf (s, "FRAME Ip XFRAME=%d\n", i);
+    else
+      g_string_append (s, "FRAME\n");
+    for (j = 0; j < FRAME_SIZE; j++)
+      g_string_append_c (s, i);
+  }
+  fail_unless (g_file_set_contents (filename, s->str, s->len, NULL));
+  g_string_free (s, TRUE);
+}
+
+typedef struct
+{
+  GMutex lock;
+  GPtrArray *buffers;
+} Frames;
+
+static void
+handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    Frames * frames)
+{
+  g_mutex_lock (&frames->lock);
+  g_ptr_array_add (frames->buffers, gst_buffer_ref (buffer));
+  g_mutex_unlock (&frames->lock);
+}
+
+/* With @push a queue keeps the decoder from reading in pull mode */
+static GstElement *
+create_pipeline (gboolean push, Frames * frames)
+{
+  GstElement *pipe, *sink;
+  gchar *desc;
+
+  desc = g_strdup_printf ("filesrc location=%s ! %s y4mdec name=dec ! "
+      "fakesink name=sink sync=false signal-handoffs=true", filename,
+      push ? "queue !" : "");
+  pipe = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipe != NULL);
+
+  g_mutex_init (&frames->lock);
+  frames->buffers = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_buffer_unref);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff), frames);
+  gst_object_unref (sink);
+
+  return pipe;
+}
+
+static void
+free_pipeline (GstElement * pipe, Frames * frames)
+{
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+  g_ptr_array_unref (frames->buffers);
+  g_mutex_clear (&frames->lock);
+}
+
+static GstPadMode
+get_sink_pad_mode (GstElement * pipe)
+{
+  GstElement *dec;
+  GstPad *pad;
+  GstPadMode mode;
+
+  dec = gst_bin_get_by_name (GST_BIN (pipe), "dec");
+  pad = gst_element_get_static_pad (dec, "sink");
+  mode = GST_PAD_MODE (pad);
+  gst_object_unref (pad);
+  gst_object_unref (dec);
+
+  return mode;
+}
+
+static void
+play_to_eos (GstElement * pipe)
+{
+  GstMessage *msg;
+  GstBus *bus;
+
+  fail_if (gst_element_set_state (pipe, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (pipe);
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+/* Checks that the frames from @first to the end of the file were received,
+ * with their timestamps and content */
+static void
+check_frames (Frames * frames, gint first)
+{
+  guint8 expected[FRAME_SIZE];
+  guint i;
+
+  g_mutex_lock (&frames->lock);
+  fail_unless_equals_int (frames->buffers->len, N_FRAMES - first);
+  for (i = 0; i < frames->buffers->len; i++) {
+    GstBuffer *buf = g_ptr_array_index (frames->buffers, i);
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf),
+        (first + i) * FRAME_DURATION);
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (buf), FRAME_DURATION);
+    memset (expected, first + i, FRAME_SIZE);
+    gst_check_buffer_data (buf, expected, FRAME_SIZE);
+  }
+  g_ptr_array_set_size (frames->buffers, 0);
+  g_mutex_unlock (&frames->lock);
+}
+
+GST_START_TEST (test_pull_mode)
+{
+  GstElement *pipe;
+  Frames frames;
+
+  create_y4m_file ();
+  pipe = create_pipeline (FALSE, &frames);
+  play_to_eos (pipe);
+  fail_unless_equals_int (get_sink_pad_mode (pipe), GST_PAD_MODE_PULL);
+  check_frames (&frames, 0);
+
+  free_pipeline (pipe, &frames);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_push_mode)
+{
+  GstElement *pipe;
+  Frames frames;
+
+  create_y4m_file ();
+  pipe = create_pipeline (TRUE, &frames);
+  play_to_eos (pipe);
+  fail_unless_equals_int (get_sink_pad_mode (pipe), GST_PAD_MODE_PUSH);
+  check_frames (&frames, 0);
+
+  free_pipeline (pipe, &frames);
+}
+
+GST_END_TEST;
+
+/* Seeks to frame @n in PAUSED and plays from there to the end */
+static void
+seek_and_play (GstElement * pipe, Frames * frames, gint n)
+{
+  fail_if (gst_element_set_state (pipe, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless (gst_element_get_state (pipe, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+  g_mutex_lock (&frames->lock);
+  g_ptr_array_set_size (frames->buffers, 0);
+  g_mutex_unlock (&frames->lock);
+
+  fail_unless (gst_element_seek (pipe, 1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, GST_SEEK_TYPE_SET,
+          n * FRAME_DURATION, GST_SEEK_TYPE_NONE, -1));
+  fail_unless (gst_element_get_state (pipe, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+  play_to_eos (pipe);
+}
+
+/* Seeks past what was indexed read the FRAME headers up to the target,
+ * seeks back use the index */
+GST_START_TEST (test_pull_mode_seek)
+{
+  const gint targets[] = { 7, 2, 9, 4, 0 };
+  GstElement *pipe;
+  Frames frames;
+  guint i;
+
+  create_y4m_file ();
+  pipe = create_pipeline (FALSE, &frames);
+
+  for (i = 0; i < G_N_ELEMENTS (targets); i++) {
+    seek_and_play (pipe, &frames, targets[i]);
+    check_frames (&frames, targets[i]);
+  }
+
+  free_pipeline (pipe, &frames);
+}
+
+GST_END_TEST;
+
+static Suite *
+y4mdec_suite (void)
+{
+  Suite *s = suite_create ("y4mdec");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, NULL, remove_y4m_file);
+  tcase_add_test (tc_chain, test_pull_mode);
+  tcase_add_test (tc_chain, test_push_mode);
+  tcase_add_test (tc_chain, test_pull_mode_seek);
+
+  return s;
+}
+
+GST_CHECK_MAIN (y4mdec);
@@ -20,6 +20,7 @@
  */
 #include <gst/check/gstcheck.h>
 #include <gst/codecparsers/gsth264parser.h>
+#include <string.h>
 
 static guint8 slice_dpa[] = {
   0x00, 0x00, 0x01, 0x02, 0x00, 0x02, 0x01, 0x03, 0x00,
@@ -144,6 +145,15 @@ static guint8 slice_eoseq_slice[] = {
   0x00, 0x00, 0x00, 0x01, 0x0b
 };
 
+/* SPS and PPS, as repeated in front of every IDR in broadcast streams */
+static guint8 sps_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x67, 0x4d, 0x40, 0x15,
+  0xec, 0xa4, 0xbf, 0x2e, 0x02, 0x20, 0x00, 0x00,
+  0x03, 0x00, 0x2e, 0xe6, 0xb2, 0x80, 0x01, 0xe2,
+  0xc5, 0xb2, 0xc0,
+  0x00, 0x00, 0x00, 0x01, 0x68, 0xeb, 0xec, 0xb2
+};
+
 GST_START_TEST (test_h264_parse_slice_dpa)
 {
   GstH264ParserResult res;
@@ -211,6 +221,85 @@ GST_START_TEST (test_h264_parse_slice_eoseq_slice)
 
 GST_END_TEST;
 
+/* Byte-identical repeats are answered from the stored parameter sets, which
+ * is observed by altering the stored ones. Any other bytes are parsed */
+GST_START_TEST (test_h264_parse_repeated_sps_pps)
+{
+  GstH264ParserResult res;
+  GstH264NalUnit sps_nalu, pps_nalu;
+  GstH264SPS sps, sps2;
+  GstH264PPS pps, pps2;
+  guint8 changed[sizeof (sps_pps)];
+  GstH264NalParser *const parser = gst_h264_nal_parser_new ();
+
+  res = gst_h264_parser_identify_nalu (parser, sps_pps, 0, sizeof (sps_pps),
+      &sps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (sps_nalu.type, GST_H264_NAL_SPS);
+
+  res = gst_h264_parser_identify_nalu_unchecked (parser, sps_pps,
+      sps_nalu.offset + sps_nalu.size, sizeof (sps_pps), &pps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (pps_nalu.type, GST_H264_NAL_PPS);
+
+  res = gst_h264_parser_parse_sps (parser, &sps_nalu, &sps, TRUE);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (sps.level_idc, 0x15);
+  res = gst_h264_parser_parse_pps (parser, &pps_nalu, &pps);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+
+  /* the repeat yields the stored sets without parsing them again */
+  parser->sps[sps.id].width = sps.width + 16;
+  res = gst_h264_parser_parse_sps (parser, &sps_nalu, &sps2, TRUE);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (sps2.id, sps.id);
+  assert_equals_int (sps2.width, sps.width + 16);
+  assert_equals_int (sps2.height, sps.height);
+  fail_unless (parser->last_sps == &parser->sps[sps.id]);
+  gst_h264_sps_clear (&sps2);
+
+  parser->pps[pps.id].num_ref_idx_l0_active_minus1 =
+      pps.num_ref_idx_l0_active_minus1 + 1;
+  res = gst_h264_parser_parse_pps (parser, &pps_nalu, &pps2);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (pps2.id, pps.id);
+  assert_equals_int (pps2.num_ref_idx_l0_active_minus1,
+      pps.num_ref_idx_l0_active_minus1 + 1);
+  assert_equals_int (pps2.entropy_coding_mode_flag,
+      pps.entropy_coding_mode_flag);
+  fail_unless (parser->last_pps == &parser->pps[pps.id]);
+  gst_h264_pps_clear (&pps2);
+
+  /* a single changed byte, the level, is parsed */
+  memcpy (changed, sps_pps, sizeof (sps_pps));
+  changed[sps_nalu.offset + 3] = 0x1e;
+  res = gst_h264_parser_identify_nalu (parser, changed, 0, sizeof (changed),
+      &sps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  res = gst_h264_parser_parse_sps (parser, &sps_nalu, &sps2, TRUE);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (sps2.level_idc, 0x1e);
+  assert_equals_int (sps2.width, sps.width);
+  assert_equals_int (parser->sps[sps.id].width, sps.width);
+  gst_h264_sps_clear (&sps2);
+
+  /* and the unchanged PPS is parsed again against the new SPS */
+  res = gst_h264_parser_identify_nalu_unchecked (parser, changed,
+      sps_nalu.offset + sps_nalu.size, sizeof (changed), &pps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  res = gst_h264_parser_parse_pps (parser, &pps_nalu, &pps2);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (pps2.num_ref_idx_l0_active_minus1,
+      pps.num_ref_idx_l0_active_minus1);
+  gst_h264_pps_clear (&pps2);
+
+  gst_h264_sps_clear (&sps);
+  gst_h264_pps_clear (&pps);
+  gst_h264_nal_parser_free (parser);
+}
+
+GST_END_TEST;
+
 static Suite *
 h264parser_suite (void)
 {
@@ -221,6 +310,7 @@ h264parser_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_h264_parse_slice_dpa);
   tcase_add_test (tc_chain, test_h264_parse_slice_eoseq_slice);
+  tcase_add_test (tc_chain, test_h264_parse_repeated_sps_pps);
 
   return s;
 }
@@ -430,6 +430,160 @@ GST_START_TEST (test_mpegts_atsc_stt)
 GST_END_TEST;
 
 
+static GstMpegtsSection *
+new_section (guint16 pid, const guint8 * data, gsize size)
+{
+  GstMpegtsSection *section;
+
+  section = gst_mpegts_section_new (pid, g_memdup (data, size), size);
+  fail_if (section == NULL);
+
+  return section;
+}
+
+/* Identical sections in a cache share their parsed table, others don't */
+GST_START_TEST (test_mpegts_section_cache)
+{
+  GstMpegtsSectionCache *cache;
+  GstMpegtsSection *section1, *section2, *bad_section;
+  const GstMpegtsSDT *sdt1, *sdt2;
+  guint8 *data;
+
+  cache = gst_mpegts_section_cache_new (16);
+
+  section1 = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  fail_if (gst_mpegts_section_cache_add (cache, section1));
+  sdt1 = gst_mpegts_section_get_sdt (section1);
+  fail_if (sdt1 == NULL);
+
+  section2 = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  fail_unless (gst_mpegts_section_cache_add (cache, section2));
+  sdt2 = gst_mpegts_section_get_sdt (section2);
+  fail_unless (sdt1 == sdt2);
+
+  /* The shared table stays valid as long as one of the sections, even
+   * after the cache is gone */
+  gst_mpegts_section_unref (section1);
+  gst_mpegts_section_cache_free (cache);
+  fail_unless (sdt2->services->len == 2);
+  fail_unless (sdt2->transport_stream_id == 0x1FFF);
+  gst_mpegts_section_unref (section2);
+
+  /* Same headers and CRC field, but different contents */
+  cache = gst_mpegts_section_cache_new (16);
+  section1 = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  fail_if (gst_mpegts_section_cache_add (cache, section1));
+  fail_if (gst_mpegts_section_get_sdt (section1) == NULL);
+  data = g_memdup (sdt_data_check, sizeof (sdt_data_check));
+  data[sizeof (sdt_data_check) - 6]++;
+  bad_section = gst_mpegts_section_new (0x11, data, sizeof (sdt_data_check));
+  fail_if (bad_section == NULL);
+  fail_if (gst_mpegts_section_cache_add (cache, bad_section));
+  fail_unless (gst_mpegts_section_get_sdt (bad_section) == NULL);
+
+  /* Sections not added to the cache are parsed on their own */
+  section2 = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  sdt2 = gst_mpegts_section_get_sdt (section2);
+  fail_if (sdt2 == NULL);
+  fail_if (sdt2 == gst_mpegts_section_get_sdt (section1));
+
+  gst_mpegts_section_unref (section2);
+  gst_mpegts_section_unref (bad_section);
+  gst_mpegts_section_unref (section1);
+  gst_mpegts_section_cache_free (cache);
+}
+
+GST_END_TEST;
+
+/* The least recently used section goes when the cache is full */
+GST_START_TEST (test_mpegts_section_cache_eviction)
+{
+  GstMpegtsSectionCache *cache;
+  GstMpegtsSection *sdt, *nit, *pmt, *section;
+
+  cache = gst_mpegts_section_cache_new (2);
+
+  sdt = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  fail_if (gst_mpegts_section_cache_add (cache, sdt));
+  nit = new_section (0x10, nit_data_check, sizeof (nit_data_check));
+  fail_if (gst_mpegts_section_cache_add (cache, nit));
+
+  /* makes the SDT the most recently used one */
+  section = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  fail_unless (gst_mpegts_section_cache_add (cache, section));
+  gst_mpegts_section_unref (section);
+
+  /* evicts the NIT */
+  pmt = new_section (0x30, pmt_data_check, sizeof (pmt_data_check));
+  fail_if (gst_mpegts_section_cache_add (cache, pmt));
+  section = new_section (0x10, nit_data_check, sizeof (nit_data_check));
+  fail_if (gst_mpegts_section_cache_add (cache, section));
+  gst_mpegts_section_unref (section);
+
+  /* which evicted the SDT in turn */
+  section = new_section (0x30, pmt_data_check, sizeof (pmt_data_check));
+  fail_unless (gst_mpegts_section_cache_add (cache, section));
+  gst_mpegts_section_unref (section);
+  section = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  fail_if (gst_mpegts_section_cache_add (cache, section));
+  gst_mpegts_section_unref (section);
+
+  /* the evicted sections are still usable */
+  fail_if (gst_mpegts_section_get_sdt (sdt) == NULL);
+  fail_if (gst_mpegts_section_get_nit (nit) == NULL);
+
+  gst_mpegts_section_cache_free (cache);
+  gst_mpegts_section_unref (sdt);
+  gst_mpegts_section_unref (nit);
+  gst_mpegts_section_unref (pmt);
+}
+
+GST_END_TEST;
+
+static gint other_parsed_freed;
+
+static void
+free_other_parsed (gpointer parsed)
+{
+  other_parsed_freed++;
+  g_free (parsed);
+}
+
+/* A cached section holding what another parser made of the same data is
+ * not shared */
+GST_START_TEST (test_mpegts_section_cache_other_parser)
+{
+  GstMpegtsSectionCache *cache;
+  GstMpegtsSection *section1, *section2;
+  const GstMpegtsSDT *sdt;
+  gpointer other;
+
+  cache = gst_mpegts_section_cache_new (16);
+  other_parsed_freed = 0;
+
+  section1 = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  fail_if (gst_mpegts_section_cache_add (cache, section1));
+  other = g_strdup ("parsed elsewhere");
+  section1->cached_parsed = other;
+  section1->destroy_parsed = free_other_parsed;
+
+  section2 = new_section (0x11, sdt_data_check, sizeof (sdt_data_check));
+  fail_unless (gst_mpegts_section_cache_add (cache, section2));
+  sdt = gst_mpegts_section_get_sdt (section2);
+  fail_if (sdt == NULL);
+  fail_if ((gpointer) sdt == other);
+  fail_unless (sdt->services->len == 2);
+
+  /* each section frees only what it parsed itself */
+  gst_mpegts_section_cache_free (cache);
+  gst_mpegts_section_unref (section2);
+  fail_unless_equals_int (other_parsed_freed, 0);
+  gst_mpegts_section_unref (section1);
+  fail_unless_equals_int (other_parsed_freed, 1);
+}
+
+GST_END_TEST;
+
 static const guint8 registration_descriptor[] = {
   0x05, 0x04, 0x48, 0x44, 0x4d, 0x56
 };
@@ -575,6 +729,9 @@ mpegts_suite (void)
   tcase_add_test (tc_chain, test_mpegts_nit);
   tcase_add_test (tc_chain, test_mpegts_sdt);
   tcase_add_test (tc_chain, test_mpegts_atsc_stt);
+  tcase_add_test (tc_chain, test_mpegts_section_cache);
+  tcase_add_test (tc_chain, test_mpegts_section_cache_eviction);
+  tcase_add_test (tc_chain, test_mpegts_section_cache_other_parser);
   tcase_add_test (tc_chain, test_mpegts_descriptors);
   tcase_add_test (tc_chain, test_mpegts_dvb_descriptors);
 
@@ -21,6 +21,10 @@
 #include <gst/check/gstcheck.h>
 #include <gst/codecparsers/gstvp8parser.h>
 
+/* for the bool decoder, which is internal to the library */
+#include "../../gst-libs/gst/codecparsers/dboolhuff.c"
+#include "../../gst-libs/gst/codecparsers/vp8utils.c"
+
 /* A key frame data */
 static const guint8 vp8_frame_data_0[] = {
   0x50, 0x1d, 0x00, 0x9d, 0x01, 0x2a, 0xb0, 0x00, 0x90, 0x00, 0x00, 0x07,
@@ -211,6 +215,58 @@ GST_START_TEST (test_vp8_parse_inter_frame)
 
 GST_END_TEST;
 
+/* With a decrypt callback the bool decoder fills byte by byte, without it
+ * it takes the word load fast path whenever enough input is left. Both
+ * have to decode the same bits and leave the same state. */
+static void
+identity_decrypt (void *state, const unsigned char *input,
+    unsigned char *output, int count)
+{
+  memcpy (output, input, count);
+}
+
+GST_START_TEST (test_vp8_bool_decoder_fill)
+{
+  GRand *rand = g_rand_new_with_seed (0x5eed);
+  guint8 data[80];
+  gint iter;
+
+  for (iter = 0; iter < 2000; iter++) {
+    BOOL_DECODER fast, bytewise;
+    guint offset = g_rand_int_range (rand, 0, 8);
+    guint size = g_rand_int_range (rand, 0, sizeof (data) - offset + 1);
+    guint n_bools = size * 8 + g_rand_int_range (rand, 0, 64);
+    guint i;
+
+    for (i = 0; i < sizeof (data); i++)
+      data[i] = g_rand_int (rand);
+    /* runs of 0x00 and 0xff bytes keep the range from renormalizing */
+    if (iter % 4 == 0)
+      memset (data + offset, (iter & 4) ? 0xff : 0x00, size / 2);
+
+    fail_if (vp8dx_start_decode (&fast, data + offset, size, NULL, NULL));
+    fail_if (vp8dx_start_decode (&bytewise, data + offset, size,
+            identity_decrypt, NULL));
+
+    for (i = 0; i < n_bools; i++) {
+      gint prob = g_rand_int_range (rand, 1, 256);
+
+      assert_equals_int (vp8dx_decode_bool (&fast, prob),
+          vp8dx_decode_bool (&bytewise, prob));
+      fail_unless (fast.value == bytewise.value);
+      assert_equals_int (fast.count, bytewise.count);
+      assert_equals_int (fast.range, bytewise.range);
+      fail_unless (fast.user_buffer == bytewise.user_buffer);
+      assert_equals_int (vp8dx_bool_error (&fast),
+          vp8dx_bool_error (&bytewise));
+    }
+  }
+
+  g_rand_free (rand);
+}
+
+GST_END_TEST;
+
 static Suite *
 vp8parsers_suite (void)
 {
@@ -221,6 +277,7 @@ vp8parsers_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_vp8_parse_key_frame);
   tcase_add_test (tc_chain, test_vp8_parse_inter_frame);
+  tcase_add_test (tc_chain, test_vp8_bool_decoder_fill);
 
   return s;
 }